@@ -1,5 +1,6 @@
 ﻿using AOT;
 using System;
+using System.Collections.Generic;
 using System.Runtime.InteropServices;
 using System.Text;
 
@@ -20,6 +21,45 @@ namespace Kirurobo
             [return: MarshalAs(UnmanagedType.Bool)]
             public static extern bool OpenSavePanel(in PanelSettings settings, [MarshalAs(UnmanagedType.LPWStr), Out] StringBuilder buffer, UInt32 bufferSize);
 
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            [DllImport("LibUniWinC")]
+            public static extern UInt32 OpenFilePanelEx(in PanelSettings settings);
+
+            [DllImport("LibUniWinC")]
+            public static extern UInt32 OpenSavePanelEx(in PanelSettings settings);
+
+            [DllImport("LibUniWinC")]
+            public static extern UInt32 GetPanelResultLength(UInt32 resultHandle);
+
+            [DllImport("LibUniWinC")]
+            public static extern IntPtr MapPanelResult(UInt32 resultHandle);
+
+            [DllImport("LibUniWinC")]
+            public static extern void ReleasePanelResult(UInt32 resultHandle);
+
+            [DllImport("LibUniWinC")]
+            public static extern UInt32 OpenFilePanelAsync(in PanelSettings settings);
+
+            [DllImport("LibUniWinC")]
+            public static extern UInt32 OpenSavePanelAsync(in PanelSettings settings);
+
+            [DllImport("LibUniWinC")]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool CancelPanelRequest(UInt32 requestId);
+
+            [DllImport("LibUniWinC")]
+            public static extern Int32 GetPanelRequestState(UInt32 requestId);
+
+            [DllImport("LibUniWinC")]
+            public static extern Int32 GetLastPanelState();
+
+            [DllImport("LibUniWinC")]
+            public static extern UInt32 TakePanelRequestResult(UInt32 requestId);
+
+            [DllImport("LibUniWinC")]
+            public static extern void ReleasePanelRequest(UInt32 requestId);
+#endif
+
 
             [StructLayout(LayoutKind.Sequential, Pack = 1)]
             public struct PanelSettings : IDisposable {
@@ -104,6 +144,20 @@ namespace Kirurobo
             RetrieveLink = 8192,
         }
 
+        /// <summary>
+        /// State of an asynchronous panel. Same as PanelRequestState of LibUniWinC
+        /// </summary>
+        public enum RequestState : int
+        {
+            None = 0,
+            Queued = 1,
+            Open = 2,
+            Selected = 3,
+            Cancelled = 4,
+            Failed = 5,
+            TooManyFiles = 6,   // Files were selected, but too many to be returned
+        }
+
         /// <summary>
         /// Parameters for file dialog
         /// </summary>
@@ -161,12 +215,49 @@ namespace Kirurobo
             }
         }
 
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+        /// <summary>
+        /// Take the result kept in the library and release it
+        ///     結果はネイティブ側で必要な長さだけ確保されているので、長さを聞いて一度だけ文字列にする。
+        /// </summary>
+        /// <param name="resultHandle">Handle of the result, or 0 if canceled</param>
+        /// <returns>Selected paths, or null if canceled</returns>
+        private static string[] TakeResult(uint resultHandle)
+        {
+            if (resultHandle == 0) return null;
+
+            string text = null;
+            uint length = LibUniWinC.GetPanelResultLength(resultHandle);
+            IntPtr ptr = LibUniWinC.MapPanelResult(resultHandle);
+            if (length > 0 && ptr != IntPtr.Zero)
+            {
+                text = Marshal.PtrToStringUni(ptr, (int)length - 1);
+            }
+            LibUniWinC.ReleasePanelResult(resultHandle);
+
+            if (text == null) return null;
+            return UniWinCore.parsePaths(text);
+        }
+#else
         /// <summary>
         /// ファイルやフォルダ―のパス受け渡しUTF-16バッファの文字数
         ///     複数パスが改行区切りで入るため 260 では少ない。
         /// </summary>
         private const int pathBufferSize = 2560;
 
+        /// <summary>
+        /// Take the result of the panel
+        /// </summary>
+        /// <param name="isSelected">Return value of the panel</param>
+        /// <param name="sb">Buffer passed to the panel</param>
+        /// <returns>Selected paths, or null if canceled</returns>
+        private static string[] GetResult(bool isSelected, StringBuilder sb)
+        {
+            if (!isSelected) return null;
+            return UniWinCore.parsePaths(sb.ToString());
+        }
+#endif
+
 
         /// <summary>
         /// Open file selection dialog
@@ -176,11 +267,14 @@ namespace Kirurobo
         public static void OpenFilePanel(Settings settings, Action<string[]> action)
         {
             LibUniWinC.PanelSettings ps = new LibUniWinC.PanelSettings(settings);
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            string[] files = TakeResult(LibUniWinC.OpenFilePanelEx(in ps));
+#else
             StringBuilder sb = new StringBuilder(pathBufferSize);
-
-            if (LibUniWinC.OpenFilePanel(in ps, sb, (uint)sb.Capacity))
+            string[] files = GetResult(LibUniWinC.OpenFilePanel(in ps, sb, (uint)sb.Capacity), sb);
+#endif
+            if (files != null)
             {
-                string[] files = UniWinCore.parsePaths(sb.ToString());
                 action.Invoke(files);
             }
 
@@ -195,15 +289,152 @@ namespace Kirurobo
         public static void SaveFilePanel(Settings settings, Action<string[]> action)
         {
             LibUniWinC.PanelSettings ps = new LibUniWinC.PanelSettings(settings);
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            string[] files = TakeResult(LibUniWinC.OpenSavePanelEx(in ps));
+#else
             StringBuilder sb = new StringBuilder(pathBufferSize);
-
-            if (LibUniWinC.OpenSavePanel(in ps, sb, (uint)sb.Capacity))
+            string[] files = GetResult(LibUniWinC.OpenSavePanel(in ps, sb, (uint)sb.Capacity), sb);
+#endif
+            if (files != null)
             {
-                string[] files = UniWinCore.parsePaths(sb.ToString());
                 action.Invoke(files);
             }
 
             ps.Dispose();   // Settings を渡したコンストラクタでメモリが確保されるため、解放が必要
         }
+
+        /// <summary>
+        /// Actions of the asynchronous panels waiting for completion, by the request ID
+        /// </summary>
+        private static readonly Dictionary<uint, Action<string[]>> _pendingRequests = new Dictionary<uint, Action<string[]>>();
+
+        /// <summary>
+        /// Open file selection dialog without blocking the frame
+        ///     The action is invoked by UniWindowController when the dialog closes, with null if cancelled.
+        ///     Other than Windows, the dialog is shown synchronously and 0 is returned.
+        /// </summary>
+        /// <param name="settings"></param>
+        /// <param name="action"></param>
+        /// <returns>Request ID to cancel the dialog, or 0</returns>
+        public static uint OpenFilePanelAsync(Settings settings, Action<string[]> action)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.PanelSettings ps = new LibUniWinC.PanelSettings(settings);
+            uint requestId = LibUniWinC.OpenFilePanelAsync(in ps);
+            ps.Dispose();   // 設定はネイティブ側でコピーされるため、すぐに解放してよい
+
+            if (requestId != 0) _pendingRequests[requestId] = action;
+            return requestId;
+#else
+            OpenFilePanel(settings, action);
+            return 0;
+#endif
+        }
+
+        /// <summary>
+        /// Open save-file selection dialog without blocking the frame
+        ///     The action is invoked by UniWindowController when the dialog closes, with null if cancelled.
+        ///     Other than Windows, the dialog is shown synchronously and 0 is returned.
+        /// </summary>
+        /// <param name="settings"></param>
+        /// <param name="action"></param>
+        /// <returns>Request ID to cancel the dialog, or 0</returns>
+        public static uint SaveFilePanelAsync(Settings settings, Action<string[]> action)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.PanelSettings ps = new LibUniWinC.PanelSettings(settings);
+            uint requestId = LibUniWinC.OpenSavePanelAsync(in ps);
+            ps.Dispose();
+
+            if (requestId != 0) _pendingRequests[requestId] = action;
+            return requestId;
+#else
+            SaveFilePanel(settings, action);
+            return 0;
+#endif
+        }
+
+        /// <summary>
+        /// Cancel the asynchronous dialog. The action is invoked with null
+        /// </summary>
+        /// <param name="requestId">Returned by OpenFilePanelAsync() or SaveFilePanelAsync()</param>
+        /// <returns>false if the dialog has already closed</returns>
+        public static bool CancelPanel(uint requestId)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            return LibUniWinC.CancelPanelRequest(requestId);
+#else
+            return false;
+#endif
+        }
+
+        /// <summary>
+        /// Get the state of the asynchronous dialog
+        /// </summary>
+        /// <param name="requestId"></param>
+        /// <returns>None after the action was invoked</returns>
+        public static RequestState GetPanelState(uint requestId)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            return (RequestState)LibUniWinC.GetPanelRequestState(requestId);
+#else
+            return RequestState.None;
+#endif
+        }
+
+        /// <summary>
+        /// How the last OpenFilePanel() or SaveFilePanel() ended
+        ///     Tells a cancel from TooManyFiles when the action was not invoked.
+        /// </summary>
+        /// <returns>None if not supported on the platform</returns>
+        public static RequestState GetLastPanelState()
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            return (RequestState)LibUniWinC.GetLastPanelState();
+#else
+            return RequestState.None;
+#endif
+        }
+
+        /// <summary>
+        /// Take the result of the completed request and invoke its action
+        ///     Called by UniWindowController on the PanelCompleted event.
+        /// </summary>
+        /// <param name="requestId"></param>
+        internal static void CompleteRequest(uint requestId)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            string[] files = TakeResult(LibUniWinC.TakePanelRequestResult(requestId));
+            LibUniWinC.ReleasePanelRequest(requestId);
+
+            if (_pendingRequests.TryGetValue(requestId, out var action))
+            {
+                _pendingRequests.Remove(requestId);
+                action?.Invoke(files);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Complete all the requests which have closed
+        ///     Called when PanelCompleted events may have been lost by the overflow of the event queue.
+        /// </summary>
+        internal static void CompleteClosedRequests()
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            if (_pendingRequests.Count < 1) return;
+
+            var closed = new List<uint>();
+            foreach (var requestId in _pendingRequests.Keys)
+            {
+                var state = (RequestState)LibUniWinC.GetPanelRequestState(requestId);
+                if (state != RequestState.Queued && state != RequestState.Open) closed.Add(requestId);
+            }
+            foreach (var requestId in closed)
+            {
+                CompleteRequest(requestId);
+            }
+#endif
+        }
     }
 }
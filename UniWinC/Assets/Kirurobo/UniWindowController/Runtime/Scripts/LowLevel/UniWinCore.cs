@@ -31,6 +31,234 @@ namespace Kirurobo
             ColorKey = 2,
         }
 
+        /// <summary>
+        /// Kinds of the events taken by PollEvents() for Windows only
+        /// </summary>
+        public enum EventType : int
+        {
+            None = 0,
+            WindowStateChanged = 1, // param: WindowStateEventType
+            MonitorChanged = 2,     // param: Number of monitors
+            FilesDropped = 3,       // param: Number of files. Also the end of a streaming drop
+            DropBegin = 4,          // param: Number of files of a streaming drop
+            DropChunk = 5,          // param: Number of files which can be read so far
+            DropInfoReady = 6,      // param: Number of files whose metadata can be read so far
+            DropExpandChunk = 7,    // param: Number of files found in the dropped folders so far
+            DropExpanded = 8,       // param: Number of files found in the dropped folders
+            PanelCompleted = 9,     // param: Request ID of FilePanel.OpenFilePanelAsync() or SaveFilePanelAsync()
+            DragMoveEnded = 10,     // param: 1 if the mouse button was released, 0 if ended by EndDragMove() or the window state
+            TweenCompleted = 11,    // param: ID of StartWindowTween(). The target has been reached
+            TweenCancelled = 12,    // param: ID of StartWindowTween(). Stopped, or its properties were taken by newer tweens
+            Overflow = 255,         // param: Number of events lost because the queue was full
+        }
+
+        /// <summary>
+        /// Event taken by PollEvents() for Windows only
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct WindowEvent
+        {
+            public Int32 type;          // EventType
+            public Int32 param;
+            public Int64 timestamp;     // [us]
+            public float x;             // Window position and size at the event
+            public float y;
+            public float width;
+            public float height;
+        }
+
+        /// <summary>
+        /// Properties animated by StartWindowTween() for Windows only
+        /// </summary>
+        [Flags]
+        public enum WindowTweenFlag : int
+        {
+            None = 0,
+            Position = 1,
+            Size = 2,           // The bottom-left is kept unless the position is also animated
+            Alpha = 4,
+        }
+
+        /// <summary>
+        /// Curves of the window tweens for Windows only
+        /// </summary>
+        public enum EasingType : int
+        {
+            Linear = 0,
+            InQuad = 1,
+            OutQuad = 2,
+            InOutQuad = 3,
+            InCubic = 4,
+            OutCubic = 5,
+            InOutCubic = 6,
+        }
+
+        /// <summary>
+        /// Window tween given to StartWindowTween() for Windows only
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct WindowTween
+        {
+            public Int32 structSize;
+            public Int32 flags;                 // WindowTweenFlag
+            public float x;                     // Target position and size, bottom-left origin
+            public float y;
+            public float width;
+            public float height;
+            public float alpha;                 // Target alpha [0, 1]
+            public Int32 duration;              // [ms]
+            public Int32 easing;                // EasingType
+        }
+
+        /// <summary>
+        /// How to apply a change of the window frame for Windows only
+        /// </summary>
+        public enum RefreshMode : int
+        {
+            FrameChanged = 0,   // SWP_FRAMECHANGED once. Resize by 1px only if needed
+            ResizeTrick = 1,    // Always resize by 1px and back
+        }
+
+        /// <summary>
+        /// Counts of window refreshes for Windows only
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct RefreshStats
+        {
+            public Int32 structSize;
+            public UInt32 resizeEvents;         // WM_SIZE received
+            public UInt32 swapchainRebuilds;    // Client size changes, each of which reallocates the back buffer
+            public UInt32 frameChanges;         // SetWindowPos with SWP_FRAMECHANGED
+            public UInt32 resizeTricks;         // Times the 1px resize trick was used
+        }
+
+        /// <summary>
+        /// Flags of WindowSnapshot
+        /// </summary>
+        [Flags]
+        public enum WindowSnapshotFlag : int
+        {
+            None = 0,
+            Attached = 1,       // A window is attached
+            Maximized = 2,
+            Minimized = 4,
+            Changed = 256,      // Something has changed since the generation given
+        }
+
+        /// <summary>
+        /// Window position, sizes, state, monitor and cursor position taken at once
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct WindowSnapshot
+        {
+            public Int32 structSize;
+            public UInt32 generation;           // In: generation of the last snapshot. Out: current generation, not changed by the cursor
+            public Int32 flags;                 // WindowSnapshotFlag
+            public Int32 monitor;               // Same as GetCurrentMonitor()
+            public Int32 monitorCount;
+            public UInt32 monitorGeneration;
+            public float x;                     // Window position and size, bottom-left origin
+            public float y;
+            public float width;
+            public float height;
+            public float clientWidth;
+            public float clientHeight;
+            public float cursorX;
+            public float cursorY;
+
+            public bool isChanged => (flags & (int)WindowSnapshotFlag.Changed) != 0;
+            public bool isMaximized => (flags & (int)WindowSnapshotFlag.Maximized) != 0;
+            public Vector2 position => new Vector2(x, y);
+            public Vector2 size => new Vector2(width, height);
+            public Vector2 clientSize => new Vector2(clientWidth, clientHeight);
+            public Vector2 cursorPosition => new Vector2(cursorX, cursorY);
+        }
+
+        /// <summary>
+        /// Page of the dropped paths taken by GetDropFiles() for Windows only
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct DropFilesPage
+        {
+            public Int32 structSize;
+            public UInt32 dropId;               // Incremented by each drop
+            public UInt32 totalCount;           // Paths of the drop
+            public UInt32 firstIndex;           // Index of the first path in this page
+            public UInt32 count;                // Paths in this page
+            public UInt32 dataLength;           // Characters written
+            public UInt32 nextLength;           // Characters of the path after this page, or 0
+            public UInt32 availableCount;       // Paths which can be read now. Less than totalCount while streaming
+        }
+
+        /// <summary>
+        /// Flags of DropFileInfo
+        /// </summary>
+        [Flags]
+        public enum DropFileFlag : int
+        {
+            None = 0,
+            Exists = 1,
+            Directory = 2,
+            Unreadable = 4,     // Exists but the head of the file could not be read
+        }
+
+        /// <summary>
+        /// File type guessed from the first bytes
+        /// </summary>
+        public enum DropFileType : int
+        {
+            Unknown = 0,
+            Png = 1,
+            Jpeg = 2,
+            Gif = 3,
+            Bmp = 4,
+            WebP = 5,
+            Tiff = 6,
+            Pdf = 16,
+            Zip = 17,
+            Gzip = 18,
+            SevenZip = 19,
+            Wav = 32,
+            Ogg = 33,
+            Flac = 34,
+            Mp3 = 35,
+            Mp4 = 36,
+            Glb = 48,           // glTF binary, also VRM
+            Fbx = 49,           // Binary FBX
+            Text = 64,          // Text with a UTF-8 or UTF-16 BOM
+        }
+
+        /// <summary>
+        /// Metadata of a dropped file taken by GetDropFileInfo() for Windows only
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct DropFileInfo
+        {
+            public UInt64 size;                 // Bytes. 0 for a directory
+            public Int64 modifiedTime;          // Unix time [ms]
+            public Int32 flags;                 // DropFileFlag
+            public Int32 type;                  // DropFileType
+
+            public bool exists => (flags & (int)DropFileFlag.Exists) != 0;
+            public bool isDirectory => (flags & (int)DropFileFlag.Directory) != 0;
+            public DropFileType fileType => (DropFileType)type;
+            public DateTimeOffset modified => DateTimeOffset.FromUnixTimeMilliseconds(modifiedTime);
+        }
+
+        /// <summary>
+        /// Counts of the events taken by PollEvents() for Windows only
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct EventStats
+        {
+            public Int32 structSize;
+            public UInt32 received;             // Events which occurred
+            public UInt32 delivered;            // Events returned by PollEvents(). Fewer than received by coalescing
+            public UInt32 dropped;              // Events lost because the queue was full
+            public UInt32 resizedReceived;
+            public UInt32 resizedDelivered;
+        }
+
 
         /// <summary>
         /// State changed event type (Experimental)
@@ -85,6 +313,10 @@ namespace Kirurobo
             [return: MarshalAs(UnmanagedType.Bool)]
             public static extern bool IsMaximized();
 
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool IsMinimized();
+
             [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
             [return: MarshalAs(UnmanagedType.Bool)]
             public static extern bool AttachMyWindow();
@@ -202,6 +434,190 @@ namespace Kirurobo
             [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
             [return: MarshalAs(UnmanagedType.Bool)]
             public static extern bool AttachWindowHandle(IntPtr hWnd);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetHitTestMask(byte[] alpha, int width, int height, byte threshold);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetHitTestMaskBits(byte[] bits, int width, int height);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void ClearHitTestMask();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void EnableHitTestMask([MarshalAs(UnmanagedType.U1)] bool bEnabled);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void EnableInputRegion([MarshalAs(UnmanagedType.U1)] bool bEnabled);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool BeginDragMove();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void EndDragMove();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool IsDragMoving();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void SetDragMoveSnap([MarshalAs(UnmanagedType.U1)] bool bEnabled, int nDistance);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern uint StartWindowTween(ref WindowTween tween);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool StopWindowTween(uint nTweenId, [MarshalAs(UnmanagedType.U1)] bool bComplete);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void StopAllWindowTweens();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool IsWindowTweening(uint nTweenId);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void BeginWindowUpdate();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool CommitWindowUpdate();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void SetRefreshMode(int mode);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern int GetRefreshMode();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool GetRefreshStats(ref RefreshStats stats);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void ResetRefreshStats();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern UInt32 GetMonitorGeneration();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool GetWindowSnapshot(ref WindowSnapshot snapshot);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void EnableEventQueue([MarshalAs(UnmanagedType.U1)] bool bEnabled);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern int PollEvents([In, Out] WindowEvent[] events, int maxCount);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void EnableDropStreaming([MarshalAs(UnmanagedType.Bool)] bool bEnabled, int budget);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void EnableDropFileInfo([MarshalAs(UnmanagedType.Bool)] bool bEnabled, int threads);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void CancelDropFileInfo();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern int GetDropFileInfo(uint firstIndex, [Out] DropFileInfo[] infos, uint maxCount, ref DropFilesPage page);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi, CharSet = CharSet.Unicode)]
+            public static extern int GetDropFiles(uint firstIndex, [Out] uint[] offsets, uint maxCount, [Out] char[] data, uint dataCapacity, ref DropFilesPage page);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi, CharSet = CharSet.Unicode)]
+            public static extern void EnableDropExpansion([MarshalAs(UnmanagedType.Bool)] bool bEnabled, [MarshalAs(UnmanagedType.LPWStr)] string lpszFilter, int maxDepth, int threads);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void CancelDropExpansion();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi, CharSet = CharSet.Unicode)]
+            public static extern int MatchFileFilter([MarshalAs(UnmanagedType.LPWStr)] string lpszFilter, [In] uint[] offsets, [In] char[] data, uint count, [Out] byte[] results);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi, CharSet = CharSet.Unicode)]
+            public static extern int GetExpandedFiles(uint firstIndex, [Out] uint[] offsets, uint maxCount, [Out] char[] data, uint dataCapacity, ref DropFilesPage page);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetEventInterval(int type, int param, int milliseconds);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool GetEventStats(ref EventStats stats);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern void ResetEventStats();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern uint CreateContext();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool DestroyContext(uint hContext);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern uint GetDefaultContext();
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool AttachContextWindow(uint hContext, IntPtr hWnd);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool DetachContextWindow(uint hContext);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern IntPtr GetContextWindowHandle(uint hContext);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool IsContextActive(uint hContext);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextTransparent(uint hContext, [MarshalAs(UnmanagedType.Bool)] bool bTransparent);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextBorderless(uint hContext, [MarshalAs(UnmanagedType.Bool)] bool bBorderless);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextAlphaValue(uint hContext, float alpha);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextTopmost(uint hContext, [MarshalAs(UnmanagedType.Bool)] bool bTopmost);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextClickThrough(uint hContext, [MarshalAs(UnmanagedType.Bool)] bool bTransparent);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextPosition(uint hContext, float x, float y);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool GetContextPosition(uint hContext, out float x, out float y);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool SetContextSize(uint hContext, float width, float height);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool GetContextSize(uint hContext, out float width, out float height);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            [return: MarshalAs(UnmanagedType.Bool)]
+            public static extern bool EnableContextEventQueue(uint hContext, [MarshalAs(UnmanagedType.Bool)] bool bEnabled);
+
+            [DllImport("LibUniWinC",CallingConvention=CallingConvention.Winapi)]
+            public static extern int PollContextEvents(uint hContext, [In, Out] WindowEvent[] events, int maxCount);
             #endregion
         }
         #endregion
@@ -297,6 +713,9 @@ namespace Kirurobo
             LibUniWinC.UnregisterDropFilesCallback();
             LibUniWinC.UnregisterMonitorChangedCallback();
             LibUniWinC.UnregisterWindowStyleChangedCallback();
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.EnableEventQueue(false);
+#endif
         }
         #endregion
 
@@ -453,9 +872,15 @@ namespace Kirurobo
             LibUniWinC.AttachMyWindow();
 #endif
             // Add event handlers
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            // ウィンドウ状態とモニタの変化、ドロップは、コールバックではなく PollEvents() でまとめて取り出す
+            //   ドロップされたパスは GetDroppedFiles() で受け取る
+            LibUniWinC.EnableEventQueue(true);
+#else
             LibUniWinC.RegisterDropFilesCallback(_dropFilesCallback);
             LibUniWinC.RegisterMonitorChangedCallback(_monitorChangedCallback);
             LibUniWinC.RegisterWindowStyleChangedCallback(_windowStyleChangedCallback);
+#endif
 
             IsActive = LibUniWinC.IsActive();
             return IsActive;
@@ -629,6 +1054,47 @@ namespace Kirurobo
             return size;
         }
 
+        /// <summary>
+        /// Get the window position, sizes, state, monitor and cursor position at once
+        ///   Windows では1回の呼び出しで取得。それ以外では個別に取得する
+        /// </summary>
+        /// <param name="snapshot">generation に前回の値を入れておくと、変化があったかが isChanged で分かる</param>
+        /// <returns>成功すれば true</returns>
+        public bool GetWindowSnapshot(ref WindowSnapshot snapshot)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            snapshot.structSize = Marshal.SizeOf(snapshot);
+            return LibUniWinC.GetWindowSnapshot(ref snapshot);
+#else
+            WindowSnapshot current = new WindowSnapshot();
+            current.structSize = Marshal.SizeOf(current);
+            if (IsActive)
+            {
+                current.flags |= (int)WindowSnapshotFlag.Attached;
+                if (LibUniWinC.IsMaximized()) current.flags |= (int)WindowSnapshotFlag.Maximized;
+                if (LibUniWinC.IsMinimized()) current.flags |= (int)WindowSnapshotFlag.Minimized;
+                LibUniWinC.GetPosition(out current.x, out current.y);
+                LibUniWinC.GetSize(out current.width, out current.height);
+                LibUniWinC.GetClientSize(out current.clientWidth, out current.clientHeight);
+            }
+            LibUniWinC.GetCursorPosition(out current.cursorX, out current.cursorY);
+            current.monitor = LibUniWinC.GetCurrentMonitor();
+            current.monitorCount = LibUniWinC.GetMonitorCount();
+
+            // 世代の代わりに値を比べる
+            current.generation = snapshot.generation;
+            WindowSnapshot previous = snapshot;
+            previous.flags &= ~(int)WindowSnapshotFlag.Changed;
+            if (!current.Equals(previous))
+            {
+                current.generation++;
+                current.flags |= (int)WindowSnapshotFlag.Changed;
+            }
+            snapshot = current;
+            return true;
+#endif
+        }
+
 #endregion
 
         #region File opening
@@ -749,6 +1215,674 @@ namespace Kirurobo
             LibUniWinC.SetKeyColor((UInt32)(color.b * 0x10000 + color.g * 0x100 + color.r));
             keyColor = color;
         }
+
+        /// <summary>
+        /// クリックスルー判定用のアルファマスクを設定（Windowsのみ対応）
+        ///   縮小した画像でもよい。数フレームおきに送れば、判定はネイティブ側でカーソルに追従して行われる
+        /// </summary>
+        /// <param name="alpha">width * height のアルファ値。テクスチャと同じく下の行から</param>
+        /// <param name="width"></param>
+        /// <param name="height"></param>
+        /// <param name="threshold">この値以上を不透明とする [0, 1]</param>
+        public bool SetHitTestMask(byte[] alpha, int width, int height, float threshold)
+        {
+            if (alpha == null || alpha.Length < width * height) return false;
+            return LibUniWinC.SetHitTestMask(alpha, width, height, (byte)(Mathf.Clamp01(threshold) * 255f));
+        }
+
+        /// <summary>
+        /// 1ピクセル1ビットに詰めたマスクを設定（Windowsのみ対応）
+        /// </summary>
+        /// <param name="bits">各バイトの下位ビットから左のピクセル。各行はバイト境界まで詰める</param>
+        /// <param name="width"></param>
+        /// <param name="height"></param>
+        public bool SetHitTestMaskBits(byte[] bits, int width, int height)
+        {
+            if (bits == null || bits.Length < ((width + 7) / 8) * height) return false;
+            return LibUniWinC.SetHitTestMaskBits(bits, width, height);
+        }
+
+        /// <summary>
+        /// マスクを消去（Windowsのみ対応）
+        /// </summary>
+        public void ClearHitTestMask()
+        {
+            LibUniWinC.ClearHitTestMask();
+        }
+
+        /// <summary>
+        /// マスクによるクリックスルーの自動切替を有効化／無効化（Windowsのみ対応）
+        /// </summary>
+        /// <param name="enabled"></param>
+        public void EnableHitTestMask(bool enabled)
+        {
+            LibUniWinC.EnableHitTestMask(enabled);
+        }
+
+        /// <summary>
+        /// マスクの不透明部分をウィンドウの入力領域とするか設定（Windowsのみ対応）
+        ///   判定はOSが行う。ただしWindowsでは領域外は描画もされない
+        /// </summary>
+        /// <param name="enabled"></param>
+        public void EnableInputRegion(bool enabled)
+        {
+            LibUniWinC.EnableInputRegion(enabled);
+        }
+
+        /// <summary>
+        /// ウィンドウのドラッグを開始（Windowsのみ対応）
+        ///   以後はフレームに関係なく、ネイティブ側でウィンドウがカーソルに追従する。マウスボタンを離すと終了
+        /// </summary>
+        /// <returns>開始できれば true。最大化されていれば false</returns>
+        public bool BeginDragMove()
+        {
+            return LibUniWinC.BeginDragMove();
+        }
+
+        /// <summary>
+        /// ウィンドウのドラッグを終了（Windowsのみ対応）
+        /// </summary>
+        public void EndDragMove()
+        {
+            LibUniWinC.EndDragMove();
+        }
+
+        /// <summary>
+        /// ウィンドウのドラッグ中か（Windowsのみ対応）
+        /// </summary>
+        public bool IsDragMoving()
+        {
+            return LibUniWinC.IsDragMoving();
+        }
+
+        /// <summary>
+        /// ドラッグ中のウィンドウをモニタの端に吸着させるか設定（Windowsのみ対応）
+        /// </summary>
+        /// <param name="enabled"></param>
+        /// <param name="distance">端からこの距離以内で吸着する [px]。0なら既定値</param>
+        public void SetDragMoveSnap(bool enabled, int distance = 0)
+        {
+            LibUniWinC.SetDragMoveSnap(enabled, distance);
+        }
+
+        /// <summary>
+        /// ウィンドウの位置、サイズ、透明度のアニメーションを開始（Windowsのみ対応）
+        ///   フレームに関係なくネイティブ側で進み、終われば PollEvents() で TweenCompleted が届く
+        /// </summary>
+        /// <param name="flags">動かすプロパティ</param>
+        /// <param name="position">目標位置。左下基準 [px]</param>
+        /// <param name="size">目標サイズ [px]</param>
+        /// <param name="alpha">目標透明度 [0, 1]</param>
+        /// <param name="duration">時間 [s]</param>
+        /// <param name="easing"></param>
+        /// <returns>アニメーションのID。失敗すれば 0</returns>
+        public uint StartWindowTween(WindowTweenFlag flags, Vector2 position, Vector2 size, float alpha, float duration, EasingType easing = EasingType.Linear)
+        {
+            WindowTween tween = new WindowTween();
+            tween.structSize = Marshal.SizeOf(tween);
+            tween.flags = (int)flags;
+            tween.x = position.x;
+            tween.y = position.y;
+            tween.width = size.x;
+            tween.height = size.y;
+            tween.alpha = alpha;
+            tween.duration = (int)(duration * 1000f);
+            tween.easing = (int)easing;
+            return LibUniWinC.StartWindowTween(ref tween);
+        }
+
+        /// <summary>
+        /// アニメーションを止める（Windowsのみ対応）
+        /// </summary>
+        /// <param name="id">StartWindowTween() で得たID</param>
+        /// <param name="complete">true なら目標値まで進めて TweenCompleted、false ならその場で止めて TweenCancelled</param>
+        public bool StopWindowTween(uint id, bool complete)
+        {
+            return LibUniWinC.StopWindowTween(id, complete);
+        }
+
+        /// <summary>
+        /// 全てのアニメーションをその場で止める（Windowsのみ対応）
+        /// </summary>
+        public void StopAllWindowTweens()
+        {
+            LibUniWinC.StopAllWindowTweens();
+        }
+
+        /// <summary>
+        /// アニメーション中か（Windowsのみ対応）
+        /// </summary>
+        /// <param name="id">StartWindowTween() で得たID。0 ならいずれかが動いているか</param>
+        public bool IsWindowTweening(uint id = 0)
+        {
+            return LibUniWinC.IsWindowTweening(id);
+        }
+
+        /// <summary>
+        /// 以降のウィンドウ状態の変更を CommitWindowUpdate() までまとめる（Windowsのみ対応）
+        ///   複数の設定を同時に変える際に、ちらつきとスタイル変更の回数を減らせる
+        /// </summary>
+        public void BeginWindowUpdate()
+        {
+            LibUniWinC.BeginWindowUpdate();
+        }
+
+        /// <summary>
+        /// BeginWindowUpdate() 以降の変更をまとめて反映（Windowsのみ対応）
+        /// </summary>
+        public bool CommitWindowUpdate()
+        {
+            return LibUniWinC.CommitWindowUpdate();
+        }
+
+        /// <summary>
+        /// 枠の変更の反映方法を指定（Windowsのみ対応）
+        /// </summary>
+        /// <param name="mode"></param>
+        public void SetRefreshMode(RefreshMode mode)
+        {
+            LibUniWinC.SetRefreshMode((Int32)mode);
+        }
+
+        /// <summary>
+        /// 枠の変更の反映方法を取得（Windowsのみ対応）
+        /// </summary>
+        public RefreshMode GetRefreshMode()
+        {
+            return (RefreshMode)LibUniWinC.GetRefreshMode();
+        }
+
+        /// <summary>
+        /// 枠の変更によるリサイズ、スワップチェーン再作成の回数を取得（Windowsのみ対応）
+        /// </summary>
+        /// <param name="stats"></param>
+        public bool GetRefreshStats(out RefreshStats stats)
+        {
+            stats = new RefreshStats();
+            stats.structSize = Marshal.SizeOf(stats);
+            return LibUniWinC.GetRefreshStats(ref stats);
+        }
+
+        /// <summary>
+        /// 計測した回数を0に戻す（Windowsのみ対応）
+        /// </summary>
+        public void ResetRefreshStats()
+        {
+            LibUniWinC.ResetRefreshStats();
+        }
+
+        /// <summary>
+        /// モニタ配置の世代を取得（Windowsのみ対応）
+        ///   モニタ構成が変わると増えるので、前回の値と比べて変化を判定できる
+        /// </summary>
+        /// <returns>世代</returns>
+        public uint GetMonitorGeneration()
+        {
+            return LibUniWinC.GetMonitorGeneration();
+        }
+
+        /// <summary>
+        /// ネイティブ側に溜まったイベントを発生順にまとめて取り出す（Windowsのみ対応）
+        ///   毎フレーム1回呼ぶ想定
+        /// </summary>
+        /// <param name="events">受け取る配列</param>
+        /// <returns>取り出したイベント数</returns>
+        public int PollEvents(WindowEvent[] events)
+        {
+            if (events == null || events.Length == 0) return 0;
+            return LibUniWinC.PollEvents(events, events.Length);
+        }
+
+        /// <summary>
+        /// 最後にドロップされたパスを取得（Windowsのみ対応）
+        ///   区切り文字を使わないため、パスに改行等が含まれていてもよい
+        ///   受け取り用のバッファは使い回し、大量のドロップは複数回に分けて取り出す
+        /// </summary>
+        /// <param name="files">パスの配列</param>
+        /// <returns>パスがあれば true</returns>
+        public bool GetDroppedFiles(out string[] files)
+        {
+            var list = new System.Collections.Generic.List<string>();
+            uint dropId = 0;
+            ReadDroppedFiles(list, ref dropId);
+            files = list.ToArray();
+            return (files.Length > 0);
+        }
+
+        /// <summary>
+        /// ドロップされたパスのうち、まだ受け取っていないものを追加（Windowsのみ対応）
+        ///   ストリーミング中は、その時点で取り出し済みの分だけ追加される
+        /// </summary>
+        /// <param name="files">受け取ったパス。files.Count 番目から追加する</param>
+        /// <param name="dropId">受け取り中のドロップのID。別のドロップになっていれば files を空にして最初から受け取る</param>
+        /// <returns>追加したパスの数</returns>
+        public int ReadDroppedFiles(System.Collections.Generic.List<string> files, ref uint dropId)
+        {
+            return ReadPaths(false, files, ref dropId);
+        }
+
+        /// <summary>
+        /// ドロップされたフォルダ内で見つかったパスのうち、まだ受け取っていないものを追加（Windowsのみ対応）
+        ///   フォルダを辿っている間は、その時点で見つかった分だけ追加される。順序は決まっていない
+        /// </summary>
+        /// <param name="files">受け取ったパス。files.Count 番目から追加する</param>
+        /// <param name="dropId">受け取り中のドロップのID。別のドロップになっていれば files を空にして最初から受け取る</param>
+        /// <returns>追加したパスの数</returns>
+        public int ReadExpandedFiles(System.Collections.Generic.List<string> files, ref uint dropId)
+        {
+            return ReadPaths(true, files, ref dropId);
+        }
+
+        /// <summary>
+        /// ドロップされたフォルダ内のファイルを別スレッドで再帰的に探す（Windowsのみ対応）
+        ///   DropExpandChunk、DropExpanded のイベントが届き、ReadExpandedFiles() で受け取る
+        /// </summary>
+        /// <param name="enabled">false にすると探している途中なら取り消す</param>
+        /// <param name="filters">ファイルダイアログと同じフィルタ。null なら全てのファイル</param>
+        /// <param name="maxDepth">ドロップされたフォルダ直下を 1 とした深さの上限。0 なら既定値</param>
+        /// <param name="threads">同時に探すスレッド数の上限。0 なら既定値</param>
+        public void EnableDropExpansion(bool enabled, FilePanel.Filter[] filters = null, int maxDepth = 0, int threads = 0)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.EnableDropExpansion(enabled, (filters == null ? null : FilePanel.Filter.Join(filters)), maxDepth, threads);
+#endif
+        }
+
+        /// <summary>
+        /// ドロップされたフォルダ内を探している途中なら止める（Windowsのみ対応）
+        ///   それまでに見つかった分で DropExpanded のイベントが届く
+        /// </summary>
+        public void CancelDropExpansion()
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.CancelDropExpansion();
+#endif
+        }
+
+        /// <summary>
+        /// パスのうち、ファイルダイアログと同じフィルタの拡張子を持つものを取り出す
+        ///   Windows ではネイティブでまとめて照合する。"tar.gz" のような拡張子も指定できる
+        /// </summary>
+        /// <param name="filters">ファイルダイアログと同じフィルタ。null なら全てのパスが一致する</param>
+        /// <param name="paths">調べるパス</param>
+        /// <param name="matched">一致したパスを追加する</param>
+        /// <returns>一致したパスの数</returns>
+        public int FilterPaths(FilePanel.Filter[] filters, System.Collections.Generic.IList<string> paths, System.Collections.Generic.List<string> matched)
+        {
+            string filterText = (filters == null ? null : FilePanel.Filter.Join(filters));
+            int added = 0;
+
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            // 受け取り用と同じ形に詰めて、まとめて照合する
+            int index = 0;
+            while (index < paths.Count)
+            {
+                int count = 0;
+                int length = 0;
+                _filterOffsets[0] = 0;
+                while (index + count < paths.Count && count < _filterOffsets.Length - 1)
+                {
+                    string path = paths[index + count];
+                    if (length + path.Length > _filterData.Length)
+                    {
+                        if (count > 0) break;
+                        _filterData = new char[Math.Max(_filterData.Length * 2, path.Length)];
+                    }
+                    path.CopyTo(0, _filterData, length, path.Length);
+                    length += path.Length;
+                    count++;
+                    _filterOffsets[count] = (uint)length;
+                }
+
+                LibUniWinC.MatchFileFilter(filterText, _filterOffsets, _filterData, (uint)count, _filterResults);
+                for (int i = 0; i < count; i++)
+                {
+                    if (_filterResults[i] != 0)
+                    {
+                        matched.Add(paths[index + i]);
+                        added++;
+                    }
+                }
+                index += count;
+            }
+#else
+            string[] extensions = null;
+            if (filterText != null)
+            {
+                var list = new System.Collections.Generic.List<string>();
+                foreach (string line in filterText.Split('\n'))
+                {
+                    string[] items = line.Split('\t');
+                    for (int i = 1; i < items.Length; i++)
+                    {
+                        if (items[i] == "*") { list = null; break; }
+                        if (items[i].Length > 0) list.Add("." + items[i]);
+                    }
+                    if (list == null) break;
+                }
+                if (list != null && list.Count > 0) extensions = list.ToArray();
+            }
+
+            foreach (string path in paths)
+            {
+                bool isMatched = (extensions == null);
+                for (int i = 0; !isMatched && i < extensions.Length; i++)
+                {
+                    isMatched = path.EndsWith(extensions[i], StringComparison.OrdinalIgnoreCase);
+                }
+                if (isMatched)
+                {
+                    matched.Add(path);
+                    added++;
+                }
+            }
+#endif
+            return added;
+        }
+        private uint[] _filterOffsets = new uint[4097];
+        private char[] _filterData = new char[65536];
+        private byte[] _filterResults = new byte[4096];
+
+        /// <summary>
+        /// ドロップされたパス、またはフォルダ内で見つかったパスを追加
+        /// </summary>
+        private int ReadPaths(bool expanded, System.Collections.Generic.List<string> files, ref uint dropId)
+        {
+            var page = new DropFilesPage();
+            page.structSize = Marshal.SizeOf(page);
+
+            int added = 0;
+            while (true)
+            {
+                uint index = (uint)files.Count;
+                int count = (expanded
+                    ? LibUniWinC.GetExpandedFiles(index, _dropOffsets, (uint)(_dropOffsets.Length - 1), _dropData, (uint)_dropData.Length, ref page)
+                    : LibUniWinC.GetDropFiles(index, _dropOffsets, (uint)(_dropOffsets.Length - 1), _dropData, (uint)_dropData.Length, ref page));
+                if (count < 0) break;
+
+                // 途中で次のドロップがあれば最初から取り直す
+                if (page.dropId != dropId)
+                {
+                    dropId = page.dropId;
+                    files.Clear();
+                    added = 0;
+                    if (page.firstIndex != 0) continue;
+                }
+
+                for (int i = 0; i < count; i++)
+                {
+                    files.Add(new string(_dropData, (int)_dropOffsets[i], (int)(_dropOffsets[i + 1] - _dropOffsets[i])));
+                }
+                added += count;
+
+                if (count == 0)
+                {
+                    // 取り出し済みの分は受け取り終えた
+                    if (page.nextLength == 0) break;
+
+                    // 1つも入らなければバッファを広げる
+                    _dropData = new char[Math.Max(_dropData.Length * 2, (int)page.nextLength)];
+                }
+            }
+            return added;
+        }
+
+        /// <summary>
+        /// 大量のドロップを、ウィンドウプロシージャで一度に処理せず PollEvents() で少しずつ取り出す（Windowsのみ対応）
+        ///   DropBegin、DropChunk、FilesDropped のイベントが届く
+        /// </summary>
+        /// <param name="enabled"></param>
+        /// <param name="budget">PollEvents() 1回あたりに使う時間 [us]。0 なら既定値</param>
+        public void EnableDropStreaming(bool enabled, int budget = 0)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.EnableDropStreaming(enabled, budget);
+#endif
+        }
+        private uint[] _dropOffsets = new uint[1025];
+        private char[] _dropData = new char[32768];
+
+        /// <summary>
+        /// ドロップされたファイルのサイズ、更新日時、種類を別スレッドで調べる（Windowsのみ対応）
+        ///   調べ終えた分から、ドロップの順に DropInfoReady のイベントが届く
+        /// </summary>
+        /// <param name="enabled">false にすると調べていない分は取り消す</param>
+        /// <param name="threads">同時に調べるスレッド数の上限。0 なら既定値</param>
+        public void EnableDropFileInfo(bool enabled, int threads = 0)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.EnableDropFileInfo(enabled, threads);
+#endif
+        }
+
+        /// <summary>
+        /// 最後のドロップについて、まだ調べていないファイルは調べない（Windowsのみ対応）
+        /// </summary>
+        public void CancelDropFileInfo()
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            LibUniWinC.CancelDropFileInfo();
+#endif
+        }
+
+        /// <summary>
+        /// ドロップされたファイルの情報のうち、まだ受け取っていないものを追加（Windowsのみ対応）
+        ///   調べ終えた分だけ、ドロップの順に追加される
+        /// </summary>
+        /// <param name="infos">受け取った情報。infos.Count 番目から追加する</param>
+        /// <param name="dropId">受け取り中のドロップのID。別のドロップになっていれば infos を空にして最初から受け取る</param>
+        /// <returns>追加した数</returns>
+        public int ReadDropFileInfo(System.Collections.Generic.List<DropFileInfo> infos, ref uint dropId)
+        {
+            var page = new DropFilesPage();
+            page.structSize = Marshal.SizeOf(page);
+
+            int added = 0;
+            while (true)
+            {
+                int count = LibUniWinC.GetDropFileInfo((uint)infos.Count, _dropInfos, (uint)_dropInfos.Length, ref page);
+                if (count < 0) break;
+
+                // 途中で次のドロップがあれば最初から取り直す
+                if (page.dropId != dropId)
+                {
+                    dropId = page.dropId;
+                    infos.Clear();
+                    added = 0;
+                    if (page.firstIndex != 0) continue;
+                }
+
+                for (int i = 0; i < count; i++)
+                {
+                    infos.Add(_dropInfos[i]);
+                }
+                added += count;
+
+                if (count < _dropInfos.Length) break;
+            }
+            return added;
+        }
+        private DropFileInfo[] _dropInfos = new DropFileInfo[256];
+
+        /// <summary>
+        /// ウィンドウ状態の変化イベントを通知する最小間隔を指定（Windowsのみ対応）
+        ///   間隔内の変化はまとめられ、最後の状態が間隔の経過後に通知される。0 なら PollEvents() 1回につき1つ
+        /// </summary>
+        /// <param name="type">Resized か StyleChanged</param>
+        /// <param name="milliseconds">最小間隔 [ms]</param>
+        /// <returns>まとめられないイベントならfalse</returns>
+        public bool SetEventInterval(WindowStateEventType type, int milliseconds)
+        {
+            return LibUniWinC.SetEventInterval((int)EventType.WindowStateChanged, (int)type, milliseconds);
+        }
+
+        /// <summary>
+        /// 発生したイベント数と PollEvents() で渡したイベント数を取得（Windowsのみ対応）
+        /// </summary>
+        /// <param name="stats"></param>
+        public bool GetEventStats(out EventStats stats)
+        {
+            stats = new EventStats();
+            stats.structSize = Marshal.SizeOf(stats);
+            return LibUniWinC.GetEventStats(ref stats);
+        }
+
+        /// <summary>
+        /// イベント数を0に戻す（Windowsのみ対応）
+        /// </summary>
+        public void ResetEventStats()
+        {
+            LibUniWinC.ResetEventStats();
+        }
+
+        /// <summary>
+        /// 別のウィンドウを扱うコンテキストを作成（Windowsのみ対応）
+        ///   このクラスの他の関数は既定のコンテキストのウィンドウを扱い、コンテキストのウィンドウとは独立している
+        ///   ドロップされたファイル、ファイルパネル、モニタ情報は共通
+        /// </summary>
+        /// <returns>コンテキストのハンドル。失敗すれば 0</returns>
+        public static uint CreateContext()
+        {
+            return LibUniWinC.CreateContext();
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウを元に戻し、コンテキストを破棄（Windowsのみ対応）
+        /// </summary>
+        /// <param name="context">CreateContext() で得たハンドル。以降は使えない</param>
+        public static bool DestroyContext(uint context)
+        {
+            return LibUniWinC.DestroyContext(context);
+        }
+
+        /// <summary>
+        /// コンテキストでウィンドウを扱う（Windowsのみ対応）
+        /// </summary>
+        /// <param name="context"></param>
+        /// <param name="hWnd">他のコンテキストが扱っているウィンドウは選べない</param>
+        public static bool AttachContextWindow(uint context, IntPtr hWnd)
+        {
+            return LibUniWinC.AttachContextWindow(context, hWnd);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウを元に戻して解放（Windowsのみ対応）
+        /// </summary>
+        public static bool DetachContextWindow(uint context)
+        {
+            return LibUniWinC.DetachContextWindow(context);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウが利用可能か（Windowsのみ対応）
+        /// </summary>
+        public static bool IsContextActive(uint context)
+        {
+            return LibUniWinC.IsContextActive(context);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウの透過を設定（Windowsのみ対応）
+        /// </summary>
+        public static bool SetContextTransparent(uint context, bool isTransparent)
+        {
+            return LibUniWinC.SetContextTransparent(context, isTransparent);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウの枠を設定（Windowsのみ対応）
+        /// </summary>
+        public static bool SetContextBorderless(uint context, bool isBorderless)
+        {
+            return LibUniWinC.SetContextBorderless(context, isBorderless);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウの透明度を設定（Windowsのみ対応）
+        /// </summary>
+        /// <param name="context"></param>
+        /// <param name="alpha">0.0 - 1.0</param>
+        public static bool SetContextAlphaValue(uint context, float alpha)
+        {
+            return LibUniWinC.SetContextAlphaValue(context, alpha);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウを最前面にするか設定（Windowsのみ対応）
+        /// </summary>
+        public static bool SetContextTopmost(uint context, bool isTopmost)
+        {
+            return LibUniWinC.SetContextTopmost(context, isTopmost);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウのクリックスルーを設定（Windowsのみ対応）
+        /// </summary>
+        public static bool SetContextClickThrough(uint context, bool isTransparent)
+        {
+            return LibUniWinC.SetContextClickThrough(context, isTransparent);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウの位置を設定（Windowsのみ対応）
+        /// </summary>
+        /// <param name="context"></param>
+        /// <param name="position">左下基準 [px]</param>
+        public static bool SetContextWindowPosition(uint context, Vector2 position)
+        {
+            return LibUniWinC.SetContextPosition(context, position.x, position.y);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウの位置を取得（Windowsのみ対応）
+        /// </summary>
+        public static Vector2 GetContextWindowPosition(uint context)
+        {
+            Vector2 pos = Vector2.zero;
+            LibUniWinC.GetContextPosition(context, out pos.x, out pos.y);
+            return pos;
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウのサイズを設定（Windowsのみ対応）
+        /// </summary>
+        /// <param name="context"></param>
+        /// <param name="size">x が幅、y が高さ [px]</param>
+        public static bool SetContextWindowSize(uint context, Vector2 size)
+        {
+            return LibUniWinC.SetContextSize(context, size.x, size.y);
+        }
+
+        /// <summary>
+        /// コンテキストのウィンドウのサイズを取得（Windowsのみ対応）
+        /// </summary>
+        public static Vector2 GetContextWindowSize(uint context)
+        {
+            Vector2 size = Vector2.zero;
+            LibUniWinC.GetContextSize(context, out size.x, out size.y);
+            return size;
+        }
+
+        /// <summary>
+        /// コンテキストのイベントを PollContextEvents() で受け取るか設定（Windowsのみ対応）
+        /// </summary>
+        public static bool EnableContextEventQueue(uint context, bool enabled)
+        {
+            return LibUniWinC.EnableContextEventQueue(context, enabled);
+        }
+
+        /// <summary>
+        /// コンテキストのイベントをまとめて取り出す（Windowsのみ対応）
+        ///   ファイルのドロップのイベントはドロップされたウィンドウのコンテキストに届く
+        /// </summary>
+        /// <param name="context"></param>
+        /// <param name="events">受け取り用の配列</param>
+        /// <returns>受け取ったイベント数。ハンドルが無効なら -1</returns>
+        public static int PollContextEvents(uint context, WindowEvent[] events)
+        {
+            if (events == null || events.Length == 0) return 0;
+            return LibUniWinC.PollContextEvents(context, events, events.Length);
+        }
 #endregion
 
 #region About monitors
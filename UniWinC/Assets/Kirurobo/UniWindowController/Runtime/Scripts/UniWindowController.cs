@@ -1,4 +1,4 @@
-/*
+﻿/*
  * UniWindowController.cs
  * 
  * Author: Kirurobo http://twitter.com/kirurobo
@@ -93,6 +93,34 @@ namespace Kirurobo
         /// </summary>
         private UniWinCore _uniWinCore = null;
 
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+        /// <summary>
+        /// Buffer to receive the native events every frame
+        /// </summary>
+        private UniWinCore.WindowEvent[] _events = new UniWinCore.WindowEvent[64];
+
+        /// <summary>
+        /// Paths of the drop being received
+        /// </summary>
+        private List<string> _droppedFiles = new List<string>();
+        private uint _dropId = 0;
+
+        /// <summary>
+        /// Paths of the last drop and their metadata being received
+        /// </summary>
+        private string[] _lastDroppedFiles = new string[0];
+        private List<UniWinCore.DropFileInfo> _dropFileInfos = new List<UniWinCore.DropFileInfo>();
+        private uint _dropInfoId = 0;
+
+        /// <summary>
+        /// Files found in the dropped folders being received
+        /// </summary>
+        private List<string> _expandedFiles = new List<string>();
+        private uint _expandedDropId = 0;
+        private FilePanel.Filter[] _dropExpansionFilters = null;
+        private int _dropExpansionDepth = 0;
+#endif
+
         /// <summary>
         /// Is this window receives mouse events
         /// </summary>
@@ -249,6 +277,24 @@ namespace Kirurobo
         /// </summary>
         [Tooltip("Will be used the next time the window becomes transparent")]
         public Color32 keyColor = new Color32(0x01, 0x00, 0x01, 0x00);
+
+        /// <summary>
+        /// Receive a large file drop little by little in Update() instead of all at once
+        /// </summary>
+        [Tooltip("Read dropped paths over several frames. *Only available on Windows")]
+        public bool streamDroppedFiles = false;
+
+        /// <summary>
+        /// Read the size, modification time and type of dropped files on worker threads, and raise OnDropFileInfo
+        /// </summary>
+        [Tooltip("Read metadata of dropped files in the background. *Only available on Windows")]
+        public bool readDropFileInfo = false;
+
+        /// <summary>
+        /// List the files in dropped folders recursively on worker threads, and raise OnDropFilesExpanded
+        /// </summary>
+        [Tooltip("Find files in dropped folders in the background. *Only available on Windows")]
+        public bool expandDroppedFolders = false;
         
         /// <summary>
         /// Is the mouse pointer on an opaque pixel or an object
@@ -298,6 +344,16 @@ namespace Kirurobo
             set { UniWinCore.SetCursorPosition(value); }
         }
 
+        /// <summary>
+        /// このフレーム開始時のウィンドウ位置、サイズ、状態、モニタ、カーソル座標
+        ///   毎フレーム1回でまとめて取得したもの。isChanged なら前フレームから何かが変化している
+        /// </summary>
+        public UniWinCore.WindowSnapshot windowSnapshot
+        {
+            get { return _snapshot; }
+        }
+        private UniWinCore.WindowSnapshot _snapshot;
+
         /// <summary>
         /// 初期状態でのウィンドウ位置、サイズ
         /// </summary>
@@ -335,12 +391,32 @@ namespace Kirurobo
         /// </summary>
         public event FilesDelegate OnDropFiles;
 
+        public delegate void FilesInfoDelegate(string[] files, UniWinCore.DropFileInfo[] infos);
+
+        /// <summary>
+        /// Occurs after the metadata of all dropped files has been read. Windows only, with readDropFileInfo
+        /// </summary>
+        public event FilesInfoDelegate OnDropFileInfo;
+
+        /// <summary>
+        /// Occurs after the files in the dropped folders have been listed. Windows only, with expandDroppedFolders
+        ///   Dropped files which match the filter are also included. The order is not defined.
+        /// </summary>
+        public event FilesDelegate OnDropFilesExpanded;
+
         /// <summary>
         /// Occurs when the monitor settings or resolution changed
         /// </summary>
         public event OnMonitorChangedDelegate OnMonitorChanged;
         public delegate void OnMonitorChangedDelegate();
 
+        /// <summary>
+        /// Occurs when a window tween has ended. Windows only
+        ///   completed is false if it was stopped or replaced before reaching the target.
+        /// </summary>
+        public event OnWindowTweenEndedDelegate OnWindowTweenEnded;
+        public delegate void OnWindowTweenEndedDelegate(uint id, bool completed);
+
 
         // Use this for initialization
         void Awake()
@@ -489,6 +565,9 @@ namespace Kirurobo
             {
                 _uniWinCore.Update();
             }
+
+            // ウィンドウの状態をまとめて取得
+            _uniWinCore?.GetWindowSnapshot(ref _snapshot);
             
             // Process events
             UpdateEvents();
@@ -509,6 +588,89 @@ namespace Kirurobo
                 OnDropFiles?.Invoke(droppedFiles);
             }
 
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            // 前フレームからのイベントを発生順にまとめて取り出す
+            //   連続するリサイズ等はネイティブ側でまとめられ、1フレームに1回まで
+            bool isStateChanged = false;
+            int count = _uniWinCore.PollEvents(_events);
+            for (int i = 0; i < count; i++)
+            {
+                switch ((UniWinCore.EventType)_events[i].type)
+                {
+                    case UniWinCore.EventType.MonitorChanged:
+                        OnMonitorChanged?.Invoke();
+                        break;
+
+                    case UniWinCore.EventType.DropBegin:
+                    case UniWinCore.EventType.DropChunk:
+                        // ストリーミング中は、取り出された分から受け取っておく
+                        _uniWinCore.ReadDroppedFiles(_droppedFiles, ref _dropId);
+                        break;
+
+                    case UniWinCore.EventType.FilesDropped:
+                        _uniWinCore.ReadDroppedFiles(_droppedFiles, ref _dropId);
+                        if (_droppedFiles.Count > 0)
+                        {
+                            _lastDroppedFiles = _droppedFiles.ToArray();
+                            OnDropFiles?.Invoke(_lastDroppedFiles);
+                        }
+                        _droppedFiles.Clear();
+                        break;
+
+                    case UniWinCore.EventType.DropInfoReady:
+                        // ドロップの順に届くので、全て揃ったら通知
+                        _uniWinCore.ReadDropFileInfo(_dropFileInfos, ref _dropInfoId);
+                        if (_dropInfoId == _dropId && _dropFileInfos.Count == _lastDroppedFiles.Length)
+                        {
+                            OnDropFileInfo?.Invoke(_lastDroppedFiles, _dropFileInfos.ToArray());
+                            _dropFileInfos.Clear();
+                        }
+                        break;
+
+                    case UniWinCore.EventType.DropExpandChunk:
+                        // フォルダを辿っている間も、見つかった分から受け取っておく
+                        _uniWinCore.ReadExpandedFiles(_expandedFiles, ref _expandedDropId);
+                        break;
+
+                    case UniWinCore.EventType.DropExpanded:
+                        _uniWinCore.ReadExpandedFiles(_expandedFiles, ref _expandedDropId);
+                        OnDropFilesExpanded?.Invoke(_expandedFiles.ToArray());
+                        _expandedFiles.Clear();
+                        break;
+
+                    case UniWinCore.EventType.WindowStateChanged:
+                        isStateChanged = true;
+                        OnStateChanged?.Invoke((WindowStateEventType)_events[i].param);
+                        break;
+
+                    case UniWinCore.EventType.PanelCompleted:
+                        FilePanel.CompleteRequest((uint)_events[i].param);
+                        break;
+
+                    case UniWinCore.EventType.TweenCompleted:
+                        OnWindowTweenEnded?.Invoke((uint)_events[i].param, true);
+                        break;
+
+                    case UniWinCore.EventType.TweenCancelled:
+                        OnWindowTweenEnded?.Invoke((uint)_events[i].param, false);
+                        break;
+
+                    case UniWinCore.EventType.Overflow:
+                        // 取りこぼしがあったため、状態が変わったものとして扱う
+                        isStateChanged = true;
+                        OnStateChanged?.Invoke(WindowStateEventType.StyleChanged | WindowStateEventType.Resized);
+                        FilePanel.CompleteClosedRequests();
+                        break;
+                }
+            }
+
+            if (isStateChanged && _shouldFitMonitor)
+            {
+                // 時間差で最大化を強制。イベント毎に増やさず、最後の変化から待ち直す
+                StopCoroutine("ForceZoomed");
+                StartCoroutine("ForceZoomed");
+            }
+#else
             if (_uniWinCore.ObserveMonitorChanged())
             {
                 OnMonitorChanged?.Invoke();
@@ -527,6 +689,7 @@ namespace Kirurobo
                 
                 OnStateChanged?.Invoke((WindowStateEventType)type);
             }
+#endif
         }
 
         IEnumerator ForceZoomed()
@@ -780,11 +943,16 @@ namespace Kirurobo
                 _uniWinCore.AttachMyWindow();
 
                 // ウィンドウを取得できたら最初の値を設定
+                //   まとめて反映し、ちらつきを抑える
                 if (_uniWinCore.IsActive)
                 {
+                    _uniWinCore.BeginWindowUpdate();
                     _uniWinCore.SetTransparentType((UniWinCore.TransparentType)transparentType);
                     _uniWinCore.SetKeyColor(keyColor);
                     _uniWinCore.SetAlphaValue(_alphaValue);
+                    _uniWinCore.EnableDropStreaming(streamDroppedFiles);
+                    _uniWinCore.EnableDropFileInfo(readDropFileInfo);
+                    _uniWinCore.EnableDropExpansion(expandDroppedFolders, _dropExpansionFilters, _dropExpansionDepth);
                     SetTransparent(_isTransparent);
                     if (_isBottommost)
                     {
@@ -797,6 +965,7 @@ namespace Kirurobo
                     SetZoomed(_isZoomed);
                     SetClickThrough(_isClickThrough);
                     SetAllowDrop(_allowDropFiles);
+                    _uniWinCore.CommitWindowUpdate();
 
                     // ウィンドウ取得時にはモニタ変更と同等の処理を行う
                     OnMonitorChanged?.Invoke();
@@ -886,10 +1055,12 @@ namespace Kirurobo
                 // 透過中だったなら、一度解除して再透過
                 if (_isTransparent)
                 {
+                    _uniWinCore.BeginWindowUpdate();
                     SetTransparent(false);
                     _uniWinCore.SetTransparentType((UniWinCore.TransparentType)type);
                     transparentType = type;
                     SetTransparent(true);
+                    _uniWinCore.CommitWindowUpdate();
                 }
                 else
                 {
@@ -956,6 +1127,20 @@ namespace Kirurobo
             _allowDropFiles = enabled;
         }
 
+        /// <summary>
+        /// Set the files listed from dropped folders (Windows only)
+        /// </summary>
+        /// <param name="filters">Same as the filters of FilePanel. null for all files</param>
+        /// <param name="maxDepth">Files directly in a dropped folder are at depth 1. 0 for the default</param>
+        public void SetDropExpansionFilter(FilePanel.Filter[] filters, int maxDepth = 0)
+        {
+            _dropExpansionFilters = filters;
+            _dropExpansionDepth = maxDepth;
+            if (_uniWinCore == null) return;
+
+            _uniWinCore.EnableDropExpansion(expandDroppedFolders, _dropExpansionFilters, _dropExpansionDepth);
+        }
+
 
         /// <summary>
         /// Get the number of connected monitors
@@ -1054,6 +1239,75 @@ namespace Kirurobo
             UniWinCore.SetCursorPosition(position);
         }
 
+        /// <summary>
+        /// Start moving the window natively with the mouse cursor until the button is released (Windows only)
+        ///   The window follows the cursor at input rate, independent of the frame rate.
+        /// </summary>
+        /// <param name="snapDistance">Snap the window to the monitor edges within this distance [px]. 0 to disable</param>
+        /// <returns>false if not supported, or the window is maximized</returns>
+        public bool BeginDragMove(int snapDistance = 0)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            if (_uniWinCore == null) return false;
+
+            _uniWinCore.SetDragMoveSnap(snapDistance > 0, snapDistance);
+            return _uniWinCore.BeginDragMove();
+#else
+            return false;
+#endif
+        }
+
+        /// <summary>
+        /// Stop moving the window started by BeginDragMove() (Windows only)
+        /// </summary>
+        public void EndDragMove()
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            if (_uniWinCore == null) return;
+
+            _uniWinCore.EndDragMove();
+#endif
+        }
+
+        /// <summary>
+        /// Animate the window position, size and alpha natively (Windows only)
+        ///   The tween is stepped inside the library, independent of the frame rate. OnWindowTweenEnded occurs at the end.
+        /// </summary>
+        /// <param name="flags">Properties to animate</param>
+        /// <param name="position">Target position, the same as windowPosition</param>
+        /// <param name="size">Target size, the same as windowSize</param>
+        /// <param name="alpha">Target alpha, the same as alphaValue</param>
+        /// <param name="duration">[s]</param>
+        /// <returns>ID of the tween, or 0 if not supported</returns>
+        public uint StartWindowTween(UniWinCore.WindowTweenFlag flags, Vector2 position, Vector2 size, float alpha, float duration, UniWinCore.EasingType easing = UniWinCore.EasingType.Linear)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            if (_uniWinCore == null) return 0;
+
+            uint id = _uniWinCore.StartWindowTween(flags, position, size, alpha, duration, easing);
+
+            // 透明度は最後の値を覚えておく
+            if (id != 0 && (flags & UniWinCore.WindowTweenFlag.Alpha) != 0)
+            {
+                _alphaValue = Mathf.Clamp01(alpha);
+            }
+            return id;
+#else
+            return 0;
+#endif
+        }
+
+        /// <summary>
+        /// Stop the window tween (Windows only)
+        /// </summary>
+        /// <param name="complete">true to jump to the target, false to stop where it is</param>
+        public void StopWindowTween(uint id, bool complete = false)
+        {
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            _uniWinCore?.StopWindowTween(id, complete);
+#endif
+        }
+
         /// <summary>
         /// 終了時にはウィンドウ状態を戻す処理が必要
         /// </summary>
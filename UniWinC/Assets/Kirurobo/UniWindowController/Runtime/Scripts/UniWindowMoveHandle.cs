@@ -26,6 +26,19 @@ namespace  Kirurobo
         [Tooltip("Disable drag-move when the window is zoomed (maximized).")]
         public bool disableOnZoomed = true;
 
+        /// <summary>
+        /// ネイティブ側でカーソルに追従させるか（Windowsのみ）
+        ///   フレームレートに関係なく、入力の度にウィンドウが移動する
+        /// </summary>
+        [Tooltip("Move the window natively at input rate, independent of the frame rate. Windows only.")]
+        public bool useNativeDragMove = true;
+
+        /// <summary>
+        /// ネイティブでの移動中、モニタの端からこの距離以内なら吸着させる [px]。0なら吸着しない
+        /// </summary>
+        [Tooltip("Snap the window to the monitor edges within this distance [px] while moving natively. 0 to disable.")]
+        public int snapDistance = 0;
+
         /// <summary>
         /// ドラッグ中なら true
         /// </summary>
@@ -35,6 +48,11 @@ namespace  Kirurobo
         }
         private bool _isDragging = false;
 
+        /// <summary>
+        /// ネイティブ側でウィンドウを移動中なら true
+        /// </summary>
+        private bool _isNativeDragging = false;
+
         /// <summary>
         /// ドラッグを行なうか否か
         /// </summary>
@@ -101,6 +119,15 @@ namespace  Kirurobo
             }
             
             _isDragging = true;
+
+#if UNITY_EDITOR_WIN || UNITY_STANDALONE_WIN
+            // 以後の移動はネイティブ側に任せる。修飾キーが押されていれば移動しない
+            if (useNativeDragMove && !_isNativeDragging
+                && eventData.button == PointerEventData.InputButton.Left && !IsModifierPressed())
+            {
+                _isNativeDragging = _uniwinc.BeginDragMove(snapDistance);
+            }
+#endif
         }
 
         /// <summary>
@@ -125,6 +152,11 @@ namespace  Kirurobo
         /// </summary>
         private void EndDragging()
         {
+            if (_isNativeDragging)
+            {
+                _uniwinc.EndDragMove();
+                _isNativeDragging = false;
+            }
             if (_isDragging)
             {
                 _uniwinc.isHitTestEnabled = _isHitTestEnabled; 
@@ -146,17 +178,14 @@ namespace  Kirurobo
                 return;
             }
 
+            // ネイティブ側で移動中なら何もしない
+            if (_isNativeDragging) return;
+
             // Move the window when the left mouse button is pressed
             if (eventData.button != PointerEventData.InputButton.Left) return;
 
             // Return if any modifier key is pressed
-#if ENABLE_INPUT_SYSTEM
-            if (Keyboard.current[Key.LeftShift].isPressed || Keyboard.current[Key.RightShift].isPressed || Keyboard.current[Key.LeftCtrl].isPressed || Keyboard.current[Key.RightCtrl].isPressed || Keyboard.current[Key.LeftAlt].isPressed || Keyboard.current[Key.RightAlt].isPressed) return;
-#elif ENABLE_LEGACY_INPUT_MANAGER
-            if (Input.GetKey(KeyCode.LeftShift) || Input.GetKey(KeyCode.RightShift)
-                || Input.GetKey(KeyCode.LeftCtrl) || Input.GetKey(KeyCode.RightCtrl)
-                || Input.GetKey(KeyCode.LeftAlt) || Input.GetKey(KeyCode.RightAlt)) return;
-#endif
+            if (IsModifierPressed()) return;
 
             // フルスクリーンならウィンドウ移動は行わない
             //  エディタだと true になってしまうようなので、エディタ以外でのみ確認
@@ -175,6 +204,22 @@ namespace  Kirurobo
             // Windowsなら、タッチ操作も対応させるために eventData.position を使用する
             // スクリーンポジションが開始時の位置と一致させる分だけウィンドウを移動
             _uniwinc.windowPosition += eventData.position - _dragStartedPosition;
+#endif
+        }
+
+        /// <summary>
+        /// Shift, Ctrl, Alt のいずれかが押されているか
+        /// </summary>
+        private bool IsModifierPressed()
+        {
+#if ENABLE_INPUT_SYSTEM
+            return (Keyboard.current[Key.LeftShift].isPressed || Keyboard.current[Key.RightShift].isPressed || Keyboard.current[Key.LeftCtrl].isPressed || Keyboard.current[Key.RightCtrl].isPressed || Keyboard.current[Key.LeftAlt].isPressed || Keyboard.current[Key.RightAlt].isPressed);
+#elif ENABLE_LEGACY_INPUT_MANAGER
+            return (Input.GetKey(KeyCode.LeftShift) || Input.GetKey(KeyCode.RightShift)
+                || Input.GetKey(KeyCode.LeftCtrl) || Input.GetKey(KeyCode.RightCtrl)
+                || Input.GetKey(KeyCode.LeftAlt) || Input.GetKey(KeyCode.RightAlt));
+#else
+            return false;
 #endif
         }
     }
@@ -0,0 +1,136 @@
+﻿#pragma once
+
+#include <chrono>
+#include <vector>
+
+// Interface between the exported functions and the window system.
+//
+//   libuniwinc.cpp does not call the window system directly, but through this interface.
+//   The methods follow the Win32 functions which the library originally used,
+//   so that the Win32 backend is a thin wrapper and the other backends emulate their behavior.
+//
+//   - backend_win32.cpp   : Win32 (default on Windows)
+//   - backend_x11.cpp     : X11 via XCB (default on Linux unless UNIWINC_HEADLESS is defined)
+//   - backend_virtual.cpp : Deterministic in-memory virtual desktop for tests and benchmarks
+//   - backend_batch.cpp   : Wraps another backend to apply the changes between BeginWindowUpdate() and CommitWindowUpdate() at once
+class WindowBackend {
+public:
+	virtual ~WindowBackend() {}
+
+	// Process and window lookup
+	virtual DWORD getCurrentProcessId() = 0;
+	virtual BOOL enumWindows(WNDENUMPROC lpEnumFunc, LPARAM lParam) = 0;
+	virtual DWORD getWindowProcessId(HWND hWnd) = 0;
+	virtual HWND getOwnerWindow(HWND hWnd) = 0;
+	virtual HWND getActiveWindow() = 0;
+	virtual HWND findDesktopWindow() = 0;
+	virtual HWND setParent(HWND hWnd, HWND hParent) = 0;
+
+	// Top-level windows created by the thread, in the same order as enumWindows().
+	// Lets the library find its own window without looking at the windows of the other processes.
+	// Backends which do not know the threads return 0 from getCurrentThreadId(), then only enumWindows() is used.
+	virtual DWORD getCurrentThreadId() { return 0; }
+	virtual DWORD getWindowThreadId(HWND /*hWnd*/) { return 0; }
+	virtual BOOL enumThreadWindows(DWORD /*dwThreadId*/, WNDENUMPROC /*lpEnumFunc*/, LPARAM /*lParam*/) { return FALSE; }
+
+	// Window state
+	virtual BOOL isWindow(HWND hWnd) = 0;
+	virtual BOOL isZoomed(HWND hWnd) = 0;
+	virtual BOOL isIconic(HWND hWnd) = 0;
+	virtual BOOL isWindowVisible(HWND hWnd) = 0;
+	virtual BOOL showWindow(HWND hWnd, INT nCmdShow) = 0;
+	virtual LONG getWindowLong(HWND hWnd, INT nIndex) = 0;
+	virtual LONG setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) = 0;
+	virtual BOOL getWindowInfo(HWND hWnd, WINDOWINFO* pwi) = 0;
+	virtual BOOL getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) = 0;
+	virtual BOOL setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) = 0;
+	virtual BOOL hasMenu(HWND hWnd) = 0;
+
+	// Window geometry
+	virtual BOOL getWindowRect(HWND hWnd, RECT* lpRect) = 0;
+	virtual BOOL getClientRect(HWND hWnd, RECT* lpRect) = 0;
+	virtual BOOL setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) = 0;
+	virtual BOOL adjustWindowRect(RECT* lpRect, DWORD dwStyle, BOOL bMenu) = 0;
+	virtual BOOL screenToClient(HWND hWnd, POINT* lpPoint) = 0;
+
+	// Transparency
+	virtual BOOL setLayeredWindowAttributes(HWND hWnd, COLORREF crKey, BYTE bAlpha, DWORD dwFlags) = 0;
+	virtual BOOL extendFrameIntoClientArea(HWND hWnd, BOOL bEntireWindow) = 0;
+
+	// Input region. lpRects are in client coordinates. NULL restores the whole window
+	virtual BOOL setInputRegion(HWND hWnd, const RECT* lpRects, UINT count) = 0;
+
+	// Monitors
+	virtual BOOL enumDisplayMonitors(MONITORENUMPROC lpfnEnum, LPARAM dwData) = 0;
+
+	// Mouse cursor
+	//   getCursorPos() may be called on any thread, like GetCursorPos() on Windows
+	virtual BOOL getCursorPos(POINT* lpPoint) = 0;
+	virtual BOOL setCursorPos(INT x, INT y) = 0;
+	// Whether the primary (usually left) mouse button is held now, regardless of the messages
+	virtual BOOL isPrimaryButtonDown() = 0;
+
+	// File drop
+	virtual void dragAcceptFiles(HWND hWnd, BOOL fAccept) = 0;
+	virtual UINT dragQueryFile(HDROP hDrop, UINT iFile, LPWSTR lpszFile, UINT cch) = 0;
+	virtual void dragFinish(HDROP hDrop) = 0;
+
+	// Window procedure
+	virtual WNDPROC setWindowProcedure(HWND hWnd, WNDPROC lpWndProc) = 0;
+	virtual LRESULT callWindowProc(WNDPROC lpPrevWndFunc, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) = 0;
+	virtual LRESULT defWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) = 0;
+
+	// Timers. WM_TIMER is sent to the window procedure with the ID as wParam
+	virtual BOOL setTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse) = 0;
+	virtual BOOL killTimer(HWND hWnd, UINT_PTR nIDEvent) = 0;
+
+	// File dialogs
+	virtual BOOL getOpenFileName(OPENFILENAMEW* lpofn) = 0;
+	virtual BOOL getSaveFileName(OPENFILENAMEW* lpofn) = 0;
+
+	// Close the dialog shown by getOpenFileName() or getSaveFileName() on another thread, as if it was cancelled.
+	// Returns FALSE if the dialog is not shown (yet) or the backend cannot close it.
+	virtual BOOL closeFileDialog(const OPENFILENAMEW* /*lpofn*/) { return FALSE; }
+
+	// Why the last file dialog on this thread returned FALSE, like CommDlgExtendedError(). 0 if it was cancelled.
+	// FNERR_BUFFERTOOSMALL means the selection did not fit in lpofn->nMaxFile.
+	virtual DWORD getFileDialogError() { return 0; }
+
+	// Show a file dialog whose result may not fit in lpofn->nMaxFile. lpofn->lpstrFile points to buffer.
+	// Backends which know the length of the result resize buffer and update lpofn. The default is limited to the buffer.
+	virtual BOOL getFileNames(OPENFILENAMEW* lpofn, const BOOL bSave, std::vector<WCHAR>& /*buffer*/) {
+		return (bSave ? getSaveFileName(lpofn) : getOpenFileName(lpofn));
+	}
+
+	// Posted messages. Unlike the other methods, postMessage() may be called on any thread.
+	// The message is delivered later to the window procedure on the thread of the window.
+	// Returns FALSE if the backend cannot post, then the library waits for Update() instead.
+	virtual BOOL postMessage(HWND /*hWnd*/, UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/) { return FALSE; }
+	// Message ID unique to the name, like RegisterWindowMessage(). 0 if not supported
+	virtual UINT registerWindowMessage(LPCWSTR /*lpString*/) { return 0; }
+
+	// Called from Update(). Backends which have to pump the window system events do it here.
+	virtual void update() {}
+
+	// Monotonic clock for the animations [us]. Backends with their own clock override it
+	virtual INT64 getMonotonicTime() {
+		return (INT64)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+};
+
+
+/// <summary>
+/// The default backend for the current platform
+/// </summary>
+WindowBackend* getDefaultBackend();
+
+/// <summary>
+/// The backend currently used by the exported functions
+/// </summary>
+WindowBackend* getBackend();
+
+/// <summary>
+/// Replace the backend. The attached window is detached before switching.
+///   nullptr restores the default backend.
+/// </summary>
+void setBackend(WindowBackend* pBackend);
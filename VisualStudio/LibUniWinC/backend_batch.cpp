@@ -0,0 +1,340 @@
+﻿// backend_batch.cpp : Backend which collects the changes of a window and applies them at once
+
+#include "pch.h"
+#include "backend_batch.h"
+
+
+BatchBackend::BatchBackend() : pInner_(nullptr), hWnd_(NULL), bFetched_(FALSE),
+	current_(), desired_(), bZOrder_(FALSE), hWndInsertAfter_(NULL),
+	bLayered_(FALSE), crKey_(0), bAlpha_(0xFF), dwLayeredFlags_(0) {
+}
+
+void BatchBackend::begin(WindowBackend* pInner, HWND hWnd) {
+	pInner_ = pInner;
+	hWnd_ = hWnd;
+	bFetched_ = FALSE;
+}
+
+void BatchBackend::setTarget(HWND hWnd) {
+	if (hWnd == hWnd_) return;
+
+	flush();
+	hWnd_ = hWnd;
+}
+
+BOOL BatchBackend::commit() {
+	if (!pInner_) return FALSE;
+
+	BOOL result = flush();
+	pInner_ = nullptr;
+	hWnd_ = NULL;
+	return result;
+}
+
+/// <summary>
+/// Read the current state of the target when it is accessed first
+/// </summary>
+void BatchBackend::fetch() {
+	if (bFetched_) return;
+
+	current_.style = pInner_->getWindowLong(hWnd_, GWL_STYLE);
+	current_.exStyle = pInner_->getWindowLong(hWnd_, GWL_EXSTYLE);
+	pInner_->getWindowRect(hWnd_, &current_.rect);
+	current_.bVisible = pInner_->isWindowVisible(hWnd_);
+	if (pInner_->isIconic(hWnd_)) {
+		current_.state = ShowState::Minimized;
+	}
+	else if (pInner_->isZoomed(hWnd_)) {
+		current_.state = ShowState::Maximized;
+	}
+	else {
+		current_.state = ShowState::Normal;
+	}
+
+	desired_ = current_;
+	bZOrder_ = FALSE;
+	hWndInsertAfter_ = NULL;
+	bLayered_ = FALSE;
+	bFetched_ = TRUE;
+}
+
+/// <summary>
+/// Apply the difference between the recorded state and the state which was read
+/// </summary>
+BOOL BatchBackend::flush() {
+	if (!bFetched_) return TRUE;
+	bFetched_ = FALSE;
+
+	if (!pInner_->isWindow(hWnd_)) return FALSE;
+
+	BOOL result = TRUE;
+	const BOOL bStyleChanged = (desired_.style != current_.style);
+	const BOOL bExStyleChanged = ((desired_.exStyle & ~WS_EX_TOPMOST) != (current_.exStyle & ~WS_EX_TOPMOST));
+
+	// 最大化中に枠が変わる場合は、一度通常表示に戻して最大化し直さないと大きさが合わない
+	const BOOL bRemaximize = (bStyleChanged && current_.state == ShowState::Maximized && desired_.state == ShowState::Maximized);
+	BOOL bVisible = current_.bVisible;
+
+	// 通常表示に戻すのは位置の変更より先。後だと元の位置に戻ってしまう
+	if (bRemaximize || (desired_.state == ShowState::Normal && current_.state != ShowState::Normal)) {
+		pInner_->showWindow(hWnd_, SW_NORMAL);
+		bVisible = TRUE;
+	}
+
+	// Styles. WS_EX_TOPMOST is changed by the z-order
+	if (bStyleChanged) {
+		pInner_->setWindowLong(hWnd_, GWL_STYLE, desired_.style);
+	}
+	if (bExStyleChanged) {
+		pInner_->setWindowLong(hWnd_, GWL_EXSTYLE, desired_.exStyle);
+	}
+
+	// WS_EX_LAYERED must have been set before
+	if (bLayered_) {
+		if (!pInner_->setLayeredWindowAttributes(hWnd_, crKey_, bAlpha_, dwLayeredFlags_)) result = FALSE;
+	}
+
+	// Geometry, z-order, frame and visibility with one SetWindowPos()
+	const RECT& rc = desired_.rect;
+	const BOOL bMove = (rc.left != current_.rect.left || rc.top != current_.rect.top);
+	const BOOL bSize = ((rc.right - rc.left) != (current_.rect.right - current_.rect.left)
+		|| (rc.bottom - rc.top) != (current_.rect.bottom - current_.rect.top));
+
+	// 既にその状態であれば、最前面の設定・解除は不要
+	BOOL bZOrder = bZOrder_;
+	if (hWndInsertAfter_ == HWND_TOPMOST && (current_.exStyle & WS_EX_TOPMOST)) bZOrder = FALSE;
+	if (hWndInsertAfter_ == HWND_NOTOPMOST && !(current_.exStyle & WS_EX_TOPMOST)) bZOrder = FALSE;
+
+	const BOOL bShowCommand = (bRemaximize || (desired_.state != ShowState::Normal && desired_.state != current_.state));
+
+	UINT flags = SWP_NOOWNERZORDER | SWP_NOACTIVATE;
+	if (!bMove) flags |= SWP_NOMOVE;
+	if (!bSize) flags |= SWP_NOSIZE;
+	if (!bZOrder) flags |= SWP_NOZORDER;
+	// 枠の再計算はスタイルを書き換えた時だけ。同じスタイルを設定し直しただけなら SetWindowPos() も不要
+	if (bStyleChanged || bExStyleChanged) flags |= SWP_FRAMECHANGED;
+	if (!bShowCommand && desired_.bVisible != bVisible) flags |= (desired_.bVisible ? SWP_SHOWWINDOW : SWP_HIDEWINDOW);
+
+	if (bMove || bSize || bZOrder || (flags & (SWP_FRAMECHANGED | SWP_SHOWWINDOW | SWP_HIDEWINDOW))) {
+		if (!pInner_->setWindowPos(hWnd_, hWndInsertAfter_, rc.left, rc.top, (rc.right - rc.left), (rc.bottom - rc.top), flags)) result = FALSE;
+	}
+
+	// 最大化・最小化は位置の変更の後。変更した位置は元に戻す際の位置となる
+	if (bShowCommand) {
+		pInner_->showWindow(hWnd_, (desired_.state == ShowState::Maximized ? SW_MAXIMIZE : SW_MINIMIZE));
+		if (!desired_.bVisible) {
+			pInner_->showWindow(hWnd_, SW_HIDE);
+		}
+	}
+
+	return result;
+}
+
+/// <summary>
+/// Client area calculated from the recorded style and window size
+/// </summary>
+void BatchBackend::calculateClientRect(RECT* lpRect) {
+	RECT frame = { 0, 0, 0, 0 };
+	pInner_->adjustWindowRect(&frame, (DWORD)desired_.style, pInner_->hasMenu(hWnd_));
+
+	LONG width = (desired_.rect.right - desired_.rect.left) - (frame.right - frame.left);
+	LONG height = (desired_.rect.bottom - desired_.rect.top) - (frame.bottom - frame.top);
+	lpRect->left = 0;
+	lpRect->top = 0;
+	lpRect->right = (width > 0 ? width : 0);
+	lpRect->bottom = (height > 0 ? height : 0);
+}
+
+
+#pragma region Recorded calls
+
+BOOL BatchBackend::isZoomed(HWND hWnd) {
+	if (!isTarget(hWnd)) return pInner_->isZoomed(hWnd);
+
+	fetch();
+	return (desired_.state == ShowState::Maximized);
+}
+
+BOOL BatchBackend::isIconic(HWND hWnd) {
+	if (!isTarget(hWnd)) return pInner_->isIconic(hWnd);
+
+	fetch();
+	return (desired_.state == ShowState::Minimized);
+}
+
+BOOL BatchBackend::isWindowVisible(HWND hWnd) {
+	if (!isTarget(hWnd)) return pInner_->isWindowVisible(hWnd);
+
+	fetch();
+	return desired_.bVisible;
+}
+
+BOOL BatchBackend::showWindow(HWND hWnd, INT nCmdShow) {
+	if (!isTarget(hWnd)) return pInner_->showWindow(hWnd, nCmdShow);
+
+	fetch();
+	BOOL bWasVisible = desired_.bVisible;
+
+	switch (nCmdShow) {
+	case SW_HIDE:
+		desired_.bVisible = FALSE;
+		break;
+
+	case SW_SHOW:
+		desired_.bVisible = TRUE;
+		break;
+
+	case SW_MAXIMIZE:
+		desired_.bVisible = TRUE;
+		desired_.state = ShowState::Maximized;
+		break;
+
+	case SW_MINIMIZE:
+		desired_.state = ShowState::Minimized;
+		break;
+
+	case SW_NORMAL:
+	case SW_RESTORE:
+		desired_.bVisible = TRUE;
+		desired_.state = ShowState::Normal;
+		break;
+
+	default:
+		// 記録できないものは、それまでの変更を反映してからそのまま実行
+		flush();
+		return pInner_->showWindow(hWnd, nCmdShow);
+	}
+
+	return bWasVisible;
+}
+
+LONG BatchBackend::getWindowLong(HWND hWnd, INT nIndex) {
+	if (!isTarget(hWnd) || (nIndex != GWL_STYLE && nIndex != GWL_EXSTYLE)) return pInner_->getWindowLong(hWnd, nIndex);
+
+	fetch();
+	return (nIndex == GWL_STYLE ? desired_.style : desired_.exStyle);
+}
+
+LONG BatchBackend::setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) {
+	if (!isTarget(hWnd) || (nIndex != GWL_STYLE && nIndex != GWL_EXSTYLE)) return pInner_->setWindowLong(hWnd, nIndex, dwNewLong);
+
+	fetch();
+	LONG previous;
+	if (nIndex == GWL_STYLE) {
+		previous = desired_.style;
+		desired_.style = dwNewLong;
+	}
+	else {
+		// WS_EX_TOPMOST can not be changed by SetWindowLong()
+		previous = desired_.exStyle;
+		desired_.exStyle = (dwNewLong & ~WS_EX_TOPMOST) | (desired_.exStyle & WS_EX_TOPMOST);
+	}
+	return previous;
+}
+
+BOOL BatchBackend::getWindowRect(HWND hWnd, RECT* lpRect) {
+	if (!isTarget(hWnd) || !lpRect) return pInner_->getWindowRect(hWnd, lpRect);
+
+	fetch();
+	*lpRect = desired_.rect;
+	return TRUE;
+}
+
+BOOL BatchBackend::getClientRect(HWND hWnd, RECT* lpRect) {
+	if (!isTarget(hWnd) || !lpRect) return pInner_->getClientRect(hWnd, lpRect);
+
+	fetch();
+
+	// 通常表示のまま枠か大きさが変わる場合のみ計算する
+	const BOOL bChanged = (desired_.style != current_.style
+		|| (desired_.rect.right - desired_.rect.left) != (current_.rect.right - current_.rect.left)
+		|| (desired_.rect.bottom - desired_.rect.top) != (current_.rect.bottom - current_.rect.top));
+	if (!bChanged || desired_.state != ShowState::Normal || current_.state != ShowState::Normal) {
+		return pInner_->getClientRect(hWnd, lpRect);
+	}
+
+	calculateClientRect(lpRect);
+	return TRUE;
+}
+
+BOOL BatchBackend::setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) {
+	if (!isTarget(hWnd)) return pInner_->setWindowPos(hWnd, hWndInsertAfter, x, y, cx, cy, uFlags);
+
+	fetch();
+	RECT& rc = desired_.rect;
+
+	if (!(uFlags & SWP_NOZORDER)) {
+		bZOrder_ = TRUE;
+		hWndInsertAfter_ = hWndInsertAfter;
+		if (hWndInsertAfter == HWND_TOPMOST) {
+			desired_.exStyle |= WS_EX_TOPMOST;
+		}
+		else if (hWndInsertAfter == HWND_NOTOPMOST || hWndInsertAfter == HWND_BOTTOM) {
+			desired_.exStyle &= ~WS_EX_TOPMOST;
+		}
+	}
+	if (!(uFlags & SWP_NOMOVE)) {
+		rc.right += x - rc.left;
+		rc.bottom += y - rc.top;
+		rc.left = x;
+		rc.top = y;
+	}
+	if (!(uFlags & SWP_NOSIZE)) {
+		rc.right = rc.left + cx;
+		rc.bottom = rc.top + cy;
+	}
+	// SWP_FRAMECHANGED is added by flush() only if a style has been changed
+	if (uFlags & SWP_SHOWWINDOW) desired_.bVisible = TRUE;
+	if (uFlags & SWP_HIDEWINDOW) desired_.bVisible = FALSE;
+
+	return TRUE;
+}
+
+BOOL BatchBackend::setLayeredWindowAttributes(HWND hWnd, COLORREF crKey, BYTE bAlpha, DWORD dwFlags) {
+	if (!isTarget(hWnd)) return pInner_->setLayeredWindowAttributes(hWnd, crKey, bAlpha, dwFlags);
+
+	fetch();
+	bLayered_ = TRUE;
+	crKey_ = crKey;
+	bAlpha_ = bAlpha;
+	dwLayeredFlags_ = dwFlags;
+	return TRUE;
+}
+
+#pragma endregion Recorded calls
+
+
+#pragma region Calls applied after the recorded changes
+
+HWND BatchBackend::setParent(HWND hWnd, HWND hParent) {
+	if (isTarget(hWnd)) flush();
+	return pInner_->setParent(hWnd, hParent);
+}
+
+BOOL BatchBackend::getWindowInfo(HWND hWnd, WINDOWINFO* pwi) {
+	if (isTarget(hWnd)) flush();
+	return pInner_->getWindowInfo(hWnd, pwi);
+}
+
+BOOL BatchBackend::getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) {
+	if (isTarget(hWnd)) flush();
+	return pInner_->getWindowPlacement(hWnd, lpwndpl);
+}
+
+BOOL BatchBackend::setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) {
+	if (isTarget(hWnd)) flush();
+	return pInner_->setWindowPlacement(hWnd, lpwndpl);
+}
+
+BOOL BatchBackend::screenToClient(HWND hWnd, POINT* lpPoint) {
+	if (isTarget(hWnd)) flush();
+	return pInner_->screenToClient(hWnd, lpPoint);
+}
+
+void BatchBackend::dragAcceptFiles(HWND hWnd, BOOL fAccept) {
+	// DragAcceptFiles() changes WS_EX_ACCEPTFILES
+	if (isTarget(hWnd)) flush();
+	pInner_->dragAcceptFiles(hWnd, fAccept);
+}
+
+#pragma endregion Calls applied after the recorded changes
@@ -0,0 +1,134 @@
+﻿#pragma once
+
+#include "backend.h"
+
+/// <summary>
+/// Backend which collects the changes of one window and applies them at once.
+///   Between begin() and commit(), style writes, SetWindowPos(), ShowWindow() and the layered attributes
+///   of the target window are only recorded, and the queries return the recorded state.
+///   commit() compares them with the state read at the first access, and applies only the difference
+///   with at most one write per style, one SetWindowPos() and one ShowWindow().
+///   The other windows and the other calls go to the wrapped backend as they are.
+///   Not thread safe. Use it from the thread which owns the window.
+/// </summary>
+class BatchBackend : public WindowBackend {
+public:
+	BatchBackend();
+
+	/// <summary>
+	/// Start collecting the changes of the window
+	/// </summary>
+	void begin(WindowBackend* pInner, HWND hWnd);
+
+	/// <summary>
+	/// Change the target. The changes of the previous target are applied
+	/// </summary>
+	void setTarget(HWND hWnd);
+
+	/// <summary>
+	/// Apply the changes and stop collecting
+	/// </summary>
+	BOOL commit();
+
+	BOOL isActive() const { return (pInner_ != nullptr); }
+	WindowBackend* getInner() const { return pInner_; }
+
+	// ---- WindowBackend ----
+
+	DWORD getCurrentProcessId() override { return pInner_->getCurrentProcessId(); }
+	BOOL enumWindows(WNDENUMPROC lpEnumFunc, LPARAM lParam) override { return pInner_->enumWindows(lpEnumFunc, lParam); }
+	DWORD getWindowProcessId(HWND hWnd) override { return pInner_->getWindowProcessId(hWnd); }
+	HWND getOwnerWindow(HWND hWnd) override { return pInner_->getOwnerWindow(hWnd); }
+	DWORD getCurrentThreadId() override { return pInner_->getCurrentThreadId(); }
+	DWORD getWindowThreadId(HWND hWnd) override { return pInner_->getWindowThreadId(hWnd); }
+	BOOL enumThreadWindows(DWORD dwThreadId, WNDENUMPROC lpEnumFunc, LPARAM lParam) override { return pInner_->enumThreadWindows(dwThreadId, lpEnumFunc, lParam); }
+	HWND getActiveWindow() override { return pInner_->getActiveWindow(); }
+	HWND findDesktopWindow() override { return pInner_->findDesktopWindow(); }
+	HWND setParent(HWND hWnd, HWND hParent) override;
+
+	BOOL isWindow(HWND hWnd) override { return pInner_->isWindow(hWnd); }
+	BOOL isZoomed(HWND hWnd) override;
+	BOOL isIconic(HWND hWnd) override;
+	BOOL isWindowVisible(HWND hWnd) override;
+	BOOL showWindow(HWND hWnd, INT nCmdShow) override;
+	LONG getWindowLong(HWND hWnd, INT nIndex) override;
+	LONG setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) override;
+	BOOL getWindowInfo(HWND hWnd, WINDOWINFO* pwi) override;
+	BOOL getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) override;
+	BOOL setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) override;
+	BOOL hasMenu(HWND hWnd) override { return pInner_->hasMenu(hWnd); }
+
+	BOOL getWindowRect(HWND hWnd, RECT* lpRect) override;
+	BOOL getClientRect(HWND hWnd, RECT* lpRect) override;
+	BOOL setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) override;
+	BOOL adjustWindowRect(RECT* lpRect, DWORD dwStyle, BOOL bMenu) override { return pInner_->adjustWindowRect(lpRect, dwStyle, bMenu); }
+	BOOL screenToClient(HWND hWnd, POINT* lpPoint) override;
+
+	BOOL setLayeredWindowAttributes(HWND hWnd, COLORREF crKey, BYTE bAlpha, DWORD dwFlags) override;
+	BOOL extendFrameIntoClientArea(HWND hWnd, BOOL bEntireWindow) override { return pInner_->extendFrameIntoClientArea(hWnd, bEntireWindow); }
+	BOOL setInputRegion(HWND hWnd, const RECT* lpRects, UINT count) override { return pInner_->setInputRegion(hWnd, lpRects, count); }
+
+	BOOL enumDisplayMonitors(MONITORENUMPROC lpfnEnum, LPARAM dwData) override { return pInner_->enumDisplayMonitors(lpfnEnum, dwData); }
+
+	BOOL getCursorPos(POINT* lpPoint) override { return pInner_->getCursorPos(lpPoint); }
+	BOOL setCursorPos(INT x, INT y) override { return pInner_->setCursorPos(x, y); }
+	BOOL isPrimaryButtonDown() override { return pInner_->isPrimaryButtonDown(); }
+
+	void dragAcceptFiles(HWND hWnd, BOOL fAccept) override;
+	UINT dragQueryFile(HDROP hDrop, UINT iFile, LPWSTR lpszFile, UINT cch) override { return pInner_->dragQueryFile(hDrop, iFile, lpszFile, cch); }
+	void dragFinish(HDROP hDrop) override { pInner_->dragFinish(hDrop); }
+
+	WNDPROC setWindowProcedure(HWND hWnd, WNDPROC lpWndProc) override { return pInner_->setWindowProcedure(hWnd, lpWndProc); }
+	LRESULT callWindowProc(WNDPROC lpPrevWndFunc, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override { return pInner_->callWindowProc(lpPrevWndFunc, hWnd, uMsg, wParam, lParam); }
+	LRESULT defWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override { return pInner_->defWindowProc(hWnd, uMsg, wParam, lParam); }
+
+	BOOL setTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse) override { return pInner_->setTimer(hWnd, nIDEvent, uElapse); }
+	BOOL killTimer(HWND hWnd, UINT_PTR nIDEvent) override { return pInner_->killTimer(hWnd, nIDEvent); }
+
+	BOOL postMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override { return pInner_->postMessage(hWnd, uMsg, wParam, lParam); }
+	UINT registerWindowMessage(LPCWSTR lpString) override { return pInner_->registerWindowMessage(lpString); }
+
+	BOOL getOpenFileName(OPENFILENAMEW* lpofn) override { return pInner_->getOpenFileName(lpofn); }
+	BOOL getSaveFileName(OPENFILENAMEW* lpofn) override { return pInner_->getSaveFileName(lpofn); }
+	BOOL closeFileDialog(const OPENFILENAMEW* lpofn) override { return pInner_->closeFileDialog(lpofn); }
+	BOOL getFileNames(OPENFILENAMEW* lpofn, const BOOL bSave, std::vector<WCHAR>& buffer) override { return pInner_->getFileNames(lpofn, bSave, buffer); }
+
+	void update() override { pInner_->update(); }
+	INT64 getMonotonicTime() override { return pInner_->getMonotonicTime(); }
+
+private:
+	enum class ShowState : int {
+		Normal = 0,
+		Maximized = 1,
+		Minimized = 2,
+	};
+
+	/// <summary>
+	/// State of the window
+	/// </summary>
+	struct WindowState {
+		LONG style;
+		LONG exStyle;
+		RECT rect;
+		BOOL bVisible;
+		ShowState state;
+	};
+
+	WindowBackend* pInner_;
+	HWND hWnd_;
+	BOOL bFetched_;				// current_ has been read from the window
+
+	WindowState current_;		// State when the window was read
+	WindowState desired_;		// State after the recorded changes
+	BOOL bZOrder_;
+	HWND hWndInsertAfter_;
+	BOOL bLayered_;
+	COLORREF crKey_;
+	BYTE bAlpha_;
+	DWORD dwLayeredFlags_;
+
+	BOOL isTarget(HWND hWnd) const { return (hWnd != NULL && hWnd == hWnd_); }
+	void fetch();
+	BOOL flush();
+	void calculateClientRect(RECT* lpRect);
+};
@@ -0,0 +1,1033 @@
+﻿// backend_virtual.cpp : In-memory virtual desktop implementation of WindowBackend
+
+#include "pch.h"
+#include "libuniwinc.h"
+#include "backend_virtual.h"
+#include <algorithm>
+#include <chrono>
+
+// 最小化されたウィンドウの位置（Windowsと同じ）
+static const LONG MINIMIZED_POSITION = -32000;
+
+// CommDlgExtendedError() 相当。ダイアログは複数のスレッドで開かれるため、スレッドごとに持つ
+static thread_local DWORD fileDialogError_ = 0;
+
+
+VirtualBackend::VirtualBackend() {
+	reset();
+}
+
+VirtualBackend::~VirtualBackend() {
+}
+
+/// <summary>
+/// Remove all windows, monitors and counters
+/// </summary>
+void VirtualBackend::reset() {
+	processId_ = 1000;
+	threadId_ = 2000;
+	nextHandle_ = 0x1000;
+	hActiveWnd_ = NULL;
+	hDesktopWnd_ = NULL;
+	cursor_.store({ 0, 0 });
+	bPrimaryButton_ = FALSE;
+	bFrameChangeDeferred_ = FALSE;
+	time_ = 0;
+	timers_.clear();
+	windows_.clear();
+	zOrder_.clear();
+	monitors_.clear();
+	fileDialogHandler_ = nullptr;
+	fileDialogDelay_ = 0;
+	resetCallCounts();
+	{
+		std::lock_guard<std::mutex> lock(postMutex_);
+		posted_.clear();
+	}
+
+	// A full HD primary monitor by default
+	addMonitor({ 0, 0, 1920, 1080 });
+}
+
+VirtualBackend::CallCounts VirtualBackend::getCallCounts() const {
+	CallCounts counts = counts_;
+	counts.getCursorPos = cursorQueries_.load(std::memory_order_relaxed);
+	return counts;
+}
+
+void VirtualBackend::resetCallCounts() {
+	counts_ = CallCounts();
+	cursorQueries_.store(0, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Create a top-level window
+///   The windows of the current process belong to the current thread, the others to no thread (0)
+/// </summary>
+/// <returns>The handle of the new window</returns>
+HWND VirtualBackend::createWindow(DWORD pid, const RECT& rect, LONG style, LONG exStyle, HWND hOwner, BOOL bMenu) {
+	nextHandle_ += 4;
+	HWND hWnd = (HWND)nextHandle_;
+
+	VirtualWindow w;
+	w.hWnd = hWnd;
+	w.pid = pid;
+	w.threadId = (pid == processId_ ? threadId_ : 0);
+	w.hOwner = hOwner;
+	w.hParent = NULL;
+	w.rect = rect;
+	w.normalRect = rect;
+	w.style = style;
+	w.exStyle = exStyle;
+	w.frameStyle = style;
+	w.bFramePending = FALSE;
+	w.bMenu = bMenu;
+	w.bVisible = ((style & WS_VISIBLE) != 0);
+	w.state = ShowState::Normal;
+	w.alpha = 0xFF;
+	w.keyColor = 0;
+	w.layeredFlags = 0;
+	w.bGlass = FALSE;
+	w.bInputRegion = FALSE;
+	w.bAcceptFiles = ((exStyle & WS_EX_ACCEPTFILES) != 0);
+	w.wndProc = defaultWindowProc;
+	windows_[hWnd] = w;
+
+	// 新しいウィンドウは最前面グループまたは通常グループの先頭に入る
+	zOrder_.push_back(hWnd);
+	moveInZOrder(hWnd, ((exStyle & WS_EX_TOPMOST) ? HWND_TOPMOST : HWND_TOP));
+
+	return hWnd;
+}
+
+/// <summary>
+/// Destroy the window after sending WM_DESTROY and WM_NCDESTROY
+/// </summary>
+void VirtualBackend::destroyWindow(HWND hWnd) {
+	if (!find(hWnd)) return;
+
+	sendMessage(hWnd, WM_DESTROY, 0, 0);
+	sendMessage(hWnd, WM_NCDESTROY, 0, 0);
+
+	windows_.erase(hWnd);
+	timers_.erase(std::remove_if(timers_.begin(), timers_.end(), [hWnd](const VirtualTimer& t) { return t.hWnd == hWnd; }), timers_.end());
+	zOrder_.erase(std::remove(zOrder_.begin(), zOrder_.end(), hWnd), zOrder_.end());
+	if (hActiveWnd_ == hWnd) hActiveWnd_ = NULL;
+	if (hDesktopWnd_ == hWnd) hDesktopWnd_ = NULL;
+}
+
+void VirtualBackend::clearMonitors() {
+	monitors_.clear();
+}
+
+HMONITOR VirtualBackend::addMonitor(const RECT& rect) {
+	monitors_.push_back(rect);
+	return (HMONITOR)(UINT_PTR)monitors_.size();
+}
+
+/// <summary>
+/// Send WM_DISPLAYCHANGE to all windows
+/// </summary>
+void VirtualBackend::notifyDisplayChange() {
+	std::vector<HWND> targets = zOrder_;
+	for (HWND hWnd : targets) {
+		sendMessage(hWnd, WM_DISPLAYCHANGE, 32, 0);
+	}
+}
+
+/// <summary>
+/// Drop the files onto the window
+/// </summary>
+/// <returns>TRUE if WM_DROPFILES was sent</returns>
+BOOL VirtualBackend::dropFiles(HWND hWnd, const std::vector<std::u16string>& paths) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !w->bAcceptFiles) return FALSE;
+
+	// The receiver must release it with dragFinish() as well as DragFinish() on Windows
+	sendMessage(hWnd, WM_DROPFILES, (WPARAM)createDrop(paths), 0);
+	return TRUE;
+}
+
+HDROP VirtualBackend::createDrop(const std::vector<std::u16string>& paths) {
+	VirtualDrop* drop = new VirtualDrop();
+	drop->paths = paths;
+	return (HDROP)drop;
+}
+
+/// <summary>
+/// Move the cursor and send WM_MOUSEMOVE to the window under it
+/// </summary>
+void VirtualBackend::moveCursor(INT x, INT y) {
+	cursor_.store({ x, y });
+
+	const HWND hWnd = windowFromCursor();
+	if (hWnd) {
+		sendMessage(hWnd, WM_MOUSEMOVE, (bPrimaryButton_ ? MK_LBUTTON : 0), clientCursorParam(hWnd));
+	}
+}
+
+/// <summary>
+/// Press or release the primary button over the window under the cursor
+/// </summary>
+void VirtualBackend::setPrimaryButton(BOOL bDown) {
+	if (bPrimaryButton_ == bDown) return;
+	bPrimaryButton_ = bDown;
+
+	const HWND hWnd = windowFromCursor();
+	if (hWnd) {
+		sendMessage(hWnd, (bDown ? WM_LBUTTONDOWN : WM_LBUTTONUP), (bDown ? MK_LBUTTON : 0), clientCursorParam(hWnd));
+	}
+}
+
+/// <summary>
+/// Deliver the message to the window procedure
+/// </summary>
+LRESULT VirtualBackend::sendMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return 0;
+
+	counts_.messages++;
+	if (uMsg == WM_SIZE) counts_.sizeMessages++;
+	WNDPROC wndProc = w->wndProc;
+	return wndProc(hWnd, uMsg, wParam, lParam);
+}
+
+/// <summary>
+/// Deliver the posted messages, including the ones posted by the window procedures meanwhile
+/// </summary>
+UINT VirtualBackend::dispatchPostedMessages() {
+	UINT count = 0;
+	std::vector<VirtualMessage> messages;
+	for (;;) {
+		{
+			std::lock_guard<std::mutex> lock(postMutex_);
+			if (posted_.empty()) break;
+			messages.swap(posted_);
+		}
+
+		for (const VirtualMessage& m : messages) {
+			sendMessage(m.hWnd, m.uMsg, m.wParam, m.lParam);
+		}
+		count += (UINT)messages.size();
+		messages.clear();
+	}
+	return count;
+}
+
+/// <summary>
+/// Advance the virtual clock and fire the timers in order of their due time
+/// </summary>
+void VirtualBackend::advanceTime(UINT milliseconds) {
+	dispatchPostedMessages();
+
+	const UINT64 end = time_ + milliseconds;
+
+	while (true) {
+		// 次に期限が来るタイマーを探す（ウィンドウプロシージャ内で追加・削除されうるため毎回探す）
+		size_t next = timers_.size();
+		for (size_t i = 0; i < timers_.size(); i++) {
+			if (timers_[i].due <= end && (next == timers_.size() || timers_[i].due < timers_[next].due)) {
+				next = i;
+			}
+		}
+		if (next == timers_.size()) break;
+
+		VirtualTimer& timer = timers_[next];
+		time_ = timer.due;
+		timer.due += (timer.interval > 0 ? timer.interval : 1);
+
+		const HWND hWnd = timer.hWnd;
+		const UINT_PTR id = timer.id;
+		sendMessage(hWnd, WM_TIMER, (WPARAM)id, 0);
+	}
+	time_ = end;
+}
+
+LONG VirtualBackend::getFrameStyle(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->frameStyle : 0);
+}
+
+BYTE VirtualBackend::getLayeredAlpha(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->alpha : 0);
+}
+
+BOOL VirtualBackend::isGlass(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->bGlass : FALSE);
+}
+
+BOOL VirtualBackend::getInputRegion(HWND hWnd, std::vector<RECT>& rects) {
+	VirtualWindow* w = find(hWnd);
+	rects.clear();
+	if (!w || !w->bInputRegion) return FALSE;
+
+	rects = w->inputRects;
+	return TRUE;
+}
+
+BOOL VirtualBackend::isAcceptingFiles(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->bAcceptFiles : FALSE);
+}
+
+HWND VirtualBackend::getParent(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->hParent : NULL);
+}
+
+
+// ========================================================================
+#pragma region WindowBackend
+
+DWORD VirtualBackend::getCurrentProcessId() {
+	return processId_;
+}
+
+BOOL VirtualBackend::enumWindows(WNDENUMPROC lpEnumFunc, LPARAM lParam) {
+	// コールバック中にウィンドウが変化しても良いように複製して列挙
+	std::vector<HWND> targets = zOrder_;
+	for (HWND hWnd : targets) {
+		counts_.enumeratedWindows++;
+		if (!lpEnumFunc(hWnd, lParam)) return FALSE;
+	}
+	return TRUE;
+}
+
+DWORD VirtualBackend::getCurrentThreadId() {
+	return threadId_;
+}
+
+DWORD VirtualBackend::getWindowThreadId(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->threadId : 0);
+}
+
+BOOL VirtualBackend::enumThreadWindows(DWORD dwThreadId, WNDENUMPROC lpEnumFunc, LPARAM lParam) {
+	if (dwThreadId == 0) return FALSE;
+
+	// EnumThreadWindows() と同じく、見つからなければ FALSE
+	std::vector<HWND> targets;
+	for (HWND hWnd : zOrder_) {
+		if (windows_[hWnd].threadId == dwThreadId) {
+			targets.push_back(hWnd);
+		}
+	}
+	for (HWND hWnd : targets) {
+		counts_.enumeratedWindows++;
+		if (!lpEnumFunc(hWnd, lParam)) return FALSE;
+	}
+	return !targets.empty();
+}
+
+DWORD VirtualBackend::getWindowProcessId(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->pid : 0);
+}
+
+HWND VirtualBackend::getOwnerWindow(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w ? w->hOwner : NULL);
+}
+
+HWND VirtualBackend::getActiveWindow() {
+	return hActiveWnd_;
+}
+
+HWND VirtualBackend::findDesktopWindow() {
+	return hDesktopWnd_;
+}
+
+HWND VirtualBackend::setParent(HWND hWnd, HWND hParent) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return NULL;
+
+	HWND hPrevious = w->hParent;
+	w->hParent = hParent;
+	return hPrevious;
+}
+
+BOOL VirtualBackend::isWindow(HWND hWnd) {
+	return (find(hWnd) != nullptr);
+}
+
+BOOL VirtualBackend::isZoomed(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w && w->state == ShowState::Maximized);
+}
+
+BOOL VirtualBackend::isIconic(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w && w->state == ShowState::Minimized);
+}
+
+BOOL VirtualBackend::isWindowVisible(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w && w->bVisible);
+}
+
+/// <summary>
+/// Emulate ShowWindow()
+/// </summary>
+/// <returns>TRUE if the window was previously visible</returns>
+BOOL VirtualBackend::showWindow(HWND hWnd, INT nCmdShow) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return FALSE;
+
+	counts_.showWindow++;
+	BOOL bWasVisible = w->bVisible;
+
+	switch (nCmdShow) {
+	case SW_HIDE:
+		w->bVisible = FALSE;
+		break;
+
+	case SW_SHOW:
+		w->bVisible = TRUE;
+		break;
+
+	case SW_MAXIMIZE:
+		w->bVisible = TRUE;
+		if (w->state != ShowState::Maximized) {
+			if (w->state == ShowState::Normal) w->normalRect = w->rect;
+			w->state = ShowState::Maximized;
+			applyRect(*w, getMonitorRectFor(w->normalRect), FALSE, SIZE_MAXIMIZED);
+		}
+		break;
+
+	case SW_MINIMIZE:
+		if (w->state != ShowState::Minimized) {
+			if (w->state == ShowState::Normal) w->normalRect = w->rect;
+			w->state = ShowState::Minimized;
+			w->rect = { MINIMIZED_POSITION, MINIMIZED_POSITION, MINIMIZED_POSITION + 160, MINIMIZED_POSITION + 28 };
+			sendMessage(hWnd, WM_SIZE, SIZE_MINIMIZED, 0);
+		}
+		break;
+
+	case SW_NORMAL:
+	case SW_RESTORE:
+	default:
+		w->bVisible = TRUE;
+		if (w->state != ShowState::Normal) {
+			w->state = ShowState::Normal;
+			applyRect(*w, w->normalRect, FALSE, SIZE_RESTORED);
+		}
+		break;
+	}
+
+	return bWasVisible;
+}
+
+LONG VirtualBackend::getWindowLong(HWND hWnd, INT nIndex) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return 0;
+
+	counts_.getWindowLong++;
+	switch (nIndex) {
+	case GWL_STYLE:
+		return w->style | (w->bVisible ? WS_VISIBLE : 0);
+	case GWL_EXSTYLE:
+		return w->exStyle;
+	default:
+		return 0;
+	}
+}
+
+/// <summary>
+/// Emulate SetWindowLong(). WM_STYLECHANGED is sent, but the frame is not updated until SWP_FRAMECHANGED
+/// </summary>
+/// <returns>Previous value</returns>
+LONG VirtualBackend::setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return 0;
+
+	counts_.setWindowLong++;
+	LONG previous = 0;
+	switch (nIndex) {
+	case GWL_STYLE:
+		previous = w->style;
+		w->style = dwNewLong;
+		if (dwNewLong & WS_VISIBLE) w->bVisible = TRUE;
+		break;
+	case GWL_EXSTYLE:
+		previous = w->exStyle;
+		w->exStyle = dwNewLong;
+		break;
+	default:
+		return 0;
+	}
+
+	sendMessage(hWnd, WM_STYLECHANGED, (WPARAM)nIndex, 0);
+	return previous;
+}
+
+BOOL VirtualBackend::getWindowInfo(HWND hWnd, WINDOWINFO* pwi) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !pwi) return FALSE;
+
+	RECT rcClient = calculateClientRect(*w);
+	RECT rcFrame = rcClient;
+	adjustWindowRect(&rcFrame, w->frameStyle, w->bMenu);
+
+	pwi->cbSize = sizeof(WINDOWINFO);
+	pwi->rcWindow = w->rect;
+	pwi->rcClient = {
+		w->rect.left - rcFrame.left, w->rect.top - rcFrame.top,
+		w->rect.left - rcFrame.left + rcClient.right, w->rect.top - rcFrame.top + rcClient.bottom
+	};
+	pwi->dwStyle = (DWORD)getWindowLong(hWnd, GWL_STYLE);
+	pwi->dwExStyle = (DWORD)w->exStyle;
+	pwi->dwWindowStatus = (hActiveWnd_ == hWnd ? 1 : 0);
+	pwi->cxWindowBorders = (UINT)(-rcFrame.left);
+	pwi->cyWindowBorders = (UINT)(rcFrame.bottom - rcClient.bottom);
+	pwi->atomWindowType = 0;
+	pwi->wCreatorVersion = 0;
+	return TRUE;
+}
+
+BOOL VirtualBackend::getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !lpwndpl) return FALSE;
+
+	lpwndpl->length = sizeof(WINDOWPLACEMENT);
+	lpwndpl->flags = 0;
+	switch (w->state) {
+	case ShowState::Maximized:
+		lpwndpl->showCmd = SW_MAXIMIZE;
+		break;
+	case ShowState::Minimized:
+		lpwndpl->showCmd = SW_MINIMIZE;
+		break;
+	default:
+		lpwndpl->showCmd = SW_SHOWNORMAL;
+		break;
+	}
+	lpwndpl->ptMinPosition = { MINIMIZED_POSITION, MINIMIZED_POSITION };
+	lpwndpl->ptMaxPosition = { -1, -1 };
+	lpwndpl->rcNormalPosition = (w->state == ShowState::Normal ? w->rect : w->normalRect);
+	return TRUE;
+}
+
+BOOL VirtualBackend::setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !lpwndpl) return FALSE;
+
+	w->normalRect = lpwndpl->rcNormalPosition;
+	if (w->state == ShowState::Normal && lpwndpl->showCmd == SW_SHOWNORMAL) {
+		applyRect(*w, w->normalRect, FALSE, SIZE_RESTORED);
+	}
+	else {
+		showWindow(hWnd, (INT)lpwndpl->showCmd);
+	}
+	return TRUE;
+}
+
+BOOL VirtualBackend::hasMenu(HWND hWnd) {
+	VirtualWindow* w = find(hWnd);
+	return (w && w->bMenu);
+}
+
+BOOL VirtualBackend::getWindowRect(HWND hWnd, RECT* lpRect) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !lpRect) return FALSE;
+
+	counts_.getWindowRect++;
+	*lpRect = w->rect;
+	return TRUE;
+}
+
+BOOL VirtualBackend::getClientRect(HWND hWnd, RECT* lpRect) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !lpRect) return FALSE;
+
+	counts_.getClientRect++;
+	*lpRect = calculateClientRect(*w);
+	return TRUE;
+}
+
+/// <summary>
+/// Emulate SetWindowPos(). WM_WINDOWPOSCHANGING, WM_SIZE (if resized) and WM_WINDOWPOSCHANGED are sent.
+/// </summary>
+BOOL VirtualBackend::setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) {
+	if (!find(hWnd)) return FALSE;
+
+	counts_.setWindowPos++;
+
+	WINDOWPOS wp = { hWnd, hWndInsertAfter, x, y, cx, cy, uFlags };
+	if (!(uFlags & SWP_NOSENDCHANGING)) {
+		sendMessage(hWnd, WM_WINDOWPOSCHANGING, 0, (LPARAM)&wp);
+	}
+
+	// ウィンドウプロシージャ内で破棄された場合に備えて再取得
+	VirtualWindow* w = find(hWnd);
+	if (!w) return FALSE;
+
+	if (!(wp.flags & SWP_NOZORDER)) {
+		moveInZOrder(hWnd, wp.hwndInsertAfter);
+	}
+	if (wp.flags & SWP_SHOWWINDOW) w->bVisible = TRUE;
+	if (wp.flags & SWP_HIDEWINDOW) w->bVisible = FALSE;
+
+	RECT rect = w->rect;
+	if (!(wp.flags & SWP_NOMOVE)) {
+		LONG width = rect.right - rect.left;
+		LONG height = rect.bottom - rect.top;
+		rect = { wp.x, wp.y, wp.x + width, wp.y + height };
+	}
+	if (!(wp.flags & SWP_NOSIZE)) {
+		rect.right = rect.left + wp.cx;
+		rect.bottom = rect.top + wp.cy;
+	}
+
+	if (w->state == ShowState::Minimized) {
+		// 最小化中は元に戻す際の位置のみ更新
+		w->normalRect = rect;
+	}
+	else {
+		applyRect(*w, rect, (wp.flags & SWP_FRAMECHANGED), (w->state == ShowState::Maximized ? SIZE_MAXIMIZED : SIZE_RESTORED));
+		w = find(hWnd);
+		if (w && w->state == ShowState::Normal) w->normalRect = w->rect;
+	}
+
+	sendMessage(hWnd, WM_WINDOWPOSCHANGED, 0, (LPARAM)&wp);
+	return TRUE;
+}
+
+/// <summary>
+/// Emulate AdjustWindowRect() with fixed frame metrics
+/// </summary>
+BOOL VirtualBackend::adjustWindowRect(RECT* lpRect, DWORD dwStyle, BOOL bMenu) {
+	if (!lpRect) return FALSE;
+
+	LONG border = 0;
+	if (dwStyle & WS_THICKFRAME) {
+		border = FRAME_BORDER;
+	}
+	else if (dwStyle & (WS_DLGFRAME | WS_BORDER)) {
+		border = 1;
+	}
+
+	LONG caption = 0;
+	if ((dwStyle & WS_CAPTION) == WS_CAPTION) {
+		caption = CAPTION_HEIGHT;
+	}
+	if (bMenu) {
+		caption += MENU_HEIGHT;
+	}
+
+	lpRect->left -= border;
+	lpRect->top -= (border + caption);
+	lpRect->right += border;
+	lpRect->bottom += border;
+	return TRUE;
+}
+
+BOOL VirtualBackend::screenToClient(HWND hWnd, POINT* lpPoint) {
+	if (!lpPoint) return FALSE;
+
+	WINDOWINFO wi;
+	if (!getWindowInfo(hWnd, &wi)) return FALSE;
+
+	lpPoint->x -= wi.rcClient.left;
+	lpPoint->y -= wi.rcClient.top;
+	return TRUE;
+}
+
+BOOL VirtualBackend::setLayeredWindowAttributes(HWND hWnd, COLORREF crKey, BYTE bAlpha, DWORD dwFlags) {
+	VirtualWindow* w = find(hWnd);
+	if (!w || !(w->exStyle & WS_EX_LAYERED)) return FALSE;
+
+	counts_.setLayeredWindowAttributes++;
+	w->keyColor = crKey;
+	w->alpha = ((dwFlags & LWA_ALPHA) ? bAlpha : (BYTE)0xFF);
+	w->layeredFlags = dwFlags;
+	return TRUE;
+}
+
+BOOL VirtualBackend::extendFrameIntoClientArea(HWND hWnd, BOOL bEntireWindow) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return FALSE;
+
+	w->bGlass = bEntireWindow;
+	return TRUE;
+}
+
+BOOL VirtualBackend::setInputRegion(HWND hWnd, const RECT* lpRects, UINT count) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return FALSE;
+
+	counts_.setInputRegion++;
+	w->bInputRegion = (lpRects != NULL);
+	w->inputRects.clear();
+	if (lpRects != NULL) {
+		w->inputRects.assign(lpRects, lpRects + count);
+	}
+	return TRUE;
+}
+
+BOOL VirtualBackend::enumDisplayMonitors(MONITORENUMPROC lpfnEnum, LPARAM dwData) {
+	counts_.enumDisplayMonitors++;
+	for (size_t i = 0; i < monitors_.size(); i++) {
+		RECT rect = monitors_[i];
+		if (!lpfnEnum((HMONITOR)(UINT_PTR)(i + 1), NULL, &rect, dwData)) break;
+	}
+	return TRUE;
+}
+
+BOOL VirtualBackend::getCursorPos(POINT* lpPoint) {
+	if (!lpPoint) return FALSE;
+
+	cursorQueries_.fetch_add(1, std::memory_order_relaxed);
+	*lpPoint = cursor_.load();
+	return TRUE;
+}
+
+BOOL VirtualBackend::setCursorPos(INT x, INT y) {
+	cursor_.store({ x, y });
+	return TRUE;
+}
+
+BOOL VirtualBackend::isPrimaryButtonDown() {
+	return bPrimaryButton_;
+}
+
+void VirtualBackend::dragAcceptFiles(HWND hWnd, BOOL fAccept) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return;
+
+	w->bAcceptFiles = fAccept;
+	if (fAccept) {
+		w->exStyle |= WS_EX_ACCEPTFILES;
+	}
+	else {
+		w->exStyle &= ~WS_EX_ACCEPTFILES;
+	}
+}
+
+/// <summary>
+/// Emulate DragQueryFile()
+/// </summary>
+UINT VirtualBackend::dragQueryFile(HDROP hDrop, UINT iFile, LPWSTR lpszFile, UINT cch) {
+	VirtualDrop* drop = (VirtualDrop*)hDrop;
+	if (!drop) return 0;
+
+	counts_.dragQueryFile++;
+	if (iFile == 0xFFFFFFFF) {
+		return (UINT)drop->paths.size();
+	}
+	if (iFile >= drop->paths.size()) return 0;
+
+	const std::u16string& path = drop->paths[iFile];
+	if (lpszFile == nullptr) {
+		return (UINT)path.size();
+	}
+	if (cch == 0) return 0;
+
+	UINT length = (UINT)std::min<size_t>(path.size(), cch - 1);
+	memcpy(lpszFile, path.data(), length * sizeof(WCHAR));
+	lpszFile[length] = u'\0';
+	return length;
+}
+
+void VirtualBackend::dragFinish(HDROP hDrop) {
+	if (hDrop) counts_.dragFinish++;
+	delete (VirtualDrop*)hDrop;
+}
+
+WNDPROC VirtualBackend::setWindowProcedure(HWND hWnd, WNDPROC lpWndProc) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return NULL;
+
+	WNDPROC previous = w->wndProc;
+	w->wndProc = (lpWndProc ? lpWndProc : defaultWindowProc);
+	return previous;
+}
+
+LRESULT VirtualBackend::callWindowProc(WNDPROC lpPrevWndFunc, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+	if (lpPrevWndFunc == NULL) {
+		return defWindowProc(hWnd, uMsg, wParam, lParam);
+	}
+	return lpPrevWndFunc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT VirtualBackend::defWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+	return defaultWindowProc(hWnd, uMsg, wParam, lParam);
+}
+
+/// <summary>
+/// Emulate SetTimer(). An existing timer with the same ID is replaced
+/// </summary>
+BOOL VirtualBackend::setTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse) {
+	if (!find(hWnd)) return FALSE;
+
+	killTimer(hWnd, nIDEvent);
+	timers_.push_back({ hWnd, nIDEvent, uElapse, time_ + uElapse });
+	return TRUE;
+}
+
+BOOL VirtualBackend::killTimer(HWND hWnd, UINT_PTR nIDEvent) {
+	auto it = std::find_if(timers_.begin(), timers_.end(), [hWnd, nIDEvent](const VirtualTimer& t) { return (t.hWnd == hWnd && t.id == nIDEvent); });
+	if (it == timers_.end()) return FALSE;
+
+	timers_.erase(it);
+	return TRUE;
+}
+
+/// <summary>
+/// Emulate PostMessage(). The message is delivered by dispatchPostedMessages() or advanceTime()
+///   The window is checked on delivery, since the windows may not be read on other threads.
+/// </summary>
+BOOL VirtualBackend::postMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+	std::lock_guard<std::mutex> lock(postMutex_);
+	try {
+		posted_.push_back({ hWnd, uMsg, wParam, lParam });
+	}
+	catch (...) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Emulate RegisterWindowMessage(). IDs start from 0xC000 like Windows
+/// </summary>
+UINT VirtualBackend::registerWindowMessage(LPCWSTR lpString) {
+	if (lpString == nullptr || lpString[0] == 0) return 0;
+
+	const std::basic_string<WCHAR> name(lpString);
+	auto it = std::find(registeredMessages_.begin(), registeredMessages_.end(), name);
+	if (it == registeredMessages_.end()) {
+		registeredMessages_.push_back(name);
+		it = registeredMessages_.end() - 1;
+	}
+	return 0xC000 + (UINT)(it - registeredMessages_.begin());
+}
+
+BOOL VirtualBackend::getOpenFileName(OPENFILENAMEW* lpofn) {
+	return runFileDialog(lpofn, FALSE);
+}
+
+BOOL VirtualBackend::getSaveFileName(OPENFILENAMEW* lpofn) {
+	return runFileDialog(lpofn, TRUE);
+}
+
+void VirtualBackend::setFileDialogError(const DWORD error) {
+	fileDialogError_ = error;
+}
+
+DWORD VirtualBackend::getFileDialogError() {
+	return fileDialogError_;
+}
+
+BOOL VirtualBackend::closeFileDialog(const OPENFILENAMEW* lpofn) {
+	std::lock_guard<std::mutex> lock(dialogMutex_);
+	for (VirtualDialog& dialog : dialogs_) {
+		if (dialog.lpofn == lpofn) {
+			dialog.bClosed = TRUE;
+			dialogClosed_.notify_all();
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+#pragma endregion WindowBackend
+
+
+// ========================================================================
+#pragma region Internal functions
+
+/// <summary>
+/// Wait for the delay as if the dialog was shown, then let the handler choose
+/// </summary>
+BOOL VirtualBackend::runFileDialog(OPENFILENAMEW* lpofn, const BOOL bSave) {
+	fileDialogError_ = 0;
+
+	std::unique_lock<std::mutex> lock(dialogMutex_);
+	dialogs_.push_back({ lpofn, FALSE });
+
+	const auto isClosed = [this, lpofn] {
+		for (const VirtualDialog& dialog : dialogs_) {
+			if (dialog.lpofn == lpofn) return (dialog.bClosed != FALSE);
+		}
+		return false;
+	};
+	if (fileDialogDelay_ > 0) {
+		dialogClosed_.wait_for(lock, std::chrono::milliseconds(fileDialogDelay_), isClosed);
+	}
+	const BOOL bClosed = isClosed();
+
+	for (size_t i = 0; i < dialogs_.size(); i++) {
+		if (dialogs_[i].lpofn == lpofn) {
+			dialogs_.erase(dialogs_.begin() + i);
+			break;
+		}
+	}
+	lock.unlock();
+
+	if (bClosed || !fileDialogHandler_) return FALSE;
+	return fileDialogHandler_(lpofn, bSave);
+}
+
+VirtualBackend::VirtualWindow* VirtualBackend::find(HWND hWnd) {
+	auto it = windows_.find(hWnd);
+	if (it == windows_.end()) return nullptr;
+	return &(it->second);
+}
+
+/// <summary>
+/// Client area in client coordinates, calculated with the frame style
+/// </summary>
+RECT VirtualBackend::calculateClientRect(const VirtualWindow& w) {
+	if (w.state == ShowState::Minimized) {
+		return { 0, 0, 0, 0 };
+	}
+
+	RECT frame = { 0, 0, 0, 0 };
+	adjustWindowRect(&frame, (DWORD)w.frameStyle, w.bMenu);
+
+	LONG width = (w.rect.right - w.rect.left) - (frame.right - frame.left);
+	LONG height = (w.rect.bottom - w.rect.top) - (frame.bottom - frame.top);
+	return { 0, 0, std::max<LONG>(width, 0), std::max<LONG>(height, 0) };
+}
+
+/// <summary>
+/// The monitor which contains the center of the rectangle (or the first monitor)
+/// </summary>
+RECT VirtualBackend::getMonitorRectFor(const RECT& rect) {
+	if (monitors_.empty()) return rect;
+
+	LONG cx = (rect.left + rect.right - 1) / 2;
+	LONG cy = (rect.top + rect.bottom - 1) / 2;
+	for (const RECT& mr : monitors_) {
+		if (mr.left <= cx && cx < mr.right && mr.top <= cy && cy < mr.bottom) {
+			return mr;
+		}
+	}
+	return monitors_[0];
+}
+
+/// <summary>
+/// Change the z-order. Topmost windows are always above the others.
+/// </summary>
+void VirtualBackend::moveInZOrder(HWND hWnd, HWND hWndInsertAfter) {
+	VirtualWindow* w = find(hWnd);
+	if (!w) return;
+
+	zOrder_.erase(std::remove(zOrder_.begin(), zOrder_.end(), hWnd), zOrder_.end());
+
+	// 最前面グループの末尾
+	auto firstNormal = std::find_if(zOrder_.begin(), zOrder_.end(), [this](HWND h) {
+		VirtualWindow* other = find(h);
+		return !(other && (other->exStyle & WS_EX_TOPMOST));
+	});
+
+	if (hWndInsertAfter == HWND_TOPMOST) {
+		w->exStyle |= WS_EX_TOPMOST;
+		zOrder_.insert(zOrder_.begin(), hWnd);
+	}
+	else if (hWndInsertAfter == HWND_NOTOPMOST) {
+		w->exStyle &= ~WS_EX_TOPMOST;
+		zOrder_.insert(firstNormal, hWnd);
+	}
+	else if (hWndInsertAfter == HWND_TOP) {
+		if (w->exStyle & WS_EX_TOPMOST) {
+			zOrder_.insert(zOrder_.begin(), hWnd);
+		}
+		else {
+			zOrder_.insert(firstNormal, hWnd);
+		}
+	}
+	else if (hWndInsertAfter == HWND_BOTTOM) {
+		w->exStyle &= ~WS_EX_TOPMOST;
+		zOrder_.push_back(hWnd);
+	}
+	else {
+		auto it = std::find(zOrder_.begin(), zOrder_.end(), hWndInsertAfter);
+		if (it == zOrder_.end()) {
+			zOrder_.insert(firstNormal, hWnd);
+		}
+		else {
+			zOrder_.insert(it + 1, hWnd);
+		}
+	}
+}
+
+/// <summary>
+/// Topmost visible window containing the cursor, or NULL
+/// </summary>
+HWND VirtualBackend::windowFromCursor() {
+	const POINT cursor = cursor_.load();
+	for (HWND hWnd : zOrder_) {
+		VirtualWindow* w = find(hWnd);
+		if (w && w->bVisible && w->state != ShowState::Minimized
+			&& cursor.x >= w->rect.left && cursor.x < w->rect.right
+			&& cursor.y >= w->rect.top && cursor.y < w->rect.bottom) {
+			return hWnd;
+		}
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Cursor position in the client coordinates as lParam of the mouse messages
+/// </summary>
+LPARAM VirtualBackend::clientCursorParam(HWND hWnd) {
+	POINT pos = cursor_.load();
+	screenToClient(hWnd, &pos);
+	return MAKELPARAM(pos.x, pos.y);
+}
+
+/// <summary>
+/// Set the window rectangle and send WM_SIZE if the size or the frame has changed
+/// </summary>
+void VirtualBackend::applyRect(VirtualWindow& w, const RECT& rect, BOOL bFrameChanged, WPARAM sizeType) {
+	RECT oldClient = calculateClientRect(w);
+	BOOL bSizeChanged = ((w.rect.right - w.rect.left) != (rect.right - rect.left)) || ((w.rect.bottom - w.rect.top) != (rect.bottom - rect.top));
+
+	w.rect = rect;
+	if (w.bFramePending && bSizeChanged) {
+		w.frameStyle = w.style;
+		w.bFramePending = FALSE;
+	}
+	if (bFrameChanged && w.frameStyle != w.style) {
+		if (bFrameChangeDeferred_) {
+			w.bFramePending = TRUE;
+		}
+		else {
+			w.frameStyle = w.style;
+		}
+	}
+
+	RECT newClient = calculateClientRect(w);
+	BOOL bClientChanged = (oldClient.right != newClient.right) || (oldClient.bottom != newClient.bottom);
+	if (bClientChanged) {
+		counts_.resized++;
+	}
+
+	if (bSizeChanged || bClientChanged) {
+		sendMessage(w.hWnd, WM_SIZE, sizeType, MAKELPARAM(newClient.right, newClient.bottom));
+	}
+}
+
+/// <summary>
+/// Window procedure of windows which are not hooked
+/// </summary>
+LRESULT CALLBACK VirtualBackend::defaultWindowProc(HWND /*hWnd*/, UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/) {
+	return 0;
+}
+
+#pragma endregion Internal functions
+
+
+#if !defined(_WIN32) && (!defined(__linux__) || defined(UNIWINC_HEADLESS))
+/// <summary>
+/// The virtual desktop is the default where no native backend is available, or with UNIWINC_HEADLESS
+/// </summary>
+/// <returns></returns>
+WindowBackend* getDefaultBackend() {
+	static VirtualBackend backend;
+	return &backend;
+}
+#endif
@@ -0,0 +1,313 @@
+﻿#pragma once
+
+#include "backend.h"
+#include "seqlock.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Deterministic in-memory "virtual desktop" backend.
+///   Emulates windows (styles, z-order, show state), monitors, the mouse cursor and file drops
+///   without any window system, so that the library can be measured and tested headless.
+///   Window messages are delivered synchronously to the installed window procedure.
+///   Not thread safe. Use it from one thread, except the file dialogs which may be shown from another thread
+///   and postMessage() and getCursorPos() which may be called on any thread.
+/// </summary>
+class VirtualBackend : public WindowBackend {
+public:
+	// Frame metrics used to emulate AdjustWindowRect() [px]
+	static const LONG FRAME_BORDER = 8;
+	static const LONG CAPTION_HEIGHT = 23;
+	static const LONG MENU_HEIGHT = 20;
+
+	/// <summary>
+	/// Numbers of the calls which would reach the window system
+	/// </summary>
+	struct CallCounts {
+		UINT64 setWindowPos;
+		UINT64 setWindowLong;
+		UINT64 getWindowLong;
+		UINT64 getWindowRect;
+		UINT64 getClientRect;
+		UINT64 showWindow;
+		UINT64 setLayeredWindowAttributes;
+		UINT64 setInputRegion;
+		UINT64 enumDisplayMonitors;
+		UINT64 getCursorPos;
+		UINT64 dragQueryFile;
+		UINT64 dragFinish;
+		UINT64 enumeratedWindows;	// Windows passed to the callbacks of enumWindows() and enumThreadWindows()
+		UINT64 messages;		// Messages sent to window procedures
+		UINT64 sizeMessages;	// WM_SIZE sent to window procedures
+		UINT64 resized;			// Changes of the client area size
+	};
+
+	VirtualBackend();
+	~VirtualBackend() override;
+
+	// ---- Simulation API ----
+
+	/// <summary>
+	/// Remove all windows, monitors and counters
+	/// </summary>
+	void reset();
+
+	void setCurrentProcessId(DWORD pid) { processId_ = pid; }
+
+	/// <summary>
+	/// Thread which creates the windows of the current process from now on, and which calls the library
+	/// </summary>
+	void setCurrentThreadId(DWORD tid) { threadId_ = tid; }
+
+	/// <summary>
+	/// Create a top-level window. The windows of the current process belong to the current thread,
+	///   the others to no thread (0), as their threads are not emulated.
+	/// </summary>
+	HWND createWindow(DWORD pid, const RECT& rect, LONG style, LONG exStyle = 0, HWND hOwner = NULL, BOOL bMenu = FALSE);
+	void destroyWindow(HWND hWnd);
+	void setActiveWindow(HWND hWnd) { hActiveWnd_ = hWnd; }
+
+	/// <summary>
+	/// Make SWP_FRAMECHANGED apply the new frame at the next resize instead, as the window of Unity 2020 sometimes does.
+	///   The client area keeps the old frame until then, so the 1px resize trick is needed.
+	/// </summary>
+	void setFrameChangeDeferred(BOOL bDeferred) { bFrameChangeDeferred_ = bDeferred; }
+	void setDesktopWindow(HWND hWnd) { hDesktopWnd_ = hWnd; }
+
+	void clearMonitors();
+	HMONITOR addMonitor(const RECT& rect);
+
+	/// <summary>
+	/// Send WM_DISPLAYCHANGE to all windows
+	/// </summary>
+	void notifyDisplayChange();
+
+	/// <summary>
+	/// Drop the files onto the window. WM_DROPFILES is sent if the window accepts files.
+	/// </summary>
+	BOOL dropFiles(HWND hWnd, const std::vector<std::u16string>& paths);
+
+	/// <summary>
+	/// Make an HDROP of the files without sending it, to drive a receiver directly. Release it with dragFinish()
+	/// </summary>
+	HDROP createDrop(const std::vector<std::u16string>& paths);
+
+	/// <summary>
+	/// Set the function which emulates the file dialogs. Dialogs are cancelled if not set.
+	/// </summary>
+	void setFileDialogHandler(std::function<BOOL(OPENFILENAMEW*, BOOL bSave)> handler) { fileDialogHandler_ = handler; }
+
+	/// <summary>
+	/// Keep the file dialogs open for the time before calling the handler, like a user choosing a file.
+	///   closeFileDialog() in the meantime closes the dialog as cancelled without calling the handler.
+	/// </summary>
+	/// <param name="milliseconds">Real time [ms]. 0 calls the handler at once (default)</param>
+	void setFileDialogDelay(const UINT32 milliseconds) { fileDialogDelay_ = milliseconds; }
+
+	/// <summary>
+	/// Set the error of the dialog on this thread, e.g. FNERR_BUFFERTOOSMALL. Called by the handler before returning FALSE
+	/// </summary>
+	void setFileDialogError(const DWORD error);
+
+	/// <summary>
+	/// Move the cursor like the user. WM_MOUSEMOVE is sent to the topmost visible window under the cursor
+	/// </summary>
+	void moveCursor(INT x, INT y);
+
+	/// <summary>
+	/// Press or release the primary button. WM_LBUTTONDOWN or WM_LBUTTONUP is sent to the window under the cursor
+	/// </summary>
+	void setPrimaryButton(BOOL bDown);
+
+	/// <summary>
+	/// Deliver the message to the window procedure of the window
+	/// </summary>
+	LRESULT sendMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+	/// <summary>
+	/// Deliver the messages posted so far, in the order they were posted
+	/// </summary>
+	/// <returns>Number of the messages delivered</returns>
+	UINT dispatchPostedMessages();
+
+	/// <summary>
+	/// Advance the virtual clock. The posted messages are delivered first, then WM_TIMER for each timer which has elapsed.
+	/// </summary>
+	void advanceTime(UINT milliseconds);
+
+	CallCounts getCallCounts() const;
+	void resetCallCounts();
+
+	LONG getFrameStyle(HWND hWnd);
+	BYTE getLayeredAlpha(HWND hWnd);
+	BOOL isGlass(HWND hWnd);
+
+	/// <summary>
+	/// Rectangles set by setInputRegion() in client coordinates
+	/// </summary>
+	/// <returns>FALSE if the whole window accepts input</returns>
+	BOOL getInputRegion(HWND hWnd, std::vector<RECT>& rects);
+	BOOL isAcceptingFiles(HWND hWnd);
+	HWND getParent(HWND hWnd);
+	std::vector<HWND> getZOrder() const { return zOrder_; }
+
+	// ---- WindowBackend ----
+
+	DWORD getCurrentProcessId() override;
+	BOOL enumWindows(WNDENUMPROC lpEnumFunc, LPARAM lParam) override;
+	DWORD getWindowProcessId(HWND hWnd) override;
+	HWND getOwnerWindow(HWND hWnd) override;
+	DWORD getCurrentThreadId() override;
+	DWORD getWindowThreadId(HWND hWnd) override;
+	BOOL enumThreadWindows(DWORD dwThreadId, WNDENUMPROC lpEnumFunc, LPARAM lParam) override;
+	HWND getActiveWindow() override;
+	HWND findDesktopWindow() override;
+	HWND setParent(HWND hWnd, HWND hParent) override;
+
+	BOOL isWindow(HWND hWnd) override;
+	BOOL isZoomed(HWND hWnd) override;
+	BOOL isIconic(HWND hWnd) override;
+	BOOL isWindowVisible(HWND hWnd) override;
+	BOOL showWindow(HWND hWnd, INT nCmdShow) override;
+	LONG getWindowLong(HWND hWnd, INT nIndex) override;
+	LONG setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) override;
+	BOOL getWindowInfo(HWND hWnd, WINDOWINFO* pwi) override;
+	BOOL getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) override;
+	BOOL setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) override;
+	BOOL hasMenu(HWND hWnd) override;
+
+	BOOL getWindowRect(HWND hWnd, RECT* lpRect) override;
+	BOOL getClientRect(HWND hWnd, RECT* lpRect) override;
+	BOOL setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) override;
+	BOOL adjustWindowRect(RECT* lpRect, DWORD dwStyle, BOOL bMenu) override;
+	BOOL screenToClient(HWND hWnd, POINT* lpPoint) override;
+
+	BOOL setLayeredWindowAttributes(HWND hWnd, COLORREF crKey, BYTE bAlpha, DWORD dwFlags) override;
+	BOOL extendFrameIntoClientArea(HWND hWnd, BOOL bEntireWindow) override;
+	BOOL setInputRegion(HWND hWnd, const RECT* lpRects, UINT count) override;
+
+	BOOL enumDisplayMonitors(MONITORENUMPROC lpfnEnum, LPARAM dwData) override;
+
+	BOOL getCursorPos(POINT* lpPoint) override;
+	BOOL setCursorPos(INT x, INT y) override;
+	BOOL isPrimaryButtonDown() override;
+
+	void dragAcceptFiles(HWND hWnd, BOOL fAccept) override;
+	UINT dragQueryFile(HDROP hDrop, UINT iFile, LPWSTR lpszFile, UINT cch) override;
+	void dragFinish(HDROP hDrop) override;
+
+	WNDPROC setWindowProcedure(HWND hWnd, WNDPROC lpWndProc) override;
+	LRESULT callWindowProc(WNDPROC lpPrevWndFunc, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override;
+	LRESULT defWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override;
+
+	BOOL setTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse) override;
+	BOOL killTimer(HWND hWnd, UINT_PTR nIDEvent) override;
+
+	BOOL postMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override;
+	UINT registerWindowMessage(LPCWSTR lpString) override;
+
+	BOOL getOpenFileName(OPENFILENAMEW* lpofn) override;
+	BOOL getSaveFileName(OPENFILENAMEW* lpofn) override;
+	BOOL closeFileDialog(const OPENFILENAMEW* lpofn) override;
+	DWORD getFileDialogError() override;
+
+	/// <summary>
+	/// The virtual clock, advanced only by advanceTime()
+	/// </summary>
+	INT64 getMonotonicTime() override { return (INT64)time_ * 1000; }
+
+private:
+	enum class ShowState : int {
+		Normal = 0,
+		Maximized = 1,
+		Minimized = 2,
+	};
+
+	struct VirtualWindow {
+		HWND hWnd;
+		DWORD pid;
+		DWORD threadId;
+		HWND hOwner;
+		HWND hParent;
+		RECT rect;				// Current window rectangle
+		RECT normalRect;		// Rectangle to restore
+		LONG style;
+		LONG exStyle;
+		LONG frameStyle;		// Style which the client area is calculated with. Updated by SWP_FRAMECHANGED
+		BOOL bFramePending;		// SWP_FRAMECHANGED has been deferred to the next resize
+		BOOL bMenu;
+		BOOL bVisible;
+		ShowState state;
+		BYTE alpha;
+		COLORREF keyColor;
+		DWORD layeredFlags;
+		BOOL bGlass;
+		BOOL bInputRegion;
+		std::vector<RECT> inputRects;
+		BOOL bAcceptFiles;
+		WNDPROC wndProc;
+	};
+
+	struct VirtualTimer {
+		HWND hWnd;
+		UINT_PTR id;
+		UINT interval;			// [ms]
+		UINT64 due;				// Virtual time to fire [ms]
+	};
+
+	struct VirtualDialog {
+		const OPENFILENAMEW* lpofn;
+		BOOL bClosed;
+	};
+
+	struct VirtualDrop {
+		std::vector<std::u16string> paths;
+	};
+
+	struct VirtualMessage {
+		HWND hWnd;
+		UINT uMsg;
+		WPARAM wParam;
+		LPARAM lParam;
+	};
+
+	DWORD processId_;
+	DWORD threadId_;
+	UINT_PTR nextHandle_;
+	HWND hActiveWnd_;
+	HWND hDesktopWnd_;
+	SeqLock<POINT> cursor_;			// getCursorPos() may be called on any thread, as GetCursorPos() on Windows
+	std::atomic<UINT64> cursorQueries_;	// CallCounts::getCursorPos
+	BOOL bPrimaryButton_;
+	BOOL bFrameChangeDeferred_;
+	UINT64 time_;					// Virtual clock [ms]
+	std::vector<VirtualTimer> timers_;
+	std::unordered_map<HWND, VirtualWindow> windows_;
+	std::vector<HWND> zOrder_;		// Top to bottom
+	std::vector<RECT> monitors_;
+	std::function<BOOL(OPENFILENAMEW*, BOOL)> fileDialogHandler_;
+	UINT32 fileDialogDelay_;		// [ms]
+	std::mutex dialogMutex_;		// Guards dialogs_
+	std::condition_variable dialogClosed_;
+	std::vector<VirtualDialog> dialogs_;
+	std::mutex postMutex_;			// Guards posted_
+	std::vector<VirtualMessage> posted_;
+	std::vector<std::basic_string<WCHAR>> registeredMessages_;	// Index + 0xC000 is the message ID
+	CallCounts counts_;
+
+	VirtualWindow* find(HWND hWnd);
+	RECT calculateClientRect(const VirtualWindow& w);
+	RECT getMonitorRectFor(const RECT& rect);
+	void moveInZOrder(HWND hWnd, HWND hWndInsertAfter);
+	HWND windowFromCursor();
+	LPARAM clientCursorParam(HWND hWnd);
+	void applyRect(VirtualWindow& w, const RECT& rect, BOOL bFrameChanged, WPARAM sizeType);
+	BOOL runFileDialog(OPENFILENAMEW* lpofn, const BOOL bSave);
+
+	static LRESULT CALLBACK defaultWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+};
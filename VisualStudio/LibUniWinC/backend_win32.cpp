@@ -0,0 +1,371 @@
+﻿// backend_win32.cpp : Win32 implementation of WindowBackend
+
+#include "pch.h"
+#include "libuniwinc.h"
+#include "backend.h"
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+
+class Win32Backend : public WindowBackend {
+public:
+	DWORD getCurrentProcessId() override {
+		return GetCurrentProcessId();
+	}
+
+	BOOL enumWindows(WNDENUMPROC lpEnumFunc, LPARAM lParam) override {
+		return EnumWindows(lpEnumFunc, lParam);
+	}
+
+	DWORD getWindowProcessId(HWND hWnd) override {
+		DWORD pid = 0;
+		GetWindowThreadProcessId(hWnd, &pid);
+		return pid;
+	}
+
+	HWND getOwnerWindow(HWND hWnd) override {
+		return GetWindow(hWnd, GW_OWNER);
+	}
+
+	DWORD getCurrentThreadId() override {
+		return GetCurrentThreadId();
+	}
+
+	DWORD getWindowThreadId(HWND hWnd) override {
+		return GetWindowThreadProcessId(hWnd, NULL);
+	}
+
+	BOOL enumThreadWindows(DWORD dwThreadId, WNDENUMPROC lpEnumFunc, LPARAM lParam) override {
+		return EnumThreadWindows(dwThreadId, lpEnumFunc, lParam);
+	}
+
+	HWND getActiveWindow() override {
+		return GetActiveWindow();
+	}
+
+	HWND findDesktopWindow() override {
+		bExpectDesktopWnd_ = FALSE;
+		hDesktopWnd_ = NULL;
+		EnumWindows(findDesktopWindowProc, (LPARAM)this);
+		return hDesktopWnd_;
+	}
+
+	HWND setParent(HWND hWnd, HWND hParent) override {
+		return SetParent(hWnd, hParent);
+	}
+
+	BOOL isWindow(HWND hWnd) override {
+		return IsWindow(hWnd);
+	}
+
+	BOOL isZoomed(HWND hWnd) override {
+		return IsZoomed(hWnd);
+	}
+
+	BOOL isIconic(HWND hWnd) override {
+		return IsIconic(hWnd);
+	}
+
+	BOOL isWindowVisible(HWND hWnd) override {
+		return IsWindowVisible(hWnd);
+	}
+
+	BOOL showWindow(HWND hWnd, INT nCmdShow) override {
+		return ShowWindow(hWnd, nCmdShow);
+	}
+
+	LONG getWindowLong(HWND hWnd, INT nIndex) override {
+		return GetWindowLong(hWnd, nIndex);
+	}
+
+	LONG setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) override {
+		return SetWindowLong(hWnd, nIndex, dwNewLong);
+	}
+
+	BOOL getWindowInfo(HWND hWnd, WINDOWINFO* pwi) override {
+		return GetWindowInfo(hWnd, pwi);
+	}
+
+	BOOL getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) override {
+		return GetWindowPlacement(hWnd, lpwndpl);
+	}
+
+	BOOL setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) override {
+		return SetWindowPlacement(hWnd, lpwndpl);
+	}
+
+	BOOL hasMenu(HWND hWnd) override {
+		return (GetMenu(hWnd) != NULL);
+	}
+
+	BOOL getWindowRect(HWND hWnd, RECT* lpRect) override {
+		return GetWindowRect(hWnd, lpRect);
+	}
+
+	BOOL getClientRect(HWND hWnd, RECT* lpRect) override {
+		return GetClientRect(hWnd, lpRect);
+	}
+
+	BOOL setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) override {
+		return SetWindowPos(hWnd, hWndInsertAfter, x, y, cx, cy, uFlags);
+	}
+
+	BOOL adjustWindowRect(RECT* lpRect, DWORD dwStyle, BOOL bMenu) override {
+		return AdjustWindowRect(lpRect, dwStyle, bMenu);
+	}
+
+	BOOL screenToClient(HWND hWnd, POINT* lpPoint) override {
+		return ScreenToClient(hWnd, lpPoint);
+	}
+
+	BOOL setLayeredWindowAttributes(HWND hWnd, COLORREF crKey, BYTE bAlpha, DWORD dwFlags) override {
+		return SetLayeredWindowAttributes(hWnd, crKey, bAlpha, dwFlags);
+	}
+
+	BOOL extendFrameIntoClientArea(HWND hWnd, BOOL bEntireWindow) override {
+		if (bEntireWindow) {
+			// 全面をGlassにする
+			MARGINS margins = { -1 };
+			return SUCCEEDED(DwmExtendFrameIntoClientArea(hWnd, &margins));
+		}
+		else {
+			// 枠のみGlassにする
+			MARGINS margins = { 0, 0, 0, 0 };
+			return SUCCEEDED(DwmExtendFrameIntoClientArea(hWnd, &margins));
+		}
+	}
+
+	/// <summary>
+	/// The window region also clips drawing on Windows, so the pixels outside are not shown
+	/// </summary>
+	BOOL setInputRegion(HWND hWnd, const RECT* lpRects, UINT count) override {
+		if (lpRects == NULL) {
+			return (SetWindowRgn(hWnd, NULL, TRUE) != 0);
+		}
+
+		// SetWindowRgn() uses window coordinates
+		WINDOWINFO wi;
+		wi.cbSize = sizeof(WINDOWINFO);
+		if (!GetWindowInfo(hWnd, &wi)) return FALSE;
+		const LONG dx = wi.rcClient.left - wi.rcWindow.left;
+		const LONG dy = wi.rcClient.top - wi.rcWindow.top;
+
+		const DWORD size = (DWORD)(sizeof(RGNDATAHEADER) + sizeof(RECT) * count);
+		std::vector<BYTE> buffer(size);
+		RGNDATA* data = (RGNDATA*)buffer.data();
+		data->rdh.dwSize = sizeof(RGNDATAHEADER);
+		data->rdh.iType = RDH_RECTANGLES;
+		data->rdh.nCount = count;
+		data->rdh.nRgnSize = (DWORD)(sizeof(RECT) * count);
+		data->rdh.rcBound = { 0, 0, 0, 0 };
+
+		RECT* rects = (RECT*)data->Buffer;
+		RECT& bound = data->rdh.rcBound;
+		for (UINT i = 0; i < count; i++) {
+			const RECT rect = { lpRects[i].left + dx, lpRects[i].top + dy, lpRects[i].right + dx, lpRects[i].bottom + dy };
+			rects[i] = rect;
+			if (i == 0) {
+				bound = rect;
+				continue;
+			}
+			if (rect.left < bound.left) bound.left = rect.left;
+			if (rect.top < bound.top) bound.top = rect.top;
+			if (rect.right > bound.right) bound.right = rect.right;
+			if (rect.bottom > bound.bottom) bound.bottom = rect.bottom;
+		}
+
+		HRGN hRgn = ExtCreateRegion(NULL, size, data);
+		if (hRgn == NULL) return FALSE;
+
+		// 成功すればリージョンはシステムが所有する
+		if (!SetWindowRgn(hWnd, hRgn, TRUE)) {
+			DeleteObject(hRgn);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	BOOL enumDisplayMonitors(MONITORENUMPROC lpfnEnum, LPARAM dwData) override {
+		return EnumDisplayMonitors(NULL, NULL, lpfnEnum, dwData);
+	}
+
+	BOOL getCursorPos(POINT* lpPoint) override {
+		return GetCursorPos(lpPoint);
+	}
+
+	BOOL setCursorPos(INT x, INT y) override {
+		return SetCursorPos(x, y);
+	}
+
+	BOOL isPrimaryButtonDown() override {
+		// GetAsyncKeyState() は物理的なボタンを返すため、左右が入れ替えられていれば右ボタンを見る
+		const int vKey = (GetSystemMetrics(SM_SWAPBUTTON) ? VK_RBUTTON : VK_LBUTTON);
+		return ((GetAsyncKeyState(vKey) & 0x8000) != 0);
+	}
+
+	void dragAcceptFiles(HWND hWnd, BOOL fAccept) override {
+		DragAcceptFiles(hWnd, fAccept);
+	}
+
+	UINT dragQueryFile(HDROP hDrop, UINT iFile, LPWSTR lpszFile, UINT cch) override {
+		return DragQueryFileW(hDrop, iFile, lpszFile, cch);
+	}
+
+	void dragFinish(HDROP hDrop) override {
+		DragFinish(hDrop);
+	}
+
+	WNDPROC setWindowProcedure(HWND hWnd, WNDPROC lpWndProc) override {
+#ifdef _WIN64
+		// 64bit
+		return (WNDPROC)SetWindowLongPtr(hWnd, GWLP_WNDPROC, (LONG_PTR)lpWndProc);
+#else
+		return (WNDPROC)SetWindowLong(hWnd, GWLP_WNDPROC, (LONG)lpWndProc);
+#endif
+	}
+
+	LRESULT callWindowProc(WNDPROC lpPrevWndFunc, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override {
+		return CallWindowProc(lpPrevWndFunc, hWnd, uMsg, wParam, lParam);
+	}
+
+	LRESULT defWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override {
+		return DefWindowProc(hWnd, uMsg, wParam, lParam);
+	}
+
+	BOOL setTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse) override {
+		return (SetTimer(hWnd, nIDEvent, uElapse, NULL) != 0);
+	}
+
+	BOOL killTimer(HWND hWnd, UINT_PTR nIDEvent) override {
+		return KillTimer(hWnd, nIDEvent);
+	}
+
+	BOOL postMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override {
+		return PostMessageW(hWnd, uMsg, wParam, lParam);
+	}
+
+	UINT registerWindowMessage(LPCWSTR lpString) override {
+		return RegisterWindowMessageW(lpString);
+	}
+
+	BOOL getOpenFileName(OPENFILENAMEW* lpofn) override {
+		return runFileDialog(lpofn, FALSE);
+	}
+
+	BOOL getSaveFileName(OPENFILENAMEW* lpofn) override {
+		return runFileDialog(lpofn, TRUE);
+	}
+
+	DWORD getFileDialogError() override {
+		return CommDlgExtendedError();
+	}
+
+	BOOL closeFileDialog(const OPENFILENAMEW* lpofn) override {
+		DWORD threadId = 0;
+		{
+			std::lock_guard<std::mutex> lock(dialogMutex_);
+			for (const OpenDialog& dialog : dialogs_) {
+				if (dialog.lpofn == lpofn) threadId = dialog.threadId;
+			}
+		}
+		if (threadId == 0) return FALSE;
+
+		// ダイアログが作られる前なら見つからないので、呼び出し側で後ほど再試行する
+		BOOL bClosed = FALSE;
+		EnumThreadWindows(threadId, closeDialogProc, (LPARAM)&bClosed);
+		return bClosed;
+	}
+
+private:
+	struct OpenDialog {
+		const OPENFILENAMEW* lpofn;
+		DWORD threadId;
+	};
+
+	BOOL bExpectDesktopWnd_ = FALSE;
+	HWND hDesktopWnd_ = NULL;
+	std::mutex dialogMutex_;
+	std::vector<OpenDialog> dialogs_;		// Dialogs being shown, to close them from another thread
+
+	/// <summary>
+	/// Show the dialog, remembering which thread shows it
+	/// </summary>
+	BOOL runFileDialog(OPENFILENAMEW* lpofn, const BOOL bSave) {
+		{
+			std::lock_guard<std::mutex> lock(dialogMutex_);
+			dialogs_.push_back({ lpofn, GetCurrentThreadId() });
+		}
+
+		BOOL result = (bSave ? GetSaveFileNameW(lpofn) : GetOpenFileNameW(lpofn));
+
+		std::lock_guard<std::mutex> lock(dialogMutex_);
+		for (size_t i = 0; i < dialogs_.size(); i++) {
+			if (dialogs_[i].lpofn == lpofn) {
+				dialogs_.erase(dialogs_.begin() + i);
+				break;
+			}
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Post WM_CLOSE to the dialog windows of the thread. The common dialogs close as cancelled
+	/// </summary>
+	/// <param name="lParam">BOOL* which receives TRUE if a dialog was found</param>
+	static BOOL CALLBACK closeDialogProc(const HWND hWnd, const LPARAM lParam)
+	{
+		WCHAR className[UNIWINC_MAX_CLASSNAME];
+		int len = GetClassName(hWnd, className, UNIWINC_MAX_CLASSNAME);
+
+		if (len > 0 && lstrcmp(TEXT("#32770"), className) == 0) {
+			PostMessageW(hWnd, WM_CLOSE, 0, 0);
+			*(BOOL*)lParam = TRUE;
+		}
+		return TRUE;
+	}
+
+	/// <summary>
+	/// デスクトップのウィンドウハンドルを探す際のコールバック
+	/// </summary>
+	/// <param name="hWnd"></param>
+	/// <param name="lParam">Win32Backend</param>
+	/// <returns></returns>
+	static BOOL CALLBACK findDesktopWindowProc(const HWND hWnd, const LPARAM lParam)
+	{
+		Win32Backend* self = (Win32Backend*)lParam;
+		WCHAR className[UNIWINC_MAX_CLASSNAME];
+		int len = GetClassName(hWnd, className, UNIWINC_MAX_CLASSNAME);
+
+		if (len > 0) {
+			// クラス名が取得でき、WorkerW または Progman ならその子で SHELLDLL_DefView を対象とする
+			// 参考 http://www.orangemaker.sakura.ne.jp/labo/memo/sdk-mfc/win7Desktop.html
+			if ((lstrcmp(TEXT("WorkerW"), className) == 0) || (lstrcmp(TEXT("Progman"), className) == 0)) {
+				if (self->bExpectDesktopWnd_) {
+					self->hDesktopWnd_ = hWnd;
+					return FALSE;
+				}
+
+				HWND hChild = FindWindowEx(hWnd, NULL, TEXT("SHELLDLL_DefView"), NULL);
+				if (hChild != NULL) {
+					self->bExpectDesktopWnd_ = TRUE;
+					return TRUE;
+				}
+			}
+		}
+
+		return TRUE;
+	}
+};
+
+
+/// <summary>
+/// Win32 backend is the default on Windows
+/// </summary>
+/// <returns></returns>
+WindowBackend* getDefaultBackend() {
+	static Win32Backend backend;
+	return &backend;
+}
+
+#endif // _WIN32
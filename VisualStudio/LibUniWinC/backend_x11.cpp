@@ -0,0 +1,1739 @@
+﻿// backend_x11.cpp : X11 (XCB) implementation of WindowBackend
+//
+//   Default backend on Linux. Define UNIWINC_HEADLESS to use the virtual backend instead.
+//   Link with xcb, xcb-shape and xcb-randr.
+//
+//   - One persistent connection is used. Window state is fetched with one batched round trip,
+//     cached, and invalidated by the events (ConfigureNotify, PropertyNotify) or our own requests.
+//   - Window procedures are emulated: the messages which libuniwinc.cpp handles are delivered
+//     from Update() (WM_SIZE, WM_DISPLAYCHANGE, WM_DROPFILES, WM_TIMER) or synchronously (WM_STYLECHANGED, WM_WINDOWPOSCHANGING).
+//   - Works without a window manager (e.g. bare Xvfb). Then the states are applied directly.
+
+#include "pch.h"
+#include "libuniwinc.h"
+#include "backend.h"
+#include "textcodec.h"
+
+#if defined(__linux__) && !defined(UNIWINC_HEADLESS)
+
+#include <xcb/xcb.h>
+#include <xcb/shape.h>
+#include <xcb/randr.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+// Motif window manager hints
+static const uint32_t MWM_HINTS_DECORATIONS = (1 << 1);
+static const uint32_t MWM_DECOR_ALL = (1 << 0);
+
+// ICCCM
+static const uint32_t ICCCM_NORMAL_STATE = 1;
+static const uint32_t ICCCM_ICONIC_STATE = 3;
+static const uint32_t X_STATIC_GRAVITY = 10;
+
+// _NET_WM_STATE actions
+static const uint32_t NET_WM_STATE_REMOVE = 0;
+static const uint32_t NET_WM_STATE_ADD = 1;
+
+// Longest property value to read [32-bit units]
+static const uint32_t MAX_PROPERTY_LENGTH = 0x100000;
+
+// Length of a selection read by a request [32-bit units]. A longer value is read in pieces
+static const uint32_t SELECTION_CHUNK_LENGTH = 0x10000;
+
+// Separator of the paths selected in zenity.
+//   The file chooser returns absolute canonical paths, which never contain "//", whereas a file name may contain '\n'
+static const char* const ZENITY_SEPARATOR = "//";
+
+static inline xcb_window_t toXid(const HWND hWnd) {
+	return (xcb_window_t)(UINT_PTR)hWnd;
+}
+
+static inline HWND toHwnd(const xcb_window_t window) {
+	return (HWND)(UINT_PTR)window;
+}
+
+/// <summary>
+/// Convert UTF-8 to UTF-16
+/// </summary>
+static std::u16string utf8ToUtf16(const std::string& src) {
+	std::u16string result(src.size(), u'\0');
+	result.resize(convertToUtf16(src.data(), src.size(), &result[0]));
+	return result;
+}
+
+/// <summary>
+/// Convert null terminated UTF-16 to UTF-8
+/// </summary>
+static std::string utf16ToUtf8(LPCWSTR src) {
+	std::string result;
+	if (src == nullptr) return result;
+
+	size_t length = 0;
+	while (src[length] != u'\0') length++;
+	appendUtf8(src, length, result);
+	return result;
+}
+
+/// <summary>
+/// Quote the string for /bin/sh
+/// </summary>
+static std::string shellQuote(const std::string& src) {
+	std::string result = "'";
+	for (char c : src) {
+		if (c == '\'') {
+			result += "'\\''";
+		}
+		else {
+			result.push_back(c);
+		}
+	}
+	result += "'";
+	return result;
+}
+
+/// <summary>
+/// Convert a "file://" URI to a local path
+/// </summary>
+static std::string uriToPath(const std::string& uri) {
+	const std::string scheme = "file://";
+	if (uri.compare(0, scheme.size(), scheme) != 0) return std::string();
+
+	// Skip the host name
+	size_t start = uri.find('/', scheme.size());
+	if (start == std::string::npos) return std::string();
+
+	std::string path;
+	for (size_t i = start; i < uri.size(); i++) {
+		if (uri[i] == '%' && (i + 2) < uri.size()) {
+			path.push_back((char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+			i += 2;
+		}
+		else {
+			path.push_back(uri[i]);
+		}
+	}
+	return path;
+}
+
+
+class X11Backend : public WindowBackend {
+public:
+	X11Backend() {
+		connect();
+	}
+
+	~X11Backend() override {
+		if (conn_) {
+			if (helperWnd_ != XCB_NONE) xcb_destroy_window(conn_, helperWnd_);
+			xcb_disconnect(conn_);
+			conn_ = nullptr;
+		}
+	}
+
+	// ---- Process and window lookup ----
+
+	DWORD getCurrentProcessId() override {
+		return (DWORD)getpid();
+	}
+
+	/// <summary>
+	/// Enumerate the managed top-level windows from top to bottom.
+	///   _NET_WM_PID of all windows are fetched in one round trip.
+	/// </summary>
+	BOOL enumWindows(WNDENUMPROC lpEnumFunc, LPARAM lParam) override {
+		if (!conn_) return FALSE;
+
+		std::vector<xcb_window_t> list = getTopLevelWindows();
+
+		// PIDを一括で要求してからまとめて受け取る
+		std::vector<xcb_get_property_cookie_t> cookies;
+		cookies.reserve(list.size());
+		for (xcb_window_t w : list) {
+			cookies.push_back(xcb_get_property(conn_, 0, w, atoms_[NET_WM_PID], XCB_ATOM_CARDINAL, 0, 1));
+		}
+		for (size_t i = 0; i < list.size(); i++) {
+			xcb_get_property_reply_t* reply = xcb_get_property_reply(conn_, cookies[i], nullptr);
+			DWORD pid = 0;
+			if (reply) {
+				if (xcb_get_property_value_length(reply) >= 4) {
+					pid = *(uint32_t*)xcb_get_property_value(reply);
+				}
+				free(reply);
+			}
+			pidCache_[list[i]] = pid;
+		}
+
+		for (xcb_window_t w : list) {
+			if (!lpEnumFunc(toHwnd(w), lParam)) return FALSE;
+		}
+		return TRUE;
+	}
+
+	DWORD getWindowProcessId(HWND hWnd) override {
+		if (!conn_ || !hWnd) return 0;
+
+		auto it = pidCache_.find(toXid(hWnd));
+		if (it != pidCache_.end()) return it->second;
+
+		std::vector<uint32_t> values = getProperty32(toXid(hWnd), atoms_[NET_WM_PID], XCB_ATOM_CARDINAL);
+		DWORD pid = (values.empty() ? 0 : values[0]);
+		pidCache_[toXid(hWnd)] = pid;
+		return pid;
+	}
+
+	HWND getOwnerWindow(HWND hWnd) override {
+		if (!conn_ || !hWnd) return NULL;
+
+		std::vector<uint32_t> values = getProperty32(toXid(hWnd), XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW);
+		return (values.empty() ? NULL : toHwnd(values[0]));
+	}
+
+	HWND getActiveWindow() override {
+		if (!conn_) return NULL;
+
+		if (bWindowManager_) {
+			std::vector<uint32_t> values = getProperty32(root_, atoms_[NET_ACTIVE_WINDOW], XCB_ATOM_WINDOW);
+			return (values.empty() ? NULL : toHwnd(values[0]));
+		}
+
+		xcb_get_input_focus_reply_t* reply = xcb_get_input_focus_reply(conn_, xcb_get_input_focus(conn_), nullptr);
+		if (!reply) return NULL;
+		xcb_window_t focus = reply->focus;
+		free(reply);
+		return (focus > XCB_INPUT_FOCUS_FOLLOW_KEYBOARD ? toHwnd(focus) : NULL);
+	}
+
+	/// <summary>
+	/// The window of _NET_WM_WINDOW_TYPE_DESKTOP
+	/// </summary>
+	HWND findDesktopWindow() override {
+		if (!conn_) return NULL;
+
+		std::vector<xcb_window_t> list = getTopLevelWindows();
+		std::vector<xcb_get_property_cookie_t> cookies;
+		cookies.reserve(list.size());
+		for (xcb_window_t w : list) {
+			cookies.push_back(xcb_get_property(conn_, 0, w, atoms_[NET_WM_WINDOW_TYPE], XCB_ATOM_ATOM, 0, 16));
+		}
+
+		HWND hDesktop = NULL;
+		for (size_t i = 0; i < list.size(); i++) {
+			xcb_get_property_reply_t* reply = xcb_get_property_reply(conn_, cookies[i], nullptr);
+			if (!reply) continue;
+
+			uint32_t* types = (uint32_t*)xcb_get_property_value(reply);
+			int count = xcb_get_property_value_length(reply) / 4;
+			for (int k = 0; k < count; k++) {
+				if (types[k] == atoms_[NET_WM_WINDOW_TYPE_DESKTOP] && hDesktop == NULL) {
+					hDesktop = toHwnd(list[i]);
+				}
+			}
+			free(reply);
+		}
+		return hDesktop;
+	}
+
+	HWND setParent(HWND hWnd, HWND hParent) override {
+		if (!conn_ || !hWnd) return NULL;
+
+		xcb_window_t previous = XCB_NONE;
+		xcb_query_tree_reply_t* tree = xcb_query_tree_reply(conn_, xcb_query_tree(conn_, toXid(hWnd)), nullptr);
+		if (tree) {
+			previous = tree->parent;
+			free(tree);
+		}
+
+		xcb_reparent_window(conn_, toXid(hWnd), (hParent ? toXid(hParent) : root_), 0, 0);
+		invalidate(toXid(hWnd));
+		xcb_flush(conn_);
+		return ((previous == root_ || previous == XCB_NONE) ? NULL : toHwnd(previous));
+	}
+
+	// ---- Window state ----
+
+	BOOL isWindow(HWND hWnd) override {
+		if (!conn_ || !hWnd) return FALSE;
+
+		auto it = windows_.find(toXid(hWnd));
+		if (it != windows_.end() && it->second.bCacheValid) return TRUE;
+
+		xcb_get_window_attributes_reply_t* reply = xcb_get_window_attributes_reply(conn_, xcb_get_window_attributes(conn_, toXid(hWnd)), nullptr);
+		if (!reply) return FALSE;
+		free(reply);
+		return TRUE;
+	}
+
+	BOOL isZoomed(HWND hWnd) override {
+		X11Window* w = fetch(hWnd);
+		return (w && w->bMaximized);
+	}
+
+	BOOL isIconic(HWND hWnd) override {
+		X11Window* w = fetch(hWnd);
+		return (w && w->bMinimized);
+	}
+
+	BOOL isWindowVisible(HWND hWnd) override {
+		X11Window* w = fetch(hWnd);
+		return (w && (w->bViewable || w->bMinimized));
+	}
+
+	/// <summary>
+	/// Emulate ShowWindow()
+	/// </summary>
+	BOOL showWindow(HWND hWnd, INT nCmdShow) override {
+		X11Window* w = fetch(hWnd);
+		if (!w) return FALSE;
+
+		xcb_window_t window = toXid(hWnd);
+		BOOL bWasVisible = (w->bViewable || w->bMinimized);
+
+		switch (nCmdShow) {
+		case SW_HIDE:
+			xcb_unmap_window(conn_, window);
+			break;
+
+		case SW_SHOW:
+			xcb_map_window(conn_, window);
+			break;
+
+		case SW_MAXIMIZE:
+			if (w->bMinimized) restoreFromIconic(window, *w);
+			if (bWindowManager_) {
+				changeNetWmState(window, NET_WM_STATE_ADD, atoms_[NET_WM_STATE_MAXIMIZED_VERT], atoms_[NET_WM_STATE_MAXIMIZED_HORZ]);
+			}
+			else if (!w->bMaximized) {
+				// ウィンドウマネージャが無ければ自前でモニタ全体に広げる
+				w->normalRect = w->rcWindow;
+				RECT mr = getMonitorRectFor(w->rcWindow);
+				configure(window, mr.left, mr.top, mr.right - mr.left, mr.bottom - mr.top);
+				changeNetWmState(window, NET_WM_STATE_ADD, atoms_[NET_WM_STATE_MAXIMIZED_VERT], atoms_[NET_WM_STATE_MAXIMIZED_HORZ]);
+			}
+			break;
+
+		case SW_MINIMIZE:
+			if (bWindowManager_) {
+				xcb_client_message_event_t ev = makeClientMessage(window, atoms_[WM_CHANGE_STATE]);
+				ev.data.data32[0] = ICCCM_ICONIC_STATE;
+				sendToRoot(ev);
+			}
+			else {
+				changeNetWmState(window, NET_WM_STATE_ADD, atoms_[NET_WM_STATE_HIDDEN], XCB_NONE);
+				xcb_unmap_window(conn_, window);
+			}
+			break;
+
+		case SW_NORMAL:
+		case SW_RESTORE:
+		default:
+			if (w->bMinimized) {
+				restoreFromIconic(window, *w);
+			}
+			else if (!w->bViewable) {
+				xcb_map_window(conn_, window);
+			}
+			if (w->bMaximized) {
+				changeNetWmState(window, NET_WM_STATE_REMOVE, atoms_[NET_WM_STATE_MAXIMIZED_VERT], atoms_[NET_WM_STATE_MAXIMIZED_HORZ]);
+				if (!bWindowManager_) {
+					const RECT& r = w->normalRect;
+					configure(window, r.left, r.top, r.right - r.left, r.bottom - r.top);
+				}
+			}
+			break;
+		}
+
+		invalidate(window);
+		xcb_flush(conn_);
+		return bWasVisible;
+	}
+
+	LONG getWindowLong(HWND hWnd, INT nIndex) override {
+		X11Window* w = fetch(hWnd);
+		if (!w) return 0;
+
+		switch (nIndex) {
+		case GWL_STYLE:
+			return w->style | ((w->bViewable || w->bMinimized) ? WS_VISIBLE : 0);
+		case GWL_EXSTYLE:
+			return (w->exStyle & ~WS_EX_TOPMOST) | (w->bAbove ? WS_EX_TOPMOST : 0);
+		default:
+			return 0;
+		}
+	}
+
+	/// <summary>
+	/// Emulate SetWindowLong(). Styles are translated into Motif hints, input shape and XDND properties.
+	/// </summary>
+	LONG setWindowLong(HWND hWnd, INT nIndex, LONG dwNewLong) override {
+		X11Window* w = fetch(hWnd);
+		if (!w) return 0;
+
+		xcb_window_t window = toXid(hWnd);
+		LONG previous = 0;
+
+		if (nIndex == GWL_STYLE) {
+			previous = w->style;
+			w->style = (dwNewLong & ~WS_VISIBLE);
+
+			BOOL bDecorated = (((dwNewLong & WS_CAPTION) == WS_CAPTION) || (dwNewLong & WS_THICKFRAME));
+			BOOL bWasDecorated = (((previous & WS_CAPTION) == WS_CAPTION) || (previous & WS_THICKFRAME));
+			if (bDecorated != bWasDecorated) {
+				uint32_t hints[5] = { MWM_HINTS_DECORATIONS, 0, (bDecorated ? MWM_DECOR_ALL : 0), 0, 0 };
+				xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, window, atoms_[MOTIF_WM_HINTS], atoms_[MOTIF_WM_HINTS], 32, 5, hints);
+			}
+			if ((dwNewLong & WS_VISIBLE) && !w->bViewable && !w->bMinimized) {
+				xcb_map_window(conn_, window);
+			}
+		}
+		else if (nIndex == GWL_EXSTYLE) {
+			previous = w->exStyle;
+			w->exStyle = dwNewLong;
+
+			if ((previous ^ dwNewLong) & WS_EX_TRANSPARENT) {
+				setInputPassThrough(window, *w, (dwNewLong & WS_EX_TRANSPARENT) != 0);
+			}
+			if ((previous ^ dwNewLong) & WS_EX_ACCEPTFILES) {
+				dragAcceptFiles(hWnd, (dwNewLong & WS_EX_ACCEPTFILES) != 0);
+			}
+		}
+		else {
+			return 0;
+		}
+
+		invalidate(window);
+		xcb_flush(conn_);
+
+		sendMessage(window, WM_STYLECHANGED, (WPARAM)nIndex, 0);
+		return previous;
+	}
+
+	BOOL getWindowInfo(HWND hWnd, WINDOWINFO* pwi) override {
+		X11Window* w = fetch(hWnd);
+		if (!w || !pwi) return FALSE;
+
+		pwi->cbSize = sizeof(WINDOWINFO);
+		pwi->rcWindow = w->rcWindow;
+		pwi->rcClient = w->rcClient;
+		pwi->dwStyle = (DWORD)getWindowLong(hWnd, GWL_STYLE);
+		pwi->dwExStyle = (DWORD)getWindowLong(hWnd, GWL_EXSTYLE);
+		pwi->dwWindowStatus = 0;
+		pwi->cxWindowBorders = (UINT)(w->rcClient.left - w->rcWindow.left);
+		pwi->cyWindowBorders = (UINT)(w->rcWindow.bottom - w->rcClient.bottom);
+		pwi->atomWindowType = 0;
+		pwi->wCreatorVersion = 0;
+		return TRUE;
+	}
+
+	BOOL getWindowPlacement(HWND hWnd, WINDOWPLACEMENT* lpwndpl) override {
+		X11Window* w = fetch(hWnd);
+		if (!w || !lpwndpl) return FALSE;
+
+		lpwndpl->length = sizeof(WINDOWPLACEMENT);
+		lpwndpl->flags = 0;
+		lpwndpl->showCmd = (w->bMinimized ? SW_MINIMIZE : (w->bMaximized ? SW_MAXIMIZE : SW_SHOWNORMAL));
+		lpwndpl->ptMinPosition = { -1, -1 };
+		lpwndpl->ptMaxPosition = { -1, -1 };
+		lpwndpl->rcNormalPosition = ((w->bMinimized || w->bMaximized) ? w->normalRect : w->rcWindow);
+		return TRUE;
+	}
+
+	BOOL setWindowPlacement(HWND hWnd, const WINDOWPLACEMENT* lpwndpl) override {
+		X11Window* w = fetch(hWnd);
+		if (!w || !lpwndpl) return FALSE;
+
+		const RECT& r = lpwndpl->rcNormalPosition;
+		if (lpwndpl->showCmd == SW_SHOWNORMAL) {
+			if (w->bMaximized || w->bMinimized) showWindow(hWnd, SW_RESTORE);
+			return setWindowPos(hWnd, NULL, r.left, r.top, r.right - r.left, r.bottom - r.top, SWP_NOZORDER | SWP_NOACTIVATE);
+		}
+
+		w->normalRect = r;
+		showWindow(hWnd, (INT)lpwndpl->showCmd);
+		return TRUE;
+	}
+
+	BOOL hasMenu(HWND /*hWnd*/) override {
+		return FALSE;
+	}
+
+	// ---- Window geometry ----
+
+	BOOL getWindowRect(HWND hWnd, RECT* lpRect) override {
+		X11Window* w = fetch(hWnd);
+		if (!w || !lpRect) return FALSE;
+
+		*lpRect = w->rcWindow;
+		return TRUE;
+	}
+
+	BOOL getClientRect(HWND hWnd, RECT* lpRect) override {
+		X11Window* w = fetch(hWnd);
+		if (!w || !lpRect) return FALSE;
+
+		*lpRect = { 0, 0, w->rcClient.right - w->rcClient.left, w->rcClient.bottom - w->rcClient.top };
+		return TRUE;
+	}
+
+	/// <summary>
+	/// Emulate SetWindowPos(). The position and size include the frame as on Windows.
+	/// </summary>
+	BOOL setWindowPos(HWND hWnd, HWND hWndInsertAfter, INT x, INT y, INT cx, INT cy, UINT uFlags) override {
+		X11Window* w = fetch(hWnd);
+		if (!w) return FALSE;
+
+		xcb_window_t window = toXid(hWnd);
+
+		WINDOWPOS wp = { hWnd, hWndInsertAfter, x, y, cx, cy, uFlags };
+		if (!(uFlags & SWP_NOSENDCHANGING)) {
+			sendMessage(window, WM_WINDOWPOSCHANGING, 0, (LPARAM)&wp);
+		}
+
+		if (!(wp.flags & SWP_NOZORDER)) {
+			restack(window, wp.hwndInsertAfter);
+		}
+
+		if (!(wp.flags & SWP_NOMOVE) || !(wp.flags & SWP_NOSIZE)) {
+			RECT r = w->rcWindow;
+			if (!(wp.flags & SWP_NOMOVE)) {
+				r = { wp.x, wp.y, wp.x + (r.right - r.left), wp.y + (r.bottom - r.top) };
+			}
+			if (!(wp.flags & SWP_NOSIZE)) {
+				r.right = r.left + wp.cx;
+				r.bottom = r.top + wp.cy;
+			}
+			configure(window, r.left, r.top, r.right - r.left, r.bottom - r.top);
+		}
+
+		if (wp.flags & SWP_SHOWWINDOW) xcb_map_window(conn_, window);
+		if (wp.flags & SWP_HIDEWINDOW) xcb_unmap_window(conn_, window);
+
+		invalidate(window);
+		xcb_flush(conn_);
+
+		sendMessage(window, WM_WINDOWPOSCHANGED, 0, (LPARAM)&wp);
+		return TRUE;
+	}
+
+	/// <summary>
+	/// Emulate AdjustWindowRect() with the frame extents last reported by the window manager
+	/// </summary>
+	BOOL adjustWindowRect(RECT* lpRect, DWORD dwStyle, BOOL /*bMenu*/) override {
+		if (!lpRect) return FALSE;
+
+		if (((dwStyle & WS_CAPTION) == WS_CAPTION) || (dwStyle & WS_THICKFRAME)) {
+			lpRect->left -= frameExtents_.left;
+			lpRect->top -= frameExtents_.top;
+			lpRect->right += frameExtents_.right;
+			lpRect->bottom += frameExtents_.bottom;
+		}
+		return TRUE;
+	}
+
+	BOOL screenToClient(HWND hWnd, POINT* lpPoint) override {
+		X11Window* w = fetch(hWnd);
+		if (!w || !lpPoint) return FALSE;
+
+		lpPoint->x -= w->rcClient.left;
+		lpPoint->y -= w->rcClient.top;
+		return TRUE;
+	}
+
+	// ---- Transparency ----
+
+	/// <summary>
+	/// Only the alpha is supported via _NET_WM_WINDOW_OPACITY. Color key is not available on X11.
+	/// </summary>
+	BOOL setLayeredWindowAttributes(HWND hWnd, COLORREF /*crKey*/, BYTE bAlpha, DWORD dwFlags) override {
+		if (!conn_ || !hWnd) return FALSE;
+
+		xcb_window_t window = toXid(hWnd);
+		if ((dwFlags & LWA_ALPHA) && bAlpha < 0xFF) {
+			uint32_t opacity = (uint32_t)(((uint64_t)bAlpha * 0xFFFFFFFFu) / 0xFF);
+			xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, window, atoms_[NET_WM_WINDOW_OPACITY], XCB_ATOM_CARDINAL, 32, 1, &opacity);
+		}
+		else {
+			xcb_delete_property(conn_, window, atoms_[NET_WM_WINDOW_OPACITY]);
+		}
+		xcb_flush(conn_);
+		return ((dwFlags & LWA_COLORKEY) == 0);
+	}
+
+	/// <summary>
+	/// Per-pixel alpha depends on the 32-bit visual chosen when the window was created and a compositor.
+	///   There is nothing to change afterwards.
+	/// </summary>
+	BOOL extendFrameIntoClientArea(HWND /*hWnd*/, BOOL /*bEntireWindow*/) override {
+		return (conn_ != nullptr);
+	}
+
+	/// <summary>
+	/// Set the input shape of the window. The drawing is not clipped
+	/// </summary>
+	BOOL setInputRegion(HWND hWnd, const RECT* lpRects, UINT count) override {
+		xcb_window_t window = toXid(hWnd);
+		X11Window* w = track(window);
+		if (!w || !bShape_) return FALSE;
+
+		w->bInputRegion = (lpRects != NULL);
+		w->inputRects.clear();
+		if (lpRects != NULL) {
+			w->inputRects.reserve(count);
+			for (UINT i = 0; i < count; i++) {
+				const RECT& r = lpRects[i];
+				xcb_rectangle_t rect = { (int16_t)r.left, (int16_t)r.top, (uint16_t)(r.right - r.left), (uint16_t)(r.bottom - r.top) };
+				w->inputRects.push_back(rect);
+			}
+		}
+
+		// WS_EX_TRANSPARENT の間は入力を受けない形状のままにし、解除時に適用する
+		if (!(w->exStyle & WS_EX_TRANSPARENT)) {
+			setInputPassThrough(window, *w, FALSE);
+		}
+		xcb_flush(conn_);
+		return TRUE;
+	}
+
+	// ---- Monitors ----
+
+	BOOL enumDisplayMonitors(MONITORENUMPROC lpfnEnum, LPARAM dwData) override {
+		if (!conn_) return FALSE;
+
+		if (!bMonitorsValid_) {
+			updateMonitors();
+		}
+
+		for (size_t i = 0; i < monitors_.size(); i++) {
+			RECT rect = monitors_[i];
+			if (!lpfnEnum((HMONITOR)(UINT_PTR)(i + 1), NULL, &rect, dwData)) break;
+		}
+		return TRUE;
+	}
+
+	// ---- Mouse cursor ----
+
+	BOOL getCursorPos(POINT* lpPoint) override {
+		if (!conn_ || !lpPoint) return FALSE;
+
+		xcb_query_pointer_reply_t* reply = xcb_query_pointer_reply(conn_, xcb_query_pointer(conn_, root_), nullptr);
+		if (!reply) return FALSE;
+
+		lpPoint->x = reply->root_x;
+		lpPoint->y = reply->root_y;
+		free(reply);
+		return TRUE;
+	}
+
+	BOOL isPrimaryButtonDown() override {
+		if (!conn_) return FALSE;
+
+		// The button mapping is applied by the server, so button 1 is the primary button
+		xcb_query_pointer_reply_t* reply = xcb_query_pointer_reply(conn_, xcb_query_pointer(conn_, root_), nullptr);
+		if (!reply) return FALSE;
+
+		const BOOL bDown = ((reply->mask & XCB_BUTTON_MASK_1) != 0);
+		free(reply);
+		return bDown;
+	}
+
+	BOOL setCursorPos(INT x, INT y) override {
+		if (!conn_) return FALSE;
+
+		xcb_warp_pointer(conn_, XCB_NONE, root_, 0, 0, 0, 0, (int16_t)x, (int16_t)y);
+		xcb_flush(conn_);
+		return TRUE;
+	}
+
+	// ---- File drop (XDND) ----
+
+	/// <summary>
+	/// Make the window an XDND target. The messages are redirected to our helper window with XdndProxy,
+	///   because client messages are only delivered to the client which created the window.
+	/// </summary>
+	void dragAcceptFiles(HWND hWnd, BOOL fAccept) override {
+		if (!conn_ || !hWnd) return;
+
+		xcb_window_t window = toXid(hWnd);
+		if (fAccept) {
+			uint32_t version = XDND_VERSION;
+			xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, window, atoms_[XDND_AWARE], XCB_ATOM_ATOM, 32, 1, &version);
+			xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, window, atoms_[XDND_PROXY], XCB_ATOM_WINDOW, 32, 1, &helperWnd_);
+			dropTarget_ = window;
+		}
+		else {
+			xcb_delete_property(conn_, window, atoms_[XDND_AWARE]);
+			xcb_delete_property(conn_, window, atoms_[XDND_PROXY]);
+			if (dropTarget_ == window) dropTarget_ = XCB_NONE;
+		}
+		xcb_flush(conn_);
+	}
+
+	UINT dragQueryFile(HDROP hDrop, UINT iFile, LPWSTR lpszFile, UINT cch) override {
+		X11Drop* drop = (X11Drop*)hDrop;
+		if (!drop) return 0;
+
+		if (iFile == 0xFFFFFFFF) {
+			return (UINT)drop->paths.size();
+		}
+		if (iFile >= drop->paths.size()) return 0;
+
+		const std::u16string& path = drop->paths[iFile];
+		if (lpszFile == nullptr) {
+			return (UINT)path.size();
+		}
+		if (cch == 0) return 0;
+
+		UINT length = (UINT)std::min<size_t>(path.size(), cch - 1);
+		memcpy(lpszFile, path.data(), length * sizeof(WCHAR));
+		lpszFile[length] = u'\0';
+		return length;
+	}
+
+	void dragFinish(HDROP hDrop) override {
+		delete (X11Drop*)hDrop;
+	}
+
+	// ---- Window procedure ----
+
+	WNDPROC setWindowProcedure(HWND hWnd, WNDPROC lpWndProc) override {
+		X11Window* w = track(toXid(hWnd));
+		if (!w) return NULL;
+
+		WNDPROC previous = w->wndProc;
+		w->wndProc = lpWndProc;
+		return previous;
+	}
+
+	LRESULT callWindowProc(WNDPROC lpPrevWndFunc, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) override {
+		if (lpPrevWndFunc == NULL) {
+			return defWindowProc(hWnd, uMsg, wParam, lParam);
+		}
+		return lpPrevWndFunc(hWnd, uMsg, wParam, lParam);
+	}
+
+	LRESULT defWindowProc(HWND /*hWnd*/, UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/) override {
+		return 0;
+	}
+
+	// ---- Timers ----
+
+	/// <summary>
+	/// Emulate SetTimer(). WM_TIMER is delivered from update(), so the resolution is the frame interval
+	/// </summary>
+	BOOL setTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse) override {
+		if (!hWnd) return FALSE;
+
+		killTimer(hWnd, nIDEvent);
+		timers_.push_back({ toXid(hWnd), nIDEvent, std::chrono::milliseconds(uElapse), std::chrono::steady_clock::now() + std::chrono::milliseconds(uElapse) });
+		return TRUE;
+	}
+
+	BOOL killTimer(HWND hWnd, UINT_PTR nIDEvent) override {
+		xcb_window_t window = toXid(hWnd);
+		auto it = std::find_if(timers_.begin(), timers_.end(), [window, nIDEvent](const X11Timer& t) { return (t.window == window && t.id == nIDEvent); });
+		if (it == timers_.end()) return FALSE;
+
+		timers_.erase(it);
+		return TRUE;
+	}
+
+	// ---- File dialogs ----
+
+	BOOL getOpenFileName(OPENFILENAMEW* lpofn) override {
+		return runFileDialog(lpofn, FALSE, nullptr);
+	}
+
+	BOOL getSaveFileName(OPENFILENAMEW* lpofn) override {
+		return runFileDialog(lpofn, TRUE, nullptr);
+	}
+
+	BOOL getFileNames(OPENFILENAMEW* lpofn, const BOOL bSave, std::vector<WCHAR>& buffer) override {
+		return runFileDialog(lpofn, bSave, &buffer);
+	}
+
+	/// <summary>
+	/// Terminate the zenity of the dialog and its process group, which then closes as cancelled
+	/// </summary>
+	/// <returns>FALSE if zenity is not started yet. The caller retries later</returns>
+	BOOL closeFileDialog(const OPENFILENAMEW* lpofn) override {
+		std::lock_guard<std::mutex> lock(dialogMutex_);
+		for (const ZenityDialog& dialog : dialogs_) {
+			// 子プロセスは登録を外してから回収するので、ここで pid が再利用されていることはない
+			if (dialog.lpofn == lpofn) return (kill(-dialog.pid, SIGTERM) == 0);
+		}
+		return FALSE;
+	}
+
+	// ---- Events ----
+
+	/// <summary>
+	/// Process the queued X events and deliver them as window messages
+	/// </summary>
+	void update() override {
+		if (!conn_) return;
+
+		xcb_generic_event_t* event;
+		while ((event = xcb_poll_for_event(conn_)) != nullptr) {
+			handleEvent(event);
+			free(event);
+		}
+
+		fireTimers();
+	}
+
+private:
+	static const uint32_t XDND_VERSION = 5;
+	static const uint32_t XDND_MIN_VERSION = 3;		// Sources older than this are ignored
+
+	enum AtomIndex : int {
+		WM_STATE = 0,
+		WM_CHANGE_STATE,
+		NET_SUPPORTING_WM_CHECK,
+		NET_CLIENT_LIST_STACKING,
+		NET_ACTIVE_WINDOW,
+		NET_WM_PID,
+		NET_WM_STATE,
+		NET_WM_STATE_ABOVE,
+		NET_WM_STATE_BELOW,
+		NET_WM_STATE_MAXIMIZED_VERT,
+		NET_WM_STATE_MAXIMIZED_HORZ,
+		NET_WM_STATE_HIDDEN,
+		NET_FRAME_EXTENTS,
+		NET_MOVERESIZE_WINDOW,
+		NET_WM_WINDOW_OPACITY,
+		NET_WM_WINDOW_TYPE,
+		NET_WM_WINDOW_TYPE_DESKTOP,
+		MOTIF_WM_HINTS,
+		XDND_AWARE,
+		XDND_PROXY,
+		XDND_ENTER,
+		XDND_POSITION,
+		XDND_STATUS,
+		XDND_LEAVE,
+		XDND_DROP,
+		XDND_FINISHED,
+		XDND_SELECTION,
+		XDND_ACTION_COPY,
+		TEXT_URI_LIST,
+		XDND_TYPE_LIST,
+		INCR,
+		UNIWINC_DROP,
+		ATOM_COUNT
+	};
+
+	/// <summary>
+	/// Emulated Win32 state and the cached X state of a window
+	/// </summary>
+	struct X11Window {
+		LONG style = 0;
+		LONG exStyle = 0;
+		WNDPROC wndProc = NULL;
+
+		BOOL bCacheValid = FALSE;
+		RECT rcWindow = { 0, 0, 0, 0 };		// Including the frame, in screen coordinates
+		RECT rcClient = { 0, 0, 0, 0 };		// In screen coordinates
+		RECT normalRect = { 0, 0, 0, 0 };	// Rectangle to restore
+		BOOL bViewable = FALSE;
+		BOOL bMaximized = FALSE;
+		BOOL bMinimized = FALSE;
+		BOOL bAbove = FALSE;
+
+		// Input shape set by setInputRegion()
+		BOOL bInputRegion = FALSE;
+		std::vector<xcb_rectangle_t> inputRects;
+
+		// Last state notified with WM_SIZE
+		LONG lastWidth = -1;
+		LONG lastHeight = -1;
+		WPARAM lastSizeType = SIZE_RESTORED;
+	};
+
+	struct X11Timer {
+		xcb_window_t window;
+		UINT_PTR id;
+		std::chrono::milliseconds interval;
+		std::chrono::steady_clock::time_point due;
+	};
+
+	struct X11Drop {
+		std::vector<std::u16string> paths;
+	};
+
+	struct ZenityDialog {
+		const OPENFILENAMEW* lpofn;
+		pid_t pid;
+	};
+
+	xcb_connection_t* conn_ = nullptr;
+	xcb_window_t root_ = XCB_NONE;
+	xcb_window_t helperWnd_ = XCB_NONE;		// XDND proxy and selection requestor
+	xcb_atom_t atoms_[ATOM_COUNT] = {};
+	BOOL bWindowManager_ = FALSE;
+	BOOL bShape_ = FALSE;
+	BOOL bRandr_ = FALSE;
+	uint8_t randrFirstEvent_ = 0;
+	RECT rootRect_ = { 0, 0, 0, 0 };
+	RECT frameExtents_ = { 0, 0, 0, 0 };	// left, top, right, bottom of the last decorated window
+
+	std::unordered_map<xcb_window_t, X11Window> windows_;
+	std::unordered_map<xcb_window_t, DWORD> pidCache_;
+	std::vector<RECT> monitors_;
+	BOOL bMonitorsValid_ = FALSE;
+
+	std::vector<X11Timer> timers_;
+
+	xcb_window_t dropTarget_ = XCB_NONE;
+	xcb_window_t dropSource_ = XCB_NONE;		// Source of the drag which has entered, or XCB_NONE if ignored
+	BOOL bDropUriList_ = FALSE;				// The source offers "text/uri-list"
+	BOOL bDropIncr_ = FALSE;				// The selection is being received by INCR
+	std::string dropData_;					// "text/uri-list" received so far
+
+	std::mutex dialogMutex_;
+	std::vector<ZenityDialog> dialogs_;		// Dialogs being shown, to close them from another thread
+
+	/// <summary>
+	/// Open the connection, intern atoms and query extensions in a batch
+	/// </summary>
+	void connect() {
+		int screenNumber = 0;
+		conn_ = xcb_connect(nullptr, &screenNumber);
+		if (xcb_connection_has_error(conn_)) {
+			xcb_disconnect(conn_);
+			conn_ = nullptr;
+			return;
+		}
+
+		xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(conn_));
+		for (int i = 0; i < screenNumber && it.rem; i++) {
+			xcb_screen_next(&it);
+		}
+		root_ = it.data->root;
+		rootRect_ = { 0, 0, it.data->width_in_pixels, it.data->height_in_pixels };
+
+		static const char* names[ATOM_COUNT] = {
+			"WM_STATE", "WM_CHANGE_STATE",
+			"_NET_SUPPORTING_WM_CHECK", "_NET_CLIENT_LIST_STACKING", "_NET_ACTIVE_WINDOW", "_NET_WM_PID",
+			"_NET_WM_STATE", "_NET_WM_STATE_ABOVE", "_NET_WM_STATE_BELOW",
+			"_NET_WM_STATE_MAXIMIZED_VERT", "_NET_WM_STATE_MAXIMIZED_HORZ", "_NET_WM_STATE_HIDDEN",
+			"_NET_FRAME_EXTENTS", "_NET_MOVERESIZE_WINDOW", "_NET_WM_WINDOW_OPACITY",
+			"_NET_WM_WINDOW_TYPE", "_NET_WM_WINDOW_TYPE_DESKTOP", "_MOTIF_WM_HINTS",
+			"XdndAware", "XdndProxy", "XdndEnter", "XdndPosition", "XdndStatus", "XdndLeave",
+			"XdndDrop", "XdndFinished", "XdndSelection", "XdndActionCopy", "text/uri-list",
+			"XdndTypeList", "INCR", "UNIWINC_DROP",
+		};
+
+		// 全てのアトムを一括で要求してから受け取る
+		xcb_intern_atom_cookie_t cookies[ATOM_COUNT];
+		for (int i = 0; i < ATOM_COUNT; i++) {
+			cookies[i] = xcb_intern_atom(conn_, 0, (uint16_t)strlen(names[i]), names[i]);
+		}
+		for (int i = 0; i < ATOM_COUNT; i++) {
+			xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(conn_, cookies[i], nullptr);
+			atoms_[i] = (reply ? reply->atom : (xcb_atom_t)XCB_ATOM_NONE);
+			free(reply);
+		}
+
+		bWindowManager_ = !getProperty32(root_, atoms_[NET_SUPPORTING_WM_CHECK], XCB_ATOM_WINDOW).empty();
+
+		const xcb_query_extension_reply_t* shape = xcb_get_extension_data(conn_, &xcb_shape_id);
+		bShape_ = (shape && shape->present);
+
+		const xcb_query_extension_reply_t* randr = xcb_get_extension_data(conn_, &xcb_randr_id);
+		bRandr_ = (randr && randr->present);
+		if (bRandr_) {
+			randrFirstEvent_ = randr->first_event;
+			xcb_randr_select_input(conn_, root_, XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE);
+		}
+
+		// XDNDのプロキシおよびセレクションの受け取りに使う不可視ウィンドウ
+		helperWnd_ = xcb_generate_id(conn_);
+		uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+		xcb_create_window(conn_, XCB_COPY_FROM_PARENT, helperWnd_, root_, -1, -1, 1, 1, 0,
+			XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, &mask);
+		uint32_t version = XDND_VERSION;
+		xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, helperWnd_, atoms_[XDND_AWARE], XCB_ATOM_ATOM, 32, 1, &version);
+		xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, helperWnd_, atoms_[XDND_PROXY], XCB_ATOM_WINDOW, 32, 1, &helperWnd_);
+
+		xcb_flush(conn_);
+	}
+
+	/// <summary>
+	/// Get a property of 32-bit values
+	/// </summary>
+	std::vector<uint32_t> getProperty32(xcb_window_t window, xcb_atom_t property, xcb_atom_t type) {
+		std::vector<uint32_t> values;
+		xcb_get_property_reply_t* reply = xcb_get_property_reply(conn_, xcb_get_property(conn_, 0, window, property, type, 0, MAX_PROPERTY_LENGTH), nullptr);
+		if (reply) {
+			if (reply->format == 32) {
+				uint32_t* data = (uint32_t*)xcb_get_property_value(reply);
+				values.assign(data, data + xcb_get_property_value_length(reply) / 4);
+			}
+			free(reply);
+		}
+		return values;
+	}
+
+	/// <summary>
+	/// Managed top-level windows from top to bottom
+	/// </summary>
+	std::vector<xcb_window_t> getTopLevelWindows() {
+		std::vector<xcb_window_t> list;
+		if (bWindowManager_) {
+			std::vector<uint32_t> stacking = getProperty32(root_, atoms_[NET_CLIENT_LIST_STACKING], XCB_ATOM_WINDOW);
+			list.assign(stacking.rbegin(), stacking.rend());
+		}
+		else {
+			xcb_query_tree_reply_t* tree = xcb_query_tree_reply(conn_, xcb_query_tree(conn_, root_), nullptr);
+			if (tree) {
+				xcb_window_t* children = xcb_query_tree_children(tree);
+				int count = xcb_query_tree_children_length(tree);
+				for (int i = count - 1; i >= 0; i--) {
+					if (children[i] != helperWnd_) list.push_back(children[i]);
+				}
+				free(tree);
+			}
+		}
+		return list;
+	}
+
+	/// <summary>
+	/// Start tracking the window. Its events are selected and the initial style is read.
+	/// </summary>
+	X11Window* track(xcb_window_t window) {
+		if (!conn_ || window == XCB_NONE) return nullptr;
+
+		auto it = windows_.find(window);
+		if (it != windows_.end()) return &(it->second);
+
+		// イベントマスクはクライアントごとなので、他のクライアントのウィンドウにも設定できる
+		uint32_t mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
+		xcb_void_cookie_t cookie = xcb_change_window_attributes_checked(conn_, window, XCB_CW_EVENT_MASK, &mask);
+		xcb_generic_error_t* error = xcb_request_check(conn_, cookie);
+		if (error) {
+			free(error);
+			return nullptr;
+		}
+
+		X11Window& w = windows_[window];
+		std::vector<uint32_t> hints = getProperty32(window, atoms_[MOTIF_WM_HINTS], atoms_[MOTIF_WM_HINTS]);
+		BOOL bBorderless = (hints.size() >= 3 && (hints[0] & MWM_HINTS_DECORATIONS) && hints[2] == 0);
+		w.style = (bBorderless ? (LONG)WS_POPUP : (LONG)WS_OVERLAPPEDWINDOW);
+		return &w;
+	}
+
+	/// <summary>
+	/// Get the tracked window with up-to-date state
+	/// </summary>
+	X11Window* fetch(HWND hWnd) {
+		X11Window* w = track(toXid(hWnd));
+		if (w && !w->bCacheValid) {
+			refresh(toXid(hWnd), *w);
+		}
+		return w;
+	}
+
+	void invalidate(xcb_window_t window) {
+		auto it = windows_.find(window);
+		if (it != windows_.end()) it->second.bCacheValid = FALSE;
+	}
+
+	/// <summary>
+	/// Read the geometry and the states in one round trip
+	/// </summary>
+	BOOL refresh(xcb_window_t window, X11Window& w) {
+		xcb_get_geometry_cookie_t geometryCookie = xcb_get_geometry(conn_, window);
+		xcb_translate_coordinates_cookie_t originCookie = xcb_translate_coordinates(conn_, window, root_, 0, 0);
+		xcb_get_window_attributes_cookie_t attributesCookie = xcb_get_window_attributes(conn_, window);
+		xcb_get_property_cookie_t stateCookie = xcb_get_property(conn_, 0, window, atoms_[NET_WM_STATE], XCB_ATOM_ATOM, 0, 32);
+		xcb_get_property_cookie_t extentsCookie = xcb_get_property(conn_, 0, window, atoms_[NET_FRAME_EXTENTS], XCB_ATOM_CARDINAL, 0, 4);
+		xcb_get_property_cookie_t wmStateCookie = xcb_get_property(conn_, 0, window, atoms_[WM_STATE], atoms_[WM_STATE], 0, 2);
+
+		xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(conn_, geometryCookie, nullptr);
+		xcb_translate_coordinates_reply_t* origin = xcb_translate_coordinates_reply(conn_, originCookie, nullptr);
+		xcb_get_window_attributes_reply_t* attributes = xcb_get_window_attributes_reply(conn_, attributesCookie, nullptr);
+		xcb_get_property_reply_t* state = xcb_get_property_reply(conn_, stateCookie, nullptr);
+		xcb_get_property_reply_t* extents = xcb_get_property_reply(conn_, extentsCookie, nullptr);
+		xcb_get_property_reply_t* wmState = xcb_get_property_reply(conn_, wmStateCookie, nullptr);
+
+		BOOL result = (geometry && origin && attributes);
+		if (result) {
+			w.rcClient = { origin->dst_x, origin->dst_y, origin->dst_x + geometry->width, origin->dst_y + geometry->height };
+			w.bViewable = (attributes->map_state == XCB_MAP_STATE_VIEWABLE);
+
+			RECT frame = { 0, 0, 0, 0 };
+			if (extents && xcb_get_property_value_length(extents) >= 16) {
+				uint32_t* e = (uint32_t*)xcb_get_property_value(extents);
+				frame = { (LONG)e[0], (LONG)e[2], (LONG)e[1], (LONG)e[3] };
+				if (frame.left || frame.top || frame.right || frame.bottom) frameExtents_ = frame;
+			}
+			w.rcWindow = {
+				w.rcClient.left - frame.left, w.rcClient.top - frame.top,
+				w.rcClient.right + frame.right, w.rcClient.bottom + frame.bottom
+			};
+
+			w.bMaximized = FALSE;
+			w.bAbove = FALSE;
+			BOOL bHidden = FALSE;
+			BOOL bVert = FALSE, bHorz = FALSE;
+			if (state) {
+				uint32_t* atoms = (uint32_t*)xcb_get_property_value(state);
+				int count = xcb_get_property_value_length(state) / 4;
+				for (int i = 0; i < count; i++) {
+					if (atoms[i] == atoms_[NET_WM_STATE_MAXIMIZED_VERT]) bVert = TRUE;
+					else if (atoms[i] == atoms_[NET_WM_STATE_MAXIMIZED_HORZ]) bHorz = TRUE;
+					else if (atoms[i] == atoms_[NET_WM_STATE_HIDDEN]) bHidden = TRUE;
+					else if (atoms[i] == atoms_[NET_WM_STATE_ABOVE]) w.bAbove = TRUE;
+				}
+			}
+			w.bMaximized = (bVert && bHorz);
+
+			BOOL bIconicState = FALSE;
+			if (wmState && xcb_get_property_value_length(wmState) >= 4) {
+				bIconicState = (*(uint32_t*)xcb_get_property_value(wmState) == ICCCM_ICONIC_STATE);
+			}
+			w.bMinimized = (!w.bViewable && (bHidden || bIconicState));
+
+			if (!w.bMaximized && !w.bMinimized && w.bViewable) {
+				w.normalRect = w.rcWindow;
+			}
+			w.bCacheValid = TRUE;
+		}
+
+		free(geometry);
+		free(origin);
+		free(attributes);
+		free(state);
+		free(extents);
+		free(wmState);
+		return result;
+	}
+
+	/// <summary>
+	/// Deliver the message to the emulated window procedure
+	/// </summary>
+	LRESULT sendMessage(xcb_window_t window, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+		auto it = windows_.find(window);
+		if (it == windows_.end() || it->second.wndProc == NULL) return 0;
+		return it->second.wndProc(toHwnd(window), uMsg, wParam, lParam);
+	}
+
+	/// <summary>
+	/// Send WM_TIMER once for each elapsed timer. Missed intervals are not made up for, as on Windows.
+	/// </summary>
+	void fireTimers() {
+		if (timers_.empty()) return;
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::vector<std::pair<xcb_window_t, UINT_PTR>> elapsed;
+		for (X11Timer& timer : timers_) {
+			if (timer.due <= now) {
+				elapsed.push_back(std::make_pair(timer.window, timer.id));
+				timer.due = now + timer.interval;
+			}
+		}
+
+		// ウィンドウプロシージャ内でタイマーが変更されうるため、まとめてから送る
+		for (const auto& e : elapsed) {
+			sendMessage(e.first, WM_TIMER, (WPARAM)e.second, 0);
+		}
+	}
+
+	xcb_client_message_event_t makeClientMessage(xcb_window_t window, xcb_atom_t type) {
+		xcb_client_message_event_t ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.response_type = XCB_CLIENT_MESSAGE;
+		ev.format = 32;
+		ev.window = window;
+		ev.type = type;
+		return ev;
+	}
+
+	void sendToRoot(const xcb_client_message_event_t& ev) {
+		xcb_send_event(conn_, 0, root_, XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY, (const char*)&ev);
+	}
+
+	/// <summary>
+	/// Add or remove _NET_WM_STATE atoms. The property is written directly without a window manager.
+	/// </summary>
+	void changeNetWmState(xcb_window_t window, uint32_t action, xcb_atom_t first, xcb_atom_t second) {
+		if (bWindowManager_) {
+			xcb_client_message_event_t ev = makeClientMessage(window, atoms_[NET_WM_STATE]);
+			ev.data.data32[0] = action;
+			ev.data.data32[1] = first;
+			ev.data.data32[2] = second;
+			ev.data.data32[3] = 2;		// Source indication: pager (direct user action)
+			sendToRoot(ev);
+			return;
+		}
+
+		std::vector<uint32_t> states = getProperty32(window, atoms_[NET_WM_STATE], XCB_ATOM_ATOM);
+		for (xcb_atom_t atom : { first, second }) {
+			if (atom == XCB_NONE) continue;
+			auto found = std::find(states.begin(), states.end(), atom);
+			if (action == NET_WM_STATE_ADD && found == states.end()) states.push_back(atom);
+			if (action == NET_WM_STATE_REMOVE && found != states.end()) states.erase(found);
+		}
+		xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, window, atoms_[NET_WM_STATE], XCB_ATOM_ATOM, 32, (uint32_t)states.size(), states.data());
+	}
+
+	/// <summary>
+	/// Move and resize. The rectangle includes the frame.
+	/// </summary>
+	void configure(xcb_window_t window, LONG x, LONG y, LONG width, LONG height) {
+		X11Window* w = track(window);
+		RECT frame = { 0, 0, 0, 0 };
+		if (w && w->bCacheValid) {
+			frame = { w->rcClient.left - w->rcWindow.left, w->rcClient.top - w->rcWindow.top, w->rcWindow.right - w->rcClient.right, w->rcWindow.bottom - w->rcClient.bottom };
+		}
+
+		int32_t clientX = x + frame.left;
+		int32_t clientY = y + frame.top;
+		uint32_t clientWidth = (uint32_t)std::max<LONG>(1, width - frame.left - frame.right);
+		uint32_t clientHeight = (uint32_t)std::max<LONG>(1, height - frame.top - frame.bottom);
+
+		if (bWindowManager_) {
+			// StaticGravity で、クライアント領域の座標として指定
+			xcb_client_message_event_t ev = makeClientMessage(window, atoms_[NET_MOVERESIZE_WINDOW]);
+			ev.data.data32[0] = X_STATIC_GRAVITY | (0xF << 8) | (2 << 12);
+			ev.data.data32[1] = (uint32_t)clientX;
+			ev.data.data32[2] = (uint32_t)clientY;
+			ev.data.data32[3] = clientWidth;
+			ev.data.data32[4] = clientHeight;
+			sendToRoot(ev);
+		}
+		else {
+			uint32_t values[4] = { (uint32_t)clientX, (uint32_t)clientY, clientWidth, clientHeight };
+			xcb_configure_window(conn_, window, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+		}
+	}
+
+	/// <summary>
+	/// Emulate the z-order part of SetWindowPos()
+	/// </summary>
+	void restack(xcb_window_t window, HWND hWndInsertAfter) {
+		if (hWndInsertAfter == HWND_TOPMOST) {
+			changeNetWmState(window, NET_WM_STATE_REMOVE, atoms_[NET_WM_STATE_BELOW], XCB_NONE);
+			changeNetWmState(window, NET_WM_STATE_ADD, atoms_[NET_WM_STATE_ABOVE], XCB_NONE);
+			if (!bWindowManager_) stackWindow(window, XCB_NONE, XCB_STACK_MODE_ABOVE);
+		}
+		else if (hWndInsertAfter == HWND_NOTOPMOST) {
+			changeNetWmState(window, NET_WM_STATE_REMOVE, atoms_[NET_WM_STATE_ABOVE], atoms_[NET_WM_STATE_BELOW]);
+		}
+		else if (hWndInsertAfter == HWND_BOTTOM) {
+			changeNetWmState(window, NET_WM_STATE_REMOVE, atoms_[NET_WM_STATE_ABOVE], XCB_NONE);
+			changeNetWmState(window, NET_WM_STATE_ADD, atoms_[NET_WM_STATE_BELOW], XCB_NONE);
+			if (!bWindowManager_) stackWindow(window, XCB_NONE, XCB_STACK_MODE_BELOW);
+		}
+		else if (hWndInsertAfter == HWND_TOP) {
+			stackWindow(window, XCB_NONE, XCB_STACK_MODE_ABOVE);
+		}
+		else {
+			stackWindow(window, toXid(hWndInsertAfter), XCB_STACK_MODE_BELOW);
+		}
+	}
+
+	void stackWindow(xcb_window_t window, xcb_window_t sibling, uint32_t mode) {
+		if (sibling != XCB_NONE) {
+			uint32_t values[2] = { sibling, mode };
+			xcb_configure_window(conn_, window, XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, values);
+		}
+		else {
+			xcb_configure_window(conn_, window, XCB_CONFIG_WINDOW_STACK_MODE, &mode);
+		}
+	}
+
+	void restoreFromIconic(xcb_window_t window, X11Window& /*w*/) {
+		xcb_map_window(conn_, window);
+		if (bWindowManager_) {
+			xcb_client_message_event_t ev = makeClientMessage(window, atoms_[NET_ACTIVE_WINDOW]);
+			ev.data.data32[0] = 2;		// Source indication: pager
+			sendToRoot(ev);
+		}
+		else {
+			changeNetWmState(window, NET_WM_STATE_REMOVE, atoms_[NET_WM_STATE_HIDDEN], XCB_NONE);
+		}
+	}
+
+	/// <summary>
+	/// Click-through with an empty input shape, or restore the default input shape
+	/// </summary>
+	void setInputPassThrough(xcb_window_t window, const X11Window& w, BOOL bPassThrough) {
+		if (!bShape_) return;
+
+		if (bPassThrough) {
+			xcb_shape_rectangles(conn_, XCB_SHAPE_SO_SET, XCB_SHAPE_SK_INPUT, XCB_CLIP_ORDERING_UNSORTED, window, 0, 0, 0, nullptr);
+		}
+		else if (w.bInputRegion) {
+			// Rows are merged into bands by RegionIndex, so the rectangles are YX-sorted
+			xcb_shape_rectangles(conn_, XCB_SHAPE_SO_SET, XCB_SHAPE_SK_INPUT, XCB_CLIP_ORDERING_YX_SORTED, window, 0, 0,
+				(uint32_t)w.inputRects.size(), w.inputRects.data());
+		}
+		else {
+			xcb_shape_mask(conn_, XCB_SHAPE_SO_SET, XCB_SHAPE_SK_INPUT, window, 0, 0, XCB_NONE);
+		}
+	}
+
+	/// <summary>
+	/// Monitors from RandR 1.5, or the root window
+	/// </summary>
+	void updateMonitors() {
+		monitors_.clear();
+
+		if (bRandr_) {
+			xcb_randr_get_monitors_reply_t* reply = xcb_randr_get_monitors_reply(conn_, xcb_randr_get_monitors(conn_, root_, 1), nullptr);
+			if (reply) {
+				xcb_randr_monitor_info_iterator_t it = xcb_randr_get_monitors_monitors_iterator(reply);
+				for (; it.rem; xcb_randr_monitor_info_next(&it)) {
+					xcb_randr_monitor_info_t* m = it.data;
+					RECT rect = { m->x, m->y, m->x + m->width, m->y + m->height };
+					if (m->primary) {
+						monitors_.insert(monitors_.begin(), rect);
+					}
+					else {
+						monitors_.push_back(rect);
+					}
+				}
+				free(reply);
+			}
+		}
+
+		if (monitors_.empty()) {
+			monitors_.push_back(rootRect_);
+		}
+		bMonitorsValid_ = TRUE;
+	}
+
+	RECT getMonitorRectFor(const RECT& rect) {
+		if (!bMonitorsValid_) updateMonitors();
+
+		LONG cx = (rect.left + rect.right - 1) / 2;
+		LONG cy = (rect.top + rect.bottom - 1) / 2;
+		for (const RECT& mr : monitors_) {
+			if (mr.left <= cx && cx < mr.right && mr.top <= cy && cy < mr.bottom) {
+				return mr;
+			}
+		}
+		return monitors_[0];
+	}
+
+	/// <summary>
+	/// Send WM_SIZE if the client size or the show state has changed
+	/// </summary>
+	void notifySize(xcb_window_t window) {
+		auto it = windows_.find(window);
+		if (it == windows_.end()) return;
+
+		X11Window& w = it->second;
+		if (!refresh(window, w)) return;
+
+		LONG width = w.rcClient.right - w.rcClient.left;
+		LONG height = w.rcClient.bottom - w.rcClient.top;
+		WPARAM sizeType = (w.bMinimized ? SIZE_MINIMIZED : (w.bMaximized ? SIZE_MAXIMIZED : SIZE_RESTORED));
+		if (width == w.lastWidth && height == w.lastHeight && sizeType == w.lastSizeType) return;
+
+		w.lastWidth = width;
+		w.lastHeight = height;
+		w.lastSizeType = sizeType;
+		sendMessage(window, WM_SIZE, sizeType, (sizeType == SIZE_MINIMIZED ? 0 : MAKELPARAM(width, height)));
+	}
+
+	void handleEvent(xcb_generic_event_t* event) {
+		uint8_t type = (event->response_type & ~0x80);
+
+		if (bRandr_ && type == (uint8_t)(randrFirstEvent_ + XCB_RANDR_SCREEN_CHANGE_NOTIFY)) {
+			bMonitorsValid_ = FALSE;
+			std::vector<xcb_window_t> targets;
+			for (auto& pair : windows_) targets.push_back(pair.first);
+			for (xcb_window_t w : targets) {
+				sendMessage(w, WM_DISPLAYCHANGE, 32, 0);
+			}
+			return;
+		}
+
+		switch (type) {
+		case XCB_CONFIGURE_NOTIFY:
+			notifySize(((xcb_configure_notify_event_t*)event)->window);
+			break;
+
+		case XCB_MAP_NOTIFY:
+			notifySize(((xcb_map_notify_event_t*)event)->window);
+			break;
+
+		case XCB_UNMAP_NOTIFY:
+			notifySize(((xcb_unmap_notify_event_t*)event)->window);
+			break;
+
+		case XCB_PROPERTY_NOTIFY: {
+			xcb_property_notify_event_t* ev = (xcb_property_notify_event_t*)event;
+			if (ev->window == helperWnd_) {
+				if (bDropIncr_ && ev->atom == atoms_[UNIWINC_DROP] && ev->state == XCB_PROPERTY_NEW_VALUE) {
+					receiveDropPiece();
+				}
+			}
+			else if (ev->atom == atoms_[NET_WM_STATE] || ev->atom == atoms_[WM_STATE] || ev->atom == atoms_[NET_FRAME_EXTENTS]) {
+				notifySize(ev->window);
+			}
+			break;
+		}
+
+		case XCB_DESTROY_NOTIFY: {
+			xcb_window_t window = ((xcb_destroy_notify_event_t*)event)->window;
+			sendMessage(window, WM_DESTROY, 0, 0);
+			windows_.erase(window);
+			timers_.erase(std::remove_if(timers_.begin(), timers_.end(), [window](const X11Timer& t) { return t.window == window; }), timers_.end());
+			pidCache_.erase(window);
+			break;
+		}
+
+		case XCB_CLIENT_MESSAGE:
+			handleClientMessage((xcb_client_message_event_t*)event);
+			break;
+
+		case XCB_SELECTION_NOTIFY:
+			handleSelectionNotify((xcb_selection_notify_event_t*)event);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/// <summary>
+	/// XDND messages which are sent to the helper window via XdndProxy
+	///   Only a source of a supported version which offers "text/uri-list" is accepted. Messages of other sources are ignored.
+	/// </summary>
+	void handleClientMessage(xcb_client_message_event_t* ev) {
+		if (ev->format != 32) return;
+
+		if (ev->type == atoms_[XDND_ENTER]) {
+			resetDrop();
+
+			// 新しすぎる版は解釈できないので、このドラッグには応えない
+			const uint32_t version = (ev->data.data32[1] >> 24);
+			if (version < XDND_MIN_VERSION || version > XDND_VERSION) return;
+
+			dropSource_ = ev->data.data32[0];
+			if (ev->data.data32[1] & 1) {
+				// 4つ以上の型は XdndTypeList に書かれている
+				std::vector<uint32_t> types = getProperty32(dropSource_, atoms_[XDND_TYPE_LIST], XCB_ATOM_ATOM);
+				bDropUriList_ = (std::find(types.begin(), types.end(), atoms_[TEXT_URI_LIST]) != types.end());
+			}
+			else {
+				for (int i = 2; i <= 4; i++) {
+					if (ev->data.data32[i] == atoms_[TEXT_URI_LIST]) bDropUriList_ = TRUE;
+				}
+			}
+			return;
+		}
+
+		if (dropSource_ == XCB_NONE || ev->data.data32[0] != dropSource_) return;
+
+		const BOOL bAccept = (dropTarget_ != XCB_NONE && bDropUriList_);
+		if (ev->type == atoms_[XDND_POSITION]) {
+			xcb_client_message_event_t status = makeClientMessage(dropSource_, atoms_[XDND_STATUS]);
+			status.data.data32[0] = dropTarget_;
+			status.data.data32[1] = (bAccept ? 1 : 0);
+			status.data.data32[4] = (bAccept ? atoms_[XDND_ACTION_COPY] : XCB_NONE);
+			xcb_send_event(conn_, 0, dropSource_, XCB_EVENT_MASK_NO_EVENT, (const char*)&status);
+			xcb_flush(conn_);
+		}
+		else if (ev->type == atoms_[XDND_DROP]) {
+			if (!bAccept) {
+				finishDrop(FALSE);
+				return;
+			}
+			xcb_timestamp_t time = ev->data.data32[2];
+			xcb_convert_selection(conn_, helperWnd_, atoms_[XDND_SELECTION], atoms_[TEXT_URI_LIST], atoms_[UNIWINC_DROP], time);
+			xcb_flush(conn_);
+		}
+		else if (ev->type == atoms_[XDND_LEAVE]) {
+			resetDrop();
+		}
+	}
+
+	/// <summary>
+	/// The dropped "text/uri-list" has arrived, or an INCR transfer of it begins
+	/// </summary>
+	void handleSelectionNotify(xcb_selection_notify_event_t* ev) {
+		if (ev->requestor != helperWnd_ || ev->selection != atoms_[XDND_SELECTION] || dropSource_ == XCB_NONE) return;
+
+		xcb_atom_t type = XCB_NONE;
+		dropData_.clear();
+		if (ev->property == XCB_NONE || !readProperty(helperWnd_, ev->property, dropData_, &type)) {
+			finishDrop(FALSE);
+			return;
+		}
+
+		if (type == atoms_[INCR]) {
+			// 大きな選択は INCR で少しずつ届く。プロパティを消したことが、送り始めの合図になる
+			dropData_.clear();
+			bDropIncr_ = TRUE;
+			return;
+		}
+		finishDrop(TRUE);
+	}
+
+	/// <summary>
+	/// A piece of the INCR transfer has been written to the property. A piece of zero length ends it
+	/// </summary>
+	void receiveDropPiece() {
+		const size_t length = dropData_.size();
+		xcb_atom_t type = XCB_NONE;
+		if (!readProperty(helperWnd_, atoms_[UNIWINC_DROP], dropData_, &type)) {
+			finishDrop(FALSE);
+			return;
+		}
+
+		if (dropData_.size() == length) {
+			finishDrop(TRUE);
+		}
+	}
+
+	/// <summary>
+	/// Read the whole value of a property by pieces of SELECTION_CHUNK_LENGTH, and delete it
+	/// </summary>
+	/// <param name="data">The value is appended</param>
+	/// <returns>FALSE if the property could not be read</returns>
+	BOOL readProperty(xcb_window_t window, xcb_atom_t property, std::string& data, xcb_atom_t* pType) {
+		uint32_t offset = 0;
+		for (;;) {
+			// 残りが無くなった回にプロパティが消される
+			xcb_get_property_reply_t* reply = xcb_get_property_reply(conn_,
+				xcb_get_property(conn_, 1, window, property, XCB_GET_PROPERTY_TYPE_ANY, offset, SELECTION_CHUNK_LENGTH), nullptr);
+			if (!reply) return FALSE;
+
+			const int length = xcb_get_property_value_length(reply);
+			const uint32_t bytesAfter = reply->bytes_after;
+			*pType = reply->type;
+			data.append((const char*)xcb_get_property_value(reply), (size_t)length);
+			free(reply);
+
+			if (bytesAfter == 0 || length <= 0) break;
+			offset += (uint32_t)length / 4;
+		}
+		return TRUE;
+	}
+
+	/// <summary>
+	/// Send WM_DROPFILES with the received "text/uri-list" and finish XDND
+	/// </summary>
+	/// <param name="bReceived">FALSE if the selection could not be received or the drop is refused</param>
+	void finishDrop(const BOOL bReceived) {
+		BOOL bAccepted = FALSE;
+		if (bReceived && dropTarget_ != XCB_NONE) {
+			X11Drop* drop = new (std::nothrow) X11Drop();
+			if (drop) {
+				const std::string& list = dropData_;
+				size_t start = 0;
+				while (start < list.size()) {
+					size_t end = list.find('\n', start);
+					if (end == std::string::npos) end = list.size();
+
+					std::string line = list.substr(start, end - start);
+					if (!line.empty() && line.back() == '\r') line.pop_back();
+					if (!line.empty() && line[0] != '#') {
+						std::string path = uriToPath(line);
+						if (!path.empty()) drop->paths.push_back(utf8ToUtf16(path));
+					}
+					start = end + 1;
+				}
+
+				if (!drop->paths.empty() && windows_.count(dropTarget_) && windows_[dropTarget_].wndProc) {
+					// 受け取った側が dragFinish() で解放する
+					bAccepted = TRUE;
+					sendMessage(dropTarget_, WM_DROPFILES, (WPARAM)drop, 0);
+				}
+				else {
+					delete drop;
+				}
+			}
+		}
+
+		if (dropSource_ != XCB_NONE) {
+			xcb_client_message_event_t finished = makeClientMessage(dropSource_, atoms_[XDND_FINISHED]);
+			finished.data.data32[0] = dropTarget_;
+			finished.data.data32[1] = (bAccepted ? 1 : 0);
+			finished.data.data32[2] = (bAccepted ? atoms_[XDND_ACTION_COPY] : XCB_NONE);
+			xcb_send_event(conn_, 0, dropSource_, XCB_EVENT_MASK_NO_EVENT, (const char*)&finished);
+			xcb_flush(conn_);
+		}
+		resetDrop();
+	}
+
+	void resetDrop() {
+		dropSource_ = XCB_NONE;
+		bDropUriList_ = FALSE;
+		bDropIncr_ = FALSE;
+		dropData_.clear();
+	}
+
+	/// <summary>
+	/// File dialogs with zenity, as X11 itself has none.
+	///   Multiple paths are returned newline separated, which expandMultiSelect() leaves as they are.
+	///   A path containing '\n' cannot be told apart in that format, so such a selection fails.
+	/// </summary>
+	/// <param name="pBuffer">Buffer of lpstrFile which is resized if the result is longer, or nullptr to fail then</param>
+	BOOL runFileDialog(OPENFILENAMEW* lpofn, BOOL bSave, std::vector<WCHAR>* pBuffer) {
+		if (!lpofn || !lpofn->lpstrFile || lpofn->nMaxFile == 0) return FALSE;
+
+		// exec so that the pid of the child is the one of zenity, for closeFileDialog()
+		std::string command = "exec zenity --file-selection";
+		if (bSave) {
+			command += " --save";
+			if (lpofn->Flags & OFN_OVERWRITEPROMPT) command += " --confirm-overwrite";
+		}
+		if (lpofn->Flags & OFN_ALLOWMULTISELECT) {
+			command += " --multiple --separator=" + shellQuote(ZENITY_SEPARATOR);
+		}
+		if (lpofn->lpstrTitle) {
+			command += " --title=" + shellQuote(utf16ToUtf8(lpofn->lpstrTitle));
+		}
+
+		std::string initialPath;
+		if (lpofn->lpstrInitialDir && lpofn->lpstrInitialDir[0] != u'\0') {
+			initialPath = utf16ToUtf8(lpofn->lpstrInitialDir) + "/";
+		}
+		initialPath += utf16ToUtf8(lpofn->lpstrFile);
+		if (!initialPath.empty()) {
+			command += " --filename=" + shellQuote(initialPath);
+		}
+
+		// "Title\0*.a;*.b\0...\0\0" を "Title | *.a *.b" に変換
+		if (lpofn->lpstrFilter) {
+			LPCWSTR p = lpofn->lpstrFilter;
+			while (*p != u'\0') {
+				std::string title = utf16ToUtf8(p);
+				while (*p != u'\0') p++;
+				p++;
+				std::string patterns = utf16ToUtf8(p);
+				while (*p != u'\0') p++;
+				p++;
+
+				std::replace(patterns.begin(), patterns.end(), ';', ' ');
+				if (patterns.empty()) patterns = "*";
+				command += " --file-filter=" + shellQuote(title + " | " + patterns);
+			}
+		}
+		command += " 2>/dev/null";
+
+		std::string output;
+		if (!runZenity(lpofn, command, output)) return FALSE;
+
+		// zenity は最後に改行を一つだけ付ける
+		if (!output.empty() && output.back() == '\n') output.pop_back();
+		if (output.empty()) return FALSE;
+
+		std::string paths;
+		size_t start = 0;
+		while (start <= output.size()) {
+			size_t end = output.find(ZENITY_SEPARATOR, start);
+			if (end == std::string::npos) end = output.size();
+
+			std::string path = output.substr(start, end - start);
+			if (path.find('\n') != std::string::npos) return FALSE;
+			if (!paths.empty()) paths.push_back('\n');
+			paths += path;
+			start = end + strlen(ZENITY_SEPARATOR);
+		}
+
+		std::u16string result = utf8ToUtf16(paths);
+		if (result.size() + 1 > lpofn->nMaxFile) {
+			if (pBuffer == nullptr) return FALSE;
+
+			try {
+				pBuffer->resize(result.size() + 1);
+			}
+			catch (...) {
+				return FALSE;
+			}
+			lpofn->lpstrFile = pBuffer->data();
+			lpofn->nMaxFile = (DWORD)pBuffer->size();
+		}
+
+		memcpy(lpofn->lpstrFile, result.data(), result.size() * sizeof(WCHAR));
+		lpofn->lpstrFile[result.size()] = u'\0';
+		return TRUE;
+	}
+
+	/// <summary>
+	/// Run the command with /bin/sh and read its output, registering the child for closeFileDialog() meanwhile
+	/// </summary>
+	/// <returns>FALSE if it could not be run or exited with a failure, e.g. cancelled</returns>
+	BOOL runZenity(const OPENFILENAMEW* lpofn, const std::string& command, std::string& output) {
+		int fds[2];
+		if (pipe2(fds, O_CLOEXEC) != 0) return FALSE;
+
+		pid_t pid = fork();
+		if (pid < 0) {
+			close(fds[0]);
+			close(fds[1]);
+			return FALSE;
+		}
+		if (pid == 0) {
+			// 子プロセスでは async-signal-safe な関数だけを使う
+			// 自身のプロセスグループにして、closeFileDialog() で子孫ごと終了させる
+			setpgid(0, 0);
+			dup2(fds[1], STDOUT_FILENO);
+			execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+			_exit(127);
+		}
+		setpgid(pid, pid);		// 子プロセスより先に登録されても kill() が届くように親でも設定する
+		close(fds[1]);
+
+		{
+			std::lock_guard<std::mutex> lock(dialogMutex_);
+			dialogs_.push_back({ lpofn, pid });
+		}
+
+		char buffer[1024];
+		for (;;) {
+			ssize_t length = read(fds[0], buffer, sizeof(buffer));
+			if (length > 0) {
+				output.append(buffer, (size_t)length);
+			}
+			else if (length == 0 || errno != EINTR) {
+				break;
+			}
+		}
+		close(fds[0]);
+
+		{
+			std::lock_guard<std::mutex> lock(dialogMutex_);
+			for (size_t i = 0; i < dialogs_.size(); i++) {
+				if (dialogs_[i].pid == pid) {
+					dialogs_.erase(dialogs_.begin() + i);
+					break;
+				}
+			}
+		}
+
+		int status = 0;
+		while (waitpid(pid, &status, 0) < 0) {
+			if (errno != EINTR) return FALSE;
+		}
+		return (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+};
+
+
+/// <summary>
+/// X11 backend is the default on Linux
+/// </summary>
+/// <returns></returns>
+WindowBackend* getDefaultBackend() {
+	static X11Backend backend;
+	return &backend;
+}
+
+#endif // defined(__linux__) && !defined(UNIWINC_HEADLESS)
@@ -0,0 +1,438 @@
+﻿// directorywalker.cpp : Recursive expansion of the dropped folders with work stealing
+
+#include "pch.h"
+#include "directorywalker.h"
+#include <chrono>
+
+#ifndef _WIN32
+#include "textcodec.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+
+#ifdef _WIN32
+static const WCHAR PATH_SEPARATOR = L'\\';
+
+static inline BOOL isSeparator(const WCHAR c) {
+	return (c == L'\\' || c == L'/');
+}
+#else
+static const char PATH_SEPARATOR = '/';
+
+static inline BOOL isSeparator(const char c) {
+	return (c == '/');
+}
+#endif
+
+/// <summary>
+/// Offset of the file name in the path
+/// </summary>
+static size_t getNameOffset(const DirectoryWalker::NativePath& path) {
+	size_t i = path.size();
+	while (i > 0 && !isSeparator(path[i - 1])) i--;
+	return i;
+}
+
+
+DirectoryWalker::DirectoryWalker(DropArena& results) : results_(results), maxDepth_(UNIWINC_DROP_EXPAND_DEPTH), maxThreads_(UNIWINC_DROP_INFO_THREADS), dropId_(0) {
+}
+
+DirectoryWalker::~DirectoryWalker() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	cancelWalk();
+
+	// ここだけは、終わっていないスレッドも待つ
+	if (current_) {
+		retired_.push_back(std::move(current_));
+	}
+	for (std::unique_ptr<Walk>& walk : retired_) {
+		for (std::thread& thread : walk->threads) {
+			thread.join();
+		}
+	}
+	retired_.clear();
+}
+
+void DirectoryWalker::configure(const std::shared_ptr<const PanelFilter>& filter, const INT32 maxDepth, const UINT32 maxThreads) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	cancelWalk();
+
+	filter_ = filter;
+	maxDepth_ = (maxDepth > 0 ? maxDepth : UNIWINC_DROP_EXPAND_DEPTH);
+	maxThreads_ = (maxThreads > 0 ? maxThreads : 1);
+}
+
+void DirectoryWalker::start(DropArena& source) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	cancelWalk();
+
+	// 前の走査は待たずに退かせる。スレッドは終わった後で回収する
+	if (current_) {
+		retired_.push_back(std::move(current_));
+	}
+	reapWalks();
+
+	std::unique_ptr<Walk> walk(new (std::nothrow) Walk());
+	if (!walk) return;
+	walk->filter = filter_;
+	walk->maxDepth = maxDepth_;
+
+	const UINT32 dropId = source.getDropId();
+	const UINT32 count = source.getCount();
+	results_.beginList(dropId);
+	dropId_ = dropId;
+
+	// ワーカーは使い回す
+	while (walk->workers.size() < maxThreads_) {
+		std::unique_ptr<Worker> worker;
+		if (!idleWorkers_.empty()) {
+			worker = std::move(idleWorkers_.back());
+			idleWorkers_.pop_back();
+		}
+		else {
+			worker.reset(new (std::nothrow) Worker());
+			if (!worker) break;
+		}
+		walk->workers.push_back(std::move(worker));
+	}
+	const UINT32 workerCount = (UINT32)walk->workers.size();
+	Walk& w = *walk;
+	current_ = std::move(walk);
+	if (workerCount == 0 || count == 0) return;
+
+	// ドロップされたパスを各ワーカーに振り分ける
+	std::vector<WCHAR> path;
+	INT64 queued = 0;
+	for (UINT32 i = 0; i < count; i++) {
+		if (!source.getPath(dropId, i, path)) break;
+
+		Task task;
+#ifdef _WIN32
+		task.path.assign(path.data(), path.size() - 1);
+#else
+		appendUtf8(path.data(), path.size() - 1, task.path);
+#endif
+		task.depth = 0;
+		task.bRoot = TRUE;
+		w.workers[i % workerCount]->tasks.push_back(std::move(task));
+		queued++;
+	}
+	w.outstanding = queued;
+
+	w.runningThreads = workerCount;
+	for (UINT32 i = 0; i < workerCount; i++) {
+		try {
+			w.threads.emplace_back(&DirectoryWalker::workerMain, this, &w, i);
+		}
+		catch (...) {
+			// 起動できなかった分の仕事は、他のワーカーが盗む
+			w.runningThreads -= (workerCount - i);
+			break;
+		}
+	}
+}
+
+void DirectoryWalker::cancel() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	cancelWalk();
+}
+
+BOOL DirectoryWalker::isRunning(UINT32* pDropId) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	reapWalks();
+
+	if (pDropId) *pDropId = dropId_.load();
+	return (current_ && !current_->bCancelled.load() && current_->runningThreads.load() > 0);
+}
+
+UINT32 DirectoryWalker::getDirectoryCount() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (current_ ? current_->directoryCount.load() : 0);
+}
+
+UINT32 DirectoryWalker::getRetiredCount() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	reapWalks();
+	return (UINT32)retired_.size();
+}
+
+/// <summary>
+/// Tell the workers of the current walk to stop. Called with mutex_ locked
+///   Once this returns, the walk appends no more paths to the results.
+/// </summary>
+void DirectoryWalker::cancelWalk() {
+	if (!current_) return;
+
+	std::lock_guard<std::mutex> lock(resultsMutex_);
+	current_->bCancelled = true;
+}
+
+/// <summary>
+/// Join the threads of the walk if all of them have ended, and take back its workers. Called with mutex_ locked
+/// </summary>
+/// <returns>TRUE if the threads have been joined</returns>
+BOOL DirectoryWalker::joinIfEnded(Walk& walk) {
+	if (walk.runningThreads.load() > 0) return FALSE;
+
+	// 数え終えた後は return するだけなので、すぐに戻る
+	for (std::thread& thread : walk.threads) {
+		thread.join();
+	}
+	walk.threads.clear();
+
+	for (std::unique_ptr<Worker>& worker : walk.workers) {
+		worker->tasks.clear();
+		worker->batchData.clear();
+		worker->batchLengths.clear();
+		idleWorkers_.push_back(std::move(worker));
+	}
+	walk.workers.clear();
+	return TRUE;
+}
+
+/// <summary>
+/// Join the threads of the walks which have ended. Called with mutex_ locked
+/// </summary>
+void DirectoryWalker::reapWalks() {
+	for (size_t i = retired_.size(); i > 0; i--) {
+		if (joinIfEnded(*retired_[i - 1])) {
+			retired_.erase(retired_.begin() + (i - 1));
+		}
+	}
+	if (current_ && !current_->threads.empty()) {
+		joinIfEnded(*current_);
+	}
+}
+
+void DirectoryWalker::workerMain(Walk* walk, const UINT32 index) {
+	Walk& w = *walk;
+	Worker& self = *w.workers[index];
+	UINT32 idle = 0;
+	Task task;
+
+	while (!w.bCancelled.load(std::memory_order_relaxed)) {
+		if (popTask(w, index, task) || stealTask(w, index, task)) {
+			idle = 0;
+			processTask(w, self, task);
+			w.outstanding.fetch_sub(1);		// Subdirectories have been counted before this
+			continue;
+		}
+
+		// 手が空いたら溜めた分を出しておく
+		flushBatch(w, self);
+		if (w.outstanding.load() <= 0) break;
+
+		// 他のワーカーが新しいディレクトリを見つけるまで待つ
+		if (++idle < 64) {
+			std::this_thread::yield();
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	flushBatch(w, self);
+	w.runningThreads.fetch_sub(1);
+}
+
+BOOL DirectoryWalker::popTask(Walk& walk, const UINT32 index, Task& task) {
+	Worker& worker = *walk.workers[index];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) return FALSE;
+
+	// 自分の分は新しいものから。深さ優先になり、キューが膨らみにくい
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	return TRUE;
+}
+
+BOOL DirectoryWalker::stealTask(Walk& walk, const UINT32 index, Task& task) {
+	const UINT32 workerCount = (UINT32)walk.workers.size();
+	for (UINT32 k = 1; k < workerCount; k++) {
+		Worker& victim = *walk.workers[(index + k) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) continue;
+
+		// 盗むのは古いものから。浅いディレクトリほど下に多くのファイルを抱えている
+		task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		return TRUE;
+	}
+	return FALSE;
+}
+
+void DirectoryWalker::pushTask(Walk& walk, Worker& worker, NativePath&& path, const INT32 depth) {
+	walk.outstanding.fetch_add(1);
+
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	worker.tasks.push_back({ std::move(path), depth, FALSE });
+}
+
+BOOL DirectoryWalker::markVisited(Walk& walk, const UINT64 volume, const UINT64 file) {
+	std::lock_guard<std::mutex> lock(walk.visitedMutex);
+	if (!walk.visited.insert(std::make_pair(volume, file)).second) return FALSE;
+
+	walk.directoryCount++;
+	return TRUE;
+}
+
+void DirectoryWalker::addFile(Walk& walk, Worker& worker, const NativePath& path, const size_t nameOffset) {
+	const size_t start = worker.batchData.size();
+	const std::shared_ptr<const PanelFilter>& filter = walk.filter;
+
+#ifdef _WIN32
+	if (filter && !filter->match(path.data() + nameOffset, path.size() - nameOffset)) return;
+	worker.batchData.insert(worker.batchData.end(), path.begin(), path.end());
+#else
+	// 名前だけ変換して調べ、一致したらパス全体を変換する
+	if (filter && !filter->isMatchAll()) {
+		worker.name.clear();
+		appendUtf16(path.data() + nameOffset, path.size() - nameOffset, worker.name);
+		if (!filter->match(worker.name.data(), worker.name.size())) return;
+	}
+	appendUtf16(path.data(), path.size(), worker.batchData);
+#endif
+
+	worker.batchLengths.push_back((UINT32)(worker.batchData.size() - start));
+	if (worker.batchLengths.size() >= BATCH_SIZE) {
+		flushBatch(walk, worker);
+	}
+}
+
+void DirectoryWalker::flushBatch(Walk& walk, Worker& worker) {
+	if (worker.batchLengths.empty()) return;
+
+	{
+		// 取り消された走査の分は、次の走査の結果に混ぜない
+		std::lock_guard<std::mutex> lock(resultsMutex_);
+		if (!walk.bCancelled.load()) {
+			results_.appendList(worker.batchData.data(), worker.batchLengths.data(), (UINT32)worker.batchLengths.size());
+		}
+	}
+	worker.batchData.clear();
+	worker.batchLengths.clear();
+}
+
+#ifdef _WIN32
+
+void DirectoryWalker::processTask(Walk& walk, Worker& worker, Task& task) {
+	if (task.bRoot) {
+		const DWORD attributes = GetFileAttributesW(task.path.c_str());
+		if (attributes == INVALID_FILE_ATTRIBUTES) return;
+
+		if (!(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+			addFile(walk, worker, task.path, getNameOffset(task.path));
+			return;
+		}
+	}
+	walkDirectory(walk, worker, task);
+}
+
+void DirectoryWalker::walkDirectory(Walk& walk, Worker& worker, const Task& task) {
+	// リンクの先も含めて、同じディレクトリには一度しか入らない
+	HANDLE hDir = CreateFileW(task.path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (hDir == INVALID_HANDLE_VALUE) return;
+
+	BY_HANDLE_FILE_INFORMATION info;
+	const BOOL bInfo = GetFileInformationByHandle(hDir, &info);
+	CloseHandle(hDir);
+	if (!bInfo || !markVisited(walk, info.dwVolumeSerialNumber, ((UINT64)info.nFileIndexHigh << 32) | info.nFileIndexLow)) return;
+
+	NativePath child = task.path;
+	if (child.empty() || !isSeparator(child.back())) {
+		child.push_back(PATH_SEPARATOR);
+	}
+	const size_t base = child.size();
+	child.push_back(L'*');
+
+	WIN32_FIND_DATAW data;
+	HANDLE hFind = FindFirstFileExW(child.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if (hFind == INVALID_HANDLE_VALUE) return;
+
+	do {
+		const WCHAR* name = data.cFileName;
+		if (name[0] == L'.' && (name[1] == L'\0' || (name[1] == L'.' && name[2] == L'\0'))) continue;
+
+		child.resize(base);
+		child.append(name);
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			if (task.depth + 1 < walk.maxDepth) {
+				pushTask(walk, worker, NativePath(child), task.depth + 1);
+			}
+		}
+		else {
+			addFile(walk, worker, child, base);
+		}
+	} while (!walk.bCancelled.load(std::memory_order_relaxed) && FindNextFileW(hFind, &data));
+
+	FindClose(hFind);
+}
+
+#else
+
+void DirectoryWalker::processTask(Walk& walk, Worker& worker, Task& task) {
+	if (task.bRoot) {
+		struct stat st;
+		if (stat(task.path.c_str(), &st) != 0) return;
+
+		if (!S_ISDIR(st.st_mode)) {
+			if (S_ISREG(st.st_mode)) {
+				addFile(walk, worker, task.path, getNameOffset(task.path));
+			}
+			return;
+		}
+	}
+	walkDirectory(walk, worker, task);
+}
+
+void DirectoryWalker::walkDirectory(Walk& walk, Worker& worker, const Task& task) {
+	DIR* dir = opendir(task.path.c_str());
+	if (dir == NULL) return;
+
+	// リンクの先も含めて、同じディレクトリには一度しか入らない
+	struct stat st;
+	if (fstat(dirfd(dir), &st) != 0 || !markVisited(walk, (UINT64)st.st_dev, (UINT64)st.st_ino)) {
+		closedir(dir);
+		return;
+	}
+
+	NativePath child = task.path;
+	if (child.empty() || !isSeparator(child.back())) {
+		child.push_back(PATH_SEPARATOR);
+	}
+	const size_t base = child.size();
+
+	struct dirent* entry;
+	while (!walk.bCancelled.load(std::memory_order_relaxed) && (entry = readdir(dir)) != NULL) {
+		const char* name = entry->d_name;
+		if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+		child.resize(base);
+		child.append(name);
+
+		// 種類が分からないものとリンクは、辿った先で判断する
+		BOOL bDirectory = (entry->d_type == DT_DIR);
+		BOOL bFile = (entry->d_type == DT_REG);
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+			struct stat childStat;
+			if (stat(child.c_str(), &childStat) == 0) {
+				bDirectory = S_ISDIR(childStat.st_mode);
+				bFile = S_ISREG(childStat.st_mode);
+			}
+		}
+
+		if (bDirectory) {
+			if (task.depth + 1 < walk.maxDepth) {
+				pushTask(walk, worker, NativePath(child), task.depth + 1);
+			}
+		}
+		else if (bFile) {
+			addFile(walk, worker, child, base);
+		}
+	}
+
+	closedir(dir);
+}
+
+#endif
@@ -0,0 +1,132 @@
+﻿#pragma once
+
+#include "droparena.h"
+#include "panelfilter.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Recursive expansion of the dropped folders on worker threads.
+///   Each worker has its own deque of directories. It takes the newest one from the back (depth first),
+///   and an idle worker steals the oldest one from the front of another deque, which is usually the largest subtree.
+///   Every directory is entered at most once by its identity (volume and file index, or device and inode),
+///   so symbolic links and junctions which point to an ancestor do not loop.
+///   Matched files are appended to the result arena in batches, in no particular order.
+///   Cancelling does not wait for the workers. A cancelled walk is retired and its threads are joined after they have ended,
+///   so start() and cancel() on the window thread never block on a slow file system.
+/// </summary>
+class DirectoryWalker {
+public:
+	explicit DirectoryWalker(DropArena& results);
+	~DirectoryWalker();
+
+	/// <summary>
+	/// Settings for the next start()
+	/// </summary>
+	/// <param name="filter">Compiled filter, or nullptr for all files</param>
+	/// <param name="maxDepth">Files deeper than this are not listed. The files in a dropped folder are at depth 1</param>
+	void configure(const std::shared_ptr<const PanelFilter>& filter, const INT32 maxDepth, const UINT32 maxThreads);
+
+	/// <summary>
+	/// Walk the paths of the drop. The previous walk is cancelled
+	///   Dropped files which match the filter are listed as they are.
+	/// </summary>
+	void start(DropArena& source);
+
+	/// <summary>
+	/// Stop the walk without waiting for the workers. Paths already listed are kept, and no more are appended
+	/// </summary>
+	void cancel();
+
+	/// <summary>
+	/// TRUE while the workers are walking. The threads of the walks which have ended are joined here
+	/// </summary>
+	/// <param name="pDropId">Receives the drop ID of the last walk, or 0 if never started</param>
+	BOOL isRunning(UINT32* pDropId);
+
+	/// <summary>
+	/// Number of the directories entered by the last walk
+	/// </summary>
+	UINT32 getDirectoryCount();
+
+	/// <summary>
+	/// Number of the cancelled walks whose threads have not ended yet
+	/// </summary>
+	UINT32 getRetiredCount();
+
+	static const UINT32 BATCH_SIZE = 256;	// Paths appended to the results at once
+
+#ifdef _WIN32
+	typedef std::basic_string<WCHAR> NativePath;
+#else
+	typedef std::string NativePath;		// UTF-8
+#endif
+
+private:
+	struct Task {
+		NativePath path;
+		INT32 depth;
+		BOOL bRoot;						// Dropped path, which may be a file
+	};
+
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::vector<WCHAR> batchData;	// Matched paths not appended yet
+		std::vector<UINT32> batchLengths;
+#ifndef _WIN32
+		std::vector<WCHAR> name;		// UTF-16 file name to match with the filter
+#endif
+	};
+
+	/// <summary>
+	/// State of a walk. Kept until its threads have been joined, even after it has been cancelled
+	/// </summary>
+	struct Walk {
+		std::shared_ptr<const PanelFilter> filter;	// nullptr for all files
+		INT32 maxDepth;
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::vector<std::thread> threads;
+		std::atomic<INT64> outstanding;				// Tasks queued or running. The walk ends at 0
+		std::atomic<UINT32> runningThreads;
+		std::atomic<bool> bCancelled;				// Set under resultsMutex_
+		std::atomic<UINT32> directoryCount;
+
+		std::mutex visitedMutex;
+		std::set<std::pair<UINT64, UINT64>> visited;	// Identities of the directories entered
+
+		Walk() : maxDepth(0), outstanding(0), runningThreads(0), bCancelled(false), directoryCount(0) {}
+	};
+
+	DropArena& results_;
+	std::mutex resultsMutex_;					// A cancelled walk does not append to the results after cancel()
+
+	std::mutex mutex_;							// Guards the members below
+	std::shared_ptr<const PanelFilter> filter_;	// nullptr for all files
+	INT32 maxDepth_;
+	UINT32 maxThreads_;
+	std::atomic<UINT32> dropId_;
+	std::unique_ptr<Walk> current_;				// Last walk started
+	std::vector<std::unique_ptr<Walk>> retired_;	// Walks whose threads have not been joined yet
+	std::vector<std::unique_ptr<Worker>> idleWorkers_;	// Workers are reused for their batch buffers
+
+	void cancelWalk();
+	BOOL joinIfEnded(Walk& walk);
+	void reapWalks();
+
+	void workerMain(Walk* walk, const UINT32 index);
+	BOOL popTask(Walk& walk, const UINT32 index, Task& task);
+	BOOL stealTask(Walk& walk, const UINT32 index, Task& task);
+	void pushTask(Walk& walk, Worker& worker, NativePath&& path, const INT32 depth);
+	void processTask(Walk& walk, Worker& worker, Task& task);
+	void walkDirectory(Walk& walk, Worker& worker, const Task& task);
+	BOOL markVisited(Walk& walk, const UINT64 volume, const UINT64 file);
+	void addFile(Walk& walk, Worker& worker, const NativePath& path, const size_t nameOffset);
+	void flushBatch(Walk& walk, Worker& worker);
+};
@@ -0,0 +1,77 @@
+﻿// dragmove.cpp : Motion of a window dragged by the mouse cursor
+
+#include "pch.h"
+#include "dragmove.h"
+
+
+DragMover::DragMover() : bDragging_(FALSE), offset_({ 0, 0 }), size_({ 0, 0 }), position_({ 0, 0 }), snapDistance_(0) {
+}
+
+void DragMover::begin(const POINT& cursor, const RECT& windowRect) {
+	offset_.x = windowRect.left - cursor.x;
+	offset_.y = windowRect.top - cursor.y;
+	size_.cx = windowRect.right - windowRect.left;
+	size_.cy = windowRect.bottom - windowRect.top;
+	position_.x = windowRect.left;
+	position_.y = windowRect.top;
+	bDragging_ = TRUE;
+}
+
+void DragMover::end() {
+	bDragging_ = FALSE;
+}
+
+void DragMover::setSnapDistance(const LONG distance) {
+	snapDistance_ = (distance > 0 ? distance : 0);
+}
+
+BOOL DragMover::move(const POINT& cursor, const MonitorTopology& topology, POINT* pPosition) {
+	if (!bDragging_) return FALSE;
+
+	RECT rect;
+	rect.left = cursor.x + offset_.x;
+	rect.top = cursor.y + offset_.y;
+	rect.right = rect.left + size_.cx;
+	rect.bottom = rect.top + size_.cy;
+
+	if (snapDistance_ > 0) {
+		snap(rect, topology);
+	}
+
+	if (rect.left == position_.x && rect.top == position_.y) return FALSE;
+
+	position_.x = rect.left;
+	position_.y = rect.top;
+	if (pPosition != nullptr) *pPosition = position_;
+	return TRUE;
+}
+
+/// <summary>
+/// Put the edges of the rectangle on the edges of the monitor which has the largest part of it
+/// </summary>
+void DragMover::snap(RECT& rect, const MonitorTopology& topology) const {
+	const INT32 index = topology.findMonitor(rect);
+	if (index < 0) return;
+
+	const RECT& monitor = topology.getRect(index);
+	const LONG dx = snapAxis(rect.left, rect.right, monitor.left, monitor.right, snapDistance_);
+	const LONG dy = snapAxis(rect.top, rect.bottom, monitor.top, monitor.bottom, snapDistance_);
+	rect.left += dx;
+	rect.right += dx;
+	rect.top += dy;
+	rect.bottom += dy;
+}
+
+/// <summary>
+/// Shift along one axis to snap. The nearer edge wins, and the low edge if both are equally near
+/// </summary>
+LONG DragMover::snapAxis(const LONG low, const LONG high, const LONG monitorLow, const LONG monitorHigh, const LONG distance) {
+	const LONG dLow = monitorLow - low;
+	const LONG dHigh = monitorHigh - high;
+	const LONG aLow = (dLow < 0 ? -dLow : dLow);
+	const LONG aHigh = (dHigh < 0 ? -dHigh : dHigh);
+
+	if (aLow <= distance && aLow <= aHigh) return dLow;
+	if (aHigh <= distance) return dHigh;
+	return 0;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include "monitortopology.h"
+
+/// <summary>
+/// Motion of a window dragged by the mouse cursor, independent of the window system.
+///   The window keeps the offset to the cursor at begin(), so it can be moved at every input instead of every frame.
+///   With snapping, an edge of the window near an edge of the monitor (the one with the largest part of the window) is put on it.
+///   The snapped position is calculated from the cursor each time, so the window leaves the edge when the cursor goes farther.
+/// </summary>
+class DragMover {
+public:
+	DragMover();
+
+	/// <summary>
+	/// Start dragging
+	/// </summary>
+	/// <param name="cursor">Cursor position in screen coordinates</param>
+	/// <param name="windowRect">Current window rectangle in screen coordinates</param>
+	void begin(const POINT& cursor, const RECT& windowRect);
+
+	void end();
+
+	BOOL isDragging() const { return bDragging_; }
+
+	/// <param name="distance">Snap an edge within this distance [px]. 0 disables snapping</param>
+	void setSnapDistance(const LONG distance);
+	LONG getSnapDistance() const { return snapDistance_; }
+
+	/// <summary>
+	/// Calculate the window position for the cursor
+	/// </summary>
+	/// <param name="topology">Monitors to snap to</param>
+	/// <param name="pPosition">Receives the top-left of the window</param>
+	/// <returns>FALSE if not dragging, or the window is already there</returns>
+	BOOL move(const POINT& cursor, const MonitorTopology& topology, POINT* pPosition);
+
+private:
+	BOOL bDragging_;
+	POINT offset_;			// Window top-left minus the cursor
+	SIZE size_;
+	POINT position_;		// Last window position
+	LONG snapDistance_;		// [px]
+
+	void snap(RECT& rect, const MonitorTopology& topology) const;
+	static LONG snapAxis(const LONG low, const LONG high, const LONG monitorLow, const LONG monitorHigh, const LONG distance);
+};
@@ -0,0 +1,324 @@
+﻿// droparena.cpp : Paths of the last drop in reusable buffers
+
+#include "pch.h"
+#include "droparena.h"
+#include "eventqueue.h"
+#include "textcodec.h"
+#include <cstring>
+
+
+DropArena::DropArena() : currentBlock_(0), blockUsed_(0), dropId_(0), pStreamBackend_(NULL), hStreamDrop_(NULL), streamTotal_(0) {
+}
+
+/// <summary>
+/// Start a new drop. mutex_ must be locked
+/// </summary>
+UINT32 DropArena::beginDrop(const UINT32 num) {
+	paths_.clear();
+	paths_.reserve(num);
+	currentBlock_ = 0;
+	blockUsed_ = 0;
+	streamTotal_ = num;
+	dropId_++;
+	return num;
+}
+
+/// <summary>
+/// Move to the next block which has the space. mutex_ must be locked
+/// </summary>
+void DropArena::nextBlock(const UINT32 required) {
+	if (!blocks_.empty() && blockUsed_ > 0) {
+		currentBlock_++;
+	}
+	blockUsed_ = 0;
+
+	if (currentBlock_ >= blocks_.size()) {
+		blocks_.emplace_back();
+	}
+
+	// 既存のブロックが足りなければ作り直す
+	std::vector<WCHAR>& block = blocks_[currentBlock_];
+	if (block.size() < required) {
+		block.resize(required > BLOCK_SIZE ? required : (UINT32)BLOCK_SIZE);
+	}
+}
+
+/// <summary>
+/// Take a path at the end of the data. mutex_ must be locked
+/// </summary>
+void DropArena::appendPath(WindowBackend* pBackend, HDROP hDrop, const UINT32 index) {
+	if (blocks_.empty() || blocks_[currentBlock_].size() - blockUsed_ < MIN_FREE) {
+		nextBlock(MIN_FREE);
+	}
+
+	// まずは空きにそのまま受け取る。終端まで埋まっていたら長さを調べて、次のブロックに取り直す
+	UINT cch = (UINT)(blocks_[currentBlock_].size() - blockUsed_);
+	UINT length = pBackend->dragQueryFile(hDrop, index, &blocks_[currentBlock_][blockUsed_], cch);
+	if (length + 1 >= cch) {
+		const UINT required = pBackend->dragQueryFile(hDrop, index, NULL, 0);
+		if (required + 1 > cch) {
+			nextBlock(required + 1);
+			length = pBackend->dragQueryFile(hDrop, index, &blocks_[currentBlock_][0], required + 1);
+		}
+	}
+
+	paths_.push_back({ currentBlock_, blockUsed_, length });
+	blockUsed_ += length;
+}
+
+/// <summary>
+/// Release the HDROP of the stream. mutex_ must be locked
+/// </summary>
+void DropArena::endStream() {
+	if (hStreamDrop_ == NULL) return;
+
+	pStreamBackend_->dragFinish(hStreamDrop_);
+	hStreamDrop_ = NULL;
+	pStreamBackend_ = NULL;
+}
+
+UINT32 DropArena::collect(WindowBackend* pBackend, HDROP hDrop) {
+	if (pBackend == NULL) return 0;
+
+	finishStream();
+
+	const UINT32 num = pBackend->dragQueryFile(hDrop, 0xFFFFFFFF, NULL, 0);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	beginDrop(num);
+	for (UINT32 i = 0; i < num; i++) {
+		appendPath(pBackend, hDrop, i);
+	}
+	return num;
+}
+
+UINT32 DropArena::beginStream(WindowBackend* pBackend, HDROP hDrop) {
+	if (pBackend == NULL) return 0;
+
+	finishStream();
+
+	const UINT32 num = pBackend->dragQueryFile(hDrop, 0xFFFFFFFF, NULL, 0);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	beginDrop(num);
+	pStreamBackend_ = pBackend;
+	hStreamDrop_ = hDrop;
+	if (num == 0) {
+		endStream();
+	}
+	return num;
+}
+
+UINT32 DropArena::continueStream(const INT64 budget, BOOL* pbFinished) {
+	if (pbFinished) *pbFinished = FALSE;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (hStreamDrop_ == NULL) return 0;
+
+	// 時刻の取得も只ではないので、数件ごとに確認する
+	const INT64 deadline = EventQueue::now() + budget;
+	UINT32 count = 0;
+	UINT32 index = (UINT32)paths_.size();
+	while (index < streamTotal_) {
+		appendPath(pStreamBackend_, hStreamDrop_, index);
+		index++;
+		count++;
+		if ((count % 32) == 0 && EventQueue::now() >= deadline) break;
+	}
+
+	if (index >= streamTotal_) {
+		endStream();
+		if (pbFinished) *pbFinished = TRUE;
+	}
+	return count;
+}
+
+BOOL DropArena::finishStream() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (hStreamDrop_ == NULL) return FALSE;
+
+	for (UINT32 i = (UINT32)paths_.size(); i < streamTotal_; i++) {
+		appendPath(pStreamBackend_, hStreamDrop_, i);
+	}
+	endStream();
+	return TRUE;
+}
+
+void DropArena::beginList(const UINT32 dropId) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	beginDrop(0);
+	dropId_ = dropId;
+}
+
+void DropArena::appendList(const WCHAR* pData, const UINT32* pLengths, const UINT32 count) {
+	if (pData == NULL || pLengths == NULL) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (UINT32 i = 0; i < count; i++) {
+		const UINT32 length = pLengths[i];
+		if (blocks_.empty() || blocks_[currentBlock_].size() - blockUsed_ < length) {
+			nextBlock(length);
+		}
+		if (length > 0) {
+			memcpy(&blocks_[currentBlock_][blockUsed_], pData, (size_t)length * sizeof(WCHAR));
+		}
+		paths_.push_back({ currentBlock_, blockUsed_, length });
+		blockUsed_ += length;
+		pData += length;
+	}
+	streamTotal_ = (UINT32)paths_.size();
+}
+
+BOOL DropArena::isStreaming() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (hStreamDrop_ != NULL);
+}
+
+UINT32 DropArena::getPage(const UINT32 firstIndex, UINT32* pOffsets, const UINT32 maxCount, WCHAR* pData, const UINT32 dataCapacity, DROPFILESPAGE* pPage) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const UINT32 available = (UINT32)paths_.size();		// ストリーミング中は取り出し済みの分のみ
+	const UINT32 first = (firstIndex < available ? firstIndex : available);
+
+	// 件数とデータ量の両方に収まるだけ、詰めて書き込む
+	UINT32 count = 0;
+	UINT32 length = 0;
+	if (pOffsets != NULL && pData != NULL) {
+		pOffsets[0] = 0;
+		while (first + count < available && count < maxCount) {
+			const Entry& e = paths_[first + count];
+			if ((UINT64)length + e.length > dataCapacity) break;
+
+			memcpy(pData + length, &blocks_[e.block][e.offset], (size_t)e.length * sizeof(WCHAR));
+			length += e.length;
+			count++;
+			pOffsets[count] = length;
+		}
+	}
+
+	if (pPage != NULL) {
+		pPage->nDropId = dropId_;
+		pPage->nTotalCount = streamTotal_;
+		pPage->nAvailableCount = available;
+		pPage->nFirstIndex = first;
+		pPage->nCount = count;
+		pPage->nDataLength = length;
+		pPage->nNextLength = (first + count < available ? paths_[first + count].length : 0);
+	}
+	return count;
+}
+
+UINT32 DropArena::getPageUtf8(const UINT32 firstIndex, UINT32* pOffsets, const UINT32 maxCount, char* pData, const UINT32 dataCapacity, DROPFILESPAGE* pPage) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const UINT32 available = (UINT32)paths_.size();
+	const UINT32 first = (firstIndex < available ? firstIndex : available);
+
+	// パスごとに長さを数えてから、収まるものだけ直接書き込む
+	UINT32 count = 0;
+	UINT32 length = 0;
+	size_t nextLength = 0;
+	if (pOffsets != NULL && pData != NULL) {
+		pOffsets[0] = 0;
+		while (first + count < available && count < maxCount) {
+			const Entry& e = paths_[first + count];
+			const WCHAR* p = &blocks_[e.block][e.offset];
+			nextLength = getUtf8Length(p, e.length);
+			if ((UINT64)length + nextLength > dataCapacity) break;
+
+			length += (UINT32)convertToUtf8(p, e.length, pData + length);
+			nextLength = 0;
+			count++;
+			pOffsets[count] = length;
+		}
+	}
+
+	if (pPage != NULL) {
+		if (nextLength == 0 && first + count < available) {
+			const Entry& e = paths_[first + count];
+			nextLength = getUtf8Length(&blocks_[e.block][e.offset], e.length);
+		}
+		pPage->nDropId = dropId_;
+		pPage->nTotalCount = streamTotal_;
+		pPage->nAvailableCount = available;
+		pPage->nFirstIndex = first;
+		pPage->nCount = count;
+		pPage->nDataLength = length;
+		pPage->nNextLength = (UINT32)nextLength;
+	}
+	return count;
+}
+
+BOOL DropArena::getPath(const UINT32 dropId, const UINT32 index, std::vector<WCHAR>& path) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (dropId != dropId_ || index >= paths_.size()) return FALSE;
+
+	const Entry& e = paths_[index];
+	const WCHAR* p = &blocks_[e.block][e.offset];
+	path.assign(p, p + e.length);
+	path.push_back(0);
+	return TRUE;
+}
+
+void DropArena::join(std::vector<WCHAR>& buffer, const WCHAR delimiter) {
+	buffer.clear();
+	appendJoined(0, buffer, delimiter);
+	buffer.push_back(0);
+}
+
+void DropArena::joinUtf8(std::string& buffer, const char delimiter) {
+	buffer.clear();
+	appendJoinedUtf8(0, buffer, delimiter);
+}
+
+UINT32 DropArena::appendJoined(const UINT32 firstIndex, std::vector<WCHAR>& buffer, const WCHAR delimiter) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const UINT32 count = (UINT32)paths_.size();
+
+	size_t total = buffer.size() + 1;
+	for (UINT32 i = firstIndex; i < count; i++) {
+		total += (size_t)paths_[i].length + 1;
+	}
+
+	buffer.reserve(total);
+	for (UINT32 i = firstIndex; i < count; i++) {
+		const Entry& e = paths_[i];
+		const WCHAR* p = &blocks_[e.block][e.offset];
+		buffer.insert(buffer.end(), p, p + e.length);
+		buffer.push_back(delimiter);
+	}
+	return (count > firstIndex ? count : firstIndex);
+}
+
+UINT32 DropArena::appendJoinedUtf8(const UINT32 firstIndex, std::string& buffer, const char delimiter) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const UINT32 count = (UINT32)paths_.size();
+
+	const size_t used = buffer.size();
+	size_t total = used;
+	for (UINT32 i = firstIndex; i < count; i++) {
+		total += getUtf8Length(&blocks_[paths_[i].block][paths_[i].offset], paths_[i].length) + 1;
+	}
+
+	buffer.resize(total);
+	char* p = &buffer[used];
+	for (UINT32 i = firstIndex; i < count; i++) {
+		const Entry& e = paths_[i];
+		p += convertToUtf8(&blocks_[e.block][e.offset], e.length, p);
+		*p++ = delimiter;
+	}
+	return (count > firstIndex ? count : firstIndex);
+}
+
+UINT32 DropArena::getCount() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (UINT32)paths_.size();
+}
+
+UINT32 DropArena::getTotalCount() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return streamTotal_;
+}
+
+UINT32 DropArena::getDropId() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return dropId_;
+}
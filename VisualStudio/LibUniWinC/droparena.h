@@ -0,0 +1,138 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include "backend.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Paths of the last drop, kept as UTF-16 data in fixed size blocks and a table of the paths.
+///   The blocks are reused for the next drop, so receiving a drop does not allocate once there are enough of them.
+///   Growing never moves the data taken, so each step of a streaming drop takes a bounded time.
+///   Paths are not delimited, so they may contain any character including '\n'.
+///   Filled on the window thread and read by GetDropFiles() on another, so the access is guarded.
+///   A large drop can be streamed: beginStream() only keeps the HDROP, and continueStream() takes the paths within a time budget.
+/// </summary>
+class DropArena {
+public:
+	DropArena();
+
+	/// <summary>
+	/// Take the paths of the drop. The previous drop is replaced
+	///   DragQueryFile is called once per path unless the path is longer than the free space.
+	/// </summary>
+	/// <returns>Number of the paths</returns>
+	UINT32 collect(WindowBackend* pBackend, HDROP hDrop);
+
+	/// <summary>
+	/// Keep the drop to take its paths later by continueStream(). The previous drop is replaced
+	///   If the previous stream has not finished, the rest of it is taken first.
+	/// </summary>
+	/// <returns>Number of the paths. The HDROP is released if it is 0</returns>
+	UINT32 beginStream(WindowBackend* pBackend, HDROP hDrop);
+
+	/// <summary>
+	/// Take the paths of the streaming drop until the budget runs out
+	///   The HDROP is released when all paths have been taken.
+	/// </summary>
+	/// <param name="budget">Time budget [us]. At least one path is taken</param>
+	/// <param name="pbFinished">Receives TRUE if the stream has finished by this call</param>
+	/// <returns>Number of the paths taken by this call</returns>
+	UINT32 continueStream(const INT64 budget, BOOL* pbFinished);
+
+	/// <summary>
+	/// Take all remaining paths of the streaming drop
+	/// </summary>
+	/// <returns>TRUE if a stream was in progress</returns>
+	BOOL finishStream();
+
+	BOOL isStreaming();
+
+	/// <summary>
+	/// Start a list of paths which do not come from an HDROP, e.g. the files found in the dropped folders
+	/// </summary>
+	/// <param name="dropId">ID reported by getPage(), e.g. the ID of the drop the paths came from</param>
+	void beginList(const UINT32 dropId);
+
+	/// <summary>
+	/// Append paths to the list at once
+	/// </summary>
+	/// <param name="pData">Paths without terminators</param>
+	/// <param name="pLengths">WCHARs of each path</param>
+	void appendList(const WCHAR* pData, const UINT32* pLengths, const UINT32 count);
+
+	/// <summary>
+	/// Copy the paths from firstIndex as many as fit in the buffers
+	///   While streaming, only the paths already taken are copied.
+	/// </summary>
+	/// <param name="pOffsets">Receives count + 1 offsets in pData. Path i is [pOffsets[i], pOffsets[i + 1])</param>
+	/// <param name="maxCount">Maximum number of the paths. pOffsets must have maxCount + 1 elements</param>
+	/// <param name="pData">Receives the paths without terminators</param>
+	/// <param name="pPage">Receives the drop ID, the counts and the data length</param>
+	/// <returns>Number of the paths copied</returns>
+	UINT32 getPage(const UINT32 firstIndex, UINT32* pOffsets, const UINT32 maxCount, WCHAR* pData, const UINT32 dataCapacity, DROPFILESPAGE* pPage);
+
+	/// <summary>
+	/// Copy the paths in UTF-8 in the same way as getPage(). Offsets and lengths are in bytes
+	/// </summary>
+	UINT32 getPageUtf8(const UINT32 firstIndex, UINT32* pOffsets, const UINT32 maxCount, char* pData, const UINT32 dataCapacity, DROPFILESPAGE* pPage);
+
+	/// <summary>
+	/// Copy a path with a terminator
+	/// </summary>
+	/// <returns>FALSE if the drop has been replaced or the path has not been taken yet</returns>
+	BOOL getPath(const UINT32 dropId, const UINT32 index, std::vector<WCHAR>& path);
+
+	/// <summary>
+	/// Paths joined with the delimiter after each path, and a terminator. For the string callback
+	/// </summary>
+	void join(std::vector<WCHAR>& buffer, const WCHAR delimiter);
+	void joinUtf8(std::string& buffer, const char delimiter);
+
+	/// <summary>
+	/// Append the paths from firstIndex with the delimiter after each path, without a terminator
+	///   Called after each step of a streaming drop, so that the joined string is ready when the stream ends.
+	/// </summary>
+	/// <returns>Number of the paths taken, i.e. firstIndex of the next call</returns>
+	UINT32 appendJoined(const UINT32 firstIndex, std::vector<WCHAR>& buffer, const WCHAR delimiter);
+	UINT32 appendJoinedUtf8(const UINT32 firstIndex, std::string& buffer, const char delimiter);
+
+	/// <summary>
+	/// Number of the paths taken
+	/// </summary>
+	UINT32 getCount();
+
+	/// <summary>
+	/// Number of the paths of the drop, including those not taken yet while streaming
+	/// </summary>
+	UINT32 getTotalCount();
+	UINT32 getDropId();
+
+private:
+	static const UINT32 BLOCK_SIZE = 65536;	// WCHARs of a block. A longer path has its own block
+	static const UINT32 MIN_FREE = 1024;	// Free space to keep before querying a path [WCHAR]
+
+	struct Entry {
+		UINT32 block;
+		UINT32 offset;
+		UINT32 length;
+	};
+
+	std::mutex mutex_;
+	std::vector<Entry> paths_;
+	std::vector<std::vector<WCHAR>> blocks_;	// The size of each block is its capacity
+	UINT32 currentBlock_;				// Block to append to
+	UINT32 blockUsed_;					// WCHARs used in the current block
+	UINT32 dropId_;
+
+	// Streaming drop
+	WindowBackend* pStreamBackend_;
+	HDROP hStreamDrop_;					// NULL if not streaming
+	UINT32 streamTotal_;
+
+	UINT32 beginDrop(const UINT32 num);
+	void nextBlock(const UINT32 required);
+	void appendPath(WindowBackend* pBackend, HDROP hDrop, const UINT32 index);
+	void endStream();
+};
@@ -0,0 +1,287 @@
+﻿// dropfileinfo.cpp : Metadata of the dropped files read on worker threads
+
+#include "pch.h"
+#include "dropfileinfo.h"
+#include <cstring>
+
+#ifndef _WIN32
+#include "textcodec.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+DropFileInfoPool::DropFileInfoPool(DropArena& arena) : arena_(arena), maxThreads_(UNIWINC_DROP_INFO_THREADS), bStopping_(FALSE), bCancelled_(FALSE), token_(0),
+	dropId_(0), totalCount_(0), requestedCount_(0), nextIndex_(0), readyCount_(0) {
+}
+
+DropFileInfoPool::~DropFileInfoPool() {
+	stop();
+}
+
+void DropFileInfoPool::setMaxThreads(const UINT32 count) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	maxThreads_ = (count > 0 ? count : 1);
+}
+
+void DropFileInfoPool::request(const UINT32 dropId, const UINT32 count, const UINT32 total) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// 別のドロップなら、読み込み中の分は捨てて最初から
+	if (dropId != dropId_) {
+		token_++;
+		dropId_ = dropId;
+		totalCount_ = total;
+		requestedCount_ = 0;
+		nextIndex_ = 0;
+		readyCount_ = 0;
+		bCancelled_ = FALSE;
+		infos_.assign(total, DROPFILEINFO());
+		done_.assign(total, 0);
+	}
+	if (bCancelled_) return;
+
+	const UINT32 available = (count < totalCount_ ? count : totalCount_);
+	if (available <= requestedCount_) return;
+	requestedCount_ = available;
+
+	// 待っているパスの数だけ、上限までスレッドを起こす
+	const size_t pending = requestedCount_ - nextIndex_;
+	while (threads_.size() < maxThreads_ && threads_.size() < pending) {
+		try {
+			threads_.emplace_back(&DropFileInfoPool::workerMain, this);
+		}
+		catch (...) {
+			break;
+		}
+	}
+	condition_.notify_all();
+}
+
+void DropFileInfoPool::cancel() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	token_++;
+	bCancelled_ = TRUE;
+	requestedCount_ = nextIndex_;
+}
+
+void DropFileInfoPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		token_++;
+		bCancelled_ = TRUE;
+		requestedCount_ = nextIndex_;
+		bStopping_ = TRUE;
+	}
+	condition_.notify_all();
+
+	// 読み込み中のファイルがあれば、その完了を待つことになる
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		threads.swap(threads_);
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	bStopping_ = FALSE;
+}
+
+void DropFileInfoPool::workerMain() {
+	std::vector<WCHAR> path;
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	while (true) {
+		condition_.wait(lock, [this] { return (bStopping_ || nextIndex_ < requestedCount_); });
+		if (bStopping_) break;
+
+		// ドロップの順に取り出す
+		const UINT32 index = nextIndex_++;
+		const UINT32 dropId = dropId_;
+		const UINT32 token = token_.load();
+		lock.unlock();
+
+		DROPFILEINFO info = DROPFILEINFO();
+		if (arena_.getPath(dropId, index, path) && token_.load() == token) {
+			queryFile(path.data(), &info);
+		}
+
+		lock.lock();
+		if (token_.load() != token) continue;		// Cancelled while reading
+
+		infos_[index] = info;
+		done_[index] = 1;
+		while (readyCount_ < requestedCount_ && done_[readyCount_]) {
+			readyCount_++;
+		}
+	}
+}
+
+UINT32 DropFileInfoPool::getPage(const UINT32 firstIndex, DROPFILEINFO* pInfos, const UINT32 maxCount, DROPFILESPAGE* pPage) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const UINT32 first = (firstIndex < readyCount_ ? firstIndex : readyCount_);
+
+	UINT32 count = 0;
+	if (pInfos != NULL) {
+		count = ((readyCount_ - first) < maxCount ? (readyCount_ - first) : maxCount);
+		if (count > 0) {
+			memcpy(pInfos, &infos_[first], (size_t)count * sizeof(DROPFILEINFO));
+		}
+	}
+
+	if (pPage != NULL) {
+		pPage->nDropId = dropId_;
+		pPage->nTotalCount = totalCount_;
+		pPage->nAvailableCount = readyCount_;
+		pPage->nFirstIndex = first;
+		pPage->nCount = count;
+		pPage->nDataLength = 0;
+		pPage->nNextLength = 0;
+	}
+	return count;
+}
+
+UINT32 DropFileInfoPool::getReadyCount(UINT32* pDropId) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (pDropId) *pDropId = dropId_;
+	return readyCount_;
+}
+
+/// <summary>
+/// Compare the bytes at the offset
+/// </summary>
+static inline BOOL matchBytes(const BYTE* pHead, const UINT32 length, const UINT32 offset, const char* pattern, const UINT32 count) {
+	return (offset + count <= length && memcmp(pHead + offset, pattern, count) == 0);
+}
+
+DropFileType DropFileInfoPool::sniffType(const BYTE* pHead, const UINT32 length) {
+	if (pHead == NULL) return DropFileType::Unknown;
+
+	// BOM は MP3 のフレーム同期 (FF Fx) にも見えるので先に調べる
+	if (matchBytes(pHead, length, 0, "\xEF\xBB\xBF", 3)) return DropFileType::Text;
+	if (matchBytes(pHead, length, 0, "\xFF\xFE", 2)) return DropFileType::Text;
+	if (matchBytes(pHead, length, 0, "\xFE\xFF", 2)) return DropFileType::Text;
+
+	if (matchBytes(pHead, length, 0, "\x89PNG\r\n\x1A\n", 8)) return DropFileType::Png;
+	if (matchBytes(pHead, length, 0, "\xFF\xD8\xFF", 3)) return DropFileType::Jpeg;
+	if (matchBytes(pHead, length, 0, "GIF8", 4)) return DropFileType::Gif;
+	if (matchBytes(pHead, length, 0, "RIFF", 4)) {
+		if (matchBytes(pHead, length, 8, "WEBP", 4)) return DropFileType::WebP;
+		if (matchBytes(pHead, length, 8, "WAVE", 4)) return DropFileType::Wav;
+		return DropFileType::Unknown;
+	}
+	if (matchBytes(pHead, length, 0, "II*\0", 4) || matchBytes(pHead, length, 0, "MM\0*", 4)) return DropFileType::Tiff;
+	if (matchBytes(pHead, length, 0, "BM", 2) && length >= 14) return DropFileType::Bmp;
+
+	if (matchBytes(pHead, length, 0, "%PDF-", 5)) return DropFileType::Pdf;
+	if (matchBytes(pHead, length, 0, "PK\x03\x04", 4) || matchBytes(pHead, length, 0, "PK\x05\x06", 4)) return DropFileType::Zip;
+	if (matchBytes(pHead, length, 0, "\x1F\x8B", 2)) return DropFileType::Gzip;
+	if (matchBytes(pHead, length, 0, "7z\xBC\xAF\x27\x1C", 6)) return DropFileType::SevenZip;
+
+	if (matchBytes(pHead, length, 0, "OggS", 4)) return DropFileType::Ogg;
+	if (matchBytes(pHead, length, 0, "fLaC", 4)) return DropFileType::Flac;
+	if (matchBytes(pHead, length, 4, "ftyp", 4)) return DropFileType::Mp4;
+	if (matchBytes(pHead, length, 0, "ID3", 3)) return DropFileType::Mp3;
+	if (length >= 2 && pHead[0] == 0xFF && (pHead[1] & 0xE0) == 0xE0) return DropFileType::Mp3;
+
+	if (matchBytes(pHead, length, 0, "glTF", 4)) return DropFileType::Glb;
+	if (matchBytes(pHead, length, 0, "Kaydara FBX Binary", 18)) return DropFileType::Fbx;
+
+	return DropFileType::Unknown;
+}
+
+#ifdef _WIN32
+
+void DropFileInfoPool::queryFile(const WCHAR* path, DROPFILEINFO* pInfo) {
+	*pInfo = DROPFILEINFO();
+
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data)) return;
+
+	// FILETIME は 1601-01-01 からの 100ns 単位
+	const INT64 fileTime = (INT64)(((UINT64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+	pInfo->nModifiedTime = (fileTime - 116444736000000000LL) / 10000;
+
+	INT32 flags = (INT32)DropFileFlag::Exists;
+	if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+		pInfo->nFlags = flags | (INT32)DropFileFlag::Directory;
+		return;
+	}
+	pInfo->nSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+
+	BYTE head[SNIFF_LENGTH];
+	DWORD length = 0;
+	HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	// パイプやデバイスは読むと止まりうるので、ディスク上のファイルだけ中身を見る
+	if (hFile != INVALID_HANDLE_VALUE && GetFileType(hFile) != FILE_TYPE_DISK) {
+		CloseHandle(hFile);
+		pInfo->nFlags = flags;
+		return;
+	}
+	if (hFile != INVALID_HANDLE_VALUE && ReadFile(hFile, head, sizeof(head), &length, NULL)) {
+		pInfo->nType = (INT32)sniffType(head, length);
+	}
+	else {
+		flags |= (INT32)DropFileFlag::Unreadable;
+	}
+	if (hFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(hFile);
+	}
+	pInfo->nFlags = flags;
+}
+
+#else
+
+void DropFileInfoPool::queryFile(const WCHAR* path, DROPFILEINFO* pInfo) {
+	*pInfo = DROPFILEINFO();
+
+	size_t pathLength = 0;
+	while (path[pathLength]) pathLength++;
+	std::string utf8;
+	appendUtf8(path, pathLength, utf8);
+
+	struct stat st;
+	if (stat(utf8.c_str(), &st) != 0) return;
+
+#if defined(__APPLE__)
+	pInfo->nModifiedTime = (INT64)st.st_mtimespec.tv_sec * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+	pInfo->nModifiedTime = (INT64)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+
+	INT32 flags = (INT32)DropFileFlag::Exists;
+	if (S_ISDIR(st.st_mode)) {
+		pInfo->nFlags = flags | (INT32)DropFileFlag::Directory;
+		return;
+	}
+
+	// FIFO やデバイスは開くだけでも止まりうるので、通常のファイルだけ中身を見る
+	if (!S_ISREG(st.st_mode)) {
+		pInfo->nFlags = flags;
+		return;
+	}
+	pInfo->nSize = (UINT64)st.st_size;
+
+	// stat() の後に差し替えられても止まらないよう、O_NONBLOCK で開いてから確かめ直す
+	BYTE head[SNIFF_LENGTH];
+	const int fd = open(utf8.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+	struct stat opened;
+	const BOOL bRegular = (fd >= 0 && fstat(fd, &opened) == 0 && S_ISREG(opened.st_mode));
+	const ssize_t length = (bRegular ? read(fd, head, sizeof(head)) : -1);
+	if (length >= 0) {
+		pInfo->nType = (INT32)sniffType(head, (UINT32)length);
+	}
+	else {
+		flags |= (INT32)DropFileFlag::Unreadable;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	pInfo->nFlags = flags;
+}
+
+#endif
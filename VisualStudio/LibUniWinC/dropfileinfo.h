@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include "droparena.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Metadata of the dropped files (size, modification time, directory or not, and the type from the first bytes).
+///   The files are read by a few worker threads, so neither the window thread nor PollEvents() waits for the disk.
+///   Paths are dispatched in the order of the drop, and the results become readable in that order:
+///   getReadyCount() only grows over a prefix where all results are done.
+///   A new drop or cancel() changes the cancellation token. Workers check it before and after each file,
+///   and the results for the old token are discarded.
+/// </summary>
+class DropFileInfoPool {
+public:
+	explicit DropFileInfoPool(DropArena& arena);
+	~DropFileInfoPool();
+
+	/// <summary>
+	/// Maximum number of the worker threads. Threads are started when there are paths to read
+	/// </summary>
+	void setMaxThreads(const UINT32 count);
+
+	/// <summary>
+	/// Read the metadata of the paths [0, count) of the drop
+	///   Called again with a larger count while the drop is streamed. Another drop ID cancels the previous drop.
+	/// </summary>
+	/// <param name="total">Number of the paths of the whole drop</param>
+	void request(const UINT32 dropId, const UINT32 count, const UINT32 total);
+
+	/// <summary>
+	/// Stop reading the current drop. Results already done can still be read
+	/// </summary>
+	void cancel();
+
+	/// <summary>
+	/// Cancel and wait for the worker threads to exit
+	/// </summary>
+	void stop();
+
+	/// <summary>
+	/// Copy the results from firstIndex as many as are ready
+	/// </summary>
+	/// <param name="pPage">Receives the drop ID, nTotalCount, nCount and nAvailableCount (the ready count)</param>
+	/// <returns>Number of the results copied</returns>
+	UINT32 getPage(const UINT32 firstIndex, DROPFILEINFO* pInfos, const UINT32 maxCount, DROPFILESPAGE* pPage);
+
+	/// <summary>
+	/// Number of the results which can be read in the order of the drop
+	/// </summary>
+	UINT32 getReadyCount(UINT32* pDropId);
+
+	/// <summary>
+	/// Read the metadata of a file
+	/// </summary>
+	/// <param name="path">Null terminated</param>
+	static void queryFile(const WCHAR* path, DROPFILEINFO* pInfo);
+
+	/// <summary>
+	/// Guess the file type from the first bytes
+	/// </summary>
+	static DropFileType sniffType(const BYTE* pHead, const UINT32 length);
+
+	static const UINT32 SNIFF_LENGTH = 32;	// Bytes read from the head of a file
+
+private:
+	DropArena& arena_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::vector<std::thread> threads_;
+	UINT32 maxThreads_;
+	BOOL bStopping_;
+	BOOL bCancelled_;					// The current drop is not read any more
+	std::atomic<UINT32> token_;			// Cancellation token. Changed to cancel the work in progress
+
+	UINT32 dropId_;
+	UINT32 totalCount_;
+	UINT32 requestedCount_;				// Paths which can be dispatched
+	UINT32 nextIndex_;					// Next path to dispatch
+	UINT32 readyCount_;					// All results before this are done
+	std::vector<DROPFILEINFO> infos_;
+	std::vector<BYTE> done_;
+
+	void workerMain();
+};
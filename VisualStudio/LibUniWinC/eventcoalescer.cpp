@@ -0,0 +1,131 @@
+﻿// eventcoalescer.cpp : Merges and rate-limits the window events
+
+#include "pch.h"
+#include "eventcoalescer.h"
+#include <algorithm>
+
+
+EventCoalescer::EventCoalescer() : slots_(), ready_(), received_(0), delivered_(0), dropped_(0) {
+	ready_.reserve(UNIWINC_EVENT_QUEUE_SIZE);
+	clear();
+}
+
+INT32 EventCoalescer::getSlot(const INT32 type, const INT32 param) {
+	switch ((EventType)type) {
+	case EventType::WindowStateChanged:
+		if (param == (INT32)WindowStateEventType::Resized) return SLOT_RESIZED;
+		if (param == (INT32)WindowStateEventType::StyleChanged) return SLOT_STYLE_CHANGED;
+		return -1;
+	case EventType::MonitorChanged:
+		return SLOT_MONITOR_CHANGED;
+	case EventType::Overflow:
+		return SLOT_OVERFLOW;
+	default:
+		return -1;
+	}
+}
+
+BOOL EventCoalescer::setInterval(const INT32 type, const INT32 param, const UINT32 milliseconds) {
+	INT32 slot = getSlot(type, param);
+	if (slot < 0) return FALSE;
+
+	slots_[slot].interval = (INT64)milliseconds * 1000;
+	return TRUE;
+}
+
+void EventCoalescer::clear() {
+	for (INT32 i = 0; i < SLOT_COUNT; i++) {
+		slots_[i].lastDelivered = 0;
+		slots_[i].bPending = FALSE;
+	}
+	ready_.clear();
+}
+
+UINT64 EventCoalescer::getReceivedCount(const INT32 slot) const {
+	if (slot < 0 || slot >= SLOT_COUNT) return received_;
+	return slots_[slot].received;
+}
+
+UINT64 EventCoalescer::getDeliveredCount(const INT32 slot) const {
+	if (slot < 0 || slot >= SLOT_COUNT) return delivered_;
+	return slots_[slot].delivered;
+}
+
+void EventCoalescer::resetCounts() {
+	received_ = 0;
+	delivered_ = 0;
+	dropped_ = 0;
+	for (INT32 i = 0; i < SLOT_COUNT; i++) {
+		slots_[i].received = 0;
+		slots_[i].delivered = 0;
+	}
+}
+
+/// <summary>
+/// Hold a coalesced event or queue the other events to deliver
+/// </summary>
+void EventCoalescer::add(const UNIWINCEVENT& e) {
+	INT32 index = getSlot(e.nType, e.nParam);
+	if (index < 0) {
+		ready_.push_back(e);
+		received_++;
+		return;
+	}
+
+	Slot& slot = slots_[index];
+	if (index == SLOT_OVERFLOW) {
+		// 失われた数は合計する
+		dropped_ += (UINT64)e.nParam;
+		INT32 lost = e.nParam + (slot.bPending ? slot.pending.nParam : 0);
+		slot.pending = e;
+		slot.pending.nParam = lost;
+	}
+	else {
+		// 後のものが最新の状態を持つ
+		slot.pending = e;
+		received_++;
+		slot.received++;
+	}
+	slot.bPending = TRUE;
+}
+
+UINT32 EventCoalescer::poll(EventQueue& queue, UNIWINCEVENT* pEvents, const UINT32 maxCount) {
+	if (pEvents == NULL || maxCount == 0) return 0;
+
+	// 溜まっているイベントを全て取り出す
+	const size_t firstNew = ready_.size();
+	UNIWINCEVENT buffer[64];
+	UINT32 count;
+	while ((count = queue.pop(buffer, 64)) > 0) {
+		for (UINT32 i = 0; i < count; i++) {
+			add(buffer[i]);
+		}
+	}
+
+	// 間隔が空いていれば、保留していたイベントを送る
+	const INT64 now = EventQueue::now();
+	for (INT32 i = 0; i < SLOT_COUNT; i++) {
+		Slot& slot = slots_[i];
+		if (!slot.bPending) continue;
+		if (slot.lastDelivered != 0 && (now - slot.lastDelivered) < slot.interval) continue;
+
+		ready_.push_back(slot.pending);
+		slot.bPending = FALSE;
+		slot.lastDelivered = now;
+		slot.delivered++;
+	}
+
+	// 発生順に並べる。前回送りきれなかった分は既に並んでいる
+	std::stable_sort(ready_.begin() + firstNew, ready_.end(), [](const UNIWINCEVENT& a, const UNIWINCEVENT& b) {
+		return a.nTimestamp < b.nTimestamp;
+	});
+
+	UINT32 n = (ready_.size() < maxCount ? (UINT32)ready_.size() : maxCount);
+	std::copy(ready_.begin(), ready_.begin() + n, pEvents);
+	ready_.erase(ready_.begin(), ready_.begin() + n);
+
+	for (UINT32 i = 0; i < n; i++) {
+		if (pEvents[i].nType != (INT32)EventType::Overflow) delivered_++;
+	}
+	return n;
+}
@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include "eventqueue.h"
+#include <vector>
+
+/// <summary>
+/// Merges and rate-limits the events taken from an EventQueue before PollEvents() returns them.
+///   Resized, StyleChanged, MonitorChanged and Overflow are coalesced: within one poll only the last of each is kept
+///   (last value wins, so it has the final geometry), and it is delivered only if its minimum interval has passed
+///   since the previous delivery. Otherwise it is held and delivered by a later poll, so the last event of a burst is never lost.
+///   The other events are delivered as they are. Events are returned in the order of their timestamps.
+///   Not thread safe. Use it from the thread which calls PollEvents().
+/// </summary>
+class EventCoalescer {
+public:
+	EventCoalescer();
+
+	/// <summary>
+	/// Set the minimum interval between deliveries of a coalesced event
+	/// </summary>
+	/// <param name="type">EventType</param>
+	/// <param name="param">WindowStateEventType if type is WindowStateChanged</param>
+	/// <returns>FALSE if the event is not coalesced</returns>
+	BOOL setInterval(const INT32 type, const INT32 param, const UINT32 milliseconds);
+
+	/// <summary>
+	/// Take the events from the queue and return the events to deliver
+	///   Events which do not fit in the buffer are kept for the next call.
+	/// </summary>
+	/// <returns>Number of events written</returns>
+	UINT32 poll(EventQueue& queue, UNIWINCEVENT* pEvents, const UINT32 maxCount);
+
+	/// <summary>
+	/// Discard the held events
+	/// </summary>
+	void clear();
+
+	UINT64 getReceivedCount(const INT32 slot = -1) const;
+	UINT64 getDeliveredCount(const INT32 slot = -1) const;
+	UINT64 getDroppedCount() const { return dropped_; }
+	void resetCounts();
+
+	// Coalesced events
+	static const INT32 SLOT_RESIZED = 0;
+	static const INT32 SLOT_STYLE_CHANGED = 1;
+	static const INT32 SLOT_MONITOR_CHANGED = 2;
+	static const INT32 SLOT_OVERFLOW = 3;
+	static const INT32 SLOT_COUNT = 4;
+
+	/// <summary>
+	/// Slot of the coalesced event, or -1
+	/// </summary>
+	static INT32 getSlot(const INT32 type, const INT32 param);
+
+private:
+	struct Slot {
+		INT64 interval;			// [us]
+		INT64 lastDelivered;	// Timestamp of the last delivery [us]
+		BOOL bPending;
+		UNIWINCEVENT pending;	// Last event not delivered yet
+		UINT64 received;
+		UINT64 delivered;
+	};
+
+	Slot slots_[SLOT_COUNT];
+	std::vector<UNIWINCEVENT> ready_;	// Events to deliver in the order of timestamps
+	UINT64 received_;
+	UINT64 delivered_;
+	UINT64 dropped_;					// Reported by the Overflow events
+
+	void add(const UNIWINCEVENT& e);
+};
@@ -0,0 +1,91 @@
+﻿// eventqueue.cpp : Lock-free queue of the window events
+
+#include "pch.h"
+#include "eventqueue.h"
+#include <chrono>
+
+
+EventQueue::EventQueue(const UINT32 capacity) : slots_(), mask_(0), head_(0), tail_(0), pushed_(0), dropped_(0), reportedDrops_(0) {
+	UINT32 size = 2;
+	while (size < capacity && size < 0x80000000u) {
+		size <<= 1;
+	}
+	mask_ = size - 1;
+
+	// std::atomic はコピーできないため、要素数を指定して作ってから初期化
+	std::vector<Slot> slots(size);
+	slots_.swap(slots);
+	for (UINT32 i = 0; i < size; i++) {
+		slots_[i].sequence.store(i, std::memory_order_relaxed);
+		slots_[i].event = UNIWINCEVENT();
+	}
+}
+
+INT64 EventQueue::now() {
+	return (INT64)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BOOL EventQueue::push(const UNIWINCEVENT& event) {
+	UINT32 pos = head_.load(std::memory_order_relaxed);
+	Slot* slot;
+
+	for (;;) {
+		slot = &slots_[pos & mask_];
+		const UINT32 seq = slot->sequence.load(std::memory_order_acquire);
+		const INT32 diff = (INT32)(seq - pos);
+
+		if (diff == 0) {
+			// 空きスロット。他の送り手と競合しなければ確保できる
+			if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		}
+		else if (diff < 0) {
+			// 一周前のイベントがまだ取り出されていない（満杯）
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return FALSE;
+		}
+		else {
+			pos = head_.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->event = event;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	pushed_.fetch_add(1, std::memory_order_relaxed);
+	return TRUE;
+}
+
+UINT32 EventQueue::pop(UNIWINCEVENT* pEvents, const UINT32 maxCount) {
+	if (pEvents == NULL || maxCount == 0) return 0;
+
+	// 溢れを通知する分を1つ残しておく
+	const UINT64 dropped = dropped_.load(std::memory_order_relaxed);
+	const BOOL bOverflow = (dropped != reportedDrops_);
+	const UINT32 limit = (bOverflow ? maxCount - 1 : maxCount);
+
+	UINT32 count = 0;
+	while (count < limit) {
+		Slot& slot = slots_[tail_ & mask_];
+		const UINT32 seq = slot.sequence.load(std::memory_order_acquire);
+		if ((INT32)(seq - (tail_ + 1)) < 0) break;		// Empty
+
+		pEvents[count++] = slot.event;
+		slot.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+		tail_++;
+	}
+
+	if (bOverflow) {
+		UNIWINCEVENT& e = pEvents[count++];
+		e = UNIWINCEVENT();
+		e.nType = (INT32)EventType::Overflow;
+		e.nParam = (INT32)(dropped - reportedDrops_);
+		e.nTimestamp = now();
+		reportedDrops_ = dropped;
+	}
+	return count;
+}
+
+void EventQueue::clear() {
+	UNIWINCEVENT events[16];
+	while (pop(events, 16) > 0) {
+	}
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include <atomic>
+#include <vector>
+
+/// <summary>
+/// Bounded lock-free queue of the events for PollEvents().
+///   Slots are allocated in the constructor, so push() never allocates nor blocks.
+///   One consumer (PollEvents). Producers may be the window thread and the thread calling the exported functions,
+///   so each slot has a sequence number to hand it over (Vyukov's bounded queue).
+///   When the queue is full, the new event is dropped and counted. pop() reports it with an EventType::Overflow event.
+/// </summary>
+class EventQueue {
+public:
+	/// <param name="capacity">Rounded up to a power of 2</param>
+	explicit EventQueue(const UINT32 capacity);
+
+	/// <summary>
+	/// Add an event. Called by producers
+	/// </summary>
+	/// <returns>FALSE if the queue was full and the event has been dropped</returns>
+	BOOL push(const UNIWINCEVENT& event);
+
+	/// <summary>
+	/// Take events in the order they were pushed. Called by the consumer
+	///   If events have been dropped since the last call, an EventType::Overflow event with the number is added at the end.
+	/// </summary>
+	/// <returns>Number of events written</returns>
+	UINT32 pop(UNIWINCEVENT* pEvents, const UINT32 maxCount);
+
+	/// <summary>
+	/// Discard all events. Called by the consumer
+	/// </summary>
+	void clear();
+
+	UINT32 getCapacity() const { return mask_ + 1; }
+	UINT64 getPushedCount() const { return pushed_.load(std::memory_order_relaxed); }
+	UINT64 getDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Monotonic time for the timestamps [us]
+	/// </summary>
+	static INT64 now();
+
+private:
+	struct Slot {
+		std::atomic<UINT32> sequence;	// == position : empty, == position + 1 : filled
+		UNIWINCEVENT event;
+	};
+
+	std::vector<Slot> slots_;
+	UINT32 mask_;
+
+	std::atomic<UINT32> head_;			// Next position to push
+	UINT32 tail_;						// Next position to pop. Only the consumer touches it
+	std::atomic<UINT64> pushed_;
+	std::atomic<UINT64> dropped_;
+	UINT64 reportedDrops_;				// Dropped count already reported by pop()
+};
@@ -0,0 +1,213 @@
+﻿// extensionmatcher.cpp : Case-insensitive matcher of file extensions
+
+#include "pch.h"
+#include "extensionmatcher.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNIWINC_EXTENSION_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define UNIWINC_EXTENSION_NEON
+#include <arm_neon.h>
+#endif
+
+
+static const UINT32 NO_NODE = 0xFFFFFFFF;
+
+static inline WCHAR toLowerAscii(const WCHAR c) {
+	return ((c >= L'A' && c <= L'Z') ? (WCHAR)(c + (L'a' - L'A')) : c);
+}
+
+static inline BOOL isPathSeparator(const WCHAR c) {
+	return (c == L'\\' || c == L'/');
+}
+
+
+ExtensionMatcher::ExtensionMatcher() : maxLength_(0) {
+	nodes_.push_back({ 0, 0, 0, 0 });
+}
+
+void ExtensionMatcher::foldCase(const WCHAR* pSource, const size_t length, WCHAR* pDestination) {
+	size_t i = 0;
+
+#if defined(UNIWINC_EXTENSION_SSE2)
+	// 8 characters at once. Characters from 0x8000 are negative as signed, so they are not in the range
+	const __m128i before = _mm_set1_epi16((short)(L'A' - 1));
+	const __m128i after = _mm_set1_epi16((short)(L'Z' + 1));
+	const __m128i difference = _mm_set1_epi16((short)(L'a' - L'A'));
+	for (; i + 8 <= length; i += 8) {
+		const __m128i c = _mm_loadu_si128((const __m128i*)(pSource + i));
+		const __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(c, before), _mm_cmplt_epi16(c, after));
+		_mm_storeu_si128((__m128i*)(pDestination + i), _mm_add_epi16(c, _mm_and_si128(upper, difference)));
+	}
+#elif defined(UNIWINC_EXTENSION_NEON)
+	const uint16x8_t first = vdupq_n_u16((uint16_t)L'A');
+	const uint16x8_t last = vdupq_n_u16((uint16_t)L'Z');
+	const uint16x8_t difference = vdupq_n_u16((uint16_t)(L'a' - L'A'));
+	for (; i + 8 <= length; i += 8) {
+		const uint16x8_t c = vld1q_u16((const uint16_t*)(pSource + i));
+		const uint16x8_t upper = vandq_u16(vcgeq_u16(c, first), vcleq_u16(c, last));
+		vst1q_u16((uint16_t*)(pDestination + i), vaddq_u16(c, vandq_u16(upper, difference)));
+	}
+#endif
+
+	// Remaining characters
+	for (; i < length; i++) {
+		pDestination[i] = toLowerAscii(pSource[i]);
+	}
+}
+
+void ExtensionMatcher::add(const WCHAR* ext, const size_t length) {
+	if (ext == NULL || length == 0) return;
+
+	// 末尾から辿るため、逆順で持つ
+	std::vector<WCHAR> reversed(length);
+	for (size_t i = 0; i < length; i++) {
+		reversed[i] = toLowerAscii(ext[length - 1 - i]);
+	}
+	pending_.push_back(reversed);
+	if (length > maxLength_) maxLength_ = length;
+}
+
+void ExtensionMatcher::build() {
+	std::sort(pending_.begin(), pending_.end());
+	pending_.erase(std::unique(pending_.begin(), pending_.end()), pending_.end());
+
+	nodes_.clear();
+	nodes_.push_back({ 0, 0, 0, 0 });
+	if (!pending_.empty()) {
+		buildNode(0, 0, pending_.size(), 0);
+	}
+	pending_.clear();
+	pending_.shrink_to_fit();
+}
+
+/// <summary>
+/// Make the children of the node from the sorted extensions [first, last) which share the first depth characters
+/// </summary>
+void ExtensionMatcher::buildNode(const UINT32 index, const size_t first, const size_t last, const size_t depth) {
+	size_t i = first;
+
+	// ちょうどここで終わる拡張子は、ソート順で先頭に来る
+	while (i < last && pending_[i].size() == depth) {
+		nodes_[index].bTerminal = 1;
+		i++;
+	}
+
+	// 次の文字ごとにまとめて子にする
+	std::vector<std::pair<size_t, size_t>> ranges;
+	const UINT32 firstChild = (UINT32)nodes_.size();
+	while (i < last) {
+		const WCHAR c = pending_[i][depth];
+		size_t end = i + 1;
+		while (end < last && pending_[end][depth] == c) end++;
+
+		nodes_.push_back({ c, 0, 0, 0 });
+		ranges.push_back(std::make_pair(i, end));
+		i = end;
+	}
+	nodes_[index].firstChild = firstChild;
+	nodes_[index].childCount = (UINT32)ranges.size();
+
+	for (size_t k = 0; k < ranges.size(); k++) {
+		buildNode(firstChild + (UINT32)k, ranges[k].first, ranges[k].second, depth + 1);
+	}
+}
+
+UINT32 ExtensionMatcher::findChild(const Node& node, const WCHAR c) const {
+	const Node* children = nodes_.data() + node.firstChild;
+	UINT32 low = 0;
+	UINT32 high = node.childCount;
+
+	// 子が少なければ順に、多ければ二分探索
+	if (high <= 8) {
+		for (UINT32 i = 0; i < high; i++) {
+			if (children[i].c == c) return node.firstChild + i;
+		}
+		return NO_NODE;
+	}
+	while (low < high) {
+		const UINT32 mid = (low + high) / 2;
+		if (children[mid].c < c) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return ((low < node.childCount && children[low].c == c) ? node.firstChild + low : NO_NODE);
+}
+
+/// <summary>
+/// Walk the trie from the end of the tail
+/// </summary>
+/// <param name="tail">Last characters of the name, at most maxLength_ + 1</param>
+/// <param name="bFolded">FALSE if the tail has to be folded character by character</param>
+BOOL ExtensionMatcher::matchFolded(const WCHAR* tail, const size_t length, const BOOL bFolded) const {
+	const Node* node = &nodes_[0];
+	size_t i = length;
+
+	while (i > 0) {
+		const WCHAR c = (bFolded ? tail[i - 1] : toLowerAscii(tail[i - 1]));
+		if (isPathSeparator(c)) return FALSE;
+
+		const UINT32 child = findChild(*node, c);
+		if (child == NO_NODE) return FALSE;
+
+		node = &nodes_[child];
+		i--;
+		if (node->bTerminal && i > 0 && tail[i - 1] == L'.') return TRUE;
+	}
+	return FALSE;
+}
+
+BOOL ExtensionMatcher::match(const WCHAR* name, const size_t length) const {
+	if (isEmpty() || name == NULL) return FALSE;
+
+	const size_t n = (length < maxLength_ + 1 ? length : maxLength_ + 1);
+	const WCHAR* tail = name + (length - n);
+	if (n > FOLD_BUFFER_LENGTH) return matchFolded(tail, n, FALSE);
+
+	WCHAR folded[FOLD_BUFFER_LENGTH];
+	foldCase(tail, n, folded);
+	return matchFolded(folded, n, TRUE);
+}
+
+UINT32 ExtensionMatcher::matchPaths(const UINT32* pOffsets, const WCHAR* pData, const UINT32 count, BYTE* pResults) const {
+	if (pOffsets == NULL || pData == NULL || pResults == NULL) return 0;
+
+	const size_t window = maxLength_ + 1;
+	const size_t alignedWindow = (window + 7) & ~(size_t)7;
+	const BOOL bBuffered = (alignedWindow <= FOLD_BUFFER_LENGTH);
+	WCHAR folded[FOLD_BUFFER_LENGTH];
+	UINT32 matched = 0;
+
+	for (UINT32 i = 0; i < count; i++) {
+		const UINT32 start = pOffsets[i];
+		const UINT32 end = pOffsets[i + 1];
+		BOOL bMatch = FALSE;
+
+		if (!isEmpty() && end > start) {
+			// 拡張子の入りうる末尾だけを小文字化して辿る
+			const size_t n = ((end - start) < window ? (end - start) : window);
+			const WCHAR* tail = pData + end - n;
+			if (bBuffered && end >= alignedWindow) {
+				// 8 文字単位で小文字化できるよう、前のパスの文字も含めて末尾を取る。辿るのはこのパスの分だけ
+				foldCase(pData + end - alignedWindow, alignedWindow, folded);
+				bMatch = matchFolded(folded + alignedWindow - n, n, TRUE);
+			}
+			else if (bBuffered) {
+				foldCase(tail, n, folded);
+				bMatch = matchFolded(folded, n, TRUE);
+			}
+			else {
+				bMatch = matchFolded(tail, n, FALSE);
+			}
+		}
+
+		pResults[i] = (bMatch ? 1 : 0);
+		if (bMatch) matched++;
+	}
+	return matched;
+}
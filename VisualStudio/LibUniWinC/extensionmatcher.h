@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <vector>
+
+/// <summary>
+/// Case-insensitive matcher of file extensions, e.g. "png" or "tar.gz".
+///   The extensions are kept in a trie of the reversed characters, so a name is tested by walking back from its end once
+///   regardless of the number of the extensions. The children of each node are contiguous and sorted by the character.
+///   ASCII letters are folded to lower case, 8 characters at once with SSE2 or NEON if available.
+///   Build it by add() and build(), then it is read-only and may be used from any thread.
+/// </summary>
+class ExtensionMatcher {
+public:
+	ExtensionMatcher();
+
+	/// <summary>
+	/// Add an extension without "*.". build() must be called after adding
+	/// </summary>
+	void add(const WCHAR* ext, const size_t length);
+
+	/// <summary>
+	/// Make the trie from the extensions added
+	/// </summary>
+	void build();
+
+	BOOL isEmpty() const { return (nodes_.size() <= 1); }
+
+	/// <summary>
+	/// TRUE if the name ends with "." and any extension
+	/// </summary>
+	/// <param name="name">File name, or a path whose extension is tested</param>
+	BOOL match(const WCHAR* name, const size_t length) const;
+
+	/// <summary>
+	/// Test the paths of an offsets + data list at once
+	/// </summary>
+	/// <param name="pOffsets">count + 1 offsets. Path i is pData[pOffsets[i]] to pData[pOffsets[i + 1] - 1]</param>
+	/// <param name="pResults">Receives 1 for each path which matches, otherwise 0</param>
+	/// <returns>Number of the paths which match</returns>
+	UINT32 matchPaths(const UINT32* pOffsets, const WCHAR* pData, const UINT32 count, BYTE* pResults) const;
+
+	/// <summary>
+	/// Convert 'A' to 'Z' into lower case. Other characters are copied as they are
+	/// </summary>
+	static void foldCase(const WCHAR* pSource, const size_t length, WCHAR* pDestination);
+
+private:
+	static const size_t FOLD_BUFFER_LENGTH = 256;	// Longer extensions are folded character by character
+
+	struct Node {
+		WCHAR c;				// Character from the parent
+		BYTE bTerminal;			// An extension ends here
+		UINT32 childCount;
+		UINT32 firstChild;		// Index in nodes_
+	};
+
+	std::vector<std::vector<WCHAR>> pending_;		// Reversed and folded extensions added
+	std::vector<Node> nodes_;						// nodes_[0] is the root
+	size_t maxLength_;
+
+	void buildNode(const UINT32 index, const size_t first, const size_t last, const size_t depth);
+	UINT32 findChild(const Node& node, const WCHAR c) const;
+	BOOL matchFolded(const WCHAR* tail, const size_t length, const BOOL bFolded) const;
+};
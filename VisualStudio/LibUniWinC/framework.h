@@ -1,11 +1,22 @@
 ﻿#pragma once
 
+#ifdef _WIN32
+
 #define WIN32_LEAN_AND_MEAN		// Exclude lesser used parts of Windows headers
 #define STRICT					// Enable STRICT
 
 // Headers used in this library
 #include <windows.h>
 #include <commdlg.h>
+#include <cderr.h>
 #include <dwmapi.h>
 #include <shellapi.h>
 #include <new>
+
+#else
+
+// Win32 compatible types and constants for building without the Windows SDK
+#include "win32compat.h"
+#include <new>
+
+#endif
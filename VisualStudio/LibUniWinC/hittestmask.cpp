@@ -0,0 +1,141 @@
+﻿// hittestmask.cpp : 1 bit per pixel hit test mask
+
+#include "pch.h"
+#include "hittestmask.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNIWINC_HITTEST_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define UNIWINC_HITTEST_NEON
+#include <arm_neon.h>
+#endif
+
+
+HitTestMask::HitTestMask() {
+}
+
+/// <summary>
+/// Pack 8 pixels or fewer
+/// </summary>
+static BYTE packAlphaScalar(const BYTE* pAlpha, const UINT32 count, const BYTE threshold) {
+	BYTE bits = 0;
+	for (UINT32 i = 0; i < count; i++) {
+		if (pAlpha[i] >= threshold) {
+			bits |= (BYTE)(1 << i);
+		}
+	}
+	return bits;
+}
+
+void HitTestMask::packAlpha(const BYTE* pAlpha, const UINT32 count, const BYTE threshold, BYTE* pBits) {
+	UINT32 i = 0;
+
+#if defined(UNIWINC_HITTEST_SSE2)
+	// 16 pixels at once. a >= t  <=>  max(a, t) == a
+	const __m128i t = _mm_set1_epi8((char)threshold);
+	for (; i + 16 <= count; i += 16) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(pAlpha + i));
+		const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(a, t), a));
+		pBits[i / 8] = (BYTE)(mask & 0xFF);
+		pBits[i / 8 + 1] = (BYTE)((mask >> 8) & 0xFF);
+	}
+#elif defined(UNIWINC_HITTEST_NEON)
+	// 16 pixels at once. Weight each lane by its bit and sum them up for each 8 lanes
+	static const BYTE weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	const uint8x16_t w = vld1q_u8(weights);
+	const uint8x16_t t = vdupq_n_u8(threshold);
+	for (; i + 16 <= count; i += 16) {
+		const uint8x16_t m = vandq_u8(vcgeq_u8(vld1q_u8(pAlpha + i), t), w);
+		uint8x8_t s = vpadd_u8(vget_low_u8(m), vget_high_u8(m));
+		s = vpadd_u8(s, s);
+		s = vpadd_u8(s, s);
+		pBits[i / 8] = vget_lane_u8(s, 0);
+		pBits[i / 8 + 1] = vget_lane_u8(s, 1);
+	}
+#endif
+
+	// Remaining pixels
+	for (; i < count; i += 8) {
+		const UINT32 n = ((count - i) < 8 ? (count - i) : 8);
+		pBits[i / 8] = packAlphaScalar(pAlpha + i, n, threshold);
+	}
+}
+
+BOOL HitTestMask::setAlpha(const BYTE* pAlpha, const INT32 width, const INT32 height, const BYTE threshold) {
+	if (pAlpha == NULL || width <= 0 || height <= 0) return FALSE;
+
+	std::lock_guard<std::mutex> writeLock(writeMutex_);
+	const UINT32 stride = getStride(width);
+	band_.resize((size_t)stride * RegionIndex::TILE_SIZE);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		index_.resize(width, height);
+	}
+
+	// タイル1行分ずつ詰めて、変化したタイルのみ更新
+	for (INT32 y0 = 0, ty = 0; y0 < height; y0 += RegionIndex::TILE_SIZE, ty++) {
+		const INT32 rows = ((height - y0) < RegionIndex::TILE_SIZE ? (height - y0) : RegionIndex::TILE_SIZE);
+		for (INT32 r = 0; r < rows; r++) {
+			packAlpha(pAlpha + (size_t)width * (y0 + r), (UINT32)width, threshold, band_.data() + (size_t)stride * r);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		index_.updateTileRow(ty, band_.data(), stride);
+	}
+	return TRUE;
+}
+
+BOOL HitTestMask::setBits(const BYTE* pBits, const INT32 width, const INT32 height) {
+	if (pBits == NULL || width <= 0 || height <= 0) return FALSE;
+
+	std::lock_guard<std::mutex> writeLock(writeMutex_);
+	std::lock_guard<std::mutex> lock(mutex_);
+	index_.update(pBits, getStride(width), width, height);
+	return TRUE;
+}
+
+void HitTestMask::clear() {
+	std::lock_guard<std::mutex> writeLock(writeMutex_);
+	std::lock_guard<std::mutex> lock(mutex_);
+	index_.clear();
+}
+
+BOOL HitTestMask::isEmpty() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return index_.isEmpty();
+}
+
+UINT64 HitTestMask::getVersion() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return index_.getVersion();
+}
+
+BOOL HitTestMask::hitTest(const INT32 x, const INT32 y, const INT32 clientWidth, const INT32 clientHeight) {
+	// Outside of the client area is not our business
+	if (x < 0 || y < 0 || x >= clientWidth || y >= clientHeight) return TRUE;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (index_.isEmpty()) return TRUE;
+
+	// Scale to the mask. The mask is bottom-up
+	const INT32 width = index_.getWidth();
+	const INT32 height = index_.getHeight();
+	const INT32 mx = (INT32)(((INT64)x * width) / clientWidth);
+	const INT32 my = height - 1 - (INT32)(((INT64)y * height) / clientHeight);
+
+	return index_.test(mx, my);
+}
+
+BOOL HitTestMask::getRegion(std::vector<RECT>& rects, const INT32 clientWidth, const INT32 clientHeight, UINT64* pVersion) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (pVersion) *pVersion = index_.getVersion();
+
+	if (index_.isEmpty()) {
+		rects.clear();
+		return FALSE;
+	}
+	index_.getRects(rects, clientWidth, clientHeight);
+	return TRUE;
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include "regionindex.h"
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// 1 bit per pixel mask to decide whether a point of the client area is opaque.
+///   The mask may be smaller than the client area (e.g. downsampled by 1/4). It is scaled to the client area.
+///   Row 0 is the bottom row, the same as Unity textures.
+///   The bits are kept in a RegionIndex, so only the tiles which changed are rebuilt on each update.
+///   set*() and hitTest() may be called from different threads.
+/// </summary>
+class HitTestMask {
+public:
+	HitTestMask();
+
+	/// <summary>
+	/// Build the mask from 8 bit alpha values
+	/// </summary>
+	/// <param name="pAlpha">width * height alpha values. Row 0 is the bottom</param>
+	/// <param name="threshold">Pixels whose alpha is greater than or equal to this value are opaque</param>
+	BOOL setAlpha(const BYTE* pAlpha, const INT32 width, const INT32 height, const BYTE threshold);
+
+	/// <summary>
+	/// Set the mask which is already packed
+	/// </summary>
+	/// <param name="pBits">LSB first bits. Each row is padded to a byte boundary (see getStride)</param>
+	BOOL setBits(const BYTE* pBits, const INT32 width, const INT32 height);
+
+	void clear();
+	BOOL isEmpty();
+
+	/// <summary>
+	/// Check the mask at the point
+	/// </summary>
+	/// <param name="x">Client X coordinate, left is 0</param>
+	/// <param name="y">Client Y coordinate, top is 0</param>
+	/// <returns>FALSE only if the point is inside the client area and transparent on the mask</returns>
+	BOOL hitTest(const INT32 x, const INT32 y, const INT32 clientWidth, const INT32 clientHeight);
+
+	/// <summary>
+	/// Opaque area as rectangles in client coordinates, e.g. for an input region of the window
+	/// </summary>
+	/// <param name="pVersion">Receives the version of the mask the rectangles came from</param>
+	/// <returns>FALSE if no mask is set</returns>
+	BOOL getRegion(std::vector<RECT>& rects, const INT32 clientWidth, const INT32 clientHeight, UINT64* pVersion);
+
+	/// <summary>
+	/// Incremented whenever the mask changes
+	/// </summary>
+	UINT64 getVersion();
+
+	/// <summary>
+	/// Bytes of a packed row
+	/// </summary>
+	static UINT32 getStride(const INT32 width) { return ((UINT32)width + 7) / 8; }
+
+	/// <summary>
+	/// Pack alpha values into LSB first bits. (count + 7) / 8 bytes are written.
+	/// </summary>
+	static void packAlpha(const BYTE* pAlpha, const UINT32 count, const BYTE threshold, BYTE* pBits);
+
+private:
+	std::mutex mutex_;				// Guards index_
+	std::mutex writeMutex_;			// Serializes set*()
+	RegionIndex index_;
+	std::vector<BYTE> band_;		// Packed rows of one row of tiles, used by setAlpha()
+};
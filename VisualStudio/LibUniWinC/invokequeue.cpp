@@ -0,0 +1,66 @@
+﻿// invokequeue.cpp : Changes requested by other threads, run on the window thread
+
+#include "pch.h"
+#include "invokequeue.h"
+
+
+InvokeQueue::InvokeQueue() : windowThread_(std::thread::id()), pending_(0), posted_(0), bWakeRequested_(FALSE), bRunning_(FALSE) {
+}
+
+void InvokeQueue::bindCurrentThread() {
+	windowThread_.store(std::this_thread::get_id(), std::memory_order_release);
+}
+
+BOOL InvokeQueue::bindIfUnbound() {
+	const std::thread::id current = std::this_thread::get_id();
+	std::thread::id unbound;
+	if (windowThread_.compare_exchange_strong(unbound, current, std::memory_order_acq_rel)) return TRUE;
+	return (unbound == current);
+}
+
+BOOL InvokeQueue::isWindowThread() const {
+	// 既定の id はどのスレッドとも一致しないので、バインド前は全てのスレッドで FALSE となる
+	return (windowThread_.load(std::memory_order_acquire) == std::this_thread::get_id());
+}
+
+BOOL InvokeQueue::post(std::function<void()>&& function) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	try {
+		queue_.push_back(std::move(function));
+	}
+	catch (...) {
+		return FALSE;
+	}
+	pending_.fetch_add(1, std::memory_order_release);
+	posted_.fetch_add(1, std::memory_order_relaxed);
+	return TRUE;
+}
+
+UINT32 InvokeQueue::run() {
+	// 実行中の関数から呼ばれた場合（ウィンドウプロシージャ経由など）は、外側の run() に任せる
+	if (bRunning_) return 0;
+	bRunning_ = TRUE;
+
+	UINT32 count = 0;
+
+	// 実行中に追加された分も続けて実行する。実行中はロックを持たないので、関数の中から post() してもよい
+	while (!isEmpty()) {
+		// これ以降に追加されたものは、改めて起こしてもらう
+		bWakeRequested_.store(FALSE, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_.swap(queue_);
+			pending_.store(0, std::memory_order_release);
+		}
+
+		for (size_t i = 0; i < running_.size(); i++) {
+			running_[i]();
+		}
+		count += (UINT32)running_.size();
+
+		// 確保した領域は次回も使う
+		running_.clear();
+	}
+	bRunning_ = FALSE;
+	return count;
+}
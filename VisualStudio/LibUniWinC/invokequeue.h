@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Changes requested by other threads, run later on the window thread.
+///   The window thread is bound by bindCurrentThread(), or by the first bindIfUnbound(). Until then, no thread is the window thread,
+///   so the changes requested before are queued and run once the window thread is bound.
+///   Any thread may post a function. The window thread runs them in the order they were posted,
+///   so the changes from one thread are applied in the order they were made.
+///   Only posting takes a lock. isWindowThread() and isEmpty() are wait-free.
+/// </summary>
+class InvokeQueue {
+public:
+	InvokeQueue();
+
+	/// <summary>
+	/// Make the calling thread the window thread
+	/// </summary>
+	void bindCurrentThread();
+
+	/// <summary>
+	/// Make the calling thread the window thread if no thread is bound yet
+	/// </summary>
+	/// <returns>TRUE if the calling thread is the window thread</returns>
+	BOOL bindIfUnbound();
+
+	/// <summary>
+	/// TRUE if called on the window thread. FALSE on every thread until one is bound
+	/// </summary>
+	BOOL isWindowThread() const;
+
+	/// <summary>
+	/// Queue the function. Any thread may call this
+	/// </summary>
+	/// <returns>FALSE if failed to allocate</returns>
+	BOOL post(std::function<void()>&& function);
+
+	/// <summary>
+	/// Run the queued functions, including the ones posted while running. Called on the window thread
+	///   Does nothing if called from one of the functions.
+	/// </summary>
+	/// <returns>Number of the functions run</returns>
+	UINT32 run();
+
+	BOOL isEmpty() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+	/// <summary>
+	/// TRUE only for the first call since run() started, so that the window thread is woken once for the functions posted meanwhile
+	/// </summary>
+	BOOL requestWake() { return !bWakeRequested_.exchange(TRUE, std::memory_order_acq_rel); }
+
+	/// <summary>
+	/// Number of the functions posted so far
+	/// </summary>
+	UINT64 getPostedCount() const { return posted_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<std::thread::id> windowThread_;
+	std::mutex mutex_;
+	std::vector<std::function<void()>> queue_;		// Guarded by mutex_
+	std::vector<std::function<void()>> running_;	// Used only by run()
+	std::atomic<UINT32> pending_;
+	std::atomic<UINT64> posted_;
+	std::atomic<BOOL> bWakeRequested_;
+	BOOL bRunning_;									// Used only by run()
+
+	InvokeQueue(const InvokeQueue&) = delete;
+	InvokeQueue& operator=(const InvokeQueue&) = delete;
+};
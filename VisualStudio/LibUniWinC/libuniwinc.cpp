@@ -2,54 +2,218 @@
 
 #include "pch.h"
 #include "libuniwinc.h"
-
-
-static HWND hTargetWnd_ = NULL;
-static HWND hPanelOwnerWnd_ = NULL;
-static WINDOWINFO originalWindowInfo_;
-static WINDOWPLACEMENT originalWindowPlacement_;
-static HWND hParentWnd_ = NULL;
-static BOOL bExpedtDesktopWnd = FALSE;
-static HWND hDesktopWnd_ = NULL;
-static SIZE szOriginaiBorder_;
-static POINT ptVirtualScreen_;
-static SIZE szVirtualScreen_;
-static INT nPrimaryMonitorHeight_;
-static BOOL bIsTransparent_ = FALSE;
-static BOOL bIsBorderless_ = FALSE;
-static BYTE byAlpha_ = 0xFF;						// ウィンドウ全体の透明度 0x00:透明 ～ 0xFF:不透明
-static BOOL bIsTopmost_ = FALSE;
-static BOOL bIsBottommost_ = FALSE;
-static BOOL bIsBackground_ = FALSE;
-static BOOL bIsClickThrough_ = FALSE;
-static BOOL bAllowDropFile_ = FALSE;
-static COLORREF dwKeyColor_ = 0x00000000;		// AABBGGRR
-static TransparentType nTransparentType_ = TransparentType::Alpha;
-static TransparentType nCurrentTransparentType_ = TransparentType::Alpha;
-static INT nMonitorCount_ = 0;							// モニタ数。モニタ解像度一覧取得時は一時的に0に戻る
-static RECT pMonitorRect_[UNIWINC_MAX_MONITORCOUNT];	// EnumDisplayMonitorsの順番で保持した、各画面のRECT
-static INT pMonitorIndices_[UNIWINC_MAX_MONITORCOUNT];	// このライブラリ独自のモニタ番号をキーとした、EnumDisplayMonitorsでの順番
-static HMONITOR hMonitors_[UNIWINC_MAX_MONITORCOUNT];	// Monitor handles
-static WNDPROC lpMyWndProc_ = NULL;
-static WNDPROC lpOriginalWndProc_ = NULL;
+#include "backend.h"
+#include "backend_batch.h"
+#include "hittestmask.h"
+#include "dragmove.h"
+#include "windowtween.h"
+#include "windowcontext.h"
+#include "eventqueue.h"
+#include "eventcoalescer.h"
+#include "monitortopology.h"
+#include "droparena.h"
+#include "dropfileinfo.h"
+#include "directorywalker.h"
+#include "panelfilter.h"
+#include "panelresult.h"
+#include "panelworker.h"
+#include "textcodec.h"
+#include "invokequeue.h"
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+
+static WindowBackend* pBackend_ = getDefaultBackend();	// Window system (see backend.h)
+static std::atomic<WindowBackend*> pSharedBackend_(pBackend_);	// pBackend_ for the other threads. Not replaced by BeginWindowUpdate()
+static BatchBackend batchBackend_;						// pBackend_ while the changes are collected by BeginWindowUpdate()
+static INT32 nWindowUpdateDepth_ = 0;
+static WindowContextSlab contexts_;						// ウィンドウ毎の状態。CreateContext() で追加する
+static const UINT32 hDefaultContext_ = contexts_.create();	// Context of the functions without a context handle
+static WindowContext* const pDefaultContext_ = contexts_.get(hDefaultContext_);
+
+/// <summary>
+/// Context which the functions work on, kept for each thread (see ContextScope)
+///   nullptr means the default context, so that the thread local variable needs no dynamic initializer.
+/// </summary>
+class CurrentContext {
+public:
+	constexpr CurrentContext() : pCurrent_(nullptr) {}
+
+	CurrentContext& operator=(WindowContext* pContext) {
+		pCurrent_ = (pContext != pDefaultContext_ ? pContext : nullptr);
+		return *this;
+	}
+	operator WindowContext*() const { return (pCurrent_ != nullptr ? pCurrent_ : pDefaultContext_); }
+	WindowContext* operator->() const { return (pCurrent_ != nullptr ? pCurrent_ : pDefaultContext_); }
+
+private:
+	WindowContext* pCurrent_;
+};
+
+static thread_local CurrentContext pContext_;			// Context which the functions work on (see ContextScope)
+static InvokeQueue invokeQueue_;						// 他のスレッドから呼ばれた変更。ウィンドウスレッドで実行する
+static std::atomic<WindowBackend*> pInvokeBackend_(nullptr);	// invokeQueue_ に積まれたことを知らせるバックエンドとウィンドウ
+static std::atomic<HWND> hInvokeWnd_(NULL);
+static std::atomic<UINT> nInvokeMessage_(0);
+static std::atomic<HWND> hMyOwnerWnd_(NULL);			// findMyOwnerWindow() で見つけたウィンドウ。破棄されたら NULL
+static DWORD dwMyWindowThreadId_ = 0;					// hMyOwnerWnd_ を作ったスレッド。次に探す際は先にこのスレッドを調べる
+static PanelResultArena panelResults_;					// ファイルパネルで選択されたパス。ハンドルで取り出し、解放する
+static std::atomic<UINT32> hLastPanelResult_(0);		// OpenFilePanel() で最後に選択された結果。GetPanelResult(0) で他のスレッドからも取り出せる
+static std::atomic<INT32> nLastPanelState_(0);			// 同期的に開いた最後のパネルの PanelRequestState。キャンセルと失敗を区別する
+static PanelWorker panelWorker_(panelResults_);			// OpenFilePanelAsync() 等のパネルを別スレッドで表示する
+static std::atomic<HWND> hDesktopWnd_(NULL);
+static MonitorTopologyRing monitorTopologies_;			// モニタ配置。表示の変更時に、読まれていないスロットで作り直す
+static std::mutex monitorTopologyMutex_;				// Serializes the writers of monitorTopologies_
 //static HHOOK hHook_ = NULL;
-static WindowStyleChangedCallback hWindowStyleChangedHandler_ = nullptr;
-static MonitorChangedCallback hMonitorChangedHandler_ = nullptr;
-static FilesCallback hDropFilesHandler_ = nullptr;
+static DropArena dropArena_;							// 最後にドロップされたパス。GetDropFiles() で取り出す
+static BOOL bIsDropStreamingEnabled_ = FALSE;			// ドロップされたパスを PollEvents() で少しずつ取り出すか
+static INT64 nDropStreamBudget_ = UNIWINC_DROP_STREAM_BUDGET;	// PollEvents() 1回でパスの取り出しに使う時間 [us]
+struct PendingDrop {
+	HDROP hDrop;
+	UINT32 hContext;									// Context of the window which received the drop
+};
+static std::deque<PendingDrop> pendingDrops_;			// ストリーミング中に届いたドロップ。前のドロップが終わってから順に取り出す
+static std::vector<WCHAR> droppedPathsJoined_;			// コールバックに渡す LF 区切りのパス。ストリーミング中は取り出した分ずつ繋げる
+static std::string droppedPathsJoinedUtf8_;
+static UINT32 nDroppedPathsJoined_ = 0;					// droppedPathsJoined_ に繋げたパスの数
+static UINT32 nDroppedPathsJoinedUtf8_ = 0;
+static DropFileInfoPool dropFileInfoPool_(dropArena_);	// ドロップされたファイルのサイズ、種類等を別スレッドで調べる
+static BOOL bIsDropFileInfoEnabled_ = FALSE;
+static UINT32 nDropFileInfoDropId_ = 0;					// DropInfoReady で通知済みのドロップ
+static UINT32 nDropFileInfoNotified_ = 0;				// DropInfoReady で通知済みの件数
+static DropArena expandedArena_;						// ドロップされたフォルダ内のファイル。GetExpandedFiles() で取り出す
+static DirectoryWalker directoryWalker_(expandedArena_);	// フォルダ内を別スレッドで辿る
+static BOOL bIsDropExpansionEnabled_ = FALSE;
+static UINT32 nDropExpansionDropId_ = 0;				// DropExpandChunk で通知中のドロップ
+static UINT32 nDropExpansionNotified_ = 0;				// DropExpandChunk で通知済みの件数
+static UINT32 nDropExpandedDropId_ = 0;					// DropExpanded を通知済みのドロップ
+static UINT32 hDropContext_ = 0;						// ドロップを受けたウィンドウのコンテキスト。ドロップのイベントはここへ通知する
+static const UINT_PTR HITTEST_TIMER_ID = 0x55574854;	// WM_TIMER ID to follow the cursor with the mask
+static const UINT_PTR DRAGMOVE_TIMER_ID = 0x55574D56;	// WM_TIMER ID to follow the cursor while dragging the window
+static const UINT_PTR TWEEN_TIMER_ID = 0x55575457;		// WM_TIMER ID to step the window tweens
 
 
 // ========================================================================
 #pragma region Internal functions
 
-void attachWindow(const HWND hWnd);
+BOOL attachWindow(const HWND hWnd);
 void detachWindow();
 void refreshWindowRect();
+void applyFrameChange(const RECT* pRect, const INT offset);
 void updateScreenSize();
 void applyWindowAlphaValue();
+void updateAlphaValue();
 //void beginHook();
 //void endHook();
 void createCustomWindowProcedure();
 void destroyCustomWindowProcedure();
+void applyClickThrough(const BOOL bTransparent);
+void updateHitTestMode();
+void stopHitTestMask();
+void updateInputRegion();
+void stepDragMove();
+void endDragMove(const BOOL bReleased);
+void stepWindowTweens();
+void cancelWindowTweens(const DWORD flags);
+void beginWindowUpdate();
+BOOL commitWindowUpdate();
+void queueEvent(const EventType type, const INT32 param);
+void notifyWindowStateChanged(const WindowStateEventType type);
+void notifyMonitorChanged();
+void publishWindowGeometry();
+void runInvokedFunctions();
+LPWSTR toUtf16String(const char* src, const UINT32 length, std::vector<WCHAR>& buffer);
+
+
+/// <summary>
+/// Make the context current while in the scope, so that the functions without a context handle work on it
+///   The previous context is restored at the end, so the scopes may be nested (e.g. by the window procedure).
+///   The current context is kept for each thread, so a scope on another thread does not change it for the window thread.
+/// </summary>
+class ContextScope {
+public:
+	explicit ContextScope(WindowContext* pContext) : pPrevious_(pContext_), bValid_(pContext != nullptr) {
+		if (pContext != nullptr) pContext_ = pContext;
+	}
+
+	explicit ContextScope(const UINT32 hContext) : ContextScope(contexts_.get(hContext)) {
+	}
+
+	~ContextScope() {
+		pContext_ = pPrevious_;
+	}
+
+	/// <summary>
+	/// FALSE if the context was not found. The current context is not changed then
+	/// </summary>
+	BOOL isValid() const { return bValid_; }
+
+private:
+	WindowContext* pPrevious_;
+	BOOL bValid_;
+
+	ContextScope(const ContextScope&) = delete;
+	ContextScope& operator=(const ContextScope&) = delete;
+};
+
+
+/// <summary>
+/// Whether the calling thread may change the windows directly
+///   TRUE only on the window thread: the one which has set the backend, attached a window or called Update() first.
+/// </summary>
+BOOL isWindowThread() {
+	return invokeQueue_.isWindowThread();
+}
+
+/// <summary>
+/// Same as isWindowThread(), but the calling thread becomes the window thread if none is bound yet.
+///   Called by Update() and Attach*, one of which the window thread calls before the others.
+/// </summary>
+BOOL bindWindowThread() {
+	return invokeQueue_.bindIfUnbound();
+}
+
+/// <summary>
+/// Run the function later on the window thread, on the current context of the calling thread
+///   The exported functions which change the window call this when called on another thread.
+///   It is run in the window procedure if the backend can post a message, otherwise by the next Update() or PollEvents().
+/// </summary>
+/// <returns>FALSE if failed to queue</returns>
+template <typename Function>
+BOOL invokeOnWindowThread(Function function) {
+	const UINT32 hContext = contexts_.getHandle(pContext_);
+	BOOL bPosted = invokeQueue_.post([hContext, function]() {
+		// 実行までにコンテキストが破棄されていれば捨てる
+		ContextScope scope(hContext);
+		if (scope.isValid()) function();
+	});
+	if (!bPosted) return FALSE;
+
+	// 前回の実行以降で最初の1回だけ、ウィンドウスレッドを起こす
+	if (invokeQueue_.requestWake()) {
+		WindowBackend* pBackend = pInvokeBackend_.load(std::memory_order_acquire);
+		const HWND hWnd = hInvokeWnd_.load(std::memory_order_acquire);
+		const UINT message = nInvokeMessage_.load(std::memory_order_acquire);
+		if (pBackend != nullptr && hWnd != NULL && message != 0) {
+			pBackend->postMessage(hWnd, message, 0, 0);
+		}
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Run the functions queued by other threads, if called on the window thread
+/// </summary>
+void runInvokedFunctions() {
+	if (invokeQueue_.isEmpty() || !isWindowThread()) return;
+
+	// 各関数はそれぞれのコンテキストで実行されるので、ここでは既定のコンテキストにしておく
+	ContextScope scope(pDefaultContext_);
+	invokeQueue_.run();
+}
 
 
 /// <summary>
@@ -57,46 +221,66 @@ void destroyCustomWindowProcedure();
 /// </summary>
 void detachWindow()
 {
-	if (hTargetWnd_) {
+	if (pContext_->hTargetWnd) {
+		// Stop following the cursor with the hit test mask
+		stopHitTestMask();
+
+		// Stop dragging the window
+		endDragMove(FALSE);
+
+		// Stop the animations
+		cancelWindowTweens((DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Size | (DWORD)WindowTweenFlag::Alpha);
+
 		// Restore the original window procedure
 		destroyCustomWindowProcedure();
 
 		//// Unhook if exist
 		//endHook();
 
-		if (IsWindow(hTargetWnd_)) {
+		if (pBackend_->isWindow(pContext_->hTargetWnd)) {
 			// 透明化は、起動時は無効であるものとして、戻すときは無効化
 			SetTransparent(FALSE);
 
 			//// 壁紙化が試みられていればウィンドウの親を戻す
 			//if (hDesktopWnd_ != NULL) {
-			//	SetParent(hTargetWnd_, hParentWnd_);
+			//	SetParent(pContext_->hTargetWnd, pContext_->hParentWnd);
 			//}
 
 			//// 常に最前面は、起動時の状態に合わせるよう戻す	↓SetWindowLongで本来戻るはずで不要？
 			//SetTopmost((originalWindowInfo.dwExStyle & WS_EX_TOPMOST) == WS_EX_TOPMOST);
 
 			// 最初のスタイルに戻す
-			SetWindowLong(hTargetWnd_, GWL_STYLE, originalWindowInfo_.dwStyle);
-			SetWindowLong(hTargetWnd_, GWL_EXSTYLE, originalWindowInfo_.dwExStyle);
+			pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_STYLE, pContext_->originalWindowInfo.dwStyle);
+			pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE, pContext_->originalWindowInfo.dwExStyle);
 
 			// ウィンドウ位置を戻す
-			SetWindowPlacement(hTargetWnd_, &originalWindowPlacement_);
+			pBackend_->setWindowPlacement(pContext_->hTargetWnd, &pContext_->originalWindowPlacement);
 
 			// 表示を更新
 			refreshWindowRect();
 		}
 	}
-	hTargetWnd_ = NULL;
+	// 他のスレッドへ知らせるウィンドウだったなら、以後は Update() で実行させる
+	HWND hWnd = pContext_->hTargetWnd;
+	hInvokeWnd_.compare_exchange_strong(hWnd, NULL);
+
+	pContext_->hTargetWnd = NULL;
+	contexts_.bindWindow(contexts_.getHandle(pContext_), NULL);
+	publishWindowGeometry();
 }
 
 /// <summary>
 /// 指定ハンドルのウィンドウを今後使うようにする
 /// </summary>
 /// <param name="hWnd"></param>
-void attachWindow(const HWND hWnd) {
+/// <returns>FALSE if the window is attached to another context</returns>
+BOOL attachWindow(const HWND hWnd) {
+	// 他のコンテキストで選択されているウィンドウは選べない
+	WindowContext* pOwner = contexts_.findByWindow(hWnd);
+	if (pOwner != nullptr && pOwner != pContext_) return FALSE;
+
 	// 選択済みウィンドウが異なるものであれば、元に戻す
-	if (hTargetWnd_ != hWnd) {
+	if (pContext_->hTargetWnd != hWnd) {
 		detachWindow();
 	}
 
@@ -105,61 +289,78 @@ void attachWindow(const HWND hWnd) {
 	updateScreenSize();
 
 	// Set the target
-	hTargetWnd_ = hWnd;
+	pContext_->hTargetWnd = hWnd;
 
 	if (hWnd) {
+		// ウィンドウプロシージャからこのコンテキストを探せるようにする
+		if (!contexts_.bindWindow(contexts_.getHandle(pContext_), hWnd)) {
+			pContext_->hTargetWnd = NULL;
+			return FALSE;
+		}
+
 		// Save the original state
-		GetWindowInfo(hWnd, &originalWindowInfo_);
-		GetWindowPlacement(hWnd, &originalWindowPlacement_);
-		//hParentWnd_ = GetParent(hWnd);
+		pBackend_->getWindowInfo(hWnd, &pContext_->originalWindowInfo);
+		pBackend_->getWindowPlacement(hWnd, &pContext_->originalWindowPlacement);
+		//pContext_->hParentWnd = GetParent(hWnd);
 
 		// Apply current settings
+		//   まとめて反映し、スタイルの書き込みとSetWindowPosを1回ずつにする
+		beginWindowUpdate();
 		applyWindowAlphaValue();
-		SetTransparent(bIsTransparent_);
-		SetBorderless(bIsBorderless_);
-		SetTopmost(bIsTopmost_);
-		SetBottommost(bIsBottommost_);
-		//SetBackground(bIsBackground_);
-		SetClickThrough(bIsClickThrough_);
-		SetAllowDrop(bAllowDropFile_);
+		SetTransparent(pContext_->bIsTransparent);
+		SetBorderless(pContext_->bIsBorderless);
+		SetTopmost(pContext_->bIsTopmost);
+		SetBottommost(pContext_->bIsBottommost);
+		//SetBackground(pContext_->bIsBackground);
+		SetClickThrough(pContext_->bIsClickThrough);
+		SetAllowDrop(pContext_->bAllowDropFile);
+		commitWindowUpdate();
 
 		// Replace the window procedure
 		createCustomWindowProcedure();
+
+		// Start following the cursor or apply the input region if the hit test mask is enabled
+		updateHitTestMode();
+
+		// このスレッドをウィンドウスレッドとし、他のスレッドからの変更はこのウィンドウへのメッセージで知らせてもらう
+		WindowBackend* pBackend = getBackend();
+		invokeQueue_.bindCurrentThread();
+		nInvokeMessage_.store(pBackend->registerWindowMessage(TEXT("UniWinC.Invoke")), std::memory_order_release);
+		pInvokeBackend_.store(pBackend, std::memory_order_release);
+		hInvokeWnd_.store(hWnd, std::memory_order_release);
 	}
+
+	// 他のスレッドから読めるよう、位置とサイズを公開
+	publishWindowGeometry();
+	return TRUE;
 }
 
+// State of findMyWindowProc()
+struct OwnWindowSearch {
+	DWORD processId;
+	HWND hWnd;				// The first window of the process, or NULL
+};
 
-/// オーナーウィンドウハンドルを探してアタッチする際のコールバック
+/// <summary>
+/// 自分のプロセスのウィンドウを探す際のコールバック
+/// lParam は OwnWindowSearch へのポインタ。最初に見つかったウィンドウで列挙を止める
 /// </summary>
 /// <param name="hWnd"></param>
 /// <param name="lParam"></param>
 /// <returns></returns>
-BOOL CALLBACK attachOwnerWindowProc(const HWND hWnd, const LPARAM lParam)
+BOOL CALLBACK findMyWindowProc(const HWND hWnd, const LPARAM lParam)
 {
-	DWORD currentPid = (DWORD)lParam;
-	DWORD pid;
-	GetWindowThreadProcessId(hWnd, &pid);
+	OwnWindowSearch* pSearch = (OwnWindowSearch*)lParam;
 
 	// プロセスIDが一致すれば自分のウィンドウとする
-	if (pid == currentPid) {
-
-		// オーナーウィンドウを探す
-		// Unityエディタだと本体が選ばれて独立Gameビューが選ばれない…
-		HWND hOwner = GetWindow(hWnd, GW_OWNER);
-		if (hOwner) {
-			// あればオーナーを選択
-			attachWindow(hOwner);
-		}
-		else {
-			// オーナーが無ければこのウィンドウを選択
-			attachWindow(hWnd);
-		}
+	if (pBackend_->getWindowProcessId(hWnd) == pSearch->processId) {
+		pSearch->hWnd = hWnd;
 		return FALSE;
 
 		//// 同じプロセスIDでも、表示されているウィンドウのみを選択
 		//LONG style = GetWindowLong(hWnd, GWL_STYLE);
 		//if (style & WS_VISIBLE) {
-		//	hTargetWnd_ = hWnd;
+		//	pContext_->hTargetWnd = hWnd;
 		//	return FALSE;
 		//}
 	}
@@ -168,135 +369,121 @@ BOOL CALLBACK attachOwnerWindowProc(const HWND hWnd, const LPARAM lParam)
 }
 
 /// <summary>
-/// オーナーウィンドウハンドルを探す際のコールバック
+/// 自分のプロセスのウィンドウ（オーナーがあればオーナー）を探す
+///   前回見つけたウィンドウが残っていればそれを返す。無ければ呼び出し元のスレッドのウィンドウ、
+///   前回見つけたウィンドウのスレッドのウィンドウ、全てのウィンドウの順に探す
+///   全てのウィンドウを調べるのは、ウィンドウが他のスレッドで作られていて初めて探す時だけとなる
 /// </summary>
-/// <param name="hWnd"></param>
-/// <param name="lParam"></param>
-/// <returns></returns>
-BOOL CALLBACK findOwnerWindowProc(const HWND hWnd, const LPARAM lParam)
-{
-	DWORD currentPid = (DWORD)lParam;
-	DWORD pid;
-	GetWindowThreadProcessId(hWnd, &pid);
-
-	// プロセスIDが一致すれば自分のウィンドウとする
-	if (pid == currentPid) {
+/// <returns>見つからなければ NULL</returns>
+HWND findMyOwnerWindow() {
+	const DWORD currentPid = pBackend_->getCurrentProcessId();
 
-		// オーナーウィンドウを探す
-		// Unityエディタだと本体が選ばれて独立Gameビューが選ばれない…
-		HWND hOwner = GetWindow(hWnd, GW_OWNER);
-		if (hOwner) {
-			// あればオーナーを選択
-			hPanelOwnerWnd_ = hOwner;
-		}
-		else {
-			// オーナーが無ければこのウィンドウを選択
-			hPanelOwnerWnd_ = hWnd;
+	// 破棄されたらウィンドウプロシージャで消しているが、アタッチしていないウィンドウは破棄を知らされないので確かめる
+	HWND hCached = hMyOwnerWnd_.load(std::memory_order_acquire);
+	if (hCached != NULL) {
+		if (pBackend_->isWindow(hCached) && pBackend_->getWindowProcessId(hCached) == currentPid) {
+			return hCached;
 		}
-		return FALSE;
+		hMyOwnerWnd_.store(NULL, std::memory_order_release);
 	}
 
-	return TRUE;
-}
-
-/// <summary>
-/// デスクトップのウィンドウハンドルを探す際のコールバック
-/// </summary>
-/// <param name="hWnd"></param>
-/// <param name="lParam"></param>
-/// <returns></returns>
-BOOL CALLBACK findDesktopWindowProc(const HWND hWnd, const LPARAM lParam)
-{
-	WCHAR className[UNIWINC_MAX_CLASSNAME];
-	int len = GetClassName(hWnd, className, UNIWINC_MAX_CLASSNAME);
-
-	if (len > 0) {
-		// クラス名が取得でき、WorkerW または Progman ならその子で SHELLDLL_DefView を対象とする
-		// 参考 http://www.orangemaker.sakura.ne.jp/labo/memo/sdk-mfc/win7Desktop.html
-		if ((lstrcmp(TEXT("WorkerW"), className) == 0) || (lstrcmp(TEXT("Progman"), className) == 0)) {
-			if (bExpedtDesktopWnd) {
-				hDesktopWnd_ = hWnd;
-				return FALSE;
-			}
-
-			HWND hChild = FindWindowEx(hWnd, NULL, TEXT("SHELLDLL_DefView"), NULL);
-			if (hChild != NULL) {
-				//hDesktopWnd_ = hChild;
-				//return FALSE;
-
-				bExpedtDesktopWnd = TRUE;
-				return TRUE;
-			}
+	OwnWindowSearch search = { currentPid, NULL };
+	const DWORD currentThreadId = pBackend_->getCurrentThreadId();
+	if (currentThreadId != 0) {
+		pBackend_->enumThreadWindows(currentThreadId, findMyWindowProc, (LPARAM)&search);
+		if (search.hWnd == NULL && dwMyWindowThreadId_ != 0 && dwMyWindowThreadId_ != currentThreadId) {
+			pBackend_->enumThreadWindows(dwMyWindowThreadId_, findMyWindowProc, (LPARAM)&search);
 		}
 	}
+	if (search.hWnd == NULL) {
+		pBackend_->enumWindows(findMyWindowProc, (LPARAM)&search);
+	}
+	if (search.hWnd == NULL) return NULL;
 
-	return TRUE;
+	// オーナーウィンドウを探す
+	// Unityエディタだと本体が選ばれて独立Gameビューが選ばれない…
+	HWND hOwner = pBackend_->getOwnerWindow(search.hWnd);
+	HWND hWnd = (hOwner != NULL ? hOwner : search.hWnd);
+
+	dwMyWindowThreadId_ = pBackend_->getWindowThreadId(hWnd);
+	hMyOwnerWnd_.store(hWnd, std::memory_order_release);
+	return hWnd;
 }
 
+// Monitors collected by monitorEnumProc()
+struct MonitorList {
+	std::vector<RECT> rects;
+	std::vector<HMONITOR> handles;
+};
+
 /// <summary>
 /// モニタ情報取得時のコールバック
-/// EnumDisplayMonitors()で呼ばれる。その際は最初にnMonitorCountが0にセットされるものとする。
+/// EnumDisplayMonitors()で呼ばれる。lParam は MonitorList へのポインタ
 /// </summary>
 /// <param name="hMon"></param>
 /// <param name="hDc"></param>
 /// <param name="lpRect"></param>
 /// <param name="lParam"></param>
 /// <returns></returns>
-BOOL CALLBACK monitorEnumProc(HMONITOR hMon, HDC hDc, LPRECT lpRect, LPARAM lParam)
+BOOL CALLBACK monitorEnumProc(HMONITOR hMon, HDC /*hDc*/, LPRECT lpRect, LPARAM lParam)
 {
-	// 最大取り扱いモニタ数に達したら探索終了
-	if (nMonitorCount_ >= UNIWINC_MAX_MONITORCOUNT) return FALSE;
-
-	// RECTを記憶
-	pMonitorRect_[nMonitorCount_] = *lpRect;
-
-	// プライマリモニタの高さを記憶
-	if (lpRect->left == 0 && lpRect->top == 0) {
-		// 原点に位置するモニタがプライマリモニタだと判断
-		nPrimaryMonitorHeight_ = lpRect->bottom;
-	}
-
-	// インデックスを一旦登場順で保存
-	pMonitorIndices_[nMonitorCount_] = nMonitorCount_;
+	MonitorList* pList = (MonitorList*)lParam;
 
-	// Store the monitor handle
-	hMonitors_[nMonitorCount_] = hMon;
-
-	// モニタ数カウント
-	nMonitorCount_++;
+	// RECTとハンドルを登場順で記憶
+	pList->rects.push_back(*lpRect);
+	pList->handles.push_back(hMon);
 
 	return TRUE;
 }
 
+/// <summary>
+/// Current monitor layout
+///   The snapshot is replaced as a whole, so keep the returned reader while using it.
+///   Lock-free on any thread. The snapshot is not reused until the reader is destroyed.
+/// </summary>
+MonitorTopologyRing::Reader getMonitorTopology() {
+	return monitorTopologies_.read();
+}
+
 /// <summary>
 /// 接続モニタ数とそれらのサイズ一覧を取得
+///   配置が変わっていなければ、スナップショットもその世代も変えない
 /// </summary>
 /// <returns>成功ならTRUE</returns>
 BOOL updateMonitorRectangles() {
-	//  カウントするため一時的に0に戻す
-	nMonitorCount_ = 0;
+	MonitorList list;
 
 	// モニタを列挙してRECTを保存
-	if (!EnumDisplayMonitors(NULL, NULL, monitorEnumProc, NULL)) {
+	if (!pBackend_->enumDisplayMonitors(monitorEnumProc, (LPARAM)&list)) {
 		return FALSE;
 	}
 
-	// モニタの位置を基準にバブルソート
-	for (int i = 0; i < (nMonitorCount_ - 1); i++) {
-		for (int j = (nMonitorCount_ - 1); j > i; j--) {
-			RECT pr = pMonitorRect_[pMonitorIndices_[j - 1]];
-			RECT cr = pMonitorRect_[pMonitorIndices_[j]];
+	std::lock_guard<std::mutex> lock(monitorTopologyMutex_);
+	if (getMonitorTopology()->isSameLayout(list.rects, list.handles)) {
+		return TRUE;
+	}
+
+	// モニタの位置を基準に並べた新しいスナップショットに差し替える
+	//   以前のものは、他のスレッドが読み終えてから次の変更で使い回される
+	return monitorTopologies_.publish(list.rects, list.handles);
+}
 
-			// 左にあるモニタが先、横が同じなら下にあるモニタが先となるようソート
-			if (pr.left >  cr.left || ((pr.left == cr.left) && (pr.bottom < cr.bottom))) {
-				int index = pMonitorIndices_[j - 1];
-				pMonitorIndices_[j - 1] = pMonitorIndices_[j];
-				pMonitorIndices_[j] = index;
-			}
-		}
+/// <summary>
+/// ウィンドウの中心があるモニタ番号を取得
+/// </summary>
+/// <param name="pWindowRect">ウィンドウのRECT。NULLならプライマリモニタ</param>
+/// <returns>判定できなければプライマリモニタの番号</returns>
+INT32 findMonitorOfWindow(const MonitorTopology& topology, const RECT* pWindowRect) {
+	if (pWindowRect == NULL) {
+		return topology.getPrimaryIndex();
 	}
 
-	return TRUE;
+	// ウィンドウの中央が含まれているモニタを検索
+	LONG cx = (pWindowRect->right - 1 + pWindowRect->left) / 2;
+	LONG cy = (pWindowRect->bottom - 1 + pWindowRect->top) / 2;
+	INT32 index = topology.findMonitor(cx, cy);
+
+	return (index >= 0 ? index : topology.getPrimaryIndex());
 }
 
 /// <summary>
@@ -304,10 +491,9 @@ BOOL updateMonitorRectangles() {
 /// </summary>
 void enableTransparentByDWM()
 {
-	if (!hTargetWnd_) return;
+	if (!pContext_->hTargetWnd) return;
 
-	MARGINS margins = { -1 };
-	DwmExtendFrameIntoClientArea(hTargetWnd_, &margins);
+	pBackend_->extendFrameIntoClientArea(pContext_->hTargetWnd, TRUE);
 }
 
 /// <summary>
@@ -315,33 +501,32 @@ void enableTransparentByDWM()
 /// </summary>
 void disableTransparentByDWM()
 {
-	if (!hTargetWnd_) return;
+	if (!pContext_->hTargetWnd) return;
 
 	// TODO: できれば決め打ちでは無くせるとよい
 	//   本来のウィンドウが何らかの範囲指定でGlassにしていた場合は、残念ながら表示が戻りません
-	MARGINS margins = { 0, 0, 0, 0 };
-	DwmExtendFrameIntoClientArea(hTargetWnd_, &margins);
+	pBackend_->extendFrameIntoClientArea(pContext_->hTargetWnd, FALSE);
 }
 
 /// <summary>
 /// DWM利用時またはウィンドウ非透過時の透明度設定
 /// </summary>
 void applyWindowAlphaValue() {
-	if (!hTargetWnd_) return;
+	if (!pContext_->hTargetWnd) return;
 
 	// 半透明の場合、レイヤードウィンドウになっていなければ以降はレイヤードウィンドウにする
-	if (byAlpha_ < 0xFF) {
-		LONG exstyle = GetWindowLong(hTargetWnd_, GWL_EXSTYLE);
+	if (pContext_->byAlpha < 0xFF) {
+		LONG exstyle = pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE);
 
 		// まだレイヤードウィンドウになっていなければ、設定
 		if (!(exstyle & WS_EX_LAYERED)) {
 			exstyle |= WS_EX_LAYERED;
-			SetWindowLong(hTargetWnd_, GWL_EXSTYLE, exstyle);
+			pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE, exstyle);
 		}
 	}
 
 	COLORREF cref = { 0 };
-	SetLayeredWindowAttributes(hTargetWnd_, cref, byAlpha_, LWA_ALPHA);
+	pBackend_->setLayeredWindowAttributes(pContext_->hTargetWnd, cref, pContext_->byAlpha, LWA_ALPHA);
 }
 
 /// <summary>
@@ -349,17 +534,17 @@ void applyWindowAlphaValue() {
 /// </summary>
 void enableTransparentBySetLayered()
 {
-	if (!hTargetWnd_) return;
+	if (!pContext_->hTargetWnd) return;
 
-	LONG exstyle = GetWindowLong(hTargetWnd_, GWL_EXSTYLE);
+	LONG exstyle = pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE);
 
 	// レイヤードウィンドウになっていなければ、設定
 	if (!(exstyle & WS_EX_LAYERED)) {
 		exstyle |= WS_EX_LAYERED;
-		SetWindowLong(hTargetWnd_, GWL_EXSTYLE, exstyle);
+		pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE, exstyle);
 	}
 
-	SetLayeredWindowAttributes(hTargetWnd_, dwKeyColor_, byAlpha_, LWA_COLORKEY | LWA_ALPHA);
+	pBackend_->setLayeredWindowAttributes(pContext_->hTargetWnd, pContext_->dwKeyColor, pContext_->byAlpha, LWA_COLORKEY | LWA_ALPHA);
 }
 
 /// <summary>
@@ -367,59 +552,104 @@ void enableTransparentBySetLayered()
 /// </summary>
 void disableTransparentBySetLayered()
 {
-	if (!hTargetWnd_) return;
+	if (!pContext_->hTargetWnd) return;
 
 	COLORREF cref = { 0 };
-	SetLayeredWindowAttributes(hTargetWnd_, cref, byAlpha_, LWA_ALPHA);
+	pBackend_->setLayeredWindowAttributes(pContext_->hTargetWnd, cref, pContext_->byAlpha, LWA_ALPHA);
 }
 
 /// <summary>
-/// 壁紙の親となるウィンドウハンドルを取得
+/// クリックスルーのためのスタイルを設定／解除。状態の記録はしない
 /// </summary>
-void findDesktopWindow() {
-	bExpedtDesktopWnd = FALSE;
-	EnumWindows(findDesktopWindowProc, NULL);
+/// <param name="bTransparent"></param>
+void applyClickThrough(const BOOL bTransparent) {
+	if (!pContext_->hTargetWnd) return;
+
+	if (bTransparent) {
+		LONG exstyle = pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE);
+		exstyle |= WS_EX_TRANSPARENT;
+		exstyle |= WS_EX_LAYERED;
+		pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE, exstyle);
+	}
+	else
+	{
+		LONG exstyle = pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE);
+		exstyle &= ~WS_EX_TRANSPARENT;
+
+		// 半透明を維持するため、レイヤードウィンドウは戻さないようコメントアウト
+		//if (!pContext_->bIsTransparent && !(pContext_->originalWindowInfo.dwExStyle & WS_EX_LAYERED)) {
+		//	exstyle &= ~WS_EX_LAYERED;
+		//}
+		pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE, exstyle);
+	}
 }
 
 /// <summary>
 /// 枠を消した際に描画サイズが合わなくなることに対応するため、ウィンドウを強制リサイズして更新
 /// </summary>
 void refreshWindowRect() {
-	if (!hTargetWnd_) return;
+	if (!pContext_->hTargetWnd) return;
 
-	if (IsZoomed(hTargetWnd_)) {
+	if (pBackend_->isZoomed(pContext_->hTargetWnd)) {
 		// 最大化されていた場合は、ウィンドウサイズ変更の代わりに一度最小化して再度最大化
-		ShowWindow(hTargetWnd_, SW_MINIMIZE);
-		ShowWindow(hTargetWnd_, SW_MAXIMIZE);
+		pBackend_->showWindow(pContext_->hTargetWnd, SW_MINIMIZE);
+		pBackend_->showWindow(pContext_->hTargetWnd, SW_MAXIMIZE);
 	}
-	else if (IsIconic(hTargetWnd_)) {
+	else if (pBackend_->isIconic(pContext_->hTargetWnd)) {
 		// 最小化されていた場合は、次に表示されるときに更新されるものとして、何もしない
 	}
-	else if (IsWindowVisible(hTargetWnd_)) {
-		// 通常のウィンドウだった場合は、ウィンドウサイズを1px変えることで再描画
+	else if (pBackend_->isWindowVisible(pContext_->hTargetWnd)) {
+		// 通常のウィンドウだった場合は、位置とサイズはそのままで枠の変更を反映
+		applyFrameChange(NULL, 1);
+		pBackend_->showWindow(pContext_->hTargetWnd, SW_SHOW);
+	}
+}
 
-		// 現在のウィンドウサイズを取得
-		RECT rect;
-		GetWindowRect(hTargetWnd_, &rect);
+/// <summary>
+/// 枠の変更を反映する
+///   RefreshMode::FrameChanged では SWP_FRAMECHANGED を付けた SetWindowPos 1回のみとし、
+///   期待したクライアント領域サイズにならなかった場合だけ、1px大きさを変えて戻す方法で反映させる
+/// </summary>
+/// <param name="pRect">変更後のウィンドウ矩形。NULLなら位置とサイズは変えない</param>
+/// <param name="offset">1px大きさを変える場合の幅の増分 [px]</param>
+void applyFrameChange(const RECT* pRect, const INT offset) {
+	if (!pContext_->hTargetWnd) return;
 
-		// 1px横幅を広げて、リサイズイベントを強制的に起こす
-		SetWindowPos(
-			hTargetWnd_,
-			NULL,
-			0, 0, (rect.right - rect.left + 1), (rect.bottom - rect.top + 1),
-			SWP_NOMOVE | SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS
-		);
+	RECT rcWin;
+	if (pRect) {
+		rcWin = *pRect;
+	}
+	else {
+		pBackend_->getWindowRect(pContext_->hTargetWnd, &rcWin);
+	}
+	const int w = rcWin.right - rcWin.left;
+	const int h = rcWin.bottom - rcWin.top;
+	const UINT flags = SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE;	//| SWP_ASYNCWINDOWPOS
+
+	if (pContext_->nRefreshMode == RefreshMode::FrameChanged) {
+		pBackend_->setWindowPos(pContext_->hTargetWnd, NULL, rcWin.left, rcWin.top, w, h, flags | (pRect ? 0 : (SWP_NOMOVE | SWP_NOSIZE)));
+		pContext_->refreshStats.nFrameChanges++;
+
+		// 現在の枠で期待されるクライアント領域になっていれば完了
+		RECT rcFrame = { 0, 0, 0, 0 };
+		pBackend_->adjustWindowRect(&rcFrame, (DWORD)pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_STYLE), pBackend_->hasMenu(pContext_->hTargetWnd));
+		RECT rcCli;
+		pBackend_->getClientRect(pContext_->hTargetWnd, &rcCli);
+		if (((rcCli.right - rcCli.left) == (w - (rcFrame.right - rcFrame.left)))
+			&& ((rcCli.bottom - rcCli.top) == (h - (rcFrame.bottom - rcFrame.top)))) {
+			return;
+		}
+	}
 
-		// 元のサイズに戻す。この時もリサイズイベントは発生するはず
-		SetWindowPos(
-			hTargetWnd_,
-			NULL,
-			0, 0, (rect.right - rect.left), (rect.bottom - rect.top),
-			SWP_NOMOVE | SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS
-		);
+	// 1px幅を変えて、リサイズイベントを強制的に起こす
+	//    Unity2019までの手順ではUnity2020ではサイズが戻ってしまう場合があったため、サイズ変更を繰り返している
+	pBackend_->setWindowPos(pContext_->hTargetWnd, NULL, rcWin.left, rcWin.top, w + offset, h, flags | (pRect ? 0 : SWP_NOMOVE));
 
-		ShowWindow(hTargetWnd_, SW_SHOW);
-	}
+	// 元のサイズに戻す。この時もリサイズイベントは発生するはず
+	pBackend_->setWindowPos(pContext_->hTargetWnd, NULL, rcWin.left, rcWin.top, w, h, flags | (pRect ? 0 : SWP_NOMOVE));
+
+	pContext_->refreshStats.nFrameChanges += 2;
+	pContext_->refreshStats.nResizeTricks++;
 }
 
 BOOL compareRect(const RECT rcA, const RECT rcB) {
@@ -443,13 +673,237 @@ void updateScreenSize() {
 /// </summary>
 /// <returns></returns>
 BOOL getTopMost() {
-	if ((hTargetWnd_ == NULL) || !IsWindow(hTargetWnd_)) {
+	if ((pContext_->hTargetWnd == NULL) || !pBackend_->isWindow(pContext_->hTargetWnd)) {
 		return FALSE;
 	}
-	LONG ex = GetWindowLong(hTargetWnd_, GWL_EXSTYLE);
+	LONG ex = pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_EXSTYLE);
 	return (ex & WS_EX_TOPMOST) == WS_EX_TOPMOST;
 }
 
+/// <summary>
+/// Store the geometry only if it has changed, so that its sequence counts the changes (see GetWindowSnapshot)
+///   Only the window thread writes it, so the value loaded here is the last one stored.
+/// </summary>
+void storeWindowGeometry(const WindowGeometry& geometry) {
+	const WindowGeometry current = pContext_->geometry.load();
+	if (memcmp(&current, &geometry, sizeof(WindowGeometry)) == 0) return;
+	pContext_->geometry.store(geometry);
+}
+
+/// <summary>
+/// Publish the geometry of the window for the getters called on other threads
+///   Called on the window thread whenever the window may have moved or resized, or has been attached or detached.
+/// </summary>
+void publishWindowGeometry() {
+	WindowGeometry geometry = WindowGeometry();
+
+	// まとめて反映する途中でも、実際のウィンドウの状態を公開する
+	WindowBackend* pBackend = getBackend();
+	if (pContext_->hTargetWnd && pBackend->getWindowRect(pContext_->hTargetWnd, &geometry.rect)) {
+		geometry.hWnd = pContext_->hTargetWnd;
+
+		RECT clientRect;
+		if (pBackend->getClientRect(pContext_->hTargetWnd, &clientRect)) {
+			geometry.client.cx = clientRect.right - clientRect.left;
+			geometry.client.cy = clientRect.bottom - clientRect.top;
+		}
+		geometry.bZoomed = pBackend->isZoomed(pContext_->hTargetWnd);
+		geometry.bIconic = pBackend->isIconic(pContext_->hTargetWnd);
+	}
+	storeWindowGeometry(geometry);
+}
+
+/// <summary>
+/// Publish the geometry changed by WM_WINDOWPOSCHANGED, without querying the window
+/// </summary>
+void publishWindowPos(const WINDOWPOS* pPos) {
+	if ((pPos->flags & (SWP_NOMOVE | SWP_NOSIZE)) == (SWP_NOMOVE | SWP_NOSIZE)) return;
+
+	// 書き込むのはこのスレッドだけなので、前回の値に変わった分だけ反映すればよい
+	WindowGeometry geometry = pContext_->geometry.load();
+	if (geometry.hWnd == NULL) return;
+
+	if (!(pPos->flags & SWP_NOMOVE)) {
+		geometry.rect.right += pPos->x - geometry.rect.left;
+		geometry.rect.bottom += pPos->y - geometry.rect.top;
+		geometry.rect.left = pPos->x;
+		geometry.rect.top = pPos->y;
+	}
+	if (!(pPos->flags & SWP_NOSIZE)) {
+		geometry.rect.right = geometry.rect.left + pPos->cx;
+		geometry.rect.bottom = geometry.rect.top + pPos->cy;
+	}
+	storeWindowGeometry(geometry);
+}
+
+/// <summary>
+/// Publish the client size and the state notified by WM_SIZE
+///   The window rectangle is queried, since maximizing or restoring may not be notified by WM_WINDOWPOSCHANGED.
+/// </summary>
+void publishWindowSize(const WPARAM sizeType, const LPARAM lParam) {
+	WindowGeometry geometry = pContext_->geometry.load();
+	if (geometry.hWnd == NULL) return;
+
+	getBackend()->getWindowRect(pContext_->hTargetWnd, &geometry.rect);
+	geometry.client.cx = LOWORD(lParam);
+	geometry.client.cy = HIWORD(lParam);
+	geometry.bZoomed = (sizeType == SIZE_MAXIMIZED);
+	geometry.bIconic = (sizeType == SIZE_MINIMIZED);
+	storeWindowGeometry(geometry);
+}
+
+/// <summary>
+/// Rectangle of the target window
+///   Other threads get the one published by the window thread, instead of querying the window.
+/// </summary>
+/// <returns>FALSE if no window is attached</returns>
+BOOL getTargetWindowRect(RECT* pRect) {
+	if (!isWindowThread()) {
+		const WindowGeometry geometry = pContext_->geometry.load();
+		*pRect = geometry.rect;
+		return (geometry.hWnd != NULL);
+	}
+	return (pContext_->hTargetWnd != NULL && pBackend_->getWindowRect(pContext_->hTargetWnd, pRect));
+}
+
+/// <summary>
+/// The backend currently used
+/// </summary>
+/// <returns></returns>
+WindowBackend* getBackend() {
+	return (nWindowUpdateDepth_ > 0 ? batchBackend_.getInner() : pBackend_);
+}
+
+/// <summary>
+/// Replace the backend. The attached window is detached before switching.
+///   The calling thread becomes the window thread.
+/// </summary>
+/// <param name="pBackend">nullptr restores the default</param>
+void setBackend(WindowBackend* pBackend) {
+	// 反映待ちの変更は以前のバックエンドで反映しておく
+	while (nWindowUpdateDepth_ > 0) {
+		commitWindowUpdate();
+	}
+
+	// 以前のバックエンドのウィンドウは、全てのコンテキストで元に戻しておく
+	std::vector<UINT32> handles;
+	contexts_.getHandles(handles);
+	for (UINT32 hContext : handles) {
+		ContextScope scope(hContext);
+		detachWindow();
+	}
+
+	// 開いているパネルを閉じ、以前のバックエンドをパネルのスレッドが使い終わるまで待つ
+	panelWorker_.stop();
+
+	pBackend_ = (pBackend != nullptr ? pBackend : getDefaultBackend());
+	pSharedBackend_.store(pBackend_, std::memory_order_release);
+
+	// バックエンドを用意したスレッドをウィンドウスレッドとする
+	invokeQueue_.bindCurrentThread();
+
+	// 以前のバックエンドで取得したハンドルは破棄
+	hMyOwnerWnd_.store(NULL, std::memory_order_release);
+	dwMyWindowThreadId_ = 0;
+	hDesktopWnd_ = NULL;
+
+	updateScreenSize();
+}
+
+/// <summary>
+/// Start collecting the changes of the target window
+///   Calls may be nested. The changes are applied when the outermost one is committed.
+/// </summary>
+void beginWindowUpdate() {
+	if (nWindowUpdateDepth_++ > 0) {
+		// 途中で対象のウィンドウが変わっていれば、それまでの変更を反映して切り替える
+		batchBackend_.setTarget(pContext_->hTargetWnd);
+		return;
+	}
+
+	batchBackend_.begin(pBackend_, pContext_->hTargetWnd);
+	pBackend_ = &batchBackend_;
+}
+
+/// <summary>
+/// Apply the collected changes
+/// </summary>
+/// <returns>FALSE if not collecting or failed to apply</returns>
+BOOL commitWindowUpdate() {
+	if (nWindowUpdateDepth_ <= 0) return FALSE;
+	if (--nWindowUpdateDepth_ > 0) return TRUE;
+
+	// 反映中に届くメッセージは実際のバックエンドで処理させる
+	pBackend_ = batchBackend_.getInner();
+	return batchBackend_.commit();
+}
+
+/// <summary>
+/// Queue the event for PollEvents() with the current window geometry
+/// </summary>
+void queueEvent(const EventType type, const INT32 param) {
+	if (!pContext_->bIsEventQueueEnabled) return;
+
+	UNIWINCEVENT e = UNIWINCEVENT();
+	e.nType = (INT32)type;
+	e.nParam = param;
+	e.nTimestamp = EventQueue::now();
+
+	RECT rect;
+	if (pContext_->hTargetWnd && pBackend_->getWindowRect(pContext_->hTargetWnd, &rect)) {
+		// GetPosition(), GetSize() と同じく左下基準
+		e.x = (float)(rect.left);
+		e.y = (float)(getMonitorTopology()->getPrimaryHeight() - rect.bottom);
+		e.width = (float)(rect.right - rect.left);
+		e.height = (float)(rect.bottom - rect.top);
+	}
+
+	// 満杯なら捨てられ、次の PollEvents() で Overflow として通知される
+	pContext_->eventQueue.push(e);
+}
+
+/// <summary>
+/// Notify a change of the window state with the queue and the callback
+/// </summary>
+void notifyWindowStateChanged(const WindowStateEventType type) {
+	queueEvent(EventType::WindowStateChanged, (INT32)type);
+
+	if (pContext_->hWindowStyleChangedHandler != nullptr) {
+		pContext_->hWindowStyleChangedHandler((INT32)type);
+	}
+}
+
+/// <summary>
+/// Notify a change of the monitors with the queue and the callback
+/// </summary>
+void notifyMonitorChanged() {
+	INT32 count = GetMonitorCount();
+	queueEvent(EventType::MonitorChanged, count);
+
+	if (pContext_->hMonitorChangedHandler != nullptr) {
+		pContext_->hMonitorChangedHandler(count);
+	}
+}
+
+/// <summary>
+/// Null terminated UTF-16 of a UTF-8 string for the functions with UTF-8 arguments
+/// </summary>
+/// <param name="buffer">Keeps the result</param>
+/// <returns>The result, or nullptr if src is nullptr or failed</returns>
+LPWSTR toUtf16String(const char* src, const UINT32 length, std::vector<WCHAR>& buffer) {
+	if (src == nullptr) return nullptr;
+
+	try {
+		buffer.clear();
+		appendUtf16(src, length, buffer);
+		buffer.push_back(L'\0');
+	}
+	catch (...) {
+		return nullptr;
+	}
+	return buffer.data();
+}
+
 #pragma endregion Internal functions
 
 
@@ -461,8 +915,32 @@ BOOL getTopMost() {
 /// </summary>
 /// <returns></returns>
 void UNIWINC_API Update() {
-	// 今のところWindowsでは何もしない
-	return;
+	if (!bindWindowThread()) return;
+
+	// 他のスレッドから頼まれた変更があれば、ここで反映する
+	runInvokedFunctions();
+
+	// Windowsではメッセージはウィンドウプロシージャに届くため、何もしない
+	//   イベントを自前で取り出す必要があるバックエンドはここで処理する
+	pBackend_->update();
+}
+
+/// <summary>
+/// 以降のウィンドウ状態の変更を、CommitWindowUpdate() まで反映せずにまとめる
+///   スタイル、Zオーダー、位置、サイズ、表示状態、不透明度は最終的な状態と現在の差分のみが反映される
+/// </summary>
+void UNIWINC_API BeginWindowUpdate() {
+	if (!isWindowThread()) return;
+	beginWindowUpdate();
+}
+
+/// <summary>
+/// BeginWindowUpdate() 以降の変更をまとめて反映
+/// </summary>
+/// <returns>反映に失敗したか、BeginWindowUpdate() されていなければFALSE</returns>
+BOOL UNIWINC_API CommitWindowUpdate() {
+	if (!isWindowThread()) return FALSE;
+	return commitWindowUpdate();
 }
 
 /// <summary>
@@ -470,7 +948,11 @@ void UNIWINC_API Update() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsActive() {
-	if (hTargetWnd_ && IsWindow(hTargetWnd_)) {
+	if (!isWindowThread()) {
+		return (pContext_->geometry.load().hWnd != NULL);
+	}
+
+	if (pContext_->hTargetWnd && pBackend_->isWindow(pContext_->hTargetWnd)) {
 		return TRUE;
 	}
 	return FALSE;
@@ -481,7 +963,7 @@ BOOL UNIWINC_API IsActive() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsTransparent() {
-	return bIsTransparent_;
+	return pContext_->bIsTransparent;
 }
 
 /// <summary>
@@ -489,7 +971,7 @@ BOOL UNIWINC_API IsTransparent() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsBorderless() {
-	return bIsBorderless_;
+	return pContext_->bIsBorderless;
 }
 
 /// <summary>
@@ -497,7 +979,7 @@ BOOL UNIWINC_API IsBorderless() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsTopmost() {
-	return bIsTopmost_;
+	return pContext_->bIsTopmost;
 }
 
 /// <summary>
@@ -505,7 +987,7 @@ BOOL UNIWINC_API IsTopmost() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsBottommost() {
-	return bIsBottommost_;
+	return pContext_->bIsBottommost;
 }
 
 /// <summary>
@@ -513,7 +995,7 @@ BOOL UNIWINC_API IsBottommost() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsBackground() {
-	return bIsBackground_;
+	return pContext_->bIsBackground;
 }
 
 /// <summary>
@@ -521,7 +1003,11 @@ BOOL UNIWINC_API IsBackground() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsMaximized() {
-	return (hTargetWnd_ && IsZoomed(hTargetWnd_));
+	if (!isWindowThread()) {
+		const WindowGeometry geometry = pContext_->geometry.load();
+		return (geometry.hWnd != NULL && geometry.bZoomed);
+	}
+	return (pContext_->hTargetWnd && pBackend_->isZoomed(pContext_->hTargetWnd));
 }
 
 /// <summary>
@@ -529,7 +1015,11 @@ BOOL UNIWINC_API IsMaximized() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API IsMinimized() {
-	return (hTargetWnd_ && IsIconic(hTargetWnd_));
+	if (!isWindowThread()) {
+		const WindowGeometry geometry = pContext_->geometry.load();
+		return (geometry.hWnd != NULL && geometry.bIconic);
+	}
+	return (pContext_->hTargetWnd && pBackend_->isIconic(pContext_->hTargetWnd));
 }
 
 /// <summary>
@@ -537,6 +1027,10 @@ BOOL UNIWINC_API IsMinimized() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API DetachWindow() {
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([]() { detachWindow(); });
+	}
+
 	detachWindow();
 	return TRUE;
 }
@@ -554,8 +1048,10 @@ BOOL UNIWINC_API AttachMyWindow() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API AttachMyOwnerWindow() {
-	DWORD currentPid = GetCurrentProcessId();
-	return EnumWindows(attachOwnerWindowProc, (LPARAM)currentPid);
+	if (!bindWindowThread()) return FALSE;
+
+	HWND hWnd = findMyOwnerWindow();
+	return (hWnd != NULL && attachWindow(hWnd));
 }
 
 /// <summary>
@@ -563,11 +1059,7 @@ BOOL UNIWINC_API AttachMyOwnerWindow() {
 /// </summary>
 /// <returns></returns>
 HWND FindOwnerWindowHandle() {
-	DWORD currentPid = GetCurrentProcessId();
-	if (EnumWindows(attachOwnerWindowProc, (LPARAM)currentPid)) {
-		return hPanelOwnerWnd_;
-	}
-	return NULL;
+	return findMyOwnerWindow();
 }
 
 /// <summary>
@@ -576,14 +1068,14 @@ HWND FindOwnerWindowHandle() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API AttachMyActiveWindow() {
-	DWORD currentPid = GetCurrentProcessId();
-	HWND hWnd = GetActiveWindow();
-	DWORD pid;
+	if (!bindWindowThread()) return FALSE;
+
+	DWORD currentPid = pBackend_->getCurrentProcessId();
+	HWND hWnd = pBackend_->getActiveWindow();
+	DWORD pid = pBackend_->getWindowProcessId(hWnd);
 
-	GetWindowThreadProcessId(hWnd, &pid);
 	if (pid == currentPid) {
-		attachWindow(hWnd);
-		return TRUE;
+		return attachWindow(hWnd);
 	}
 	return FALSE;
 }
@@ -593,8 +1085,8 @@ BOOL UNIWINC_API AttachMyActiveWindow() {
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API AttachWindowHandle(const HWND hWnd) {
-	attachWindow(hWnd);
-	return TRUE;
+	if (!bindWindowThread()) return FALSE;
+	return attachWindow(hWnd);
 }
 
 /// <summary>
@@ -603,15 +1095,20 @@ BOOL UNIWINC_API AttachWindowHandle(const HWND hWnd) {
 /// <param name="type"></param>
 /// <returns></returns>
 void UNIWINC_API SetTransparentType(const TransparentType type) {
-	if (bIsTransparent_) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetTransparentType(type); });
+		return;
+	}
+
+	if (pContext_->bIsTransparent) {
 		// 透明化状態であれば、一度解除してから設定
 		SetTransparent(FALSE);
-		nTransparentType_ = type;
+		pContext_->nTransparentType = type;
 		SetTransparent(TRUE);
 	}
 	else {
 		// 透明化状態でなければ、そのまま設定
-		nTransparentType_ = type;
+		pContext_->nTransparentType = type;
 	}
 }
 
@@ -621,15 +1118,20 @@ void UNIWINC_API SetTransparentType(const TransparentType type) {
 /// <param name="color">透過する色</param>
 /// <returns></returns>
 void UNIWINC_API SetKeyColor(const COLORREF color) {
-	if (bIsTransparent_ && (nTransparentType_ == TransparentType::ColorKey)) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetKeyColor(color); });
+		return;
+	}
+
+	if (pContext_->bIsTransparent && (pContext_->nTransparentType == TransparentType::ColorKey)) {
 		// 透明化状態であれば、一度解除してから設定
 		SetTransparent(FALSE);
-		dwKeyColor_ = color;
+		pContext_->dwKeyColor = color;
 		SetTransparent(TRUE);
 	}
 	else {
 		// 透明化状態でなければ、そのまま設定
-		dwKeyColor_ = color;
+		pContext_->dwKeyColor = color;
 	}
 }
 
@@ -639,9 +1141,14 @@ void UNIWINC_API SetKeyColor(const COLORREF color) {
 /// <param name="bTransparent"></param>
 /// <returns></returns>
 void UNIWINC_API SetTransparent(const BOOL bTransparent) {
-	if (hTargetWnd_) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetTransparent(bTransparent); });
+		return;
+	}
+
+	if (pContext_->hTargetWnd) {
 		if (bTransparent) {
-			switch (nTransparentType_)
+			switch (pContext_->nTransparentType)
 			{
 			case TransparentType::Alpha:
 				enableTransparentByDWM();
@@ -654,7 +1161,7 @@ void UNIWINC_API SetTransparent(const BOOL bTransparent) {
 			}
 		}
 		else {
-			switch (nCurrentTransparentType_)
+			switch (pContext_->nCurrentTransparentType)
 			{
 			case TransparentType::Alpha:
 				disableTransparentByDWM();
@@ -668,11 +1175,11 @@ void UNIWINC_API SetTransparent(const BOOL bTransparent) {
 		}
 
 		// 戻す方法を決めるため、透明化が変更された時のタイプを記憶
-		nCurrentTransparentType_ = nTransparentType_;
+		pContext_->nCurrentTransparentType = pContext_->nTransparentType;
 	}
 
 	// 透明化状態を記憶
-	bIsTransparent_ = bTransparent;
+	pContext_->bIsTransparent = bTransparent;
 }
 
 
@@ -681,25 +1188,30 @@ void UNIWINC_API SetTransparent(const BOOL bTransparent) {
 /// </summary>
 /// <param name="bBorderless"></param>
 void UNIWINC_API SetBorderless(const BOOL bBorderless) {
-	if (hTargetWnd_) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetBorderless(bBorderless); });
+		return;
+	}
+
+	if (pContext_->hTargetWnd) {
 		int newW, newH, newX, newY;
 		RECT rcWin, rcCli;
-		GetWindowRect(hTargetWnd_, &rcWin);
-		GetClientRect(hTargetWnd_, &rcCli);
+		pBackend_->getWindowRect(pContext_->hTargetWnd, &rcWin);
+		pBackend_->getClientRect(pContext_->hTargetWnd, &rcCli);
 
 		newX = rcWin.left;
 		newY = rcWin.top;
 		int w = rcWin.right - rcWin.left;
 		int h = rcWin.bottom - rcWin.top;
 
-		bool hasMenu =  (GetMenu(hTargetWnd_) != NULL);		// ウィンドウがメニューを持っているか
+		BOOL hasMenu = pBackend_->hasMenu(pContext_->hTargetWnd);		// ウィンドウがメニューを持っているか
 
-		int bZoomed = IsZoomed(hTargetWnd_);
-		int bIconic = IsIconic(hTargetWnd_);
+		int bZoomed = pBackend_->isZoomed(pContext_->hTargetWnd);
+		int bIconic = pBackend_->isIconic(pContext_->hTargetWnd);
 
 		// 最大化されていたら、一度最大化は解除
 		if (bZoomed) {
-			ShowWindow(hTargetWnd_, SW_NORMAL);
+			pBackend_->showWindow(pContext_->hTargetWnd, SW_NORMAL);
 		}
 
 		int offset = 1;
@@ -710,12 +1222,12 @@ void UNIWINC_API SetBorderless(const BOOL bBorderless) {
 			offset = -1;
 		} else {
 			// 初期のウィンドウスタイル（必ずしも枠ありとは限らない）
-			newStyle = originalWindowInfo_.dwStyle;
+			newStyle = pContext_->originalWindowInfo.dwStyle;
 			offset = 1;
 		}
 		
 		// 変更後のウィンドウサイズを計算
-		AdjustWindowRect(&rcCli, newStyle, hasMenu);
+		pBackend_->adjustWindowRect(&rcCli, newStyle, hasMenu);
 		newW = rcCli.right - rcCli.left;
 		newH = rcCli.bottom - rcCli.top;
 			
@@ -729,52 +1241,55 @@ void UNIWINC_API SetBorderless(const BOOL bBorderless) {
 		// ウィンドウサイズが変化しないか、最大化や最小化状態なら標準のサイズ更新
 		if (bZoomed) {
 			// ウィンドウスタイルを適用
-			SetWindowLong(hTargetWnd_, GWL_STYLE, newStyle);
+			pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_STYLE, newStyle);
 
 			// 最大化されていたら、ここで再度最大化
-			ShowWindow(hTargetWnd_, SW_MAXIMIZE);
+			pBackend_->showWindow(pContext_->hTargetWnd, SW_MAXIMIZE);
 		} else if (bIconic) {
 			// ウィンドウスタイルを適用
-			SetWindowLong(hTargetWnd_, GWL_STYLE, newStyle);
+			pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_STYLE, newStyle);
 			// 最小化されていたら、次に表示されるときの再描画を期待して、SetWindowPosやShowWindowは省略
 		} else {
-			// クライアント領域サイズを維持するようサイズと位置を調整
-			//    Unity2019までの手順ではUnity2020ではサイズが戻ってしまう。サイズ変更を繰り返したり、後でウィンドウスタイルを変更してみる。
-			//    ウィンドウリサイズのタイミングがずれた場合の挙動が不安なため、SWP_ASYNCWINDOWPOSを外した。
-			SetWindowPos(
-				hTargetWnd_,
-				NULL,
-				newX, newY, newW + offset, newH,
-				SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS
-			);
-			SetWindowPos(
-				hTargetWnd_,
-				NULL,
-				newX, newY, newW, newH,
-				SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS
-			);
-
 			// ウィンドウスタイルを適用
-			SetWindowLong(hTargetWnd_, GWL_STYLE, newStyle);
-
-			SetWindowPos(
-				hTargetWnd_,
-				NULL,
-				newX, newY, newW + offset, newH,
-				SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS
-			);
-			SetWindowPos(
-				hTargetWnd_,
-				NULL,
-				newX, newY, newW, newH,
-				SWP_NOZORDER | SWP_FRAMECHANGED | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS
-			);
-			ShowWindow(hTargetWnd_, SW_SHOW);
+			pBackend_->setWindowLong(pContext_->hTargetWnd, GWL_STYLE, newStyle);
+
+			// クライアント領域サイズを維持するようサイズと位置を調整して、枠の変更と同時に反映
+			//    ウィンドウリサイズのタイミングがずれた場合の挙動が不安なため、SWP_ASYNCWINDOWPOSを外した。
+			RECT rcNew = { newX, newY, newX + newW, newY + newH };
+			applyFrameChange(&rcNew, offset);
+			pBackend_->showWindow(pContext_->hTargetWnd, SW_SHOW);
 		}
 	}
 
 	// 枠無しか否かを記憶
-	bIsBorderless_ = bBorderless;
+	pContext_->bIsBorderless = bBorderless;
+}
+
+/// <summary>
+/// 記憶している透明度を、現在の透過方法に合わせてウィンドウに反映
+/// </summary>
+void updateAlphaValue() {
+	if (!pContext_->hTargetWnd) return;
+
+	if (pContext_->bIsTransparent) {
+		// 現在が透過時の処理
+
+		switch (pContext_->nTransparentType)
+		{
+		case TransparentType::Alpha:
+			applyWindowAlphaValue();
+			break;
+		case TransparentType::ColorKey:
+			enableTransparentBySetLayered();	// 透過開始と同じ関数で設定
+			break;
+		default:
+			applyWindowAlphaValue();
+			break;
+		}
+	} else {
+		// 現在が非透過での処理
+		applyWindowAlphaValue();
+	}
 }
 
 /// <summary>
@@ -783,30 +1298,15 @@ void UNIWINC_API SetBorderless(const BOOL bBorderless) {
 /// <param name=""></param>
 /// <returns></returns>
 void UNIWINC_API SetAlphaValue(const float alpha) {
-	// 透明度指定値を記憶
-	byAlpha_ = (BYTE)(0xFF * alpha);
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetAlphaValue(alpha); });
+		return;
+	}
 
-	if (hTargetWnd_) {
-		if (bIsTransparent_) {
-			// 現在が透過時の処理
+	// 透明度指定値を記憶
+	pContext_->byAlpha = (BYTE)(0xFF * alpha);
 
-			switch (nTransparentType_)
-			{
-			case TransparentType::Alpha:
-				applyWindowAlphaValue();
-				break;
-			case TransparentType::ColorKey:
-				enableTransparentBySetLayered();	// 透過開始と同じ関数で設定
-				break;
-			default:
-				applyWindowAlphaValue();
-				break;
-			}
-		} else {
-			// 現在が非透過での処理
-			applyWindowAlphaValue();
-		}
-	}
+	updateAlphaValue();
 }
 
 /// <summary>
@@ -815,26 +1315,29 @@ void UNIWINC_API SetAlphaValue(const float alpha) {
 /// <param name="bTopmost"></param>
 /// <returns></returns>
 void UNIWINC_API SetTopmost(const BOOL bTopmost) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetTopmost(bTopmost); });
+		return;
+	}
+
 	// 最背面化されていたら、解除
-	bIsBottommost_ = FALSE;
+	pContext_->bIsBottommost = FALSE;
 
-	if (hTargetWnd_) {
-		SetWindowPos(
-			hTargetWnd_,
+	if (pContext_->hTargetWnd) {
+		pBackend_->setWindowPos(
+			pContext_->hTargetWnd,
 			(bTopmost ? HWND_TOPMOST : HWND_NOTOPMOST),
 			0, 0, 0, 0,
 			SWP_NOSIZE | SWP_NOMOVE | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS // | SWP_FRAMECHANGED
 		);
 
 		// Run callback if the topmost state changed
-		if (bIsTopmost_ != bTopmost) {
-			if (hWindowStyleChangedHandler_ != nullptr) {
-				hWindowStyleChangedHandler_((INT32)(bTopmost ? WindowStateEventType::TopMostEnabled : WindowStateEventType::TopMostDisabled));
-			}
+		if (pContext_->bIsTopmost != bTopmost) {
+			notifyWindowStateChanged(bTopmost ? WindowStateEventType::TopMostEnabled : WindowStateEventType::TopMostDisabled);
 		}
 	}
 
-	bIsTopmost_ = bTopmost;
+	pContext_->bIsTopmost = bTopmost;
 }
 
 /// <summary>
@@ -843,26 +1346,29 @@ void UNIWINC_API SetTopmost(const BOOL bTopmost) {
 /// <param name="bBottommost"></param>
 /// <returns></returns>
 void UNIWINC_API SetBottommost(const BOOL bBottommost) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetBottommost(bBottommost); });
+		return;
+	}
+
 	// 最前面化されていたら、解除
-	bIsTopmost_ = FALSE;
+	pContext_->bIsTopmost = FALSE;
 
-	if (hTargetWnd_) {
-		SetWindowPos(
-			hTargetWnd_,
+	if (pContext_->hTargetWnd) {
+		pBackend_->setWindowPos(
+			pContext_->hTargetWnd,
 			(bBottommost ? HWND_BOTTOM : HWND_NOTOPMOST),
 			0, 0, 0, 0,
 			SWP_NOSIZE | SWP_NOMOVE | SWP_NOOWNERZORDER | SWP_NOACTIVATE //| SWP_ASYNCWINDOWPOS // | SWP_FRAMECHANGED
 		);
 
 		// Run callback if the bottommost state changed
-		if (bIsBottommost_ != bBottommost) {
-			if (hWindowStyleChangedHandler_ != nullptr) {
-				hWindowStyleChangedHandler_((INT32)(bBottommost ? WindowStateEventType::BottomMostEnabled : WindowStateEventType::BottomMostDisabled));
-			}
+		if (pContext_->bIsBottommost != bBottommost) {
+			notifyWindowStateChanged(bBottommost ? WindowStateEventType::BottomMostEnabled : WindowStateEventType::BottomMostDisabled);
 		}
 	}
 
-	bIsBottommost_ = bBottommost;
+	pContext_->bIsBottommost = bBottommost;
 }
 
 /// <summary>
@@ -871,18 +1377,23 @@ void UNIWINC_API SetBottommost(const BOOL bBottommost) {
 /// <param name="bEnabled"></param>
 /// <returns></returns>
 void UNIWINC_API SetBackground(const BOOL bEnabled) {
-	if (hTargetWnd_) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetBackground(bEnabled); });
+		return;
+	}
+
+	if (pContext_->hTargetWnd) {
 		if (bEnabled) {
 			// デスクトップにあたるウィンドウが未取得なら、ここで取得
 			if (hDesktopWnd_ == NULL) {
-				findDesktopWindow();
+				hDesktopWnd_ = pBackend_->findDesktopWindow();
 			}
 
 			if (hDesktopWnd_ != NULL) {
-				SetParent(hTargetWnd_, hDesktopWnd_);
+				pBackend_->setParent(pContext_->hTargetWnd, hDesktopWnd_);
 				//SetBottommost(TRUE);
 				//SetWindowPos(
-				//	hTargetWnd_,
+				//	pContext_->hTargetWnd,
 				//	HWND_BOTTOM,
 				//	0, 0, 0, 0,
 				//	SWP_NOSIZE | SWP_NOMOVE | SWP_NOOWNERZORDER | SWP_NOACTIVATE | SWP_ASYNCWINDOWPOS // | SWP_FRAMECHANGED
@@ -892,19 +1403,17 @@ void UNIWINC_API SetBackground(const BOOL bEnabled) {
 		}
 		else
 		{
-			SetParent(hTargetWnd_, hParentWnd_);
+			pBackend_->setParent(pContext_->hTargetWnd, pContext_->hParentWnd);
 			//SetBottommost(FALSE);
 		}
 
 		// Run callback if the bottommost state changed
-		if (bIsBackground_!= bEnabled) {
-			if (hWindowStyleChangedHandler_ != nullptr) {
-				hWindowStyleChangedHandler_((INT32)(bEnabled ? WindowStateEventType::WallpaperModeEnabled : WindowStateEventType::WallpaperModeDisabled));
-			}
+		if (pContext_->bIsBackground!= bEnabled) {
+			notifyWindowStateChanged(bEnabled ? WindowStateEventType::WallpaperModeEnabled : WindowStateEventType::WallpaperModeDisabled);
 		}
 	}
 
-	bIsBackground_= bEnabled;
+	pContext_->bIsBackground= bEnabled;
 }
 
 /// <summary>
@@ -913,13 +1422,18 @@ void UNIWINC_API SetBackground(const BOOL bEnabled) {
 /// <param name="bZoomed"></param>
 /// <returns></returns>
 void UNIWINC_API SetMaximized(const BOOL bZoomed) {
-	if (hTargetWnd_) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetMaximized(bZoomed); });
+		return;
+	}
+
+	if (pContext_->hTargetWnd) {
 		if (bZoomed) {
-			ShowWindow(hTargetWnd_, SW_MAXIMIZE);
+			pBackend_->showWindow(pContext_->hTargetWnd, SW_MAXIMIZE);
 		}
 		else
 		{
-			ShowWindow(hTargetWnd_, SW_NORMAL);
+			pBackend_->showWindow(pContext_->hTargetWnd, SW_NORMAL);
 		}
 	}
 }
@@ -930,26 +1444,16 @@ void UNIWINC_API SetMaximized(const BOOL bZoomed) {
 /// <param name="bTransparent"></param>
 /// <returns></returns>
 void UNIWINC_API SetClickThrough(const BOOL bTransparent) {
-	if (hTargetWnd_) {
-		if (bTransparent) {
-			LONG exstyle = GetWindowLong(hTargetWnd_, GWL_EXSTYLE);
-			exstyle |= WS_EX_TRANSPARENT;
-			exstyle |= WS_EX_LAYERED;
-			SetWindowLong(hTargetWnd_, GWL_EXSTYLE, exstyle);
-		}
-		else
-		{
-			LONG exstyle = GetWindowLong(hTargetWnd_, GWL_EXSTYLE);
-			exstyle &= ~WS_EX_TRANSPARENT;
-
-			// 半透明を維持するため、レイヤードウィンドウは戻さないようコメントアウト
-			//if (!bIsTransparent_ && !(originalWindowInfo_.dwExStyle & WS_EX_LAYERED)) {
-			//	exstyle &= ~WS_EX_LAYERED;
-			//}
-			SetWindowLong(hTargetWnd_, GWL_EXSTYLE, exstyle);
-		}
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetClickThrough(bTransparent); });
+		return;
 	}
-	bIsClickThrough_ = bTransparent;
+
+	applyClickThrough(bTransparent);
+	pContext_->bIsClickThrough = bTransparent;
+
+	// マスクによるクリックスルーはここで上書きされたため、次のタイマーで改めて判定させる
+	pContext_->bIsMaskClickThrough = FALSE;
 }
 
 /// <summary>
@@ -959,18 +1463,22 @@ void UNIWINC_API SetClickThrough(const BOOL bTransparent) {
 /// <param name="y">プライマリー画面下端を原点とし、上が正のY座標 [px]</param>
 /// <returns>成功すれば true</returns>
 BOOL UNIWINC_API SetPosition(const float x, const float y) {
-	if (hTargetWnd_ == NULL) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { SetPosition(x, y); });
+	}
+
+	if (pContext_->hTargetWnd == NULL) return FALSE;
 
 	// 現在のウィンドウ位置とサイズを取得
 	RECT rect;
-	GetWindowRect(hTargetWnd_, &rect);
+	pBackend_->getWindowRect(pContext_->hTargetWnd, &rect);
 
 	// 引数の y はCocoa相当の座標系でウィンドウ左下なので、変換
-	int newY = (nPrimaryMonitorHeight_ - (int)y) - (rect.bottom - rect.top);
+	int newY = (getMonitorTopology()->getPrimaryHeight() - (int)y) - (rect.bottom - rect.top);
 	int newX = (int)(x);
 
-	return SetWindowPos(
-		hTargetWnd_, NULL,
+	return pBackend_->setWindowPos(
+		pContext_->hTargetWnd, NULL,
 		newX, newY,
 		0, 0,
 		SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOSIZE | SWP_NOZORDER //| SWP_ASYNCWINDOWPOS
@@ -987,12 +1495,10 @@ BOOL UNIWINC_API GetPosition(float* x, float* y) {
 	*x = 0;
 	*y = 0;
 
-	if (hTargetWnd_ == NULL) return FALSE;
-
 	RECT rect;
-	if (GetWindowRect(hTargetWnd_, &rect)) {
+	if (getTargetWindowRect(&rect)) {
 		*x = (float)(rect.left);
-		*y = (float)(nPrimaryMonitorHeight_- rect.bottom);	// 左下基準とする
+		*y = (float)(getMonitorTopology()->getPrimaryHeight() - rect.bottom);	// 左下基準とする
 		return TRUE;
 	}
 	return FALSE;
@@ -1005,11 +1511,15 @@ BOOL UNIWINC_API GetPosition(float* x, float* y) {
 /// <param name="height">高さ [px]</param>
 /// <returns>成功すれば true</returns>
 BOOL UNIWINC_API SetSize(const float width, const float height) {
-	if (hTargetWnd_ == NULL) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { SetSize(width, height); });
+	}
+
+	if (pContext_->hTargetWnd == NULL) return FALSE;
 
 	// 現在のウィンドウ位置とサイズを取得
 	RECT rect;
-	GetWindowRect(hTargetWnd_, &rect);
+	pBackend_->getWindowRect(pContext_->hTargetWnd, &rect);
 
 	int x = rect.left;
 	int y = rect.bottom;
@@ -1019,8 +1529,8 @@ BOOL UNIWINC_API SetSize(const float width, const float height) {
 	// 左下原点とするために調整した、新規Y座標
 	y = y - h;
 
-	return SetWindowPos(
-		hTargetWnd_, NULL,
+	return pBackend_->setWindowPos(
+		pContext_->hTargetWnd, NULL,
 		x, y, w, h,
 		SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOZORDER | SWP_FRAMECHANGED //| SWP_ASYNCWINDOWPOS
 	);
@@ -1036,9 +1546,8 @@ BOOL UNIWINC_API GetSize(float* width, float* height) {
 	*width = 0;
 	*height = 0;
 
-	if (hTargetWnd_ == NULL) return FALSE;
 	RECT rect;
-	if (GetWindowRect(hTargetWnd_, &rect)) {
+	if (getTargetWindowRect(&rect)) {
 		*width = (float)(rect.right - rect.left);	// +1 は不要なよう
 		*height = (float)(rect.bottom - rect.top);	// +1 は不要なよう
 
@@ -1057,9 +1566,17 @@ BOOL UNIWINC_API GetClientSize(float* width, float* height) {
 	*width = 0;
 	*height = 0;
 
-	if (hTargetWnd_ == NULL) return FALSE;
+	if (!isWindowThread()) {
+		const WindowGeometry geometry = pContext_->geometry.load();
+		if (geometry.hWnd == NULL) return FALSE;
+		*width = (float)geometry.client.cx;
+		*height = (float)geometry.client.cy;
+		return TRUE;
+	}
+
+	if (pContext_->hTargetWnd == NULL) return FALSE;
 	RECT rect;
-	if (GetClientRect(hTargetWnd_, &rect)) {
+	if (pBackend_->getClientRect(pContext_->hTargetWnd, &rect)) {
 		*width = (float)(rect.right - rect.left);
 		*height = (float)(rect.bottom - rect.top);
 
@@ -1068,6 +1585,63 @@ BOOL UNIWINC_API GetClientSize(float* width, float* height) {
 	return FALSE;
 }
 
+/// <summary>
+/// Get the window position, sizes, state, monitor and cursor position at once
+///   Each of them is queried only once, instead of calling GetPosition(), GetSize(), GetClientSize(), IsMaximized(),
+///   GetCurrentMonitor() and GetCursorPosition() separately.
+/// </summary>
+/// <param name="pSnapshot">nStructSize を設定しておくこと。nGeneration に前回の値を入れておけば、変化があったか Changed フラグで分かる（カーソルの移動は含まない）</param>
+/// <returns>成功すればTRUE</returns>
+BOOL UNIWINC_API GetWindowSnapshot(PWINDOWSNAPSHOT pSnapshot) {
+	if (pSnapshot == nullptr || pSnapshot->nStructSize < (INT32)sizeof(INT32)) return FALSE;
+
+	// ウィンドウスレッドでは最新の状態を公開してから読む。他のスレッドでは公開済みの状態を読む
+	if (isWindowThread()) publishWindowGeometry();
+
+	UINT32 sequence;
+	const WindowGeometry geometry = pContext_->geometry.load(&sequence);
+	const MonitorTopologyRing::Reader topology = getMonitorTopology();
+	const LONG primaryHeight = topology->getPrimaryHeight();
+
+	WINDOWSNAPSHOT snapshot = WINDOWSNAPSHOT();
+	if (geometry.hWnd) {
+		snapshot.nFlags |= (INT32)WindowSnapshotFlag::Attached;
+		if (geometry.bZoomed) snapshot.nFlags |= (INT32)WindowSnapshotFlag::Maximized;
+		if (geometry.bIconic) snapshot.nFlags |= (INT32)WindowSnapshotFlag::Minimized;
+
+		// GetPosition(), GetSize() と同じく左下基準
+		snapshot.x = (float)(geometry.rect.left);
+		snapshot.y = (float)(primaryHeight - geometry.rect.bottom);
+		snapshot.width = (float)(geometry.rect.right - geometry.rect.left);
+		snapshot.height = (float)(geometry.rect.bottom - geometry.rect.top);
+		snapshot.clientWidth = (float)geometry.client.cx;
+		snapshot.clientHeight = (float)geometry.client.cy;
+	}
+
+	snapshot.nMonitor = findMonitorOfWindow(*topology, (geometry.hWnd ? &geometry.rect : NULL));
+	snapshot.nMonitorCount = topology->getCount();
+	snapshot.nMonitorGeneration = topology->getGeneration();
+
+	// ウィンドウの状態は変わった時だけ書かれるので、その回数とモニタの世代の和を世代とする
+	//   カーソルはほぼ毎フレーム動くので含めない。含めると、ウィンドウが止まっていても毎回 Changed になってしまう
+	snapshot.nGeneration = sequence / 2 + topology->getGeneration();
+	if (pSnapshot->nStructSize < (INT32)(sizeof(INT32) * 2) || pSnapshot->nGeneration != snapshot.nGeneration) {
+		snapshot.nFlags |= (INT32)WindowSnapshotFlag::Changed;
+	}
+
+	POINT pos;
+	if (pSharedBackend_.load(std::memory_order_acquire)->getCursorPos(&pos)) {
+		snapshot.cursorX = (float)pos.x;
+		snapshot.cursorY = (float)(primaryHeight - pos.y - 1);
+	}
+
+	// 呼び出し側の構造体の方が小さければ、入る分だけ返す
+	INT32 size = pSnapshot->nStructSize;
+	snapshot.nStructSize = (size < (INT32)sizeof(WINDOWSNAPSHOT) ? size : (INT32)sizeof(WINDOWSNAPSHOT));
+	memcpy(pSnapshot, &snapshot, snapshot.nStructSize);
+	return TRUE;
+}
+
 /// <summary>
 /// Register the callback fucnction called when window style changed
 /// </summary>
@@ -1075,8 +1649,11 @@ BOOL UNIWINC_API GetClientSize(float* width, float* height) {
 /// <returns></returns>
 BOOL UNIWINC_API RegisterWindowStyleChangedCallback(WindowStyleChangedCallback callback) {
 	if (callback == nullptr) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { RegisterWindowStyleChangedCallback(callback); });
+	}
 
-	hWindowStyleChangedHandler_= callback;
+	pContext_->hWindowStyleChangedHandler= callback;
 	return TRUE;
 }
 
@@ -1085,7 +1662,11 @@ BOOL UNIWINC_API RegisterWindowStyleChangedCallback(WindowStyleChangedCallback c
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API UnregisterWindowStyleChangedCallback() {
-	hWindowStyleChangedHandler_ = nullptr;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([]() { UnregisterWindowStyleChangedCallback(); });
+	}
+
+	pContext_->hWindowStyleChangedHandler = nullptr;
 	return TRUE;
 }
 
@@ -1101,45 +1682,16 @@ BOOL UNIWINC_API UnregisterWindowStyleChangedCallback() {
 /// </summary>
 /// <returns></returns>
 INT32 UNIWINC_API GetCurrentMonitor() {
-	int primaryIndex = 0;
-
-	//  ウィンドウ未取得ならプライマリモニタを探す
-	if (hTargetWnd_ == NULL) {
-		for (int i = 0; i < nMonitorCount_; i++) {
-			RECT mr = pMonitorRect_[pMonitorIndices_[i]];
+	const MonitorTopologyRing::Reader topology = getMonitorTopology();
 
-			// 原点にあるモニタはプライマリと判定
-			if (mr.left == 0 && mr.top == 0) {
-				primaryIndex = i;
-				break;
-			}
-		}
-		return primaryIndex;
-	}
-
-	// 現在のウィンドウの中心座標を取得
+	//  ウィンドウ未取得ならプライマリモニタ
 	RECT rect;
-	GetWindowRect(hTargetWnd_, &rect);
-	LONG cx = (rect.right - 1 + rect.left) / 2;
-	LONG cy = (rect.bottom - 1 + rect.top) / 2;
-
-	// ウィンドウの中央が含まれているモニタを検索
-	for (int i = 0; i < nMonitorCount_; i++) {
-		RECT mr = pMonitorRect_[pMonitorIndices_[i]];
-
-		// ウィンドウ中心が入っていればその画面番号を返して終了
-		if (mr.left <= cx && cx < mr.right && mr.top <= cy && cy < mr.bottom) {
-			return i;
-		}
-
-		// 原点にあるモニタはプライマリと判定
-		if (mr.left == 0 && mr.top == 0) {
-			primaryIndex = i;
-		}
+	if (!getTargetWindowRect(&rect)) {
+		return findMonitorOfWindow(*topology, NULL);
 	}
 
-	// 判定できなければプライマリモニタの画面番号を返す
-	return primaryIndex;
+	// 現在のウィンドウの中心座標から判定
+	return findMonitorOfWindow(*topology, &rect);
 }
 
 
@@ -1150,7 +1702,7 @@ INT32 UNIWINC_API GetCurrentMonitor() {
 INT32  UNIWINC_API GetMonitorCount() {
 	//// SM_CMONITORS では表示されているモニタのみ対象となる（EnumDisplayとは異なる）
 	//return GetSystemMetrics(SM_CMONITORS);
-	return nMonitorCount_;
+	return getMonitorTopology()->getCount();
 }
 
 /// <summary>
@@ -1165,13 +1717,14 @@ BOOL  UNIWINC_API GetMonitorRectangle(const INT32 monitorIndex, float* x, float*
 	*width = 0;
 	*height = 0;
 
-	if (monitorIndex < 0 || monitorIndex >= nMonitorCount_) {
+	const MonitorTopologyRing::Reader topology = getMonitorTopology();
+	if (monitorIndex < 0 || monitorIndex >= topology->getCount()) {
 		return FALSE;
 	}
 
-	RECT rect = pMonitorRect_[pMonitorIndices_[monitorIndex]];
+	RECT rect = topology->getRect(monitorIndex);
 	*x = (float)(rect.left);
-	*y = (float)(nPrimaryMonitorHeight_ - rect.bottom);		// 左下基準とする
+	*y = (float)(topology->getPrimaryHeight() - rect.bottom);		// 左下基準とする
 	*width = (float)(rect.right - rect.left);
 	*height = (float)(rect.bottom - rect.top);
 	return TRUE;
@@ -1184,8 +1737,11 @@ BOOL  UNIWINC_API GetMonitorRectangle(const INT32 monitorIndex, float* x, float*
 /// <returns></returns>
 BOOL UNIWINC_API RegisterMonitorChangedCallback(MonitorChangedCallback callback) {
 	if (callback == nullptr) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { RegisterMonitorChangedCallback(callback); });
+	}
 
-	hMonitorChangedHandler_ = callback;
+	pContext_->hMonitorChangedHandler = callback;
 	return TRUE;
 }
 
@@ -1194,7 +1750,11 @@ BOOL UNIWINC_API RegisterMonitorChangedCallback(MonitorChangedCallback callback)
 /// </summary>
 /// <returns></returns>
 BOOL UNIWINC_API UnregisterMonitorChangedCallback() {
-	hMonitorChangedHandler_ = nullptr;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([]() { UnregisterMonitorChangedCallback(); });
+	}
+
+	pContext_->hMonitorChangedHandler = nullptr;
 	return TRUE;
 }
 
@@ -1214,10 +1774,11 @@ BOOL UNIWINC_API GetCursorPosition(float* x, float* y) {
 	*x = 0;
 	*y = 0;
 
+	// カーソル位置の取得はどのスレッドからでもよい
 	POINT pos;
-	if (GetCursorPos(&pos)) {
+	if (pSharedBackend_.load(std::memory_order_acquire)->getCursorPos(&pos)) {
 		*x = (float)pos.x;
-		*y = (float)(nPrimaryMonitorHeight_ - pos.y - 1);	// 左下基準とする
+		*y = (float)(getMonitorTopology()->getPrimaryHeight() - pos.y - 1);	// 左下基準とする
 		return TRUE;
 	}
 	return FALSE;
@@ -1231,186 +1792,966 @@ BOOL UNIWINC_API GetCursorPosition(float* x, float* y) {
 /// <param name="y">プライマリー画面下端を原点とし、上が正のY座標 [px]</param>
 /// <returns>成功すれば true</returns>
 BOOL UNIWINC_API SetCursorPosition(const float x, const float y) {
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { SetCursorPosition(x, y); });
+	}
+
 	POINT pos;
 
 	pos.x = (int)x;
-	pos.y = nPrimaryMonitorHeight_ - (int)y - 1;
+	pos.y = getMonitorTopology()->getPrimaryHeight() - (int)y - 1;
+
+	return pBackend_->setCursorPos(pos.x, pos.y);
+}
+
+/// <summary>
+/// ドラッグ中のウィンドウをカーソルに追従させる
+/// </summary>
+void stepDragMove() {
+	if (!pContext_->hTargetWnd || !pContext_->dragMover.isDragging()) return;
+
+	POINT cursor;
+	if (!pBackend_->getCursorPos(&cursor)) return;
+
+	// 位置が変わった時だけ動かす。サイズは変えないので取得し直さない
+	POINT pos;
+	if (pContext_->dragMover.move(cursor, *getMonitorTopology(), &pos)) {
+		pBackend_->setWindowPos(
+			pContext_->hTargetWnd, NULL,
+			pos.x, pos.y,
+			0, 0,
+			SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOSIZE | SWP_NOZORDER
+		);
+	}
+}
+
+/// <summary>
+/// ウィンドウのドラッグを終了し、DragMoveEnded を通知
+/// </summary>
+/// <param name="bReleased">マウスボタンが離されて終了したか</param>
+void endDragMove(const BOOL bReleased) {
+	if (!pContext_->dragMover.isDragging()) return;
+
+	pContext_->dragMover.end();
+	pContext_->bIsDragMoving = FALSE;
+	if (pContext_->hTargetWnd) {
+		pBackend_->killTimer(pContext_->hTargetWnd, DRAGMOVE_TIMER_ID);
+	}
+	queueEvent(EventType::DragMoveEnded, (bReleased ? 1 : 0));
+}
+
+/// <summary>
+/// ウィンドウのドラッグを開始
+///   以後はフレームに関係なく、マウスの移動とタイマーでウィンドウがカーソルに追従する
+///   開始時にボタンが押されていれば、離された時点で終了する。そうでなければ EndDragMove() で終了する
+/// </summary>
+/// <returns>開始できれば true。最大化、最小化されていれば開始しない</returns>
+BOOL UNIWINC_API BeginDragMove() {
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { BeginDragMove(); });
+	}
+
+	if (pContext_->hTargetWnd == NULL) return FALSE;
+	if (pBackend_->isZoomed(pContext_->hTargetWnd) || pBackend_->isIconic(pContext_->hTargetWnd)) return FALSE;
+
+	POINT cursor;
+	RECT rect;
+	if (!pBackend_->getCursorPos(&cursor) || !pBackend_->getWindowRect(pContext_->hTargetWnd, &rect)) return FALSE;
+
+	// 位置のアニメーションよりドラッグを優先
+	cancelWindowTweens((DWORD)WindowTweenFlag::Position);
+
+	pContext_->dragMover.begin(cursor, rect);
+	pContext_->bIsDragMoving = TRUE;
+	pContext_->bIsDragEndOnRelease = pBackend_->isPrimaryButtonDown();
+	pBackend_->setTimer(pContext_->hTargetWnd, DRAGMOVE_TIMER_ID, UNIWINC_DRAGMOVE_INTERVAL);
+	return TRUE;
+}
+
+/// <summary>
+/// ウィンドウのドラッグを終了
+/// </summary>
+void UNIWINC_API EndDragMove() {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { EndDragMove(); });
+		return;
+	}
 
-	return SetCursorPos(pos.x, pos.y);
+	endDragMove(FALSE);
+}
+
+/// <summary>
+/// ウィンドウのドラッグ中か
+/// </summary>
+BOOL UNIWINC_API IsDragMoving() {
+	return pContext_->bIsDragMoving;
+}
+
+/// <summary>
+/// ドラッグ中のウィンドウを、モニタの端に吸着させるか設定
+/// </summary>
+/// <param name="bEnabled">吸着させるなら true</param>
+/// <param name="nDistance">端からこの距離以内で吸着する [px]。0以下なら既定値</param>
+void UNIWINC_API SetDragMoveSnap(const BOOL bEnabled, const INT32 nDistance) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetDragMoveSnap(bEnabled, nDistance); });
+		return;
+	}
+
+	pContext_->dragMover.setSnapDistance(bEnabled ? (nDistance > 0 ? nDistance : UNIWINC_DRAGMOVE_SNAP_DISTANCE) : 0);
 }
 
 #pragma endregion For mouse cursor
 
 
 // ========================================================================
-#pragma region For file dropping and window procedure
+#pragma region For window tween
 
 /// <summary>
-/// Process drop files
+/// キャンセルされたアニメーションを通知
 /// </summary>
-/// <param name="hDrop"></param>
-/// <returns></returns>
-BOOL receiveDropFiles(HDROP hDrop) {
-	// TODO: Windowsでは特殊文字がファイル名に入る例はまず無さそうだが、macOSと同様にダブルクォーテーション囲みにした方がよい
-	//		CSVと同様にダブルクォーテーションが文字としてあれば二重にする
-	UINT num = DragQueryFile(hDrop, 0xFFFFFFFF, NULL, 0);
+void queueTweenCancelled(const std::vector<UINT32>& cancelled) {
+	for (const UINT32 id : cancelled) {
+		queueEvent(EventType::TweenCancelled, (INT32)id);
+	}
+}
 
-	if (num > 0) {
-		// Retrieve total buffer size
-		UINT bufferSize = 0;
-		for (UINT i = 0; i < num; i++) {
-			UINT size = DragQueryFile(hDrop, i, NULL, 0);
-			bufferSize += size + sizeof(L'\n');		// Add a delimiter size
-		}
-		bufferSize++;
-
-		// Allocate buffer
-		LPWSTR buffer;
-		buffer = new (std::nothrow)WCHAR[bufferSize];
-
-		if (buffer != NULL) {
-			// Retrieve file paths
-			UINT bufferIndex = 0;
-			for (UINT i = 0; i < num; i++) {
-				UINT cch = bufferSize - 1 - bufferIndex;
-				UINT size = DragQueryFile(hDrop, i, buffer + bufferIndex, cch);
-				bufferIndex += size;
-				buffer[bufferIndex] = L'\n';	// Delimiter of each path
-				bufferIndex++;
-			}
-			buffer[bufferIndex] = NULL;
+/// <summary>
+/// 各プロパティを動かしているアニメーションを、他のスレッドの IsWindowTweening() のために公開する
+///   windowTweener を変えたら呼ぶ
+/// </summary>
+void publishWindowTweens() {
+	const DWORD flags[] = { (DWORD)WindowTweenFlag::Position, (DWORD)WindowTweenFlag::Size, (DWORD)WindowTweenFlag::Alpha };
+	for (int i = 0; i < 3; i++) {
+		pContext_->tweenIds[i].store(pContext_->windowTweener.getTweenOf(flags[i]), std::memory_order_release);
+	}
+}
 
-			// Do callback function
-			if (hDropFilesHandler_ != nullptr) {
-				hDropFilesHandler_((WCHAR*)buffer);	// Charset of this project must be set U
-			}
+/// <summary>
+/// アニメーションが無くなればタイマーを止める
+/// </summary>
+void stopIdleTweenTimer() {
+	if (pContext_->hTargetWnd && pContext_->windowTweener.isEmpty()) {
+		pBackend_->killTimer(pContext_->hTargetWnd, TWEEN_TIMER_ID);
+	}
+}
+
+/// <summary>
+/// アニメーションを現在の時刻まで進める
+///   全てのアニメーションをまとめ、位置とサイズは1回の SetWindowPos で、透明度は1回で反映する
+/// </summary>
+void stepWindowTweens() {
+	if (!pContext_->hTargetWnd || pContext_->windowTweener.isEmpty()) return;
+
+	const DWORD geometry = (DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Size;
+
+	// 動かさない値は現在の状態のまま。位置かサイズを動かす時だけ取得する
+	RECT rect = { 0, 0, 0, 0 };
+	if ((pContext_->windowTweener.getFlags() & geometry) && !pBackend_->getWindowRect(pContext_->hTargetWnd, &rect)) return;
+
+	TweenValues values;
+	values.left = rect.left;
+	values.bottom = rect.bottom;
+	values.width = rect.right - rect.left;
+	values.height = rect.bottom - rect.top;
+	values.alpha = pContext_->byAlpha;
+
+	std::vector<UINT32> completed;
+	const DWORD written = pContext_->windowTweener.step(pBackend_->getMonotonicTime(), values, completed);
+	publishWindowTweens();
+
+	if (written & geometry) {
+		const LONG width = (values.width > 0 ? (LONG)std::lround(values.width) : 0);
+		const LONG height = (values.height > 0 ? (LONG)std::lround(values.height) : 0);
+		const LONG left = (LONG)std::lround(values.left);
+		const LONG top = (LONG)std::lround(values.bottom) - height;
+
+		// 変わらないものは指定しない。枠は変わらないので SWP_FRAMECHANGED も不要
+		UINT flags = SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOZORDER;
+		if (width == rect.right - rect.left && height == rect.bottom - rect.top) flags |= SWP_NOSIZE;
+		if (left == rect.left && top == rect.top) flags |= SWP_NOMOVE;
 
-			delete[] buffer;
+		if ((flags & (SWP_NOSIZE | SWP_NOMOVE)) != (SWP_NOSIZE | SWP_NOMOVE)) {
+			pBackend_->setWindowPos(pContext_->hTargetWnd, NULL, left, top, width, height, flags);
 		}
 	}
 
-	return (num > 0);
+	if (written & (DWORD)WindowTweenFlag::Alpha) {
+		const double alpha = (values.alpha < 0.0 ? 0.0 : (values.alpha > 255.0 ? 255.0 : values.alpha));
+		const BYTE byAlpha = (BYTE)std::lround(alpha);
+		if (byAlpha != pContext_->byAlpha) {
+			pContext_->byAlpha = byAlpha;
+			updateAlphaValue();
+		}
+	}
+
+	stopIdleTweenTimer();
+
+	for (const UINT32 id : completed) {
+		queueEvent(EventType::TweenCompleted, (INT32)id);
+	}
 }
 
 /// <summary>
-/// Custom window proceture to accept dropped files and display-changed event
+/// 指定されたプロパティのアニメーションを止め、TweenCancelled を通知
 /// </summary>
-/// <param name="hWnd"></param>
-/// <param name="uMsg"></param>
-/// <param name="wParam"></param>
-/// <param name="lParam"></param>
-/// <returns></returns>
-LRESULT CALLBACK customWindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
-{
-	HDROP hDrop;
-	INT32 count;
+/// <param name="flags">WindowTweenFlag</param>
+void cancelWindowTweens(const DWORD flags) {
+	if (pContext_->windowTweener.isEmpty()) return;
 
-	switch (uMsg)
-	{
-	case WM_DROPFILES:
-		hDrop = (HDROP)wParam;
-		receiveDropFiles(hDrop);
-		DragFinish(hDrop);
-		break;
+	std::vector<UINT32> cancelled;
+	pContext_->windowTweener.take(flags, cancelled);
+	publishWindowTweens();
+	queueTweenCancelled(cancelled);
+	stopIdleTweenTimer();
+}
 
-	case WM_DISPLAYCHANGE:
-		updateScreenSize();
+/// <summary>
+/// ウィンドウの位置、サイズ、透明度のアニメーションを開始
+///   以後はフレームに関係なくライブラリ内のタイマーで進み、終われば PollEvents() で TweenCompleted が通知される
+///   同じプロパティを動かしていたアニメーションは、そのプロパティについては止まる
+/// </summary>
+/// <param name="pTween">nStructSize を設定しておくこと</param>
+/// <returns>アニメーションのID。失敗すれば 0</returns>
+UINT32 UNIWINC_API StartWindowTween(const PWINDOWTWEEN pTween) {
+	// IDを返すため、ウィンドウスレッドのみ
+	if (!isWindowThread()) return 0;
+	if (pContext_->hTargetWnd == NULL || pTween == nullptr || pTween->nStructSize < (INT32)sizeof(INT32)) return 0;
 
-		// Run callback
-		if (hMonitorChangedHandler_ != nullptr) {
-			count = GetMonitorCount();
-			hMonitorChangedHandler_(count);
-		}
-		break;
+	// 古い定義の構造体でも受け取れるよう、足りない部分は 0 とする
+	WINDOWTWEEN tween;
+	ZeroMemory(&tween, sizeof(tween));
+	memcpy(&tween, pTween, (pTween->nStructSize < (INT32)sizeof(WINDOWTWEEN) ? pTween->nStructSize : sizeof(WINDOWTWEEN)));
 
-	case WM_WINDOWPOSCHANGING:
-		// 常に最背面
-		if (bIsBottommost_) {
-			((WINDOWPOS*)lParam)->hwndInsertAfter = HWND_BOTTOM;
-		}
-		break;
+	RECT rect;
+	if (!pBackend_->getWindowRect(pContext_->hTargetWnd, &rect)) return 0;
 
-	case WM_STYLECHANGED:	// スタイルの変化を検出
-		// Run callback
-		if (hWindowStyleChangedHandler_ != nullptr) {
-			hWindowStyleChangedHandler_((INT32)WindowStateEventType::StyleChanged);
-		}
-		break;
+	TweenValues from;
+	from.left = rect.left;
+	from.bottom = rect.bottom;
+	from.width = rect.right - rect.left;
+	from.height = rect.bottom - rect.top;
+	from.alpha = pContext_->byAlpha;
 
-	case WM_SIZE:		// 最大化、最小化による変化を検出
-		switch (wParam)
-		{
-		case SIZE_RESTORED:		// 最小化でも最大化でもない通常のリサイズ
-		case SIZE_MAXIMIZED:
-		case SIZE_MINIMIZED:
-			// Run callback
-			if (hWindowStyleChangedHandler_ != nullptr) {
-				hWindowStyleChangedHandler_((INT32)WindowStateEventType::Resized);
-			}
-			break;
-		}
-		break;
-		
-	default:
-		break;
+	// 引数の y はCocoa相当の座標系でウィンドウ左下なので、変換
+	TweenValues to;
+	to.left = tween.x;
+	to.bottom = (double)getMonitorTopology()->getPrimaryHeight() - tween.y;
+	to.width = (tween.width > 0 ? tween.width : 0);
+	to.height = (tween.height > 0 ? tween.height : 0);
+	to.alpha = (BYTE)(0xFF * (tween.alpha < 0 ? 0 : (tween.alpha > 1 ? 1 : tween.alpha)));	// SetAlphaValue() と同じ値にする
+
+	const BOOL bWasEmpty = pContext_->windowTweener.isEmpty();
+	std::vector<UINT32> cancelled;
+	const UINT32 id = pContext_->windowTweener.start(pBackend_->getMonotonicTime(), (DWORD)tween.nFlags, from, to, (INT64)tween.nDuration * 1000, (EasingType)tween.nEasing, cancelled);
+	publishWindowTweens();
+	queueTweenCancelled(cancelled);
+	if (id == 0) {
+		stopIdleTweenTimer();
+		return 0;
 	}
 
-	if (lpOriginalWndProc_ != NULL) {
-		return CallWindowProc(lpOriginalWndProc_, hWnd, uMsg, wParam, lParam);
+	// ドラッグ中なら位置はアニメーションを優先
+	if (tween.nFlags & (DWORD)WindowTweenFlag::Position) {
+		endDragMove(FALSE);
 	}
-	else {
-		return DefWindowProc(hWnd, uMsg, wParam, lParam);
+
+	if (bWasEmpty) {
+		pBackend_->setTimer(pContext_->hTargetWnd, TWEEN_TIMER_ID, UNIWINC_TWEEN_INTERVAL);
+	}
+
+	// 時間が無ければすぐに反映
+	if (tween.nDuration <= 0) {
+		stepWindowTweens();
 	}
+	return id;
 }
 
 /// <summary>
-/// Wrapper of SetWindowLongPtr to set window procedure
+/// アニメーションを止める
 /// </summary>
-/// <param name="wndProc"></param>
-/// <returns></returns>
-WNDPROC setWindowProcedure(WNDPROC wndProc) {
-	//return (WNDPROC)SetWindowLongPtr(hTargetWnd_, GWLP_WNDPROC, (LONG_PTR)wndProc);
+/// <param name="nTweenId">StartWindowTween() で得たID</param>
+/// <param name="bComplete">true なら目標値にして TweenCompleted、false ならその場で止めて TweenCancelled を通知</param>
+/// <returns>動いているアニメーションでなければ false</returns>
+BOOL UNIWINC_API StopWindowTween(const UINT32 nTweenId, const BOOL bComplete) {
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { StopWindowTween(nTweenId, bComplete); });
+	}
+
+	if (!pContext_->windowTweener.stop(nTweenId, bComplete)) return FALSE;
+	publishWindowTweens();
 
-#ifdef _WIN64
-	// 64bit
-	return (WNDPROC)SetWindowLongPtr(hTargetWnd_, GWLP_WNDPROC, (LONG_PTR)wndProc);
-#else
-	return (WNDPROC)SetWindowLong(hTargetWnd_, GWLP_WNDPROC, (LONG)wndProc);
-#endif
+	if (bComplete) {
+		stepWindowTweens();
+	}
+	else {
+		queueEvent(EventType::TweenCancelled, (INT32)nTweenId);
+		stopIdleTweenTimer();
+	}
+	return TRUE;
 }
 
 /// <summary>
-/// Remove the custom window procedure
+/// 全てのアニメーションをその場で止める
 /// </summary>
-void destroyCustomWindowProcedure() {
-	if (lpMyWndProc_ == NULL) return;
+void UNIWINC_API StopAllWindowTweens() {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { StopAllWindowTweens(); });
+		return;
+	}
+
+	cancelWindowTweens((DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Size | (DWORD)WindowTweenFlag::Alpha);
+}
 
-	if (lpOriginalWndProc_ != NULL) {
-		if (hTargetWnd_ != NULL && IsWindow(hTargetWnd_)) {
-			setWindowProcedure(lpOriginalWndProc_);
+/// <summary>
+/// アニメーション中か
+/// </summary>
+/// <param name="nTweenId">StartWindowTween() で得たID。0 ならいずれかが動いているか</param>
+BOOL UNIWINC_API IsWindowTweening(const UINT32 nTweenId) {
+	if (!isWindowThread()) {
+		// 他のスレッドでは、プロパティごとに公開されているIDから調べる
+		for (const std::atomic<UINT32>& id : pContext_->tweenIds) {
+			const UINT32 running = id.load(std::memory_order_acquire);
+			if (running != 0 && (nTweenId == 0 || running == nTweenId)) return TRUE;
 		}
-		lpOriginalWndProc_ = NULL;
+		return FALSE;
 	}
-	lpMyWndProc_ = NULL;
+	return pContext_->windowTweener.isRunning(nTweenId);
 }
 
+#pragma endregion For window tween
+
+
+// ========================================================================
+#pragma region For hit test mask
+
 /// <summary>
-/// Create and attach the custom window procedure
+/// マスク上で指定座標が不透明か調べる
 /// </summary>
-void createCustomWindowProcedure() {
-	if (lpMyWndProc_ != NULL) {
-		destroyCustomWindowProcedure();
+/// <param name="x">スクリーン座標 [px]</param>
+/// <param name="y">スクリーン座標 [px]</param>
+/// <returns>不透明、またはクライアント領域外ならば TRUE</returns>
+BOOL hitTestMaskAt(const INT32 x, const INT32 y) {
+	POINT pt = { x, y };
+	RECT rcClient;
+	if (!pBackend_->screenToClient(pContext_->hTargetWnd, &pt)) return TRUE;
+	if (!pBackend_->getClientRect(pContext_->hTargetWnd, &rcClient)) return TRUE;
+
+	return pContext_->hitTestMask.hitTest(pt.x, pt.y, rcClient.right, rcClient.bottom);
+}
+
+/// <summary>
+/// マスクによるクリックスルーを解除
+/// </summary>
+void resetMaskClickThrough() {
+	if (!pContext_->bIsMaskClickThrough) return;
+
+	if (!pContext_->bIsClickThrough) {
+		applyClickThrough(FALSE);
+	}
+	pContext_->bIsMaskClickThrough = FALSE;
+}
+
+/// <summary>
+/// マスクから設定した入力領域を解除し、ウィンドウ全体に戻す
+/// </summary>
+void resetInputRegion() {
+	if (!pContext_->bIsInputRegionApplied) return;
+
+	pBackend_->setInputRegion(pContext_->hTargetWnd, NULL, 0);
+	pContext_->bIsInputRegionApplied = FALSE;
+}
+
+/// <summary>
+/// マスクの不透明部分をウィンドウの入力領域にする
+///   以降のヒットテストはOSが行う。マスクかクライアント領域サイズが変わった場合のみ設定し直す
+/// </summary>
+void updateInputRegion() {
+	if (!pContext_->hTargetWnd || !pContext_->bIsInputRegionEnabled) return;
+
+	RECT rcClient;
+	if (!pBackend_->getClientRect(pContext_->hTargetWnd, &rcClient)) return;
+	if (rcClient.right <= 0 || rcClient.bottom <= 0) return;		// 最小化中
+
+	if (pContext_->bIsInputRegionApplied
+		&& pContext_->nInputRegionVersion == pContext_->hitTestMask.getVersion()
+		&& pContext_->szInputRegionClient.cx == rcClient.right
+		&& pContext_->szInputRegionClient.cy == rcClient.bottom) {
+		return;
 	}
 
-	if (hTargetWnd_ != NULL) {
-		lpMyWndProc_ = customWindowProcedure;
-		lpOriginalWndProc_ = setWindowProcedure(lpMyWndProc_);
+	if (pContext_->hitTestMask.getRegion(pContext_->inputRegionRects, rcClient.right, rcClient.bottom, &pContext_->nInputRegionVersion)) {
+		pBackend_->setInputRegion(pContext_->hTargetWnd, pContext_->inputRegionRects.data(), (UINT)pContext_->inputRegionRects.size());
+	}
+	else {
+		// マスクが無ければウィンドウ全体
+		pBackend_->setInputRegion(pContext_->hTargetWnd, NULL, 0);
 	}
+	pContext_->bIsInputRegionApplied = TRUE;
+	pContext_->szInputRegionClient.cx = rcClient.right;
+	pContext_->szInputRegionClient.cy = rcClient.bottom;
 }
 
+/// <summary>
+/// カーソル位置のマスクに合わせてクリックスルーを切り替える。入力領域を使う場合はそれを更新する
+///   WS_EX_TRANSPARENT の間は WM_NCHITTEST が届かないため、タイマーで呼ばれる
+/// </summary>
+void updateHitTestMask() {
+	if (!pContext_->hTargetWnd) return;
 
-// ↓ウィンドウプロシージャではなくメッセージをフックする場合はこちらを使う
-//    解像度変更を検出するためにウィンドウプロシージャを使うものとした
+	// 入力領域を使う場合、判定はOSに任せる
+	if (pContext_->bIsInputRegionEnabled) {
+		resetMaskClickThrough();
+		updateInputRegion();
+		return;
+	}
+	resetInputRegion();
+
+	if (!pContext_->bIsHitTestMaskEnabled) return;
+
+	// 明示的にクリックスルーにされていれば、そちらを優先
+	if (pContext_->bIsClickThrough) return;
+
+	POINT pos;
+	if (!pBackend_->getCursorPos(&pos)) return;
+
+	const BOOL bThrough = !hitTestMaskAt(pos.x, pos.y);
+	if (bThrough != pContext_->bIsMaskClickThrough) {
+		applyClickThrough(bThrough);
+		pContext_->bIsMaskClickThrough = bThrough;
+	}
+}
+
+/// <summary>
+/// マスクによるクリックスルーの追従を終了し、マスクで変えた状態を戻す
+/// </summary>
+void stopHitTestMask() {
+	if (!pContext_->hTargetWnd) return;
+
+	pBackend_->killTimer(pContext_->hTargetWnd, HITTEST_TIMER_ID);
+	resetMaskClickThrough();
+	resetInputRegion();
+}
+
+/// <summary>
+/// 有効な機能に合わせて、マスクによる判定を開始または終了
+/// </summary>
+void updateHitTestMode() {
+	if (!pContext_->hTargetWnd) return;
+
+	if (pContext_->bIsHitTestMaskEnabled || pContext_->bIsInputRegionEnabled) {
+		pBackend_->setTimer(pContext_->hTargetWnd, HITTEST_TIMER_ID, UNIWINC_HITTEST_INTERVAL);
+		updateHitTestMask();
+	}
+	else {
+		stopHitTestMask();
+	}
+}
+
+/// <summary>
+/// 8bit のアルファ値からマスクを設定
+///   縮小した画像でもよく、クライアント領域に合わせて拡大して判定される
+/// </summary>
+/// <param name="pAlpha">width * height のアルファ値。Unityのテクスチャと同じく下の行から</param>
+/// <param name="width">マスクの幅 [px]</param>
+/// <param name="height">マスクの高さ [px]</param>
+/// <param name="threshold">この値以上ならば不透明とする</param>
+/// <returns>成功すれば true</returns>
+BOOL UNIWINC_API SetHitTestMask(const BYTE* pAlpha, const INT32 width, const INT32 height, const BYTE threshold) {
+	return pContext_->hitTestMask.setAlpha(pAlpha, width, height, threshold);
+}
+
+/// <summary>
+/// 1ピクセル1ビットに詰めたマスクを設定
+/// </summary>
+/// <param name="pBits">各バイトの下位ビットから左のピクセル。各行はバイト境界まで詰める。下の行から</param>
+/// <param name="width">マスクの幅 [px]</param>
+/// <param name="height">マスクの高さ [px]</param>
+/// <returns>成功すれば true</returns>
+BOOL UNIWINC_API SetHitTestMaskBits(const BYTE* pBits, const INT32 width, const INT32 height) {
+	return pContext_->hitTestMask.setBits(pBits, width, height);
+}
+
+/// <summary>
+/// マスクを消去。以降はウィンドウ全体が不透明として扱われる
+/// </summary>
+void UNIWINC_API ClearHitTestMask() {
+	pContext_->hitTestMask.clear();
+}
+
+/// <summary>
+/// マスクによるヒットテストを有効化／無効化
+///   有効な間はカーソル位置のマスクに従ってクリックスルーが切り替わる
+/// </summary>
+/// <param name="bEnabled"></param>
+void UNIWINC_API EnableHitTestMask(const BOOL bEnabled) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { EnableHitTestMask(bEnabled); });
+		return;
+	}
+
+	if (bEnabled == pContext_->bIsHitTestMaskEnabled) return;
+
+	pContext_->bIsHitTestMaskEnabled = bEnabled;
+	updateHitTestMode();
+}
+
+/// <summary>
+/// マスクによるヒットテストが有効ならば true
+/// </summary>
+/// <returns></returns>
+BOOL UNIWINC_API IsHitTestMaskEnabled() {
+	return pContext_->bIsHitTestMaskEnabled;
+}
+
+/// <summary>
+/// マスクの不透明部分をウィンドウの入力領域とするか設定
+///   有効な間はOSがヒットテストを行い、カーソルへの追従は不要になる
+///   Windowsではウィンドウリージョンを使うため、領域外は描画もされない
+/// </summary>
+/// <param name="bEnabled"></param>
+void UNIWINC_API EnableInputRegion(const BOOL bEnabled) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { EnableInputRegion(bEnabled); });
+		return;
+	}
+
+	if (bEnabled == pContext_->bIsInputRegionEnabled) return;
+
+	pContext_->bIsInputRegionEnabled = bEnabled;
+	updateHitTestMode();
+}
+
+/// <summary>
+/// マスクから入力領域を設定していれば true
+/// </summary>
+/// <returns></returns>
+BOOL UNIWINC_API IsInputRegionEnabled() {
+	return pContext_->bIsInputRegionEnabled;
+}
+
+#pragma endregion For hit test mask
+
+
+// ========================================================================
+#pragma region For file dropping and window procedure
+
+/// <summary>
+/// Start reading the metadata of the paths taken so far
+/// </summary>
+void requestDropFileInfo() {
+	if (!bIsDropFileInfoEnabled_) return;
+
+	dropFileInfoPool_.request(dropArena_.getDropId(), dropArena_.getCount(), dropArena_.getTotalCount());
+}
+
+/// <summary>
+/// Queue DropInfoReady if more metadata has been read since the last call
+/// </summary>
+void notifyDropFileInfo() {
+	if (!bIsDropFileInfoEnabled_) return;
+
+	UINT32 dropId = 0;
+	UINT32 ready = dropFileInfoPool_.getReadyCount(&dropId);
+	if (dropId == nDropFileInfoDropId_ && ready == nDropFileInfoNotified_) return;
+
+	nDropFileInfoDropId_ = dropId;
+	nDropFileInfoNotified_ = ready;
+	if (ready > 0) {
+		queueEvent(EventType::DropInfoReady, (INT32)ready);
+	}
+}
+
+/// <summary>
+/// Queue DropExpandChunk while the dropped folders are walked, and DropExpanded when finished
+/// </summary>
+void notifyDropExpansion() {
+	if (!bIsDropExpansionEnabled_) return;
+
+	UINT32 dropId = 0;
+	const BOOL bRunning = directoryWalker_.isRunning(&dropId);
+	if (dropId == 0) return;
+
+	const UINT32 count = expandedArena_.getCount();
+	if (!bRunning) {
+		if (dropId != nDropExpandedDropId_) {
+			nDropExpandedDropId_ = dropId;
+			queueEvent(EventType::DropExpanded, (INT32)count);
+		}
+		return;
+	}
+
+	if (dropId != nDropExpansionDropId_) {
+		nDropExpansionDropId_ = dropId;
+		nDropExpansionNotified_ = 0;
+	}
+	if (count != nDropExpansionNotified_) {
+		nDropExpansionNotified_ = count;
+		queueEvent(EventType::DropExpandChunk, (INT32)count);
+	}
+}
+
+/// <summary>
+/// Queue PanelCompleted for the asynchronous file panels which have closed
+///   The requests are kept until released, so they are taken even if the event queue is disabled.
+/// </summary>
+void notifyPanelRequests() {
+	UINT32 ids[16];
+	UINT32 count;
+	while ((count = panelWorker_.takeCompleted(ids, 16)) > 0) {
+		for (UINT32 i = 0; i < count; i++) {
+			queueEvent(EventType::PanelCompleted, (INT32)ids[i]);
+		}
+	}
+}
+
+/// <summary>
+/// Join the paths taken since the last call for the callbacks of the current context
+///   Called after each step of a streaming drop, so the end of the stream does not join all the paths at once.
+/// </summary>
+void joinDroppedPaths() {
+	if (pContext_->hDropFilesHandler != nullptr) {
+		nDroppedPathsJoined_ = dropArena_.appendJoined(nDroppedPathsJoined_, droppedPathsJoined_, L'\n');
+	}
+	if (pContext_->hDropFilesUtf8Handler != nullptr) {
+		nDroppedPathsJoinedUtf8_ = dropArena_.appendJoinedUtf8(nDroppedPathsJoinedUtf8_, droppedPathsJoinedUtf8_, '\n');
+	}
+}
+
+/// <summary>
+/// Forget the joined paths of the previous drop. The buffers are kept for the next
+/// </summary>
+void clearDroppedPaths() {
+	droppedPathsJoined_.clear();
+	droppedPathsJoinedUtf8_.clear();
+	nDroppedPathsJoined_ = 0;
+	nDroppedPathsJoinedUtf8_ = 0;
+}
+
+/// <summary>
+/// Notify the paths in the drop arena by the callback and the event
+/// </summary>
+void notifyFilesDropped() {
+	UINT32 num = dropArena_.getCount();
+	requestDropFileInfo();
+	if (bIsDropExpansionEnabled_) {
+		directoryWalker_.start(dropArena_);
+	}
+
+	// TODO: Windowsでは特殊文字がファイル名に入る例はまず無さそうだが、macOSと同様にダブルクォーテーション囲みにした方がよい
+	//		CSVと同様にダブルクォーテーションが文字としてあれば二重にする
+	// Do callback function with the paths joined by LF
+	joinDroppedPaths();
+	if (pContext_->hDropFilesHandler != nullptr) {
+		droppedPathsJoined_.push_back(0);
+		pContext_->hDropFilesHandler(droppedPathsJoined_.data());	// Charset of this project must be set U
+	}
+	if (pContext_->hDropFilesUtf8Handler != nullptr) {
+		pContext_->hDropFilesUtf8Handler(droppedPathsJoinedUtf8_.c_str(), (INT32)droppedPathsJoinedUtf8_.size());
+	}
+	clearDroppedPaths();
+	queueEvent(EventType::FilesDropped, (INT32)num);
+}
+
+/// <summary>
+/// Process drop files
+///   Not called while a drop is streamed, since disabling the streaming finishes the streams.
+/// </summary>
+/// <param name="hDrop"></param>
+/// <returns></returns>
+BOOL receiveDropFiles(HDROP hDrop) {
+	clearDroppedPaths();
+	UINT32 num = dropArena_.collect(pBackend_, hDrop);
+	if (num > 0) {
+		notifyFilesDropped();
+	}
+
+	return (num > 0);
+}
+
+/// <summary>
+/// Start streaming the queued drops in order, unless a drop is being streamed
+///   Each drop is reported to the context of the window which received it.
+/// </summary>
+void beginDropStream() {
+	while (!pendingDrops_.empty() && !dropArena_.isStreaming()) {
+		const PendingDrop drop = pendingDrops_.front();
+		pendingDrops_.pop_front();
+
+		hDropContext_ = drop.hContext;
+		ContextScope scope(contexts_.get(hDropContext_) != nullptr ? hDropContext_ : hDefaultContext_);
+		clearDroppedPaths();
+		UINT32 num = dropArena_.beginStream(pBackend_, drop.hDrop);
+		if (num > 0) {
+			queueEvent(EventType::DropBegin, (INT32)num);
+		}
+	}
+}
+
+/// <summary>
+/// Keep the dropped files to take the paths by PollEvents() within the budget
+///   A drop during the stream of another waits for it to end, instead of taking the rest of it at once.
+///   HDROP is released when all paths have been taken.
+/// </summary>
+/// <param name="hDrop"></param>
+/// <param name="hContext">Context of the window which received the drop</param>
+void queueDropStream(HDROP hDrop, const UINT32 hContext) {
+	pendingDrops_.push_back({ hDrop, hContext });
+	beginDropStream();
+}
+
+/// <summary>
+/// Take the paths of the streaming drop within the budget
+///   Called in the context of the drop. The next queued drop starts when the stream ends.
+/// </summary>
+void continueDropStream() {
+	BOOL bFinished = FALSE;
+	UINT32 count = dropArena_.continueStream(nDropStreamBudget_, &bFinished);
+
+	if (bFinished) {
+		notifyFilesDropped();
+		beginDropStream();
+	}
+	else if (count > 0) {
+		joinDroppedPaths();
+		requestDropFileInfo();
+		queueEvent(EventType::DropChunk, (INT32)dropArena_.getCount());
+	}
+}
+
+/// <summary>
+/// Take the rest of the streaming drop and the queued drops at once
+/// </summary>
+void finishDropStreams() {
+	if (dropArena_.finishStream()) {
+		ContextScope scope(contexts_.get(hDropContext_) != nullptr ? hDropContext_ : hDefaultContext_);
+		notifyFilesDropped();
+	}
+
+	while (!pendingDrops_.empty()) {
+		const PendingDrop drop = pendingDrops_.front();
+		pendingDrops_.pop_front();
+
+		hDropContext_ = drop.hContext;
+		ContextScope scope(contexts_.get(hDropContext_) != nullptr ? hDropContext_ : hDefaultContext_);
+		receiveDropFiles(drop.hDrop);
+		pBackend_->dragFinish(drop.hDrop);
+	}
+}
+
+/// <summary>
+/// Custom window proceture to accept dropped files and display-changed event
+/// </summary>
+/// <param name="hWnd"></param>
+/// <param name="uMsg"></param>
+/// <param name="wParam"></param>
+/// <param name="lParam"></param>
+/// <returns></returns>
+LRESULT CALLBACK customWindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	// ウィンドウのコンテキストで処理する
+	WindowContext* pContext = contexts_.findByWindow(hWnd);
+	if (pContext == nullptr) {
+		return pBackend_->defWindowProc(hWnd, uMsg, wParam, lParam);
+	}
+	ContextScope scope(pContext);
+
+	// 他のスレッドから頼まれた変更を反映する。このライブラリが送ったメッセージなので、元のプロシージャには渡さない
+	const UINT invokeMessage = nInvokeMessage_.load(std::memory_order_relaxed);
+	if (invokeMessage != 0 && uMsg == invokeMessage) {
+		runInvokedFunctions();
+		return 0;
+	}
+
+	HDROP hDrop;
+	LRESULT result;
+
+	switch (uMsg)
+	{
+	case WM_DROPFILES:
+		hDrop = (HDROP)wParam;
+		if (bIsDropStreamingEnabled_) {
+			// パスは PollEvents() で少しずつ取り出す。HDROP はその後で解放される
+			queueDropStream(hDrop, contexts_.getHandle(pContext));
+		}
+		else {
+			hDropContext_ = contexts_.getHandle(pContext);
+			receiveDropFiles(hDrop);
+			pBackend_->dragFinish(hDrop);
+		}
+		break;
+
+	case WM_DISPLAYCHANGE:
+		updateScreenSize();
+
+		// Run callback
+		notifyMonitorChanged();
+		break;
+
+	case WM_NCHITTEST:
+		// マスク上で透明な位置ならば背後へ通す（同一スレッドのウィンドウ向け。他プロセスへはタイマーで対応）
+		if (pContext_->bIsHitTestMaskEnabled && !pContext_->bIsClickThrough && !hitTestMaskAt(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam))) {
+			return HTTRANSPARENT;
+		}
+		break;
+
+	case WM_TIMER:
+		if (wParam == HITTEST_TIMER_ID) {
+			updateHitTestMask();
+			return 0;
+		}
+		if (wParam == TWEEN_TIMER_ID) {
+			stepWindowTweens();
+			return 0;
+		}
+		if (wParam == DRAGMOVE_TIMER_ID) {
+			// ウィンドウ外でボタンが離されると WM_LBUTTONUP は来ないため、ここでも確認する
+			if (pContext_->bIsDragEndOnRelease && !pBackend_->isPrimaryButtonDown()) {
+				endDragMove(TRUE);
+			}
+			else {
+				stepDragMove();
+			}
+			return 0;
+		}
+		break;
+
+	case WM_MOUSEMOVE:
+		// ドラッグ中は入力の度に追従させる
+		if (pContext_->dragMover.isDragging()) {
+			stepDragMove();
+		}
+		break;
+
+	case WM_LBUTTONUP:
+		if (pContext_->dragMover.isDragging() && pContext_->bIsDragEndOnRelease) {
+			stepDragMove();
+			endDragMove(TRUE);
+		}
+		break;
+
+	case WM_WINDOWPOSCHANGING:
+		// 常に最背面
+		if (pContext_->bIsBottommost) {
+			((WINDOWPOS*)lParam)->hwndInsertAfter = HWND_BOTTOM;
+		}
+		break;
+
+	case WM_WINDOWPOSCHANGED:
+		// 他のスレッドから読む位置、サイズを更新
+		publishWindowPos((const WINDOWPOS*)lParam);
+		break;
+
+	case WM_STYLECHANGED:	// スタイルの変化を検出
+		// Run callback
+		notifyWindowStateChanged(WindowStateEventType::StyleChanged);
+		break;
+
+	case WM_SIZE:		// 最大化、最小化による変化を検出
+		// クライアント領域サイズが変わるたびに、Unityはスワップチェーンを作り直す
+		pContext_->refreshStats.nResizeEvents++;
+		if (wParam != SIZE_MINIMIZED && (LOWORD(lParam) != pContext_->szLastClient.cx || HIWORD(lParam) != pContext_->szLastClient.cy)) {
+			pContext_->szLastClient.cx = LOWORD(lParam);
+			pContext_->szLastClient.cy = HIWORD(lParam);
+			pContext_->refreshStats.nSwapchainRebuilds++;
+		}
+
+		// 他のスレッドから読むサイズと最大化、最小化の状態を更新
+		if (wParam == SIZE_RESTORED || wParam == SIZE_MAXIMIZED || wParam == SIZE_MINIMIZED) {
+			publishWindowSize(wParam, lParam);
+		}
+
+		// 入力領域はクライアント領域に合わせて作り直す
+		updateInputRegion();
+
+		// 最大化、最小化されたらドラッグと位置、サイズのアニメーションは終える
+		if (wParam == SIZE_MAXIMIZED || wParam == SIZE_MINIMIZED) {
+			endDragMove(FALSE);
+			cancelWindowTweens((DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Size);
+		}
+
+		switch (wParam)
+		{
+		case SIZE_RESTORED:		// 最小化でも最大化でもない通常のリサイズ
+		case SIZE_MAXIMIZED:
+		case SIZE_MINIMIZED:
+			// Run callback
+			notifyWindowStateChanged(WindowStateEventType::Resized);
+			break;
+		}
+		break;
+
+	case WM_NCDESTROY:
+		// ウィンドウが破棄されるので、タイマーで続けている処理は終える
+		stopHitTestMask();
+		endDragMove(FALSE);
+		cancelWindowTweens((DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Size | (DWORD)WindowTweenFlag::Alpha);
+		break;
+		
+	default:
+		break;
+	}
+
+	if (pContext_->lpOriginalWndProc != NULL) {
+		result = pBackend_->callWindowProc(pContext_->lpOriginalWndProc, hWnd, uMsg, wParam, lParam);
+	}
+	else {
+		result = pBackend_->defWindowProc(hWnd, uMsg, wParam, lParam);
+	}
+
+	if (uMsg == WM_NCDESTROY) {
+		// 破棄されたウィンドウのハンドルは再利用されうるので、コンテキストから外しておく
+		pContext_->lpOriginalWndProc = NULL;
+		pContext_->lpMyWndProc = NULL;
+		HWND hDestroyed = hWnd;
+		hInvokeWnd_.compare_exchange_strong(hDestroyed, NULL);
+		hDestroyed = hWnd;
+		hMyOwnerWnd_.compare_exchange_strong(hDestroyed, NULL);
+		pContext_->hTargetWnd = NULL;
+		contexts_.bindWindow(contexts_.getHandle(pContext_), NULL);
+		publishWindowGeometry();
+	}
+	return result;
+}
+
+/// <summary>
+/// Remove the custom window procedure
+/// </summary>
+void destroyCustomWindowProcedure() {
+	if (pContext_->lpMyWndProc == NULL) return;
+
+	if (pContext_->lpOriginalWndProc != NULL) {
+		if (pContext_->hTargetWnd != NULL && pBackend_->isWindow(pContext_->hTargetWnd)) {
+			pBackend_->setWindowProcedure(pContext_->hTargetWnd, pContext_->lpOriginalWndProc);
+		}
+		pContext_->lpOriginalWndProc = NULL;
+	}
+	pContext_->lpMyWndProc = NULL;
+}
+
+/// <summary>
+/// Create and attach the custom window procedure
+/// </summary>
+void createCustomWindowProcedure() {
+	if (pContext_->lpMyWndProc != NULL) {
+		destroyCustomWindowProcedure();
+	}
+
+	if (pContext_->hTargetWnd != NULL) {
+		// 以降のWM_SIZEでサイズが変わったか判断するため、現在のサイズを記憶
+		RECT rcCli;
+		pBackend_->getClientRect(pContext_->hTargetWnd, &rcCli);
+		pContext_->szLastClient.cx = rcCli.right - rcCli.left;
+		pContext_->szLastClient.cy = rcCli.bottom - rcCli.top;
+
+		pContext_->lpMyWndProc = customWindowProcedure;
+		pContext_->lpOriginalWndProc = pBackend_->setWindowProcedure(pContext_->hTargetWnd, pContext_->lpMyWndProc);
+	}
+}
+
+
+// ↓ウィンドウプロシージャではなくメッセージをフックする場合はこちらを使う
+//    解像度変更を検出するためにウィンドウプロシージャを使うものとした
 
 ///// <summary>
 ///// Callback when received WM_DROPFILE message
@@ -1429,7 +2770,7 @@ void createCustomWindowProcedure() {
 //
 //	switch (msg->message) {
 //	case WM_DROPFILES:
-//		if (hTargetWnd_ != NULL && msg->hwnd == hTargetWnd_) {
+//		if (pContext_->hTargetWnd != NULL && msg->hwnd == pContext_->hTargetWnd) {
 //			HDROP hDrop = (HDROP)msg->wParam;
 //			ReceiveDropFiles(hDrop);
 //			DragFinish(hDrop);
@@ -1452,7 +2793,7 @@ void createCustomWindowProcedure() {
 ///// Set the hook
 ///// </summary>
 //void beginHook() {
-//	if (hTargetWnd_ == NULL) return;
+//	if (pContext_->hTargetWnd == NULL) return;
 //
 //	// Return if the hook is already set
 //	if (hHook_ != NULL) return;
@@ -1467,7 +2808,7 @@ void createCustomWindowProcedure() {
 ///// Unset the hook
 ///// </summary>
 //void endHook() {
-//	if (hTargetWnd_ == NULL) return;
+//	if (pContext_->hTargetWnd == NULL) return;
 //
 //	// Return if the hook is not set
 //	if (hHook_ == NULL) return;
@@ -1478,437 +2819,1204 @@ void createCustomWindowProcedure() {
 
 
 /// <summary>
-/// Enable or disable file dropping
+/// Enable or disable file dropping
+/// </summary>
+/// <returns>Previous window procedure</returns>
+BOOL UNIWINC_API SetAllowDrop(const BOOL bEnabled)
+{
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { SetAllowDrop(bEnabled); });
+	}
+
+	if (pContext_->hTargetWnd == NULL) return FALSE;
+
+	pContext_->bAllowDropFile = bEnabled;
+	pBackend_->dragAcceptFiles(pContext_->hTargetWnd, pContext_->bAllowDropFile);
+
+	//if (bEnabled && hHook == NULL) {
+	//	beginHook();
+	//}
+	////else if (!bEnabled && hHook != NULL) {
+	////	endHook();
+	////}
+
+	return TRUE;
+}
+
+/// <summary>
+/// Register the callback fucnction for dropping files
+/// </summary>
+/// <param name="callback"></param>
+/// <returns></returns>
+BOOL UNIWINC_API RegisterDropFilesCallback(FilesCallback callback) {
+	if (callback == nullptr) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { RegisterDropFilesCallback(callback); });
+	}
+
+	pContext_->hDropFilesHandler = callback;
+	return TRUE;
+}
+
+/// <summary>
+/// Unregister the callback function
+/// </summary>
+/// <returns></returns>
+BOOL UNIWINC_API UnregisterDropFilesCallback() {
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([]() { UnregisterDropFilesCallback(); });
+	}
+
+	pContext_->hDropFilesHandler = nullptr;
+	return TRUE;
+}
+
+/// <summary>
+/// Register the callback function which receives the dropped paths in UTF-8
+///   Called after the UTF-16 one if both are registered.
+/// </summary>
+BOOL UNIWINC_API RegisterDropFilesCallbackUtf8(FilesCallbackUtf8 callback) {
+	if (callback == nullptr) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { RegisterDropFilesCallbackUtf8(callback); });
+	}
+
+	pContext_->hDropFilesUtf8Handler = callback;
+	return TRUE;
+}
+
+BOOL UNIWINC_API UnregisterDropFilesCallbackUtf8() {
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([]() { UnregisterDropFilesCallbackUtf8(); });
+	}
+
+	pContext_->hDropFilesUtf8Handler = nullptr;
+	return TRUE;
+}
+
+/// <summary>
+/// Take the paths of a drop by PollEvents() within the time budget, instead of all at once in the window procedure
+///   DropBegin, DropChunk and FilesDropped events are queued. The paths taken so far can be read by GetDropFiles().
+///   PollEvents() must be called every frame while enabled.
+/// </summary>
+/// <param name="bEnabled">Disabling takes the rest of the current drop and the drops waiting for it at once</param>
+/// <param name="nBudget">Time budget per PollEvents() [us]. Default if 0 or less</param>
+void UNIWINC_API EnableDropStreaming(const BOOL bEnabled, const INT32 nBudget) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { EnableDropStreaming(bEnabled, nBudget); });
+		return;
+	}
+
+	nDropStreamBudget_ = (nBudget > 0 ? nBudget : UNIWINC_DROP_STREAM_BUDGET);
+	bIsDropStreamingEnabled_ = bEnabled;
+
+	if (!bEnabled) {
+		finishDropStreams();
+	}
+}
+
+/// <summary>
+/// Get the paths of the last drop into the caller's buffers
+///   Unlike the callback, paths are not joined, so they may contain any character.
+///   Call repeatedly with nFirstIndex += nCount until nFirstIndex reaches nTotalCount to read a large drop by pages.
+/// </summary>
+/// <param name="nFirstIndex">Index of the first path to get</param>
+/// <param name="pOffsets">nMaxCount + 1 elements. Path i is pData[pOffsets[i]] to pData[pOffsets[i + 1] - 1]</param>
+/// <param name="nMaxCount">Maximum number of the paths to get</param>
+/// <param name="pData">Buffer to receive the UTF-16 paths without terminators</param>
+/// <param name="nDataCapacity">Number of the WCHARs of pData</param>
+/// <param name="pPage">nStructSize を設定しておくこと</param>
+/// <returns>Number of the paths written, or -1 if the arguments are invalid</returns>
+INT32 UNIWINC_API GetDropFiles(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, LPWSTR pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage) {
+	if (pPage == nullptr || pPage->nStructSize < (INT32)sizeof(INT32)) return -1;
+
+	DROPFILESPAGE page = DROPFILESPAGE();
+	UINT32 count = dropArena_.getPage(nFirstIndex, pOffsets, nMaxCount, pData, nDataCapacity, &page);
+
+	// 呼び出し側の構造体の方が小さければ、入る分だけ返す
+	INT32 size = pPage->nStructSize;
+	page.nStructSize = (size < (INT32)sizeof(DROPFILESPAGE) ? size : (INT32)sizeof(DROPFILESPAGE));
+	memcpy(pPage, &page, page.nStructSize);
+	return (INT32)count;
+}
+
+/// <summary>
+/// Get the paths of the last drop in UTF-8, in the same way as GetDropFiles()
+///   Offsets, nDataCapacity, nDataLength and nNextLength are in bytes. Each path is converted once directly into pData.
+/// </summary>
+/// <returns>Number of the paths written, or -1 if the arguments are invalid</returns>
+INT32 UNIWINC_API GetDropFilesUtf8(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, char* pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage) {
+	if (pPage == nullptr || pPage->nStructSize < (INT32)sizeof(INT32)) return -1;
+
+	DROPFILESPAGE page = DROPFILESPAGE();
+	UINT32 count = dropArena_.getPageUtf8(nFirstIndex, pOffsets, nMaxCount, pData, nDataCapacity, &page);
+
+	INT32 size = pPage->nStructSize;
+	page.nStructSize = (size < (INT32)sizeof(DROPFILESPAGE) ? size : (INT32)sizeof(DROPFILESPAGE));
+	memcpy(pPage, &page, page.nStructSize);
+	return (INT32)count;
+}
+
+/// <summary>
+/// Read the size, the modification time and the type of each dropped file on worker threads
+///   The results can be read by GetDropFileInfo() in the order of the drop, and DropInfoReady events are queued.
+/// </summary>
+/// <param name="bEnabled">Disabling cancels the files not read yet and stops the threads</param>
+/// <param name="nThreads">Maximum number of the threads. Default if 0 or less</param>
+void UNIWINC_API EnableDropFileInfo(const BOOL bEnabled, const INT32 nThreads) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { EnableDropFileInfo(bEnabled, nThreads); });
+		return;
+	}
+
+	dropFileInfoPool_.setMaxThreads(nThreads > 0 ? (UINT32)nThreads : UNIWINC_DROP_INFO_THREADS);
+	bIsDropFileInfoEnabled_ = bEnabled;
+
+	if (bEnabled) {
+		// 既にドロップされていた分も調べる
+		requestDropFileInfo();
+	}
+	else {
+		dropFileInfoPool_.stop();
+	}
+}
+
+/// <summary>
+/// Stop reading the metadata of the current drop
+///   Results already read can still be taken by GetDropFileInfo(). The next drop is read as usual.
+/// </summary>
+void UNIWINC_API CancelDropFileInfo() {
+	dropFileInfoPool_.cancel();
+}
+
+/// <summary>
+/// Get the metadata of the dropped files in the order of the drop
+///   Only the files whose metadata has been read are returned. pPage->nAvailableCount is the number of them.
+/// </summary>
+/// <param name="nFirstIndex">Index of the first file to get</param>
+/// <param name="pInfos">Buffer to receive the metadata</param>
+/// <param name="nMaxCount">Number of the elements of pInfos</param>
+/// <param name="pPage">nStructSize を設定しておくこと。nDataLength と nNextLength は 0</param>
+/// <returns>Number of the elements written, or -1 if the arguments are invalid</returns>
+INT32 UNIWINC_API GetDropFileInfo(const UINT32 nFirstIndex, PDROPFILEINFO pInfos, const UINT32 nMaxCount, PDROPFILESPAGE pPage) {
+	if (pPage == nullptr || pPage->nStructSize < (INT32)sizeof(INT32)) return -1;
+
+	DROPFILESPAGE page = DROPFILESPAGE();
+	UINT32 count = dropFileInfoPool_.getPage(nFirstIndex, pInfos, nMaxCount, &page);
+
+	// 呼び出し側の構造体の方が小さければ、入る分だけ返す
+	INT32 size = pPage->nStructSize;
+	page.nStructSize = (size < (INT32)sizeof(DROPFILESPAGE) ? size : (INT32)sizeof(DROPFILESPAGE));
+	memcpy(pPage, &page, page.nStructSize);
+	return (INT32)count;
+}
+
+/// <summary>
+/// Configure the walk of the dropped folders. Called on the window thread
+/// </summary>
+void enableDropExpansion(const BOOL bEnabled, const std::shared_ptr<const PanelFilter>& filter, const INT32 nMaxDepth, const INT32 nThreads) {
+	bIsDropExpansionEnabled_ = bEnabled;
+
+	directoryWalker_.configure(filter, nMaxDepth, (nThreads > 0 ? (UINT32)nThreads : UNIWINC_DROP_INFO_THREADS));
+}
+
+/// <summary>
+/// List the files in the dropped folders recursively on worker threads
+///   The paths can be read by GetExpandedFiles() while walking. DropExpandChunk and DropExpanded events are queued.
+///   Dropped files are listed as they are if they match the filter.
+/// </summary>
+/// <param name="bEnabled">Disabling cancels the walk in progress</param>
+/// <param name="lpszFilter">Same as the filter of the file panels, e.g. "Image\tpng\tjpg\n". NULL for all files</param>
+/// <param name="nMaxDepth">Files deeper than this are not listed. Default if 0 or less</param>
+/// <param name="nThreads">Maximum number of the threads. Default if 0 or less</param>
+void UNIWINC_API EnableDropExpansion(const BOOL bEnabled, const LPWSTR lpszFilter, const INT32 nMaxDepth, const INT32 nThreads) {
+	// 呼び出し側のバッファは戻ったら使えないので、フィルタはここで作っておく
+	std::shared_ptr<const PanelFilter> filter = PanelFilter::compile(lpszFilter);
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { enableDropExpansion(bEnabled, filter, nMaxDepth, nThreads); });
+		return;
+	}
+	enableDropExpansion(bEnabled, filter, nMaxDepth, nThreads);
+}
+
+/// <summary>
+/// Same as EnableDropExpansion() with the filter in UTF-8
+/// </summary>
+/// <param name="lpszFilter">NULL for all files</param>
+/// <param name="nFilterLength">Bytes of the filter</param>
+void UNIWINC_API EnableDropExpansionUtf8(const BOOL bEnabled, const char* lpszFilter, const UINT32 nFilterLength, const INT32 nMaxDepth, const INT32 nThreads) {
+	std::vector<WCHAR> filter;
+	EnableDropExpansion(bEnabled, toUtf16String(lpszFilter, nFilterLength, filter), nMaxDepth, nThreads);
+}
+
+/// <summary>
+/// Stop walking the dropped folders without waiting for the worker threads. May be called on any thread
+///   Paths already found can still be read by GetExpandedFiles(), and DropExpanded is queued.
+/// </summary>
+void UNIWINC_API CancelDropExpansion() {
+	directoryWalker_.cancel();
+}
+
+/// <summary>
+/// Get the paths found in the dropped folders, in the same way as GetDropFiles()
+///   pPage->nDropId is the ID of the drop the paths came from.
+///   While walking, nTotalCount and nAvailableCount are the number found so far.
+/// </summary>
+/// <returns>Number of the paths written, or -1 if the arguments are invalid</returns>
+INT32 UNIWINC_API GetExpandedFiles(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, LPWSTR pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage) {
+	if (pPage == nullptr || pPage->nStructSize < (INT32)sizeof(INT32)) return -1;
+
+	DROPFILESPAGE page = DROPFILESPAGE();
+	UINT32 count = expandedArena_.getPage(nFirstIndex, pOffsets, nMaxCount, pData, nDataCapacity, &page);
+
+	// 呼び出し側の構造体の方が小さければ、入る分だけ返す
+	INT32 size = pPage->nStructSize;
+	page.nStructSize = (size < (INT32)sizeof(DROPFILESPAGE) ? size : (INT32)sizeof(DROPFILESPAGE));
+	memcpy(pPage, &page, page.nStructSize);
+	return (INT32)count;
+}
+
+/// <summary>
+/// Get the paths found in the dropped folders in UTF-8, in the same way as GetDropFilesUtf8()
+/// </summary>
+/// <returns>Number of the paths written, or -1 if the arguments are invalid</returns>
+INT32 UNIWINC_API GetExpandedFilesUtf8(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, char* pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage) {
+	if (pPage == nullptr || pPage->nStructSize < (INT32)sizeof(INT32)) return -1;
+
+	DROPFILESPAGE page = DROPFILESPAGE();
+	UINT32 count = expandedArena_.getPageUtf8(nFirstIndex, pOffsets, nMaxCount, pData, nDataCapacity, &page);
+
+	INT32 size = pPage->nStructSize;
+	page.nStructSize = (size < (INT32)sizeof(DROPFILESPAGE) ? size : (INT32)sizeof(DROPFILESPAGE));
+	memcpy(pPage, &page, page.nStructSize);
+	return (INT32)count;
+}
+
+/// <summary>
+/// Queue the events to be taken by PollEvents()
+///   Callbacks are called regardless of this.
+/// </summary>
+/// <param name="bEnabled"></param>
+void UNIWINC_API EnableEventQueue(const BOOL bEnabled) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { EnableEventQueue(bEnabled); });
+		return;
+	}
+
+	if (pContext_->bIsEventQueueEnabled && !bEnabled) {
+		pContext_->eventQueue.clear();
+		pContext_->eventCoalescer.clear();
+	}
+	pContext_->bIsEventQueueEnabled = bEnabled;
+}
+
+/// <summary>
+/// Take the queued events at once
+///   Called once per frame instead of receiving each callback.
+///   Resized, StyleChanged and MonitorChanged are coalesced: at most one of each per call, with the latest geometry.
+/// </summary>
+/// <param name="pEvents">Buffer to receive the events in the order they occurred</param>
+/// <param name="nMaxCount">Number of the elements of the buffer</param>
+/// <returns>Number of the events received</returns>
+INT32 UNIWINC_API PollEvents(PUNIWINCEVENT pEvents, const INT32 nMaxCount) {
+	if (pEvents == nullptr || nMaxCount <= 0 || !isWindowThread()) return 0;
+
+	// 他のスレッドから頼まれた変更を先に反映し、そのイベントも返す
+	runInvokedFunctions();
+
+	// ドロップはどのコンテキストからも進め、受けたウィンドウのコンテキストへ通知する
+	{
+		ContextScope scope(contexts_.get(hDropContext_) != nullptr ? hDropContext_ : hDefaultContext_);
+
+		// ストリーミング中のドロップがあれば、予算内でパスを取り出す
+		continueDropStream();
+		notifyDropFileInfo();
+		notifyDropExpansion();
+	}
+
+	// ファイルパネルはコンテキストによらないため、既定のコンテキストへ通知する
+	{
+		ContextScope scope(hDefaultContext_);
+		notifyPanelRequests();
+	}
+
+	return (INT32)pContext_->eventCoalescer.poll(pContext_->eventQueue, pEvents, (UINT32)nMaxCount);
+}
+
+/// <summary>
+/// Set the minimum interval between the coalesced events returned by PollEvents()
+///   The last event of a burst is returned after the interval. 0 (default) means once per PollEvents().
+/// </summary>
+/// <param name="nType">EventType</param>
+/// <param name="nParam">WindowStateEventType if nType is WindowStateChanged</param>
+/// <param name="nMilliseconds">Minimum interval [ms]</param>
+/// <returns>FALSE if the event is not coalesced</returns>
+BOOL UNIWINC_API SetEventInterval(const INT32 nType, const INT32 nParam, const INT32 nMilliseconds) {
+	if (nMilliseconds < 0) return FALSE;
+	if (!isWindowThread()) {
+		return invokeOnWindowThread([=]() { SetEventInterval(nType, nParam, nMilliseconds); });
+	}
+
+	return pContext_->eventCoalescer.setInterval(nType, nParam, (UINT32)nMilliseconds);
+}
+
+/// <summary>
+/// Get the counts of the events received and delivered
+///   The counts are updated by PollEvents(), so they are read only on the window thread.
+/// </summary>
+/// <param name="pStats">nStructSize を設定しておくこと</param>
+/// <returns>成功すればTRUE。ウィンドウスレッド以外ではFALSE</returns>
+BOOL UNIWINC_API GetEventStats(PEVENTSTATS pStats) {
+	if (pStats == nullptr || pStats->nStructSize < (INT32)sizeof(INT32)) return FALSE;
+	if (!isWindowThread()) return FALSE;
+
+	EVENTSTATS stats;
+	stats.nReceived = (UINT32)pContext_->eventCoalescer.getReceivedCount();
+	stats.nDelivered = (UINT32)pContext_->eventCoalescer.getDeliveredCount();
+	stats.nDropped = (UINT32)pContext_->eventCoalescer.getDroppedCount();
+	stats.nResizedReceived = (UINT32)pContext_->eventCoalescer.getReceivedCount(EventCoalescer::SLOT_RESIZED);
+	stats.nResizedDelivered = (UINT32)pContext_->eventCoalescer.getDeliveredCount(EventCoalescer::SLOT_RESIZED);
+
+	// 呼び出し側の構造体の方が小さければ、入る分だけ返す
+	INT32 size = pStats->nStructSize;
+	stats.nStructSize = (size < (INT32)sizeof(EVENTSTATS) ? size : (INT32)sizeof(EVENTSTATS));
+	memcpy(pStats, &stats, stats.nStructSize);
+	return TRUE;
+}
+
+/// <summary>
+/// イベントの数を0に戻す
+/// </summary>
+void UNIWINC_API ResetEventStats() {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { ResetEventStats(); });
+		return;
+	}
+
+	pContext_->eventCoalescer.resetCounts();
+}
+
+#pragma endregion For file dropping and window procedure
+
+
+// ========================================================================
+#pragma region File dialogs
+
+DWORD GetPanelFlags(const INT32 flags) {
+	DWORD result = OFN_EXPLORER | OFN_NOCHANGEDIR;	// Default
+
+	if ((flags & (INT32)PanelFlag::AllowMultiSelect) > 0) result |= OFN_ALLOWMULTISELECT;
+	if ((flags & (INT32)PanelFlag::FileMustExist) > 0) result |= OFN_FILEMUSTEXIST;
+	if ((flags & (INT32)PanelFlag::FolderMustExist) > 0) result |= OFN_PATHMUSTEXIST;
+	if ((flags & (INT32)PanelFlag::ShowHidden) > 0) result |= OFN_FORCESHOWHIDDEN;
+	if ((flags & (INT32)PanelFlag::OverwritePrompt) > 0) result |= OFN_OVERWRITEPROMPT;
+	if ((flags & (INT32)PanelFlag::CreatePrompt) > 0) result |= OFN_CREATEPROMPT;
+
+	return result;
+}
+
+/// <summary>
+/// Show a file panel and keep the result in panelResults_
+/// </summary>
+/// <returns>Handle of the result, or 0 if cancelled. The reason is kept for GetLastPanelState()</returns>
+UINT32 showFilePanel(const PPANELSETTINGS pSettings, const BOOL bSave) {
+	// 対象のウィンドウやオーナーの探索はウィンドウスレッドの状態なので、他のスレッドからは開かない
+	if (pSettings == nullptr || !bindWindowThread()) return 0;
+
+	// モーダルにするため、ウィンドウハンドル未取得なら探して設定
+	HWND hwnd = pContext_->hTargetWnd;
+	if (hwnd == NULL) {
+		hwnd = FindOwnerWindowHandle();
+	}
+
+	// 同じフィルタは解析済みのものを使う
+	std::shared_ptr<const PanelFilter> pFilter = PanelFilter::compile(pSettings->lpszFilter);
+
+	OPENFILENAMEW ofn;
+	ZeroMemory(&ofn, sizeof(ofn));
+	ofn.lStructSize = sizeof(ofn);
+	ofn.hwndOwner = hwnd;
+	ofn.lpstrTitle = pSettings->lpszTitle;
+	ofn.lpstrFilter = (pFilter ? pFilter->getFilterString() : nullptr);
+	ofn.lpstrInitialDir = pSettings->lpszInitialDir;
+	//ofn.lpstrDefExt = pSettings->lpszDefaultExt;		// Not implemented
+	ofn.lpstrDefExt = (pFilter ? pFilter->getDefaultExt() : nullptr);
+	ofn.Flags = GetPanelFlags(pSettings->nFlags);
+
+	PanelRequestState state;
+	const UINT32 hResult = panelResults_.showPanel(pBackend_, ofn, pSettings->lpszInitialFile, bSave, &state);
+	nLastPanelState_.store((INT32)state);
+	return hResult;
+}
+
+/// <summary>
+/// Show a file panel and copy the result to the caller
+///   The result is kept even if it does not fit, so the caller can retry with GetPanelResult(0).
+/// </summary>
+/// <returns>FALSE if cancelled, the result does not fit or called on another thread than the window thread. The result buffer is left empty then. GetLastPanelState() tells a cancel from too many files</returns>
+BOOL UNIWINC_API OpenFilePanel(const PPANELSETTINGS pSettings, LPWSTR pResultBuffer, const UINT32 nBufferSize) {
+	if ((pResultBuffer == nullptr) || (nBufferSize == 0)) return FALSE;
+	ZeroMemory(pResultBuffer, nBufferSize * sizeof(WCHAR));
+	if (!bindWindowThread()) return FALSE;
+
+	// 他のスレッドが GetPanelResult(0) で読んでいても、解放済みのハンドルは無視される
+	panelResults_.release(hLastPanelResult_.exchange(0));
+	const UINT32 hResult = showFilePanel(pSettings, FALSE);
+	hLastPanelResult_.store(hResult);
+	return panelResults_.copy(hResult, pResultBuffer, nBufferSize);
+}
+
+/// <summary>
+/// Show a save panel and copy the result to the caller
+///   The result is kept even if it does not fit, so the caller can retry with GetPanelResult(0).
+/// </summary>
+/// <returns>FALSE if cancelled, the result does not fit or called on another thread than the window thread. The result buffer is left empty then. GetLastPanelState() tells a cancel from too many files</returns>
+BOOL UNIWINC_API OpenSavePanel(const PPANELSETTINGS pSettings, LPWSTR pResultBuffer, const UINT32 nBufferSize) {
+	if ((pResultBuffer == nullptr) || (nBufferSize == 0)) return FALSE;
+	ZeroMemory(pResultBuffer, nBufferSize * sizeof(WCHAR));
+	if (!bindWindowThread()) return FALSE;
+
+	panelResults_.release(hLastPanelResult_.exchange(0));
+	const UINT32 hResult = showFilePanel(pSettings, TRUE);
+	hLastPanelResult_.store(hResult);
+	return panelResults_.copy(hResult, pResultBuffer, nBufferSize);
+}
+
+/// <summary>
+/// Show a file panel and keep the result in the library, however long it is
+///   Read it by GetPanelResultLength() and GetPanelResult() or MapPanelResult(), then ReleasePanelResult().
+/// </summary>
+/// <returns>Handle of the result, or 0 if cancelled or called on another thread than the window thread. GetLastPanelState() tells a cancel from too many files</returns>
+UINT32 UNIWINC_API OpenFilePanelEx(const PPANELSETTINGS pSettings) {
+	return showFilePanel(pSettings, FALSE);
+}
+
+/// <summary>
+/// Show a save panel and keep the result in the library
+/// </summary>
+/// <returns>Handle of the result, or 0 if cancelled or called on another thread than the window thread. GetLastPanelState() tells a cancel from too many files</returns>
+UINT32 UNIWINC_API OpenSavePanelEx(const PPANELSETTINGS pSettings) {
+	return showFilePanel(pSettings, TRUE);
+}
+
+/// <summary>
+/// Queue a file panel shown on another thread. Returns at once
+///   PanelCompleted is sent by PollEvents() when the panel closes. Release the request after reading the result.
+/// </summary>
+/// <returns>Request ID, or 0 if failed or called on another thread than the window thread</returns>
+UINT32 UNIWINC_API OpenFilePanelAsync(const PPANELSETTINGS pSettings) {
+	// オーナーはウィンドウスレッドの状態から決めるので、依頼もウィンドウスレッドから
+	if (pSettings == nullptr || !bindWindowThread()) return 0;
+
+	HWND hwnd = pContext_->hTargetWnd;
+	if (hwnd == NULL) {
+		hwnd = FindOwnerWindowHandle();
+	}
+	return panelWorker_.request(getBackend(), hwnd, pSettings, GetPanelFlags(pSettings->nFlags), FALSE);
+}
+
+/// <summary>
+/// Queue a save panel shown on another thread. Returns at once
+/// </summary>
+/// <returns>Request ID, or 0 if failed or called on another thread than the window thread</returns>
+UINT32 UNIWINC_API OpenSavePanelAsync(const PPANELSETTINGS pSettings) {
+	if (pSettings == nullptr || !bindWindowThread()) return 0;
+
+	HWND hwnd = pContext_->hTargetWnd;
+	if (hwnd == NULL) {
+		hwnd = FindOwnerWindowHandle();
+	}
+	return panelWorker_.request(getBackend(), hwnd, pSettings, GetPanelFlags(pSettings->nFlags), TRUE);
+}
+
+/// <summary>
+/// Cancel the request. A queued panel is not shown, an open panel is closed
+///   PanelCompleted is sent with the state Cancelled, unless the panel had already closed.
+/// </summary>
+/// <returns>FALSE if the request is unknown or has already completed</returns>
+BOOL UNIWINC_API CancelPanelRequest(const UINT32 nRequestId) {
+	return panelWorker_.cancel(nRequestId);
+}
+
+/// <summary>
+/// State of the request
+/// </summary>
+/// <returns>PanelRequestState. None if unknown or released</returns>
+INT32 UNIWINC_API GetPanelRequestState(const UINT32 nRequestId) {
+	return (INT32)panelWorker_.getState(nRequestId);
+}
+
+/// <summary>
+/// How the last panel opened by OpenFilePanel(), OpenFilePanelEx(), OpenFilePanelUtf8() or their save versions ended
+///   Tells a cancel from TooManyFiles or Failed when they returned nothing.
+/// </summary>
+/// <returns>PanelRequestState. None if no panel has been opened</returns>
+INT32 UNIWINC_API GetLastPanelState() {
+	return nLastPanelState_.load();
+}
+
+/// <summary>
+/// Take the result of the request out as a handle. Release it by ReleasePanelResult()
+/// </summary>
+/// <returns>0 unless the state is Selected, or if already taken</returns>
+UINT32 UNIWINC_API TakePanelRequestResult(const UINT32 nRequestId) {
+	return panelWorker_.takeResult(nRequestId);
+}
+
+/// <summary>
+/// Free the request and its result if not taken. An open panel is closed
+/// </summary>
+void UNIWINC_API ReleasePanelRequest(const UINT32 nRequestId) {
+	panelWorker_.release(nRequestId);
+}
+
+/// <summary>
+/// Length of the result including the terminator. Paths are separated by LF
+/// </summary>
+/// <param name="hResult">Handle of the result, or 0 for the last result of OpenFilePanel() and OpenSavePanel()</param>
+/// <returns>0 if the handle is released</returns>
+UINT32 UNIWINC_API GetPanelResultLength(const UINT32 hResult) {
+	return panelResults_.getLength(hResult != 0 ? hResult : hLastPanelResult_.load());
+}
+
+/// <summary>
+/// Copy the result
+/// </summary>
+/// <param name="hResult">Handle of the result, or 0 for the last result of OpenFilePanel() and OpenSavePanel()</param>
+/// <returns>FALSE if the handle is released or the buffer is too small. The buffer is left empty then</returns>
+BOOL UNIWINC_API GetPanelResult(const UINT32 hResult, LPWSTR pResultBuffer, const UINT32 nBufferSize) {
+	return panelResults_.copy((hResult != 0 ? hResult : hLastPanelResult_.load()), pResultBuffer, nBufferSize);
+}
+
+/// <summary>
+/// Read the result in place without copying
+/// </summary>
+/// <returns>Null terminated paths separated by LF, valid until the handle is released. nullptr if released</returns>
+LPCWSTR UNIWINC_API MapPanelResult(const UINT32 hResult) {
+	return panelResults_.map(hResult);
+}
+
+/// <summary>
+/// Free the result
+/// </summary>
+void UNIWINC_API ReleasePanelResult(const UINT32 hResult) {
+	panelResults_.release(hResult);
+}
+
+/// <summary>
+/// PANELSETTINGS with the strings of PANELSETTINGSUTF8 converted to UTF-16
+/// </summary>
+struct PanelSettingsUtf16 {
+	PANELSETTINGS settings;
+	std::vector<WCHAR> strings[5];		// Keep the converted strings
+
+	explicit PanelSettingsUtf16(const PPANELSETTINGSUTF8 pSource) {
+		ZeroMemory(&settings, sizeof(settings));
+		settings.nStructSize = sizeof(settings);
+		settings.nFlags = pSource->nFlags;
+		settings.lpszTitle = toUtf16String(pSource->lpszTitle, pSource->nTitleLength, strings[0]);
+		settings.lpszFilter = toUtf16String(pSource->lpszFilter, pSource->nFilterLength, strings[1]);
+		settings.lpszInitialFile = toUtf16String(pSource->lpszInitialFile, pSource->nInitialFileLength, strings[2]);
+		settings.lpszInitialDir = toUtf16String(pSource->lpszInitialDir, pSource->nInitialDirLength, strings[3]);
+		settings.lpszDefaultExt = toUtf16String(pSource->lpszDefaultExt, pSource->nDefaultExtLength, strings[4]);
+	}
+};
+
+/// <summary>
+/// Same as OpenFilePanelEx() with the settings in UTF-8
+///   Read the result by GetPanelResultUtf8(), then ReleasePanelResult().
+/// </summary>
+/// <returns>Handle of the result, or 0 if cancelled. GetLastPanelState() tells a cancel from too many files</returns>
+UINT32 UNIWINC_API OpenFilePanelUtf8(const PPANELSETTINGSUTF8 pSettings) {
+	if (pSettings == nullptr || pSettings->nStructSize < (INT32)sizeof(PANELSETTINGSUTF8)) return 0;
+
+	PanelSettingsUtf16 settings(pSettings);
+	return showFilePanel(&settings.settings, FALSE);
+}
+
+/// <summary>
+/// Same as OpenSavePanelEx() with the settings in UTF-8
+/// </summary>
+/// <returns>Handle of the result, or 0 if cancelled. GetLastPanelState() tells a cancel from too many files</returns>
+UINT32 UNIWINC_API OpenSavePanelUtf8(const PPANELSETTINGSUTF8 pSettings) {
+	if (pSettings == nullptr || pSettings->nStructSize < (INT32)sizeof(PANELSETTINGSUTF8)) return 0;
+
+	PanelSettingsUtf16 settings(pSettings);
+	return showFilePanel(&settings.settings, TRUE);
+}
+
+/// <summary>
+/// Same as OpenFilePanelAsync() with the settings in UTF-8
+/// </summary>
+/// <returns>Request ID, or 0 if failed</returns>
+UINT32 UNIWINC_API OpenFilePanelAsyncUtf8(const PPANELSETTINGSUTF8 pSettings) {
+	if (pSettings == nullptr || pSettings->nStructSize < (INT32)sizeof(PANELSETTINGSUTF8)) return 0;
+
+	// 設定は依頼時にコピーされるので、変換したものはすぐに捨ててよい
+	PanelSettingsUtf16 settings(pSettings);
+	return OpenFilePanelAsync(&settings.settings);
+}
+
+/// <summary>
+/// Same as OpenSavePanelAsync() with the settings in UTF-8
+/// </summary>
+/// <returns>Request ID, or 0 if failed</returns>
+UINT32 UNIWINC_API OpenSavePanelAsyncUtf8(const PPANELSETTINGSUTF8 pSettings) {
+	if (pSettings == nullptr || pSettings->nStructSize < (INT32)sizeof(PANELSETTINGSUTF8)) return 0;
+
+	PanelSettingsUtf16 settings(pSettings);
+	return OpenSavePanelAsync(&settings.settings);
+}
+
+/// <summary>
+/// Copy the result in UTF-8 with a terminator. Paths are separated by LF
+///   Call with pResultBuffer NULL to get the size to allocate.
+/// </summary>
+/// <param name="hResult">Handle of the result, or 0 for the last result of OpenFilePanel() and OpenSavePanel()</param>
+/// <returns>Bytes of the result including the terminator, or -1 if the handle is released. Nothing is copied if larger than nBufferSize</returns>
+INT32 UNIWINC_API GetPanelResultUtf8(const UINT32 hResult, char* pResultBuffer, const UINT32 nBufferSize) {
+	return panelResults_.copyUtf8((hResult != 0 ? hResult : hLastPanelResult_.load()), pResultBuffer, nBufferSize);
+}
+
+/// <summary>
+/// Test the extensions of many paths with the filter of the file panels at once
+///   The paths are given in the same layout as GetDropFiles(). The filter is compiled once and reused for the same text.
+/// </summary>
+/// <param name="lpszFilter">Same as the filter of the file panels, e.g. "Image\tpng\tjpg\n". NULL matches everything</param>
+/// <param name="pOffsets">nCount + 1 elements. Path i is pData[pOffsets[i]] to pData[pOffsets[i + 1] - 1]</param>
+/// <param name="pData">UTF-16 paths without terminators</param>
+/// <param name="pResults">nCount elements. Receives 1 if the path matches, otherwise 0</param>
+/// <returns>Number of the paths which match, or -1 if the arguments are invalid</returns>
+INT32 UNIWINC_API MatchFileFilter(const LPWSTR lpszFilter, const UINT32* pOffsets, const LPWSTR pData, const UINT32 nCount, BYTE* pResults) {
+	if (pOffsets == nullptr || pResults == nullptr) return -1;
+	if (nCount == 0) return 0;
+	if (pData == nullptr) return -1;
+
+	std::shared_ptr<const PanelFilter> pFilter = PanelFilter::compile(lpszFilter);
+	if (!pFilter) {
+		memset(pResults, 1, nCount);
+		return (INT32)nCount;
+	}
+	return (INT32)pFilter->matchPaths(pOffsets, pData, nCount, pResults);
+}
+
+/// <summary>
+/// Same as MatchFileFilter() with the filter and the paths in UTF-8
+/// </summary>
+/// <param name="nFilterLength">Bytes of the filter</param>
+/// <param name="pOffsets">nCount + 1 elements in bytes. Path i is pData[pOffsets[i]] to pData[pOffsets[i + 1] - 1]</param>
+/// <returns>Number of the paths which match, or -1 if the arguments are invalid or failed</returns>
+INT32 UNIWINC_API MatchFileFilterUtf8(const char* lpszFilter, const UINT32 nFilterLength, const UINT32* pOffsets, const char* pData, const UINT32 nCount, BYTE* pResults) {
+	if (pOffsets == nullptr || pResults == nullptr) return -1;
+	if (nCount == 0) return 0;
+	if (pData == nullptr) return -1;
+
+	std::vector<WCHAR> filter;
+	std::shared_ptr<const PanelFilter> pFilter = PanelFilter::compile(toUtf16String(lpszFilter, nFilterLength, filter));
+	if (!pFilter) {
+		memset(pResults, 1, nCount);
+		return (INT32)nCount;
+	}
+
+	// 拡張子は末尾だけを見るが、パス全体をまとめて UTF-16 にして同じ配置で渡す
+	std::vector<UINT32> offsets;
+	std::vector<WCHAR> data;
+	try {
+		size_t total = 0;
+		for (UINT32 i = 0; i < nCount; i++) {
+			if (pOffsets[i + 1] > pOffsets[i]) total += pOffsets[i + 1] - pOffsets[i];
+		}
+		offsets.resize((size_t)nCount + 1);
+		data.resize(total + 1);		// 空のパスばかりでも nullptr にしない
+	}
+	catch (...) {
+		return -1;
+	}
+
+	offsets[0] = 0;
+	for (UINT32 i = 0; i < nCount; i++) {
+		const UINT32 length = (pOffsets[i + 1] > pOffsets[i] ? pOffsets[i + 1] - pOffsets[i] : 0);
+		offsets[i + 1] = offsets[i] + (UINT32)convertToUtf16(pData + pOffsets[i], length, data.data() + offsets[i]);
+	}
+	return (INT32)pFilter->matchPaths(offsets.data(), data.data(), nCount, pResults);
+}
+
+#pragma endregion File dialogs
+
+
+/// <summary>
+/// デバッグ時に情報を渡すための関数
+///   ウィンドウに問い合わせるので、ウィンドウスレッド以外では 0
 /// </summary>
-/// <returns>Previous window procedure</returns>
-BOOL UNIWINC_API SetAllowDrop(const BOOL bEnabled)
-{
-	if (hTargetWnd_ == NULL) return FALSE;
+/// <returns></returns>
+INT32 UNIWINC_API GetDebugInfo() {
+	if (!isWindowThread()) return 0;
 
-	bAllowDropFile_ = bEnabled;
-	DragAcceptFiles(hTargetWnd_, bAllowDropFile_);
+	LONG style = pBackend_->getWindowLong(pContext_->hTargetWnd, GWL_STYLE);
+	return style;
+}
 
-	//if (bEnabled && hHook == NULL) {
-	//	beginHook();
-	//}
-	////else if (!bEnabled && hHook != NULL) {
-	////	endHook();
-	////}
+// ========================================================================
+#pragma region Windows only public functions
 
-	return TRUE;
+/// <summary>
+/// 現在選択されているウィンドウハンドルを取得
+/// </summary>
+/// <returns></returns>
+HWND UNIWINC_API GetWindowHandle() {
+	if (!isWindowThread()) {
+		return pContext_->geometry.load().hWnd;
+	}
+	return pContext_->hTargetWnd;
 }
 
 /// <summary>
-/// Register the callback fucnction for dropping files
+/// 壁紙化の親となるウィンドウハンドルを取得
 /// </summary>
-/// <param name="callback"></param>
 /// <returns></returns>
-BOOL UNIWINC_API RegisterDropFilesCallback(FilesCallback callback) {
-	if (callback == nullptr) return FALSE;
-
-	hDropFilesHandler_ = callback;
-	return TRUE;
+HWND UNIWINC_API GetDesktopWindowHandle() {
+	return hDesktopWnd_.load();
 }
 
 /// <summary>
-/// Unregister the callback function
+/// 自分のプロセスIDを取得
 /// </summary>
 /// <returns></returns>
-BOOL UNIWINC_API UnregisterDropFilesCallback() {
-	hDropFilesHandler_ = nullptr;
-	return TRUE;
+DWORD UNIWINC_API GetMyProcessId() {
+	return pSharedBackend_.load(std::memory_order_acquire)->getCurrentProcessId();
 }
 
-#pragma endregion For file dropping and window procedure
+/// <summary>
+/// 枠の変更の反映方法を設定
+/// </summary>
+/// <param name="mode">RefreshMode</param>
+void UNIWINC_API SetRefreshMode(const INT32 mode) {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { SetRefreshMode(mode); });
+		return;
+	}
 
+	pContext_->nRefreshMode = (mode == (INT32)RefreshMode::ResizeTrick ? RefreshMode::ResizeTrick : RefreshMode::FrameChanged);
+}
 
-// ========================================================================
-#pragma region File dialogs
+/// <summary>
+/// 枠の変更の反映方法を取得
+/// </summary>
+/// <returns>RefreshMode</returns>
+INT32 UNIWINC_API GetRefreshMode() {
+	return (INT32)pContext_->nRefreshMode.load();
+}
 
 /// <summary>
-/// Convert multi-selection files string to new-line separated string
+/// 枠の変更やリサイズの回数を取得
 /// </summary>
-/// <param name="lpBuffer"></param>
-/// <param name="nBufferSize"></param>
-BOOL parsePaths(LPWSTR lpBuffer, const UINT32 nBufferLength) {
-	// 複製を保存するのに必要な長さを調べる
-	int bufferLength = nBufferLength;
-	int length = bufferLength;	// OPENFILENAME中で実際に利用した長さ
-	int pathCount = 0;			// NULL区切りでみた行数。複数選択時は1より大きくなる
-	int firstLineLength = bufferLength;	// 先頭要素の長さ。複数選択時にはフォルダ名が入る部分
+/// <param name="pStats">nStructSize を設定しておくこと</param>
+/// <returns>成功すればTRUE。回数はウィンドウスレッドで数えているので、他のスレッドではFALSE</returns>
+BOOL UNIWINC_API GetRefreshStats(PREFRESHSTATS pStats) {
+	if (pStats == nullptr || pStats->nStructSize < (INT32)sizeof(INT32)) return FALSE;
+	if (!isWindowThread()) return FALSE;
 
-	// 要素の数、全体の文字数を数える
-	for (int i = 0; i < bufferLength; i++) {
-		if (lpBuffer[i] == L'\0') {
-			if (firstLineLength == bufferLength) firstLineLength = i;
-			pathCount++;
-			length = i;		// とりあえずここまでの文字数は利用している
+	// 呼び出し側の構造体の方が小さければ、入る分だけ返す
+	INT32 size = pStats->nStructSize;
+	REFRESHSTATS stats = pContext_->refreshStats;
+	stats.nStructSize = (size < (INT32)sizeof(REFRESHSTATS) ? size : (INT32)sizeof(REFRESHSTATS));
+	memcpy(pStats, &stats, stats.nStructSize);
+	return TRUE;
+}
 
-			if ((i < (bufferLength - 1)) && (lpBuffer[i + 1] == L'\0')) {
-				// NULLが連続していれば終端とみなす（連続する後ろがもう無い場合も終端）
-				break;
-			}
-			else
-			{
-				// 次の文字がNULLでなければスキップできる
-				i++;
-			}
-		}
+/// <summary>
+/// 枠の変更やリサイズの回数を0に戻す
+/// </summary>
+void UNIWINC_API ResetRefreshStats() {
+	if (!isWindowThread()) {
+		invokeOnWindowThread([=]() { ResetRefreshStats(); });
+		return;
 	}
 
-	// NULLが最後に来なかった場合は行数追加できていないので、1増やしておく
-	if (length == bufferLength) pathCount++;
+	pContext_->refreshStats = REFRESHSTATS();
+}
 
-	// 複数選択でない場合は改行区切りやフォルダ名追加の必要はなく、そのままの値で終了
-	if (pathCount <= 1) {
-		return TRUE;
-	}
+/// <summary>
+/// モニタ配置の世代を取得
+///   モニタの追加、削除、配置の変更があると増える。前回の値と比べれば、モニタ情報を取り直すべきか判断できる
+/// </summary>
+/// <returns>世代</returns>
+UINT32 UNIWINC_API GetMonitorGeneration() {
+	return getMonitorTopology()->getGeneration();
+}
 
+#pragma endregion Windows-only public functions
 
-	// パスのリストが返却バッファに入りきらない場合は失敗として空で返す
-	if (((firstLineLength + 2) * pathCount + length - firstLineLength) > bufferLength) {
-		// 結果返却バッファをクリア
-		ZeroMemory(lpBuffer, bufferLength * sizeof(WCHAR));
-		return FALSE;
-	}
 
-	// 完全なパスを改行区切り文字列で生成
+// ========================================================================
+#pragma region For window contexts
 
-	LPWSTR buffer = new (std::nothrow)WCHAR[length];
-	if (buffer == NULL) {
-		ZeroMemory(lpBuffer, bufferLength * sizeof(WCHAR));
-		return FALSE;
-	}
-	ZeroMemory(buffer, length * sizeof(WCHAR));
+// 各ウィンドウの状態はコンテキストが持ち、ハンドルのない関数は既定のコンテキストに対して働く
+//   以下の関数は指定したコンテキストを一時的に現在のものとして、同名の関数を呼ぶ
+//   ドロップされたファイル、ファイルパネル、モニタ情報はライブラリで共通
 
-	// 一時バッファに内容を退避
-	memcpy(buffer, lpBuffer, length * sizeof(WCHAR));
+/// <summary>
+/// Create a context to attach another window
+/// </summary>
+/// <returns>Context handle, or 0 if failed</returns>
+UINT32 UNIWINC_API CreateContext() {
+	if (!isWindowThread()) return 0;
+	return contexts_.create();
+}
 
-	// 結果返却バッファをクリア
-	ZeroMemory(lpBuffer, bufferLength * sizeof(WCHAR));
+/// <summary>
+/// Detach the window of the context and destroy it. The handle is invalid after this
+///   The default context, and a context whose callback is being called, cannot be destroyed.
+/// </summary>
+/// <returns>FALSE if the handle is invalid or the context cannot be destroyed</returns>
+BOOL UNIWINC_API DestroyContext(const UINT32 hContext) {
+	WindowContext* pContext = contexts_.get(hContext);
+	if (pContext == nullptr || hContext == hDefaultContext_ || pContext == pContext_ || !isWindowThread()) return FALSE;
 
+	{
+		ContextScope scope(pContext);
+		detachWindow();
+	}
+	return contexts_.destroy(hContext);
+}
 
-	int offset = 0;
-	int index = firstLineLength;
-	for (int i = firstLineLength; i < length; i++) {
-		if (buffer[i] == NULL) {
-			// 改行で区切り
-			if (offset > 0) {
-				lpBuffer[offset] = L'\n';
-				offset++;
-			}
+/// <summary>
+/// Handle of the context which the functions without a context handle work on
+/// </summary>
+/// <returns></returns>
+UINT32 UNIWINC_API GetDefaultContext() {
+	return hDefaultContext_;
+}
 
-			//  フォルダ名部分を複製
-			memcpy(lpBuffer + offset, buffer, firstLineLength * sizeof(WCHAR));
-			offset += firstLineLength;
-			lpBuffer[offset] = L'\\';	// パスの区切り文字も追加
-			offset++;
-		}
-		else
-		{
-			// NULL文字でなければファイル名の一部として追加
-			lpBuffer[offset] = buffer[i];
-			offset++;
-		}
-	}
+/// <summary>
+/// Attach the window to the context. Same as AttachWindowHandle()
+/// </summary>
+/// <returns>FALSE if the handle is invalid or the window is attached to another context</returns>
+BOOL UNIWINC_API AttachContextWindow(const UINT32 hContext, const HWND hWnd) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	return AttachWindowHandle(hWnd);
+}
 
-	//// デバッグ用
-	//swprintf_s(lpBuffer, bufferSize, L"Files: bufferSize %d, length %d, pathCount %d, firstLineLength %d, Dir %s", bufferSize, length, pathCount, firstLineLength, buffer);
+/// <summary>
+/// Restore and release the window of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API DetachContextWindow(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && DetachWindow());
+}
 
-	delete[] buffer;
-	return TRUE;
+/// <summary>
+/// Window attached to the context
+/// </summary>
+/// <returns>NULL if not attached or the handle is invalid</returns>
+HWND UNIWINC_API GetContextWindowHandle(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() ? GetWindowHandle() : NULL);
 }
 
 /// <summary>
-/// Create a null ended extension string from the first extension in the input string
-/// e.g. "TitleA\ttExtA1\tExtA2\t...ExtAn\nTitleB\tExtB1\tExtB2...ExtBn\n"
-/// </summary>
-/// <param name="lpsFormTypeFilterText"></param>
-/// <returns>Null ended string</returns>
-LPWSTR createDefaultExtString(const LPWSTR lpsFormTypeFilterText) {
-	const int MAX_EXT_LENGTH = 32;
-
-	int resultIndex = 0;
-	LPWSTR lpsResult = nullptr;
-	if (lpsFormTypeFilterText != nullptr) {
-		lpsResult = new (std::nothrow)WCHAR[MAX_EXT_LENGTH];
-
-		if (lpsResult != nullptr) {
-			ZeroMemory(lpsResult, MAX_EXT_LENGTH * sizeof(WCHAR));
-
-			int inputIndex = 0;
-			int section = 0;	// 0:title, 1:extensions
-			bool includesWildCard = false;
-
-			while (resultIndex < (MAX_EXT_LENGTH - 1)) {
-				WCHAR c = lpsFormTypeFilterText[inputIndex++];
-
-				// End of the input string
-				if (c == L'\0') {
-					break;
-				}
-				// Tab separated
-				else if (c == L'\t') {
-					// The first element is title
-					if (section <= 0) {
-						section = 1;
-					}
-					else {
-						break;
-					}
-				}
-				// New line
-				else if (c == L'\n') {
-					break;
-				}
-				// Other character
-				else {
-					if (section == 1) {
-						// Wild card
-						if (c == L'*') {
-							includesWildCard = true;
-							break;
-						}
-
-						// A character of extension
-						lpsResult[resultIndex++] = c;
-					}
-				}
-			}
+/// IsActive() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextActive(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsActive());
+}
 
-			lpsResult[resultIndex++] = L'\0';
+/// <summary>
+/// IsTransparent() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextTransparent(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsTransparent());
+}
 
-			if (includesWildCard) {
-				delete[] lpsResult;
-				lpsResult = nullptr;
-			}
-		}
-	}
-	return lpsResult;
-}
-
-/// <summary>
-/// Create a null separated filter text from tab separated text
-/// e.g. "TitleA\ttExtA1\tExtA2\t...ExtAn\nTitleB\tExtB1\tExtB2...ExtBn\n"
-/// </summary>
-/// <param name="lpsFormTypeFilterText"></param>
-/// <returns>e.g. "TitleA\0*.tExtA1;*.ExtA2;...;*.ExtAn\0TitleB\0*.ExtB1;*.ExtB2;...;*.ExtBn\0\0"</returns>
-LPWSTR createFilterString(const LPWSTR lpsFormTypeFilterText) {
-	const int MAX_FILTER_LENGTH = 1024;
-
-	int resultIndex = 0;
-	LPWSTR lpsResult = nullptr;
-	if (lpsFormTypeFilterText != nullptr) {
-		lpsResult = new (std::nothrow)WCHAR[MAX_FILTER_LENGTH];
-
-		if (lpsResult != nullptr) {
-			//ZeroMemory(lpsFilter, MAX_FILTER_LENGTH * sizeof(WCHAR));
-
-			int firstExtStartIndex = 0;
-			int firstExtEndIndex = 0;
-
-			int inputIndex = 0;
-			int section = 0;	// 0:title, 1:extensions
-			bool isFirstChar = true;
-
-			while (resultIndex < (MAX_FILTER_LENGTH - 2)) {
-				WCHAR c = lpsFormTypeFilterText[inputIndex++];
-
-				// End of the input string
-				if (c == L'\0') {
-					break;
-				}
-				// Tab separated
-				else if (c == L'\t') {
-					// The first element is title
-					if (section <= 0) {
-						lpsResult[resultIndex++] = L'\0';
-						section = 1;
-					}
-					else {
-						// In extensions' section
-						lpsResult[resultIndex++] = ';';
-					}
-					isFirstChar = true;
-				}
-				// New line
-				else if (c == L'\n') {
-					// If there is no extension, add separator to skip to next pair
-					if (section <= 0) {
-						lpsResult[resultIndex++] = L'\0';
-					}
-					// The end of title and extensions pair
-					lpsResult[resultIndex++] = L'\0';
-					section = 0;
-					isFirstChar = true;
-				}
-				// Other character
-				else {
-					// Add "*." before each extension.
-					if (isFirstChar && section == 1) {
-						if (resultIndex >= (MAX_FILTER_LENGTH - 4)) break;
-						lpsResult[resultIndex++] = '*';
-						lpsResult[resultIndex++] = '.';
-					}
-					lpsResult[resultIndex++] = c;
-					isFirstChar = false;
-				}
-			}
+/// <summary>
+/// IsBorderless() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextBorderless(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsBorderless());
+}
 
-			// Terminated by two NULL characters 
-			lpsResult[resultIndex++] = L'\0';
-			lpsResult[resultIndex++] = L'\0';
-		}
-	}
-	return lpsResult;
+/// <summary>
+/// IsTopmost() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextTopmost(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsTopmost());
 }
 
-DWORD GetPanelFlags(const INT32 flags) {
-	DWORD result = OFN_EXPLORER | OFN_NOCHANGEDIR;	// Default
+/// <summary>
+/// IsBottommost() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextBottommost(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsBottommost());
+}
 
-	if ((flags & (INT32)PanelFlag::AllowMultiSelect) > 0) result |= OFN_ALLOWMULTISELECT;
-	if ((flags & (INT32)PanelFlag::FileMustExist) > 0) result |= OFN_FILEMUSTEXIST;
-	if ((flags & (INT32)PanelFlag::FolderMustExist) > 0) result |= OFN_PATHMUSTEXIST;
-	if ((flags & (INT32)PanelFlag::ShowHidden) > 0) result |= OFN_FORCESHOWHIDDEN;
-	if ((flags & (INT32)PanelFlag::OverwritePrompt) > 0) result |= OFN_OVERWRITEPROMPT;
-	if ((flags & (INT32)PanelFlag::CreatePrompt) > 0) result |= OFN_CREATEPROMPT;
+/// <summary>
+/// IsMaximized() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextMaximized(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsMaximized());
+}
 
-	return result;
+/// <summary>
+/// IsMinimized() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API IsContextMinimized(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && IsMinimized());
 }
 
-BOOL UNIWINC_API OpenFilePanel(const PPANELSETTINGS pSettings, LPWSTR pResultBuffer, const UINT32 nBufferSize) {
-	// モーダルにするため、ウィンドウハンドル未取得なら探して設定
-	HWND hwnd = hTargetWnd_;
-	if (hwnd == NULL) {
-		hwnd = hPanelOwnerWnd_;
-		if (hwnd == NULL) {
-			hwnd = hPanelOwnerWnd_ = FindOwnerWindowHandle();
-		}
-	}
+/// <summary>
+/// SetTransparentType() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextTransparentType(const UINT32 hContext, const TransparentType type) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetTransparentType(type);
+	return TRUE;
+}
 
-	LPWSTR lpszDefaultExt = createDefaultExtString(pSettings->lpszFilter);
-	LPWSTR lpsFilter = createFilterString(pSettings->lpszFilter);
+/// <summary>
+/// SetKeyColor() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextKeyColor(const UINT32 hContext, const COLORREF color) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetKeyColor(color);
+	return TRUE;
+}
 
-	OPENFILENAMEW ofn;
-	ZeroMemory(&ofn, sizeof(ofn));
-	ofn.lStructSize = sizeof(ofn);
-	ofn.hwndOwner = hwnd;
-	ofn.lpstrTitle = pSettings->lpszTitle;
-	ofn.lpstrFilter = lpsFilter;
-	ofn.lpstrInitialDir = pSettings->lpszInitialDir;
-	//ofn.lpstrDefExt = pSettings->lpszDefaultExt;		// Not implemented
-	ofn.lpstrDefExt = lpszDefaultExt;
-	ofn.Flags = GetPanelFlags(pSettings->nFlags);
+/// <summary>
+/// SetTransparent() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextTransparent(const UINT32 hContext, const BOOL bTransparent) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetTransparent(bTransparent);
+	return TRUE;
+}
 
-	BOOL result = FALSE;
+/// <summary>
+/// SetBorderless() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextBorderless(const UINT32 hContext, const BOOL bBorderless) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetBorderless(bBorderless);
+	return TRUE;
+}
 
-	if ((pResultBuffer != nullptr) && (nBufferSize > 0)) {
-		ZeroMemory(pResultBuffer, nBufferSize * sizeof(WCHAR));
-		ofn.lpstrFile = pResultBuffer;
-		ofn.nMaxFile = nBufferSize;
+/// <summary>
+/// SetAlphaValue() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextAlphaValue(const UINT32 hContext, const float alpha) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetAlphaValue(alpha);
+	return TRUE;
+}
 
-		// Default path
-		if (pSettings->lpszInitialFile != nullptr) {
-			wcscpy_s(ofn.lpstrFile, ofn.nMaxFile, pSettings->lpszInitialFile);
-		}
+/// <summary>
+/// SetTopmost() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextTopmost(const UINT32 hContext, const BOOL bTopmost) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetTopmost(bTopmost);
+	return TRUE;
+}
 
-		result = GetOpenFileNameW(&ofn);
-	}
+/// <summary>
+/// SetBottommost() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextBottommost(const UINT32 hContext, const BOOL bBottommost) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetBottommost(bBottommost);
+	return TRUE;
+}
 
-	if (lpsFilter != nullptr) delete[] lpsFilter;
-	if (lpszDefaultExt!= nullptr) delete[] lpszDefaultExt;
+/// <summary>
+/// SetClickThrough() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextClickThrough(const UINT32 hContext, const BOOL bTransparent) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetClickThrough(bTransparent);
+	return TRUE;
+}
 
-	if (result) {
-		return parsePaths(pResultBuffer, nBufferSize);
-	}
-	return FALSE;
+/// <summary>
+/// SetMaximized() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API SetContextMaximized(const UINT32 hContext, const BOOL bZoomed) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	SetMaximized(bZoomed);
+	return TRUE;
 }
 
-BOOL UNIWINC_API OpenSavePanel(const PPANELSETTINGS pSettings, LPWSTR pResultBuffer, const UINT32 nBufferSize) {
-	// モーダルにするため、ウィンドウハンドル未取得なら探して設定
-	HWND hwnd = hTargetWnd_;
-	if (hwnd == NULL) {
-		hwnd = hPanelOwnerWnd_;
-		if (hwnd == NULL) {
-			hwnd = hPanelOwnerWnd_ = FindOwnerWindowHandle();
-		}
-	}
+/// <summary>
+/// SetAllowDrop() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API SetContextAllowDrop(const UINT32 hContext, const BOOL bEnabled) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && SetAllowDrop(bEnabled));
+}
 
-	LPWSTR lpszDefaultExt = createDefaultExtString(pSettings->lpszFilter);
-	LPWSTR lpsFilter = createFilterString(pSettings->lpszFilter);
+/// <summary>
+/// SetPosition() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API SetContextPosition(const UINT32 hContext, const float x, const float y) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && SetPosition(x, y));
+}
 
-	OPENFILENAMEW ofn;
-	ZeroMemory(&ofn, sizeof(ofn));
-	ofn.lStructSize = sizeof(ofn);
-	ofn.hwndOwner = hwnd;
-	ofn.lpstrTitle = pSettings->lpszTitle;
-	ofn.lpstrFilter = lpsFilter;
-	ofn.lpstrInitialDir = pSettings->lpszInitialDir;
-	//ofn.lpstrDefExt = pSettings->lpszDefaultExt;		// Not implemented
-	ofn.lpstrDefExt = lpszDefaultExt;
-	ofn.Flags = GetPanelFlags(pSettings->nFlags);
+/// <summary>
+/// GetPosition() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API GetContextPosition(const UINT32 hContext, float* x, float* y) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && GetPosition(x, y));
+}
 
-	BOOL result = FALSE;
+/// <summary>
+/// SetSize() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API SetContextSize(const UINT32 hContext, const float width, const float height) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && SetSize(width, height));
+}
 
-	if ((pResultBuffer != nullptr) && (nBufferSize > 0)) {
-		ZeroMemory(pResultBuffer, nBufferSize * sizeof(WCHAR));
-		ofn.lpstrFile = pResultBuffer;
-		ofn.nMaxFile = nBufferSize;
+/// <summary>
+/// GetSize() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API GetContextSize(const UINT32 hContext, float* width, float* height) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && GetSize(width, height));
+}
 
-		// Default path
-		if (pSettings->lpszInitialFile != nullptr) {
-			wcscpy_s(ofn.lpstrFile, ofn.nMaxFile, pSettings->lpszInitialFile);
-		}
+/// <summary>
+/// GetClientSize() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API GetContextClientSize(const UINT32 hContext, float* width, float* height) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && GetClientSize(width, height));
+}
 
-		result = GetSaveFileNameW(&ofn);
-	}
+/// <summary>
+/// GetCurrentMonitor() of the window of the context
+/// </summary>
+/// <returns>-1 if the handle is invalid</returns>
+INT32 UNIWINC_API GetContextCurrentMonitor(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return -1;
+	return GetCurrentMonitor();
+}
 
-	if (lpsFilter != nullptr) delete[] lpsFilter;
-	if (lpszDefaultExt != nullptr) delete[] lpszDefaultExt;
+/// <summary>
+/// GetWindowSnapshot() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API GetContextWindowSnapshot(const UINT32 hContext, PWINDOWSNAPSHOT pSnapshot) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && GetWindowSnapshot(pSnapshot));
+}
 
-	if (result) {
-		return parsePaths(pResultBuffer, nBufferSize);
-	}
-	return FALSE;
+/// <summary>
+/// BeginDragMove() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API BeginContextDragMove(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && BeginDragMove());
 }
 
-#pragma endregion File dialogs
+/// <summary>
+/// EndDragMove() of the context
+/// </summary>
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API EndContextDragMove(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	EndDragMove();
+	return TRUE;
+}
 
+/// <summary>
+/// StartWindowTween() of the context
+/// </summary>
+/// <returns>Tween ID, or 0 if failed or the handle is invalid</returns>
+UINT32 UNIWINC_API StartContextWindowTween(const UINT32 hContext, const PWINDOWTWEEN pTween) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return 0;
+	return StartWindowTween(pTween);
+}
 
 /// <summary>
-/// デバッグ時に情報を渡すための関数
+/// StopAllWindowTweens() of the context
 /// </summary>
-/// <returns></returns>
-INT32 UNIWINC_API GetDebugInfo() {
-	LONG style = GetWindowLong(hTargetWnd_, GWL_STYLE);
-	return style;
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API StopAllContextWindowTweens(const UINT32 hContext) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	StopAllWindowTweens();
+	return TRUE;
 }
 
-// ========================================================================
-#pragma region Windows only public functions
+/// <summary>
+/// SetHitTestMask() of the context. FALSE if the handle is invalid
+/// </summary>
+BOOL UNIWINC_API SetContextHitTestMask(const UINT32 hContext, const BYTE* pAlpha, const INT32 width, const INT32 height, const BYTE threshold) {
+	ContextScope scope(hContext);
+	return (scope.isValid() && SetHitTestMask(pAlpha, width, height, threshold));
+}
 
 /// <summary>
-/// 現在選択されているウィンドウハンドルを取得
+/// EnableHitTestMask() of the context
 /// </summary>
-/// <returns></returns>
-HWND UNIWINC_API GetWindowHandle() {
-	return hTargetWnd_;
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API EnableContextHitTestMask(const UINT32 hContext, const BOOL bEnabled) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	EnableHitTestMask(bEnabled);
+	return TRUE;
 }
 
 /// <summary>
-/// 壁紙化の親となるウィンドウハンドルを取得
+/// EnableEventQueue() of the context
 /// </summary>
-/// <returns></returns>
-HWND UNIWINC_API GetDesktopWindowHandle() {
-	return hDesktopWnd_;
+/// <returns>FALSE if the handle is invalid</returns>
+BOOL UNIWINC_API EnableContextEventQueue(const UINT32 hContext, const BOOL bEnabled) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return FALSE;
+	EnableEventQueue(bEnabled);
+	return TRUE;
 }
 
 /// <summary>
-/// 自分のプロセスIDを取得
+/// Take the queued events of the context. Same as PollEvents()
+///   The events of a file drop are queued in the context whose window received it,
+///   and the events of the file panels in the default context.
 /// </summary>
-/// <returns></returns>
-DWORD UNIWINC_API GetMyProcessId() {
-	return GetCurrentProcessId();
+/// <returns>Number of the events received, or -1 if the handle is invalid</returns>
+INT32 UNIWINC_API PollContextEvents(const UINT32 hContext, PUNIWINCEVENT pEvents, const INT32 nMaxCount) {
+	ContextScope scope(hContext);
+	if (!scope.isValid()) return -1;
+	return PollEvents(pEvents, nMaxCount);
 }
 
-#pragma endregion Windows-only public functions
+#pragma endregion For window contexts
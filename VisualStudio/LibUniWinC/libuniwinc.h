@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#ifdef _WIN32
 #ifdef LIBUNIWINC_EXPORTS
 #define UNIWINC_API __stdcall
 #define UNIWINC_EXPORT extern "C" __declspec(dllexport)
@@ -7,14 +8,50 @@
 #define UNIWINC_API __stdcall
 #define UNIWINC_EXPORT extern "C" __declspec(dllimport)
 #endif
+#else
+// Other platforms (built with a non-Win32 backend)
+#define UNIWINC_API
+#define UNIWINC_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
 
 
-// Maximum monitor number that this library could be handle
-#define UNIWINC_MAX_MONITORCOUNT 32
-
 // Maximum length for a classname
 #define UNIWINC_MAX_CLASSNAME 32
 
+// Default time budget per PollEvents() to take the paths of a streaming drop [us]
+#define UNIWINC_DROP_STREAM_BUDGET 2000
+
+// Maximum number of threads to get the metadata of dropped files
+#define UNIWINC_DROP_INFO_THREADS 4
+
+// Default maximum depth of the files listed from the dropped folders. The files in a dropped folder are at depth 1
+#define UNIWINC_DROP_EXPAND_DEPTH 64
+
+// Length of the buffer which receives a multi-selection of the file panels [WCHARs]
+#define UNIWINC_PANEL_BUFFER_LENGTH 262144
+
+// Maximum number of the asynchronous file panel requests which are not released
+#define UNIWINC_PANEL_MAX_REQUESTS 64
+
+// Interval to update click-through with the hit test mask [ms]
+#define UNIWINC_HITTEST_INTERVAL 16
+
+// Interval to follow the cursor while dragging the window, in addition to WM_MOUSEMOVE [ms]
+//   Windows rounds it up to 10 ms
+#define UNIWINC_DRAGMOVE_INTERVAL 8
+
+// Default distance to snap the dragged window to the monitor edges [px]
+#define UNIWINC_DRAGMOVE_SNAP_DISTANCE 16
+
+// Interval to step the window tweens [ms]. The values follow the elapsed time, not the number of steps
+#define UNIWINC_TWEEN_INTERVAL 10
+
+// Maximum number of window tweens running at once
+#define UNIWINC_TWEEN_MAX_COUNT 32
+
+// Number of events the queue for PollEvents() can hold
+#define UNIWINC_EVENT_QUEUE_SIZE 1024
+
 
 // Methods to transparent the window
 enum class TransparentType : int {
@@ -39,6 +76,70 @@ enum class WindowStateEventType : int {
 	WallpaperModeDisabled = 64 + 1,
 };
 
+// Kinds of the events taken by PollEvents()
+enum class EventType : int {
+	None = 0,
+	WindowStateChanged = 1,		// nParam: WindowStateEventType
+	MonitorChanged = 2,			// nParam: Number of monitors
+	FilesDropped = 3,			// nParam: Number of files. The paths are sent to FilesCallback. Also the end of a streaming drop
+	DropBegin = 4,				// nParam: Number of files. Streaming drop only (see EnableDropStreaming). A drop during a stream begins after its FilesDropped
+	DropChunk = 5,				// nParam: Number of files which can be read by GetDropFiles() so far
+	DropInfoReady = 6,			// nParam: Number of files whose metadata can be read by GetDropFileInfo() so far
+	DropExpandChunk = 7,		// nParam: Number of files found in the dropped folders so far (see EnableDropExpansion)
+	DropExpanded = 8,			// nParam: Number of files found in the dropped folders. The walk has finished
+	PanelCompleted = 9,			// nParam: Request ID of OpenFilePanelAsync() or OpenSavePanelAsync(). Selected, cancelled or failed
+	DragMoveEnded = 10,			// nParam: 1 if the mouse button was released, 0 if ended by EndDragMove() or the window state
+	TweenCompleted = 11,		// nParam: ID of StartWindowTween(). The target has been reached
+	TweenCancelled = 12,		// nParam: ID of StartWindowTween(). Stopped, or all its properties were taken by newer tweens
+	Overflow = 255,				// nParam: Number of events dropped because the queue was full
+};
+
+// How to apply a change of the window frame
+enum class RefreshMode : int {
+	FrameChanged = 0,	// SetWindowPos with SWP_FRAMECHANGED once. The resize trick is used only if the client size is not as expected
+	ResizeTrick = 1,	// Always resize by 1px and back
+};
+
+// Flags of WINDOWSNAPSHOT
+enum class WindowSnapshotFlag : int {
+	None = 0,
+	Attached = 1,		// A window is attached. Window values are 0 otherwise
+	Maximized = 2,
+	Minimized = 4,
+	Changed = 256,		// nGeneration differs from the value given by the caller
+};
+
+// Flags of DROPFILEINFO
+enum class DropFileFlag : int {
+	None = 0,
+	Exists = 1,
+	Directory = 2,
+	Unreadable = 4,		// Exists but the head of the file could not be read
+};
+
+// File type guessed from the first bytes
+enum class DropFileType : int {
+	Unknown = 0,
+	Png = 1,
+	Jpeg = 2,
+	Gif = 3,
+	Bmp = 4,
+	WebP = 5,
+	Tiff = 6,
+	Pdf = 16,
+	Zip = 17,
+	Gzip = 18,
+	SevenZip = 19,
+	Wav = 32,
+	Ogg = 33,
+	Flac = 34,
+	Mp3 = 35,
+	Mp4 = 36,
+	Glb = 48,			// glTF binary, also VRM
+	Fbx = 49,			// Binary FBX
+	Text = 64,			// Text with a UTF-8 or UTF-16 BOM
+};
+
 enum class PanelFlag : int {
 	None = 0,
 	FileMustExist = 1,
@@ -50,6 +151,36 @@ enum class PanelFlag : int {
 	ReferLink = 8192,
 };
 
+// Properties animated by StartWindowTween()
+enum class WindowTweenFlag : int {
+	None = 0,
+	Position = 1,		// x, y
+	Size = 2,			// width, height. The bottom-left is kept unless the position is also animated, the same as SetSize()
+	Alpha = 4,			// alpha
+};
+
+// Curves of the window tweens
+enum class EasingType : int {
+	Linear = 0,
+	InQuad = 1,
+	OutQuad = 2,
+	InOutQuad = 3,
+	InCubic = 4,
+	OutCubic = 5,
+	InOutCubic = 6,
+};
+
+// State of an asynchronous file panel request
+enum class PanelRequestState : int {
+	None = 0,			// Unknown or released request
+	Queued = 1,			// Waiting for the previous panels to close
+	Open = 2,
+	Selected = 3,		// The result can be taken by TakePanelRequestResult()
+	Cancelled = 4,
+	Failed = 5,
+	TooManyFiles = 6,	// Files were selected, but too many to fit in UNIWINC_PANEL_BUFFER_LENGTH. Nothing is returned
+};
+
 // Struct to transmit file panel settings
 #pragma pack(push, 1)
 typedef struct tagPANELSETTINGS {
@@ -64,6 +195,128 @@ typedef struct tagPANELSETTINGS {
 } PANELSETTINGS, *PPANELSETTINGS;
 #pragma pack(pop)
 
+// Struct to transmit file panel settings in UTF-8 (see OpenFilePanelUtf8)
+//   Strings need no terminators. A NULL string means the same as NULL in PANELSETTINGS
+#pragma pack(push, 1)
+typedef struct tagPANELSETTINGSUTF8 {
+	INT32 nStructSize;
+	INT32 nFlags;
+	const char* lpszTitle;
+	const char* lpszFilter;
+	const char* lpszInitialFile;
+	const char* lpszInitialDir;
+	const char* lpszDefaultExt;
+	UINT32 nTitleLength;		// Bytes of each string
+	UINT32 nFilterLength;
+	UINT32 nInitialFileLength;
+	UINT32 nInitialDirLength;
+	UINT32 nDefaultExtLength;
+
+} PANELSETTINGSUTF8, *PPANELSETTINGSUTF8;
+#pragma pack(pop)
+
+// Struct to receive an event by PollEvents()
+#pragma pack(push, 1)
+typedef struct tagUNIWINCEVENT {
+	INT32 nType;		// EventType
+	INT32 nParam;
+	INT64 nTimestamp;	// Monotonic time when the event occurred [us]
+	float x;			// Window position and size at the event, the same as GetPosition() and GetSize()
+	float y;
+	float width;
+	float height;
+
+} UNIWINCEVENT, *PUNIWINCEVENT;
+#pragma pack(pop)
+
+// Struct to receive the counts of the events (see GetEventStats)
+#pragma pack(push, 1)
+typedef struct tagEVENTSTATS {
+	INT32 nStructSize;
+	UINT32 nReceived;				// Events taken from the queue
+	UINT32 nDelivered;				// Events returned by PollEvents(). Fewer than nReceived by coalescing
+	UINT32 nDropped;				// Events lost because the queue was full
+	UINT32 nResizedReceived;
+	UINT32 nResizedDelivered;
+
+} EVENTSTATS, *PEVENTSTATS;
+#pragma pack(pop)
+
+// Struct to receive the window state at once (see GetWindowSnapshot)
+#pragma pack(push, 1)
+typedef struct tagWINDOWSNAPSHOT {
+	INT32 nStructSize;
+	UINT32 nGeneration;			// In: generation of the last snapshot the caller has. Out: current generation. Not changed by the cursor
+	INT32 nFlags;				// WindowSnapshotFlag
+	INT32 nMonitor;				// Same as GetCurrentMonitor()
+	INT32 nMonitorCount;
+	UINT32 nMonitorGeneration;	// Same as GetMonitorGeneration()
+	float x;					// Same as GetPosition() and GetSize()
+	float y;
+	float width;
+	float height;
+	float clientWidth;			// Same as GetClientSize()
+	float clientHeight;
+	float cursorX;				// Same as GetCursorPosition()
+	float cursorY;
+
+} WINDOWSNAPSHOT, *PWINDOWSNAPSHOT;
+#pragma pack(pop)
+
+// Struct to start a window tween (see StartWindowTween)
+#pragma pack(push, 1)
+typedef struct tagWINDOWTWEEN {
+	INT32 nStructSize;
+	INT32 nFlags;				// WindowTweenFlag
+	float x;					// Target position and size, the same as SetPosition() and SetSize()
+	float y;
+	float width;
+	float height;
+	float alpha;				// Target alpha, the same as SetAlphaValue()
+	INT32 nDuration;			// [ms]. 0 or less applies the target at once
+	INT32 nEasing;				// EasingType
+
+} WINDOWTWEEN, *PWINDOWTWEEN;
+#pragma pack(pop)
+
+// Struct to receive a page of the dropped paths (see GetDropFiles)
+#pragma pack(push, 1)
+typedef struct tagDROPFILESPAGE {
+	INT32 nStructSize;
+	UINT32 nDropId;				// Incremented by each drop. Start over if it changes while reading pages
+	UINT32 nTotalCount;			// Paths of the drop
+	UINT32 nFirstIndex;			// Index of the first path in this page
+	UINT32 nCount;				// Paths in this page
+	UINT32 nDataLength;			// WCHARs written. Bytes for GetDropFilesUtf8() and GetExpandedFilesUtf8()
+	UINT32 nNextLength;			// WCHARs (or bytes) of the path after this page, or 0. Enlarge the buffer if it did not fit at all
+	UINT32 nAvailableCount;		// Paths which can be read now. Less than nTotalCount while streaming
+
+} DROPFILESPAGE, *PDROPFILESPAGE;
+#pragma pack(pop)
+
+// Metadata of a dropped file (see GetDropFileInfo)
+#pragma pack(push, 1)
+typedef struct tagDROPFILEINFO {
+	UINT64 nSize;				// Bytes. 0 for a directory
+	INT64 nModifiedTime;		// Unix time [ms]
+	INT32 nFlags;				// DropFileFlag
+	INT32 nType;				// DropFileType
+
+} DROPFILEINFO, *PDROPFILEINFO;
+#pragma pack(pop)
+
+// Struct to receive the counts of window refreshes (see GetRefreshStats)
+#pragma pack(push, 1)
+typedef struct tagREFRESHSTATS {
+	INT32 nStructSize;
+	UINT32 nResizeEvents;			// WM_SIZE received
+	UINT32 nSwapchainRebuilds;		// WM_SIZE with a new client size. Unity reallocates the back buffer for each of them
+	UINT32 nFrameChanges;			// SetWindowPos with SWP_FRAMECHANGED called to apply a frame change
+	UINT32 nResizeTricks;			// Times the 1px resize trick was used
+
+} REFRESHSTATS, *PREFRESHSTATS;
+#pragma pack(pop)
+
 // Function called when window style (e.g. maximized, transparetize, etc.)
 //   param: The argument is indicate the kind of event
 using WindowStyleChangedCallback =  void(UNIWINC_API *)(INT32);
@@ -72,11 +325,43 @@ using WindowStyleChangedCallback =  void(UNIWINC_API *)(INT32);
 //   param: The argument is a \0 ended  UTF-16 string with each path separated by \n
 using FilesCallback = void(UNIWINC_API *)(WCHAR*);
 
+// Function called when files have selected, in UTF-8
+//   param: UTF-8 paths each followed by \n, also terminated by \0, and the bytes without the terminator
+using FilesCallbackUtf8 = void(UNIWINC_API *)(const char*, INT32);
+
 // Function called when displays have changed
 //   param: The argument is the numbers of monitors
 using MonitorChangedCallback = void(UNIWINC_API *)(INT32);
 
 
+// Threading model
+//   The window thread is the thread which attached a window (e.g. the Unity main thread).
+//   Until then, the first thread which calls Update(), Attach* or opens a file panel becomes the window thread,
+//   and the changes called before on the other threads are queued for it.
+//
+//   - Getters of the window state may be called on any thread without taking a lock:
+//     IsActive, IsTransparent, IsBorderless, IsTopmost, IsBottommost, IsBackground, IsMaximized, IsMinimized,
+//     GetPosition, GetSize, GetClientSize, GetCurrentMonitor, GetMonitorCount, GetMonitorRectangle, GetMonitorGeneration,
+//     IsDragMoving, IsHitTestMaskEnabled, IsInputRegionEnabled, GetWindowHandle, GetDesktopWindowHandle, GetWindowSnapshot,
+//     IsWindowTweening, GetRefreshMode, GetMyProcessId and GetCursorPosition, and their context variants.
+//     Flags are atomic, the monitors are an immutable snapshot replaced as a whole, and the position and sizes
+//     are published by the window thread with a seqlock whenever the window moves or resizes.
+//     A getter retries only while that store is in progress, which is short, but not bounded if the writer is preempted.
+//     The running tweens are published as atomic IDs, and the cursor is read from the window system directly.
+//     On other threads they return the state as of the last message, which may lag behind a change not yet applied.
+//   - Setters called on other threads are queued and applied on the window thread, in the order they were called,
+//     by the window procedure (Windows), or by the next Update() or PollEvents(). They return TRUE when queued.
+//   - Functions which return a result of the change, or consume the state, work only on the window thread,
+//     and fail on other threads: Update, Begin/CommitWindowUpdate, Attach*, StartWindowTween,
+//     PollEvents, CreateContext and DestroyContext.
+//     So do the functions which open a file panel (OpenFilePanel*, OpenSavePanel*, including the Async variants,
+//     because the owner window is found from the state of the window thread), returning FALSE or 0,
+//     and the counters updated by the window thread (GetRefreshStats, GetEventStats, GetDebugInfo), returning FALSE or 0.
+//   - SetHitTestMask(Bits), the pages of the dropped files (GetDropFiles etc.) and the panel results (GetPanelResult etc.)
+//     are guarded by themselves and may be used on any thread, as may the other panel request functions.
+//   The current context (see the context functions) is kept for each thread.
+
+
 // Winodow state functions
 UNIWINC_EXPORT BOOL UNIWINC_API IsActive();
 UNIWINC_EXPORT BOOL UNIWINC_API IsTransparent();
@@ -87,6 +372,8 @@ UNIWINC_EXPORT BOOL UNIWINC_API IsBackground();
 UNIWINC_EXPORT BOOL UNIWINC_API IsMaximized();
 UNIWINC_EXPORT BOOL UNIWINC_API IsMinimized();
 UNIWINC_EXPORT void UNIWINC_API Update();
+UNIWINC_EXPORT void UNIWINC_API BeginWindowUpdate();
+UNIWINC_EXPORT BOOL UNIWINC_API CommitWindowUpdate();
 
 UNIWINC_EXPORT BOOL UNIWINC_API AttachMyWindow();
 UNIWINC_EXPORT BOOL UNIWINC_API AttachMyOwnerWindow();
@@ -107,6 +394,7 @@ UNIWINC_EXPORT BOOL UNIWINC_API SetSize(const float width, const float height);
 UNIWINC_EXPORT BOOL UNIWINC_API GetSize(float* width, float* height);
 UNIWINC_EXPORT BOOL UNIWINC_API GetClientSize(float* width, float* height);
 UNIWINC_EXPORT INT32 UNIWINC_API GetCurrentMonitor();
+UNIWINC_EXPORT BOOL UNIWINC_API GetWindowSnapshot(PWINDOWSNAPSHOT pSnapshot);
 
 // Event handling
 UNIWINC_EXPORT BOOL UNIWINC_API RegisterWindowStyleChangedCallback(WindowStyleChangedCallback callback);
@@ -115,6 +403,24 @@ UNIWINC_EXPORT BOOL UNIWINC_API RegisterMonitorChangedCallback(MonitorChangedCal
 UNIWINC_EXPORT BOOL UNIWINC_API UnregisterMonitorChangedCallback();
 UNIWINC_EXPORT BOOL UNIWINC_API RegisterDropFilesCallback(FilesCallback callback);
 UNIWINC_EXPORT BOOL UNIWINC_API UnregisterDropFilesCallback();
+UNIWINC_EXPORT BOOL UNIWINC_API RegisterDropFilesCallbackUtf8(FilesCallbackUtf8 callback);
+UNIWINC_EXPORT BOOL UNIWINC_API UnregisterDropFilesCallbackUtf8();
+UNIWINC_EXPORT void UNIWINC_API EnableDropStreaming(const BOOL bEnabled, const INT32 nBudget);
+UNIWINC_EXPORT INT32 UNIWINC_API GetDropFiles(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, LPWSTR pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage);
+UNIWINC_EXPORT INT32 UNIWINC_API GetDropFilesUtf8(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, char* pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage);
+UNIWINC_EXPORT void UNIWINC_API EnableDropFileInfo(const BOOL bEnabled, const INT32 nThreads);
+UNIWINC_EXPORT void UNIWINC_API CancelDropFileInfo();
+UNIWINC_EXPORT INT32 UNIWINC_API GetDropFileInfo(const UINT32 nFirstIndex, PDROPFILEINFO pInfos, const UINT32 nMaxCount, PDROPFILESPAGE pPage);
+UNIWINC_EXPORT void UNIWINC_API EnableDropExpansion(const BOOL bEnabled, const LPWSTR lpszFilter, const INT32 nMaxDepth, const INT32 nThreads);
+UNIWINC_EXPORT void UNIWINC_API EnableDropExpansionUtf8(const BOOL bEnabled, const char* lpszFilter, const UINT32 nFilterLength, const INT32 nMaxDepth, const INT32 nThreads);
+UNIWINC_EXPORT void UNIWINC_API CancelDropExpansion();
+UNIWINC_EXPORT INT32 UNIWINC_API GetExpandedFiles(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, LPWSTR pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage);
+UNIWINC_EXPORT INT32 UNIWINC_API GetExpandedFilesUtf8(const UINT32 nFirstIndex, UINT32* pOffsets, const UINT32 nMaxCount, char* pData, const UINT32 nDataCapacity, PDROPFILESPAGE pPage);
+UNIWINC_EXPORT void UNIWINC_API EnableEventQueue(const BOOL bEnabled);
+UNIWINC_EXPORT INT32 UNIWINC_API PollEvents(PUNIWINCEVENT pEvents, const INT32 nMaxCount);
+UNIWINC_EXPORT BOOL UNIWINC_API SetEventInterval(const INT32 nType, const INT32 nParam, const INT32 nMilliseconds);
+UNIWINC_EXPORT BOOL UNIWINC_API GetEventStats(PEVENTSTATS pStats);
+UNIWINC_EXPORT void UNIWINC_API ResetEventStats();
 
 
 // Monitor Info.
@@ -125,12 +431,53 @@ UNIWINC_EXPORT BOOL UNIWINC_API GetMonitorRectangle(const INT32 monitorIndex, fl
 UNIWINC_EXPORT BOOL UNIWINC_API SetCursorPosition(const float x, const float y);
 UNIWINC_EXPORT BOOL UNIWINC_API GetCursorPosition(float* x, float* y);
 
+// Dragging the window
+UNIWINC_EXPORT BOOL UNIWINC_API BeginDragMove();
+UNIWINC_EXPORT void UNIWINC_API EndDragMove();
+UNIWINC_EXPORT BOOL UNIWINC_API IsDragMoving();
+UNIWINC_EXPORT void UNIWINC_API SetDragMoveSnap(const BOOL bEnabled, const INT32 nDistance);
+
+// Window tween
+UNIWINC_EXPORT UINT32 UNIWINC_API StartWindowTween(const PWINDOWTWEEN pTween);
+UNIWINC_EXPORT BOOL UNIWINC_API StopWindowTween(const UINT32 nTweenId, const BOOL bComplete);
+UNIWINC_EXPORT void UNIWINC_API StopAllWindowTweens();
+UNIWINC_EXPORT BOOL UNIWINC_API IsWindowTweening(const UINT32 nTweenId);
+
+// Hit test mask
+UNIWINC_EXPORT BOOL UNIWINC_API SetHitTestMask(const BYTE* pAlpha, const INT32 width, const INT32 height, const BYTE threshold);
+UNIWINC_EXPORT BOOL UNIWINC_API SetHitTestMaskBits(const BYTE* pBits, const INT32 width, const INT32 height);
+UNIWINC_EXPORT void UNIWINC_API ClearHitTestMask();
+UNIWINC_EXPORT void UNIWINC_API EnableHitTestMask(const BOOL bEnabled);
+UNIWINC_EXPORT BOOL UNIWINC_API IsHitTestMaskEnabled();
+UNIWINC_EXPORT void UNIWINC_API EnableInputRegion(const BOOL bEnabled);
+UNIWINC_EXPORT BOOL UNIWINC_API IsInputRegionEnabled();
+
 // File drop
 UNIWINC_EXPORT BOOL UNIWINC_API SetAllowDrop(const BOOL bEnabled);
 
 // File panels
 UNIWINC_EXPORT BOOL UNIWINC_API OpenFilePanel(const PPANELSETTINGS pSettings, LPWSTR pResultBuffer, const UINT32 nBufferSize);
 UNIWINC_EXPORT BOOL UNIWINC_API OpenSavePanel(const PPANELSETTINGS pSettings, LPWSTR pResultBuffer, const UINT32 nBufferSize);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenFilePanelEx(const PPANELSETTINGS pSettings);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenSavePanelEx(const PPANELSETTINGS pSettings);
+UNIWINC_EXPORT UINT32 UNIWINC_API GetPanelResultLength(const UINT32 hResult);
+UNIWINC_EXPORT BOOL UNIWINC_API GetPanelResult(const UINT32 hResult, LPWSTR pResultBuffer, const UINT32 nBufferSize);
+UNIWINC_EXPORT LPCWSTR UNIWINC_API MapPanelResult(const UINT32 hResult);
+UNIWINC_EXPORT void UNIWINC_API ReleasePanelResult(const UINT32 hResult);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenFilePanelAsync(const PPANELSETTINGS pSettings);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenSavePanelAsync(const PPANELSETTINGS pSettings);
+UNIWINC_EXPORT BOOL UNIWINC_API CancelPanelRequest(const UINT32 nRequestId);
+UNIWINC_EXPORT INT32 UNIWINC_API GetPanelRequestState(const UINT32 nRequestId);
+UNIWINC_EXPORT INT32 UNIWINC_API GetLastPanelState();
+UNIWINC_EXPORT UINT32 UNIWINC_API TakePanelRequestResult(const UINT32 nRequestId);
+UNIWINC_EXPORT void UNIWINC_API ReleasePanelRequest(const UINT32 nRequestId);
+UNIWINC_EXPORT INT32 UNIWINC_API MatchFileFilter(const LPWSTR lpszFilter, const UINT32* pOffsets, const LPWSTR pData, const UINT32 nCount, BYTE* pResults);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenFilePanelUtf8(const PPANELSETTINGSUTF8 pSettings);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenSavePanelUtf8(const PPANELSETTINGSUTF8 pSettings);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenFilePanelAsyncUtf8(const PPANELSETTINGSUTF8 pSettings);
+UNIWINC_EXPORT UINT32 UNIWINC_API OpenSavePanelAsyncUtf8(const PPANELSETTINGSUTF8 pSettings);
+UNIWINC_EXPORT INT32 UNIWINC_API GetPanelResultUtf8(const UINT32 hResult, char* pResultBuffer, const UINT32 nBufferSize);
+UNIWINC_EXPORT INT32 UNIWINC_API MatchFileFilterUtf8(const char* lpszFilter, const UINT32 nFilterLength, const UINT32* pOffsets, const char* pData, const UINT32 nCount, BYTE* pResults);
 
 // Debug function
 UNIWINC_EXPORT INT32 UNIWINC_API GetDebugInfo();
@@ -143,3 +490,48 @@ UNIWINC_EXPORT HWND UNIWINC_API GetWindowHandle();
 UNIWINC_EXPORT HWND UNIWINC_API GetDesktopWindowHandle();
 UNIWINC_EXPORT DWORD UNIWINC_API GetMyProcessId();
 UNIWINC_EXPORT BOOL UNIWINC_API AttachWindowHandle(const HWND);
+UNIWINC_EXPORT void UNIWINC_API SetRefreshMode(const INT32 mode);
+UNIWINC_EXPORT INT32 UNIWINC_API GetRefreshMode();
+UNIWINC_EXPORT BOOL UNIWINC_API GetRefreshStats(PREFRESHSTATS pStats);
+UNIWINC_EXPORT void UNIWINC_API ResetRefreshStats();
+UNIWINC_EXPORT UINT32 UNIWINC_API GetMonitorGeneration();
+
+// Window contexts
+UNIWINC_EXPORT UINT32 UNIWINC_API CreateContext();
+UNIWINC_EXPORT BOOL UNIWINC_API DestroyContext(const UINT32 hContext);
+UNIWINC_EXPORT UINT32 UNIWINC_API GetDefaultContext();
+UNIWINC_EXPORT BOOL UNIWINC_API AttachContextWindow(const UINT32 hContext, const HWND hWnd);
+UNIWINC_EXPORT BOOL UNIWINC_API DetachContextWindow(const UINT32 hContext);
+UNIWINC_EXPORT HWND UNIWINC_API GetContextWindowHandle(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextActive(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextTransparent(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextBorderless(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextTopmost(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextBottommost(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextMaximized(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API IsContextMinimized(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextTransparentType(const UINT32 hContext, const TransparentType type);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextKeyColor(const UINT32 hContext, const COLORREF color);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextTransparent(const UINT32 hContext, const BOOL bTransparent);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextBorderless(const UINT32 hContext, const BOOL bBorderless);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextAlphaValue(const UINT32 hContext, const float alpha);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextTopmost(const UINT32 hContext, const BOOL bTopmost);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextBottommost(const UINT32 hContext, const BOOL bBottommost);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextClickThrough(const UINT32 hContext, const BOOL bTransparent);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextMaximized(const UINT32 hContext, const BOOL bZoomed);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextAllowDrop(const UINT32 hContext, const BOOL bEnabled);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextPosition(const UINT32 hContext, const float x, const float y);
+UNIWINC_EXPORT BOOL UNIWINC_API GetContextPosition(const UINT32 hContext, float* x, float* y);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextSize(const UINT32 hContext, const float width, const float height);
+UNIWINC_EXPORT BOOL UNIWINC_API GetContextSize(const UINT32 hContext, float* width, float* height);
+UNIWINC_EXPORT BOOL UNIWINC_API GetContextClientSize(const UINT32 hContext, float* width, float* height);
+UNIWINC_EXPORT INT32 UNIWINC_API GetContextCurrentMonitor(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API GetContextWindowSnapshot(const UINT32 hContext, PWINDOWSNAPSHOT pSnapshot);
+UNIWINC_EXPORT BOOL UNIWINC_API BeginContextDragMove(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API EndContextDragMove(const UINT32 hContext);
+UNIWINC_EXPORT UINT32 UNIWINC_API StartContextWindowTween(const UINT32 hContext, const PWINDOWTWEEN pTween);
+UNIWINC_EXPORT BOOL UNIWINC_API StopAllContextWindowTweens(const UINT32 hContext);
+UNIWINC_EXPORT BOOL UNIWINC_API SetContextHitTestMask(const UINT32 hContext, const BYTE* pAlpha, const INT32 width, const INT32 height, const BYTE threshold);
+UNIWINC_EXPORT BOOL UNIWINC_API EnableContextHitTestMask(const UINT32 hContext, const BOOL bEnabled);
+UNIWINC_EXPORT BOOL UNIWINC_API EnableContextEventQueue(const UINT32 hContext, const BOOL bEnabled);
+UNIWINC_EXPORT INT32 UNIWINC_API PollContextEvents(const UINT32 hContext, PUNIWINCEVENT pEvents, const INT32 nMaxCount);
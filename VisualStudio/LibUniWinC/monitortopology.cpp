@@ -0,0 +1,209 @@
+﻿// monitortopology.cpp : Immutable snapshot of the monitor layout
+
+#include "pch.h"
+#include "monitortopology.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+
+MonitorTopology::MonitorTopology() : generation_(0), primaryIndex_(0), primaryHeight_(0), virtualScreen_() {
+	slabStarts_.push_back(0);
+}
+
+MonitorTopology::MonitorTopology(const std::vector<RECT>& rects, const std::vector<HMONITOR>& handles, const UINT32 generation)
+	: generation_(generation), primaryIndex_(0), primaryHeight_(0), virtualScreen_()
+{
+	const INT32 count = (INT32)rects.size();
+
+	// 左にあるモニタが先、横が同じなら下にあるモニタが先となるよう並べる
+	std::vector<INT32> order((size_t)count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&rects](const INT32 a, const INT32 b) {
+		const RECT& ra = rects[a];
+		const RECT& rb = rects[b];
+		return (ra.left < rb.left || (ra.left == rb.left && ra.bottom > rb.bottom));
+	});
+
+	rects_.resize((size_t)count);
+	handles_.resize((size_t)count);
+	enumOrder_.resize((size_t)count);
+	for (INT32 i = 0; i < count; i++) {
+		rects_[i] = rects[order[i]];
+		handles_[i] = (order[i] < (INT32)handles.size() ? handles[order[i]] : NULL);
+		enumOrder_[order[i]] = i;
+	}
+
+	// 原点に位置するモニタがプライマリモニタだと判断
+	for (INT32 i = 0; i < count; i++) {
+		if (rects_[i].left == 0 && rects_[i].top == 0) {
+			primaryIndex_ = i;
+			break;
+		}
+	}
+	if (count > 0) {
+		primaryHeight_ = rects_[primaryIndex_].bottom;
+		virtualScreen_ = rects_[0];
+	}
+
+	for (const RECT& r : rects_) {
+		if (r.left < virtualScreen_.left) virtualScreen_.left = r.left;
+		if (r.top < virtualScreen_.top) virtualScreen_.top = r.top;
+		if (r.right > virtualScreen_.right) virtualScreen_.right = r.right;
+		if (r.bottom > virtualScreen_.bottom) virtualScreen_.bottom = r.bottom;
+		edges_.push_back(r.left);
+		edges_.push_back(r.right);
+	}
+	std::sort(edges_.begin(), edges_.end());
+	edges_.erase(std::unique(edges_.begin(), edges_.end()), edges_.end());
+
+	// 縦の帯ごとに、またがるモニタを上から並べる
+	const INT32 slabs = (edges_.size() > 1 ? (INT32)edges_.size() - 1 : 0);
+	slabStarts_.reserve((size_t)slabs + 1);
+	overlapped_.assign((size_t)slabs, 0);
+	for (INT32 s = 0; s < slabs; s++) {
+		const UINT32 start = (UINT32)spans_.size();
+		slabStarts_.push_back(start);
+
+		for (INT32 i = 0; i < count; i++) {
+			const RECT& r = rects_[i];
+			if (r.left <= edges_[s] && edges_[s + 1] <= r.right && r.top < r.bottom) {
+				spans_.push_back({ r.top, r.bottom, i });
+			}
+		}
+		std::stable_sort(spans_.begin() + start, spans_.end(), [](const Span& a, const Span& b) {
+			return a.top < b.top;
+		});
+
+		for (size_t k = (size_t)start + 1; k < spans_.size(); k++) {
+			if (spans_[k - 1].bottom > spans_[k].top) {
+				overlapped_[s] = 1;
+				break;
+			}
+		}
+	}
+	slabStarts_.push_back((UINT32)spans_.size());
+}
+
+/// <summary>
+/// Slab containing x, or -1
+/// </summary>
+INT32 MonitorTopology::findSlab(const LONG x) const {
+	if (edges_.size() < 2 || x < edges_.front() || x >= edges_.back()) return -1;
+
+	return (INT32)(std::upper_bound(edges_.begin(), edges_.end(), x) - edges_.begin()) - 1;
+}
+
+INT32 MonitorTopology::findMonitor(const LONG x, const LONG y) const {
+	const INT32 slab = findSlab(x);
+	if (slab < 0) return -1;
+
+	const Span* first = spans_.data() + slabStarts_[slab];
+	const Span* last = spans_.data() + slabStarts_[slab + 1];
+
+	if (overlapped_[slab]) {
+		// 重なっているモニタがあれば、番号の小さいものを優先
+		INT32 found = -1;
+		for (const Span* p = first; p != last; p++) {
+			if (p->top <= y && y < p->bottom && (found < 0 || p->index < found)) {
+				found = p->index;
+			}
+		}
+		return found;
+	}
+
+	// top <= y となる最後の区間
+	const Span* p = std::upper_bound(first, last, y, [](const LONG value, const Span& span) {
+		return value < span.top;
+	});
+	if (p == first) return -1;
+	p--;
+	return (y < p->bottom ? p->index : -1);
+}
+
+INT32 MonitorTopology::findMonitor(const RECT& rect) const {
+	INT32 found = -1;
+	INT64 maxArea = 0;
+
+	for (INT32 i = 0; i < (INT32)rects_.size(); i++) {
+		const RECT& r = rects_[i];
+		const LONG w = (rect.right < r.right ? rect.right : r.right) - (rect.left > r.left ? rect.left : r.left);
+		const LONG h = (rect.bottom < r.bottom ? rect.bottom : r.bottom) - (rect.top > r.top ? rect.top : r.top);
+		if (w <= 0 || h <= 0) continue;
+
+		const INT64 area = (INT64)w * h;
+		if (area > maxArea) {
+			maxArea = area;
+			found = i;
+		}
+	}
+	return found;
+}
+
+BOOL MonitorTopology::isSameLayout(const std::vector<RECT>& rects, const std::vector<HMONITOR>& handles) const {
+	if (rects.size() != rects_.size()) return FALSE;
+
+	for (size_t i = 0; i < rects.size(); i++) {
+		const RECT& a = rects[i];
+		const RECT& b = rects_[enumOrder_[i]];
+		if (a.left != b.left || a.top != b.top || a.right != b.right || a.bottom != b.bottom) return FALSE;
+		if (i < handles.size() && handles[i] != handles_[enumOrder_[i]]) return FALSE;
+	}
+	return TRUE;
+}
+
+
+MonitorTopologyRing::MonitorTopologyRing() : current_(0) {
+}
+
+BOOL MonitorTopologyRing::publish(const std::vector<RECT>& rects, const std::vector<HMONITOR>& handles) {
+	// 書き込むのはこのスレッドだけなので、現在のスロットは固定せずに読める
+	const UINT32 current = current_.load(std::memory_order_relaxed);
+	MonitorTopology topology;
+	try {
+		topology = MonitorTopology(rects, handles, slots_[current].topology.getGeneration() + 1);
+	}
+	catch (...) {
+		return FALSE;
+	}
+
+	// 現在のもの以外で、読まれていないスロットを使う
+	//   ここで 0 と確かめた後に固定しようとした読み手は、現在のスロットが変わっていないのを見て外れる
+	UINT32 next = current;
+	while (next == current) {
+		for (UINT32 i = 1; i < SLOT_COUNT; i++) {
+			const UINT32 index = (current + i) % SLOT_COUNT;
+			if (slots_[index].readers.load(std::memory_order_seq_cst) == 0) {
+				next = index;
+				break;
+			}
+		}
+		if (next == current) std::this_thread::yield();
+	}
+
+	slots_[next].topology = std::move(topology);
+	current_.store(next, std::memory_order_seq_cst);
+	return TRUE;
+}
+
+MonitorTopologyRing::Reader::Reader(const MonitorTopologyRing& ring) {
+	// 固定してから、まだ現在のスロットか確かめる。差し替えられていたらやり直す
+	UINT32 index = ring.current_.load(std::memory_order_seq_cst);
+	for (;;) {
+		Slot& slot = ring.slots_[index];
+		slot.readers.fetch_add(1, std::memory_order_seq_cst);
+		const UINT32 current = ring.current_.load(std::memory_order_seq_cst);
+		if (current == index) {
+			pSlot_ = &slot;
+			return;
+		}
+		slot.readers.fetch_sub(1, std::memory_order_release);
+		index = current;
+	}
+}
+
+MonitorTopologyRing::Reader::~Reader() {
+	if (pSlot_ != nullptr) {
+		pSlot_->readers.fetch_sub(1, std::memory_order_release);
+	}
+}
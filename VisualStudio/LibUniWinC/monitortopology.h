@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include <atomic>
+#include <vector>
+
+/// <summary>
+/// Immutable snapshot of the monitor layout, built once per display change.
+///   Monitors are ordered by this library's monitor number: left first, and bottom first for the same left.
+///   Point queries are O(log n) using vertical slabs between the distinct left/right edges.
+///   Published to the other threads by MonitorTopologyRing, so readers on any thread keep a consistent view.
+/// </summary>
+class MonitorTopology {
+public:
+	MonitorTopology();
+
+	/// <summary>
+	/// Build a snapshot from the enumerated monitors
+	/// </summary>
+	/// <param name="rects">Monitor rectangles in the order of EnumDisplayMonitors</param>
+	/// <param name="handles">Monitor handles in the same order</param>
+	/// <param name="generation">Generation of the new snapshot</param>
+	MonitorTopology(const std::vector<RECT>& rects, const std::vector<HMONITOR>& handles, const UINT32 generation);
+
+	INT32 getCount() const { return (INT32)rects_.size(); }
+
+	/// <summary>
+	/// Incremented whenever the layout changes. Compare it to know whether the monitors have changed
+	/// </summary>
+	UINT32 getGeneration() const { return generation_; }
+
+	/// <param name="index">Monitor number of this library</param>
+	const RECT& getRect(const INT32 index) const { return rects_[index]; }
+	HMONITOR getHandle(const INT32 index) const { return handles_[index]; }
+
+	/// <summary>
+	/// Monitor at the origin, or 0 if there is none
+	/// </summary>
+	INT32 getPrimaryIndex() const { return primaryIndex_; }
+
+	/// <summary>
+	/// Height of the primary monitor, used to convert to the bottom-left origin
+	/// </summary>
+	LONG getPrimaryHeight() const { return primaryHeight_; }
+
+	/// <summary>
+	/// Bounding rectangle of all monitors
+	/// </summary>
+	const RECT& getVirtualScreen() const { return virtualScreen_; }
+
+	/// <summary>
+	/// Monitor containing the point
+	/// </summary>
+	/// <returns>Smallest monitor number containing the point, or -1</returns>
+	INT32 findMonitor(const LONG x, const LONG y) const;
+
+	/// <summary>
+	/// Monitor which has the largest intersection with the rectangle
+	/// </summary>
+	/// <returns>Monitor number, or -1 if the rectangle is outside of all monitors</returns>
+	INT32 findMonitor(const RECT& rect) const;
+
+	/// <summary>
+	/// Same layout or not. The generation is not compared
+	/// </summary>
+	BOOL isSameLayout(const std::vector<RECT>& rects, const std::vector<HMONITOR>& handles) const;
+
+private:
+	struct Span {
+		LONG top;
+		LONG bottom;		// Exclusive
+		INT32 index;		// Monitor number
+	};
+
+	std::vector<RECT> rects_;
+	std::vector<HMONITOR> handles_;
+	std::vector<INT32> enumOrder_;		// Monitor number of each enumerated monitor
+	UINT32 generation_;
+	INT32 primaryIndex_;
+	LONG primaryHeight_;
+	RECT virtualScreen_;
+
+	std::vector<LONG> edges_;			// Sorted distinct x of the left and right edges
+	std::vector<UINT32> slabStarts_;	// First span of each slab [edges_[i], edges_[i + 1]) in spans_, and the end
+	std::vector<Span> spans_;			// Monitors crossing each slab, sorted by top
+	std::vector<BYTE> overlapped_;		// Slabs whose spans overlap each other. They are scanned linearly
+
+	INT32 findSlab(const LONG x) const;
+};
+
+/// <summary>
+/// Current MonitorTopology, readable on any thread, kept in a small ring of slots which are reused.
+///   A reader pins the slot of the current snapshot by its counter while it reads (see Reader), without a lock.
+///   The writer builds the next snapshot in a slot which is neither current nor pinned, then makes it current,
+///   so a display change reuses a replaced snapshot instead of keeping it until unloaded.
+///   If all the other slots are pinned, the writer yields until one is released. A reader pins a slot only for one call.
+/// </summary>
+class MonitorTopologyRing {
+	struct Slot {
+		Slot() : readers(0) {}
+
+		MonitorTopology topology;
+		std::atomic<UINT32> readers;		// Readers which have pinned this slot
+	};
+
+public:
+	static const UINT32 SLOT_COUNT = 4;
+
+	/// <summary>
+	/// Pin of the current snapshot. It stays valid and unchanged until this object is destroyed
+	/// </summary>
+	class Reader {
+	public:
+		explicit Reader(const MonitorTopologyRing& ring);
+		Reader(Reader&& other) : pSlot_(other.pSlot_) { other.pSlot_ = nullptr; }
+		~Reader();
+
+		const MonitorTopology& operator*() const { return pSlot_->topology; }
+		const MonitorTopology* operator->() const { return &pSlot_->topology; }
+
+	private:
+		Slot* pSlot_;
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+	};
+
+	MonitorTopologyRing();
+
+	/// <summary>
+	/// Pin the current snapshot. Any thread may call this
+	/// </summary>
+	Reader read() const { return Reader(*this); }
+
+	/// <summary>
+	/// Replace the current snapshot by the layout, with the next generation.
+	///   Only one thread may call this at a time
+	/// </summary>
+	/// <returns>FALSE if the snapshot could not be built. The current one is kept</returns>
+	BOOL publish(const std::vector<RECT>& rects, const std::vector<HMONITOR>& handles);
+
+private:
+	mutable Slot slots_[SLOT_COUNT];
+	std::atomic<UINT32> current_;			// Index of the current slot
+
+	MonitorTopologyRing(const MonitorTopologyRing&) = delete;
+	MonitorTopologyRing& operator=(const MonitorTopologyRing&) = delete;
+};
@@ -0,0 +1,97 @@
+﻿// multiselect.cpp : Expansion of the multi-selection result of the file panels
+
+#include "pch.h"
+#include "multiselect.h"
+#include <cstring>
+
+
+static inline BOOL isPathSeparator(const WCHAR c) {
+	return (c == L'\\' || c == L'/');
+}
+
+/// <summary>
+/// Separator to put between the directory and each name. Not needed if the directory ends with one, e.g. "C:\"
+/// </summary>
+static inline UINT32 getSeparatorLength(const WCHAR* pBuffer, const MultiSelectLayout& layout) {
+	return ((layout.directoryLength > 0 && isPathSeparator(pBuffer[layout.directoryLength - 1])) ? 0 : 1);
+}
+
+void scanMultiSelect(const WCHAR* pBuffer, const UINT32 nBufferLength, MultiSelectLayout* pLayout) {
+	MultiSelectLayout layout = MultiSelectLayout();
+	if (pBuffer == NULL || nBufferLength == 0) {
+		layout.requiredLength = 1;
+		*pLayout = layout;
+		return;
+	}
+
+	UINT32 i = 0;
+	while (i < nBufferLength && pBuffer[i] != L'\0') i++;
+	layout.directoryLength = i;
+
+	// 空文字列が来るまで、NULL 区切りの名前を数える
+	UINT32 namesLength = 0;
+	UINT32 pos = i + 1;
+	while (pos < nBufferLength && pBuffer[pos] != L'\0') {
+		UINT32 end = pos;
+		while (end < nBufferLength && pBuffer[end] != L'\0') end++;
+		namesLength += end - pos;
+		layout.fileCount++;
+		pos = end + 1;
+	}
+
+	if (layout.fileCount == 0 || layout.directoryLength == 0) {
+		// 単一選択
+		layout.fileCount = 0;
+		layout.usedLength = (layout.directoryLength < nBufferLength ? layout.directoryLength + 1 : nBufferLength);
+		layout.requiredLength = layout.directoryLength + 1;
+	}
+	else {
+		// ディレクトリ + 区切り + 名前 を改行でつなぎ、最後に終端
+		const UINT32 separator = getSeparatorLength(pBuffer, layout);
+		layout.usedLength = (pos < nBufferLength ? pos : nBufferLength);
+		layout.requiredLength = layout.fileCount * (layout.directoryLength + separator) + namesLength + layout.fileCount;
+	}
+	*pLayout = layout;
+}
+
+BOOL expandMultiSelect(WCHAR* pBuffer, const UINT32 nBufferLength, const MultiSelectLayout& layout) {
+	if (pBuffer == NULL || nBufferLength < layout.requiredLength) return FALSE;
+
+	if (layout.fileCount == 0) {
+		pBuffer[layout.requiredLength - 1] = L'\0';
+		return TRUE;
+	}
+
+	const UINT32 directoryLength = layout.directoryLength;
+	const UINT32 separator = getSeparatorLength(pBuffer, layout);
+
+	// 後ろの名前から、最終的な位置へ移していく
+	//   k 番目の名前の移動先は元の位置より (k * ディレクトリ長) 程度後ろになるため、まだ移していない前の名前を上書きしない
+	//   ただし k 番目の後の改行は、k 番目を移した後で書く（区切りが無い場合に k - 1 番目の末尾と重なるため）
+	UINT32 inEnd = layout.usedLength - 1;			// Null after the current name
+	if (pBuffer[inEnd] != L'\0') inEnd++;			// The last name reached the end of the buffer
+	UINT32 outEnd = layout.requiredLength - 1;		// Exclusive end of the current name in the result
+
+	for (UINT32 k = layout.fileCount; k > 0; k--) {
+		UINT32 inStart = inEnd;
+		while (pBuffer[inStart - 1] != L'\0') inStart--;
+		const UINT32 length = inEnd - inStart;
+		const UINT32 outStart = outEnd - length;
+
+		memmove(pBuffer + outStart, pBuffer + inStart, (size_t)length * sizeof(WCHAR));
+		if (k < layout.fileCount) {
+			pBuffer[outEnd] = L'\n';
+		}
+		if (separator > 0) {
+			pBuffer[outStart - 1] = L'\\';
+		}
+		if (k > 1) {
+			memcpy(pBuffer + outStart - separator - directoryLength, pBuffer, (size_t)directoryLength * sizeof(WCHAR));
+			outEnd = outStart - separator - directoryLength - 1;
+		}
+		inEnd = inStart - 1;
+	}
+
+	pBuffer[layout.requiredLength - 1] = L'\0';
+	return TRUE;
+}
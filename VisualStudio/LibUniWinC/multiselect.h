@@ -0,0 +1,27 @@
+﻿#pragma once
+
+/// <summary>
+/// Layout of the result of OPENFILENAME with OFN_ALLOWMULTISELECT.
+///   A multi-selection is "Directory\0File1\0File2\0...\0\0", and a single selection is "Path\0".
+/// </summary>
+struct MultiSelectLayout {
+	UINT32 directoryLength;		// WCHARs of the directory, or of the path if single
+	UINT32 fileCount;			// Files after the directory. 0 if single
+	UINT32 usedLength;			// WCHARs of the input up to the end of the last name, including its null
+	UINT32 requiredLength;		// WCHARs of the expanded result including the terminator
+};
+
+/// <summary>
+/// Find the entries of the result with one scan
+/// </summary>
+/// <param name="nBufferLength">WCHARs of the buffer. An entry which reaches the end is taken as terminated there</param>
+void scanMultiSelect(const WCHAR* pBuffer, const UINT32 nBufferLength, MultiSelectLayout* pLayout);
+
+/// <summary>
+/// Expand the result into full paths separated by '\n', in place.
+///   The entries are moved from the last one, so no temporary copy is needed and the time is linear in the result.
+///   A single selection is only terminated.
+/// </summary>
+/// <param name="nBufferLength">Must be requiredLength or more, otherwise nothing is changed</param>
+/// <returns>FALSE if the buffer is too small</returns>
+BOOL expandMultiSelect(WCHAR* pBuffer, const UINT32 nBufferLength, const MultiSelectLayout& layout);
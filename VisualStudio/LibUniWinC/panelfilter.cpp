@@ -0,0 +1,275 @@
+﻿// panelfilter.cpp : Compiled filter of the file panels
+
+#include "pch.h"
+#include "panelfilter.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+
+static inline WCHAR toLowerAscii(const WCHAR c) {
+	return ((c >= L'A' && c <= L'Z') ? (WCHAR)(c + (L'a' - L'A')) : c);
+}
+
+static inline BOOL hasWildCard(const WCHAR* s, const size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		if (s[i] == L'*' || s[i] == L'?') return TRUE;
+	}
+	return FALSE;
+}
+
+
+/// <summary>
+/// Filters compiled recently. The newest is at the back
+/// </summary>
+class PanelFilterCache {
+public:
+	static const size_t MAX_COUNT = 16;
+
+	std::shared_ptr<const PanelFilter> get(const WCHAR* lpszText) {
+		size_t length = 0;
+		UINT64 hash = 14695981039346656037ull;	// FNV-1a
+		while (lpszText[length] != L'\0') {
+			hash = (hash ^ (UINT64)lpszText[length]) * 1099511628211ull;
+			length++;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (size_t i = entries_.size(); i > 0; i--) {
+			Entry& entry = entries_[i - 1];
+			if (entry.hash == hash && entry.filter->text_.size() == length
+				&& memcmp(entry.filter->text_.data(), lpszText, length * sizeof(WCHAR)) == 0) {
+				Entry found = entry;
+				entries_.erase(entries_.begin() + (i - 1));
+				entries_.push_back(found);
+				return found.filter;
+			}
+		}
+
+		std::shared_ptr<const PanelFilter> filter = std::make_shared<const PanelFilter>(lpszText, length);
+		if (entries_.size() >= MAX_COUNT) {
+			entries_.erase(entries_.begin());
+		}
+		entries_.push_back({ hash, filter });
+		return filter;
+	}
+
+private:
+	struct Entry {
+		UINT64 hash;
+		std::shared_ptr<const PanelFilter> filter;
+	};
+
+	std::mutex mutex_;
+	std::vector<Entry> entries_;
+};
+
+static PanelFilterCache cache_;
+
+
+PanelFilter::PanelFilter(const WCHAR* lpszText, const size_t length) : text_(lpszText, length), bHasDefaultExt_(FALSE), bMatchAll_(TRUE) {
+	parse();
+	build();
+}
+
+std::shared_ptr<const PanelFilter> PanelFilter::compile(const WCHAR* lpszText) {
+	if (lpszText == NULL) return nullptr;
+	return cache_.get(lpszText);
+}
+
+/// <summary>
+/// Split the text into the groups of the title and the extensions
+/// </summary>
+void PanelFilter::parse() {
+	const UINT32 length = (UINT32)text_.size();
+	UINT32 i = 0;
+
+	while (i < length) {
+		UINT32 lineEnd = i;
+		while (lineEnd < length && text_[lineEnd] != L'\n') lineEnd++;
+
+		if (lineEnd > i) {
+			// 最初の要素がタイトル、以降はタブ区切りの拡張子
+			Group group;
+			UINT32 end = i;
+			while (end < lineEnd && text_[end] != L'\t') end++;
+			group.title = { i, end - i };
+			group.firstExtension = (UINT32)extensions_.size();
+			group.extensionCount = 0;
+			group.bAny = FALSE;
+
+			while (end < lineEnd) {
+				const UINT32 start = end + 1;
+				end = start;
+				while (end < lineEnd && text_[end] != L'\t') end++;
+
+				extensions_.push_back({ start, end - start });
+				group.extensionCount++;
+				if (end - start == 1 && text_[start] == L'*') group.bAny = TRUE;
+			}
+			groups_.push_back(group);
+		}
+		i = lineEnd + 1;
+	}
+}
+
+/// <summary>
+/// Make the filter string, the default extension and the matcher from the groups
+/// </summary>
+void PanelFilter::build() {
+	const WCHAR* text = text_.data();
+
+	// "Title\0*.ext1;*.ext2\0" を繰り返し、最後に NULL を追加
+	//   空のタイトルはそこで終端とみなされてしまうため、パターンをタイトルにする
+	for (const Group& group : groups_) {
+		if (group.title.length > 0) {
+			filterString_.insert(filterString_.end(), text + group.title.offset, text + group.title.offset + group.title.length);
+		}
+		else {
+			appendPatterns(group);
+		}
+		filterString_.push_back(L'\0');
+		appendPatterns(group);
+		filterString_.push_back(L'\0');
+	}
+	if (groups_.empty()) filterString_.push_back(L'\0');
+	filterString_.push_back(L'\0');
+
+	// 最初の組の最初の拡張子。ワイルドカードを含むなら無し
+	if (groups_.empty()) {
+		bHasDefaultExt_ = TRUE;
+	}
+	else {
+		const Group& first = groups_.front();
+		if (first.extensionCount == 0) {
+			bHasDefaultExt_ = TRUE;
+		}
+		else {
+			const Range& ext = extensions_[first.firstExtension];
+			if (!hasWildCard(text + ext.offset, ext.length)) {
+				defaultExt_.assign(text + ext.offset, text + ext.offset + ext.length);
+				bHasDefaultExt_ = TRUE;
+			}
+		}
+	}
+	defaultExt_.push_back(L'\0');
+
+	// 照合用に小文字化。"*" があればすべてに一致させる
+	for (const Range& ext : extensions_) {
+		if (ext.length == 0) continue;
+
+		String lower(text + ext.offset, ext.length);
+		for (WCHAR& c : lower) c = toLowerAscii(c);
+
+		if (lower.size() == 1 && lower[0] == L'*') {
+			matcher_ = ExtensionMatcher();
+			patterns_.clear();
+			bMatchAll_ = TRUE;
+			return;
+		}
+		if (hasWildCard(lower.data(), lower.size())) {
+			patterns_.push_back(String(1, L'*') + String(1, L'.') + lower);
+		}
+		else {
+			matcher_.add(lower.data(), lower.size());
+		}
+	}
+	matcher_.build();
+	bMatchAll_ = (matcher_.isEmpty() && patterns_.empty());
+}
+
+/// <summary>
+/// Append "*.ext1;*.ext2" of the group to the filter string
+/// </summary>
+void PanelFilter::appendPatterns(const Group& group) {
+	const WCHAR* text = text_.data();
+	for (UINT32 e = 0; e < group.extensionCount; e++) {
+		const Range& ext = extensions_[group.firstExtension + e];
+		if (e > 0) filterString_.push_back(L';');
+		if (ext.length > 0) {
+			filterString_.push_back(L'*');
+			filterString_.push_back(L'.');
+			filterString_.insert(filterString_.end(), text + ext.offset, text + ext.offset + ext.length);
+		}
+	}
+}
+
+const WCHAR* PanelFilter::getTitle(const UINT32 group, UINT32* pLength) const {
+	const Range& title = groups_[group].title;
+	if (pLength) *pLength = title.length;
+	return text_.data() + title.offset;
+}
+
+const WCHAR* PanelFilter::getExtension(const UINT32 group, const UINT32 index, UINT32* pLength) const {
+	const Range& ext = extensions_[groups_[group].firstExtension + index];
+	if (pLength) *pLength = ext.length;
+	return text_.data() + ext.offset;
+}
+
+BOOL PanelFilter::match(const WCHAR* name, const size_t length) const {
+	if (bMatchAll_) return TRUE;
+
+	if (matcher_.match(name, length)) return TRUE;
+
+	for (const String& pattern : patterns_) {
+		if (matchPattern(pattern.data(), pattern.size(), name, length)) return TRUE;
+	}
+	return FALSE;
+}
+
+UINT32 PanelFilter::matchPaths(const UINT32* pOffsets, const WCHAR* pData, const UINT32 count, BYTE* pResults) const {
+	if (pOffsets == NULL || pData == NULL || pResults == NULL) return 0;
+
+	if (bMatchAll_) {
+		memset(pResults, 1, count);
+		return count;
+	}
+
+	UINT32 matched = matcher_.matchPaths(pOffsets, pData, count, pResults);
+	if (patterns_.empty()) return matched;
+
+	// ワイルドカードを含む拡張子は、一致しなかったものの名前部分だけ調べる
+	for (UINT32 i = 0; i < count; i++) {
+		if (pResults[i]) continue;
+
+		UINT32 start = pOffsets[i + 1];
+		while (start > pOffsets[i] && pData[start - 1] != L'\\' && pData[start - 1] != L'/') start--;
+		for (const String& pattern : patterns_) {
+			if (matchPattern(pattern.data(), pattern.size(), pData + start, pOffsets[i + 1] - start)) {
+				pResults[i] = 1;
+				matched++;
+				break;
+			}
+		}
+	}
+	return matched;
+}
+
+BOOL PanelFilter::matchPattern(const WCHAR* pattern, const size_t patternLength, const WCHAR* name, const size_t length) {
+	// 直前の '*' の位置まで戻ってやり直す。再帰しないので長い名前でも線形に近い
+	size_t p = 0;
+	size_t n = 0;
+	size_t starPattern = (size_t)-1;
+	size_t starName = 0;
+
+	while (n < length) {
+		if (p < patternLength && pattern[p] == L'*') {
+			starPattern = p++;
+			starName = n;
+		}
+		else if (p < patternLength && (pattern[p] == L'?' || pattern[p] == toLowerAscii(name[n]))) {
+			p++;
+			n++;
+		}
+		else if (starPattern != (size_t)-1) {
+			p = starPattern + 1;
+			n = ++starName;
+		}
+		else {
+			return FALSE;
+		}
+	}
+
+	while (p < patternLength && pattern[p] == L'*') p++;
+	return (p == patternLength);
+}
@@ -0,0 +1,111 @@
+﻿#pragma once
+
+#include "extensionmatcher.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Filter of the file panels compiled from the text "TitleA\tExtA1\tExtA2\nTitleB\tExtB1\n".
+///   The text is parsed once, and the forms for each use are made from the same groups:
+///     - Win32 filter string "TitleA\0*.ExtA1;*.ExtA2\0TitleB\0*.ExtB1\0\0" and the default extension
+///     - Extensions of each group, e.g. for the content types of macOS panels
+///     - Matcher of file names, e.g. for the dropped files
+///   compile() interns the filters by the text, so the same text is not parsed again.
+///   It is immutable after built. Share it by std::shared_ptr<const PanelFilter> with any thread.
+/// </summary>
+class PanelFilter {
+public:
+	/// <summary>
+	/// Parse the text. Empty lines are skipped and there is no limit of the length
+	/// </summary>
+	PanelFilter(const WCHAR* lpszText, const size_t length);
+
+	/// <summary>
+	/// Get the compiled filter of the text, parsing it only if not cached
+	/// </summary>
+	/// <returns>nullptr if the text is NULL</returns>
+	static std::shared_ptr<const PanelFilter> compile(const WCHAR* lpszText);
+
+	/// <summary>
+	/// Null separated filter for OPENFILENAME, terminated by two nulls
+	/// </summary>
+	const WCHAR* getFilterString() const { return filterString_.data(); }
+
+	/// <summary>
+	/// First extension of the first group for OPENFILENAME, e.g. "png"
+	/// </summary>
+	/// <returns>NULL if it includes a wild card</returns>
+	const WCHAR* getDefaultExt() const { return (bHasDefaultExt_ ? defaultExt_.data() : NULL); }
+
+	UINT32 getGroupCount() const { return (UINT32)groups_.size(); }
+	const WCHAR* getTitle(const UINT32 group, UINT32* pLength) const;
+
+	/// <summary>
+	/// TRUE if the group has "*", which means any type
+	/// </summary>
+	BOOL isAnyType(const UINT32 group) const { return groups_[group].bAny; }
+
+	UINT32 getExtensionCount(const UINT32 group) const { return groups_[group].extensionCount; }
+
+	/// <summary>
+	/// Extension without "*." as written in the text
+	/// </summary>
+	/// <param name="index">Index in the group</param>
+	const WCHAR* getExtension(const UINT32 group, const UINT32 index, UINT32* pLength) const;
+
+	/// <summary>
+	/// TRUE if the file name has any extension of any group, or there is no extension
+	///   Extensions are compared case-insensitively for ASCII letters, and "tar.gz" is also available.
+	/// </summary>
+	/// <param name="name">File name without the directory</param>
+	BOOL match(const WCHAR* name, const size_t length) const;
+
+	/// <summary>
+	/// Test the names or paths of an offsets + data list at once
+	/// </summary>
+	/// <param name="pOffsets">count + 1 offsets. Path i is pData[pOffsets[i]] to pData[pOffsets[i + 1] - 1]</param>
+	/// <param name="pResults">Receives 1 for each path which matches, otherwise 0</param>
+	/// <returns>Number of the paths which match</returns>
+	UINT32 matchPaths(const UINT32* pOffsets, const WCHAR* pData, const UINT32 count, BYTE* pResults) const;
+
+	BOOL isMatchAll() const { return bMatchAll_; }
+
+	/// <summary>
+	/// Match a name with a pattern. '*' matches any characters and '?' matches one
+	/// </summary>
+	/// <param name="pattern">Lower case pattern</param>
+	static BOOL matchPattern(const WCHAR* pattern, const size_t patternLength, const WCHAR* name, const size_t length);
+
+private:
+	typedef std::basic_string<WCHAR> String;
+
+	struct Range {
+		UINT32 offset;		// In text_
+		UINT32 length;
+	};
+
+	struct Group {
+		Range title;
+		UINT32 firstExtension;	// In extensions_
+		UINT32 extensionCount;
+		BOOL bAny;
+	};
+
+	String text_;						// Source text, also the key of the cache
+	std::vector<Group> groups_;
+	std::vector<Range> extensions_;
+	std::vector<WCHAR> filterString_;
+	std::vector<WCHAR> defaultExt_;
+	BOOL bHasDefaultExt_;
+
+	ExtensionMatcher matcher_;			// Extensions without a wild card
+	std::vector<String> patterns_;		// Lower case "*.ext" including a wild card
+	BOOL bMatchAll_;
+
+	void parse();
+	void build();
+	void appendPatterns(const Group& group);
+
+	friend class PanelFilterCache;
+};
@@ -0,0 +1,146 @@
+﻿// panelresult.cpp : Results of the file panels kept by handles
+
+#include "pch.h"
+#include "libuniwinc.h"
+#include "panelresult.h"
+#include "multiselect.h"
+#include "textcodec.h"
+#include <cstring>
+
+
+PanelResultArena::PanelResultArena() : nextHandle_(1) {
+}
+
+UINT32 PanelResultArena::showPanel(WindowBackend* pBackend, OPENFILENAMEW& ofn, const WCHAR* lpszInitialFile, const BOOL bSave, PanelRequestState* pState) {
+	if (pState != nullptr) *pState = PanelRequestState::Failed;
+	if (pBackend == nullptr) return 0;
+
+	// GetOpenFileName() は受け取り用のバッファを広げられないため、複数選択では大きめに用意する
+	//   表示している間だけ確保し、結果は必要な長さだけ残す
+	const UINT32 length = ((ofn.Flags & OFN_ALLOWMULTISELECT) ? UNIWINC_PANEL_BUFFER_LENGTH : SINGLE_BUFFER_LENGTH);
+	std::vector<WCHAR> buffer;
+	try {
+		buffer.assign(length, L'\0');
+	}
+	catch (...) {
+		return 0;
+	}
+
+	// Default path
+	if (lpszInitialFile != nullptr) {
+		UINT32 i = 0;
+		for (; i < length - 1 && lpszInitialFile[i] != L'\0'; i++) {
+			buffer[i] = lpszInitialFile[i];
+		}
+	}
+	ofn.lpstrFile = buffer.data();
+	ofn.nMaxFile = (DWORD)length;
+
+	if (!pBackend->getFileNames(&ofn, bSave, buffer)) {
+		ofn.lpstrFile = nullptr;
+		ofn.nMaxFile = 0;
+
+		// 選択が多すぎてバッファに収まらなかった場合は、キャンセルと区別して知らせる
+		if (pState != nullptr) {
+			const DWORD error = pBackend->getFileDialogError();
+			*pState = (error == 0 ? PanelRequestState::Cancelled
+				: (error == FNERR_BUFFERTOOSMALL ? PanelRequestState::TooManyFiles : PanelRequestState::Failed));
+		}
+		return 0;
+	}
+	ofn.lpstrFile = nullptr;
+	ofn.nMaxFile = 0;
+
+	const UINT32 handle = store(buffer);
+	if (handle != 0 && pState != nullptr) *pState = PanelRequestState::Selected;
+	return handle;
+}
+
+UINT32 PanelResultArena::store(std::vector<WCHAR>& buffer) {
+	// 複数選択なら改行区切りに展開して、その長さだけの領域に移す
+	MultiSelectLayout layout;
+	scanMultiSelect(buffer.data(), (UINT32)buffer.size(), &layout);
+
+	std::vector<WCHAR> result;
+	try {
+		if (buffer.size() < layout.requiredLength) {
+			buffer.resize(layout.requiredLength);
+		}
+		expandMultiSelect(buffer.data(), (UINT32)buffer.size(), layout);
+		result.assign(buffer.begin(), buffer.begin() + layout.requiredLength);
+	}
+	catch (...) {
+		return 0;
+	}
+	std::vector<WCHAR>().swap(buffer);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// 0 は結果が無いことを表すので使わない
+	while (nextHandle_ == 0 || results_.count(nextHandle_) > 0) {
+		nextHandle_++;
+	}
+	const UINT32 handle = nextHandle_++;
+	try {
+		results_[handle].swap(result);
+	}
+	catch (...) {
+		return 0;
+	}
+	return handle;
+}
+
+UINT32 PanelResultArena::getLength(const UINT32 handle) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = results_.find(handle);
+	return (it != results_.end() ? (UINT32)it->second.size() : 0);
+}
+
+const WCHAR* PanelResultArena::map(const UINT32 handle) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = results_.find(handle);
+	return (it != results_.end() ? it->second.data() : nullptr);
+}
+
+BOOL PanelResultArena::copy(const UINT32 handle, LPWSTR pBuffer, const UINT32 size) {
+	if (pBuffer == nullptr || size == 0) return FALSE;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = results_.find(handle);
+	if (it == results_.end() || size < it->second.size()) {
+		pBuffer[0] = L'\0';
+		return FALSE;
+	}
+	memcpy(pBuffer, it->second.data(), it->second.size() * sizeof(WCHAR));
+	return TRUE;
+}
+
+INT32 PanelResultArena::copyUtf8(const UINT32 handle, char* pBuffer, const UINT32 size) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = results_.find(handle);
+	if (it == results_.end()) {
+		if (pBuffer != nullptr && size > 0) pBuffer[0] = '\0';
+		return -1;
+	}
+
+	// 終端の \0 も含めて変換する
+	const std::vector<WCHAR>& result = it->second;
+	const size_t length = getUtf8Length(result.data(), result.size());
+	if (pBuffer != nullptr && length <= size) {
+		convertToUtf8(result.data(), result.size(), pBuffer);
+	}
+	else if (pBuffer != nullptr && size > 0) {
+		pBuffer[0] = '\0';
+	}
+	return (INT32)length;
+}
+
+void PanelResultArena::release(const UINT32 handle) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	results_.erase(handle);
+}
+
+UINT32 PanelResultArena::getCount() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (UINT32)results_.size();
+}
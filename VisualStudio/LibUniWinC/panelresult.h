@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include "backend.h"
+#include <map>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Results of the file panels, each kept in a buffer of its exact length until released.
+///   A result is identified by a handle, so the caller asks the length first and copies it once,
+///   or reads it in place while it is not released. Nothing has to be sized by the caller in advance.
+///   Handles are not reused until the counter wraps around. Thread safe.
+/// </summary>
+class PanelResultArena {
+public:
+	PanelResultArena();
+
+	/// <summary>
+	/// Show a panel and keep the result with multi-selections expanded to paths separated by LF
+	///   The receiving buffer is freed before returning, only the result is kept.
+	/// </summary>
+	/// <param name="ofn">Settings of the panel. lpstrFile and nMaxFile are set here</param>
+	/// <param name="lpszInitialFile">Default path, or nullptr</param>
+	/// <param name="pState">Receives Selected, Cancelled, Failed, or TooManyFiles if the selection did not fit in UNIWINC_PANEL_BUFFER_LENGTH. May be nullptr</param>
+	/// <returns>Handle of the result, or 0 if nothing was selected</returns>
+	UINT32 showPanel(WindowBackend* pBackend, OPENFILENAMEW& ofn, const WCHAR* lpszInitialFile, const BOOL bSave, PanelRequestState* pState);
+
+	/// <summary>
+	/// Keep the result received in the buffer of OPENFILENAME
+	/// </summary>
+	/// <returns>Handle of the result, or 0 if failed</returns>
+	UINT32 store(std::vector<WCHAR>& buffer);
+
+	/// <summary>
+	/// Length of the result including the terminator
+	/// </summary>
+	/// <returns>0 if the handle is unknown or released</returns>
+	UINT32 getLength(const UINT32 handle);
+
+	/// <summary>
+	/// The result in place. Valid until the handle is released
+	/// </summary>
+	/// <returns>nullptr if the handle is unknown or released</returns>
+	const WCHAR* map(const UINT32 handle);
+
+	/// <summary>
+	/// Copy the result
+	/// </summary>
+	/// <returns>FALSE if the handle is unknown or the buffer is too small. The buffer is left empty then</returns>
+	BOOL copy(const UINT32 handle, LPWSTR pBuffer, const UINT32 size);
+
+	/// <summary>
+	/// Copy the result in UTF-8 with a terminator
+	/// </summary>
+	/// <param name="pBuffer">nullptr to get the length only</param>
+	/// <returns>Bytes of the result including the terminator, or -1 if the handle is unknown. Not copied if larger than size</returns>
+	INT32 copyUtf8(const UINT32 handle, char* pBuffer, const UINT32 size);
+
+	void release(const UINT32 handle);
+
+	/// <summary>
+	/// Number of the results which are not released
+	/// </summary>
+	UINT32 getCount();
+
+	static const UINT32 SINGLE_BUFFER_LENGTH = 32768;	// Buffer to receive a single selection [WCHARs]. Long paths fit
+
+private:
+	std::mutex mutex_;
+	UINT32 nextHandle_;
+	std::map<UINT32, std::vector<WCHAR>> results_;
+};
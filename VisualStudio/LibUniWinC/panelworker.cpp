@@ -0,0 +1,273 @@
+﻿// panelworker.cpp : Asynchronous file panels shown on a thread owned by the library
+
+#include "pch.h"
+#include "panelworker.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+
+PanelWorker::PanelWorker(PanelResultArena& results) : results_(results), bStopping_(FALSE), nextId_(1) {
+}
+
+PanelWorker::~PanelWorker() {
+	stop();
+}
+
+UINT32 PanelWorker::request(WindowBackend* pBackend, const HWND hOwner, const PPANELSETTINGS pSettings, const DWORD flags, const BOOL bSave) {
+	if (pBackend == nullptr || pSettings == nullptr) return 0;
+
+	std::unique_ptr<Request> pRequest(new (std::nothrow) Request());
+	if (!pRequest) return 0;
+
+	// 呼び出し側の文字列はすぐに解放されるかもしれないので、全てコピーしておく
+	pRequest->bSave = bSave;
+	pRequest->state = PanelRequestState::Queued;
+	pRequest->pBackend = pBackend;
+	pRequest->hOwner = hOwner;
+	pRequest->flags = flags;
+	pRequest->filter = PanelFilter::compile(pSettings->lpszFilter);
+	pRequest->bHasTitle = (pSettings->lpszTitle != nullptr);
+	if (pRequest->bHasTitle) pRequest->title = pSettings->lpszTitle;
+	if (pSettings->lpszInitialFile != nullptr) pRequest->initialFile = pSettings->lpszInitialFile;
+	pRequest->bHasInitialDir = (pSettings->lpszInitialDir != nullptr);
+	if (pRequest->bHasInitialDir) pRequest->initialDir = pSettings->lpszInitialDir;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (bStopping_ || requests_.size() >= UNIWINC_PANEL_MAX_REQUESTS) return 0;
+
+	if (!thread_.joinable()) {
+		try {
+			thread_ = std::thread(&PanelWorker::workerMain, this);
+		}
+		catch (...) {
+			return 0;
+		}
+	}
+
+	// 0 は失敗を表すので使わない
+	while (nextId_ == 0 || requests_.count(nextId_) > 0) {
+		nextId_++;
+	}
+	const UINT32 id = nextId_++;
+	pRequest->id = id;
+
+	try {
+		pending_.push_back(id);
+		requests_[id] = std::move(pRequest);
+	}
+	catch (...) {
+		if (!pending_.empty() && pending_.back() == id) pending_.pop_back();
+		return 0;
+	}
+	condition_.notify_all();
+	return id;
+}
+
+BOOL PanelWorker::cancel(const UINT32 id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Request* pRequest = find(id);
+	if (pRequest == nullptr) return FALSE;
+
+	switch (pRequest->state) {
+	case PanelRequestState::Queued:
+		complete(*pRequest, PanelRequestState::Cancelled);
+		return TRUE;
+	case PanelRequestState::Open:
+		if (!pRequest->bCancelRequested) {
+			pRequest->bCancelRequested = TRUE;
+			closePanel(*pRequest);
+		}
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+PanelRequestState PanelWorker::getState(const UINT32 id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Request* pRequest = find(id);
+	return (pRequest != nullptr ? pRequest->state : PanelRequestState::None);
+}
+
+UINT32 PanelWorker::takeResult(const UINT32 id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Request* pRequest = find(id);
+	if (pRequest == nullptr || pRequest->state != PanelRequestState::Selected) return 0;
+
+	const UINT32 handle = pRequest->hResult;
+	pRequest->hResult = 0;
+	return handle;
+}
+
+void PanelWorker::release(const UINT32 id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Request* pRequest = find(id);
+	if (pRequest == nullptr) return;
+
+	for (size_t i = 0; i < completed_.size(); i++) {
+		if (completed_[i] == id) {
+			completed_.erase(completed_.begin() + i);
+			break;
+		}
+	}
+
+	// 表示中のパネルはスレッドが使っているので、閉じた後にスレッドで削除する
+	if (pRequest->state == PanelRequestState::Open) {
+		pRequest->bReleased = TRUE;
+		if (!pRequest->bCancelRequested) {
+			pRequest->bCancelRequested = TRUE;
+			closePanel(*pRequest);
+		}
+		return;
+	}
+	results_.release(pRequest->hResult);
+	requests_.erase(id);
+}
+
+UINT32 PanelWorker::takeCompleted(UINT32* pIds, const UINT32 maxCount) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	retryClosePanels();
+
+	if (pIds == nullptr || maxCount == 0) return 0;
+
+	const UINT32 count = ((UINT32)completed_.size() < maxCount ? (UINT32)completed_.size() : maxCount);
+	for (UINT32 i = 0; i < count; i++) {
+		pIds[i] = completed_[i];
+	}
+	completed_.erase(completed_.begin(), completed_.begin() + count);
+	return count;
+}
+
+void PanelWorker::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		bStopping_ = TRUE;
+		for (auto& item : requests_) {
+			Request& request = *item.second;
+			if (request.state == PanelRequestState::Queued) {
+				complete(request, PanelRequestState::Cancelled);
+			}
+			else if (request.state == PanelRequestState::Open && !request.bCancelRequested) {
+				request.bCancelRequested = TRUE;
+				closePanel(request);
+			}
+		}
+	}
+	condition_.notify_all();
+
+	// 表示される前に閉じようとしたパネルは、表示されて閉じられるまで閉じ直す
+	//   閉じられないパネル（バックエンドが対応していない場合）は、ユーザーが閉じるまで待つことになる
+	std::unique_lock<std::mutex> retryLock(mutex_);
+	while (retryClosePanels()) {
+		retryLock.unlock();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		retryLock.lock();
+	}
+	retryLock.unlock();
+
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	pending_.clear();
+	bStopping_ = FALSE;
+}
+
+void PanelWorker::workerMain() {
+#ifdef _WIN32
+	// コモンダイアログはSTAで表示する必要がある
+	const HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+#endif
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		condition_.wait(lock, [this] { return (bStopping_ || !pending_.empty()); });
+		if (bStopping_) break;
+
+		// 依頼された順に表示する。キャンセル、解放済みのものは飛ばす
+		const UINT32 id = pending_.front();
+		pending_.pop_front();
+		Request* pRequest = find(id);
+		if (pRequest == nullptr || pRequest->state != PanelRequestState::Queued) continue;
+
+		pRequest->state = PanelRequestState::Open;
+		lock.unlock();
+
+		const PanelRequestState state = runPanel(*pRequest);
+
+		lock.lock();
+		if (pRequest->bReleased) {
+			results_.release(pRequest->hResult);
+			requests_.erase(id);
+			continue;
+		}
+		complete(*pRequest, (pRequest->bCancelRequested ? PanelRequestState::Cancelled : state));
+	}
+	lock.unlock();
+
+#ifdef _WIN32
+	if (SUCCEEDED(hr)) {
+		CoUninitialize();
+	}
+#endif
+}
+
+/// <summary>
+/// Show the panel and keep the result in the arena. Called on the thread without the lock
+/// </summary>
+PanelRequestState PanelWorker::runPanel(Request& request) {
+	OPENFILENAMEW& ofn = request.ofn;
+	ZeroMemory(&ofn, sizeof(ofn));
+	ofn.lStructSize = sizeof(ofn);
+	ofn.hwndOwner = request.hOwner;
+	ofn.lpstrTitle = (request.bHasTitle ? request.title.c_str() : nullptr);
+	ofn.lpstrFilter = (request.filter ? request.filter->getFilterString() : nullptr);
+	ofn.lpstrInitialDir = (request.bHasInitialDir ? request.initialDir.c_str() : nullptr);
+	ofn.lpstrDefExt = (request.filter ? request.filter->getDefaultExt() : nullptr);
+	ofn.Flags = request.flags;
+
+	PanelRequestState state;
+	request.hResult = results_.showPanel(request.pBackend, ofn, request.initialFile.c_str(), request.bSave, &state);
+	return state;
+}
+
+/// <summary>
+/// Ask the backend to close the panel. Retried by takeCompleted() if the panel is not shown yet
+/// </summary>
+void PanelWorker::closePanel(Request& request) {
+	request.bCloseRetry = !request.pBackend->closeFileDialog(&request.ofn);
+}
+
+/// <summary>
+/// キャンセル時にまだ表示されていなかったパネルを閉じ直す。閉じられていないものが残れば TRUE
+/// </summary>
+BOOL PanelWorker::retryClosePanels() {
+	BOOL bRemaining = FALSE;
+	for (auto& item : requests_) {
+		Request& request = *item.second;
+		if (request.state == PanelRequestState::Open && request.bCloseRetry) {
+			closePanel(request);
+			bRemaining |= request.bCloseRetry;
+		}
+	}
+	return bRemaining;
+}
+
+void PanelWorker::complete(Request& request, const PanelRequestState state) {
+	request.state = state;
+	if (state != PanelRequestState::Selected) {
+		results_.release(request.hResult);
+		request.hResult = 0;
+	}
+	completed_.push_back(request.id);
+}
+
+PanelWorker::Request* PanelWorker::find(const UINT32 id) {
+	auto it = requests_.find(id);
+	if (it == requests_.end() || it->second->bReleased) return nullptr;
+	return it->second.get();
+}
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include "backend.h"
+#include "panelfilter.h"
+#include "panelresult.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Asynchronous file panels shown on a thread owned by the library.
+///   The thread is started at the first request and is a single-threaded COM apartment on Windows,
+///   as the common dialogs require. Requests are shown one by one in the order they were made.
+///   The caller is never blocked by a panel: it polls takeCompleted() and takes the result by the request ID.
+///   The results are kept in the arena, and a request is kept until release() is called.
+/// </summary>
+class PanelWorker {
+public:
+	explicit PanelWorker(PanelResultArena& results);
+	~PanelWorker();
+
+	/// <summary>
+	/// Queue a panel. The settings are copied, so the caller may free them at once
+	/// </summary>
+	/// <param name="pBackend">Backend which shows the panel</param>
+	/// <param name="flags">OFN_* flags</param>
+	/// <returns>Request ID, or 0 if too many requests are not released</returns>
+	UINT32 request(WindowBackend* pBackend, const HWND hOwner, const PPANELSETTINGS pSettings, const DWORD flags, const BOOL bSave);
+
+	/// <summary>
+	/// Cancel the request. A queued request is cancelled at once, an open panel is closed
+	/// </summary>
+	/// <returns>FALSE if the request is unknown or has already completed</returns>
+	BOOL cancel(const UINT32 id);
+
+	PanelRequestState getState(const UINT32 id);
+
+	/// <summary>
+	/// Take the handle of the result out of the request. The caller releases it in the arena
+	/// </summary>
+	/// <returns>0 unless the request is Selected, or if already taken</returns>
+	UINT32 takeResult(const UINT32 id);
+
+	/// <summary>
+	/// Forget the request and its result if not taken. An open panel is closed as cancelled
+	/// </summary>
+	void release(const UINT32 id);
+
+	/// <summary>
+	/// Take the IDs of the requests completed since the last call, in the order of completion
+	///   Also retries closing the cancelled panels which were not shown yet at cancel().
+	/// </summary>
+	/// <returns>Number of the IDs written</returns>
+	UINT32 takeCompleted(UINT32* pIds, const UINT32 maxCount);
+
+	/// <summary>
+	/// Cancel all the requests and wait for the thread to exit
+	///   The thread starts again by the next request, which may use another backend
+	/// </summary>
+	void stop();
+
+private:
+	typedef std::basic_string<WCHAR> String;
+
+	struct Request {
+		UINT32 id;
+		BOOL bSave;
+		PanelRequestState state;
+		BOOL bCancelRequested;
+		BOOL bCloseRetry;				// The panel was cancelled but has not been closed yet
+		BOOL bReleased;					// Released while open. Deleted by the thread
+		WindowBackend* pBackend;
+		HWND hOwner;
+		DWORD flags;
+		std::shared_ptr<const PanelFilter> filter;
+		String title;
+		String initialFile;
+		String initialDir;
+		BOOL bHasTitle;
+		BOOL bHasInitialDir;
+		OPENFILENAMEW ofn;				// Valid while open, to close the panel
+		UINT32 hResult;					// Handle of the result in the arena, or 0
+	};
+
+	PanelResultArena& results_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::thread thread_;
+	BOOL bStopping_;
+	UINT32 nextId_;
+	std::map<UINT32, std::unique_ptr<Request>> requests_;
+	std::deque<UINT32> pending_;		// Queued requests in order
+	std::vector<UINT32> completed_;		// Completed since the last takeCompleted()
+
+	void workerMain();
+	PanelRequestState runPanel(Request& request);
+	void closePanel(Request& request);
+	BOOL retryClosePanels();
+	void complete(Request& request, const PanelRequestState state);
+	Request* find(const UINT32 id);
+};
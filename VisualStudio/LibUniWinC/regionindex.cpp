@@ -0,0 +1,255 @@
+﻿// regionindex.cpp : Tiled index of the opaque pixels of a hit test mask
+
+#include "pch.h"
+#include "regionindex.h"
+#include <cstring>
+
+
+/// <summary>
+/// Read 32 bits of a packed row from the byte offset. Bytes beyond the stride are 0
+/// </summary>
+static inline UINT32 readWord(const BYTE* pRow, const UINT32 offset, const UINT32 stride) {
+	UINT32 word = 0;
+	for (UINT32 i = 0; i < 4 && (offset + i) < stride; i++) {
+		word |= ((UINT32)pRow[offset + i] << (8 * i));
+	}
+	return word;
+}
+
+/// <summary>
+/// Map a mask boundary to the client area
+///   The pixel m of the mask covers [boundary(m), boundary(m + 1)), which matches HitTestMask::hitTest()
+/// </summary>
+static inline LONG scaleBoundary(const INT32 m, const INT32 client, const INT32 mask) {
+	return (LONG)(((INT64)m * client + mask - 1) / mask);
+}
+
+
+RegionIndex::RegionIndex() : width_(0), height_(0), tilesX_(0), tilesY_(0), version_(0) {
+}
+
+void RegionIndex::clear() {
+	width_ = 0;
+	height_ = 0;
+	tilesX_ = 0;
+	tilesY_ = 0;
+	states_.clear();
+	blockIndices_.clear();
+	blocks_.clear();
+	freeBlocks_.clear();
+	runs_.clear();
+	dirtyTileRows_.clear();
+	version_++;
+}
+
+void RegionIndex::resize(const INT32 width, const INT32 height) {
+	if (width == width_ && height == height_) return;
+
+	clear();
+	if (width <= 0 || height <= 0) return;
+
+	width_ = width;
+	height_ = height;
+	tilesX_ = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY_ = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	const size_t count = (size_t)tilesX_ * tilesY_;
+	states_.assign(count, TileState::Empty);
+	blockIndices_.assign(count, (UINT32)NO_BLOCK);
+	runs_.resize((size_t)height);
+	dirtyTileRows_.assign((size_t)tilesY_, 0);
+}
+
+/// <summary>
+/// Bits inside the mask width in the tile column
+/// </summary>
+UINT32 RegionIndex::validBits(const INT32 tileX) const {
+	const INT32 n = width_ - tileX * TILE_SIZE;
+	return (n >= TILE_SIZE ? 0xFFFFFFFFu : ((1u << n) - 1));
+}
+
+UINT32 RegionIndex::allocateBlock() {
+	if (!freeBlocks_.empty()) {
+		UINT32 block = freeBlocks_.back();
+		freeBlocks_.pop_back();
+		return block;
+	}
+
+	UINT32 block = (UINT32)(blocks_.size() / TILE_SIZE);
+	blocks_.resize(blocks_.size() + TILE_SIZE);
+	return block;
+}
+
+void RegionIndex::releaseBlock(const INT32 tile) {
+	if (blockIndices_[tile] == NO_BLOCK) return;
+
+	freeBlocks_.push_back(blockIndices_[tile]);
+	blockIndices_[tile] = NO_BLOCK;
+}
+
+BOOL RegionIndex::updateTileRow(const INT32 tileY, const BYTE* pRows, const UINT32 stride) {
+	if (tileY < 0 || tileY >= tilesY_ || pRows == NULL) return FALSE;
+
+	const INT32 rows = ((height_ - tileY * TILE_SIZE) < TILE_SIZE ? (height_ - tileY * TILE_SIZE) : TILE_SIZE);
+	UINT32 words[TILE_SIZE];
+	BOOL bChanged = FALSE;
+
+	for (INT32 tx = 0; tx < tilesX_; tx++) {
+		const UINT32 valid = validBits(tx);
+		BOOL bEmpty = TRUE;
+		BOOL bFull = TRUE;
+
+		for (INT32 r = 0; r < rows; r++) {
+			const UINT32 word = readWord(pRows + (size_t)stride * r, (UINT32)tx * 4, stride) & valid;
+			words[r] = word;
+			if (word != 0) bEmpty = FALSE;
+			if (word != valid) bFull = FALSE;
+		}
+		for (INT32 r = rows; r < TILE_SIZE; r++) {
+			words[r] = 0;
+		}
+
+		const TileState state = (bEmpty ? TileState::Empty : (bFull ? TileState::Full : TileState::Mixed));
+		const INT32 tile = tileY * tilesX_ + tx;
+
+		// 変化の無いタイルは何もしない
+		if (state == states_[tile]) {
+			if (state != TileState::Mixed) continue;
+			if (memcmp(&blocks_[(size_t)blockIndices_[tile] * TILE_SIZE], words, sizeof(words)) == 0) continue;
+		}
+
+		if (state == TileState::Mixed) {
+			if (blockIndices_[tile] == NO_BLOCK) {
+				blockIndices_[tile] = allocateBlock();
+			}
+			memcpy(&blocks_[(size_t)blockIndices_[tile] * TILE_SIZE], words, sizeof(words));
+		}
+		else {
+			releaseBlock(tile);
+		}
+		states_[tile] = state;
+		bChanged = TRUE;
+	}
+
+	if (bChanged) {
+		dirtyTileRows_[tileY] = 1;
+		version_++;
+	}
+	return bChanged;
+}
+
+BOOL RegionIndex::update(const BYTE* pBits, const UINT32 stride, const INT32 width, const INT32 height) {
+	if (pBits == NULL) return FALSE;
+
+	resize(width, height);
+
+	BOOL bChanged = FALSE;
+	for (INT32 ty = 0; ty < tilesY_; ty++) {
+		if (updateTileRow(ty, pBits + (size_t)stride * ty * TILE_SIZE, stride)) {
+			bChanged = TRUE;
+		}
+	}
+	return bChanged;
+}
+
+BOOL RegionIndex::testTile(const INT32 tile, const INT32 x, const INT32 y) const {
+	switch (states_[tile]) {
+	case TileState::Empty:
+		return FALSE;
+	case TileState::Full:
+		return TRUE;
+	default:
+		return ((blocks_[(size_t)blockIndices_[tile] * TILE_SIZE + (y % TILE_SIZE)] >> (x % TILE_SIZE)) & 1) ? TRUE : FALSE;
+	}
+}
+
+BOOL RegionIndex::test(const INT32 x, const INT32 y) const {
+	if (x < 0 || y < 0 || x >= width_ || y >= height_) return FALSE;
+
+	return testTile((y / TILE_SIZE) * tilesX_ + (x / TILE_SIZE), x, y);
+}
+
+RegionIndex::TileState RegionIndex::getTileState(const INT32 tileX, const INT32 tileY) const {
+	if (tileX < 0 || tileY < 0 || tileX >= tilesX_ || tileY >= tilesY_) return TileState::Empty;
+	return states_[(size_t)tileY * tilesX_ + tileX];
+}
+
+/// <summary>
+/// Rebuild the runs of the mask rows in the tile row
+/// </summary>
+void RegionIndex::rebuildRuns(const INT32 tileY) {
+	const INT32 y0 = tileY * TILE_SIZE;
+	const INT32 y1 = ((y0 + TILE_SIZE) < height_ ? (y0 + TILE_SIZE) : height_);
+
+	for (INT32 y = y0; y < y1; y++) {
+		std::vector<Run>& runs = runs_[y];
+		runs.clear();
+
+		for (INT32 tx = 0; tx < tilesX_; tx++) {
+			const INT32 tile = tileY * tilesX_ + tx;
+			const INT32 left = tx * TILE_SIZE;
+
+			UINT32 word;
+			if (states_[tile] == TileState::Empty) continue;
+			if (states_[tile] == TileState::Full) {
+				word = validBits(tx);
+			}
+			else {
+				word = blocks_[(size_t)blockIndices_[tile] * TILE_SIZE + (y - y0)];
+			}
+
+			// 1 が連続する区間を取り出す。タイル境界をまたぐ区間は前の区間とつなげる
+			INT32 bit = 0;
+			while (bit < TILE_SIZE && word != 0) {
+				while (!(word & 1)) {
+					word >>= 1;
+					bit++;
+				}
+				const INT32 start = bit;
+				while (word & 1) {
+					word >>= 1;
+					bit++;
+				}
+
+				if (!runs.empty() && runs.back().right == left + start) {
+					runs.back().right = left + bit;
+				}
+				else {
+					runs.push_back({ left + start, left + bit });
+				}
+			}
+		}
+	}
+}
+
+void RegionIndex::getRects(std::vector<RECT>& rects, const INT32 clientWidth, const INT32 clientHeight) {
+	rects.clear();
+	if (width_ <= 0 || clientWidth <= 0 || clientHeight <= 0) return;
+
+	for (INT32 ty = 0; ty < tilesY_; ty++) {
+		if (dirtyTileRows_[ty]) {
+			rebuildRuns(ty);
+			dirtyTileRows_[ty] = 0;
+		}
+	}
+
+	// 上から順に、同じ区間を持つ行をまとめて帯にする
+	INT32 bandTop = 0;
+	for (INT32 t = 1; t <= height_; t++) {
+		const std::vector<Run>& bandRuns = runs_[height_ - 1 - bandTop];
+		if (t < height_ && runs_[height_ - 1 - t] == bandRuns) continue;
+
+		const LONG top = scaleBoundary(bandTop, clientHeight, height_);
+		const LONG bottom = scaleBoundary(t, clientHeight, height_);
+		if (top < bottom) {
+			for (const Run& run : bandRuns) {
+				const LONG left = scaleBoundary(run.left, clientWidth, width_);
+				const LONG right = scaleBoundary(run.right, clientWidth, width_);
+				if (left < right) {
+					rects.push_back({ left, top, right, bottom });
+				}
+			}
+		}
+		bandTop = t;
+	}
+}
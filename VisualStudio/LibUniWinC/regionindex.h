@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include <vector>
+
+/// <summary>
+/// Index of the opaque pixels of a 1 bit per pixel mask.
+///   The mask is divided into TILE_SIZE x TILE_SIZE tiles classified as empty, full or mixed.
+///   Only mixed tiles keep their bits, so a mostly transparent overlay takes little memory.
+///   Point queries are O(1). Updates compare tile by tile and only the changed tiles are rebuilt.
+///   Rows are bottom-up (row 0 is the bottom), the same as Unity textures.
+///   Not thread safe. HitTestMask serializes the access.
+/// </summary>
+class RegionIndex {
+public:
+	static const INT32 TILE_SIZE = 32;		// One UINT32 per tile row
+
+	enum class TileState : BYTE {
+		Empty = 0,
+		Full = 1,
+		Mixed = 2,
+	};
+
+	RegionIndex();
+
+	void clear();
+	BOOL isEmpty() const { return (width_ <= 0); }
+	INT32 getWidth() const { return width_; }
+	INT32 getHeight() const { return height_; }
+
+	/// <summary>
+	/// Incremented whenever the content changes
+	/// </summary>
+	UINT64 getVersion() const { return version_; }
+
+	/// <summary>
+	/// Set the mask size. The index is cleared if the size changes
+	/// </summary>
+	void resize(const INT32 width, const INT32 height);
+
+	/// <summary>
+	/// Update one row of tiles with LSB first packed rows
+	/// </summary>
+	/// <param name="tileY">Row of tiles. Mask rows from tileY * TILE_SIZE are read</param>
+	/// <param name="pRows">Packed bits of the first mask row of the tile row</param>
+	/// <param name="stride">Bytes per packed row</param>
+	/// <returns>TRUE if any tile has changed</returns>
+	BOOL updateTileRow(const INT32 tileY, const BYTE* pRows, const UINT32 stride);
+
+	/// <summary>
+	/// Update the whole index with LSB first packed rows
+	/// </summary>
+	/// <returns>TRUE if any tile has changed</returns>
+	BOOL update(const BYTE* pBits, const UINT32 stride, const INT32 width, const INT32 height);
+
+	/// <summary>
+	/// Opaque or not at the mask pixel. Coordinates must be inside the mask
+	/// </summary>
+	BOOL test(const INT32 x, const INT32 y) const;
+
+	TileState getTileState(const INT32 tileX, const INT32 tileY) const;
+
+	/// <summary>
+	/// Opaque area as rectangles scaled to the client area
+	///   Rows which have the same runs are merged into one band.
+	/// </summary>
+	/// <param name="rects">Client coordinates, top-down, sorted by y then x</param>
+	void getRects(std::vector<RECT>& rects, const INT32 clientWidth, const INT32 clientHeight);
+
+private:
+	struct Run {
+		INT32 left;
+		INT32 right;		// Exclusive
+		bool operator==(const Run& other) const { return (left == other.left && right == other.right); }
+	};
+
+	static const UINT32 NO_BLOCK = 0xFFFFFFFF;
+
+	INT32 width_;
+	INT32 height_;
+	INT32 tilesX_;
+	INT32 tilesY_;
+	UINT64 version_;
+
+	std::vector<TileState> states_;			// tilesX_ * tilesY_
+	std::vector<UINT32> blockIndices_;		// Block of each mixed tile, or NO_BLOCK
+	std::vector<UINT32> blocks_;			// TILE_SIZE words per mixed tile
+	std::vector<UINT32> freeBlocks_;
+
+	std::vector<std::vector<Run>> runs_;	// Opaque runs of each mask row
+	std::vector<BYTE> dirtyTileRows_;		// Tile rows whose runs have to be rebuilt
+
+	UINT32 validBits(const INT32 tileX) const;
+	UINT32 allocateBlock();
+	void releaseBlock(const INT32 tile);
+	void rebuildRuns(const INT32 tileY);
+	BOOL testTile(const INT32 tile, const INT32 x, const INT32 y) const;
+};
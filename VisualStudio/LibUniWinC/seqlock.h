@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/// <summary>
+/// Value written by one thread and read by any thread without a lock (sequence lock).
+///   The writer makes the sequence odd while writing and even again after it.
+///   A reader copies the value and retries if the sequence was odd or has changed meanwhile.
+///   The writer never waits for the readers, but the readers are only lock-free, not wait-free:
+///   a reader spins while a store is in progress, and retries as long as the writer keeps storing.
+///   The value is small and the window thread stores it a few times per frame at most, so the retries are rare and short.
+///   The value is kept in atomic words, so the copy by a reader is not a data race even if it is torn and retried.
+/// </summary>
+template <typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+	SeqLock() : sequence_(0) {
+		for (UINT32 i = 0; i < WORD_COUNT; i++) {
+			words_[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/// <summary>
+	/// Replace the value. Called only by the writer
+	/// </summary>
+	void store(const T& value) {
+		UINT32 words[WORD_COUNT] = {};
+		memcpy(words, &value, sizeof(T));
+
+		const UINT32 sequence = sequence_.load(std::memory_order_relaxed);
+		sequence_.store(sequence + 1, std::memory_order_relaxed);
+
+		// 各語を release で書くので、語を読んだ読み手には奇数の sequence も見える
+		//   フェンスを使わないのは、ThreadSanitizer がフェンスを扱えないため。x86 ではどちらも普通の書き込みになる
+		for (UINT32 i = 0; i < WORD_COUNT; i++) {
+			words_[i].store(words[i], std::memory_order_release);
+		}
+		sequence_.store(sequence + 2, std::memory_order_release);
+	}
+
+	/// <summary>
+	/// The last value stored. Any thread may call this
+	///   Retries while a store is in progress (see the class)
+	/// </summary>
+	/// <param name="pSequence">Receives the sequence of the value, if not nullptr</param>
+	T load(UINT32* pSequence = nullptr) const {
+		UINT32 words[WORD_COUNT];
+		UINT32 sequence;
+		for (;;) {
+			sequence = sequence_.load(std::memory_order_acquire);
+			if (sequence & 1) continue;		// 書き込み中
+
+			// acquire で読むので、後の sequence の読み取りは語の読み取りより前に出ない
+			for (UINT32 i = 0; i < WORD_COUNT; i++) {
+				words[i] = words_[i].load(std::memory_order_acquire);
+			}
+			if (sequence_.load(std::memory_order_relaxed) == sequence) break;
+		}
+
+		if (pSequence != nullptr) *pSequence = sequence;
+		T value;
+		memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+	/// <summary>
+	/// Incremented by 2 on each store()
+	/// </summary>
+	UINT32 getSequence() const { return sequence_.load(std::memory_order_acquire); }
+
+private:
+	static const UINT32 WORD_COUNT = (UINT32)((sizeof(T) + sizeof(UINT32) - 1) / sizeof(UINT32));
+
+	std::atomic<UINT32> sequence_;
+	std::atomic<UINT32> words_[WORD_COUNT];
+
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+};
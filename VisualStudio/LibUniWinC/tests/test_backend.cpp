@@ -0,0 +1,408 @@
+﻿// test_backend.cpp : The virtual desktop backend and the exported functions on it
+
+#include "unittest.h"
+#include <string>
+
+static int nStyleEvents_ = 0;
+static int nMonitorCount_ = 0;
+static std::u16string droppedPaths_;
+
+static void UNIWINC_API onStyleChanged(INT32 /*type*/) { nStyleEvents_++; }
+static void UNIWINC_API onMonitorChanged(INT32 count) { nMonitorCount_ = count; }
+static void UNIWINC_API onDropFiles(WCHAR* paths) { droppedPaths_ = paths; }
+
+
+TEST(backend, VirtualWindowsKeepZOrderAndGeometry) {
+	VirtualBackend backend;
+	const DWORD pid = backend.getCurrentProcessId();
+	HWND hFirst = backend.createWindow(pid, { 0, 0, 400, 300 }, WS_OVERLAPPEDWINDOW | WS_VISIBLE);
+	HWND hSecond = backend.createWindow(pid + 1, { 100, 100, 300, 200 }, WS_POPUP | WS_VISIBLE);
+
+	// 新しいウィンドウが手前に来る
+	std::vector<HWND> order = backend.getZOrder();
+	REQUIRE(order.size() == 2);
+	CHECK_EQ(hSecond, order[0]);
+	CHECK_EQ(hFirst, order[1]);
+	CHECK_EQ(pid + 1, backend.getWindowProcessId(hSecond));
+
+	// 枠のあるウィンドウのクライアント領域は AdjustWindowRect() 相当の分だけ小さい
+	RECT client;
+	CHECK(backend.getClientRect(hFirst, &client));
+	CHECK_EQ(400 - VirtualBackend::FRAME_BORDER * 2, (int)client.right);
+	CHECK_EQ(300 - VirtualBackend::FRAME_BORDER * 2 - VirtualBackend::CAPTION_HEIGHT, (int)client.bottom);
+
+	CHECK(backend.setWindowPos(hFirst, HWND_TOP, 10, 20, 200, 100, 0));
+	RECT rect;
+	CHECK(backend.getWindowRect(hFirst, &rect));
+	CHECK_EQ(10, (int)rect.left);
+	CHECK_EQ(20, (int)rect.top);
+	CHECK_EQ(210, (int)rect.right);
+	CHECK_EQ(120, (int)rect.bottom);
+	CHECK_EQ(hFirst, backend.getZOrder()[0]);
+
+	backend.destroyWindow(hFirst);
+	CHECK(!backend.isWindow(hFirst));
+	CHECK_EQ((size_t)1, backend.getZOrder().size());
+}
+
+TEST(backend, AttachAndDetachRestoreTheWindow) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	const LONG originalStyle = desktop.backend.getFrameStyle(hWnd);
+
+	CHECK(!IsActive());
+	CHECK(AttachMyWindow());
+	CHECK(IsActive());
+	CHECK_EQ(hWnd, GetWindowHandle());
+
+	SetBorderless(TRUE);
+	CHECK(IsBorderless());
+	CHECK_EQ(0, (int)(desktop.backend.getFrameStyle(hWnd) & WS_CAPTION));
+
+	CHECK(DetachWindow());
+	CHECK(!IsActive());
+	CHECK_EQ(originalStyle, desktop.backend.getFrameStyle(hWnd));
+}
+
+TEST(backend, BorderlessKeepsTheClientSize) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	float width, height;
+	CHECK(GetClientSize(&width, &height));
+	const float clientWidth = width;
+	const float clientHeight = height;
+
+	SetBorderless(TRUE);
+	CHECK(GetClientSize(&width, &height));
+	CHECK_EQ(clientWidth, width);
+	CHECK_EQ(clientHeight, height);
+	CHECK(GetSize(&width, &height));
+	CHECK_EQ(clientWidth, width);
+	CHECK_EQ(clientHeight, height);
+}
+
+/// <summary>
+/// Calls and refreshes caused by the function, counted by the backend and by GetRefreshStats()
+/// </summary>
+struct RefreshCost {
+	UINT64 setWindowPos;
+	UINT64 sizeMessages;
+	UINT32 frameChanges;
+	UINT32 resizeTricks;
+	UINT32 swapchainRebuilds;
+};
+
+template <typename F>
+static RefreshCost measureRefresh(VirtualDesktop& desktop, F function) {
+	ResetRefreshStats();
+	desktop.backend.resetCallCounts();
+	function();
+
+	REFRESHSTATS stats;
+	stats.nStructSize = sizeof(stats);
+	GetRefreshStats(&stats);
+	const VirtualBackend::CallCounts counts = desktop.backend.getCallCounts();
+	return { counts.setWindowPos, counts.sizeMessages, stats.nFrameChanges, stats.nResizeTricks, stats.nSwapchainRebuilds };
+}
+
+TEST(backend, FrameChangedModeResizesOnce) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetRefreshMode((INT32)RefreshMode::FrameChanged);
+
+	float width, height;
+	REQUIRE(GetClientSize(&width, &height));
+	const float clientWidth = width;
+	const float clientHeight = height;
+
+	// 枠の付け外しは SWP_FRAMECHANGED の SetWindowPos 1回で、WM_SIZE も1回
+	for (int i = 0; i < 4; i++) {
+		const BOOL bBorderless = (i % 2 == 0);
+		const RefreshCost cost = measureRefresh(desktop, [&]() { SetBorderless(bBorderless); });
+		CHECK_EQ((UINT64)1, cost.setWindowPos);
+		CHECK_EQ((UINT64)1, cost.sizeMessages);
+		CHECK_EQ((UINT32)1, cost.frameChanges);
+		CHECK_EQ((UINT32)0, cost.resizeTricks);
+		CHECK_EQ((UINT32)0, cost.swapchainRebuilds);
+
+		CHECK(GetClientSize(&width, &height));
+		CHECK_EQ(clientWidth, width);
+		CHECK_EQ(clientHeight, height);
+		CHECK_EQ(bBorderless, (BOOL)((desktop.backend.getFrameStyle(hWnd) & WS_CAPTION) == 0));
+	}
+
+	// 1px の変更と戻しを毎回行うと、SetWindowPos と WM_SIZE は2回ずつで、バッファも2回作り直される
+	SetRefreshMode((INT32)RefreshMode::ResizeTrick);
+	const RefreshCost trick = measureRefresh(desktop, [&]() { SetBorderless(TRUE); });
+	CHECK_EQ((UINT64)2, trick.setWindowPos);
+	CHECK_EQ((UINT64)2, trick.sizeMessages);
+	CHECK_EQ((UINT32)2, trick.frameChanges);
+	CHECK_EQ((UINT32)1, trick.resizeTricks);
+	CHECK_EQ((UINT32)2, trick.swapchainRebuilds);
+
+	DetachWindow();
+}
+
+TEST(backend, ResizeTrickIsTheFallbackOnlyWhenNeeded) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetRefreshMode((INT32)RefreshMode::FrameChanged);
+
+	float width, height;
+	REQUIRE(GetClientSize(&width, &height));
+	const float clientWidth = width;
+	const float clientHeight = height;
+
+	// 位置とサイズを変えない反映（透明化など）も、普段は1回で済む
+	RefreshCost cost = measureRefresh(desktop, [&]() { SetTransparent(TRUE); SetTransparent(FALSE); });
+	CHECK_EQ((UINT32)0, cost.resizeTricks);
+	CHECK_EQ(cost.setWindowPos, (UINT64)cost.frameChanges);
+
+	// 次のリサイズまで枠が反映されないウィンドウでは、その時だけ 1px の変更で反映させる
+	desktop.backend.setFrameChangeDeferred(TRUE);
+	cost = measureRefresh(desktop, [&]() { SetBorderless(TRUE); });
+	CHECK_EQ((UINT32)1, cost.resizeTricks);
+	CHECK_EQ((UINT32)3, cost.frameChanges);
+	CHECK_EQ((UINT64)3, cost.setWindowPos);
+	CHECK(GetClientSize(&width, &height));
+	CHECK_EQ(clientWidth, width);
+	CHECK_EQ(clientHeight, height);
+	CHECK_EQ(0, (int)(desktop.backend.getFrameStyle(hWnd) & WS_CAPTION));
+
+	// 反映できていれば、次からはまた1回
+	desktop.backend.setFrameChangeDeferred(FALSE);
+	cost = measureRefresh(desktop, [&]() { SetBorderless(FALSE); });
+	CHECK_EQ((UINT32)0, cost.resizeTricks);
+	CHECK_EQ((UINT64)1, cost.setWindowPos);
+	CHECK(GetClientSize(&width, &height));
+	CHECK_EQ(clientWidth, width);
+	CHECK_EQ(clientHeight, height);
+
+	DetachWindow();
+}
+
+TEST(backend, BatchedChangesAreWrittenOnce) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	const LONG style = desktop.backend.getWindowLong(hWnd, GWL_STYLE);
+	const LONG exStyle = desktop.backend.getWindowLong(hWnd, GWL_EXSTYLE);
+
+	// アタッチ時のような一連の変更でも、スタイルは GWL_STYLE と GWL_EXSTYLE に1回ずつ、SetWindowPos も1回
+	desktop.backend.resetCallCounts();
+	BeginWindowUpdate();
+	SetAlphaValue(0.5f);
+	SetTransparent(TRUE);
+	SetBorderless(TRUE);
+	SetTopmost(TRUE);
+	SetClickThrough(TRUE);
+	SetAllowDrop(TRUE);
+	CHECK(CommitWindowUpdate());
+
+	VirtualBackend::CallCounts counts = desktop.backend.getCallCounts();
+	CHECK_EQ((UINT64)2, counts.setWindowLong);
+	CHECK_EQ((UINT64)1, counts.setWindowPos);
+	CHECK_EQ((UINT64)1, counts.setLayeredWindowAttributes);
+	CHECK(desktop.backend.getWindowLong(hWnd, GWL_STYLE) != style);
+	CHECK(desktop.backend.getWindowLong(hWnd, GWL_EXSTYLE) != exStyle);
+	CHECK_EQ(0, (int)(desktop.backend.getFrameStyle(hWnd) & WS_CAPTION));
+	CHECK((desktop.backend.getWindowLong(hWnd, GWL_EXSTYLE) & WS_EX_TOPMOST) != 0);
+	CHECK_EQ(hWnd, desktop.backend.getZOrder()[0]);
+	CHECK_EQ((int)(BYTE)(0xFF * 0.5f), (int)desktop.backend.getLayeredAlpha(hWnd));
+
+	// 同じ状態を設定し直すだけなら、何も書き込まない
+	desktop.backend.resetCallCounts();
+	BeginWindowUpdate();
+	SetAlphaValue(0.5f);
+	SetTransparent(TRUE);
+	SetBorderless(TRUE);
+	SetTopmost(TRUE);
+	SetClickThrough(TRUE);
+	SetAllowDrop(TRUE);
+	CHECK(CommitWindowUpdate());
+
+	counts = desktop.backend.getCallCounts();
+	CHECK_EQ((UINT64)0, counts.setWindowLong);
+	CHECK_EQ((UINT64)0, counts.setWindowPos);
+	CHECK_EQ((UINT64)0, counts.showWindow);
+
+	// 途中で元に戻した変更も書き込まない
+	desktop.backend.resetCallCounts();
+	BeginWindowUpdate();
+	SetBorderless(FALSE);
+	SetTopmost(FALSE);
+	SetBorderless(TRUE);
+	SetTopmost(TRUE);
+	CHECK(CommitWindowUpdate());
+
+	counts = desktop.backend.getCallCounts();
+	CHECK_EQ((UINT64)0, counts.setWindowLong);
+	CHECK_EQ((UINT64)0, counts.setWindowPos);
+
+	DetachWindow();
+}
+
+TEST(backend, TopmostAndAlphaReachTheWindow) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	desktop.backend.createWindow(desktop.backend.getCurrentProcessId() + 1, { 0, 0, 100, 100 }, WS_POPUP | WS_VISIBLE);
+	REQUIRE(AttachWindowHandle(hWnd));
+
+	SetTopmost(TRUE);
+	CHECK(IsTopmost());
+	CHECK((desktop.backend.getWindowLong(hWnd, GWL_EXSTYLE) & WS_EX_TOPMOST) != 0);
+	CHECK_EQ(hWnd, desktop.backend.getZOrder()[0]);
+
+	SetAlphaValue(0.5f);
+	CHECK_EQ((int)(BYTE)(0xFF * 0.5f), (int)desktop.backend.getLayeredAlpha(hWnd));
+
+	SetTopmost(FALSE);
+	CHECK((desktop.backend.getWindowLong(hWnd, GWL_EXSTYLE) & WS_EX_TOPMOST) == 0);
+}
+
+TEST(backend, PositionIsFromTheBottomLeftOfThePrimaryMonitor) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	float x, y;
+	CHECK(GetPosition(&x, &y));
+	CHECK_EQ(100.0f, x);
+	CHECK_EQ(1080.0f - 700.0f, y);
+
+	CHECK(SetPosition(10, 20));
+	CHECK(GetPosition(&x, &y));
+	CHECK_EQ(10.0f, x);
+	CHECK_EQ(20.0f, y);
+
+	// サイズを変えても左下は動かない
+	CHECK(SetSize(400, 300));
+	CHECK(GetPosition(&x, &y));
+	CHECK_EQ(10.0f, x);
+	CHECK_EQ(20.0f, y);
+
+	RECT rect;
+	desktop.backend.getWindowRect(hWnd, &rect);
+	CHECK_EQ(1080 - 20, (int)rect.bottom);
+	CHECK_EQ(400, (int)(rect.right - rect.left));
+}
+
+TEST(backend, MaximizeAndMonitors) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	REQUIRE(RegisterMonitorChangedCallback(onMonitorChanged));
+
+	CHECK_EQ(1, GetMonitorCount());
+	desktop.backend.addMonitor({ 1920, 0, 3840, 1080 });
+	desktop.backend.notifyDisplayChange();
+	CHECK_EQ(2, GetMonitorCount());
+	CHECK_EQ(2, nMonitorCount_);
+
+	float x, y, width, height;
+	CHECK(GetMonitorRectangle(1, &x, &y, &width, &height));
+	CHECK_EQ(1920.0f, x);
+	CHECK_EQ(1920.0f, width);
+	CHECK(!GetMonitorRectangle(2, &x, &y, &width, &height));
+
+	SetMaximized(TRUE);
+	CHECK(IsMaximized());
+	SetMaximized(FALSE);
+	CHECK(!IsMaximized());
+}
+
+TEST(backend, StyleChangesAndDropsAreNotified) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	REQUIRE(RegisterWindowStyleChangedCallback(onStyleChanged));
+	REQUIRE(RegisterDropFilesCallback(onDropFiles));
+
+	nStyleEvents_ = 0;
+	SetBorderless(TRUE);
+	CHECK(nStyleEvents_ > 0);
+
+	// ドロップを許可するまでは受け付けない
+	CHECK(!desktop.backend.dropFiles(hWnd, { u"C:\\a.txt" }));
+	CHECK(SetAllowDrop(TRUE));
+	CHECK(desktop.backend.isAcceptingFiles(hWnd));
+	CHECK(desktop.backend.dropFiles(hWnd, { u"C:\\a.txt", u"C:\\bb.png" }));
+	// 従来通り、各パスの後に LF が付く
+	CHECK(droppedPaths_ == u"C:\\a.txt\nC:\\bb.png\n");
+}
+
+TEST(backend, SnapshotGenerationIgnoresTheCursor) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	WINDOWSNAPSHOT snapshot = WINDOWSNAPSHOT();
+	snapshot.nStructSize = sizeof(snapshot);
+	REQUIRE(GetWindowSnapshot(&snapshot));
+	CHECK(snapshot.nFlags & (INT32)WindowSnapshotFlag::Changed);
+
+	// カーソルが動いても変化とはしないが、その位置は返す
+	const UINT32 generation = snapshot.nGeneration;
+	for (int i = 0; i < 10; i++) {
+		desktop.backend.moveCursor(200 + i * 10, 300);
+		REQUIRE(GetWindowSnapshot(&snapshot));
+		CHECK_EQ(generation, snapshot.nGeneration);
+		CHECK(!(snapshot.nFlags & (INT32)WindowSnapshotFlag::Changed));
+		CHECK_EQ((float)(200 + i * 10), snapshot.cursorX);
+		CHECK_EQ((float)(1080 - 300 - 1), snapshot.cursorY);
+	}
+
+	// ウィンドウが動けば変わる
+	SetPosition(10, 20);
+	REQUIRE(GetWindowSnapshot(&snapshot));
+	CHECK(snapshot.nGeneration != generation);
+	CHECK(snapshot.nFlags & (INT32)WindowSnapshotFlag::Changed);
+	CHECK_EQ(10.0f, snapshot.x);
+}
+
+
+/// <summary>
+/// Cost of the functions which the managed side calls every frame, with a window attached
+/// </summary>
+BENCHMARK(backend, PerFrameExports) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	const int count = 200000;
+	float x, y;
+	BOOL result = FALSE;
+
+	struct Export {
+		const char* name;
+		void (*function)(float*, float*, BOOL*);
+	};
+	const Export exports[] = {
+		{ "IsActive", [](float*, float*, BOOL* r) { *r ^= IsActive(); } },
+		{ "IsTopmost", [](float*, float*, BOOL* r) { *r ^= IsTopmost(); } },
+		{ "IsMaximized", [](float*, float*, BOOL* r) { *r ^= IsMaximized(); } },
+		{ "GetPosition", [](float* px, float* py, BOOL* r) { *r ^= GetPosition(px, py); } },
+		{ "GetSize", [](float* px, float* py, BOOL* r) { *r ^= GetSize(px, py); } },
+		{ "GetClientSize", [](float* px, float* py, BOOL* r) { *r ^= GetClientSize(px, py); } },
+		{ "GetCursorPosition", [](float* px, float* py, BOOL* r) { *r ^= GetCursorPosition(px, py); } },
+		{ "GetCurrentMonitor", [](float*, float*, BOOL* r) { *r ^= GetCurrentMonitor(); } },
+		{ "GetMonitorRectangle", [](float* px, float* py, BOOL* r) { float w, h; *r ^= GetMonitorRectangle(0, px, py, &w, &h); } },
+		{ "GetWindowSnapshot", [](float*, float*, BOOL* r) { WINDOWSNAPSHOT s; s.nStructSize = sizeof(s); *r ^= GetWindowSnapshot(&s); } },
+		{ "SetPosition (same place)", [](float*, float*, BOOL* r) { *r ^= SetPosition(10, 20); } },
+		{ "SetTopmost (unchanged)", [](float*, float*, BOOL*) { SetTopmost(FALSE); } },
+		{ "Update", [](float*, float*, BOOL*) { Update(); } },
+	};
+
+	for (const Export& e : exports) {
+		Stopwatch stopwatch;
+		for (int i = 0; i < count; i++) {
+			e.function(&x, &y, &result);
+		}
+		report(e.name, stopwatch.getNanoseconds() / count, "ns/call");
+	}
+	keepValue(result);
+}
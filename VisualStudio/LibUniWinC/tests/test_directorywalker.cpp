@@ -0,0 +1,248 @@
+﻿// test_directorywalker.cpp : Recursive expansion of the dropped folders, walked in a temporary directory tree
+
+#include "unittest.h"
+#include "directorywalker.h"
+#include "textcodec.h"
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Drop arena with the paths as a list, as the window thread would have received
+/// </summary>
+static void setDroppedPaths(DropArena& source, const UINT32 dropId, const std::vector<std::string>& paths) {
+	std::vector<WCHAR> data;
+	std::vector<UINT32> lengths;
+	for (const std::string& p : paths) {
+		const size_t start = data.size();
+		appendUtf16(p.data(), p.size(), data);
+		lengths.push_back((UINT32)(data.size() - start));
+	}
+	source.beginList(dropId);
+	source.appendList(data.data(), lengths.data(), (UINT32)lengths.size());
+}
+
+/// <summary>
+/// All the paths in the arena in UTF-8
+/// </summary>
+static std::vector<std::string> readPaths(DropArena& arena) {
+	std::vector<std::string> paths;
+	std::vector<WCHAR> path;
+	const UINT32 dropId = arena.getDropId();
+	for (UINT32 i = 0; arena.getPath(dropId, i, path); i++) {
+		std::string utf8;
+		appendUtf8(path.data(), path.size() - 1, utf8);
+		paths.push_back(utf8);
+	}
+	return paths;
+}
+
+static std::set<std::string> toSet(const std::vector<std::string>& paths) {
+	return std::set<std::string>(paths.begin(), paths.end());
+}
+
+/// <summary>
+/// Wait for the walk as the window thread does every frame
+/// </summary>
+static BOOL waitForWalk(DirectoryWalker& walker, const int timeoutMilliseconds) {
+	Stopwatch stopwatch;
+	while (walker.isRunning(nullptr)) {
+		if (stopwatch.getMicroseconds() > timeoutMilliseconds * 1000.0) return FALSE;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Folders with files under the directory
+/// </summary>
+/// <returns>Paths of the files</returns>
+static std::vector<std::string> makeTree(TempDirectory& temp, const std::string& name, const int directories, const int filesPerDirectory) {
+	std::vector<std::string> files;
+	temp.makeDirectory(name);
+	for (int d = 0; d < directories; d++) {
+		const std::string dir = name + "/d" + std::to_string(d);
+		temp.makeDirectory(dir);
+		for (int f = 0; f < filesPerDirectory; f++) {
+			files.push_back(temp.write(dir + "/f" + std::to_string(f) + ".txt", "x"));
+		}
+	}
+	return files;
+}
+
+
+TEST(directorywalker, MaxDepthLimitsTheFiles) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	const std::string root = temp.makeDirectory("root");
+	const std::string a = temp.write("root/a.txt", "a");
+	temp.makeDirectory("root/d1");
+	const std::string b = temp.write("root/d1/b.txt", "b");
+	temp.makeDirectory("root/d1/d2");
+	const std::string c = temp.write("root/d1/d2/c.txt", "c");
+	const std::string dropped = temp.write("dropped.txt", "d");
+
+	DropArena source, results;
+	setDroppedPaths(source, 5, { root, dropped });
+	DirectoryWalker walker(results);
+
+	// ドロップされたフォルダの中のファイルが深さ 1
+	walker.configure(nullptr, 2, 2);
+	walker.start(source);
+	REQUIRE(waitForWalk(walker, 10000));
+	CHECK(toSet(readPaths(results)) == std::set<std::string>({ a, b, dropped }));
+	CHECK_EQ((UINT32)5, results.getDropId());
+	CHECK_EQ((UINT32)2, walker.getDirectoryCount());
+
+	walker.configure(nullptr, 1, 2);
+	walker.start(source);
+	REQUIRE(waitForWalk(walker, 10000));
+	CHECK(toSet(readPaths(results)) == std::set<std::string>({ a, dropped }));
+
+	// 0 以下は既定の深さ
+	walker.configure(nullptr, 0, 2);
+	walker.start(source);
+	REQUIRE(waitForWalk(walker, 10000));
+	CHECK(toSet(readPaths(results)) == std::set<std::string>({ a, b, c, dropped }));
+	CHECK_EQ((UINT32)3, walker.getDirectoryCount());
+}
+
+TEST(directorywalker, SymbolicLinkLoopIsEnteredOnce) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	const std::string root = temp.makeDirectory("root");
+	const std::string a = temp.write("root/a.txt", "a");
+	temp.makeDirectory("root/sub");
+	const std::string b = temp.write("root/sub/b.txt", "b");
+	REQUIRE(!temp.makeLink("root/sub/up", root).empty());
+	REQUIRE(!temp.makeLink("root/self", ".").empty());
+	const std::string link = temp.makeLink("root/b_link.txt", b);
+
+	DropArena source, results;
+	setDroppedPaths(source, 1, { root, root + "/sub/up" });
+	DirectoryWalker walker(results);
+	walker.configure(nullptr, 64, 4);
+	walker.start(source);
+	REQUIRE(waitForWalk(walker, 10000));
+
+	// ファイルへのリンクは別のパスとして数えるが、ディレクトリには一度しか入らない
+	const std::vector<std::string> paths = readPaths(results);
+	CHECK_EQ(paths.size(), toSet(paths).size());
+	CHECK(toSet(paths) == std::set<std::string>({ a, b, link }));
+	CHECK_EQ((UINT32)2, walker.getDirectoryCount());
+}
+
+TEST(directorywalker, FilterOfThePanelsIsReused) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	const std::string root = temp.makeDirectory("root");
+	const std::string png = temp.write("root/a.png", "");
+	const std::string jpg = temp.write("root/B.JPG", "");
+	temp.write("root/c.txt", "");
+	temp.makeDirectory("root/sub.png");
+	const std::string nested = temp.write("root/sub.png/d.jpg", "");
+	const std::string droppedPng = temp.write("e.png", "");
+	const std::string droppedTxt = temp.write("f.txt", "");
+
+	// パネルと同じ文字列のフィルタは、作り直さずに共有される
+	const std::u16string text = u"Image\tpng\tjpg\n";
+	std::shared_ptr<const PanelFilter> filter = PanelFilter::compile((const WCHAR*)text.c_str());
+	CHECK(filter == PanelFilter::compile((const WCHAR*)text.c_str()));
+
+	DropArena source, results;
+	setDroppedPaths(source, 1, { root, droppedPng, droppedTxt });
+	DirectoryWalker walker(results);
+	walker.configure(filter, 8, 2);
+	walker.start(source);
+	REQUIRE(waitForWalk(walker, 10000));
+	CHECK(toSet(readPaths(results)) == std::set<std::string>({ png, jpg, nested, droppedPng }));
+
+	// フィルタを外すと全てのファイル
+	walker.configure(nullptr, 8, 2);
+	walker.start(source);
+	REQUIRE(waitForWalk(walker, 10000));
+	CHECK_EQ((size_t)6, readPaths(results).size());
+}
+
+TEST(directorywalker, PathsArriveInBatchesWhileWalking) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	const UINT32 total = DirectoryWalker::BATCH_SIZE * 4 + 10;
+	const std::vector<std::string> files = makeTree(temp, "root", 1, (int)total);
+
+	DropArena source, results;
+	setDroppedPaths(source, 1, { temp.path + "/root" });
+	DirectoryWalker walker(results);
+	walker.configure(nullptr, 8, 1);
+	walker.start(source);
+
+	// ワーカー 1 つで 1 つのディレクトリなら、終わるまではバッチ単位で増える
+	Stopwatch stopwatch;
+	UINT32 last = 0;
+	while (walker.isRunning(nullptr) && stopwatch.getMicroseconds() < 10000000.0) {
+		const UINT32 count = results.getCount();
+		if (count < total) {
+			CHECK_EQ((UINT32)0, count % DirectoryWalker::BATCH_SIZE);
+		}
+		CHECK(count >= last);
+		last = count;
+		std::this_thread::yield();
+	}
+	REQUIRE(!walker.isRunning(nullptr));
+	CHECK(toSet(readPaths(results)) == toSet(files));
+}
+
+TEST(directorywalker, CancelDoesNotWaitAndKeepsTheResultsApart) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	makeTree(temp, "large", 200, 50);
+	const std::vector<std::string> small = makeTree(temp, "small", 2, 3);
+
+	DropArena large, smallSource, results;
+	setDroppedPaths(large, 1, { temp.path + "/large" });
+	setDroppedPaths(smallSource, 2, { temp.path + "/small" });
+	DirectoryWalker walker(results);
+	walker.configure(nullptr, 8, 4);
+
+	for (int round = 0; round < 20; round++) {
+		walker.start(large);
+		std::this_thread::sleep_for(std::chrono::microseconds(200 * (round % 4)));
+
+		// 取り消した後は結果が増えない
+		walker.cancel();
+		CHECK(!walker.isRunning(nullptr));
+		const UINT32 count = results.getCount();
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		CHECK_EQ(count, results.getCount());
+
+		// 前の走査のスレッドを待たずに次を始め、その結果だけが残る
+		walker.start(smallSource);
+		REQUIRE(waitForWalk(walker, 10000));
+		CHECK_EQ((UINT32)2, results.getDropId());
+		CHECK(toSet(readPaths(results)) == toSet(small));
+	}
+
+	// 取り消した走査のスレッドも、終われば回収される
+	Stopwatch stopwatch;
+	while (walker.getRetiredCount() > 0 && stopwatch.getMicroseconds() < 10000000.0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK_EQ((UINT32)0, walker.getRetiredCount());
+}
+
+TEST(directorywalker, DestroyingDuringAWalkWaitsForTheWorkers) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	makeTree(temp, "large", 100, 50);
+
+	DropArena source, results;
+	setDroppedPaths(source, 1, { temp.path + "/large" });
+	for (int round = 0; round < 10; round++) {
+		DirectoryWalker walker(results);
+		walker.configure(nullptr, 8, 4);
+		walker.start(source);
+		if (round % 2 == 1) walker.cancel();
+	}
+	CHECK_EQ((UINT32)1, results.getDropId());
+}
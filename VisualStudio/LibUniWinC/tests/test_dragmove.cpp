@@ -0,0 +1,240 @@
+﻿// test_dragmove.cpp : Native window dragging, driven by scripted cursor traces on the virtual clock
+
+#include "unittest.h"
+#include "dragmove.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Cursor of a fast swipe with a wobble, sampled by a 1 kHz mouse
+/// </summary>
+/// <param name="t">Time since the start [ms]</param>
+static POINT swipeTrace(const int t) {
+	const double s = t / 1000.0;
+	return { (LONG)(500 + 900 * s + 40 * std::sin(s * 40)), (LONG)(400 + 150 * std::sin(s * 6)) };
+}
+
+/// <summary>
+/// Two monitors side by side and a popup window on the left one, dragged by the cursor at (500, 400)
+/// </summary>
+static HWND setUpDesktop(VirtualDesktop& desktop) {
+	desktop.backend.clearMonitors();
+	desktop.backend.addMonitor({ 0, 0, 1920, 1080 });
+	desktop.backend.addMonitor({ 1920, 0, 3840, 1080 });
+	const HWND hWnd = desktop.backend.createWindow(desktop.backend.getCurrentProcessId(), { 100, 100, 900, 700 }, WS_POPUP | WS_VISIBLE);
+	AttachMyWindow();
+	EnableEventQueue(TRUE);
+	desktop.backend.setCursorPos(500, 400);
+	return hWnd;
+}
+
+static RECT getRect(VirtualDesktop& desktop, const HWND hWnd) {
+	RECT rect = { 0, 0, 0, 0 };
+	desktop.backend.getWindowRect(hWnd, &rect);
+	return rect;
+}
+
+/// <summary>
+/// nParam of the DragMoveEnded events since the last call
+/// </summary>
+static std::vector<INT32> takeDragMoveEnded() {
+	std::vector<INT32> result;
+	UNIWINCEVENT events[64];
+	INT32 n;
+	while ((n = PollEvents(events, 64)) > 0) {
+		for (INT32 i = 0; i < n; i++) {
+			if (events[i].nType == (INT32)EventType::DragMoveEnded) result.push_back(events[i].nParam);
+		}
+	}
+	return result;
+}
+
+
+TEST(dragmove, MoverKeepsTheOffsetAndSnaps) {
+	const std::vector<RECT> rects = { { 0, 0, 1920, 1080 }, { 1920, 0, 3840, 1080 } };
+	const std::vector<HMONITOR> handles = { (HMONITOR)1, (HMONITOR)2 };
+	const MonitorTopology topology(rects, handles, 1);
+
+	DragMover mover;
+	POINT position = { -1, -1 };
+	CHECK(!mover.move({ 10, 10 }, topology, &position));
+
+	mover.begin({ 500, 400 }, { 100, 100, 900, 700 });
+	CHECK(mover.isDragging());
+	CHECK(mover.move({ 510, 380 }, topology, &position));
+	CHECK(position.x == 110 && position.y == 80);
+	CHECK(!mover.move({ 510, 380 }, topology, &position));		// Not moved
+
+	// 近い辺に吸い付き、離れれば外れる。右の辺は大部分が乗っているモニターの辺に合わせる
+	mover.setSnapDistance(16);
+	const LONG xs[] = { 410, 385, 380, 1510, 1525, 1540 };
+	const LONG lefts[] = { 0, 0, -20, 1120, 1120, 1140 };
+	for (int i = 0; i < 6; i++) {
+		mover.move({ xs[i], 600 }, topology, &position);
+		CHECK_EQ(lefts[i], position.x);
+	}
+	CHECK(mover.move({ 1515, 305 }, topology, &position));
+	CHECK(position.x == 1120 && position.y == 0);
+
+	mover.setSnapDistance(-5);
+	CHECK_EQ(0, mover.getSnapDistance());
+	mover.end();
+	CHECK(!mover.isDragging());
+	CHECK(!mover.move({ 700, 700 }, topology, &position));
+}
+
+TEST(dragmove, WindowFollowsTheCursorAtInputRate) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+	desktop.backend.setPrimaryButton(TRUE);
+	REQUIRE(BeginDragMove());
+	CHECK(IsDragMoving());
+
+	// 描画のフレームを待たず、カーソルが動くたびにずれなく付いてくる
+	desktop.backend.resetCallCounts();
+	double maxError = 0;
+	for (int t = 1; t <= 500; t++) {
+		const POINT cursor = swipeTrace(t);
+		desktop.backend.moveCursor(cursor.x, cursor.y);
+		desktop.backend.advanceTime(1);
+		const RECT rect = getRect(desktop, hWnd);
+		const double error = std::hypot((double)(rect.left - (cursor.x - 400)), (double)(rect.top - (cursor.y - 300)));
+		if (error > maxError) maxError = error;
+	}
+	CHECK_EQ(0.0, maxError);
+	CHECK(desktop.backend.getCallCounts().setWindowPos <= 500);
+	const RECT rect = getRect(desktop, hWnd);
+	CHECK(rect.right - rect.left == 800 && rect.bottom - rect.top == 600);
+
+	desktop.backend.setPrimaryButton(FALSE);
+	CHECK(!IsDragMoving());
+	const std::vector<INT32> ended = takeDragMoveEnded();
+	REQUIRE(ended.size() == 1);
+	CHECK_EQ(1, ended[0]);
+}
+
+TEST(dragmove, SnapsToTheEdgesOfTheMonitors) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+	SetDragMoveSnap(TRUE, 16);
+	desktop.backend.setPrimaryButton(TRUE);
+	REQUIRE(BeginDragMove());
+
+	const INT xs[] = { 410, 385, 380, 1510, 1525, 1540 };
+	const LONG lefts[] = { 0, 0, -20, 1120, 1120, 1140 };
+	for (int i = 0; i < 6; i++) {
+		desktop.backend.moveCursor(xs[i], 400);
+		desktop.backend.advanceTime(10);
+		CHECK_EQ(lefts[i], getRect(desktop, hWnd).left);
+	}
+
+	// 角では両方の辺に吸い付く
+	desktop.backend.moveCursor(1515, 305);
+	desktop.backend.advanceTime(10);
+	const RECT rect = getRect(desktop, hWnd);
+	CHECK(rect.top == 0 && rect.right == 1920);
+
+	desktop.backend.setPrimaryButton(FALSE);
+}
+
+TEST(dragmove, ReleaseOutsideTheWindowIsNoticedByTheTimer) {
+	VirtualDesktop desktop;
+	setUpDesktop(desktop);
+	desktop.backend.setPrimaryButton(TRUE);
+	REQUIRE(BeginDragMove());
+
+	// ウィンドウの外で離されると WM_LBUTTONUP は来ないが、次のタイマーで終わる
+	desktop.backend.setCursorPos(3500, 1000);
+	desktop.backend.setPrimaryButton(FALSE);
+	CHECK(IsDragMoving());
+	desktop.backend.advanceTime(10);
+	CHECK(!IsDragMoving());
+	const std::vector<INT32> ended = takeDragMoveEnded();
+	REQUIRE(ended.size() == 1);
+	CHECK_EQ(1, ended[0]);
+}
+
+TEST(dragmove, EndedByTheCallOrTheWindowState) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+
+	// ボタンを押さずに始めたら、EndDragMove() まで続く
+	REQUIRE(BeginDragMove());
+	desktop.backend.advanceTime(100);
+	desktop.backend.moveCursor(520, 420);
+	CHECK(IsDragMoving());
+	CHECK_EQ((LONG)120, getRect(desktop, hWnd).left);
+	EndDragMove();
+	CHECK(!IsDragMoving());
+	std::vector<INT32> ended = takeDragMoveEnded();
+	REQUIRE(ended.size() == 1);
+	CHECK_EQ(0, ended[0]);
+
+	// 最大化すると終わり、最大化中は始められない
+	desktop.backend.setPrimaryButton(TRUE);
+	REQUIRE(BeginDragMove());
+	desktop.backend.showWindow(hWnd, SW_MAXIMIZE);
+	CHECK(!IsDragMoving());
+	ended = takeDragMoveEnded();
+	REQUIRE(ended.size() == 1);
+	CHECK_EQ(0, ended[0]);
+	CHECK(!BeginDragMove());
+	desktop.backend.setPrimaryButton(FALSE);
+	desktop.backend.showWindow(hWnd, SW_RESTORE);
+
+	// ウィンドウを離しても終わる
+	desktop.backend.setPrimaryButton(TRUE);
+	REQUIRE(BeginDragMove());
+	DetachWindow();
+	CHECK(!IsDragMoving());
+	ended = takeDragMoveEnded();
+	REQUIRE(ended.size() == 1);
+	CHECK_EQ(0, ended[0]);
+	desktop.backend.setPrimaryButton(FALSE);
+}
+
+
+BENCHMARK(dragmove, LagBehindTheCursor) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+
+	// 同じ軌跡を、ネイティブのドラッグと、60 fps の SetPosition() で追う
+	for (int mode = 0; mode < 2; mode++) {
+		SetPosition(100, 1080 - 100 - 600);
+		desktop.backend.setCursorPos(500, 400);
+		desktop.backend.setPrimaryButton(TRUE);
+		takeDragMoveEnded();
+
+		float windowX, windowY, cursorX, cursorY;
+		GetPosition(&windowX, &windowY);
+		GetCursorPosition(&cursorX, &cursorY);
+		const float dx = windowX - cursorX;
+		const float dy = windowY - cursorY;
+		if (mode == 0) BeginDragMove();
+
+		desktop.backend.resetCallCounts();
+		double maxError = 0;
+		double sumError = 0;
+		for (int t = 1; t <= 500; t++) {
+			const POINT cursor = swipeTrace(t);
+			desktop.backend.moveCursor(cursor.x, cursor.y);
+			desktop.backend.advanceTime(1);
+			if (mode == 1 && (t % 16) == 0) {
+				GetCursorPosition(&cursorX, &cursorY);
+				SetPosition(cursorX + dx, cursorY + dy);
+			}
+
+			const RECT rect = getRect(desktop, hWnd);
+			const double error = std::hypot((double)(rect.left - (cursor.x - 400)), (double)(rect.top - (cursor.y - 300)));
+			if (error > maxError) maxError = error;
+			sumError += error;
+		}
+		desktop.backend.setPrimaryButton(FALSE);
+
+		const std::string label = (mode == 0 ? "BeginDragMove" : "SetPosition per frame");
+		report(label + " max lag", maxError, "px");
+		report(label + " mean lag", sumError / 500, "px");
+		report(label + " SetWindowPos", (double)desktop.backend.getCallCounts().setWindowPos, "calls");
+	}
+}
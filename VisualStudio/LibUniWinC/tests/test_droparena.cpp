@@ -0,0 +1,362 @@
+﻿// test_droparena.cpp : The paths of a drop read by pages, and a drop of 100k paths
+
+#include "unittest.h"
+#include "droparena.h"
+#include <string>
+#include <vector>
+
+static std::u16string toU16(const std::string& s) {
+	return std::u16string(s.begin(), s.end());
+}
+
+/// <summary>
+/// Synthetic paths of an asset folder
+/// </summary>
+static std::vector<std::u16string> makeAssetPaths(const int count) {
+	std::vector<std::u16string> paths;
+	paths.reserve(count);
+	for (int i = 0; i < count; i++) {
+		paths.push_back(toU16("C:\\Users\\someone\\Projects\\Game\\Assets\\Textures\\Set" + std::to_string(i / 1000) + "\\texture_" + std::to_string(i) + ".png"));
+	}
+	return paths;
+}
+
+/// <summary>
+/// Read all the paths of the last drop by GetDropFiles()
+/// </summary>
+static std::vector<std::u16string> readAllPages(const UINT32 maxCount, const UINT32 dataCapacity, UINT32* pPages) {
+	std::vector<std::u16string> paths;
+	std::vector<UINT32> offsets(maxCount + 1);
+	std::vector<WCHAR> data(dataCapacity);
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+	*pPages = 0;
+
+	UINT32 first = 0;
+	for (;;) {
+		INT32 count = GetDropFiles(first, offsets.data(), maxCount, data.data(), (UINT32)data.size(), &page);
+		if (count < 0) break;
+		if (count == 0) {
+			// 1つも入らなければバッファを広げて読み直す
+			if (page.nNextLength == 0) break;
+			data.resize(page.nNextLength);
+			continue;
+		}
+		for (INT32 i = 0; i < count; i++) {
+			paths.emplace_back(data.data() + offsets[i], data.data() + offsets[i + 1]);
+		}
+		first += (UINT32)count;
+		(*pPages)++;
+	}
+	return paths;
+}
+
+
+TEST(droparena, PathsMayContainNewlinesAndBeLong) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+
+	const std::vector<std::u16string> paths = {
+		u"C:\\a.txt", u"C:\\line\nbreak.txt", std::u16string(5000, u'x'), u"",
+	};
+	const UINT64 queries = desktop.backend.getCallCounts().dragQueryFile;
+	REQUIRE(desktop.backend.dropFiles(hWnd, paths));
+
+	// パスごとに1回だけ問い合わせる（長いパスは長さの問い合わせが増える）
+	CHECK(desktop.backend.getCallCounts().dragQueryFile - queries <= paths.size() + 2);
+
+	UINT32 pages = 0;
+	std::vector<std::u16string> read = readAllPages(2, 16, &pages);
+	REQUIRE(read.size() == paths.size());
+	for (size_t i = 0; i < paths.size(); i++) {
+		CHECK(read[i] == paths[i]);
+	}
+	CHECK(pages >= 3);
+
+	DetachWindow();
+}
+
+TEST(droparena, PageReportsTheCountsAndTheNextLength) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+	REQUIRE(desktop.backend.dropFiles(hWnd, { u"abc", u"defgh", u"ij" }));
+
+	UINT32 offsets[4];
+	WCHAR data[8];
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+	CHECK_EQ(1, GetDropFiles(0, offsets, 3, data, 6, &page));
+	CHECK_EQ((UINT32)3, page.nTotalCount);
+	CHECK_EQ((UINT32)3, page.nAvailableCount);
+	CHECK_EQ((UINT32)1, page.nCount);
+	CHECK_EQ((UINT32)3, page.nDataLength);
+	CHECK_EQ((UINT32)5, page.nNextLength);
+	const UINT32 dropId = page.nDropId;
+
+	CHECK_EQ(2, GetDropFiles(1, offsets, 3, data, 8, &page));
+	CHECK_EQ((UINT32)0, page.nNextLength);
+	CHECK(std::u16string(data + offsets[1], data + offsets[2]) == u"ij");
+
+	// UTF-8 ではバイト単位
+	char bytes[16];
+	CHECK_EQ(3, GetDropFilesUtf8(0, offsets, 3, bytes, 16, &page));
+	CHECK_EQ((UINT32)10, page.nDataLength);
+	CHECK(std::string(bytes + offsets[1], bytes + offsets[2]) == "defgh");
+
+	// 次のドロップで ID が変わる
+	REQUIRE(desktop.backend.dropFiles(hWnd, { u"k" }));
+	CHECK_EQ(1, GetDropFiles(0, offsets, 3, data, 6, &page));
+	CHECK(page.nDropId != dropId);
+	CHECK_EQ(-1, GetDropFiles(0, offsets, 3, data, 6, nullptr));
+
+	DetachWindow();
+}
+
+TEST(droparena, StreamingTakesThePathsWithinTheBudget) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+	EnableEventQueue(TRUE);
+	EnableDropStreaming(TRUE, 1);
+
+	const std::vector<std::u16string> paths = makeAssetPaths(20000);
+	REQUIRE(desktop.backend.dropFiles(hWnd, paths));
+
+	UINT32 offsets[2];
+	WCHAR data[256];
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+	GetDropFiles(0, offsets, 1, data, 256, &page);
+	CHECK_EQ((UINT32)paths.size(), page.nTotalCount);
+	CHECK(page.nAvailableCount < page.nTotalCount);
+
+	// PollEvents() ごとに少しずつ取り込まれ、最後に FilesDropped が来る
+	UNIWINCEVENT events[64];
+	BOOL bBegin = FALSE, bFinished = FALSE;
+	for (int i = 0; i < 100000 && !bFinished; i++) {
+		INT32 count = PollEvents(events, 64);
+		for (INT32 k = 0; k < count; k++) {
+			if (events[k].nType == (INT32)EventType::DropBegin) bBegin = TRUE;
+			if (events[k].nType == (INT32)EventType::FilesDropped) {
+				bFinished = TRUE;
+				CHECK_EQ((INT32)paths.size(), events[k].nParam);
+			}
+		}
+	}
+	CHECK(bBegin);
+	REQUIRE(bFinished);
+
+	UINT32 pages = 0;
+	std::vector<std::u16string> read = readAllPages(4096, 1 << 16, &pages);
+	REQUIRE(read.size() == paths.size());
+	CHECK(read.front() == paths.front());
+	CHECK(read.back() == paths.back());
+
+	EnableDropStreaming(FALSE, 0);
+	DetachWindow();
+}
+
+TEST(droparena, EachStepOfTheStreamStaysWithinTheBudget) {
+	VirtualBackend backend;
+	DropArena arena;
+	const std::vector<std::u16string> paths = makeAssetPaths(5000);
+	HDROP hDrop = backend.createDrop(paths);
+	REQUIRE(arena.beginStream(&backend, hDrop) == (UINT32)paths.size());
+	CHECK(arena.isStreaming());
+	CHECK_EQ((UINT32)0, arena.getCount());
+
+	// 予算 0 でも 1 回の判定間隔（32 パス）だけは進む
+	BOOL bFinished = FALSE;
+	CHECK_EQ((UINT32)32, arena.continueStream(0, &bFinished));
+	CHECK(!bFinished);
+
+	// 時刻は 32 パスごとに見るので、最後の回以外は 32 の倍数ずつ進む
+	std::vector<WCHAR> joined;
+	UINT32 joinedCount = arena.appendJoined(0, joined, u'|');
+	UINT32 steps = 1;
+	while (!bFinished) {
+		const UINT32 before = arena.getCount();
+		Stopwatch stopwatch;
+		const UINT32 count = arena.continueStream(200, &bFinished);
+		const double elapsed = stopwatch.getMicroseconds();
+		steps++;
+
+		CHECK(count > 0);
+		CHECK_EQ(before + count, arena.getCount());
+		if (!bFinished) {
+			CHECK_EQ((UINT32)0, count % 32);
+		}
+		// 予算の超過は最後の 32 パス分まで。遅い環境を考えて余裕を見る
+		CHECK(elapsed < 200.0 + 20000.0);
+		joinedCount = arena.appendJoined(joinedCount, joined, u'|');
+	}
+	CHECK(steps > 1);
+	CHECK(!arena.isStreaming());
+	CHECK_EQ((UINT32)paths.size(), arena.getCount());
+	CHECK_EQ((UINT64)1, backend.getCallCounts().dragFinish);
+
+	// 少しずつ繋げた文字列は、最後にまとめて繋げたものと同じ
+	CHECK_EQ((UINT32)paths.size(), joinedCount);
+	std::vector<WCHAR> all;
+	arena.join(all, u'|');
+	joined.push_back(0);
+	CHECK(joined == all);
+
+	// 終わった後は何もしない
+	CHECK(!arena.finishStream());
+	CHECK_EQ((UINT32)0, arena.continueStream(1000, &bFinished));
+	CHECK_EQ((UINT64)1, backend.getCallCounts().dragFinish);
+}
+
+static std::vector<std::u16string> droppedStrings_;
+
+TEST(droparena, DropDuringAStreamWaitsForIt) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+	EnableEventQueue(TRUE);
+	EnableDropStreaming(TRUE, 1);
+	droppedStrings_.clear();
+	RegisterDropFilesCallback([](WCHAR* p) { droppedStrings_.emplace_back(p); });
+
+	const std::vector<std::u16string> first = makeAssetPaths(20000);
+	const std::vector<std::u16string> second = { u"C:\\a.txt", u"C:\\b.txt", u"C:\\c.txt" };
+	REQUIRE(desktop.backend.dropFiles(hWnd, first));
+
+	// 2 つ目のドロップは前のドロップを急かさず、パスも問い合わせずに待つ
+	const UINT64 queries = desktop.backend.getCallCounts().dragQueryFile;
+	REQUIRE(desktop.backend.dropFiles(hWnd, second));
+	CHECK_EQ(queries, desktop.backend.getCallCounts().dragQueryFile);
+	CHECK_EQ((UINT64)0, desktop.backend.getCallCounts().dragFinish);
+	CHECK(droppedStrings_.empty());
+
+	// 順に DropBegin と FilesDropped が来る
+	std::vector<UNIWINCEVENT> received;
+	UNIWINCEVENT events[64];
+	INT32 dropped = 0;
+	for (int i = 0; i < 100000 && dropped < 2; i++) {
+		INT32 count = PollEvents(events, 64);
+		for (INT32 k = 0; k < count; k++) {
+			if (events[k].nType == (INT32)EventType::DropBegin || events[k].nType == (INT32)EventType::FilesDropped) {
+				received.push_back(events[k]);
+			}
+			if (events[k].nType == (INT32)EventType::FilesDropped) dropped++;
+		}
+	}
+	REQUIRE(received.size() == 4);
+	CHECK_EQ((INT32)EventType::DropBegin, received[0].nType);
+	CHECK_EQ((INT32)first.size(), received[0].nParam);
+	CHECK_EQ((INT32)EventType::FilesDropped, received[1].nType);
+	CHECK_EQ((INT32)first.size(), received[1].nParam);
+	CHECK_EQ((INT32)EventType::DropBegin, received[2].nType);
+	CHECK_EQ((INT32)second.size(), received[2].nParam);
+	CHECK_EQ((INT32)EventType::FilesDropped, received[3].nType);
+	CHECK_EQ((INT32)second.size(), received[3].nParam);
+	CHECK_EQ((UINT64)2, desktop.backend.getCallCounts().dragFinish);
+
+	// コールバックはドロップごとに 1 回、全てのパスを受け取る
+	REQUIRE(droppedStrings_.size() == 2);
+	std::u16string expected;
+	for (const std::u16string& p : first) expected += p + u"\n";
+	CHECK(droppedStrings_[0] == expected);
+	CHECK(droppedStrings_[1] == u"C:\\a.txt\nC:\\b.txt\nC:\\c.txt\n");
+
+	// 止めると、待っているドロップもその場で取り込む
+	REQUIRE(desktop.backend.dropFiles(hWnd, first));
+	REQUIRE(desktop.backend.dropFiles(hWnd, second));
+	EnableDropStreaming(FALSE, 0);
+	CHECK_EQ((UINT64)4, desktop.backend.getCallCounts().dragFinish);
+	REQUIRE(droppedStrings_.size() == 4);
+	CHECK(droppedStrings_[2] == expected);
+	CHECK(droppedStrings_[3] == droppedStrings_[1]);
+
+	DetachWindow();
+}
+
+TEST(droparena, ListsAreKeptAsTheyAreAppended) {
+	DropArena arena;
+	arena.beginList(7);
+	const WCHAR data[] = { u'a', u'b', u'\n', u'c' };
+	const UINT32 lengths[] = { 3, 0, 1 };
+	arena.appendList(data, lengths, 3);
+	arena.appendList(data + 3, lengths + 2, 1);
+
+	CHECK_EQ((UINT32)4, arena.getCount());
+	CHECK_EQ((UINT32)7, arena.getDropId());
+
+	std::vector<WCHAR> path;
+	REQUIRE(arena.getPath(7, 0, path));
+	CHECK(std::u16string(path.data()) == u"ab\n");
+	REQUIRE(arena.getPath(7, 1, path));
+	CHECK_EQ((WCHAR)0, path[0]);
+	CHECK(!arena.getPath(8, 0, path));
+	CHECK(!arena.getPath(7, 4, path));
+
+	std::vector<WCHAR> joined;
+	arena.join(joined, u'|');
+	CHECK(std::u16string(joined.data()) == u"ab\n||c|c|");
+}
+
+
+BENCHMARK(droparena, Drop100kPaths) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+
+	const std::vector<std::u16string> paths = makeAssetPaths(100000);
+	UINT64 characters = 0;
+	for (const std::u16string& p : paths) characters += p.size();
+
+	std::vector<UINT32> offsets(4097);
+	std::vector<WCHAR> data(1 << 18);
+	std::vector<char> bytes(1 << 18);
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+
+	// 2回目以降はブロックが再利用される
+	for (int round = 0; round < 3; round++) {
+		const UINT64 queries = desktop.backend.getCallCounts().dragQueryFile;
+		Stopwatch stopwatch;
+		desktop.backend.dropFiles(hWnd, paths);
+		const double collect = stopwatch.getMicroseconds();
+		const UINT64 queried = desktop.backend.getCallCounts().dragQueryFile - queries;
+
+		stopwatch.restart();
+		UINT32 first = 0;
+		INT32 count;
+		while ((count = GetDropFiles(first, offsets.data(), 4096, data.data(), (UINT32)data.size(), &page)) > 0) {
+			first += (UINT32)count;
+		}
+		const double paging = stopwatch.getMicroseconds();
+
+		stopwatch.restart();
+		first = 0;
+		while ((count = GetDropFilesUtf8(first, offsets.data(), 4096, bytes.data(), (UINT32)bytes.size(), &page)) > 0) {
+			first += (UINT32)count;
+		}
+		const double pagingUtf8 = stopwatch.getMicroseconds();
+
+		const std::string prefix = "round " + std::to_string(round + 1) + ": ";
+		report(prefix + "collect", collect / 1000.0, "ms");
+		report(prefix + "DragQueryFile per path", (double)queried / paths.size(), "calls");
+		report(prefix + "GetDropFiles all pages", paging / 1000.0, "ms");
+		report(prefix + "GetDropFilesUtf8 all pages", pagingUtf8 / 1000.0, "ms");
+		keepValue(first);
+	}
+	report("paths of the drop", characters / 1000000.0, "M WCHARs");
+
+	// 従来の LF 区切りの文字列コールバックと比べる
+	RegisterDropFilesCallback([](WCHAR* p) { keepValue(p[0]); });
+	Stopwatch stopwatch;
+	desktop.backend.dropFiles(hWnd, paths);
+	report("collect + LF joined callback", stopwatch.getMicroseconds() / 1000.0, "ms");
+
+	DetachWindow();
+}
@@ -0,0 +1,263 @@
+﻿// test_dropfileinfo.cpp : Metadata of the dropped files, read from a temporary directory tree
+
+#include "unittest.h"
+#include "dropfileinfo.h"
+#include "textcodec.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// UTF-8 to a null terminated UTF-16 path
+/// </summary>
+static std::vector<WCHAR> toPath(const std::string& utf8) {
+	std::vector<WCHAR> result(utf8.size() + 1, 0);
+	result.resize(convertToUtf16(utf8.data(), utf8.size(), result.data()) + 1);
+	result.back() = 0;
+	return result;
+}
+
+static std::u16string toU16(const std::string& utf8) {
+	std::vector<WCHAR> path = toPath(utf8);
+	return std::u16string(path.data(), path.size() - 1);
+}
+
+static DROPFILEINFO query(const std::string& utf8) {
+	DROPFILEINFO info;
+	DropFileInfoPool::queryFile(toPath(utf8).data(), &info);
+	return info;
+}
+
+static INT32 sniff(const std::string& head) {
+	return (INT32)DropFileInfoPool::sniffType((const BYTE*)head.data(), (UINT32)head.size());
+}
+
+/// <summary>
+/// Poll until the results of count paths are ready, checking that the ready count never goes back
+/// </summary>
+static BOOL waitForInfo(const INT32 count) {
+	UNIWINCEVENT events[64];
+	INT32 ready = 0;
+	BOOL bMonotonic = TRUE;
+	for (int i = 0; i < 5000 && ready < count; i++) {
+		INT32 n = PollEvents(events, 64);
+		for (INT32 k = 0; k < n; k++) {
+			if (events[k].nType != (INT32)EventType::DropInfoReady) continue;
+			if (events[k].nParam < ready) bMonotonic = FALSE;
+			ready = events[k].nParam;
+		}
+		if (ready < count) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(bMonotonic);
+	return (ready == count);
+}
+
+
+TEST(dropfileinfo, SniffTypeRecognizesTheMagicBytes) {
+	CHECK_EQ((INT32)DropFileType::Png, sniff(std::string("\x89PNG\r\n\x1A\n", 8)));
+	CHECK_EQ((INT32)DropFileType::Jpeg, sniff("\xFF\xD8\xFF\xE0"));
+	CHECK_EQ((INT32)DropFileType::Gif, sniff("GIF89a"));
+	CHECK_EQ((INT32)DropFileType::WebP, sniff(std::string("RIFF\0\0\0\0WEBPVP8 ", 16)));
+	CHECK_EQ((INT32)DropFileType::Wav, sniff(std::string("RIFF\0\0\0\0WAVEfmt ", 16)));
+	CHECK_EQ((INT32)DropFileType::Unknown, sniff(std::string("RIFF\0\0\0\0AVI ", 12)));
+	CHECK_EQ((INT32)DropFileType::Tiff, sniff(std::string("II*\0", 4)));
+	CHECK_EQ((INT32)DropFileType::Bmp, sniff(std::string("BM\0\0\0\0\0\0\0\0\0\0\0\0", 14)));
+	CHECK_EQ((INT32)DropFileType::Unknown, sniff("BM"));
+	CHECK_EQ((INT32)DropFileType::Pdf, sniff("%PDF-1.7"));
+	CHECK_EQ((INT32)DropFileType::Zip, sniff("PK\x03\x04"));
+	CHECK_EQ((INT32)DropFileType::Gzip, sniff("\x1F\x8B\x08"));
+	CHECK_EQ((INT32)DropFileType::SevenZip, sniff("7z\xBC\xAF\x27\x1C"));
+	CHECK_EQ((INT32)DropFileType::Ogg, sniff("OggS"));
+	CHECK_EQ((INT32)DropFileType::Flac, sniff("fLaC"));
+	CHECK_EQ((INT32)DropFileType::Mp4, sniff(std::string("\0\0\0\x18" "ftypmp42", 12)));
+	CHECK_EQ((INT32)DropFileType::Mp3, sniff("ID3\x04"));
+	CHECK_EQ((INT32)DropFileType::Mp3, sniff("\xFF\xFB\x90"));
+	CHECK_EQ((INT32)DropFileType::Glb, sniff("glTF\x02"));
+	CHECK_EQ((INT32)DropFileType::Fbx, sniff("Kaydara FBX Binary  "));
+
+	// BOM は MP3 のフレーム同期より優先
+	CHECK_EQ((INT32)DropFileType::Text, sniff("\xEF\xBB\xBFhello"));
+	CHECK_EQ((INT32)DropFileType::Text, sniff("\xFF\xFEh\0"));
+	CHECK_EQ((INT32)DropFileType::Text, sniff("\xFE\xFF\0h"));
+
+	CHECK_EQ((INT32)DropFileType::Unknown, sniff(""));
+	CHECK_EQ((INT32)DropFileType::Unknown, sniff("plain text"));
+	CHECK_EQ((INT32)DropFileType::Unknown, (INT32)DropFileInfoPool::sniffType(nullptr, 4));
+}
+
+TEST(dropfileinfo, QueryFileReadsTheTemporaryTree) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+
+	const std::string png = temp.write("a.png", std::string("\x89PNG\r\n\x1A\n0000", 12));
+	const std::string glb = temp.write("model.glb", "glTF\x02");
+	const std::string empty = temp.write("empty", "");
+	const std::string japanese = temp.write(u8"日本語.pdf", "%PDF-1.7");
+	const std::string sub = temp.makeDirectory("sub");
+
+	// 更新時刻をミリ秒まで指定する
+	struct timeval times[2] = { { 1700000000, 250000 }, { 1700000000, 250000 } };
+	REQUIRE(utimes(png.c_str(), times) == 0);
+
+	DROPFILEINFO info = query(png);
+	CHECK_EQ((UINT64)12, info.nSize);
+	CHECK_EQ((INT64)1700000000250, info.nModifiedTime);
+	CHECK_EQ((INT32)DropFileFlag::Exists, info.nFlags);
+	CHECK_EQ((INT32)DropFileType::Png, info.nType);
+
+	CHECK_EQ((INT32)DropFileType::Glb, query(glb).nType);
+	CHECK_EQ((UINT64)8, query(japanese).nSize);
+	CHECK_EQ((INT32)DropFileType::Pdf, query(japanese).nType);
+
+	info = query(empty);
+	CHECK_EQ((UINT64)0, info.nSize);
+	CHECK_EQ((INT32)DropFileFlag::Exists, info.nFlags);
+	CHECK_EQ((INT32)DropFileType::Unknown, info.nType);
+
+	info = query(sub);
+	CHECK_EQ((INT32)DropFileFlag::Exists | (INT32)DropFileFlag::Directory, info.nFlags);
+	CHECK_EQ((UINT64)0, info.nSize);
+	CHECK(info.nModifiedTime > 0);
+
+	info = query(temp.path + "/missing");
+	CHECK_EQ(0, info.nFlags);
+	CHECK_EQ((INT64)0, info.nModifiedTime);
+}
+
+TEST(dropfileinfo, SpecialFilesAreNotOpened) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+	const std::string fifo = temp.path + "/pipe";
+	REQUIRE(mkfifo(fifo.c_str(), 0600) == 0);
+
+	// 書き手の無い FIFO を開くと止まるので、別のスレッドで問い合わせる
+	std::atomic<bool> bDone(false);
+	DROPFILEINFO info;
+	std::thread thread([&]() {
+		info = query(fifo);
+		bDone = true;
+	});
+	Stopwatch stopwatch;
+	while (!bDone && stopwatch.getMicroseconds() < 5000000.0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const BOOL bBlocked = !bDone;
+	if (bBlocked) {
+		// 止まっていたら、書き手として開いて閉じることで解放する
+		const int fd = open(fifo.c_str(), O_WRONLY | O_NONBLOCK);
+		if (fd >= 0) close(fd);
+	}
+	thread.join();
+	REQUIRE(!bBlocked);
+
+	// 存在は分かるが、中身は見ない
+	CHECK_EQ((INT32)DropFileFlag::Exists, info.nFlags);
+	CHECK_EQ((UINT64)0, info.nSize);
+	CHECK_EQ((INT32)DropFileType::Unknown, info.nType);
+	CHECK(info.nModifiedTime > 0);
+
+	info = query("/dev/null");
+	CHECK_EQ((INT32)DropFileFlag::Exists, info.nFlags);
+	CHECK_EQ((INT32)DropFileType::Unknown, info.nType);
+}
+
+TEST(dropfileinfo, ResultsStreamInTheOrderOfTheDrop) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+
+	const int count = 3000;
+	std::vector<std::u16string> paths;
+	for (int i = 0; i < count; i++) {
+		// 奇数は PNG、偶数はテキスト。一部は存在しない
+		std::string name = "f" + std::to_string(i) + ((i % 2) ? ".png" : ".txt");
+		if (i % 100 == 99) {
+			paths.push_back(toU16(temp.path + "/missing_" + name));
+		}
+		else {
+			paths.push_back(toU16(temp.write(name, (i % 2) ? std::string("\x89PNG\r\n\x1A\n", 8) : std::string("plain"))));
+		}
+	}
+
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+	EnableEventQueue(TRUE);
+	EnableDropFileInfo(TRUE, 3);
+
+	REQUIRE(desktop.backend.dropFiles(hWnd, paths));
+	REQUIRE(waitForInfo(count));
+
+	std::vector<DROPFILEINFO> infos(count);
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+	REQUIRE(GetDropFileInfo(0, infos.data(), count, &page) == count);
+	CHECK_EQ((UINT32)count, page.nTotalCount);
+	CHECK_EQ((UINT32)count, page.nAvailableCount);
+
+	int mismatches = 0;
+	for (int i = 0; i < count; i++) {
+		const BOOL bMissing = (i % 100 == 99);
+		const INT32 expectedType = (bMissing ? 0 : (INT32)((i % 2) ? DropFileType::Png : DropFileType::Unknown));
+		const UINT64 expectedSize = (bMissing ? 0 : (UINT64)((i % 2) ? 8 : 5));
+		if (infos[i].nType != expectedType || infos[i].nSize != expectedSize || (infos[i].nFlags != 0) == bMissing) mismatches++;
+	}
+	CHECK_EQ(0, mismatches);
+
+	// 途中から読むこともできる
+	CHECK_EQ(10, GetDropFileInfo(count - 10, infos.data(), 10, &page));
+	CHECK_EQ((UINT32)(count - 10), page.nFirstIndex);
+
+	EnableDropFileInfo(FALSE, 0);
+	DetachWindow();
+}
+
+TEST(dropfileinfo, CancelKeepsTheDoneResultsAndTheNextDropIsRead) {
+	TempDirectory temp;
+	REQUIRE(!temp.path.empty());
+
+	std::vector<std::u16string> paths;
+	for (int i = 0; i < 5000; i++) {
+		paths.push_back(toU16(temp.write("f" + std::to_string(i), "glTF")));
+	}
+	const std::u16string png = toU16(temp.write("a.png", std::string("\x89PNG\r\n\x1A\n", 8)));
+
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+	EnableEventQueue(TRUE);
+	EnableDropFileInfo(TRUE, 2);
+
+	REQUIRE(desktop.backend.dropFiles(hWnd, paths));
+	CancelDropFileInfo();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	// 取り消し後は増えない
+	DROPFILEINFO info;
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+	GetDropFileInfo(0, &info, 1, &page);
+	const UINT32 available = page.nAvailableCount;
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	GetDropFileInfo(0, &info, 1, &page);
+	CHECK_EQ(available, page.nAvailableCount);
+	CHECK_EQ((UINT32)paths.size(), page.nTotalCount);
+	if (available > 0) CHECK_EQ((INT32)DropFileType::Glb, info.nType);
+
+	// 次のドロップは読まれる
+	REQUIRE(desktop.backend.dropFiles(hWnd, { png }));
+	REQUIRE(waitForInfo(1));
+	CHECK_EQ(1, GetDropFileInfo(0, &info, 1, &page));
+	CHECK_EQ((INT32)DropFileType::Png, info.nType);
+
+	EnableDropFileInfo(FALSE, 0);
+	DetachWindow();
+}
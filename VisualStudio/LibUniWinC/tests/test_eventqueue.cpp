@@ -0,0 +1,222 @@
+﻿// test_eventqueue.cpp : The event queue for PollEvents(), its coalescer, and a stress test with millions of events
+
+#include "unittest.h"
+#include "eventqueue.h"
+#include "eventcoalescer.h"
+#include <thread>
+#include <vector>
+
+static UNIWINCEVENT makeEvent(const EventType type, const INT32 param) {
+	UNIWINCEVENT e = UNIWINCEVENT();
+	e.nType = (INT32)type;
+	e.nParam = param;
+	e.nTimestamp = EventQueue::now();
+	return e;
+}
+
+/// <summary>
+/// Push count events from each producer thread and check them on this thread as the consumer.
+///   The producer index is in nType and the sequence number in nParam.
+/// </summary>
+/// <param name="bRetry">Push again when the queue is full, otherwise the event is dropped.
+///   A failed push is counted as dropped either way, so the overflow events only tell the failed attempts when retrying</param>
+/// <returns>Events received, not including the overflow events</returns>
+static UINT64 runStress(EventQueue& queue, const int producers, const INT32 count, const BOOL bRetry, UINT64* pReportedDrops) {
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&queue, p, count, bRetry]() {
+			UNIWINCEVENT e = UNIWINCEVENT();
+			e.nType = p;
+			for (INT32 i = 0; i < count; i++) {
+				e.nParam = i;
+				while (!queue.push(e) && bRetry) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	std::vector<INT32> last(producers, -1);
+	UNIWINCEVENT buffer[256];
+	UINT64 received = 0;
+	UINT64 reported = 0;
+	BOOL bInOrder = TRUE;
+	BOOL bConsecutive = TRUE;
+	const UINT64 total = (UINT64)producers * count;
+
+	while (received + (bRetry ? 0 : reported) < total) {
+		UINT32 n = queue.pop(buffer, 256);
+		for (UINT32 i = 0; i < n; i++) {
+			if (buffer[i].nType == (INT32)EventType::Overflow) {
+				reported += (UINT64)buffer[i].nParam;
+				continue;
+			}
+			const INT32 p = buffer[i].nType;
+			if (buffer[i].nParam <= last[p]) bInOrder = FALSE;
+			if (buffer[i].nParam != last[p] + 1) bConsecutive = FALSE;
+			last[p] = buffer[i].nParam;
+			received++;
+		}
+		if (n == 0) std::this_thread::yield();
+	}
+	for (std::thread& t : threads) t.join();
+
+	// 各生産者の順序は保たれ、取りこぼしが無ければ連番になる
+	CHECK(bInOrder);
+	if (bRetry) CHECK(bConsecutive);
+	*pReportedDrops = reported;
+	return received;
+}
+
+
+TEST(eventqueue, CapacityIsRoundedUpToAPowerOfTwo) {
+	CHECK_EQ((UINT32)4, EventQueue(3).getCapacity());
+	CHECK_EQ((UINT32)1024, EventQueue(1024).getCapacity());
+	CHECK_EQ((UINT32)2048, EventQueue(1025).getCapacity());
+}
+
+TEST(eventqueue, FullQueueDropsTheNewestAndReportsOverflow) {
+	EventQueue queue(4);
+	for (INT32 i = 0; i < 10; i++) {
+		CHECK_EQ((BOOL)(i < 4), queue.push(makeEvent(EventType::MonitorChanged, i)));
+	}
+	CHECK_EQ((UINT64)4, queue.getPushedCount());
+	CHECK_EQ((UINT64)6, queue.getDroppedCount());
+
+	UNIWINCEVENT events[16];
+	REQUIRE(queue.pop(events, 16) == 5);
+	for (INT32 i = 0; i < 4; i++) {
+		CHECK_EQ(i, events[i].nParam);
+	}
+	CHECK_EQ((INT32)EventType::Overflow, events[4].nType);
+	CHECK_EQ(6, events[4].nParam);
+
+	// 報告済みの分は再び報告しない
+	CHECK_EQ((UINT32)0, queue.pop(events, 16));
+}
+
+TEST(eventqueue, PopStopsAtTheBufferAndKeepsTheRest) {
+	EventQueue queue(16);
+	for (INT32 i = 0; i < 10; i++) queue.push(makeEvent(EventType::FilesDropped, i));
+
+	UNIWINCEVENT events[4];
+	CHECK_EQ((UINT32)4, queue.pop(events, 4));
+	CHECK_EQ(3, events[3].nParam);
+	CHECK_EQ((UINT32)4, queue.pop(events, 4));
+	CHECK_EQ((UINT32)2, queue.pop(events, 4));
+	CHECK_EQ(9, events[1].nParam);
+
+	queue.push(makeEvent(EventType::FilesDropped, 0));
+	queue.clear();
+	CHECK_EQ((UINT32)0, queue.pop(events, 4));
+}
+
+TEST(eventqueue, MillionsOfEventsKeepTheirOrder) {
+	EventQueue queue(UNIWINC_EVENT_QUEUE_SIZE);
+	UINT64 reported = 0;
+	const INT32 count = 2000000;
+
+	CHECK_EQ((UINT64)2 * count, runStress(queue, 2, count, TRUE, &reported));
+	CHECK_EQ((UINT64)2 * count, queue.getPushedCount());
+}
+
+TEST(eventqueue, MillionsOfDroppedEventsAreCountedExactly) {
+	EventQueue queue(64);
+	UINT64 reported = 0;
+	const INT32 count = 1000000;
+
+	const UINT64 received = runStress(queue, 3, count, FALSE, &reported);
+	CHECK_EQ((UINT64)3 * count, received + reported);
+	CHECK_EQ(queue.getDroppedCount(), reported);
+	CHECK_EQ(received, queue.getPushedCount());
+}
+
+TEST(eventqueue, CoalescerKeepsTheLastOfABurst) {
+	EventQueue queue(UNIWINC_EVENT_QUEUE_SIZE);
+	EventCoalescer coalescer;
+
+	for (INT32 i = 0; i < 100; i++) {
+		UNIWINCEVENT e = makeEvent(EventType::WindowStateChanged, (INT32)WindowStateEventType::Resized);
+		e.nTimestamp = 1000 + i;
+		e.width = (float)i;
+		queue.push(e);
+	}
+	UNIWINCEVENT dropped = makeEvent(EventType::FilesDropped, 3);
+	dropped.nTimestamp = 2000;
+	queue.push(dropped);
+
+	UNIWINCEVENT events[16];
+	REQUIRE(coalescer.poll(queue, events, 16) == 2);
+	CHECK_EQ((INT32)EventType::WindowStateChanged, events[0].nType);
+	CHECK_EQ(99.0f, events[0].width);
+	CHECK_EQ((INT32)EventType::FilesDropped, events[1].nType);
+	CHECK_EQ((UINT64)100, coalescer.getReceivedCount(EventCoalescer::SLOT_RESIZED));
+	CHECK_EQ((UINT64)1, coalescer.getDeliveredCount(EventCoalescer::SLOT_RESIZED));
+
+	// 発生順に並び、間隔が空くまでは保留される
+	REQUIRE(coalescer.setInterval((INT32)EventType::WindowStateChanged, (INT32)WindowStateEventType::Resized, 60000));
+	queue.push(makeEvent(EventType::WindowStateChanged, (INT32)WindowStateEventType::Resized));
+	CHECK_EQ((UINT32)0, coalescer.poll(queue, events, 16));
+	CHECK(!coalescer.setInterval((INT32)EventType::FilesDropped, 0, 10));
+}
+
+TEST(eventqueue, PollEventsReturnsTheWindowEvents) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	EnableEventQueue(TRUE);
+
+	UNIWINCEVENT events[64];
+	PollEvents(events, 64);
+
+	SetTopmost(TRUE);
+	desktop.backend.setWindowPos(hWnd, NULL, 100, 100, 640, 480, SWP_NOZORDER | SWP_NOMOVE);
+	Update();
+
+	INT32 count = PollEvents(events, 64);
+	BOOL bStyleChanged = FALSE, bResized = FALSE;
+	for (INT32 i = 0; i < count; i++) {
+		if (events[i].nType != (INT32)EventType::WindowStateChanged) continue;
+		if (events[i].nParam & (INT32)WindowStateEventType::StyleChanged) bStyleChanged = TRUE;
+		if (events[i].nParam == (INT32)WindowStateEventType::Resized) {
+			bResized = TRUE;
+			CHECK_EQ(640.0f, events[i].width);
+		}
+	}
+	CHECK(bStyleChanged);
+	CHECK(bResized);
+
+	EVENTSTATS stats;
+	stats.nStructSize = sizeof(stats);
+	REQUIRE(GetEventStats(&stats));
+	CHECK(stats.nDelivered >= 2);
+	CHECK_EQ((UINT32)0, stats.nDropped);
+
+	DetachWindow();
+}
+
+
+BENCHMARK(eventqueue, Throughput) {
+	UNIWINCEVENT events[256];
+	const INT32 count = 4000000;
+
+	// 同じスレッドで積んで取り出す
+	{
+		EventQueue queue(UNIWINC_EVENT_QUEUE_SIZE);
+		UNIWINCEVENT e = makeEvent(EventType::FilesDropped, 0);
+		Stopwatch stopwatch;
+		for (INT32 i = 0; i < count; i += 256) {
+			for (INT32 k = 0; k < 256; k++) queue.push(e);
+			keepValue(queue.pop(events, 256));
+		}
+		report("push + pop, 1 thread", stopwatch.getNanoseconds() / count, "ns/event");
+	}
+
+	for (int producers : { 1, 2, 4 }) {
+		EventQueue queue(UNIWINC_EVENT_QUEUE_SIZE);
+		UINT64 reported = 0;
+		Stopwatch stopwatch;
+		const UINT64 received = runStress(queue, producers, count / producers, TRUE, &reported);
+		report(std::to_string(producers) + " producer(s) to 1 consumer", received / stopwatch.getMicroseconds(), "Mevents/s");
+	}
+}
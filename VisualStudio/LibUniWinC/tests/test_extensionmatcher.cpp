@@ -0,0 +1,343 @@
+﻿// test_extensionmatcher.cpp : The SIMD case folding and the trie of the extension matcher, fuzzed against scalar references,
+//   and MatchFileFilter() against the per-path string operations which it replaces
+
+#include "unittest.h"
+#include "extensionmatcher.h"
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static WCHAR toLowerReference(const WCHAR c) {
+	return ((c >= u'A' && c <= u'Z') ? (WCHAR)(c + (u'a' - u'A')) : c);
+}
+
+/// <summary>
+/// Characters around the ranges of the folding, and characters whose low byte is a letter or which are negative as signed
+/// </summary>
+static const WCHAR EDGE_CHARACTERS[] = {
+	0, u'@', u'A', u'M', u'Z', u'[', u'`', u'a', u'z', u'{', u'.', u'/', u'\\',
+	0x00C0, 0x0141, 0x015A, 0x7FFF, 0x8000, 0x8041, 0xC05A, 0xFF21, 0xFF3A, 0xFFFF,
+};
+
+static WCHAR randomCharacter(std::mt19937& random) {
+	if (random() % 2) return EDGE_CHARACTERS[random() % (sizeof(EDGE_CHARACTERS) / sizeof(EDGE_CHARACTERS[0]))];
+	return (WCHAR)random();
+}
+
+/// <summary>
+/// Scalar reference of match(): the name ends with "." and any of the extensions, compared in lower case
+/// </summary>
+static BOOL matchReference(const std::vector<std::u16string>& extensions, const std::u16string& name) {
+	for (const std::u16string& ext : extensions) {
+		if (ext.empty() || name.size() < ext.size() + 1) continue;
+		if (ext.find_first_of(u"\\/") != std::u16string::npos) continue;
+		if (name[name.size() - ext.size() - 1] != u'.') continue;
+
+		BOOL bSame = TRUE;
+		for (size_t i = 0; i < ext.size() && bSame; i++) {
+			bSame = (toLowerReference(name[name.size() - ext.size() + i]) == toLowerReference(ext[i]));
+		}
+		if (bSame) return TRUE;
+	}
+	return FALSE;
+}
+
+/// <summary>
+/// What the C# code did for each path: lower the whole path and test EndsWith("." + ext) on the file name
+/// </summary>
+static BOOL matchPathReference(const std::vector<std::u16string>& extensions, const std::u16string& path) {
+	if (extensions.empty()) return TRUE;
+
+	std::u16string lower = path;
+	for (WCHAR& c : lower) c = toLowerReference(c);
+	const size_t separator = lower.find_last_of(u"\\/");
+	const std::u16string name = (separator == std::u16string::npos ? lower : lower.substr(separator + 1));
+
+	for (const std::u16string& ext : extensions) {
+		std::u16string suffix = u"." + ext;
+		for (WCHAR& c : suffix) c = toLowerReference(c);
+		if (name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) return TRUE;
+	}
+	return FALSE;
+}
+
+/// <summary>
+/// Paths in the offsets + data form of MatchFileFilter()
+/// </summary>
+struct PathList {
+	std::vector<UINT32> offsets;
+	std::vector<WCHAR> data;
+
+	PathList() : offsets(1, 0) {}
+
+	void add(const std::u16string& path) {
+		data.insert(data.end(), path.begin(), path.end());
+		offsets.push_back((UINT32)data.size());
+	}
+
+	UINT32 getCount() const { return (UINT32)offsets.size() - 1; }
+};
+
+
+TEST(extensionmatcher, FoldCaseMatchesTheScalarPath) {
+	std::mt19937 random(16);
+	int failures = 0;
+
+	// 8 文字単位の本体と端数、ずれた開始位置、その場での変換を全て通す
+	for (int iteration = 0; iteration < 20000; iteration++) {
+		const size_t length = random() % 80;
+		const size_t offset = random() % 8;
+		std::vector<WCHAR> source(offset + length + 8);
+		for (WCHAR& c : source) c = randomCharacter(random);
+
+		std::vector<WCHAR> destination(source.size(), 0x5555);
+		ExtensionMatcher::foldCase(source.data() + offset, length, destination.data() + offset);
+
+		for (size_t i = 0; i < destination.size(); i++) {
+			const BOOL bInside = (i >= offset && i < offset + length);
+			const WCHAR expected = (bInside ? toLowerReference(source[i]) : (WCHAR)0x5555);
+			if (destination[i] != expected) failures++;
+		}
+
+		std::vector<WCHAR> inPlace = source;
+		ExtensionMatcher::foldCase(inPlace.data() + offset, length, inPlace.data() + offset);
+		for (size_t i = offset; i < offset + length; i++) {
+			if (inPlace[i] != toLowerReference(source[i])) failures++;
+		}
+	}
+	CHECK_EQ(0, failures);
+}
+
+TEST(extensionmatcher, MatchAgreesWithTheReference) {
+	std::mt19937 random(17);
+	const WCHAR alphabet[] = { u'a', u'A', u'g', u'G', u'z', u'.', u'/', 0x00C0, 0xFF21 };
+	const size_t alphabetSize = sizeof(alphabet) / sizeof(alphabet[0]);
+	int failures = 0;
+
+	for (int round = 0; round < 300; round++) {
+		// 短い拡張子を多く、時々長いものを混ぜる
+		std::vector<std::u16string> extensions;
+		ExtensionMatcher matcher;
+		const int count = 1 + (int)(random() % 12);
+		for (int e = 0; e < count; e++) {
+			const size_t length = ((random() % 20) == 0 ? 200 + random() % 100 : 1 + random() % 4);
+			std::u16string ext;
+			for (size_t i = 0; i < length; i++) ext += alphabet[random() % alphabetSize];
+			extensions.push_back(ext);
+			matcher.add(ext.data(), ext.size());
+		}
+		matcher.build();
+
+		// 拡張子そのものを末尾に持つ名前も作る
+		std::vector<std::u16string> names;
+		for (int n = 0; n < 300; n++) {
+			std::u16string name;
+			const size_t length = random() % 12;
+			for (size_t i = 0; i < length; i++) name += alphabet[random() % alphabetSize];
+			if (random() % 2) {
+				std::u16string ext = extensions[random() % extensions.size()];
+				for (WCHAR& c : ext) {
+					if ((random() % 2) && c >= u'a' && c <= u'z') c = (WCHAR)(c - (u'a' - u'A'));
+				}
+				name += u'.';
+				name += ext;
+			}
+			names.push_back(name);
+		}
+
+		std::vector<UINT32> offsets(1, 0);
+		std::u16string data;
+		for (const std::u16string& name : names) {
+			if (matcher.match(name.data(), name.size()) != matchReference(extensions, name)) failures++;
+			data += name;
+			offsets.push_back((UINT32)data.size());
+		}
+
+		// まとめて調べても同じ結果になる。前のパスの文字を含めて小文字化する経路も通る
+		std::vector<BYTE> results(names.size(), 0xCD);
+		UINT32 matched = matcher.matchPaths(offsets.data(), (const WCHAR*)data.data(), (UINT32)names.size(), results.data());
+		UINT32 expectedMatched = 0;
+		for (size_t i = 0; i < names.size(); i++) {
+			const BOOL bExpected = matchReference(extensions, names[i]);
+			if (results[i] != (bExpected ? 1 : 0)) failures++;
+			if (bExpected) expectedMatched++;
+		}
+		if (matched != expectedMatched) failures++;
+	}
+	CHECK_EQ(0, failures);
+}
+
+TEST(extensionmatcher, PathsAndCompoundExtensions) {
+	ExtensionMatcher matcher;
+	CHECK(matcher.isEmpty());
+	for (const char16_t* ext : { u"png", u"tar.gz", u"JPG" }) {
+		matcher.add((const WCHAR*)ext, std::char_traits<char16_t>::length(ext));
+	}
+	matcher.build();
+	CHECK(!matcher.isEmpty());
+
+	auto match = [&matcher](const std::u16string& name) { return matcher.match(name.data(), name.size()); };
+	CHECK(match(u"C:\\images\\a.PNG"));
+	CHECK(match(u"photo.jpg"));
+	CHECK(match(u"archive.TAR.GZ"));
+	CHECK(match(u".png"));
+	CHECK(!match(u"png"));
+	CHECK(!match(u"archive.gz"));
+	CHECK(!match(u"C:\\dir.png\\file"));
+	CHECK(!match(u"dir/tar.gz"));
+	CHECK(!match(u"a.pngx"));
+	CHECK(!match(u""));
+}
+
+TEST(extensionmatcher, MatchFileFilterAgreesWithThePerPathReference) {
+	std::mt19937 random(19);
+	int failures = 0;
+
+	for (int round = 0; round < 3000; round++) {
+		// 拡張子が無ければ全て一致する
+		std::vector<std::u16string> extensions;
+		std::u16string text = u"Title";
+		const int count = (int)(random() % 6);
+		for (int e = 0; e < count; e++) {
+			std::u16string ext;
+			const int length = 1 + (int)(random() % 4);
+			for (int i = 0; i < length; i++) ext += u"aB.c"[random() % 4];
+			extensions.push_back(ext);
+			text += u"\t" + ext;
+		}
+		std::vector<WCHAR> filter(text.begin(), text.end());
+		filter.push_back(u'\0');
+
+		PathList list;
+		std::vector<std::u16string> paths;
+		for (int k = 0; k < 50; k++) {
+			std::u16string path;
+			const int length = (int)(random() % 12);
+			for (int i = 0; i < length; i++) path += u"aAbBcC./\\"[random() % 9];
+			paths.push_back(path);
+			list.add(path);
+		}
+
+		std::vector<BYTE> results(paths.size(), 0xCD);
+		const INT32 matched = MatchFileFilter(filter.data(), list.offsets.data(), list.data.data(), list.getCount(), results.data());
+		INT32 expectedMatched = 0;
+		for (size_t k = 0; k < paths.size(); k++) {
+			const BOOL bExpected = matchPathReference(extensions, paths[k]);
+			if (results[k] != (bExpected ? 1 : 0)) failures++;
+			if (bExpected) expectedMatched++;
+		}
+		if (matched != expectedMatched) failures++;
+	}
+	CHECK_EQ(0, failures);
+}
+
+TEST(extensionmatcher, MatchFileFilterArguments) {
+	PathList list;
+	list.add(u"C:\\a\\image.PNG");
+	list.add(u"/home/u/notes.txt");
+	list.add(u"archive.tar.GZ");
+	const BYTE expected[] = { 1, 0, 1 };
+
+	std::u16string text = u"Assets\tpng\ttar.gz\n";
+	std::vector<WCHAR> filter(text.begin(), text.end());
+	filter.push_back(u'\0');
+	std::vector<BYTE> results(3, 0xCD);
+	CHECK_EQ(2, MatchFileFilter(filter.data(), list.offsets.data(), list.data.data(), 3, results.data()));
+	for (int i = 0; i < 3; i++) CHECK_EQ((INT32)expected[i], (INT32)results[i]);
+
+	// UTF-8 でも同じ。オフセットはバイト単位
+	const std::string utf8Paths[] = { "C:\\a\\image.PNG", "/home/u/\xE3\x83\xA1\xE3\x83\xA2.txt", "\xE5\x9C\xA7\xE7\xB8\xAE.tar.GZ" };
+	std::vector<UINT32> offsets(1, 0);
+	std::string data;
+	for (const std::string& path : utf8Paths) {
+		data += path;
+		offsets.push_back((UINT32)data.size());
+	}
+	const std::string utf8Filter = "Assets\tpng\ttar.gz\n";
+	std::fill(results.begin(), results.end(), 0xCD);
+	CHECK_EQ(2, MatchFileFilterUtf8(utf8Filter.data(), (UINT32)utf8Filter.size(), offsets.data(), data.data(), 3, results.data()));
+	for (int i = 0; i < 3; i++) CHECK_EQ((INT32)expected[i], (INT32)results[i]);
+
+	// NULL のフィルタは全て一致、不正な引数は -1
+	std::fill(results.begin(), results.end(), 0);
+	CHECK_EQ(3, MatchFileFilter(NULL, list.offsets.data(), list.data.data(), 3, results.data()));
+	CHECK(results[0] == 1 && results[1] == 1 && results[2] == 1);
+	CHECK_EQ(-1, MatchFileFilter(filter.data(), NULL, list.data.data(), 3, results.data()));
+	CHECK_EQ(-1, MatchFileFilter(filter.data(), list.offsets.data(), NULL, 3, results.data()));
+	CHECK_EQ(-1, MatchFileFilter(filter.data(), list.offsets.data(), list.data.data(), 3, NULL));
+	CHECK_EQ(0, MatchFileFilter(filter.data(), list.offsets.data(), list.data.data(), 0, results.data()));
+}
+
+
+BENCHMARK(extensionmatcher, FoldCase) {
+	std::vector<WCHAR> source(1 << 16);
+	std::mt19937 random(18);
+	for (WCHAR& c : source) c = (WCHAR)(u' ' + random() % 95);
+	std::vector<WCHAR> destination(source.size());
+
+	const int repeat = 2000;
+	Stopwatch stopwatch;
+	for (int r = 0; r < repeat; r++) {
+		ExtensionMatcher::foldCase(source.data(), source.size(), destination.data());
+		keepValue(destination[r]);
+	}
+	report("foldCase", stopwatch.getNanoseconds() / ((double)repeat * source.size()), "ns/char");
+
+	stopwatch.restart();
+	for (int r = 0; r < repeat; r++) {
+		for (size_t i = 0; i < source.size(); i++) destination[i] = toLowerReference(source[i]);
+		keepValue(destination[r]);
+	}
+	report("scalar reference", stopwatch.getNanoseconds() / ((double)repeat * source.size()), "ns/char");
+}
+
+BENCHMARK(extensionmatcher, MillionPaths) {
+	// よく使う拡張子と、数百の独自の拡張子
+	std::u16string text = u"Assets";
+	std::vector<std::u16string> extensions;
+	for (const char* ext : { "png", "jpg", "jpeg", "gif", "tga", "tiff", "txt", "log", "md", "cs", "cpp", "h", "json", "xml", "tar.gz", "zip", "7z", "mp4", "wav", "ogg" }) {
+		extensions.push_back(std::u16string(ext, ext + strlen(ext)));
+	}
+	for (int i = 0; i < 280; i++) {
+		const std::string ext = "x" + std::to_string(i);
+		extensions.push_back(std::u16string(ext.begin(), ext.end()));
+	}
+	for (const std::u16string& ext : extensions) text += u"\t" + ext;
+	std::vector<WCHAR> filter(text.begin(), text.end());
+	filter.push_back(u'\0');
+
+	const char* pool[] = { "PNG", "Jpg", "TXT", "tar.GZ", "bin", "dat", "exe", "dll", "mp4", "unknown", "WAV", "meta", "x17", "X280" };
+	const UINT32 count = 1000000;
+	std::mt19937 random(20);
+	PathList list;
+	std::vector<std::u16string> paths;
+	for (UINT32 i = 0; i < count; i++) {
+		const std::string path = "C:\\Users\\someone\\Projects\\Game\\Assets\\Folder" + std::to_string(i % 97) + "\\file_" + std::to_string(i) + "." + pool[random() % 14];
+		list.add(std::u16string(path.begin(), path.end()));
+		if (i < count / 10) paths.push_back(std::u16string(path.begin(), path.end()));
+	}
+	std::vector<BYTE> results(count);
+
+	// 初回はフィルタのコンパイルを含む
+	Stopwatch stopwatch;
+	INT32 matched = MatchFileFilter(filter.data(), list.offsets.data(), list.data.data(), count, results.data());
+	report("MatchFileFilter 1M paths, first call", stopwatch.getMicroseconds() / 1000.0, "ms");
+
+	stopwatch.restart();
+	matched = MatchFileFilter(filter.data(), list.offsets.data(), list.data.data(), count, results.data());
+	const double batch = stopwatch.getNanoseconds() / count;
+	report("MatchFileFilter 1M paths", batch, "ns/path");
+	keepValue(matched);
+
+	// 置き換える前の、パスごとの文字列操作。1/10 の数で測る
+	stopwatch.restart();
+	UINT32 referenceMatched = 0;
+	for (const std::u16string& path : paths) {
+		referenceMatched += matchPathReference(extensions, path);
+	}
+	const double reference = stopwatch.getNanoseconds() / paths.size();
+	report("per-path strings (100k paths)", reference, "ns/path");
+	report("speedup", reference / batch, "x");
+	keepValue(referenceMatched);
+}
@@ -0,0 +1,219 @@
+﻿// test_hittestmask.cpp : The hit test mask, its packing kernel and the click-through on the virtual desktop
+
+#include "unittest.h"
+#include "hittestmask.h"
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Scalar reference of HitTestMask::packAlpha()
+/// </summary>
+static std::vector<BYTE> packAlphaScalar(const std::vector<BYTE>& alpha, const BYTE threshold) {
+	std::vector<BYTE> bits((alpha.size() + 7) / 8, 0);
+	for (size_t i = 0; i < alpha.size(); i++) {
+		if (alpha[i] >= threshold) bits[i / 8] |= (BYTE)(1 << (i % 8));
+	}
+	return bits;
+}
+
+
+TEST(hittestmask, PackAlphaMatchesTheScalarReference) {
+	std::mt19937 random(1);
+
+	// SIMD の本体と端数の両方を通るよう、長さと開始位置をずらす
+	for (UINT32 count = 0; count < 200; count++) {
+		for (UINT32 offset = 0; offset < 4; offset++) {
+			std::vector<BYTE> buffer(offset + count);
+			for (BYTE& a : buffer) a = (BYTE)random();
+			std::vector<BYTE> alpha(buffer.begin() + offset, buffer.end());
+
+			for (BYTE threshold : { (BYTE)1, (BYTE)128, (BYTE)255 }) {
+				std::vector<BYTE> bits((count + 7) / 8 + 1, 0xCD);
+				HitTestMask::packAlpha(buffer.data() + offset, count, threshold, bits.data());
+
+				std::vector<BYTE> expected = packAlphaScalar(alpha, threshold);
+				REQUIRE(std::equal(expected.begin(), expected.end(), bits.begin()));
+				CHECK_EQ(0xCD, (int)bits.back());
+			}
+		}
+	}
+}
+
+TEST(hittestmask, RowZeroIsTheBottomAndTheMaskIsScaled) {
+	HitTestMask mask;
+	CHECK(mask.isEmpty());
+	CHECK(mask.hitTest(0, 0, 100, 100));
+
+	// 4x2 のマスクで、下の行の左端と上の行の右端だけ不透明
+	const BYTE alpha[4 * 2] = {
+		255, 0, 0, 0,
+		0, 0, 0, 255,
+	};
+	REQUIRE(mask.setAlpha(alpha, 4, 2, 1));
+	CHECK(!mask.isEmpty());
+
+	CHECK(mask.hitTest(0, 99, 100, 100));
+	CHECK(!mask.hitTest(99, 99, 100, 100));
+	CHECK(mask.hitTest(99, 0, 100, 100));
+	CHECK(!mask.hitTest(0, 0, 100, 100));
+	CHECK(!mask.hitTest(30, 60, 100, 100));
+
+	// クライアント領域の外は常にヒット
+	CHECK(mask.hitTest(-1, 50, 100, 100));
+	CHECK(mask.hitTest(50, 100, 100, 100));
+
+	mask.clear();
+	CHECK(mask.isEmpty());
+	CHECK(mask.hitTest(30, 60, 100, 100));
+}
+
+TEST(hittestmask, SetBitsAndRegionAgreeWithHitTest) {
+	const INT32 width = 37, height = 23;
+	std::mt19937 random(2);
+	std::vector<BYTE> alpha((size_t)width * height);
+	for (BYTE& a : alpha) a = ((random() % 3) == 0 ? 255 : 0);
+
+	std::vector<BYTE> bits((size_t)HitTestMask::getStride(width) * height, 0);
+	for (INT32 y = 0; y < height; y++) {
+		HitTestMask::packAlpha(&alpha[(size_t)y * width], width, 128, &bits[(size_t)y * HitTestMask::getStride(width)]);
+	}
+
+	HitTestMask fromAlpha, fromBits;
+	REQUIRE(fromAlpha.setAlpha(alpha.data(), width, height, 128));
+	REQUIRE(fromBits.setBits(bits.data(), width, height));
+
+	std::vector<RECT> rects;
+	UINT64 version = 0;
+	REQUIRE(fromBits.getRegion(rects, width, height, &version));
+	CHECK_EQ(fromBits.getVersion(), version);
+
+	for (INT32 y = 0; y < height; y++) {
+		for (INT32 x = 0; x < width; x++) {
+			const BOOL bOpaque = (alpha[(size_t)(height - 1 - y) * width + x] != 0);
+			CHECK_EQ(bOpaque, fromAlpha.hitTest(x, y, width, height));
+			CHECK_EQ(bOpaque, fromBits.hitTest(x, y, width, height));
+
+			BOOL bInRegion = FALSE;
+			for (const RECT& r : rects) {
+				if (x >= r.left && x < r.right && y >= r.top && y < r.bottom) bInRegion = TRUE;
+			}
+			CHECK_EQ(bOpaque, bInRegion);
+		}
+	}
+}
+
+TEST(hittestmask, VersionChangesOnlyWhenTheMaskChanges) {
+	HitTestMask mask;
+	std::vector<BYTE> alpha(64 * 64, 0);
+	REQUIRE(mask.setAlpha(alpha.data(), 64, 64, 128));
+	const UINT64 version = mask.getVersion();
+
+	REQUIRE(mask.setAlpha(alpha.data(), 64, 64, 128));
+	CHECK_EQ(version, mask.getVersion());
+
+	alpha[10] = 255;
+	REQUIRE(mask.setAlpha(alpha.data(), 64, 64, 128));
+	CHECK(mask.getVersion() != version);
+}
+
+TEST(hittestmask, ClickThroughFollowsTheCursor) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	// 2x2 のマスクで左下だけ不透明
+	const BYTE alpha[4] = { 255, 0, 0, 0 };
+	REQUIRE(SetHitTestMask(alpha, 2, 2, 128));
+	EnableHitTestMask(TRUE);
+	CHECK(IsHitTestMaskEnabled());
+
+	auto isClickThrough = [&]() { return (desktop.backend.getWindowLong(hWnd, GWL_EXSTYLE) & WS_EX_TRANSPARENT) != 0; };
+
+	desktop.backend.setCursorPos(150, 650);
+	desktop.backend.advanceTime(20);
+	CHECK(!isClickThrough());
+
+	desktop.backend.setCursorPos(850, 150);
+	desktop.backend.advanceTime(20);
+	CHECK(isClickThrough());
+	CHECK_EQ((LRESULT)HTTRANSPARENT, desktop.backend.sendMessage(hWnd, WM_NCHITTEST, 0, MAKELPARAM(850, 150)));
+
+	// 状態が変わらなければスタイルは書き換えない
+	desktop.backend.resetCallCounts();
+	desktop.backend.advanceTime(160);
+	CHECK_EQ((UINT64)0, (UINT64)desktop.backend.getCallCounts().setWindowLong);
+
+	EnableHitTestMask(FALSE);
+	CHECK(!isClickThrough());
+	DetachWindow();
+}
+
+
+BENCHMARK(hittestmask, PackAlpha) {
+	const UINT32 count = 1920 * 1080;
+	std::vector<BYTE> alpha(count);
+	std::mt19937 random(3);
+	for (BYTE& a : alpha) a = (BYTE)random();
+	std::vector<BYTE> bits((count + 7) / 8);
+
+	const int repeat = 100;
+	Stopwatch stopwatch;
+	for (int i = 0; i < repeat; i++) {
+		HitTestMask::packAlpha(alpha.data(), count, (BYTE)(128 + (i & 1)), bits.data());
+		keepValue(bits[i]);
+	}
+	const double microseconds = stopwatch.getMicroseconds() / repeat;
+	report("packAlpha 1920x1080", microseconds, "us/frame");
+	report("packAlpha throughput", count / microseconds / 1000.0, "GB/s");
+}
+
+BENCHMARK(hittestmask, SetAlpha) {
+	const INT32 width = 480, height = 270;		// 1920x1080 の 1/4
+	std::vector<BYTE> alpha((size_t)width * height, 0);
+	for (INT32 y = 50; y < 200; y++) {
+		for (INT32 x = 100; x < 300; x++) alpha[(size_t)y * width + x] = 255;
+	}
+
+	HitTestMask mask;
+	const int repeat = 1000;
+	Stopwatch stopwatch;
+	for (int i = 0; i < repeat; i++) {
+		mask.setAlpha(alpha.data(), width, height, 128);
+	}
+	report("setAlpha unchanged 480x270", stopwatch.getMicroseconds() / repeat, "us/call");
+
+	// 毎回一部のタイルだけが変わる
+	stopwatch.restart();
+	for (int i = 0; i < repeat; i++) {
+		alpha[(size_t)(100 + (i % 50)) * width + 320] ^= 255;
+		mask.setAlpha(alpha.data(), width, height, 128);
+	}
+	report("setAlpha one tile changed 480x270", stopwatch.getMicroseconds() / repeat, "us/call");
+
+	stopwatch.restart();
+	for (int i = 0; i < repeat; i++) {
+		for (BYTE& a : alpha) a = (BYTE)~a;
+		mask.setAlpha(alpha.data(), width, height, 128);
+	}
+	report("setAlpha all changed 480x270", stopwatch.getMicroseconds() / repeat, "us/call");
+	keepValue(mask.getVersion());
+}
+
+BENCHMARK(hittestmask, HitTest) {
+	const INT32 width = 480, height = 270;
+	std::vector<BYTE> alpha((size_t)width * height);
+	std::mt19937 random(4);
+	for (BYTE& a : alpha) a = (BYTE)random();
+
+	HitTestMask mask;
+	mask.setAlpha(alpha.data(), width, height, 128);
+
+	const int count = 1000000;
+	INT64 hits = 0;
+	Stopwatch stopwatch;
+	for (int i = 0; i < count; i++) {
+		hits += mask.hitTest((i * 7) % 1920, (i * 13) % 1080, 1920, 1080);
+	}
+	report("hitTest", stopwatch.getNanoseconds() / count, "ns/call");
+	keepValue(hits);
+}
@@ -0,0 +1,146 @@
+﻿// test_monitortopology.cpp : Snapshots of the monitor layout, and the ring which publishes them to the other threads
+
+#include "unittest.h"
+#include "monitortopology.h"
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Layout of the generation: 1 to 4 monitors side by side, each as wide as 1000 + generation
+/// </summary>
+static void makeLayout(const UINT32 generation, std::vector<RECT>& rects, std::vector<HMONITOR>& handles) {
+	rects.clear();
+	handles.clear();
+	const LONG width = (LONG)(1000 + generation);
+	for (UINT32 i = 0; i <= generation % 4; i++) {
+		rects.push_back({ (LONG)i * width, 0, (LONG)(i + 1) * width, 1080 });
+		handles.push_back((HMONITOR)(intptr_t)(i + 1));
+	}
+}
+
+/// <summary>
+/// Whether the snapshot is the whole layout of its generation
+/// </summary>
+static BOOL isWholeLayout(const MonitorTopology& topology) {
+	const UINT32 generation = topology.getGeneration();
+	if (generation == 0) return (topology.getCount() == 0);
+	if (topology.getCount() != (INT32)(generation % 4 + 1)) return FALSE;
+
+	for (INT32 i = 0; i < topology.getCount(); i++) {
+		const RECT& rect = topology.getRect(i);
+		if (rect.right - rect.left != (LONG)(1000 + generation)) return FALSE;
+	}
+	return TRUE;
+}
+
+
+TEST(monitortopology, FindMonitors) {
+	const std::vector<RECT> rects = { { 1920, 0, 3840, 1080 }, { 0, 0, 1920, 1080 }, { -1280, 200, 0, 1224 } };
+	const std::vector<HMONITOR> handles = { (HMONITOR)1, (HMONITOR)2, (HMONITOR)3 };
+	const MonitorTopology topology(rects, handles, 5);
+
+	// 左から並べ、原点にあるものがプライマリ
+	CHECK_EQ(3, topology.getCount());
+	CHECK_EQ((UINT32)5, topology.getGeneration());
+	CHECK(topology.getHandle(0) == (HMONITOR)3);
+	CHECK_EQ(1, topology.getPrimaryIndex());
+	CHECK_EQ((LONG)1080, topology.getPrimaryHeight());
+	CHECK_EQ((LONG)-1280, topology.getVirtualScreen().left);
+
+	CHECK_EQ(0, topology.findMonitor(-1, 300));
+	CHECK_EQ(1, topology.findMonitor(0, 0));
+	CHECK_EQ(2, topology.findMonitor(3839, 1079));
+	CHECK_EQ(-1, topology.findMonitor(-1, 100));
+	CHECK_EQ(2, topology.findMonitor(RECT{ 1800, 100, 2400, 500 }));
+	CHECK_EQ(-1, topology.findMonitor(RECT{ 5000, 0, 5100, 100 }));
+
+	CHECK(topology.isSameLayout(rects, handles));
+	CHECK(!topology.isSameLayout({ rects[1], rects[0], rects[2] }, handles));
+}
+
+TEST(monitortopology, RingReusesTheSlots) {
+	MonitorTopologyRing ring;
+	CHECK_EQ((UINT32)0, ring.read()->getGeneration());
+
+	// 何度差し替えても、スロットの数より多くは作らない
+	std::set<const MonitorTopology*> used;
+	std::vector<RECT> rects;
+	std::vector<HMONITOR> handles;
+	for (UINT32 generation = 1; generation <= 1000; generation++) {
+		makeLayout(generation, rects, handles);
+		REQUIRE(ring.publish(rects, handles));
+		const MonitorTopologyRing::Reader reader = ring.read();
+		CHECK_EQ(generation, reader->getGeneration());
+		used.insert(&*reader);
+	}
+	CHECK(used.size() <= MonitorTopologyRing::SLOT_COUNT);
+
+	// 読んでいる間は、そのスナップショットは使い回されない
+	const MonitorTopologyRing::Reader pinned = ring.read();
+	for (UINT32 generation = 1001; generation <= 1100; generation++) {
+		makeLayout(generation, rects, handles);
+		REQUIRE(ring.publish(rects, handles));
+		CHECK(&*ring.read() != &*pinned);
+	}
+	CHECK_EQ((UINT32)1000, pinned->getGeneration());
+	CHECK(isWholeLayout(*pinned));
+	CHECK_EQ((UINT32)1100, ring.read()->getGeneration());
+}
+
+TEST(monitortopology, ReadersOnOtherThreadsSeeWholeSnapshots) {
+	MonitorTopologyRing ring;
+	std::atomic<BOOL> bStop(FALSE);
+	std::atomic<int> broken(0);
+	std::atomic<int> backwards(0);
+
+	// 読み手はそれぞれ一つずつ固定しながら読み続ける
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 3; t++) {
+		readers.emplace_back([&]() {
+			UINT32 last = 0;
+			while (!bStop.load()) {
+				const MonitorTopologyRing::Reader reader = ring.read();
+				if (!isWholeLayout(*reader)) broken++;
+				if (reader->getGeneration() < last) backwards++;
+				last = reader->getGeneration();
+			}
+		});
+	}
+
+	std::vector<RECT> rects;
+	std::vector<HMONITOR> handles;
+	for (UINT32 generation = 1; generation <= 20000; generation++) {
+		makeLayout(generation, rects, handles);
+		ring.publish(rects, handles);
+	}
+	bStop = TRUE;
+	for (std::thread& thread : readers) thread.join();
+
+	CHECK_EQ(0, broken.load());
+	CHECK_EQ(0, backwards.load());
+	CHECK_EQ((UINT32)20000, ring.read()->getGeneration());
+}
+
+TEST(monitortopology, DisplayChangesReplaceTheLayout) {
+	VirtualDesktop desktop;
+	REQUIRE(AttachWindowHandle(desktop.createMyWindow({ 100, 100, 900, 700 })));
+	const UINT32 first = GetMonitorGeneration();
+
+	// 表示が変わるたびに世代が進み、同じ配置なら変わらない
+	float x, y, width, height;
+	for (int i = 1; i <= 500; i++) {
+		desktop.backend.clearMonitors();
+		desktop.backend.addMonitor({ 0, 0, 1920, 1080 });
+		if (i % 2) desktop.backend.addMonitor({ 1920, 0, 1920 + i, 1080 });
+		desktop.backend.notifyDisplayChange();
+		CHECK_EQ(first + i, GetMonitorGeneration());
+		CHECK_EQ((i % 2) ? 2 : 1, GetMonitorCount());
+		CHECK(GetMonitorRectangle(1, &x, &y, &width, &height) == ((i % 2) ? TRUE : FALSE));
+		if (i % 2) CHECK_EQ((float)i, width);
+	}
+
+	desktop.backend.notifyDisplayChange();
+	CHECK_EQ(first + 500, GetMonitorGeneration());
+}
@@ -0,0 +1,194 @@
+﻿// test_multiselect.cpp : Expansion of the multi-selection results, fuzzed against a reference and benchmarked
+
+#include "unittest.h"
+#include "multiselect.h"
+#include <random>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Straightforward expansion of "Directory\0File1\0File2\0...\0\0" to compare with
+///   An entry which reaches the end of the buffer is taken as terminated there.
+/// </summary>
+static std::u16string expandReference(const std::vector<WCHAR>& buffer) {
+	const size_t n = buffer.size();
+	size_t i = 0;
+	std::u16string directory;
+	while (i < n && buffer[i]) directory += buffer[i++];
+	i++;
+
+	std::vector<std::u16string> names;
+	while (i < n && buffer[i]) {
+		std::u16string name;
+		while (i < n && buffer[i]) name += buffer[i++];
+		names.push_back(name);
+		i++;
+	}
+	if (names.empty() || directory.empty()) return directory;
+
+	const BOOL bSeparator = !(directory.back() == u'\\' || directory.back() == u'/');
+	std::u16string result;
+	for (size_t k = 0; k < names.size(); k++) {
+		if (k > 0) result += u'\n';
+		result += directory;
+		if (bSeparator) result += u'\\';
+		result += names[k];
+	}
+	return result;
+}
+
+/// <summary>
+/// Result of a multi-selection of files in one directory
+/// </summary>
+static std::vector<WCHAR> makeSelection(const std::u16string& directory, const int files) {
+	std::vector<WCHAR> buffer(directory.begin(), directory.end());
+	buffer.push_back(0);
+	for (int i = 0; i < files; i++) {
+		const std::string name = "Screenshot_" + std::to_string(100000 + i) + ".png";
+		buffer.insert(buffer.end(), name.begin(), name.end());
+		buffer.push_back(0);
+	}
+	buffer.push_back(0);
+	return buffer;
+}
+
+
+TEST(multiselect, SingleAndMultipleSelections) {
+	std::vector<WCHAR> single = { u'C', u':', u'\\', u'a', 0, 0 };
+	MultiSelectLayout layout;
+	scanMultiSelect(single.data(), (UINT32)single.size(), &layout);
+	CHECK_EQ((UINT32)0, layout.fileCount);
+	CHECK_EQ((UINT32)4, layout.directoryLength);
+	CHECK_EQ((UINT32)5, layout.requiredLength);
+	CHECK(expandMultiSelect(single.data(), (UINT32)single.size(), layout));
+	CHECK(std::u16string(single.data()) == u"C:\\a");
+
+	std::vector<WCHAR> multiple = makeSelection(u"C:\\dir", 2);
+	scanMultiSelect(multiple.data(), (UINT32)multiple.size(), &layout);
+	CHECK_EQ((UINT32)2, layout.fileCount);
+
+	const std::u16string expected = u"C:\\dir\\Screenshot_100000.png\nC:\\dir\\Screenshot_100001.png";
+	CHECK_EQ((UINT32)expected.size() + 1, layout.requiredLength);
+
+	// 足りなければ何も変えずに失敗する
+	std::vector<WCHAR> original = multiple;
+	multiple.resize(layout.requiredLength, 0);
+	CHECK(!expandMultiSelect(multiple.data(), layout.requiredLength - 1, layout));
+	CHECK(std::equal(original.begin(), original.end(), multiple.begin()));
+	CHECK(expandMultiSelect(multiple.data(), layout.requiredLength, layout));
+	CHECK(std::u16string(multiple.data()) == expected);
+}
+
+TEST(multiselect, FuzzAgainstTheReference) {
+	std::mt19937 random(15);
+	const char alphabet[] = "ab\\/.x";
+	int failures = 0;
+
+	for (int iteration = 0; iteration < 300000 && failures < 10; iteration++) {
+		// 区切りや終端の欠けた入力、ゴミの付いた入力、途中で切れた入力を作る
+		std::vector<WCHAR> buffer;
+		const int entries = (int)(random() % 6);
+		for (int e = 0; e < entries; e++) {
+			const int length = (int)(random() % 5);
+			for (int j = 0; j < length; j++) buffer.push_back((WCHAR)alphabet[random() % 6]);
+			buffer.push_back(0);
+		}
+		if (random() % 3) buffer.push_back(0);
+		const int padding = (int)(random() % 4);
+		for (int j = 0; j < padding; j++) buffer.push_back((random() % 2) ? u'q' : 0);
+		if (random() % 4 == 0 && !buffer.empty()) buffer.resize(random() % buffer.size() + 1);
+
+		const std::u16string expected = expandReference(buffer);
+		MultiSelectLayout layout;
+		scanMultiSelect(buffer.empty() ? nullptr : buffer.data(), (UINT32)buffer.size(), &layout);
+		if (layout.requiredLength != expected.size() + 1) {
+			failures++;
+			continue;
+		}
+
+		// 大きさが足りなければ失敗し、入力はそのまま
+		if (layout.requiredLength > 1 && layout.requiredLength <= buffer.size()) {
+			std::vector<WCHAR> copy = buffer;
+			if (expandMultiSelect(copy.data(), layout.requiredLength - 1, layout) || copy != buffer) failures++;
+		}
+
+		// 足りていれば展開され、その後ろは書き換えない
+		std::vector<WCHAR> work = buffer;
+		if (work.size() < layout.requiredLength) work.resize(layout.requiredLength, 0x7777);
+		work.push_back(0x5555);
+		if (!expandMultiSelect(work.data(), (UINT32)work.size() - 1, layout)) {
+			failures++;
+			continue;
+		}
+		if (std::u16string(work.data(), work.data() + expected.size()) != expected || work[expected.size()] != 0 || work.back() != 0x5555) {
+			failures++;
+		}
+	}
+	CHECK_EQ(0, failures);
+}
+
+TEST(multiselect, PanelResultCanBeRetriedWithTheRequiredLength) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	const std::vector<WCHAR> selection = makeSelection(u"C:\\Users\\someone\\Pictures", 10000);
+	desktop.backend.setFileDialogHandler([&selection](OPENFILENAMEW* lpofn, BOOL) {
+		if (selection.size() > lpofn->nMaxFile) return FALSE;
+		std::copy(selection.begin(), selection.end(), lpofn->lpstrFile);
+		return TRUE;
+	});
+
+	PANELSETTINGS settings = PANELSETTINGS();
+	settings.nStructSize = sizeof(settings);
+	settings.nFlags = (INT32)PanelFlag::AllowMultiSelect;
+
+	// 結果が入らなければ失敗するが、必要な長さを知って取り直せる
+	std::vector<WCHAR> small(1024, 0x7777);
+	CHECK(!OpenFilePanel(&settings, small.data(), (UINT32)small.size()));
+	CHECK_EQ((WCHAR)0, small[0]);
+
+	const UINT32 length = GetPanelResultLength(0);
+	REQUIRE(length > small.size());
+	std::vector<WCHAR> result(length);
+	REQUIRE(GetPanelResult(0, result.data(), length));
+
+	size_t lines = 1;
+	for (UINT32 i = 0; i + 1 < length; i++) {
+		if (result[i] == u'\n') lines++;
+	}
+	CHECK_EQ((size_t)10000, lines);
+	CHECK_EQ((WCHAR)0, result[length - 1]);
+	const std::u16string first = u"C:\\Users\\someone\\Pictures\\Screenshot_100000.png\n";
+	CHECK(std::u16string(result.data(), first.size()) == first);
+
+	DetachWindow();
+}
+
+
+BENCHMARK(multiselect, Expand) {
+	for (int files : { 1000, 10000, 50000 }) {
+		const std::vector<WCHAR> input = makeSelection(u"C:\\Users\\someone\\Pictures\\Screenshots\\2026", files);
+		MultiSelectLayout layout;
+		scanMultiSelect(input.data(), (UINT32)input.size(), &layout);
+		std::vector<WCHAR> work(layout.requiredLength + 16);
+
+		// 一番速かった回を取る
+		const int repeat = (files > 10000 ? 5 : 50);
+		double best = 1e300;
+		for (int r = 0; r < repeat; r++) {
+			std::copy(input.begin(), input.end(), work.begin());
+			Stopwatch stopwatch;
+			MultiSelectLayout l;
+			scanMultiSelect(work.data(), (UINT32)work.size(), &l);
+			expandMultiSelect(work.data(), (UINT32)work.size(), l);
+			const double microseconds = stopwatch.getMicroseconds();
+			if (microseconds < best) best = microseconds;
+		}
+		keepValue(work[layout.requiredLength - 2]);
+
+		const std::string label = std::to_string(files) + " files";
+		report(label + " scan + expand", best, "us");
+		report(label + " per output character", best * 1000.0 / layout.requiredLength, "ns");
+	}
+}
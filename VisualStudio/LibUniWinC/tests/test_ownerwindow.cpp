@@ -0,0 +1,145 @@
+﻿// test_ownerwindow.cpp : Finding our own window among many top-level windows, through the thread windows and the cache
+
+#include "unittest.h"
+#include <string>
+
+/// <summary>
+/// Windows of other processes, stacked above the windows created so far
+/// </summary>
+static void createOtherWindows(VirtualDesktop& desktop, const int count) {
+	for (int i = 0; i < count; i++) {
+		const LONG x = (i % 50) * 30;
+		desktop.backend.createWindow(5000 + i, { x, x, x + 300, x + 200 }, WS_OVERLAPPEDWINDOW | WS_VISIBLE);
+	}
+}
+
+static void sendToBottom(VirtualDesktop& desktop, const HWND hWnd) {
+	desktop.backend.setWindowPos(hWnd, HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+}
+
+/// <summary>
+/// The search before the cache: the process ID of every top-level window
+/// </summary>
+struct ProcessSearch {
+	VirtualBackend* pBackend;
+	DWORD processId;
+	HWND hWnd;
+};
+
+static BOOL CALLBACK findByProcessProc(const HWND hWnd, const LPARAM lParam) {
+	ProcessSearch* pSearch = (ProcessSearch*)lParam;
+	if (pSearch->pBackend->getWindowProcessId(hWnd) != pSearch->processId) return TRUE;
+	pSearch->hWnd = hWnd;
+	return FALSE;
+}
+
+
+TEST(ownerwindow, FoundWithoutVisitingOtherWindows) {
+	VirtualDesktop desktop;
+	const HWND hMine = desktop.createMyWindow({ 100, 100, 900, 700 });
+	createOtherWindows(desktop, 1000);
+
+	// 自分のスレッドのウィンドウだけを調べる
+	desktop.backend.resetCallCounts();
+	REQUIRE(AttachMyOwnerWindow());
+	CHECK(GetWindowHandle() == hMine);
+	CHECK(desktop.backend.getCallCounts().enumeratedWindows <= 1);
+	DetachWindow();
+
+	// 次からは覚えているので何も数えない
+	desktop.backend.resetCallCounts();
+	for (int i = 0; i < 10; i++) {
+		CHECK(AttachMyOwnerWindow());
+		DetachWindow();
+	}
+	CHECK_EQ((UINT64)0, desktop.backend.getCallCounts().enumeratedWindows);
+}
+
+TEST(ownerwindow, DestroyedWindowIsForgotten) {
+	VirtualDesktop desktop;
+	const HWND hFirst = desktop.createMyWindow({ 100, 100, 900, 700 });
+	createOtherWindows(desktop, 100);
+
+	// アタッチ中に破棄されればウィンドウプロシージャで忘れ、新しいウィンドウを探す
+	REQUIRE(AttachMyOwnerWindow());
+	desktop.backend.destroyWindow(hFirst);
+	CHECK(GetWindowHandle() == NULL);
+	const HWND hSecond = desktop.createMyWindow({ 0, 0, 640, 480 });
+	REQUIRE(AttachMyOwnerWindow());
+	CHECK(GetWindowHandle() == hSecond);
+
+	// アタッチしていなければ破棄は知らされないが、次に探す際に確かめる
+	DetachWindow();
+	desktop.backend.destroyWindow(hSecond);
+	CHECK(!AttachMyOwnerWindow());
+	CHECK(GetWindowHandle() == NULL);
+}
+
+TEST(ownerwindow, WindowOfAnotherThread) {
+	VirtualDesktop desktop;
+	createOtherWindows(desktop, 200);
+	const DWORD mainThreadId = desktop.backend.getCurrentThreadId();
+
+	// プレイヤーの UI スレッドが作ったウィンドウと、それが持つウィンドウ
+	desktop.backend.setCurrentThreadId(mainThreadId + 1000);
+	const HWND hOwner = desktop.createMyWindow({ 0, 0, 640, 480 });
+	const HWND hOwned = desktop.backend.createWindow(desktop.backend.getCurrentProcessId(), { 0, 0, 100, 100 }, WS_VISIBLE, 0, hOwner);
+	desktop.backend.setCurrentThreadId(mainThreadId);
+	sendToBottom(desktop, hOwner);
+	sendToBottom(desktop, hOwned);
+
+	// 初めは全てを調べ、持たれているウィンドウならオーナーを選ぶ
+	REQUIRE(AttachMyOwnerWindow());
+	CHECK(GetWindowHandle() == hOwner);
+	desktop.backend.destroyWindow(hOwned);
+	desktop.backend.destroyWindow(hOwner);
+	CHECK(GetWindowHandle() == NULL);
+
+	// 作り直されても、前のウィンドウのスレッドから探せる
+	desktop.backend.setCurrentThreadId(mainThreadId + 1000);
+	const HWND hRecreated = desktop.createMyWindow({ 0, 0, 640, 480 });
+	desktop.backend.setCurrentThreadId(mainThreadId);
+	sendToBottom(desktop, hRecreated);
+
+	desktop.backend.resetCallCounts();
+	REQUIRE(AttachMyOwnerWindow());
+	CHECK(GetWindowHandle() == hRecreated);
+	CHECK(desktop.backend.getCallCounts().enumeratedWindows <= 1);
+}
+
+
+BENCHMARK(ownerwindow, TenThousandWindows) {
+	VirtualDesktop desktop;
+	const HWND hMine = desktop.createMyWindow({ 100, 100, 900, 700 });
+	const int count = 10000;
+	createOtherWindows(desktop, count);
+	const std::string label = std::to_string(count + 1) + " windows";
+
+	// 以前の方法。自分のウィンドウが一番下にあるので全てを調べる
+	const int repeat = 200;
+	ProcessSearch search = { &desktop.backend, desktop.backend.getCurrentProcessId(), NULL };
+	Stopwatch stopwatch;
+	for (int r = 0; r < repeat; r++) {
+		search.hWnd = NULL;
+		desktop.backend.enumWindows(findByProcessProc, (LPARAM)&search);
+	}
+	report(label + " EnumWindows scan", stopwatch.getMicroseconds() / repeat, "us/call");
+	keepValue(search.hWnd == hMine);
+
+	desktop.backend.resetCallCounts();
+	stopwatch.restart();
+	AttachMyOwnerWindow();
+	report(label + " first attach", stopwatch.getMicroseconds(), "us");
+	report(label + " first attach, enumerated", (double)desktop.backend.getCallCounts().enumeratedWindows, "windows");
+	DetachWindow();
+
+	// UpdateTargetWindow() のように毎フレーム探す
+	desktop.backend.resetCallCounts();
+	stopwatch.restart();
+	for (int r = 0; r < repeat; r++) {
+		AttachMyOwnerWindow();
+		DetachWindow();
+	}
+	report(label + " cached attach + detach", stopwatch.getMicroseconds() / repeat, "us/call");
+	report(label + " cached attach, enumerated", (double)desktop.backend.getCallCounts().enumeratedWindows, "windows");
+}
@@ -0,0 +1,249 @@
+﻿// test_panelfilter.cpp : The compiled filter of the file panels, its cache and the forms made from it
+
+#include "unittest.h"
+#include "panelfilter.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Null terminated copy of the text, as passed from C#
+/// </summary>
+static std::vector<WCHAR> toText(const std::u16string& text) {
+	std::vector<WCHAR> result(text.begin(), text.end());
+	result.push_back(u'\0');
+	return result;
+}
+
+static std::shared_ptr<const PanelFilter> compileText(const std::u16string& text) {
+	std::vector<WCHAR> buffer = toText(text);
+	return PanelFilter::compile(buffer.data());
+}
+
+/// <summary>
+/// Filter string up to the two terminating nulls, with the nulls replaced by '|' to compare
+/// </summary>
+static std::u16string getFilterString(const PanelFilter& filter) {
+	const WCHAR* p = filter.getFilterString();
+	std::u16string result;
+	size_t i = 0;
+	while (p[i] != u'\0' || p[i + 1] != u'\0') {
+		result += (p[i] == u'\0' ? u'|' : p[i]);
+		i++;
+	}
+	return result;
+}
+
+/// <summary>
+/// "Title\text0\text1..." with the extensions "ext0" to "ext{count - 1}"
+/// </summary>
+static std::u16string makeLongFilter(const int count) {
+	std::u16string text = u"Assets";
+	for (int i = 0; i < count; i++) {
+		const std::string ext = ((i % 50) == 7 ? "tar.gz" : "ext") + std::to_string(i);
+		text += u'\t';
+		text += std::u16string(ext.begin(), ext.end());
+	}
+	return text;
+}
+
+
+TEST(panelfilter, FilterStringAndDefaultExt) {
+	std::shared_ptr<const PanelFilter> filter = compileText(u"Image files\tpng\tJPG\nAll files\t*\n");
+	REQUIRE(filter);
+	CHECK(getFilterString(*filter) == u"Image files|*.png;*.JPG|All files|*.*");
+	REQUIRE(filter->getDefaultExt() != NULL);
+	CHECK(std::u16string(filter->getDefaultExt()) == u"png");
+
+	// 空行は読み飛ばし、空のタイトルはパターンで置き換える
+	filter = compileText(u"\n\n\ttxt\tlog\n\nText\ttxt");
+	REQUIRE(filter);
+	CHECK_EQ((UINT32)2, filter->getGroupCount());
+	CHECK(getFilterString(*filter) == u"*.txt;*.log|*.txt;*.log|Text|*.txt");
+
+	// ワイルドカードで始まるなら既定の拡張子は無い
+	filter = compileText(u"Any\t*\tpng");
+	REQUIRE(filter);
+	CHECK(filter->getDefaultExt() == NULL);
+
+	filter = compileText(u"");
+	REQUIRE(filter);
+	CHECK_EQ((UINT32)0, filter->getGroupCount());
+	CHECK(filter->getFilterString()[0] == u'\0' && filter->getFilterString()[1] == u'\0');
+	CHECK(filter->isMatchAll());
+
+	CHECK(!PanelFilter::compile(NULL));
+}
+
+TEST(panelfilter, GroupsAndExtensions) {
+	std::shared_ptr<const PanelFilter> filter = compileText(u"Models\tfbx\tglb\tOBJ\nArchives\ttar.gz\tzip\nAll\t*");
+	REQUIRE(filter);
+	REQUIRE(filter->getGroupCount() == 3);
+
+	UINT32 length = 0;
+	const WCHAR* title = filter->getTitle(1, &length);
+	CHECK(std::u16string(title, length) == u"Archives");
+	CHECK_EQ((UINT32)3, filter->getExtensionCount(0));
+	CHECK_EQ((UINT32)2, filter->getExtensionCount(1));
+
+	const WCHAR* ext = filter->getExtension(0, 2, &length);
+	CHECK(std::u16string(ext, length) == u"OBJ");
+	ext = filter->getExtension(1, 0, &length);
+	CHECK(std::u16string(ext, length) == u"tar.gz");
+
+	CHECK(!filter->isAnyType(0));
+	CHECK(filter->isAnyType(2));
+	CHECK(filter->isMatchAll());
+}
+
+TEST(panelfilter, LongFiltersAreNotTruncated) {
+	// 以前は 1024 文字と 32 文字で切れていた
+	const int count = 500;
+	std::u16string text = makeLongFilter(count);
+	text += u"\nAll\t*\n";
+	std::shared_ptr<const PanelFilter> filter = compileText(text);
+	REQUIRE(filter);
+	REQUIRE(filter->getGroupCount() == 2);
+	CHECK_EQ((UINT32)count, filter->getExtensionCount(0));
+
+	std::u16string expected = u"Assets|";
+	for (int i = 0; i < count; i++) {
+		const std::string ext = ((i % 50) == 7 ? "tar.gz" : "ext") + std::to_string(i);
+		if (i > 0) expected += u';';
+		expected += u"*.";
+		expected += std::u16string(ext.begin(), ext.end());
+	}
+	expected += u"|All|*.*";
+	CHECK(getFilterString(*filter) == expected);
+	CHECK(expected.size() > 1024);
+
+	std::u16string longExt(300, u'x');
+	filter = compileText(u"Long\t" + longExt);
+	REQUIRE(filter);
+	REQUIRE(filter->getDefaultExt() != NULL);
+	CHECK(std::u16string(filter->getDefaultExt()) == longExt);
+	const std::u16string name = u"a." + longExt;
+	CHECK(filter->match(name.data(), name.size()));
+}
+
+TEST(panelfilter, MatchExtensionsAndWildCards) {
+	std::shared_ptr<const PanelFilter> filter = compileText(u"Data\tpng\ttar.gz\tdat?\tlog.*\nOther\tJSON");
+	REQUIRE(filter);
+	CHECK(!filter->isMatchAll());
+
+	auto match = [&filter](const std::u16string& name) { return filter->match(name.data(), name.size()); };
+	CHECK(match(u"image.PNG"));
+	CHECK(match(u"backup.Tar.Gz"));
+	CHECK(match(u"values.json"));
+	CHECK(match(u"save.dat1"));
+	CHECK(!match(u"save.dat"));
+	CHECK(match(u"server.log.3"));
+	CHECK(!match(u"server.log"));
+	CHECK(!match(u"archive.gz"));
+	CHECK(!match(u"png"));
+
+	// まとめて調べると、ディレクトリ名は見ない
+	const std::vector<std::u16string> paths = {
+		u"C:\\data\\a.png", u"C:\\data.png\\b", u"/home/u/save.DATAX", u"/home/u/save.datx", u"/logs/app.log.gz", u"",
+	};
+	const BYTE expected[] = { 1, 0, 0, 1, 1, 0 };
+	std::vector<UINT32> offsets(1, 0);
+	std::u16string data;
+	for (const std::u16string& path : paths) {
+		data += path;
+		offsets.push_back((UINT32)data.size());
+	}
+	std::vector<BYTE> results(paths.size(), 0xCD);
+	CHECK_EQ((UINT32)3, filter->matchPaths(offsets.data(), (const WCHAR*)data.data(), (UINT32)paths.size(), results.data()));
+	for (size_t i = 0; i < paths.size(); i++) {
+		CHECK_EQ((INT32)expected[i], (INT32)results[i]);
+	}
+}
+
+TEST(panelfilter, CompileInternsTheText) {
+	const std::u16string text = u"Image\tpng\tjpg\n";
+	std::shared_ptr<const PanelFilter> first = compileText(text);
+	std::shared_ptr<const PanelFilter> second = compileText(text);
+	CHECK(first && first == second);
+
+	std::shared_ptr<const PanelFilter> other = compileText(u"Image\tpng\tjpeg\n");
+	CHECK(other && other != first);
+
+	// 追い出されても、持っている間は使える
+	for (int i = 0; i < 40; i++) {
+		compileText(u"Filter" + std::u16string(1, (char16_t)(u'A' + i)) + u"\ttxt");
+	}
+	CHECK(std::u16string(first->getDefaultExt()) == u"png");
+	std::shared_ptr<const PanelFilter> again = compileText(text);
+	REQUIRE(again);
+	CHECK(getFilterString(*again) == getFilterString(*first));
+}
+
+TEST(panelfilter, PanelReceivesTheCompiledFilter) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	std::u16string filterString;
+	std::u16string defaultExt;
+	desktop.backend.setFileDialogHandler([&](OPENFILENAMEW* lpofn, BOOL) {
+		const WCHAR* p = lpofn->lpstrFilter;
+		filterString.clear();
+		for (size_t i = 0; p != NULL && (p[i] != u'\0' || p[i + 1] != u'\0'); i++) {
+			filterString += (p[i] == u'\0' ? u'|' : p[i]);
+		}
+		defaultExt = (lpofn->lpstrDefExt != NULL ? std::u16string(lpofn->lpstrDefExt) : u"");
+		return FALSE;
+	});
+
+	std::vector<WCHAR> text = toText(makeLongFilter(300));
+	PANELSETTINGS settings = PANELSETTINGS();
+	settings.nStructSize = sizeof(settings);
+	settings.lpszFilter = text.data();
+
+	std::vector<WCHAR> result(260);
+	OpenFilePanel(&settings, result.data(), (UINT32)result.size());
+	CHECK(filterString == getFilterString(*PanelFilter::compile(text.data())));
+	CHECK(filterString.size() > 1024);
+	CHECK(defaultExt == u"ext0");
+
+	DetachWindow();
+}
+
+
+BENCHMARK(panelfilter, HundredsOfExtensions) {
+	for (int count : { 10, 300, 1000 }) {
+		const std::vector<WCHAR> text = toText(makeLongFilter(count) + u"\nAll files\t*\n");
+		const std::vector<WCHAR> firstGroup = toText(makeLongFilter(count));
+		const std::string label = std::to_string(count) + " extensions";
+
+		const int repeat = 500;
+		Stopwatch stopwatch;
+		for (int r = 0; r < repeat; r++) {
+			PanelFilter filter(text.data(), text.size() - 1);
+			keepValue(filter.getFilterString()[0]);
+		}
+		report(label + " parse", stopwatch.getMicroseconds() / repeat, "us");
+
+		PanelFilter::compile(text.data());
+		stopwatch.restart();
+		for (int r = 0; r < repeat; r++) {
+			keepValue(PanelFilter::compile(text.data())->getGroupCount());
+		}
+		report(label + " compile, cached", stopwatch.getMicroseconds() / repeat, "us");
+
+		// "*" の無い最初の組だけで照合する
+		const PanelFilter filter(firstGroup.data(), firstGroup.size() - 1);
+		std::vector<std::u16string> names;
+		for (int i = 0; i < 20000; i++) {
+			const std::string name = "file_" + std::to_string(i) + ((i % 3) ? ".EXT" + std::to_string(i % (count * 2)) : ".tar.gz7");
+			names.push_back(std::u16string(name.begin(), name.end()));
+		}
+		UINT32 matched = 0;
+		stopwatch.restart();
+		for (const std::u16string& name : names) {
+			matched += filter.match(name.data(), name.size());
+		}
+		report(label + " match", stopwatch.getNanoseconds() / names.size(), "ns/name");
+		keepValue(matched);
+	}
+}
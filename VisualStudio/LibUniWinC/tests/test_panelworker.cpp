@@ -0,0 +1,265 @@
+﻿// test_panelworker.cpp : Asynchronous file panels on the thread of the library, with the virtual dialogs kept open for a delay
+
+#include "unittest.h"
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Settings with the title, which tells the dialog handler what to do
+/// </summary>
+static PANELSETTINGS makeSettings(const std::u16string& title, const INT32 flags) {
+	PANELSETTINGS settings = PANELSETTINGS();
+	settings.nStructSize = sizeof(settings);
+	settings.nFlags = flags;
+	settings.lpszTitle = (LPWSTR)title.c_str();
+	return settings;
+}
+
+/// <summary>
+/// Dialog handler chosen by the title. It runs on the panel thread
+/// </summary>
+static void setDialogHandler(VirtualDesktop& desktop, std::atomic<int>& calls) {
+	desktop.backend.setFileDialogHandler([&desktop, &calls](OPENFILENAMEW* lpofn, BOOL bSave) {
+		calls++;
+		const std::u16string title = (lpofn->lpstrTitle != NULL ? std::u16string(lpofn->lpstrTitle) : u"");
+		if (title == u"cancel") return FALSE;
+
+		std::u16string path = (title == u"multi" ? std::u16string(u"C:\\dir\0a.png\0b.png\0", 20) : (bSave ? u"C:\\save.txt" : u"C:\\" + title + u".png"));
+		if (title == u"many") {
+			// バッファに収まらないほど多くのファイル
+			path = std::u16string(u"C:\\dir", 6) + u'\0';
+			while (path.size() <= UNIWINC_PANEL_BUFFER_LENGTH) path += std::u16string(u"file.png", 8) + u'\0';
+		}
+
+		// GetOpenFileName() と同じく、収まらなければ FNERR_BUFFERTOOSMALL で失敗する
+		if (path.size() + 1 > lpofn->nMaxFile) {
+			desktop.backend.setFileDialogError(FNERR_BUFFERTOOSMALL);
+			return FALSE;
+		}
+		memcpy(lpofn->lpstrFile, path.c_str(), (path.size() + 1) * sizeof(WCHAR));
+		return TRUE;
+	});
+}
+
+/// <summary>
+/// Take the IDs of PanelCompleted until the count arrives or the time runs out
+/// </summary>
+static std::vector<UINT32> waitForCompleted(const size_t count, const int timeoutMilliseconds) {
+	std::vector<UINT32> ids;
+	Stopwatch stopwatch;
+	UNIWINCEVENT events[32];
+	while (ids.size() < count && stopwatch.getMicroseconds() < timeoutMilliseconds * 1000.0) {
+		const INT32 n = PollEvents(events, 32);
+		for (INT32 i = 0; i < n; i++) {
+			if (events[i].nType == (INT32)EventType::PanelCompleted) ids.push_back((UINT32)events[i].nParam);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	return ids;
+}
+
+/// <summary>
+/// Wait for the state, polling the events as an application does every frame
+///   PollEvents() closes again the panels which were cancelled before they were shown
+/// </summary>
+static BOOL waitForState(const UINT32 id, const PanelRequestState state, const int timeoutMilliseconds) {
+	Stopwatch stopwatch;
+	UNIWINCEVENT events[32];
+	while (GetPanelRequestState(id) != (INT32)state) {
+		if (stopwatch.getMicroseconds() > timeoutMilliseconds * 1000.0) return FALSE;
+		PollEvents(events, 32);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Result of the request as a string, '\n' between the paths
+/// </summary>
+static std::u16string takeResult(const UINT32 id) {
+	const UINT32 hResult = TakePanelRequestResult(id);
+	if (hResult == 0) return u"";
+
+	const UINT32 length = GetPanelResultLength(hResult);
+	const WCHAR* p = MapPanelResult(hResult);
+	const std::u16string result = (p != NULL && length > 0 ? std::u16string(p, length - 1) : u"");
+	ReleasePanelResult(hResult);
+	return result;
+}
+
+
+TEST(panelworker, RequestsCompleteInOrderWithoutBlocking) {
+	VirtualDesktop desktop;
+	std::atomic<int> calls(0);
+	setDialogHandler(desktop, calls);
+	desktop.backend.setFileDialogDelay(50);
+	EnableEventQueue(TRUE);
+
+	const std::u16string titles[] = { u"single", u"multi", u"cancel", u"save" };
+	PANELSETTINGS single = makeSettings(titles[0], 0);
+	PANELSETTINGS multi = makeSettings(titles[1], (INT32)PanelFlag::AllowMultiSelect);
+	PANELSETTINGS cancel = makeSettings(titles[2], 0);
+	PANELSETTINGS save = makeSettings(titles[3], 0);
+
+	// 呼び出し側はダイアログを待たない
+	Stopwatch stopwatch;
+	const UINT32 ids[] = { OpenFilePanelAsync(&single), OpenFilePanelAsync(&multi), OpenFilePanelAsync(&cancel), OpenSavePanelAsync(&save) };
+	CHECK(stopwatch.getMicroseconds() < 50 * 1000.0);
+	for (UINT32 id : ids) CHECK(id != 0);
+	CHECK(ids[0] != ids[1] && ids[1] != ids[2] && ids[2] != ids[3]);
+	CHECK_EQ((INT32)PanelRequestState::Queued, GetPanelRequestState(ids[3]));
+
+	// 一つずつ、要求の順に開いて閉じる
+	const std::vector<UINT32> completed = waitForCompleted(4, 5000);
+	REQUIRE(completed.size() == 4);
+	for (size_t i = 0; i < 4; i++) CHECK_EQ(ids[i], completed[i]);
+	CHECK(stopwatch.getMicroseconds() >= 4 * 50 * 1000.0);
+	CHECK_EQ(4, calls.load());
+
+	CHECK_EQ((INT32)PanelRequestState::Selected, GetPanelRequestState(ids[0]));
+	CHECK(takeResult(ids[0]) == u"C:\\single.png");
+	CHECK(takeResult(ids[0]) == u"");
+	CHECK(takeResult(ids[1]) == u"C:\\dir\\a.png\nC:\\dir\\b.png");
+	CHECK_EQ((INT32)PanelRequestState::Cancelled, GetPanelRequestState(ids[2]));
+	CHECK(takeResult(ids[2]) == u"");
+	CHECK(takeResult(ids[3]) == u"C:\\save.txt");
+
+	for (UINT32 id : ids) {
+		ReleasePanelRequest(id);
+		CHECK_EQ((INT32)PanelRequestState::None, GetPanelRequestState(id));
+	}
+}
+
+TEST(panelworker, TooManyFilesIsNotACancel) {
+	VirtualDesktop desktop;
+	std::atomic<int> calls(0);
+	setDialogHandler(desktop, calls);
+	EnableEventQueue(TRUE);
+
+	const std::u16string titles[] = { u"many", u"cancel", u"single" };
+	PANELSETTINGS many = makeSettings(titles[0], (INT32)PanelFlag::AllowMultiSelect);
+	PANELSETTINGS cancel = makeSettings(titles[1], (INT32)PanelFlag::AllowMultiSelect);
+	PANELSETTINGS single = makeSettings(titles[2], 0);
+
+	// 非同期のパネルでは要求の状態で分かる
+	const UINT32 ids[] = { OpenFilePanelAsync(&many), OpenFilePanelAsync(&cancel) };
+	REQUIRE(waitForCompleted(2, 5000).size() == 2);
+	CHECK_EQ((INT32)PanelRequestState::TooManyFiles, GetPanelRequestState(ids[0]));
+	CHECK_EQ((INT32)PanelRequestState::Cancelled, GetPanelRequestState(ids[1]));
+	CHECK(takeResult(ids[0]) == u"");
+	for (UINT32 id : ids) ReleasePanelRequest(id);
+
+	// 同期的に開いたパネルでは GetLastPanelState() で分かる
+	CHECK_EQ(0U, OpenFilePanelEx(&many));
+	CHECK_EQ((INT32)PanelRequestState::TooManyFiles, GetLastPanelState());
+	CHECK_EQ(0U, OpenFilePanelEx(&cancel));
+	CHECK_EQ((INT32)PanelRequestState::Cancelled, GetLastPanelState());
+
+	const UINT32 hResult = OpenFilePanelEx(&single);
+	CHECK(hResult != 0);
+	CHECK_EQ((INT32)PanelRequestState::Selected, GetLastPanelState());
+	ReleasePanelResult(hResult);
+	CHECK_EQ(5, calls.load());
+}
+
+TEST(panelworker, CancelQueuedAndOpenPanels) {
+	VirtualDesktop desktop;
+	std::atomic<int> calls(0);
+	setDialogHandler(desktop, calls);
+	desktop.backend.setFileDialogDelay(10000);
+	EnableEventQueue(TRUE);
+
+	const std::u16string title = u"open";
+	PANELSETTINGS settings = makeSettings(title, 0);
+	const UINT32 open = OpenFilePanelAsync(&settings);
+	const UINT32 queued = OpenFilePanelAsync(&settings);
+	REQUIRE(waitForState(open, PanelRequestState::Open, 5000));
+
+	// 待っている要求はその場で取り消される
+	CHECK(CancelPanelRequest(queued));
+	CHECK_EQ((INT32)PanelRequestState::Cancelled, GetPanelRequestState(queued));
+	CHECK(!CancelPanelRequest(queued));
+
+	// 開いているパネルは閉じられる。遅延を待たない
+	Stopwatch stopwatch;
+	CHECK(CancelPanelRequest(open));
+	const std::vector<UINT32> completed = waitForCompleted(2, 5000);
+	CHECK(stopwatch.getMicroseconds() < 5000 * 1000.0);
+	REQUIRE(completed.size() == 2);
+	CHECK_EQ(queued, completed[0]);
+	CHECK_EQ(open, completed[1]);
+	CHECK_EQ((INT32)PanelRequestState::Cancelled, GetPanelRequestState(open));
+	CHECK_EQ(0, calls.load());
+
+	CHECK(!CancelPanelRequest(open));
+	CHECK(!CancelPanelRequest(0));
+	ReleasePanelRequest(open);
+	ReleasePanelRequest(queued);
+}
+
+TEST(panelworker, OutstandingRequestsAreLimited) {
+	VirtualDesktop desktop;
+	std::atomic<int> calls(0);
+	setDialogHandler(desktop, calls);
+	desktop.backend.setFileDialogDelay(10000);
+	EnableEventQueue(TRUE);
+
+	const std::u16string title = u"many";
+	PANELSETTINGS settings = makeSettings(title, 0);
+	std::vector<UINT32> ids;
+	int refused = 0;
+	for (int i = 0; i < UNIWINC_PANEL_MAX_REQUESTS + 6; i++) {
+		const UINT32 id = OpenFilePanelAsync(&settings);
+		if (id == 0) refused++;
+		else ids.push_back(id);
+	}
+	CHECK_EQ(6, refused);
+	CHECK_EQ((size_t)UNIWINC_PANEL_MAX_REQUESTS, ids.size());
+	REQUIRE(waitForState(ids[0], PanelRequestState::Open, 5000));
+
+	// 解放すれば、開いているものも閉じて枠が空く
+	for (UINT32 id : ids) ReleasePanelRequest(id);
+	for (UINT32 id : ids) CHECK_EQ((INT32)PanelRequestState::None, GetPanelRequestState(id));
+
+	const UINT32 next = OpenFilePanelAsync(&settings);
+	REQUIRE(next != 0);
+	REQUIRE(waitForState(next, PanelRequestState::Open, 5000));
+	CHECK(CancelPanelRequest(next));
+	const std::vector<UINT32> completed = waitForCompleted(1, 5000);
+	REQUIRE(completed.size() == 1);
+	CHECK_EQ(next, completed[0]);
+	CHECK_EQ(0, calls.load());
+	ReleasePanelRequest(next);
+}
+
+TEST(panelworker, ChangingTheBackendCancelsTheRequests) {
+	std::atomic<int> calls(0);
+	UINT32 open = 0;
+	UINT32 queued = 0;
+	{
+		VirtualDesktop desktop;
+		setDialogHandler(desktop, calls);
+		desktop.backend.setFileDialogDelay(10000);
+		EnableEventQueue(TRUE);
+
+		const std::u16string title = u"open";
+		PANELSETTINGS settings = makeSettings(title, 0);
+		open = OpenFilePanelAsync(&settings);
+		queued = OpenFilePanelAsync(&settings);
+		REQUIRE(waitForState(open, PanelRequestState::Open, 5000));
+
+		setBackend(nullptr);
+		CHECK_EQ((INT32)PanelRequestState::Cancelled, GetPanelRequestState(queued));
+
+		// 閉じ終わるまで、仮想のダイアログを消さない
+		const std::vector<UINT32> completed = waitForCompleted(2, 5000);
+		CHECK_EQ((size_t)2, completed.size());
+		CHECK_EQ((INT32)PanelRequestState::Cancelled, GetPanelRequestState(open));
+	}
+	CHECK_EQ(0, calls.load());
+	ReleasePanelRequest(open);
+	ReleasePanelRequest(queued);
+}
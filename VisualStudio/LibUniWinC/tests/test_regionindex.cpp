@@ -0,0 +1,289 @@
+﻿// test_regionindex.cpp : The tiled index of the hit test mask, compared with a plain scan of the alpha values
+
+#include "unittest.h"
+#include "hittestmask.h"
+#include "regionindex.h"
+#include <random>
+#include <vector>
+
+static const INT32 TILE = RegionIndex::TILE_SIZE;
+static const BYTE THRESHOLD = 128;
+
+/// <summary>
+/// Alpha values of a mask and the brute-force answers, which do not use RegionIndex nor packAlpha()
+/// </summary>
+struct AlphaMask {
+	INT32 width;
+	INT32 height;
+	std::vector<BYTE> alpha;	// Row 0 is the bottom
+
+	AlphaMask(const INT32 w, const INT32 h) : width(w), height(h), alpha((size_t)w * h, 0) {
+	}
+
+	BOOL isOpaque(const INT32 x, const INT32 y) const {
+		return (alpha[(size_t)y * width + x] >= THRESHOLD);
+	}
+
+	void fill(const INT32 x0, const INT32 y0, const INT32 x1, const INT32 y1, const BYTE value) {
+		for (INT32 y = y0; y < y1 && y < height; y++) {
+			for (INT32 x = x0; x < x1 && x < width; x++) {
+				alpha[(size_t)y * width + x] = value;
+			}
+		}
+	}
+
+	UINT32 getStride() const { return ((UINT32)width + 7) / 8; }
+
+	/// <summary>
+	/// LSB first rows, one bit at a time
+	/// </summary>
+	std::vector<BYTE> pack() const {
+		std::vector<BYTE> bits((size_t)getStride() * height, 0);
+		for (INT32 y = 0; y < height; y++) {
+			for (INT32 x = 0; x < width; x++) {
+				if (isOpaque(x, y)) bits[(size_t)y * getStride() + x / 8] |= (BYTE)(1 << (x % 8));
+			}
+		}
+		return bits;
+	}
+
+	RegionIndex::TileState getTileState(const INT32 tileX, const INT32 tileY) const {
+		BOOL bAny = FALSE;
+		BOOL bAll = TRUE;
+		for (INT32 y = tileY * TILE; y < (tileY + 1) * TILE && y < height; y++) {
+			for (INT32 x = tileX * TILE; x < (tileX + 1) * TILE && x < width; x++) {
+				if (isOpaque(x, y)) bAny = TRUE;
+				else bAll = FALSE;
+			}
+		}
+		return (!bAny ? RegionIndex::TileState::Empty : (bAll ? RegionIndex::TileState::Full : RegionIndex::TileState::Mixed));
+	}
+
+	/// <summary>
+	/// Opaque or not at the client pixel, scaled in the same way as HitTestMask::hitTest(). The client is top-down
+	/// </summary>
+	BOOL isOpaqueAtClient(const INT32 x, const INT32 y, const INT32 clientWidth, const INT32 clientHeight) const {
+		const INT32 mx = (INT32)(((INT64)x * width) / clientWidth);
+		const INT32 my = height - 1 - (INT32)(((INT64)y * height) / clientHeight);
+		return isOpaque(mx, my);
+	}
+};
+
+static BOOL updateIndex(RegionIndex& index, const AlphaMask& mask) {
+	const std::vector<BYTE> bits = mask.pack();
+	return index.update(bits.data(), mask.getStride(), mask.width, mask.height);
+}
+
+static void checkAgainstScan(const RegionIndex& index, const AlphaMask& mask) {
+	REQUIRE(index.getWidth() == mask.width && index.getHeight() == mask.height);
+
+	const INT32 tilesX = (mask.width + TILE - 1) / TILE;
+	const INT32 tilesY = (mask.height + TILE - 1) / TILE;
+	for (INT32 ty = 0; ty < tilesY; ty++) {
+		for (INT32 tx = 0; tx < tilesX; tx++) {
+			CHECK(mask.getTileState(tx, ty) == index.getTileState(tx, ty));
+		}
+	}
+	for (INT32 y = 0; y < mask.height; y++) {
+		for (INT32 x = 0; x < mask.width; x++) {
+			CHECK_EQ(mask.isOpaque(x, y), index.test(x, y));
+		}
+	}
+}
+
+/// <summary>
+/// Each client pixel must be covered by exactly one rectangle if it is opaque, and by none otherwise
+/// </summary>
+static void checkRects(const std::vector<RECT>& rects, const AlphaMask& mask, const INT32 clientWidth, const INT32 clientHeight) {
+	std::vector<BYTE> coverage((size_t)clientWidth * clientHeight, 0);
+	for (size_t i = 0; i < rects.size(); i++) {
+		const RECT& r = rects[i];
+		REQUIRE(r.left >= 0 && r.top >= 0 && r.right <= clientWidth && r.bottom <= clientHeight);
+		REQUIRE(r.left < r.right && r.top < r.bottom);
+
+		// 上から、同じ帯の中は左から。縮小すると隙間が消えて接することはある
+		if (i > 0) {
+			const RECT& p = rects[i - 1];
+			CHECK(p.top < r.top || (p.top == r.top && p.bottom == r.bottom && p.right <= r.left));
+		}
+
+		for (LONG y = r.top; y < r.bottom; y++) {
+			for (LONG x = r.left; x < r.right; x++) {
+				coverage[(size_t)y * clientWidth + x]++;
+			}
+		}
+	}
+
+	int nErrors = 0;
+	for (INT32 y = 0; y < clientHeight && nErrors < 10; y++) {
+		for (INT32 x = 0; x < clientWidth && nErrors < 10; x++) {
+			const int expected = (mask.isOpaqueAtClient(x, y, clientWidth, clientHeight) ? 1 : 0);
+			if (coverage[(size_t)y * clientWidth + x] != expected) nErrors++;
+			CHECK_EQ(expected, (int)coverage[(size_t)y * clientWidth + x]);
+		}
+	}
+}
+
+
+TEST(regionindex, TilesAreClassifiedAsTheScan) {
+	// 幅も高さもタイルの倍数でない。右端と上端のタイルは一部だけが有効
+	AlphaMask mask(3 * TILE + 5, 2 * TILE + 7);
+	mask.fill(TILE, 0, 2 * TILE, TILE, 255);				// (1, 0) は全て不透明
+	mask.fill(2 * TILE, 0, 2 * TILE + 3, 5, 200);			// (2, 0) は一部
+	mask.fill(3 * TILE, TILE, mask.width, 2 * TILE, 255);	// (3, 1) は有効な 5 列が全て不透明
+	mask.fill(0, 2 * TILE, mask.width, mask.height, 255);	// 上端の行は有効な 7 行が全て不透明
+	mask.fill(5, 2 * TILE + 3, 6, 2 * TILE + 4, THRESHOLD - 1);	// 閾値未満の1点で Mixed になる
+
+	RegionIndex index;
+	CHECK(updateIndex(index, mask));
+	CHECK(RegionIndex::TileState::Empty == index.getTileState(0, 0));
+	CHECK(RegionIndex::TileState::Full == index.getTileState(1, 0));
+	CHECK(RegionIndex::TileState::Mixed == index.getTileState(2, 0));
+	CHECK(RegionIndex::TileState::Full == index.getTileState(3, 1));
+	CHECK(RegionIndex::TileState::Mixed == index.getTileState(0, 2));
+	CHECK(RegionIndex::TileState::Full == index.getTileState(1, 2));
+	checkAgainstScan(index, mask);
+
+	// ランダムなマスクも、全体が不透明なマスクも走査と一致する
+	std::mt19937 random(4);
+	for (BYTE& a : mask.alpha) a = ((random() % 5) == 0 ? 255 : 0);
+	CHECK(updateIndex(index, mask));
+	checkAgainstScan(index, mask);
+
+	mask.fill(0, 0, mask.width, mask.height, 255);
+	CHECK(updateIndex(index, mask));
+	checkAgainstScan(index, mask);
+
+	mask.fill(0, 0, mask.width, mask.height, 0);
+	CHECK(updateIndex(index, mask));
+	checkAgainstScan(index, mask);
+}
+
+TEST(regionindex, OnlyTheDirtyTileRowsAreRebuilt) {
+	AlphaMask mask(100, 4 * TILE);
+	std::mt19937 random(5);
+	for (BYTE& a : mask.alpha) a = ((random() % 3) == 0 ? 255 : 0);
+
+	RegionIndex index;
+	REQUIRE(updateIndex(index, mask));
+	std::vector<RECT> rects;
+	index.getRects(rects, mask.width, mask.height);
+	checkRects(rects, mask, mask.width, mask.height);
+
+	// 同じ内容では、どの行も変化せず版も変わらない
+	const std::vector<BYTE> bits = mask.pack();
+	const UINT64 version = index.getVersion();
+	for (INT32 ty = 0; ty < 4; ty++) {
+		CHECK(!index.updateTileRow(ty, &bits[(size_t)mask.getStride() * ty * TILE], mask.getStride()));
+	}
+	CHECK_EQ(version, index.getVersion());
+
+	// タイル行 2 だけを変えると、その行だけが変化し、矩形にもそれが反映される
+	mask.fill(40, 2 * TILE + 3, 70, 2 * TILE + 9, 255);
+	mask.fill(0, 3 * TILE - 1, 10, 3 * TILE, 0);
+	const std::vector<BYTE> changed = mask.pack();
+	for (INT32 ty = 0; ty < 4; ty++) {
+		CHECK_EQ((BOOL)(ty == 2), index.updateTileRow(ty, &changed[(size_t)mask.getStride() * ty * TILE], mask.getStride()));
+	}
+	CHECK(index.getVersion() != version);
+	checkAgainstScan(index, mask);
+	index.getRects(rects, mask.width, mask.height);
+	checkRects(rects, mask, mask.width, mask.height);
+
+	// Mixed から Full、Empty へ変わったタイルも、他の行を残したまま作り直される
+	mask.fill(0, TILE, mask.width, 2 * TILE, 255);
+	mask.fill(0, 0, mask.width, TILE, 0);
+	CHECK(updateIndex(index, mask));
+	checkAgainstScan(index, mask);
+	index.getRects(rects, mask.width, mask.height);
+	checkRects(rects, mask, mask.width, mask.height);
+}
+
+TEST(regionindex, PointsAtTheTileAndClientBoundaries) {
+	AlphaMask mask(2 * TILE + 1, 2 * TILE + 1);
+	std::mt19937 random(6);
+	for (BYTE& a : mask.alpha) a = ((random() % 2) == 0 ? 255 : 0);
+
+	// タイル境界の両側
+	for (INT32 y : { 0, TILE - 1, TILE, 2 * TILE - 1, 2 * TILE }) {
+		for (INT32 x : { 0, TILE - 1, TILE, 2 * TILE - 1, 2 * TILE }) {
+			mask.fill(x, y, x + 1, y + 1, ((x + y) % 2 == 0 ? 255 : 0));
+		}
+	}
+
+	RegionIndex index;
+	REQUIRE(updateIndex(index, mask));
+	checkAgainstScan(index, mask);
+
+	// マスクの外は不透明でない
+	CHECK(!index.test(-1, 0));
+	CHECK(!index.test(0, -1));
+	CHECK(!index.test(mask.width, 0));
+	CHECK(!index.test(0, mask.height));
+
+	// 拡大、縮小、割り切れない倍率のクライアント領域で、全ての画素が走査と一致する
+	HitTestMask hitTestMask;
+	const std::vector<BYTE> bits = mask.pack();
+	REQUIRE(hitTestMask.setBits(bits.data(), mask.width, mask.height));
+
+	const SIZE clients[] = { { mask.width, mask.height }, { 211, 97 }, { 40, 25 }, { 4 * mask.width, 3 * mask.height } };
+	for (const SIZE& client : clients) {
+		const INT32 cw = (INT32)client.cx;
+		const INT32 ch = (INT32)client.cy;
+		for (INT32 y = 0; y < ch; y++) {
+			for (INT32 x = 0; x < cw; x++) {
+				CHECK_EQ(mask.isOpaqueAtClient(x, y, cw, ch), hitTestMask.hitTest(x, y, cw, ch));
+			}
+		}
+
+		// クライアント領域の外はヒットする
+		CHECK(hitTestMask.hitTest(-1, 0, cw, ch));
+		CHECK(hitTestMask.hitTest(cw, ch - 1, cw, ch));
+
+		std::vector<RECT> rects;
+		UINT64 version = 0;
+		REQUIRE(hitTestMask.getRegion(rects, cw, ch, &version));
+		checkRects(rects, mask, cw, ch);
+	}
+}
+
+TEST(regionindex, InputRegionIsTheOpaqueArea) {
+	VirtualDesktop desktop;
+	HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+
+	RECT client;
+	REQUIRE(desktop.backend.getClientRect(hWnd, &client));
+	const INT32 cw = (INT32)client.right;
+	const INT32 ch = (INT32)client.bottom;
+
+	// 縮小したマスク。クライアント領域の大きさとは割り切れない
+	AlphaMask mask(cw / 4 + 3, ch / 4 + 1);
+	std::mt19937 random(7);
+	for (INT32 i = 0; i < 40; i++) {
+		const INT32 x = (INT32)(random() % mask.width);
+		const INT32 y = (INT32)(random() % mask.height);
+		mask.fill(x, y, x + 1 + (INT32)(random() % 50), y + 1 + (INT32)(random() % 20), 255);
+	}
+
+	REQUIRE(SetHitTestMask(mask.alpha.data(), mask.width, mask.height, THRESHOLD));
+	EnableInputRegion(TRUE);
+	desktop.backend.advanceTime(20);
+
+	std::vector<RECT> rects;
+	REQUIRE(desktop.backend.getInputRegion(hWnd, rects));
+	CHECK(!rects.empty());
+	checkRects(rects, mask, cw, ch);
+
+	// マスクの一部を変えると、入力領域も作り直される
+	mask.fill(0, 0, mask.width, TILE, 0);
+	mask.fill(mask.width / 2, mask.height / 2, mask.width, mask.height, 255);
+	REQUIRE(SetHitTestMask(mask.alpha.data(), mask.width, mask.height, THRESHOLD));
+	desktop.backend.advanceTime(20);
+	REQUIRE(desktop.backend.getInputRegion(hWnd, rects));
+	checkRects(rects, mask, cw, ch);
+
+	EnableInputRegion(FALSE);
+	CHECK(!desktop.backend.getInputRegion(hWnd, rects));
+	DetachWindow();
+}
@@ -0,0 +1,288 @@
+﻿// test_textcodec.cpp : The vectorized UTF-16 and UTF-8 conversion, fuzzed against a scalar reference, and its benchmark on paths
+
+#include "unittest.h"
+#include "textcodec.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Scalar reference of UTF-16 to UTF-8. Unpaired surrogates become U+FFFD
+/// </summary>
+static std::string toUtf8Reference(const std::vector<WCHAR>& src) {
+	std::string result;
+	result.reserve(src.size() * 3);
+	for (size_t i = 0; i < src.size(); i++) {
+		UINT32 c = src[i];
+		if (c >= 0xD800 && c < 0xE000) {
+			if (c < 0xDC00 && i + 1 < src.size() && src[i + 1] >= 0xDC00 && src[i + 1] < 0xE000) {
+				c = 0x10000 + ((c - 0xD800) << 10) + (src[i + 1] - 0xDC00);
+				i++;
+			}
+			else {
+				c = 0xFFFD;
+			}
+		}
+
+		if (c < 0x80) {
+			result += (char)c;
+		}
+		else if (c < 0x800) {
+			result += (char)(0xC0 | (c >> 6));
+			result += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000) {
+			result += (char)(0xE0 | (c >> 12));
+			result += (char)(0x80 | ((c >> 6) & 0x3F));
+			result += (char)(0x80 | (c & 0x3F));
+		}
+		else {
+			result += (char)(0xF0 | (c >> 18));
+			result += (char)(0x80 | ((c >> 12) & 0x3F));
+			result += (char)(0x80 | ((c >> 6) & 0x3F));
+			result += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return result;
+}
+
+/// <summary>
+/// Scalar reference of UTF-8 to UTF-16.
+///   An invalid lead byte is one U+FFFD. A sequence cut short, overlong, a surrogate or beyond U+10FFFF is one U+FFFD
+///   for the bytes read up to there.
+/// </summary>
+static std::vector<WCHAR> toUtf16Reference(const std::string& src) {
+	std::vector<WCHAR> result;
+	result.reserve(src.size());
+	size_t i = 0;
+	while (i < src.size()) {
+		UINT32 c = (BYTE)src[i++];
+		int extra = 0;
+		UINT32 minimum = 0;
+		if (c >= 0x80) {
+			if (c >= 0xC2 && c < 0xE0) { c &= 0x1F; extra = 1; minimum = 0x80; }
+			else if (c >= 0xE0 && c < 0xF0) { c &= 0x0F; extra = 2; minimum = 0x800; }
+			else if (c >= 0xF0 && c < 0xF5) { c &= 0x07; extra = 3; minimum = 0x10000; }
+			else {
+				result.push_back(0xFFFD);
+				continue;
+			}
+
+			int k = 0;
+			while (k < extra && i < src.size() && ((BYTE)src[i] & 0xC0) == 0x80) {
+				c = (c << 6) | ((BYTE)src[i] & 0x3F);
+				i++;
+				k++;
+			}
+			if (k < extra || c < minimum || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) c = 0xFFFD;
+		}
+
+		if (c < 0x10000) {
+			result.push_back((WCHAR)c);
+		}
+		else {
+			result.push_back((WCHAR)(0xD800 + ((c - 0x10000) >> 10)));
+			result.push_back((WCHAR)(0xDC00 + ((c - 0x10000) & 0x3FF)));
+		}
+	}
+	return result;
+}
+
+/// <summary>
+/// A character of the kind: ASCII, 2 bytes, CJK, surrogates, anything, or the edges of the ranges
+///   Runs of the same kind go through the vectorized paths, and changes of the kind through the scalar path.
+/// </summary>
+static WCHAR randomCharacter(std::mt19937& random, const int kind) {
+	static const WCHAR edges[] = { 0, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xD800, 0xDBFF, 0xDC00, 0xDFFF, 0xE000, 0xFFFD, 0xFFFF };
+	switch (kind) {
+	case 0: return (WCHAR)(0x20 + random() % 0x5F);
+	case 1: return (WCHAR)(0x80 + random() % 0x780);
+	case 2: return (WCHAR)(0x4E00 + random() % 0x5000);
+	case 3: return (WCHAR)(0xD800 + random() % 0x800);
+	case 4: return (WCHAR)random();
+	default: return edges[random() % (sizeof(edges) / sizeof(edges[0]))];
+	}
+}
+
+static std::vector<WCHAR> toVector(const std::u16string& text) {
+	return std::vector<WCHAR>(text.begin(), text.end());
+}
+
+/// <summary>
+/// Paths of 20000 files under 4 directories of the kind: ASCII, CJK, Cyrillic, or CJK without separators
+/// </summary>
+static std::vector<WCHAR> makePaths(const int kind) {
+	std::vector<WCHAR> result;
+	std::mt19937 random(7);
+	for (int p = 0; p < 20000; p++) {
+		for (const char* c = "/home/user/"; *c; c++) result.push_back((WCHAR)*c);
+		for (int segment = 0; segment < 4; segment++) {
+			const int length = 6 + (int)(random() % 10);
+			for (int k = 0; k < length; k++) {
+				if (kind == 1 || kind == 3) result.push_back((WCHAR)(0x4E00 + random() % 0x5000));
+				else if (kind == 2) result.push_back((WCHAR)(0x410 + random() % 0x40));
+				else result.push_back((WCHAR)(u'a' + random() % 26));
+			}
+			if (kind != 3) result.push_back(u'/');
+		}
+		for (const char* c = "file.png"; *c; c++) result.push_back((WCHAR)*c);
+	}
+	return result;
+}
+
+
+TEST(textcodec, Utf8MatchesTheReference) {
+	std::mt19937 random(42);
+	int failures = 0;
+
+	for (int iteration = 0; iteration < 100000; iteration++) {
+		const size_t length = random() % 80;
+		std::vector<WCHAR> src(length);
+		int kind = (int)(random() % 6);
+		for (WCHAR& c : src) {
+			if (random() % 8 == 0) kind = (int)(random() % 6);
+			c = randomCharacter(random, kind);
+		}
+
+		const std::string expected = toUtf8Reference(src);
+		if (getUtf8Length(src.data(), length) != expected.size()) failures++;
+
+		// 既存の内容の後ろに足す
+		std::string appended = "pre";
+		appendUtf8(src.data(), length, appended);
+		if (appended != "pre" + expected) failures++;
+
+		std::string converted(expected.size() + 1, '\x55');
+		if (convertToUtf8(src.data(), length, &converted[0]) != expected.size()) failures++;
+		if (converted.compare(0, expected.size(), expected) != 0 || converted.back() != '\x55') failures++;
+	}
+	CHECK_EQ(0, failures);
+}
+
+TEST(textcodec, Utf16MatchesTheReference) {
+	static const unsigned char edges[] = { 0x80, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF5, 0xFF, 0xA0, 0x9F };
+	std::mt19937 random(43);
+	int failures = 0;
+
+	for (int iteration = 0; iteration < 100000; iteration++) {
+		// 正しい文字の並び、ASCII、でたらめなバイト、境界のバイトを混ぜる
+		const size_t length = random() % 100;
+		std::string src;
+		int kind = (int)(random() % 4);
+		while (src.size() < length) {
+			if (random() % 10 == 0) kind = (int)(random() % 4);
+			if (kind == 0) {
+				src += (char)(random() % 0x80);
+			}
+			else if (kind == 1) {
+				src += (char)random();
+			}
+			else if (kind == 2) {
+				const std::vector<WCHAR> c(1, randomCharacter(random, (int)(random() % 6)));
+				src += toUtf8Reference(c);
+			}
+			else {
+				src += (char)edges[random() % sizeof(edges)];
+			}
+		}
+
+		const std::vector<WCHAR> expected = toUtf16Reference(src);
+		if (getUtf16Length(src.data(), src.size()) != expected.size()) failures++;
+
+		std::vector<WCHAR> appended(1, u'p');
+		appendUtf16(src.data(), src.size(), appended);
+		if (appended.size() != expected.size() + 1 || !std::equal(expected.begin(), expected.end(), appended.begin() + 1)) failures++;
+
+		// 書き込み先はバイト数の大きさでもよい
+		std::vector<WCHAR> converted(src.size() + 1, 0x5555);
+		if (convertToUtf16(src.data(), src.size(), converted.data()) != expected.size()) failures++;
+		if (!std::equal(expected.begin(), expected.end(), converted.begin()) || converted.back() != 0x5555) failures++;
+	}
+	CHECK_EQ(0, failures);
+}
+
+TEST(textcodec, KnownSequences) {
+	auto toUtf8 = [](const std::u16string& text) {
+		std::string result;
+		appendUtf8((const WCHAR*)text.data(), text.size(), result);
+		return result;
+	};
+	auto toUtf16 = [](const std::string& text) {
+		std::vector<WCHAR> result;
+		appendUtf16(text.data(), text.size(), result);
+		return result;
+	};
+
+	CHECK(toUtf8(u"C:\\a.png") == "C:\\a.png");
+	CHECK(toUtf8(u"\u00E9\u65E5\u672C") == "\xC3\xA9\xE6\x97\xA5\xE6\x9C\xAC");
+	CHECK(toUtf8(u"\U0001F600") == "\xF0\x9F\x98\x80");
+	CHECK(toUtf8(std::u16string(1, (char16_t)0xD800) + u"a") == "\xEF\xBF\xBD" "a");
+	CHECK(toUtf8(std::u16string(1, (char16_t)0xDC00)) == "\xEF\xBF\xBD");
+
+	CHECK(toUtf16("\xE6\x97\xA5\xE6\x9C\xAC.txt") == toVector(u"\u65E5\u672C.txt"));
+	CHECK(toUtf16("\xF0\x9F\x98\x80") == toVector(u"\U0001F600"));
+	CHECK(toUtf16("\xC0\x80") == toVector(u"\uFFFD\uFFFD"));				// Overlong NUL
+	CHECK(toUtf16("\xED\xA0\x80") == toVector(u"\uFFFD"));				// Surrogate
+	CHECK(toUtf16("\xE6\x97" "a") == toVector(u"\uFFFDa"));				// Cut short
+	CHECK(toUtf16("\xF4\x90\x80\x80") == toVector(u"\uFFFD"));			// Beyond U+10FFFF
+	CHECK(toUtf16("\x80\xFF") == toVector(u"\uFFFD\uFFFD"));
+
+	CHECK_EQ((size_t)0, getUtf8Length(NULL, 10));
+	CHECK_EQ((size_t)0, convertToUtf8(NULL, 10, NULL));
+	CHECK_EQ((size_t)0, convertToUtf16(NULL, 10, NULL));
+}
+
+TEST(textcodec, ValidTextRoundTrips) {
+	for (int kind = 0; kind < 4; kind++) {
+		const std::vector<WCHAR> paths = makePaths(kind);
+		std::string utf8;
+		appendUtf8(paths.data(), paths.size(), utf8);
+		std::vector<WCHAR> utf16;
+		appendUtf16(utf8.data(), utf8.size(), utf16);
+		CHECK(utf16 == paths);
+		CHECK(utf8 == toUtf8Reference(paths));
+	}
+}
+
+
+BENCHMARK(textcodec, Paths) {
+	const char* names[] = { "ASCII paths", "CJK paths", "Cyrillic paths", "CJK names" };
+	for (int kind = 0; kind < 4; kind++) {
+		const std::vector<WCHAR> paths = makePaths(kind);
+		const std::string utf8 = toUtf8Reference(paths);
+		const std::string label = names[kind];
+
+		// 一番速かった回を取る
+		const int repeat = 100;
+		double best[4] = { 1e300, 1e300, 1e300, 1e300 };
+		for (int r = 0; r < repeat; r++) {
+			for (int k = 0; k < 4; k++) {
+				Stopwatch stopwatch;
+				if (k == 0) {
+					std::string s;
+					appendUtf8(paths.data(), paths.size(), s);
+					keepValue(s.size());
+				}
+				else if (k == 1) {
+					keepValue(toUtf8Reference(paths).size());
+				}
+				else if (k == 2) {
+					std::vector<WCHAR> v;
+					appendUtf16(utf8.data(), utf8.size(), v);
+					keepValue(v.size());
+				}
+				else {
+					keepValue(toUtf16Reference(utf8).size());
+				}
+				const double nanoseconds = stopwatch.getNanoseconds();
+				if (nanoseconds < best[k]) best[k] = nanoseconds;
+			}
+		}
+
+		report(label + " UTF-16 to UTF-8", best[0] / paths.size(), "ns/char");
+		report(label + " UTF-16 to UTF-8, scalar reference", best[1] / paths.size(), "ns/char");
+		report(label + " UTF-8 to UTF-16", best[2] / paths.size(), "ns/char");
+		report(label + " UTF-8 to UTF-16, scalar reference", best[3] / paths.size(), "ns/char");
+	}
+}
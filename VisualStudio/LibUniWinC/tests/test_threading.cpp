@@ -0,0 +1,345 @@
+﻿// test_threading.cpp : Calls from threads other than the window thread
+
+#include "unittest.h"
+#include "invokequeue.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Run the function on a new thread and wait for it
+/// </summary>
+template <typename Function>
+static void runOnOtherThread(Function function) {
+	std::thread thread(function);
+	thread.join();
+}
+
+/// <summary>
+/// Drop the files and tell whether all of them can be read at once, without streaming
+/// </summary>
+static BOOL dropAtOnce(VirtualDesktop& desktop, const HWND hWnd, const int count) {
+	std::vector<std::u16string> paths;
+	for (int i = 0; i < count; i++) {
+		paths.push_back(u"C:\\Assets\\file" + std::u16string(1, (char16_t)(u'a' + i % 26)) + u".png");
+	}
+	if (!desktop.backend.dropFiles(hWnd, paths)) return FALSE;
+
+	UINT32 offsets[2];
+	WCHAR data[256];
+	DROPFILESPAGE page;
+	page.nStructSize = sizeof(page);
+	GetDropFiles(0, offsets, 1, data, 256, &page);
+	return (page.nAvailableCount == page.nTotalCount);
+}
+
+
+TEST(threading, NoThreadIsTheWindowThreadUntilBound) {
+	InvokeQueue queue;
+	CHECK(!queue.isWindowThread());
+
+	// 最初にバインドしたスレッドだけがウィンドウスレッドになる
+	BOOL bBefore = TRUE;
+	BOOL bBound = FALSE;
+	runOnOtherThread([&]() {
+		bBefore = queue.isWindowThread();
+		bBound = queue.bindIfUnbound();
+	});
+	CHECK(!bBefore);
+	CHECK(bBound);
+	CHECK(!queue.isWindowThread());
+	CHECK(!queue.bindIfUnbound());
+
+	queue.bindCurrentThread();
+	CHECK(queue.isWindowThread());
+	CHECK(queue.bindIfUnbound());
+}
+
+TEST(threading, ChangesFromOtherThreadsWaitForTheWindowThread) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+
+	// バックエンドを用意したスレッドがウィンドウスレッドなので、他のスレッドからはアタッチできない
+	BOOL bAttached = TRUE;
+	BOOL bQueued = FALSE;
+	runOnOtherThread([&]() {
+		bAttached = AttachMyWindow();
+		Update();
+		SetTopmost(TRUE);
+		bQueued = SetPosition(10, 20);
+	});
+	CHECK(!bAttached);
+	CHECK(bQueued);
+	CHECK(!IsTopmost());
+
+	// アタッチした後の Update() で、頼まれた順に反映される
+	REQUIRE(AttachMyWindow());
+	Update();
+	CHECK(IsTopmost());
+	float x, y;
+	GetPosition(&x, &y);
+	CHECK(x == 10 && y == 20);
+}
+
+TEST(threading, DropSettingsFromOtherThreadsAreQueued) {
+	VirtualDesktop desktop;
+	const HWND hWnd = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	SetAllowDrop(TRUE);
+	EnableEventQueue(TRUE);
+
+	// ウィンドウスレッドで反映されるまでは、以前の設定のまま
+	runOnOtherThread([]() {
+		EnableDropStreaming(TRUE, 1);
+		EnableDropFileInfo(FALSE, 2);
+
+		// フィルタは呼び出し中に作られるので、戻った後にバッファを壊してもよい
+		std::vector<WCHAR> filter = { u'I', u'm', u'a', u'g', u'e', u'\t', u'p', u'n', u'g', u'\0' };
+		EnableDropExpansion(FALSE, filter.data(), 2, 2);
+		std::fill(filter.begin(), filter.end(), u'?');
+	});
+	CHECK(dropAtOnce(desktop, hWnd, 20000));
+
+	Update();
+	CHECK(!dropAtOnce(desktop, hWnd, 20000));
+
+	// 止めると残りは一度に取り込まれる
+	runOnOtherThread([]() { EnableDropStreaming(FALSE, 0); });
+	Update();
+	CHECK(dropAtOnce(desktop, hWnd, 20000));
+}
+
+TEST(threading, SnapshotCursorAndTweensOnOtherThreads) {
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	desktop.backend.setCursorPos(300, 200);
+
+	WINDOWSNAPSHOT mine = WINDOWSNAPSHOT();
+	mine.nStructSize = sizeof(mine);
+	REQUIRE(GetWindowSnapshot(&mine));
+
+	// 他のスレッドでも同じ状態と世代が返る
+	WINDOWSNAPSHOT other = WINDOWSNAPSHOT();
+	BOOL bSnapshot = FALSE;
+	BOOL bCursor = FALSE;
+	float cursorX = 0, cursorY = 0;
+	runOnOtherThread([&]() {
+		other.nStructSize = sizeof(other);
+		other.nGeneration = mine.nGeneration;
+		bSnapshot = GetWindowSnapshot(&other);
+		bCursor = GetCursorPosition(&cursorX, &cursorY);
+	});
+	REQUIRE(bSnapshot);
+	CHECK_EQ(mine.nGeneration, other.nGeneration);
+	CHECK(!(other.nFlags & (INT32)WindowSnapshotFlag::Changed));
+	CHECK(other.nFlags & (INT32)WindowSnapshotFlag::Attached);
+	CHECK(other.x == mine.x && other.y == mine.y && other.width == 800 && other.height == 600);
+	CHECK(other.nMonitor == mine.nMonitor && other.nMonitorCount == mine.nMonitorCount);
+	CHECK(bCursor);
+	CHECK(cursorX == 300 && cursorX == other.cursorX && cursorY == other.cursorY);
+
+	// カーソルだけなら世代は変わらず、ウィンドウが動けば変わる
+	desktop.backend.setCursorPos(310, 210);
+	runOnOtherThread([&]() { GetWindowSnapshot(&other); });
+	CHECK(!(other.nFlags & (INT32)WindowSnapshotFlag::Changed));
+	CHECK(other.cursorX == 310);
+
+	SetPosition(40, 50);
+	runOnOtherThread([&]() { GetWindowSnapshot(&other); });
+	CHECK(other.nFlags & (INT32)WindowSnapshotFlag::Changed);
+	CHECK(other.x == 40 && other.y == 50);
+
+	// アニメーションの状態も他のスレッドから見える
+	WINDOWTWEEN tween = WINDOWTWEEN();
+	tween.nStructSize = sizeof(tween);
+	tween.nFlags = (INT32)WindowTweenFlag::Alpha;
+	tween.alpha = 0.5f;
+	tween.nDuration = 100;
+	const UINT32 id = StartWindowTween(&tween);
+	REQUIRE(id != 0);
+
+	BOOL bAny = FALSE, bThis = FALSE, bOther = TRUE;
+	auto readTweens = [&]() {
+		bAny = IsWindowTweening(0);
+		bThis = IsWindowTweening(id);
+		bOther = IsWindowTweening(id + 1);
+	};
+	runOnOtherThread(readTweens);
+	CHECK(bAny && bThis && !bOther);
+
+	desktop.backend.advanceTime(200);
+	CHECK(!IsWindowTweening(id));
+	runOnOtherThread(readTweens);
+	CHECK(!bAny && !bThis);
+}
+
+TEST(threading, GettersRaceWithTheWindowThread) {
+	// ThreadSanitizer でも走らせる (uniwinc_tests_tsan)。読み取りが途中の値を見ないことも調べる
+	VirtualDesktop desktop;
+	desktop.backend.clearMonitors();
+	desktop.backend.addMonitor({ 0, 0, 1920, 1080 });
+	const HWND hWnd = desktop.createMyWindow({ 100, 100, 300, 200 });
+	REQUIRE(AttachMyWindow());
+	EnableEventQueue(TRUE);
+	const UINT32 hContext = GetDefaultContext();
+
+	std::atomic<BOOL> bStop(FALSE);
+	std::atomic<int> torn(0);
+	std::atomic<int> badMonitors(0);
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; t++) {
+		readers.emplace_back([&, t]() {
+			for (int n = 0; !bStop.load(); n++) {
+				// 幅は常に高さの2倍、カーソルは常に対角線上にある
+				float width, height, x, y;
+				if (GetSize(&width, &height) && width != 2 * height) torn++;
+				if (GetContextSize(hContext, &width, &height) && width != 2 * height) torn++;
+				WINDOWSNAPSHOT snapshot = WINDOWSNAPSHOT();
+				snapshot.nStructSize = sizeof(snapshot);
+				if (GetWindowSnapshot(&snapshot) && snapshot.width != 2 * snapshot.height) torn++;
+				if (GetCursorPosition(&x, &y) && x + y != 1079) torn++;
+
+				const INT32 count = GetMonitorCount();
+				if (count != 1 && count != 2) badMonitors++;
+				if (GetMonitorRectangle(0, &x, &y, &width, &height) && width != 1920) badMonitors++;
+
+				GetPosition(&x, &y);
+				IsTopmost();
+				IsMaximized();
+				IsWindowTweening(0);
+				GetCurrentMonitor();
+				GetWindowHandle();
+
+				// 他のスレッドからの変更は、ウィンドウスレッドへ送られる
+				if (t == 0 && n < 2000) SetTopmost((n & 1) != 0);
+				if (t == 1 && n < 2000) SetAlphaValue((n % 10) / 10.0f + 0.05f);
+			}
+		});
+	}
+
+	// ウィンドウスレッドは動かし、モニタを変え、アニメーションを進め、送られた変更を反映する
+	WINDOWTWEEN fade = WINDOWTWEEN();
+	fade.nStructSize = sizeof(fade);
+	fade.nFlags = (INT32)WindowTweenFlag::Alpha;
+	fade.alpha = 0.5f;
+	fade.nDuration = 5;
+	for (int k = 0; k < 5000; k++) {
+		const int height = 100 + k % 300;
+		desktop.backend.setWindowPos(hWnd, NULL, k % 500, k % 500, 2 * height, height, SWP_NOZORDER | SWP_NOACTIVATE);
+		desktop.backend.setCursorPos(k % 1000, k % 1000);
+		if (k % 500 == 0) {
+			desktop.backend.clearMonitors();
+			desktop.backend.addMonitor({ 0, 0, 1920, 1080 });
+			if (k % 1000 == 0) desktop.backend.addMonitor({ 1920, 0, 3840, 1080 });
+			desktop.backend.notifyDisplayChange();
+		}
+		if (k % 100 == 0) StartWindowTween(&fade);
+		desktop.backend.advanceTime(1);
+
+		if (k % 2 == 0) {
+			Update();
+		} else {
+			UNIWINCEVENT events[8];
+			PollEvents(events, 8);
+		}
+	}
+	bStop = TRUE;
+	for (std::thread& reader : readers) reader.join();
+	Update();
+
+	CHECK_EQ(0, torn.load());
+	CHECK_EQ(0, badMonitors.load());
+}
+
+TEST(threading, PanelsOpenOnlyOnTheWindowThread) {
+	// ThreadSanitizer でも走らせる。最後の結果やウィンドウスレッドだけの状態を、他のスレッドが読んでも競合しない
+	VirtualDesktop desktop;
+	desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachMyWindow());
+	EnableEventQueue(TRUE);
+
+	std::atomic<int> calls(0);
+	desktop.backend.setFileDialogHandler([&calls](OPENFILENAMEW* lpofn, BOOL) {
+		calls++;
+		const std::u16string path = u"C:\\Assets\\image.png";
+		if (path.size() + 1 > lpofn->nMaxFile) return FALSE;
+		std::copy(path.c_str(), path.c_str() + path.size() + 1, lpofn->lpstrFile);
+		return TRUE;
+	});
+
+	const std::u16string title = u"Open";
+	PANELSETTINGS settings = PANELSETTINGS();
+	settings.nStructSize = sizeof(settings);
+	settings.lpszTitle = (LPWSTR)title.c_str();
+	PANELSETTINGSUTF8 settingsUtf8 = PANELSETTINGSUTF8();
+	settingsUtf8.nStructSize = sizeof(settingsUtf8);
+
+	std::atomic<BOOL> bStop(FALSE);
+	std::atomic<int> opened(0);
+	std::atomic<int> badResults(0);
+	std::thread other([&]() {
+		WCHAR buffer[64];
+		char bytes[64];
+		REFRESHSTATS refresh;
+		refresh.nStructSize = sizeof(refresh);
+		EVENTSTATS events;
+		events.nStructSize = sizeof(events);
+		while (!bStop.load()) {
+			// 他のスレッドからは開けない
+			if (OpenFilePanel(&settings, buffer, 64) || OpenSavePanel(&settings, buffer, 64)) opened++;
+			if (OpenFilePanelEx(&settings) != 0 || OpenSavePanelEx(&settings) != 0) opened++;
+			if (OpenFilePanelAsync(&settings) != 0 || OpenSavePanelAsync(&settings) != 0) opened++;
+			if (OpenFilePanelUtf8(&settingsUtf8) != 0 || OpenSavePanelAsyncUtf8(&settingsUtf8) != 0) opened++;
+
+			// 最後の結果は、置き換えられている途中でも読めるか、無いかのどちらか
+			const UINT32 length = GetPanelResultLength(0);
+			if (length != 0 && length != 20) badResults++;
+			if (GetPanelResult(0, buffer, 64) && std::u16string(buffer) != u"C:\\Assets\\image.png") badResults++;
+			const INT32 size = GetPanelResultUtf8(0, bytes, 64);
+			if (size != -1 && size != 20) badResults++;
+
+			// ウィンドウスレッドで数えているものは読めない
+			if (GetRefreshStats(&refresh) || GetEventStats(&events) || GetDebugInfo() != 0) badResults++;
+			const INT32 mode = GetRefreshMode();
+			if (mode != (INT32)RefreshMode::FrameChanged && mode != (INT32)RefreshMode::ResizeTrick) badResults++;
+			GetDesktopWindowHandle();
+			GetMyProcessId();
+		}
+	});
+
+	// ウィンドウスレッドは開き直し、付け替え、枠の設定を変える
+	WCHAR buffer[64];
+	int shown = 0;
+	for (int k = 0; k < 300; k++) {
+		if (k % 3 == 0) {
+			CHECK(OpenFilePanel(&settings, buffer, 64));
+			shown++;
+		} else if (k % 3 == 1) {
+			const UINT32 hResult = OpenFilePanelEx(&settings);
+			CHECK(hResult != 0);
+			ReleasePanelResult(hResult);
+			shown++;
+		} else {
+			DetachWindow();
+			CHECK(OpenSavePanel(&settings, buffer, 64));
+			shown++;
+			REQUIRE(AttachMyWindow());
+		}
+		SetRefreshMode((INT32)(k % 2 == 0 ? RefreshMode::ResizeTrick : RefreshMode::FrameChanged));
+		SetBorderless(k % 2 == 0);
+	}
+	bStop = TRUE;
+	other.join();
+
+	CHECK_EQ(0, opened.load());
+	CHECK_EQ(0, badResults.load());
+	CHECK_EQ(shown, calls.load());
+
+	REFRESHSTATS refresh;
+	refresh.nStructSize = sizeof(refresh);
+	CHECK(GetRefreshStats(&refresh));
+	CHECK(refresh.nFrameChanges > 0);
+	DetachWindow();
+}
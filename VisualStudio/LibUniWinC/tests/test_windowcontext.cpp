@@ -0,0 +1,306 @@
+﻿// test_windowcontext.cpp : Many windows controlled at once, each by its own context kept in the slabs
+
+#include "unittest.h"
+#include "windowcontext.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Windows of this process in a grid and a context attached to each of them
+/// </summary>
+struct ContextGrid {
+	std::vector<HWND> windows;
+	std::vector<UINT32> contexts;
+
+	ContextGrid(VirtualDesktop& desktop, const int count) {
+		for (int i = 0; i < count; i++) {
+			const LONG x = (i % 20) * 90;
+			const LONG y = (i / 20) * 60;
+			windows.push_back(desktop.backend.createWindow(desktop.backend.getCurrentProcessId(), { x, y, x + 300, y + 200 }, WS_OVERLAPPEDWINDOW | WS_VISIBLE));
+			contexts.push_back(CreateContext());
+		}
+	}
+
+	/// <summary>
+	/// Destroy the contexts before the desktop goes away, so that the windows are restored
+	/// </summary>
+	~ContextGrid() {
+		for (UINT32 hContext : contexts) DestroyContext(hContext);
+	}
+};
+
+/// <summary>
+/// Number of the events of the type and the parameter, with the width of the last one
+/// </summary>
+static int countEvents(const UINT32 hContext, const EventType type, const INT32 param, INT32* pWidth) {
+	UNIWINCEVENT events[64];
+	int count = 0;
+	INT32 n;
+	while ((n = PollContextEvents(hContext, events, 64)) > 0) {
+		for (INT32 i = 0; i < n; i++) {
+			if (events[i].nType != (INT32)type || events[i].nParam != param) continue;
+			count++;
+			if (pWidth != nullptr) *pWidth = events[i].width;
+		}
+	}
+	return count;
+}
+
+
+TEST(windowcontext, SlabGrowsAndReusesSlots) {
+	WindowContextSlab slab;
+	const UINT32 count = WindowContextSlab::SLAB_SIZE * 3 + 5;
+	std::vector<UINT32> handles;
+	for (UINT32 i = 0; i < count; i++) {
+		const UINT32 handle = slab.create();
+		REQUIRE(handle != 0);
+		handles.push_back(handle);
+	}
+	CHECK_EQ(count, slab.getCount());
+
+	// 番号の小さい方から使い、スラブをまたいでもポインターは動かない
+	std::vector<WindowContext*> pointers;
+	for (UINT32 i = 0; i < count; i++) {
+		CHECK_EQ(i + 1, handles[i] & 0xFFFF);
+		pointers.push_back(slab.get(handles[i]));
+		REQUIRE(pointers[i] != nullptr);
+		CHECK_EQ(handles[i], slab.getHandle(pointers[i]));
+	}
+	for (UINT32 i = 0; i < WindowContextSlab::SLAB_SIZE * 4; i++) slab.destroy(slab.create());
+	for (UINT32 i = 0; i < count; i++) CHECK(slab.get(handles[i]) == pointers[i]);
+
+	std::vector<UINT32> listed;
+	slab.getHandles(listed);
+	CHECK(listed == handles);
+
+	// 消した枠は後から消した方から再利用され、世代が進むので古いハンドルは使えない
+	const UINT32 first = handles[10];
+	const UINT32 second = handles[100];
+	CHECK(slab.destroy(first));
+	CHECK(slab.destroy(second));
+	CHECK(!slab.destroy(first));
+	CHECK(slab.get(first) == nullptr);
+	CHECK(slab.get(second) == nullptr);
+	CHECK(slab.getHandle(pointers[10]) == 0);
+	CHECK_EQ(count - 2, slab.getCount());
+
+	const UINT32 reused = slab.create();
+	CHECK_EQ(second & 0xFFFF, reused & 0xFFFF);
+	CHECK(reused != second);
+	CHECK(slab.get(reused) == pointers[100]);
+	CHECK(slab.get(second) == nullptr);
+	const UINT32 reusedFirst = slab.create();
+	CHECK_EQ(first & 0xFFFF, reusedFirst & 0xFFFF);
+	CHECK(reusedFirst != first);
+
+	CHECK(slab.get(0) == nullptr);
+	CHECK(slab.get(0xFFFF) == nullptr);
+	CHECK(slab.getHandle(nullptr) == 0);
+}
+
+TEST(windowcontext, GenerationNeverMakesAZeroHandle) {
+	WindowContextSlab slab;
+	UINT32 handle = slab.create();
+	const UINT32 index = handle & 0xFFFF;
+
+	// 世代が一周しても 0 は使わず、直前のハンドルは常に使えない
+	for (int i = 0; i < 0x10000 + 10; i++) {
+		const UINT32 previous = handle;
+		REQUIRE(slab.destroy(previous));
+		handle = slab.create();
+		REQUIRE(handle != 0 && (handle >> 16) != 0);
+		REQUIRE((handle & 0xFFFF) == index);
+		REQUIRE(handle != previous);
+		REQUIRE(slab.get(previous) == nullptr);
+	}
+	CHECK(slab.destroy(handle));
+}
+
+TEST(windowcontext, WindowsAreBoundToOneContext) {
+	WindowContextSlab slab;
+	const UINT32 a = slab.create();
+	const UINT32 b = slab.create();
+	const HWND hFirst = (HWND)(intptr_t)0x1000;
+	const HWND hSecond = (HWND)(intptr_t)0x2000;
+
+	CHECK(slab.bindWindow(a, hFirst));
+	CHECK(slab.bindWindow(a, hFirst));
+	CHECK(!slab.bindWindow(b, hFirst));
+	CHECK(slab.bindWindow(b, hSecond));
+	CHECK(slab.findByWindow(hFirst) == slab.get(a));
+	CHECK(slab.findByWindow(hSecond) == slab.get(b));
+	CHECK(slab.findByWindow(NULL) == nullptr);
+
+	// 付け替えれば前のウィンドウは空く
+	CHECK(slab.bindWindow(a, (HWND)(intptr_t)0x3000));
+	CHECK(slab.findByWindow(hFirst) == nullptr);
+	CHECK(slab.bindWindow(b, hFirst));
+	CHECK(slab.findByWindow(hSecond) == nullptr);
+
+	// 消したコンテキストのウィンドウも空き、古いハンドルでは結べない
+	CHECK(slab.destroy(b));
+	CHECK(slab.findByWindow(hFirst) == nullptr);
+	CHECK(!slab.bindWindow(b, hSecond));
+	CHECK(slab.findByWindow(hSecond) == nullptr);
+	CHECK(slab.destroy(a));
+}
+
+TEST(windowcontext, HundredsOfWindowsKeepTheirOwnState) {
+	VirtualDesktop desktop;
+	const HWND hMain = desktop.createMyWindow({ 100, 100, 900, 700 });
+	REQUIRE(AttachWindowHandle(hMain));
+	EnableEventQueue(TRUE);
+
+	const int count = 300;
+	ContextGrid grid(desktop, count);
+	for (int i = 0; i < count; i++) {
+		REQUIRE(grid.contexts[i] != 0);
+		REQUIRE(AttachContextWindow(grid.contexts[i], grid.windows[i]));
+		CHECK(EnableContextEventQueue(grid.contexts[i], TRUE));
+	}
+
+	// 一つのウィンドウは一つのコンテキストにしか付かない
+	CHECK(!AttachContextWindow(grid.contexts[1], grid.windows[0]));
+	CHECK(!AttachWindowHandle(grid.windows[5]));
+	CHECK(GetWindowHandle() == hMain);
+
+	for (int i = 0; i < count; i++) {
+		const UINT32 hContext = grid.contexts[i];
+		if (i % 2) CHECK(SetContextBorderless(hContext, TRUE));
+		if (i % 3 == 0) CHECK(SetContextTopmost(hContext, TRUE));
+		CHECK(SetContextAlphaValue(hContext, (i % 10) / 10.0f + 0.05f));
+		CHECK(SetContextSize(hContext, (float)(200 + i), (float)(150 + i)));
+		CHECK(SetContextPosition(hContext, (float)(10 + i), (float)(20 + i)));
+	}
+
+	int mismatches = 0;
+	for (int i = 0; i < count; i++) {
+		const UINT32 hContext = grid.contexts[i];
+		if (IsContextBorderless(hContext) != (i % 2 ? TRUE : FALSE)) mismatches++;
+		if (IsContextTopmost(hContext) != (i % 3 == 0 ? TRUE : FALSE)) mismatches++;
+		float width, height, x, y;
+		GetContextSize(hContext, &width, &height);
+		GetContextPosition(hContext, &x, &y);
+		if (width != 200 + i || height != 150 + i || x != 10 + i || y != 20 + i) mismatches++;
+		if (desktop.backend.getLayeredAlpha(grid.windows[i]) != (BYTE)(0xFF * ((i % 10) / 10.0f + 0.05f))) mismatches++;
+		if (GetContextWindowHandle(hContext) != grid.windows[i]) mismatches++;
+	}
+	CHECK_EQ(0, mismatches);
+
+	// 既定のコンテキストは変わらない
+	CHECK(!IsBorderless() && !IsTopmost());
+	float width, height;
+	GetSize(&width, &height);
+	CHECK(width == 800 && height == 600);
+}
+
+TEST(windowcontext, EventsGoToTheContextOfTheWindow) {
+	VirtualDesktop desktop;
+	REQUIRE(AttachWindowHandle(desktop.createMyWindow({ 100, 100, 900, 700 })));
+	EnableEventQueue(TRUE);
+
+	const int count = 300;
+	ContextGrid grid(desktop, count);
+	for (int i = 0; i < count; i++) {
+		REQUIRE(AttachContextWindow(grid.contexts[i], grid.windows[i]));
+		EnableContextEventQueue(grid.contexts[i], TRUE);
+	}
+	UNIWINCEVENT events[64];
+	while (PollEvents(events, 64) > 0) {}
+	for (UINT32 hContext : grid.contexts) countEvents(hContext, EventType::None, 0, nullptr);
+
+	for (int i = 0; i < count; i += 7) SetContextSize(grid.contexts[i], 333, 222);
+	int wrong = 0;
+	for (int i = 0; i < count; i++) {
+		INT32 eventWidth = 0;
+		const int resized = countEvents(grid.contexts[i], EventType::WindowStateChanged, (INT32)WindowStateEventType::Resized, &eventWidth);
+		if ((resized > 0) != (i % 7 == 0)) wrong++;
+		if (resized > 0 && eventWidth != 333) wrong++;
+	}
+	CHECK_EQ(0, wrong);
+	CHECK_EQ(0, PollEvents(events, 64));
+
+	// タイマーで進むアニメーションも、それぞれのウィンドウで動く
+	for (int i = 0; i < count; i++) {
+		WINDOWTWEEN tween = WINDOWTWEEN();
+		tween.nStructSize = sizeof(tween);
+		tween.nFlags = (INT32)WindowTweenFlag::Position;
+		tween.x = (float)(500 + i);
+		tween.y = 300;
+		tween.nDuration = 100;
+		CHECK(StartContextWindowTween(grid.contexts[i], &tween) != 0);
+	}
+	desktop.backend.advanceTime(150);
+	int mismatches = 0;
+	for (int i = 0; i < count; i++) {
+		float x, y;
+		GetContextPosition(grid.contexts[i], &x, &y);
+		if (x != 500 + i || y != 300) mismatches++;
+	}
+	CHECK_EQ(0, mismatches);
+	float x, y;
+	GetPosition(&x, &y);
+	CHECK_EQ(100.0f, x);
+}
+
+TEST(windowcontext, StaleHandlesAreRejected) {
+	VirtualDesktop desktop;
+	const int count = 100;
+	ContextGrid grid(desktop, count);
+	for (int i = 0; i < count; i++) REQUIRE(AttachContextWindow(grid.contexts[i], grid.windows[i]));
+	SetContextBorderless(grid.contexts[10], TRUE);
+
+	// 消すとウィンドウは元に戻り、古いハンドルでは何もできない
+	const UINT32 old = grid.contexts[10];
+	CHECK(DestroyContext(old));
+	CHECK(!DestroyContext(old));
+	CHECK(!SetContextTopmost(old, TRUE));
+	CHECK(GetContextWindowHandle(old) == NULL);
+	UNIWINCEVENT events[8];
+	CHECK_EQ(-1, PollContextEvents(old, events, 8));
+	CHECK(!DestroyContext(GetDefaultContext()));
+	CHECK(!DestroyContext(0));
+
+	// 同じ枠が新しい世代で使われ、新しい状態で始まる
+	const UINT32 reused = CreateContext();
+	grid.contexts[10] = reused;
+	CHECK(reused != old);
+	CHECK_EQ(old & 0xFFFF, reused & 0xFFFF);
+	CHECK(AttachContextWindow(reused, grid.windows[10]));
+	CHECK(!IsContextBorderless(reused));
+	CHECK(!SetContextTopmost(old, TRUE));
+	CHECK(!IsContextTopmost(reused));
+
+	// ウィンドウが消えればコンテキストはそれを忘れ、ウィンドウは別のコンテキストで使える
+	desktop.backend.destroyWindow(grid.windows[20]);
+	CHECK(GetContextWindowHandle(grid.contexts[20]) == NULL);
+	CHECK(!IsContextActive(grid.contexts[20]));
+	CHECK(DetachContextWindow(grid.contexts[30]));
+	CHECK(AttachContextWindow(grid.contexts[20], grid.windows[30]));
+}
+
+
+BENCHMARK(windowcontext, MessageDispatch) {
+	VirtualDesktop desktop;
+	for (int count : { 1, 64, 300, 1000 }) {
+		ContextGrid grid(desktop, count);
+		for (int i = 0; i < count; i++) AttachContextWindow(grid.contexts[i], grid.windows[i]);
+		const std::string label = std::to_string(count) + " contexts";
+
+		Stopwatch stopwatch;
+		for (int i = 0; i < count; i++) {
+			SetContextPosition(grid.contexts[i], (float)(10 + i), (float)(20 + i));
+		}
+		report(label + " SetContextPosition", stopwatch.getNanoseconds() / count, "ns/call");
+
+		// ウィンドウプロシージャはメッセージごとにコンテキストを探す
+		const int messages = 100000;
+		stopwatch.restart();
+		for (int k = 0; k < messages; k++) {
+			desktop.backend.sendMessage(grid.windows[(k * 7) % count], WM_MOUSEMOVE, 0, 0);
+		}
+		report(label + " WM_MOUSEMOVE", stopwatch.getNanoseconds() / messages, "ns/msg");
+
+		for (HWND hWnd : grid.windows) desktop.backend.destroyWindow(hWnd);
+	}
+}
@@ -0,0 +1,291 @@
+﻿// test_windowtween.cpp : Window tweens, stepped by the timer of the virtual desktop on its virtual clock
+
+#include "unittest.h"
+#include "windowtween.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+static WINDOWTWEEN makeTween(const INT32 flags, const float x, const float y, const float width, const float height, const float alpha, const INT32 duration, const EasingType easing) {
+	WINDOWTWEEN tween = WINDOWTWEEN();
+	tween.nStructSize = sizeof(tween);
+	tween.nFlags = flags;
+	tween.x = x;
+	tween.y = y;
+	tween.width = width;
+	tween.height = height;
+	tween.alpha = alpha;
+	tween.nDuration = duration;
+	tween.nEasing = (INT32)easing;
+	return tween;
+}
+
+/// <summary>
+/// A popup window at (100, 100)-(900, 700) on a 1920x1080 monitor, that is x = 100 and y = 380 from the bottom-left
+/// </summary>
+static HWND setUpDesktop(VirtualDesktop& desktop) {
+	const HWND hWnd = desktop.backend.createWindow(desktop.backend.getCurrentProcessId(), { 100, 100, 900, 700 }, WS_POPUP | WS_VISIBLE);
+	AttachMyWindow();
+	EnableEventQueue(TRUE);
+	return hWnd;
+}
+
+static RECT getRect(VirtualDesktop& desktop, const HWND hWnd) {
+	RECT rect = { 0, 0, 0, 0 };
+	desktop.backend.getWindowRect(hWnd, &rect);
+	return rect;
+}
+
+/// <summary>
+/// "Completed(id)" and "Cancelled(id)" of the tween events since the last call
+/// </summary>
+static std::string takeTweenEvents() {
+	std::string result;
+	UNIWINCEVENT events[64];
+	INT32 n;
+	while ((n = PollEvents(events, 64)) > 0) {
+		for (INT32 i = 0; i < n; i++) {
+			if (events[i].nType == (INT32)EventType::TweenCompleted) result += " Completed(" + std::to_string(events[i].nParam) + ")";
+			if (events[i].nType == (INT32)EventType::TweenCancelled) result += " Cancelled(" + std::to_string(events[i].nParam) + ")";
+		}
+	}
+	return result;
+}
+
+
+TEST(windowtween, EasingCurves) {
+	for (int e = (int)EasingType::Linear; e <= (int)EasingType::InOutCubic; e++) {
+		const EasingType easing = (EasingType)e;
+		CHECK(std::fabs(WindowTweener::ease(easing, 0.0)) < 1e-12);
+		CHECK(std::fabs(WindowTweener::ease(easing, 1.0) - 1.0) < 1e-12);
+
+		// 単調増加で、途中で途切れない
+		double previous = -1.0;
+		int decreases = 0;
+		for (int i = 0; i <= 1000; i++) {
+			const double value = WindowTweener::ease(easing, i / 1000.0);
+			if (value < previous - 1e-12) decreases++;
+			previous = value;
+		}
+		CHECK_EQ(0, decreases);
+		CHECK(std::fabs(WindowTweener::ease(easing, 0.5 - 1e-9) - WindowTweener::ease(easing, 0.5 + 1e-9)) < 1e-6);
+	}
+
+	CHECK(std::fabs(WindowTweener::ease(EasingType::Linear, 0.25) - 0.25) < 1e-12);
+	CHECK(std::fabs(WindowTweener::ease(EasingType::InQuad, 0.5) - 0.25) < 1e-12);
+	CHECK(std::fabs(WindowTweener::ease(EasingType::OutQuad, 0.5) - 0.75) < 1e-12);
+	CHECK(std::fabs(WindowTweener::ease(EasingType::InCubic, 0.5) - 0.125) < 1e-12);
+	CHECK(std::fabs(WindowTweener::ease(EasingType::OutCubic, 0.5) - 0.875) < 1e-12);
+	for (double t = 0.0; t <= 1.0; t += 0.125) {
+		CHECK(std::fabs(WindowTweener::ease(EasingType::InOutQuad, t) + WindowTweener::ease(EasingType::InOutQuad, 1.0 - t) - 1.0) < 1e-12);
+		CHECK(std::fabs(WindowTweener::ease(EasingType::InOutCubic, t) + WindowTweener::ease(EasingType::InOutCubic, 1.0 - t) - 1.0) < 1e-12);
+	}
+}
+
+TEST(windowtween, ValuesDependOnlyOnTheTime) {
+	const TweenValues from = { 0, 1000, 100, 100, 0 };
+	const TweenValues to = { 800, 400, 500, 300, 255 };
+	std::vector<UINT32> ids;
+	WindowTweener regular;
+	WindowTweener irregular;
+	regular.start(0, 7, from, to, 300000, EasingType::InOutCubic, ids);
+	irregular.start(0, 7, from, to, 300000, EasingType::InOutCubic, ids);
+
+	// 間引いたり戻ったりする刻みでも、同じ時刻なら同じ値になる
+	UINT32 seed = 12345;
+	int differences = 0;
+	std::vector<UINT32> completedRegular;
+	std::vector<UINT32> completedIrregular;
+	for (INT64 now = 0; now <= 320000; now += 1000) {
+		TweenValues a = from;
+		regular.step(now, a, completedRegular);
+
+		seed = seed * 1103515245 + 12345;
+		TweenValues b = from;
+		if ((seed >> 16) % 3 == 0) irregular.step(now - ((seed >> 8) % 7) * 1000, b, completedIrregular);
+		b = from;
+		irregular.step(now, b, completedIrregular);
+
+		if (a.left != b.left || a.bottom != b.bottom || a.width != b.width || a.height != b.height || a.alpha != b.alpha) differences++;
+		if (now == 150000) CHECK(std::fabs(a.left - 400) < 1e-9 && std::fabs(a.alpha - 127.5) < 1e-9);
+	}
+	CHECK_EQ(0, differences);
+	CHECK_EQ((size_t)1, completedRegular.size());
+	CHECK_EQ((size_t)1, completedIrregular.size());
+	CHECK(regular.isEmpty());
+}
+
+TEST(windowtween, NewerTweensTakeTheProperties) {
+	const TweenValues from = { 0, 0, 100, 100, 255 };
+	const TweenValues to = { 100, 100, 200, 200, 0 };
+	std::vector<UINT32> cancelled;
+	WindowTweener tweener;
+
+	const UINT32 a = tweener.start(0, (DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Alpha, from, to, 1000, EasingType::Linear, cancelled);
+	const UINT32 b = tweener.start(0, (DWORD)WindowTweenFlag::Position, from, to, 2000, EasingType::Linear, cancelled);
+	CHECK(a != 0 && b != 0 && a != b);
+	CHECK(cancelled.empty());
+	CHECK_EQ((DWORD)5, tweener.getFlags());
+
+	// a は透明度だけを動かし、位置は b が動かす
+	TweenValues values = from;
+	std::vector<UINT32> completed;
+	CHECK_EQ((DWORD)5, tweener.step(500, values, completed));
+	CHECK(std::fabs(values.alpha - 127.5) < 1e-9);
+	CHECK(std::fabs(values.left - 25) < 1e-9);
+	CHECK_EQ(100.0, values.width);
+
+	// 全ての属性を取られたら取り消される
+	tweener.start(500, (DWORD)WindowTweenFlag::Alpha, from, to, 1000, EasingType::Linear, cancelled);
+	REQUIRE(cancelled.size() == 1);
+	CHECK_EQ(a, cancelled[0]);
+	CHECK(!tweener.isRunning(a));
+	CHECK(tweener.isRunning(b));
+
+	CHECK_EQ((UINT32)0, tweener.start(0, 0, from, to, 1000, EasingType::Linear, cancelled));
+	CHECK(tweener.stop(b, FALSE));
+	CHECK(!tweener.stop(b, FALSE));
+	tweener.clear(cancelled);
+	CHECK(tweener.isEmpty());
+}
+
+TEST(windowtween, OneWindowChangePerTick) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+	desktop.backend.resetCallCounts();
+
+	// 位置と大きさ、透明度の 2 つの tween を同時に動かす
+	WINDOWTWEEN bounds = makeTween((INT32)WindowTweenFlag::Position | (INT32)WindowTweenFlag::Size, 500, 200, 400, 300, 0, 200, EasingType::InOutQuad);
+	WINDOWTWEEN alpha = makeTween((INT32)WindowTweenFlag::Alpha, 0, 0, 0, 0, 0.25f, 200, EasingType::Linear);
+	const UINT32 boundsId = StartWindowTween(&bounds);
+	const UINT32 alphaId = StartWindowTween(&alpha);
+	CHECK(boundsId != 0 && alphaId != 0);
+	CHECK(IsWindowTweening(0));
+	CHECK(IsWindowTweening(boundsId));
+
+	int ticks = 0;
+	for (int ms = 1; ms <= 250; ms++) {
+		const UINT64 messages = desktop.backend.getCallCounts().messages;
+		desktop.backend.advanceTime(1);
+		if (desktop.backend.getCallCounts().messages != messages) ticks++;
+
+		if (ms == 100) {
+			const RECT rect = getRect(desktop, hWnd);
+			CHECK(rect.left == 300 && rect.top == 340 && rect.right - rect.left == 600 && rect.bottom - rect.top == 450);
+			CHECK_EQ(159, (int)desktop.backend.getLayeredAlpha(hWnd));
+		}
+	}
+
+	// 目標に着き、属性の数によらず 1 刻みに 1 回だけウィンドウを変える
+	const RECT rect = getRect(desktop, hWnd);
+	CHECK(rect.left == 500 && rect.top == 580 && rect.right == 900 && rect.bottom == 880);
+	CHECK_EQ(63, (int)desktop.backend.getLayeredAlpha(hWnd));
+	CHECK(ticks > 0);
+	CHECK_EQ((UINT64)ticks, desktop.backend.getCallCounts().setWindowPos);
+	CHECK_EQ((UINT64)ticks, desktop.backend.getCallCounts().setLayeredWindowAttributes);
+
+	CHECK(!IsWindowTweening(0));
+	CHECK(takeTweenEvents() == " Completed(" + std::to_string(boundsId) + ") Completed(" + std::to_string(alphaId) + ")");
+}
+
+TEST(windowtween, StopReplaceAndDetach) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+	takeTweenEvents();
+
+	// 同じ属性の新しい tween が古いものを取り消す
+	WINDOWTWEEN move = makeTween((INT32)WindowTweenFlag::Position, 0, 0, 0, 0, 0, 500, EasingType::Linear);
+	WINDOWTWEEN moveAndFade = makeTween((INT32)WindowTweenFlag::Position | (INT32)WindowTweenFlag::Alpha, 300, 300, 0, 0, 0.5f, 500, EasingType::Linear);
+	const UINT32 replaced = StartWindowTween(&move);
+	const UINT32 newer = StartWindowTween(&moveAndFade);
+	desktop.backend.advanceTime(100);
+	CHECK(takeTweenEvents() == " Cancelled(" + std::to_string(replaced) + ")");
+
+	// 止めて目標へ
+	CHECK(StopWindowTween(newer, TRUE));
+	RECT rect = getRect(desktop, hWnd);
+	CHECK(rect.left == 300 && 1080 - rect.bottom == 300);
+	CHECK_EQ(127, (int)desktop.backend.getLayeredAlpha(hWnd));
+	CHECK(takeTweenEvents() == " Completed(" + std::to_string(newer) + ")");
+	CHECK(!StopWindowTween(newer, TRUE));
+
+	// 長さ 0 はその場で目標へ
+	WINDOWTWEEN resize = makeTween((INT32)WindowTweenFlag::Size, 0, 0, 640, 480, 0, 0, EasingType::Linear);
+	const UINT32 immediate = StartWindowTween(&resize);
+	rect = getRect(desktop, hWnd);
+	CHECK(rect.right - rect.left == 640 && rect.bottom - rect.top == 480 && 1080 - rect.bottom == 300);
+	CHECK(takeTweenEvents() == " Completed(" + std::to_string(immediate) + ")");
+
+	// その場で止めれば、もう動かない
+	const UINT32 stopped = StartWindowTween(&move);
+	desktop.backend.advanceTime(50);
+	rect = getRect(desktop, hWnd);
+	CHECK(StopWindowTween(stopped, FALSE));
+	desktop.backend.advanceTime(100);
+	CHECK_EQ(rect.left, getRect(desktop, hWnd).left);
+	CHECK(takeTweenEvents() == " Cancelled(" + std::to_string(stopped) + ")");
+
+	// ウィンドウを離すと取り消される
+	const UINT32 detached = StartWindowTween(&move);
+	DetachWindow();
+	CHECK(!IsWindowTweening(0));
+	CHECK(takeTweenEvents() == " Cancelled(" + std::to_string(detached) + ")");
+
+	WINDOWTWEEN invalid = move;
+	invalid.nStructSize = 4;
+	CHECK_EQ((UINT32)0, StartWindowTween(&invalid));
+	CHECK_EQ((UINT32)0, StartWindowTween(NULL));
+}
+
+
+BENCHMARK(windowtween, WindowChanges) {
+	VirtualDesktop desktop;
+	const HWND hWnd = setUpDesktop(desktop);
+	(void)hWnd;
+
+	// 同じアニメーションを、ネイティブの tween と、16 ms ごとに 3 つの関数を呼ぶコルーチンで
+	desktop.backend.resetCallCounts();
+	WINDOWTWEEN bounds = makeTween((INT32)WindowTweenFlag::Position | (INT32)WindowTweenFlag::Size, 500, 200, 400, 300, 0, 200, EasingType::Linear);
+	WINDOWTWEEN alpha = makeTween((INT32)WindowTweenFlag::Alpha, 0, 0, 0, 0, 0.25f, 200, EasingType::Linear);
+	StartWindowTween(&bounds);
+	StartWindowTween(&alpha);
+	desktop.backend.advanceTime(250);
+	const VirtualBackend::CallCounts native = desktop.backend.getCallCounts();
+
+	SetSize(800, 600);
+	SetPosition(100, 380);
+	SetAlphaValue(1.0f);
+	desktop.backend.resetCallCounts();
+	for (int frame = 1; frame <= 13; frame++) {
+		double e = frame / 12.5;
+		if (e > 1) e = 1;
+		SetPosition((float)(100 + 400 * e), (float)(380 - 180 * e));
+		SetSize((float)(800 - 400 * e), (float)(600 - 300 * e));
+		SetAlphaValue((float)(1 - 0.75 * e));
+	}
+	const VirtualBackend::CallCounts legacy = desktop.backend.getCallCounts();
+
+	report("StartWindowTween SetWindowPos", (double)native.setWindowPos, "calls");
+	report("StartWindowTween SetLayeredWindowAttributes", (double)native.setLayeredWindowAttributes, "calls");
+	report("StartWindowTween GetWindowRect", (double)native.getWindowRect, "calls");
+	report("per-frame calls SetWindowPos", (double)legacy.setWindowPos, "calls");
+	report("per-frame calls SetLayeredWindowAttributes", (double)legacy.setLayeredWindowAttributes, "calls");
+	report("per-frame calls GetWindowRect", (double)legacy.getWindowRect, "calls");
+
+	// 刻みごとの計算
+	const TweenValues from = { 0, 0, 100, 100, 255 };
+	const TweenValues to = { 800, 600, 400, 300, 0 };
+	std::vector<UINT32> ids;
+	WindowTweener tweener;
+	tweener.start(0, (DWORD)WindowTweenFlag::Position, from, to, 1000000000, EasingType::InOutCubic, ids);
+	tweener.start(0, (DWORD)WindowTweenFlag::Size, from, to, 1000000000, EasingType::OutQuad, ids);
+	tweener.start(0, (DWORD)WindowTweenFlag::Alpha, from, to, 1000000000, EasingType::Linear, ids);
+	const int repeat = 1000000;
+	Stopwatch stopwatch;
+	for (int i = 0; i < repeat; i++) {
+		TweenValues values = from;
+		tweener.step(i, values, ids);
+		keepValue(values.left);
+	}
+	report("WindowTweener::step, 3 tweens", stopwatch.getNanoseconds() / repeat, "ns");
+}
@@ -0,0 +1,515 @@
+﻿// test_x11.cpp : Smoke test of the X11 backend on a bare X server (Xvfb, no window manager)
+//
+//   Built as uniwinc_x11_tests and run by "xvfb-run -a uniwinc_x11_tests x11".
+//   The window is created on a connection of its own, as Unity does, and found by _NET_WM_PID.
+//   File drops are sent by a drag source on the same connection, as a file manager does by XDND.
+
+#include "unittest.h"
+#include <xcb/xcb.h>
+#include <xcb/shape.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A connection of the test, which owns a top-level window of this process
+/// </summary>
+class X11TestWindow {
+public:
+	X11TestWindow() {
+		conn = xcb_connect(nullptr, nullptr);
+		if (xcb_connection_has_error(conn)) return;
+
+		xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+		window = xcb_generate_id(conn);
+		xcb_create_window(conn, XCB_COPY_FROM_PARENT, window, screen->root, 100, 100, 640, 480, 0,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, 0, nullptr);
+
+		uint32_t pid = (uint32_t)getpid();
+		xcb_change_property(conn, XCB_PROP_MODE_REPLACE, window, getAtom("_NET_WM_PID"), XCB_ATOM_CARDINAL, 32, 1, &pid);
+		xcb_map_window(conn, window);
+		sync();
+	}
+
+	~X11TestWindow() {
+		if (window != XCB_NONE) xcb_destroy_window(conn, window);
+		xcb_disconnect(conn);
+	}
+
+	BOOL isConnected() const {
+		return (window != XCB_NONE);
+	}
+
+	/// <summary>
+	/// Wait until the requests of this connection are processed
+	/// </summary>
+	void sync() {
+		free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), nullptr));
+	}
+
+	xcb_atom_t getAtom(const char* name) {
+		xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(conn, xcb_intern_atom(conn, 0, (uint16_t)strlen(name), name), nullptr);
+		xcb_atom_t atom = (reply ? reply->atom : (xcb_atom_t)XCB_NONE);
+		free(reply);
+		return atom;
+	}
+
+	std::vector<uint32_t> getProperty32(const char* name, const xcb_atom_t type) {
+		std::vector<uint32_t> values;
+		xcb_get_property_reply_t* reply = xcb_get_property_reply(conn, xcb_get_property(conn, 0, window, getAtom(name), type, 0, 64), nullptr);
+		if (reply) {
+			uint32_t* p = (uint32_t*)xcb_get_property_value(reply);
+			values.assign(p, p + xcb_get_property_value_length(reply) / 4);
+			free(reply);
+		}
+		return values;
+	}
+
+	/// <summary>
+	/// Rectangles of the input shape. The default shape is one rectangle of the window
+	/// </summary>
+	int getInputRectangleCount() {
+		xcb_shape_get_rectangles_reply_t* reply = xcb_shape_get_rectangles_reply(conn, xcb_shape_get_rectangles(conn, window, XCB_SHAPE_SK_INPUT), nullptr);
+		if (!reply) return -1;
+
+		int count = (int)reply->rectangles_len;
+		free(reply);
+		return count;
+	}
+
+	xcb_connection_t* conn = nullptr;
+	xcb_window_t window = XCB_NONE;
+};
+
+/// <summary>
+/// Requests of the library are sent on its own connection, so the server may see them a little later than ours
+/// </summary>
+static BOOL waitFor(const std::function<BOOL()>& condition) {
+	for (int i = 0; i < 100; i++) {
+		Update();
+		if (condition()) return TRUE;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return FALSE;
+}
+
+static BOOL hasAtom(const std::vector<uint32_t>& atoms, const xcb_atom_t atom) {
+	for (uint32_t a : atoms) {
+		if (a == atom) return TRUE;
+	}
+	return FALSE;
+}
+
+/// <summary>
+/// XDND drag source on the connection of the test. It answers the selection request of the library
+///   with "text/uri-list" at once, or by INCR in pieces if incrPiece is not 0.
+/// </summary>
+class X11DragSource {
+public:
+	explicit X11DragSource(X11TestWindow& test) : test_(test), conn_(test.conn) {
+		xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(conn_)).data;
+		window = xcb_generate_id(conn_);
+		xcb_create_window(conn_, XCB_COPY_FROM_PARENT, window, screen->root, -10, -10, 1, 1, 0,
+			XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, nullptr);
+
+		xdndSelection_ = test.getAtom("XdndSelection");
+		uriList_ = test.getAtom("text/uri-list");
+		incr_ = test.getAtom("INCR");
+		xcb_set_selection_owner(conn_, window, xdndSelection_, XCB_CURRENT_TIME);
+		test.sync();
+	}
+
+	~X11DragSource() {
+		xcb_destroy_window(conn_, window);
+		test_.sync();
+	}
+
+	/// <summary>
+	/// XdndProxy of the test window, which the library sets when the drop is allowed
+	/// </summary>
+	xcb_window_t getProxy() {
+		std::vector<uint32_t> proxy = test_.getProperty32("XdndProxy", XCB_ATOM_WINDOW);
+		return (proxy.empty() ? XCB_NONE : proxy[0]);
+	}
+
+	/// <summary>
+	/// XdndEnter with the types in the message, or in XdndTypeList if there are more than 3
+	/// </summary>
+	void enter(const uint32_t version, const std::vector<xcb_atom_t>& types) {
+		uint32_t flags = (version << 24);
+		uint32_t inMessage[3] = { XCB_NONE, XCB_NONE, XCB_NONE };
+		if (types.size() > 3) {
+			flags |= 1;
+			xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, window, test_.getAtom("XdndTypeList"), XCB_ATOM_ATOM, 32, (uint32_t)types.size(), types.data());
+		}
+		else {
+			for (size_t i = 0; i < types.size(); i++) inMessage[i] = types[i];
+		}
+		send("XdndEnter", flags, inMessage[0], inMessage[1], inMessage[2]);
+	}
+
+	void position() {
+		send("XdndPosition", 0, (200 << 16) | 200, XCB_CURRENT_TIME, test_.getAtom("XdndActionCopy"));
+	}
+
+	void drop() {
+		send("XdndDrop", 0, XCB_CURRENT_TIME, 0, 0);
+	}
+
+	/// <summary>
+	/// Update the library and answer its requests until the condition is met
+	/// </summary>
+	BOOL pumpUntil(const std::function<BOOL()>& condition) {
+		for (int i = 0; i < 300; i++) {
+			Update();
+			xcb_generic_event_t* event;
+			while ((event = xcb_poll_for_event(conn_)) != nullptr) {
+				handleEvent(event);
+				free(event);
+			}
+			if (condition()) return TRUE;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return FALSE;
+	}
+
+	xcb_window_t window = XCB_NONE;
+	std::string data;				// "text/uri-list" to offer
+	uint32_t incrPiece = 0;			// Bytes of a piece of INCR, or 0 to send at once
+	int status = -1;				// Accept flag of the last XdndStatus, or -1 if none
+	int finished = -1;				// Accept flag of XdndFinished, or -1 if none
+	int incrPieces = 0;				// Pieces sent by INCR, including the last one of zero length
+
+private:
+	X11TestWindow& test_;
+	xcb_connection_t* conn_;
+	xcb_atom_t xdndSelection_;
+	xcb_atom_t uriList_;
+	xcb_atom_t incr_;
+
+	// INCR transfer in progress
+	xcb_window_t incrRequestor_ = XCB_NONE;
+	xcb_atom_t incrProperty_ = XCB_NONE;
+	size_t incrOffset_ = 0;
+
+	void send(const char* type, const uint32_t d1, const uint32_t d2, const uint32_t d3, const uint32_t d4) {
+		xcb_client_message_event_t ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.response_type = XCB_CLIENT_MESSAGE;
+		ev.format = 32;
+		ev.window = test_.window;
+		ev.type = test_.getAtom(type);
+		ev.data.data32[0] = window;
+		ev.data.data32[1] = d1;
+		ev.data.data32[2] = d2;
+		ev.data.data32[3] = d3;
+		ev.data.data32[4] = d4;
+		xcb_send_event(conn_, 0, getProxy(), XCB_EVENT_MASK_NO_EVENT, (const char*)&ev);
+		xcb_flush(conn_);
+	}
+
+	void handleEvent(xcb_generic_event_t* event) {
+		switch (event->response_type & ~0x80) {
+		case XCB_SELECTION_REQUEST:
+			answerRequest((xcb_selection_request_event_t*)event);
+			break;
+
+		case XCB_PROPERTY_NOTIFY: {
+			// 受け手がプロパティを消したら次の断片を書く
+			xcb_property_notify_event_t* ev = (xcb_property_notify_event_t*)event;
+			if (incrRequestor_ != XCB_NONE && ev->window == incrRequestor_ && ev->atom == incrProperty_ && ev->state == XCB_PROPERTY_DELETE) {
+				sendPiece();
+			}
+			break;
+		}
+
+		case XCB_CLIENT_MESSAGE: {
+			xcb_client_message_event_t* ev = (xcb_client_message_event_t*)event;
+			if (ev->type == test_.getAtom("XdndStatus")) status = (int)(ev->data.data32[1] & 1);
+			if (ev->type == test_.getAtom("XdndFinished")) finished = (int)(ev->data.data32[1] & 1);
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	void answerRequest(xcb_selection_request_event_t* request) {
+		xcb_selection_notify_event_t notify;
+		memset(&notify, 0, sizeof(notify));
+		notify.response_type = XCB_SELECTION_NOTIFY;
+		notify.time = request->time;
+		notify.requestor = request->requestor;
+		notify.selection = request->selection;
+		notify.target = request->target;
+		notify.property = XCB_NONE;
+
+		if (request->selection == xdndSelection_ && request->target == uriList_) {
+			notify.property = request->property;
+			if (incrPiece == 0) {
+				xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, request->requestor, request->property, uriList_, 8, (uint32_t)data.size(), data.data());
+			}
+			else {
+				// 受け手の削除を見るため、そのウィンドウのプロパティの変化を受け取る
+				const uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+				xcb_change_window_attributes(conn_, request->requestor, XCB_CW_EVENT_MASK, &mask);
+				const uint32_t size = (uint32_t)data.size();
+				xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, request->requestor, request->property, incr_, 32, 1, &size);
+				incrRequestor_ = request->requestor;
+				incrProperty_ = request->property;
+				incrOffset_ = 0;
+			}
+		}
+		xcb_send_event(conn_, 0, request->requestor, XCB_EVENT_MASK_NO_EVENT, (const char*)&notify);
+		xcb_flush(conn_);
+	}
+
+	void sendPiece() {
+		const size_t length = std::min<size_t>(incrPiece, data.size() - incrOffset_);
+		xcb_change_property(conn_, XCB_PROP_MODE_REPLACE, incrRequestor_, incrProperty_, uriList_, 8, (uint32_t)length, data.data() + incrOffset_);
+		incrOffset_ += length;
+		incrPieces++;
+		if (length == 0) {
+			incrRequestor_ = XCB_NONE;
+		}
+		xcb_flush(conn_);
+	}
+};
+
+static std::u16string droppedFiles_;
+static int dropCallbacks_ = 0;
+
+static void UNIWINC_API onDropFiles(WCHAR* paths) {
+	droppedFiles_ = paths;
+	dropCallbacks_++;
+}
+
+/// <summary>
+/// Attach the test window and allow the drop, waiting for XdndProxy
+/// </summary>
+static BOOL prepareDrop(X11DragSource& source) {
+	if (!AttachMyWindow()) return FALSE;
+	SetAllowDrop(TRUE);
+	RegisterDropFilesCallback(onDropFiles);
+	droppedFiles_.clear();
+	dropCallbacks_ = 0;
+	return waitFor([&]() { return (BOOL)(source.getProxy() != XCB_NONE); });
+}
+
+/// <summary>
+/// "text/uri-list" of many files, and the paths joined by LF as the callback receives
+/// </summary>
+static void makeUriList(const int count, std::string& uriList, std::u16string& joined) {
+	uriList.clear();
+	joined.clear();
+	for (int i = 0; i < count; i++) {
+		const std::string name = "/tmp/uniwinc drop/file_" + std::to_string(i) + ".png";
+		uriList += "file:///tmp/uniwinc%20drop/file_" + std::to_string(i) + ".png\r\n";
+		joined += std::u16string(name.begin(), name.end()) + u"\n";
+	}
+}
+
+
+TEST(x11, AttachMyWindowFindsTheWindowByPid) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+
+	REQUIRE(AttachMyWindow());
+	CHECK(IsActive());
+	CHECK_EQ((UINT_PTR)test.window, (UINT_PTR)GetWindowHandle());
+
+	CHECK(DetachWindow());
+	CHECK(!IsActive());
+}
+
+TEST(x11, BorderlessSetsTheMotifHints) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	REQUIRE(AttachMyWindow());
+	const xcb_atom_t motifHints = test.getAtom("_MOTIF_WM_HINTS");
+
+	// flags, functions, decorations, input mode, status
+	SetBorderless(TRUE);
+	CHECK(IsBorderless());
+	CHECK(waitFor([&]() {
+		std::vector<uint32_t> hints = test.getProperty32("_MOTIF_WM_HINTS", motifHints);
+		return (BOOL)(hints.size() >= 3 && hints[2] == 0);
+	}));
+
+	SetBorderless(FALSE);
+	CHECK(!IsBorderless());
+	CHECK(waitFor([&]() {
+		std::vector<uint32_t> hints = test.getProperty32("_MOTIF_WM_HINTS", motifHints);
+		return (BOOL)(hints.size() >= 3 && hints[2] != 0);
+	}));
+
+	DetachWindow();
+}
+
+TEST(x11, TopmostSetsTheNetWmState) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	REQUIRE(AttachMyWindow());
+	const xcb_atom_t above = test.getAtom("_NET_WM_STATE_ABOVE");
+
+	// ウィンドウマネージャが無いので _NET_WM_STATE は直接書き換えられる
+	SetTopmost(TRUE);
+	CHECK(IsTopmost());
+	CHECK(waitFor([&]() { return hasAtom(test.getProperty32("_NET_WM_STATE", XCB_ATOM_ATOM), above); }));
+
+	SetTopmost(FALSE);
+	CHECK(!IsTopmost());
+	CHECK(waitFor([&]() { return (BOOL)!hasAtom(test.getProperty32("_NET_WM_STATE", XCB_ATOM_ATOM), above); }));
+
+	DetachWindow();
+}
+
+TEST(x11, ClickThroughEmptiesTheInputShape) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	REQUIRE(AttachMyWindow());
+	REQUIRE(test.getInputRectangleCount() > 0);
+
+	SetClickThrough(TRUE);
+	CHECK(waitFor([&]() { return (BOOL)(test.getInputRectangleCount() == 0); }));
+
+	SetClickThrough(FALSE);
+	CHECK(waitFor([&]() { return (BOOL)(test.getInputRectangleCount() > 0); }));
+
+	DetachWindow();
+}
+
+TEST(x11, XdndDropSendsTheFiles) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	X11DragSource source(test);
+	REQUIRE(prepareDrop(source));
+
+	source.data = "# comment\r\nfile:///tmp/a%20b.txt\r\nfile:///tmp/c.txt\r\n";
+	source.enter(5, { test.getAtom("text/uri-list"), test.getAtom("text/plain") });
+	source.position();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.status >= 0); }));
+	CHECK_EQ(1, source.status);
+
+	source.drop();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.finished >= 0); }));
+	CHECK_EQ(1, source.finished);
+	CHECK_EQ(1, dropCallbacks_);
+	CHECK(droppedFiles_ == u"/tmp/a b.txt\n/tmp/c.txt\n");
+
+	DetachWindow();
+}
+
+TEST(x11, LargeDropIsReadInPiecesAndByIncr) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	X11DragSource source(test);
+	REQUIRE(prepareDrop(source));
+
+	// 一度に読む長さ（256KB）を超えるので、bytes_after を見て続きを読む
+	std::u16string expected;
+	makeUriList(20000, source.data, expected);
+	REQUIRE(source.data.size() > 0x10000 * 4);
+
+	source.enter(5, { test.getAtom("text/uri-list") });
+	source.position();
+	source.drop();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.finished >= 0); }));
+	CHECK_EQ(1, source.finished);
+	CHECK(droppedFiles_ == expected);
+	CHECK_EQ(0, source.incrPieces);
+
+	// 同じものを INCR で 64KB ずつ送る
+	droppedFiles_.clear();
+	source.finished = -1;
+	source.incrPiece = 65536;
+	source.enter(5, { test.getAtom("text/uri-list") });
+	source.position();
+	source.drop();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.finished >= 0); }));
+	CHECK_EQ(1, source.finished);
+	CHECK(droppedFiles_ == expected);
+	CHECK_EQ((int)((source.data.size() + 65535) / 65536) + 1, source.incrPieces);
+	CHECK_EQ(2, dropCallbacks_);
+
+	DetachWindow();
+}
+
+TEST(x11, XdndRefusesDragsWithoutFilesAndUnknownVersions) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	X11DragSource source(test);
+	REQUIRE(prepareDrop(source));
+	source.data = "file:///tmp/a.txt\r\n";
+
+	// ファイルを含まないドラッグは断り、落とされても XdndFinished で失敗を返す
+	source.enter(5, { test.getAtom("text/plain"), test.getAtom("UTF8_STRING") });
+	source.position();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.status >= 0); }));
+	CHECK_EQ(0, source.status);
+	source.drop();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.finished >= 0); }));
+	CHECK_EQ(0, source.finished);
+	CHECK_EQ(0, dropCallbacks_);
+
+	// 4つ以上の型は XdndTypeList から探す
+	source.status = -1;
+	source.finished = -1;
+	source.enter(5, { test.getAtom("text/plain"), test.getAtom("UTF8_STRING"), test.getAtom("STRING"), test.getAtom("text/uri-list") });
+	source.position();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.status >= 0); }));
+	CHECK_EQ(1, source.status);
+	source.drop();
+	REQUIRE(source.pumpUntil([&]() { return (BOOL)(source.finished >= 0); }));
+	CHECK_EQ(1, source.finished);
+	CHECK_EQ(1, dropCallbacks_);
+
+	// 対応していない版のドラッグには何も返さない
+	source.status = -1;
+	source.finished = -1;
+	source.enter(6, { test.getAtom("text/uri-list") });
+	source.position();
+	source.drop();
+	CHECK(!source.pumpUntil([&]() { return (BOOL)(source.status >= 0 || source.finished >= 0); }));
+	CHECK_EQ(1, dropCallbacks_);
+
+	DetachWindow();
+}
+
+TEST(x11, MonitorsCoverTheRootWindow) {
+	X11TestWindow test;
+	REQUIRE(test.isConnected());
+	REQUIRE(AttachMyWindow());
+	xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(test.conn)).data;
+
+	// Xvfb の画面は RandR のモニタ、または root ウィンドウ全体として列挙される
+	const INT32 count = GetMonitorCount();
+	REQUIRE(count >= 1);
+	float left = 1e9f, right = -1e9f, top = 1e9f, bottom = -1e9f;
+	for (INT32 i = 0; i < count; i++) {
+		float x, y, width, height;
+		REQUIRE(GetMonitorRectangle(i, &x, &y, &width, &height));
+		CHECK(width > 0 && height > 0);
+		left = std::min(left, x);
+		right = std::max(right, x + width);
+		top = std::min(top, y);
+		bottom = std::max(bottom, y + height);
+	}
+	CHECK_EQ(0.0f, left);
+	CHECK_EQ((float)screen->width_in_pixels, right - left);
+	CHECK_EQ((float)screen->height_in_pixels, bottom - top);
+
+	const INT32 current = GetCurrentMonitor();
+	CHECK(current >= 0 && current < count);
+	float x, y, width, height;
+	CHECK(!GetMonitorRectangle(count, &x, &y, &width, &height));
+
+	DetachWindow();
+}
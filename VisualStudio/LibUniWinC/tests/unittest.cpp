@@ -0,0 +1,158 @@
+﻿// unittest.cpp : Runner of the tests and benchmarks on the virtual desktop
+
+#include "unittest.h"
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int nFailures_ = 0;
+volatile INT64 nBenchmarkSink = 0;
+
+TestRegistrar::TestRegistrar(const char* suite, const char* name, void (*function)(), const BOOL bBenchmark) {
+	getCases().push_back({ suite, name, function, bBenchmark });
+}
+
+std::vector<TestCase>& TestRegistrar::getCases() {
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+void reportFailure(const char* file, const int line, const std::string& message) {
+	printf("  FAILED %s:%d: %s\n", file, line, message.c_str());
+	nFailures_++;
+}
+
+void report(const std::string& label, const double value, const char* unit) {
+	printf("  %-48s %12.3f %s\n", label.c_str(), value, unit);
+}
+
+
+VirtualDesktop::VirtualDesktop() {
+	setBackend(&backend);
+}
+
+VirtualDesktop::~VirtualDesktop() {
+	// 次のテストに残らないよう、既定のコンテキストの設定を戻す
+	StopAllWindowTweens();
+	EndDragMove();
+	SetDragMoveSnap(FALSE, 0);
+	EnableHitTestMask(FALSE);
+	EnableInputRegion(FALSE);
+	ClearHitTestMask();
+	EnableEventQueue(FALSE);
+	UnregisterWindowStyleChangedCallback();
+	UnregisterMonitorChangedCallback();
+	UnregisterDropFilesCallback();
+	UnregisterDropFilesCallbackUtf8();
+	EnableDropStreaming(FALSE, 0);
+	EnableDropFileInfo(FALSE, 0);
+	SetTransparentType(TransparentType::Alpha);
+	SetTransparent(FALSE);
+	SetBorderless(FALSE);
+	SetTopmost(FALSE);
+	SetBottommost(FALSE);
+	SetClickThrough(FALSE);
+	SetAllowDrop(FALSE);
+	SetAlphaValue(1.0f);
+	setBackend(nullptr);
+}
+
+TempDirectory::TempDirectory() {
+	const char* base = getenv("TMPDIR");
+	std::string pattern = std::string((base && base[0]) ? base : "/tmp") + "/uniwinc_test_XXXXXX";
+	std::vector<char> buffer(pattern.begin(), pattern.end());
+	buffer.push_back('\0');
+	if (mkdtemp(buffer.data())) path = buffer.data();
+}
+
+TempDirectory::~TempDirectory() {
+	if (!path.empty()) {
+		nftw(path.c_str(), [](const char* p, const struct stat*, int, struct FTW*) { return remove(p); }, 16, FTW_DEPTH | FTW_PHYS);
+	}
+}
+
+std::string TempDirectory::write(const std::string& name, const std::string& data) {
+	const std::string p = path + "/" + name;
+	FILE* file = fopen(p.c_str(), "wb");
+	if (file) {
+		fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+	}
+	return p;
+}
+
+std::string TempDirectory::makeDirectory(const std::string& name) {
+	const std::string p = path + "/" + name;
+	mkdir(p.c_str(), 0755);
+	return p;
+}
+
+std::string TempDirectory::makeLink(const std::string& name, const std::string& target) {
+	const std::string p = path + "/" + name;
+	if (symlink(target.c_str(), p.c_str()) != 0) return "";
+	return p;
+}
+
+HWND VirtualDesktop::createMyWindow(const RECT& rect) {
+	return backend.createWindow(backend.getCurrentProcessId(), rect, WS_OVERLAPPEDWINDOW | WS_VISIBLE);
+}
+
+
+/// <summary>
+/// uniwinc_tests [--bench] [--list] [suite | suite.name ...]
+///   Without a suite, all the tests (or all the benchmarks with --bench) are run
+/// </summary>
+int main(int argc, char* argv[]) {
+	BOOL bBenchmark = FALSE;
+	BOOL bList = FALSE;
+	std::vector<std::string> filters;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench") == 0) bBenchmark = TRUE;
+		else if (strcmp(argv[i], "--list") == 0) bList = TRUE;
+		else filters.push_back(argv[i]);
+	}
+
+	int count = 0;
+	for (const TestCase& test : TestRegistrar::getCases()) {
+		if (test.bBenchmark != bBenchmark) continue;
+
+		const std::string fullName = std::string(test.suite) + "." + test.name;
+		BOOL bSelected = filters.empty();
+		for (const std::string& filter : filters) {
+			if (filter == test.suite || filter == fullName) bSelected = TRUE;
+		}
+		if (!bSelected) continue;
+
+		count++;
+		if (bList) {
+			printf("%s\n", fullName.c_str());
+			continue;
+		}
+
+		printf("[ RUN  ] %s\n", fullName.c_str());
+		fflush(stdout);
+		const int failures = nFailures_;
+		try {
+			test.function();
+		}
+		catch (const TestAbort&) {
+		}
+		catch (const std::exception& e) {
+			reportFailure(__FILE__, __LINE__, std::string("exception: ") + e.what());
+		}
+		printf("[ %s ] %s\n", (nFailures_ == failures ? " OK " : "FAIL"), fullName.c_str());
+		fflush(stdout);
+	}
+
+	if (count == 0) {
+		printf("No %s matched\n", (bBenchmark ? "benchmark" : "test"));
+		return 1;
+	}
+	if (!bList) {
+		printf("%d %s, %d failure(s)\n", count, (bBenchmark ? "benchmark(s)" : "test(s)"), nFailures_);
+	}
+	return (nFailures_ == 0 ? 0 : 1);
+}
@@ -0,0 +1,142 @@
+﻿#pragma once
+
+#include "pch.h"
+#include "libuniwinc.h"
+#include "backend_virtual.h"
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Minimal test runner for the tests and benchmarks on the virtual desktop.
+//
+//   TEST(suite, name) { CHECK(...); }       : Run by "uniwinc_tests [suite...]"
+//   BENCHMARK(suite, name) { report(...); } : Run by "uniwinc_tests --bench [suite...]"
+//
+//   CHECK() records a failure and continues, REQUIRE() also ends the test.
+//   ctest runs each suite in its own process, so the global state of the library is not shared between suites.
+
+/// <summary>
+/// A registered test or benchmark
+/// </summary>
+struct TestCase {
+	const char* suite;
+	const char* name;
+	void (*function)();
+	BOOL bBenchmark;
+};
+
+/// <summary>
+/// Registers the function at static initialization
+/// </summary>
+class TestRegistrar {
+public:
+	TestRegistrar(const char* suite, const char* name, void (*function)(), const BOOL bBenchmark);
+
+	static std::vector<TestCase>& getCases();
+};
+
+/// <summary>
+/// Thrown by REQUIRE() to end the test
+/// </summary>
+struct TestAbort {};
+
+void reportFailure(const char* file, const int line, const std::string& message);
+
+/// <summary>
+/// Print a result of a benchmark, e.g. report("GetPosition", 12.3, "ns/call")
+/// </summary>
+void report(const std::string& label, const double value, const char* unit);
+
+/// <summary>
+/// Wall clock for the benchmarks
+/// </summary>
+class Stopwatch {
+public:
+	Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+	void restart() { start_ = std::chrono::steady_clock::now(); }
+	double getMicroseconds() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_).count(); }
+	double getNanoseconds() const { return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count(); }
+
+private:
+	std::chrono::steady_clock::time_point start_;
+};
+
+/// <summary>
+/// Keep the value computed by a benchmark from being optimized away
+/// </summary>
+extern volatile INT64 nBenchmarkSink;
+
+template <typename T>
+inline void keepValue(const T& value) {
+	nBenchmarkSink = nBenchmarkSink + (INT64)value;
+}
+
+/// <summary>
+/// Virtual desktop used as the backend of the library while this object lives.
+///   The default context is restored to the initial options when destroyed, so that the next test starts from the same state.
+/// </summary>
+class VirtualDesktop {
+public:
+	VirtualDesktop();
+	~VirtualDesktop();
+
+	/// <summary>
+	/// A visible top-level window of the current process
+	/// </summary>
+	HWND createMyWindow(const RECT& rect);
+
+	VirtualBackend backend;
+};
+
+/// <summary>
+/// Directory under $TMPDIR (or /tmp) removed with its contents when destroyed
+/// </summary>
+class TempDirectory {
+public:
+	TempDirectory();
+	~TempDirectory();
+
+	/// <summary>
+	/// Write a file under the directory and return its path
+	/// </summary>
+	std::string write(const std::string& name, const std::string& data);
+
+	std::string makeDirectory(const std::string& name);
+
+	/// <summary>
+	/// Symbolic link to the target
+	/// </summary>
+	std::string makeLink(const std::string& name, const std::string& target);
+
+	std::string path;
+};
+
+template <typename A, typename B>
+inline std::string describeValues(const A& a, const B& b) {
+	std::ostringstream stream;
+	stream << a << " vs " << b;
+	return stream.str();
+}
+
+#define TEST_CASE_(suite, name, bBenchmark) \
+	static void suite##_##name##_run(); \
+	static TestRegistrar suite##_##name##_registrar(#suite, #name, suite##_##name##_run, bBenchmark); \
+	static void suite##_##name##_run()
+
+#define TEST(suite, name) TEST_CASE_(suite, name, FALSE)
+#define BENCHMARK(suite, name) TEST_CASE_(suite, name, TRUE)
+
+#define CHECK(condition) \
+	do { if (!(condition)) reportFailure(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_EQ(expected, actual) \
+	do { \
+		const auto expected_ = (expected); \
+		const auto actual_ = (actual); \
+		if (!(expected_ == actual_)) reportFailure(__FILE__, __LINE__, std::string(#expected " == " #actual " (") + describeValues(expected_, actual_) + ")"); \
+	} while (0)
+
+#define REQUIRE(condition) \
+	do { if (!(condition)) { reportFailure(__FILE__, __LINE__, #condition); throw TestAbort(); } } while (0)
@@ -0,0 +1,517 @@
+﻿// textcodec.cpp : UTF-16 and UTF-8 conversion
+
+#include "pch.h"
+#include "textcodec.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNIWINC_TEXT_SSE2
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define UNIWINC_TEXT_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define UNIWINC_TEXT_NEON
+#include <arm_neon.h>
+#endif
+
+
+static const UINT32 REPLACEMENT_CHARACTER = 0xFFFD;
+
+/// <summary>
+/// Read a character at i and move i after it
+/// </summary>
+static inline UINT32 readUtf16(const WCHAR* src, const size_t length, size_t& i) {
+	UINT32 c = (UINT32)src[i++];
+	if (c >= 0xD800 && c < 0xE000) {
+		// サロゲートペアでなければ置き換え文字にする
+		if (c < 0xDC00 && i < length && src[i] >= 0xDC00 && src[i] < 0xE000) {
+			c = 0x10000 + ((c - 0xD800) << 10) + ((UINT32)src[i] - 0xDC00);
+			i++;
+		}
+		else {
+			c = REPLACEMENT_CHARACTER;
+		}
+	}
+	return c;
+}
+
+/// <summary>
+/// Read a character at i and move i after it
+/// </summary>
+static inline UINT32 readUtf8(const char* src, const size_t length, size_t& i) {
+	UINT32 c = (BYTE)src[i++];
+	if (c < 0x80) return c;
+
+	// 先頭バイトから続くバイト数と最小値を決める。不正なら置き換え文字
+	INT32 extra;
+	UINT32 minimum;
+	if (c >= 0xC2 && c < 0xE0) { c &= 0x1F; extra = 1; minimum = 0x80; }
+	else if (c >= 0xE0 && c < 0xF0) { c &= 0x0F; extra = 2; minimum = 0x800; }
+	else if (c >= 0xF0 && c < 0xF5) { c &= 0x07; extra = 3; minimum = 0x10000; }
+	else return REPLACEMENT_CHARACTER;
+
+	INT32 k = 0;
+	for (; k < extra && i < length && ((BYTE)src[i] & 0xC0) == 0x80; k++, i++) {
+		c = (c << 6) | ((BYTE)src[i] & 0x3F);
+	}
+	if (k < extra || c < minimum || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) {
+		return REPLACEMENT_CHARACTER;
+	}
+	return c;
+}
+
+static inline size_t getUtf8Bytes(const UINT32 c) {
+	return (c < 0x80 ? 1 : (c < 0x800 ? 2 : (c < 0x10000 ? 3 : 4)));
+}
+
+/// <summary>
+/// Write a character
+/// </summary>
+/// <returns>Bytes written</returns>
+static inline size_t writeUtf8(const UINT32 c, char* dst) {
+	if (c < 0x80) {
+		dst[0] = (char)c;
+		return 1;
+	}
+	if (c < 0x800) {
+		dst[0] = (char)(0xC0 | (c >> 6));
+		dst[1] = (char)(0x80 | (c & 0x3F));
+		return 2;
+	}
+	if (c < 0x10000) {
+		dst[0] = (char)(0xE0 | (c >> 12));
+		dst[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		dst[2] = (char)(0x80 | (c & 0x3F));
+		return 3;
+	}
+	dst[0] = (char)(0xF0 | (c >> 18));
+	dst[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+	dst[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+	dst[3] = (char)(0x80 | (c & 0x3F));
+	return 4;
+}
+
+/// <summary>
+/// Write a character
+/// </summary>
+/// <returns>WCHARs written</returns>
+static inline size_t writeUtf16(UINT32 c, WCHAR* dst) {
+	if (c < 0x10000) {
+		dst[0] = (WCHAR)c;
+		return 1;
+	}
+	c -= 0x10000;
+	dst[0] = (WCHAR)(0xD800 + (c >> 10));
+	dst[1] = (WCHAR)(0xDC00 + (c & 0x3FF));
+	return 2;
+}
+
+#if defined(UNIWINC_TEXT_SSE2)
+static inline UINT32 countBits(UINT32 x) {
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+#elif defined(UNIWINC_TEXT_NEON)
+static const UINT64 ALL_LANES = 0xFFFFFFFFFFFFFFFFULL;
+
+/// <summary>
+/// Comparison result of 8 lanes as 8 bytes. ALL_LANES if true in all lanes, 0 if in none
+/// </summary>
+static inline UINT64 getLaneMask(const uint16x8_t mask) {
+	return (UINT64)vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(mask)), 0);
+}
+
+static inline UINT64 getLaneMask(const uint8x8_t mask) {
+	return (UINT64)vget_lane_u64(vreinterpret_u64_u8(mask), 0);
+}
+
+static inline BOOL isAscii(const uint8x16_t bytes) {
+	const uint64x2_t q = vreinterpretq_u64_u8(bytes);
+	return (((vgetq_lane_u64(q, 0) | vgetq_lane_u64(q, 1)) & 0x8080808080808080ULL) == 0);
+}
+#endif
+
+
+size_t getUtf8Length(const WCHAR* src, const size_t length) {
+	if (src == NULL) return 0;
+
+	size_t i = 0;
+	size_t n = 0;
+
+#if defined(UNIWINC_TEXT_SSE2)
+	// 各文字 3 バイトから、U+0800 未満と U+0080 未満の文字数を引く。サロゲートを含むときは 1 文字ずつ数える
+	const __m128i notAscii = _mm_set1_epi16((short)0xFF80);
+	const __m128i notTwoBytes = _mm_set1_epi16((short)0xF800);
+	const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+	const __m128i zero = _mm_setzero_si128();
+#if defined(UNIWINC_TEXT_AVX2)
+	const __m256i notAscii16 = _mm256_set1_epi16((short)0xFF80);
+	const __m256i notTwoBytes16 = _mm256_set1_epi16((short)0xF800);
+	const __m256i surrogate16 = _mm256_set1_epi16((short)0xD800);
+	const __m256i zero16 = _mm256_setzero_si256();
+	for (; i + 16 <= length; i += 16) {
+		const __m256i c = _mm256_loadu_si256((const __m256i*)(src + i));
+		const __m256i upper = _mm256_and_si256(c, notTwoBytes16);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(upper, surrogate16)) != 0) break;
+		const UINT32 oneByte = (UINT32)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(c, notAscii16), zero16));
+		const UINT32 upToTwoBytes = (UINT32)_mm256_movemask_epi8(_mm256_cmpeq_epi16(upper, zero16));
+		n += 48 - (countBits(oneByte) + countBits(upToTwoBytes)) / 2;
+	}
+#endif
+	while (i + 8 <= length) {
+		const __m128i c = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i upper = _mm_and_si128(c, notTwoBytes);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(upper, surrogate)) == 0) {
+			const UINT32 oneByte = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(c, notAscii), zero));
+			const UINT32 upToTwoBytes = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi16(upper, zero));
+			n += 24 - (countBits(oneByte) + countBits(upToTwoBytes)) / 2;
+			i += 8;
+			continue;
+		}
+
+		// サロゲートペアはこの 8 文字の後まで続くことがある
+		const size_t end = i + 8;
+		while (i < end) {
+			n += getUtf8Bytes(readUtf16(src, length, i));
+		}
+	}
+#elif defined(UNIWINC_TEXT_NEON)
+	const uint16x8_t ascii = vdupq_n_u16(0x80);
+	const uint16x8_t twoBytes = vdupq_n_u16(0x800);
+	const uint16x8_t notTwoBytes = vdupq_n_u16(0xF800);
+	const uint16x8_t surrogate = vdupq_n_u16(0xD800);
+	while (i + 8 <= length) {
+		const uint16x8_t c = vld1q_u16((const uint16_t*)(src + i));
+		if (getLaneMask(vceqq_u16(vandq_u16(c, notTwoBytes), surrogate)) == 0) {
+			// 1 + (U+0080 以上) + (U+0800 以上)
+			const uint16x8_t extra = vaddq_u16(vshrq_n_u16(vcgeq_u16(c, ascii), 15), vshrq_n_u16(vcgeq_u16(c, twoBytes), 15));
+			const uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(extra));
+			n += 8 + (size_t)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+			i += 8;
+			continue;
+		}
+
+		const size_t end = i + 8;
+		while (i < end) {
+			n += getUtf8Bytes(readUtf16(src, length, i));
+		}
+	}
+#endif
+
+	// Remaining characters
+	while (i < length) {
+		n += getUtf8Bytes(readUtf16(src, length, i));
+	}
+	return n;
+}
+
+size_t convertToUtf8(const WCHAR* src, const size_t length, char* dst) {
+	if (src == NULL || dst == NULL) return 0;
+
+	size_t i = 0;
+	char* p = dst;
+
+#if defined(UNIWINC_TEXT_SSE2)
+	// 8 文字がすべて ASCII、すべて 2 バイト、すべて 3 バイトのいずれかなら、まとめて変換する
+	const __m128i notAscii = _mm_set1_epi16((short)0xFF80);
+	const __m128i notTwoBytes = _mm_set1_epi16((short)0xF800);
+	const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+	const __m128i sixBits = _mm_set1_epi16(0x3F);
+	const __m128i continuation = _mm_set1_epi16(0x80);
+	const __m128i zero = _mm_setzero_si128();
+	while (i + 8 <= length) {
+#if defined(UNIWINC_TEXT_AVX2)
+		if (i + 16 <= length) {
+			const __m256i c16 = _mm256_loadu_si256((const __m256i*)(src + i));
+			if (_mm256_testz_si256(c16, _mm256_set1_epi16((short)0xFF80))) {
+				// パックは 128 ビットごとに行われるので、64 ビット単位で並べ直す
+				const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(c16, c16), 0xD8);
+				_mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(packed));
+				i += 16;
+				p += 16;
+				continue;
+			}
+		}
+#endif
+		const __m128i c = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i upper = _mm_and_si128(c, notTwoBytes);
+		const int oneByte = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(c, notAscii), zero));
+		if (oneByte == 0xFFFF) {
+			_mm_storel_epi64((__m128i*)p, _mm_packus_epi16(c, c));
+			i += 8;
+			p += 8;
+			continue;
+		}
+
+		const int upToTwoBytes = _mm_movemask_epi8(_mm_cmpeq_epi16(upper, zero));
+		if (oneByte == 0 && upToTwoBytes == 0xFFFF) {
+			// 110xxxxx 10xxxxxx. 1 文字分の 16 ビットに、先頭バイトを下位にして入れる
+			const __m128i lead = _mm_or_si128(_mm_srli_epi16(c, 6), _mm_set1_epi16(0xC0));
+			const __m128i trail = _mm_or_si128(_mm_and_si128(c, sixBits), continuation);
+			_mm_storeu_si128((__m128i*)p, _mm_or_si128(lead, _mm_slli_epi16(trail, 8)));
+			i += 8;
+			p += 16;
+			continue;
+		}
+
+		if (upToTwoBytes == 0 && _mm_movemask_epi8(_mm_cmpeq_epi16(upper, surrogate)) == 0) {
+			// 1110xxxx 10xxxxxx 10xxxxxx. SSE2 ではバイトを並べ替えられないので、先頭 2 バイトと最後のバイトを交互に書く
+			const __m128i lead = _mm_or_si128(_mm_srli_epi16(c, 12), _mm_set1_epi16(0xE0));
+			const __m128i middle = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(c, 6), sixBits), continuation);
+			const __m128i last = _mm_or_si128(_mm_and_si128(c, sixBits), continuation);
+			WORD heads[8];
+			WORD tails[8];
+			_mm_storeu_si128((__m128i*)heads, _mm_or_si128(lead, _mm_slli_epi16(middle, 8)));
+			_mm_storeu_si128((__m128i*)tails, last);
+			for (int k = 0; k < 8; k++) {
+				memcpy(p + k * 3, &heads[k], 2);
+				p[k * 3 + 2] = (char)tails[k];
+			}
+			i += 8;
+			p += 24;
+			continue;
+		}
+
+		// 混在していれば、最後の文字と種類の違う文字までを 1 文字ずつ変換して、次は同じ種類の並びから始める
+		//   サロゲートペアはこの 8 文字の後まで続くことがある
+		const int surrogates = _mm_movemask_epi8(_mm_cmpeq_epi16(upper, surrogate));
+		const int different = (oneByte ^ ((oneByte & 0x4000) ? 0xFFFF : 0)) | (upToTwoBytes ^ ((upToTwoBytes & 0x4000) ? 0xFFFF : 0)) | surrogates;
+		int count = 8;
+		while (count > 1 && (different & (1 << ((count - 1) * 2))) == 0) count--;
+		const size_t end = i + count;
+		while (i < end) {
+			p += writeUtf8(readUtf16(src, length, i), p);
+		}
+	}
+#elif defined(UNIWINC_TEXT_NEON)
+	const uint16x8_t notAscii = vdupq_n_u16(0xFF80);
+	const uint16x8_t notTwoBytes = vdupq_n_u16(0xF800);
+	const uint16x8_t surrogate = vdupq_n_u16(0xD800);
+	const uint16x8_t sixBits = vdupq_n_u16(0x3F);
+	const uint16x8_t continuation = vdupq_n_u16(0x80);
+	const uint16x8_t zero = vdupq_n_u16(0);
+	while (i + 8 <= length) {
+		const uint16x8_t c = vld1q_u16((const uint16_t*)(src + i));
+		const uint16x8_t upper = vandq_u16(c, notTwoBytes);
+		const UINT64 oneByte = getLaneMask(vceqq_u16(vandq_u16(c, notAscii), zero));
+		if (oneByte == ALL_LANES) {
+			vst1_u8((uint8_t*)p, vmovn_u16(c));
+			i += 8;
+			p += 8;
+			continue;
+		}
+
+		const UINT64 upToTwoBytes = getLaneMask(vceqq_u16(upper, zero));
+		if (oneByte == 0 && upToTwoBytes == ALL_LANES) {
+			uint8x8x2_t bytes;
+			bytes.val[0] = vmovn_u16(vorrq_u16(vshrq_n_u16(c, 6), vdupq_n_u16(0xC0)));
+			bytes.val[1] = vmovn_u16(vorrq_u16(vandq_u16(c, sixBits), continuation));
+			vst2_u8((uint8_t*)p, bytes);
+			i += 8;
+			p += 16;
+			continue;
+		}
+
+		if (upToTwoBytes == 0 && getLaneMask(vceqq_u16(upper, surrogate)) == 0) {
+			uint8x8x3_t bytes;
+			bytes.val[0] = vmovn_u16(vorrq_u16(vshrq_n_u16(c, 12), vdupq_n_u16(0xE0)));
+			bytes.val[1] = vmovn_u16(vorrq_u16(vandq_u16(vshrq_n_u16(c, 6), sixBits), continuation));
+			bytes.val[2] = vmovn_u16(vorrq_u16(vandq_u16(c, sixBits), continuation));
+			vst3_u8((uint8_t*)p, bytes);
+			i += 8;
+			p += 24;
+			continue;
+		}
+
+		const size_t end = i + 8;
+		while (i < end) {
+			p += writeUtf8(readUtf16(src, length, i), p);
+		}
+	}
+#endif
+
+	// Remaining characters
+	while (i < length) {
+		p += writeUtf8(readUtf16(src, length, i), p);
+	}
+	return (size_t)(p - dst);
+}
+
+size_t getUtf16Length(const char* src, const size_t length) {
+	if (src == NULL) return 0;
+
+	size_t i = 0;
+	size_t n = 0;
+
+#if defined(UNIWINC_TEXT_SSE2) || defined(UNIWINC_TEXT_NEON)
+	// ASCII の 16 バイトは 16 文字
+	while (i + 16 <= length) {
+#if defined(UNIWINC_TEXT_SSE2)
+		const BOOL bAscii = (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + i))) == 0);
+#else
+		const BOOL bAscii = isAscii(vld1q_u8((const uint8_t*)(src + i)));
+#endif
+		if (bAscii) {
+			i += 16;
+			n += 16;
+			continue;
+		}
+
+		const size_t end = i + 16;
+		while (i < end) {
+			n += (readUtf8(src, length, i) < 0x10000 ? 1 : 2);
+		}
+	}
+#endif
+
+	// Remaining bytes
+	while (i < length) {
+		n += (readUtf8(src, length, i) < 0x10000 ? 1 : 2);
+	}
+	return n;
+}
+
+size_t convertToUtf16(const char* src, const size_t length, WCHAR* dst) {
+	if (src == NULL || dst == NULL) return 0;
+
+	size_t i = 0;
+	WCHAR* p = dst;
+
+#if defined(UNIWINC_TEXT_SSE2)
+	// 16 バイトがすべて ASCII か、2 バイト文字 8 つならまとめて変換する
+	const __m128i leadAndTrail = _mm_set1_epi16((short)0xC0E0);
+	const __m128i twoBytes = _mm_set1_epi16((short)0x80C0);
+	const __m128i overlong = _mm_set1_epi16(0x1E);
+	const __m128i zero = _mm_setzero_si128();
+	while (i + 16 <= length) {
+#if defined(UNIWINC_TEXT_AVX2)
+		if (i + 32 <= length) {
+			const __m256i b32 = _mm256_loadu_si256((const __m256i*)(src + i));
+			if (_mm256_movemask_epi8(b32) == 0) {
+				_mm256_storeu_si256((__m256i*)p, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(b32)));
+				_mm256_storeu_si256((__m256i*)(p + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(b32, 1)));
+				i += 32;
+				p += 32;
+				continue;
+			}
+		}
+#endif
+		const __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+		if (_mm_movemask_epi8(b) == 0) {
+			_mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi8(b, zero));
+			_mm_storeu_si128((__m128i*)(p + 8), _mm_unpackhi_epi8(b, zero));
+			i += 16;
+			p += 16;
+			continue;
+		}
+
+		// 110xxxxx 10xxxxxx を 16 ビットずつ。C0, C1 で始まるものは冗長なので除く
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, leadAndTrail), twoBytes)) == 0xFFFF
+			&& _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, overlong), zero)) == 0) {
+			const __m128i high = _mm_slli_epi16(_mm_and_si128(b, _mm_set1_epi16(0x1F)), 6);
+			const __m128i low = _mm_and_si128(_mm_srli_epi16(b, 8), _mm_set1_epi16(0x3F));
+			_mm_storeu_si128((__m128i*)p, _mm_or_si128(high, low));
+			i += 16;
+			p += 8;
+			continue;
+		}
+
+		// 1 文字ずつ。文字はこの 16 バイトの後まで続くことがある
+		//   3 バイト文字 (CJK 等) は 4 バイトを一度に読んで調べる
+		const size_t end = i + 16;
+		while (i < end) {
+			if (i + 4 <= length) {
+				UINT32 bytes;
+				memcpy(&bytes, src + i, 4);
+				if ((bytes & 0xC0C0F0) == 0x8080E0) {
+					const UINT32 c = ((bytes & 0x0F) << 12) | ((bytes & 0x3F00) >> 2) | ((bytes >> 16) & 0x3F);
+					if (c >= 0x800 && (c & 0xF800) != 0xD800) {
+						*p++ = (WCHAR)c;
+						i += 3;
+						continue;
+					}
+				}
+			}
+			p += writeUtf16(readUtf8(src, length, i), p);
+		}
+	}
+#elif defined(UNIWINC_TEXT_NEON)
+	const uint8x8_t sixBits = vdup_n_u8(0x3F);
+	const uint8x8_t trailMask = vdup_n_u8(0xC0);
+	const uint8x8_t trail = vdup_n_u8(0x80);
+	while (i + 16 <= length) {
+		const uint8x16_t b = vld1q_u8((const uint8_t*)(src + i));
+		if (isAscii(b)) {
+			vst1q_u16((uint16_t*)p, vmovl_u8(vget_low_u8(b)));
+			vst1q_u16((uint16_t*)(p + 8), vmovl_u8(vget_high_u8(b)));
+			i += 16;
+			p += 16;
+			continue;
+		}
+
+		// 2 バイト文字 8 つ
+		const uint8x8x2_t pairs = vld2_u8((const uint8_t*)(src + i));
+		const uint8x8_t pairLead = vceq_u8(vand_u8(pairs.val[0], vdup_n_u8(0xE0)), vdup_n_u8(0xC0));
+		const uint8x8_t pairTrail = vceq_u8(vand_u8(pairs.val[1], trailMask), trail);
+		if (getLaneMask(vand_u8(pairLead, pairTrail)) == ALL_LANES
+			&& getLaneMask(vceq_u8(vand_u8(pairs.val[0], vdup_n_u8(0x1E)), vdup_n_u8(0))) == 0) {
+			const uint16x8_t high = vshlq_n_u16(vmovl_u8(vand_u8(pairs.val[0], vdup_n_u8(0x1F))), 6);
+			vst1q_u16((uint16_t*)p, vorrq_u16(high, vmovl_u8(vand_u8(pairs.val[1], sixBits))));
+			i += 16;
+			p += 8;
+			continue;
+		}
+
+		// 3 バイト文字 8 つ。冗長なものとサロゲートは除く
+		if (i + 24 <= length) {
+			const uint8x8x3_t triples = vld3_u8((const uint8_t*)(src + i));
+			const uint8x8_t lead = vceq_u8(vand_u8(triples.val[0], vdup_n_u8(0xF0)), vdup_n_u8(0xE0));
+			const uint8x8_t middle = vceq_u8(vand_u8(triples.val[1], trailMask), trail);
+			const uint8x8_t last = vceq_u8(vand_u8(triples.val[2], trailMask), trail);
+			if (getLaneMask(vand_u8(vand_u8(lead, middle), last)) == ALL_LANES) {
+				const uint16x8_t c = vorrq_u16(
+					vorrq_u16(vshlq_n_u16(vmovl_u8(vand_u8(triples.val[0], vdup_n_u8(0x0F))), 12), vshlq_n_u16(vmovl_u8(vand_u8(triples.val[1], sixBits)), 6)),
+					vmovl_u8(vand_u8(triples.val[2], sixBits)));
+				if (getLaneMask(vcgeq_u16(c, vdupq_n_u16(0x800))) == ALL_LANES
+					&& getLaneMask(vceqq_u16(vandq_u16(c, vdupq_n_u16(0xF800)), vdupq_n_u16(0xD800))) == 0) {
+					vst1q_u16((uint16_t*)p, c);
+					i += 24;
+					p += 8;
+					continue;
+				}
+			}
+		}
+
+		const size_t end = i + 16;
+		while (i < end) {
+			p += writeUtf16(readUtf8(src, length, i), p);
+		}
+	}
+#endif
+
+	// Remaining bytes
+	while (i < length) {
+		p += writeUtf16(readUtf8(src, length, i), p);
+	}
+	return (size_t)(p - dst);
+}
+
+void appendUtf8(const WCHAR* src, const size_t length, std::string& dst) {
+	if (src == NULL) return;
+
+	const size_t offset = dst.size();
+	dst.resize(offset + getUtf8Length(src, length));
+	convertToUtf8(src, length, &dst[0] + offset);
+}
+
+void appendUtf16(const char* src, const size_t length, std::vector<WCHAR>& dst) {
+	if (src == NULL) return;
+
+	// 1 バイトから 2 文字以上になることはないので、バイト数だけ確保して縮める
+	const size_t offset = dst.size();
+	dst.resize(offset + length);
+	dst.resize(offset + convertToUtf16(src, length, dst.data() + offset));
+}
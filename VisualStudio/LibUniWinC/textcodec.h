@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Conversion between UTF-16 (WCHAR) and UTF-8 for the paths passed to the platform APIs other than Win32,
+///   and for the UTF-8 variants of the exported functions.
+///   Unpaired surrogates and invalid bytes become U+FFFD.
+///   Runs of ASCII, of 2-byte and of 3-byte characters (e.g. CJK) are converted 8 or more characters at once.
+/// </summary>
+
+/// <summary>
+/// Bytes of the UTF-8 of length WCHARs
+/// </summary>
+size_t getUtf8Length(const WCHAR* src, const size_t length);
+
+/// <summary>
+/// Write the UTF-8 of length WCHARs without a terminator
+/// </summary>
+/// <param name="dst">Must have getUtf8Length() bytes</param>
+/// <returns>Bytes written</returns>
+size_t convertToUtf8(const WCHAR* src, const size_t length, char* dst);
+
+/// <summary>
+/// WCHARs of the UTF-16 of length bytes. Never more than length
+/// </summary>
+size_t getUtf16Length(const char* src, const size_t length);
+
+/// <summary>
+/// Write the UTF-16 of length bytes without a terminator
+/// </summary>
+/// <param name="dst">Must have getUtf16Length() WCHARs, or length WCHARs</param>
+/// <returns>WCHARs written</returns>
+size_t convertToUtf16(const char* src, const size_t length, WCHAR* dst);
+
+/// <summary>
+/// Append the UTF-8 of length WCHARs
+/// </summary>
+void appendUtf8(const WCHAR* src, const size_t length, std::string& dst);
+
+/// <summary>
+/// Append the UTF-16 of length bytes
+/// </summary>
+void appendUtf16(const char* src, const size_t length, std::vector<WCHAR>& dst);
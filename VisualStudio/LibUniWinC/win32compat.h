@@ -0,0 +1,252 @@
+﻿#pragma once
+
+// Minimal subset of the Win32 types, structures and constants used in this library.
+//   This is included instead of windows.h on other platforms, so that libuniwinc.cpp can be built
+//   with a non-Win32 backend (see backend.h). Values are the same as the Windows SDK.
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#define WINAPI
+#define CALLBACK
+#define APIENTRY
+
+typedef int BOOL;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef int64_t INT64;
+typedef uint64_t UINT64;
+typedef int32_t LONG;
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t BYTE;
+typedef intptr_t LONG_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef intptr_t LRESULT;
+typedef void* LPVOID;
+typedef DWORD COLORREF;
+
+// UTF-16 as in Windows (wchar_t is 32-bit on most other platforms)
+typedef char16_t WCHAR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define DECLARE_HANDLE(name) struct name##__ { int unused; }; typedef struct name##__ *name
+DECLARE_HANDLE(HWND);
+DECLARE_HANDLE(HMONITOR);
+DECLARE_HANDLE(HDC);
+DECLARE_HANDLE(HMENU);
+DECLARE_HANDLE(HDROP);
+
+typedef struct tagPOINT {
+	LONG x;
+	LONG y;
+} POINT, *LPPOINT;
+
+typedef struct tagSIZE {
+	LONG cx;
+	LONG cy;
+} SIZE, *LPSIZE;
+
+typedef struct tagRECT {
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+} RECT, *LPRECT;
+
+typedef struct tagWINDOWPLACEMENT {
+	UINT length;
+	UINT flags;
+	UINT showCmd;
+	POINT ptMinPosition;
+	POINT ptMaxPosition;
+	RECT rcNormalPosition;
+} WINDOWPLACEMENT;
+
+typedef struct tagWINDOWINFO {
+	DWORD cbSize;
+	RECT rcWindow;
+	RECT rcClient;
+	DWORD dwStyle;
+	DWORD dwExStyle;
+	DWORD dwWindowStatus;
+	UINT cxWindowBorders;
+	UINT cyWindowBorders;
+	WORD atomWindowType;
+	WORD wCreatorVersion;
+} WINDOWINFO;
+
+typedef struct tagWINDOWPOS {
+	HWND hwnd;
+	HWND hwndInsertAfter;
+	int x;
+	int y;
+	int cx;
+	int cy;
+	UINT flags;
+} WINDOWPOS;
+
+// Only the members used in this library
+typedef struct tagOFNW {
+	DWORD lStructSize;
+	HWND hwndOwner;
+	LPCWSTR lpstrFilter;
+	LPWSTR lpstrFile;
+	DWORD nMaxFile;
+	LPCWSTR lpstrInitialDir;
+	LPCWSTR lpstrTitle;
+	DWORD Flags;
+	WORD nFileOffset;
+	WORD nFileExtension;
+	LPCWSTR lpstrDefExt;
+} OPENFILENAMEW;
+
+typedef LRESULT (CALLBACK* WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+typedef BOOL (CALLBACK* WNDENUMPROC)(HWND, LPARAM);
+typedef BOOL (CALLBACK* MONITORENUMPROC)(HMONITOR, HDC, LPRECT, LPARAM);
+
+#define ZeroMemory(dest, length) memset((dest), 0, (length))
+#define TEXT(quote) u##quote		// WCHAR string literal, L"..." on Windows
+
+#define LOWORD(l) ((WORD)(((UINT_PTR)(l)) & 0xffff))
+#define HIWORD(l) ((WORD)((((UINT_PTR)(l)) >> 16) & 0xffff))
+#define MAKELPARAM(l, h) ((LPARAM)(DWORD)(((WORD)(l)) | (((DWORD)((WORD)(h))) << 16)))
+#define GET_X_LPARAM(lp) ((int)(short)LOWORD(lp))
+#define GET_Y_LPARAM(lp) ((int)(short)HIWORD(lp))
+
+// Window styles
+#define WS_OVERLAPPED		0x00000000L
+#define WS_POPUP			0x80000000u
+#define WS_CHILD			0x40000000L
+#define WS_MINIMIZE			0x20000000L
+#define WS_VISIBLE			0x10000000L
+#define WS_MAXIMIZE			0x01000000L
+#define WS_CAPTION			0x00C00000L
+#define WS_BORDER			0x00800000L
+#define WS_DLGFRAME			0x00400000L
+#define WS_SYSMENU			0x00080000L
+#define WS_THICKFRAME		0x00040000L
+#define WS_MINIMIZEBOX		0x00020000L
+#define WS_MAXIMIZEBOX		0x00010000L
+#define WS_OVERLAPPEDWINDOW	(WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_MINIMIZEBOX | WS_MAXIMIZEBOX)
+
+// Extended window styles
+#define WS_EX_TOPMOST		0x00000008L
+#define WS_EX_ACCEPTFILES	0x00000010L
+#define WS_EX_TRANSPARENT	0x00000020L
+#define WS_EX_TOOLWINDOW	0x00000080L
+#define WS_EX_LAYERED		0x00080000L
+
+// GetWindowLong / SetWindowLong
+#define GWL_STYLE			(-16)
+#define GWL_EXSTYLE			(-20)
+#define GWLP_WNDPROC		(-4)
+
+// GetWindow
+#define GW_OWNER			4
+
+// SetWindowPos
+#define SWP_NOSIZE			0x0001
+#define SWP_NOMOVE			0x0002
+#define SWP_NOZORDER		0x0004
+#define SWP_NOREDRAW		0x0008
+#define SWP_NOACTIVATE		0x0010
+#define SWP_FRAMECHANGED	0x0020
+#define SWP_SHOWWINDOW		0x0040
+#define SWP_HIDEWINDOW		0x0080
+#define SWP_NOOWNERZORDER	0x0200
+#define SWP_NOSENDCHANGING	0x0400
+#define SWP_ASYNCWINDOWPOS	0x4000
+
+#define HWND_TOP			((HWND)(intptr_t)0)
+#define HWND_BOTTOM			((HWND)(intptr_t)1)
+#define HWND_TOPMOST		((HWND)(intptr_t)-1)
+#define HWND_NOTOPMOST		((HWND)(intptr_t)-2)
+
+// ShowWindow
+#define SW_HIDE				0
+#define SW_NORMAL			1
+#define SW_SHOWNORMAL		1
+#define SW_MAXIMIZE			3
+#define SW_SHOW				5
+#define SW_MINIMIZE			6
+#define SW_RESTORE			9
+
+// SetLayeredWindowAttributes
+#define LWA_COLORKEY		0x00000001
+#define LWA_ALPHA			0x00000002
+
+// Window messages
+#define WM_DESTROY			0x0002
+#define WM_SIZE				0x0005
+#define WM_ACTIVATE			0x0006
+#define WM_WINDOWPOSCHANGING	0x0046
+#define WM_WINDOWPOSCHANGED	0x0047
+#define WM_STYLECHANGED		0x007D
+#define WM_DISPLAYCHANGE	0x007E
+#define WM_NCDESTROY		0x0082
+#define WM_NCHITTEST		0x0084
+#define WM_TIMER			0x0113
+#define WM_MOUSEMOVE		0x0200
+#define WM_LBUTTONDOWN		0x0201
+#define WM_LBUTTONUP		0x0202
+#define WM_DROPFILES		0x0233
+#define WM_APP				0x8000
+
+// Mouse messages
+#define MK_LBUTTON			0x0001
+
+// WM_SIZE
+#define SIZE_RESTORED		0
+#define SIZE_MINIMIZED		1
+#define SIZE_MAXIMIZED		2
+
+// WM_NCHITTEST
+#define HTTRANSPARENT		(-1)
+#define HTNOWHERE			0
+#define HTCLIENT			1
+#define HTCAPTION			2
+
+// OPENFILENAME flags
+#define OFN_OVERWRITEPROMPT	0x00000002
+#define OFN_NOCHANGEDIR		0x00000008
+#define OFN_ALLOWMULTISELECT	0x00000200
+#define OFN_PATHMUSTEXIST	0x00000800
+#define OFN_FILEMUSTEXIST	0x00001000
+#define OFN_CREATEPROMPT	0x00002000
+#define OFN_EXPLORER		0x00080000
+#define OFN_FORCESHOWHIDDEN	0x10000000
+
+// CommDlgExtendedError()
+#define FNERR_BUFFERTOOSMALL	0x3003
+
+/// <summary>
+/// wcscpy_s equivalent for UTF-16 strings
+/// </summary>
+inline int wcscpy_s(WCHAR* dest, const size_t destSize, const WCHAR* src) {
+	if (dest == nullptr || destSize == 0) return 22;	// EINVAL
+	if (src == nullptr) {
+		dest[0] = u'\0';
+		return 22;
+	}
+	size_t i = 0;
+	for (; i < destSize; i++) {
+		dest[i] = src[i];
+		if (src[i] == u'\0') return 0;
+	}
+	dest[0] = u'\0';
+	return 34;	// ERANGE
+}
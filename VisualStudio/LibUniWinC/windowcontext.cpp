@@ -0,0 +1,225 @@
+﻿// windowcontext.cpp : State of each attached window and the slabs keeping them
+
+#include "pch.h"
+#include "windowcontext.h"
+#include <algorithm>
+#include <functional>
+#include <new>
+
+
+WindowContext::WindowContext() :
+	hTargetWnd(NULL),
+	originalWindowInfo(),
+	originalWindowPlacement(),
+	hParentWnd(NULL),
+	bIsTransparent(FALSE),
+	bIsBorderless(FALSE),
+	byAlpha(0xFF),
+	bIsTopmost(FALSE),
+	bIsBottommost(FALSE),
+	bIsBackground(FALSE),
+	bIsClickThrough(FALSE),
+	bAllowDropFile(FALSE),
+	dwKeyColor(0x00000000),
+	nTransparentType(TransparentType::Alpha),
+	nCurrentTransparentType(TransparentType::Alpha),
+	lpMyWndProc(NULL),
+	lpOriginalWndProc(NULL),
+	hWindowStyleChangedHandler(nullptr),
+	hMonitorChangedHandler(nullptr),
+	hDropFilesHandler(nullptr),
+	hDropFilesUtf8Handler(nullptr),
+	eventQueue(UNIWINC_EVENT_QUEUE_SIZE),
+	bIsEventQueueEnabled(FALSE),
+	bIsHitTestMaskEnabled(FALSE),
+	bIsMaskClickThrough(FALSE),
+	bIsInputRegionEnabled(FALSE),
+	bIsInputRegionApplied(FALSE),
+	nInputRegionVersion(0),
+	szInputRegionClient(),
+	bIsDragEndOnRelease(FALSE),
+	nRefreshMode(RefreshMode::FrameChanged),
+	refreshStats(),
+	szLastClient(),
+	geometry(),
+	bIsDragMoving(FALSE)
+{
+	for (std::atomic<UINT32>& id : tweenIds) {
+		id.store(0, std::memory_order_relaxed);
+	}
+}
+
+
+WindowContextSlab::WindowContextSlab() : slabCount_(0), count_(0) {
+}
+
+WindowContextSlab::~WindowContextSlab() {
+	const UINT32 slabCount = slabCount_.load(std::memory_order_relaxed);
+	for (UINT32 i = 0; i < slabCount; i++) {
+		for (UINT32 j = 0; j < SLAB_SIZE; j++) {
+			Slot& slot = slabs_[i][j];
+			if (slot.handle.load(std::memory_order_relaxed) != 0) {
+				slot.getContext()->~WindowContext();
+			}
+		}
+	}
+}
+
+UINT32 WindowContextSlab::create() {
+	if (freeList_.empty()) {
+		const UINT32 slabCount = slabCount_.load(std::memory_order_relaxed);
+		if (slabCount >= MAX_SLABS) return 0;
+
+		// 空きが無ければスラブを追加する。既存のスラブは動かさない
+		std::unique_ptr<Slot[]> slab(new (std::nothrow) Slot[SLAB_SIZE]);
+		if (!slab) return 0;
+
+		const UINT32 first = slabCount * SLAB_SIZE;
+		try {
+			freeList_.reserve(freeList_.size() + SLAB_SIZE);
+		}
+		catch (...) {
+			return 0;
+		}
+
+		// 番号の小さい方から使うよう、逆順に積む
+		for (UINT32 j = SLAB_SIZE; j > 0; j--) {
+			Slot& slot = slab[j - 1];
+			slot.handle.store(0, std::memory_order_relaxed);
+			slot.generation = 1;
+			slot.hWnd = NULL;
+
+			const UINT32 index = first + j - 1;
+			if (index < MAX_COUNT) {
+				freeList_.push_back(index);
+			}
+		}
+
+		// 初期化を終えてから、他のスレッドの get() に見えるようにする
+		slabs_[slabCount] = std::move(slab);
+		slabCount_.store(slabCount + 1, std::memory_order_release);
+	}
+
+	const UINT32 index = freeList_.back();
+	Slot& slot = slabs_[index / SLAB_SIZE][index % SLAB_SIZE];
+	try {
+		new (&slot.storage) WindowContext();
+	}
+	catch (...) {
+		return 0;
+	}
+	freeList_.pop_back();
+	slot.hWnd = NULL;
+	count_++;
+
+	// コンテキストを構築してからハンドルを公開する
+	const UINT32 handle = makeHandle(index, slot.generation);
+	slot.handle.store(handle, std::memory_order_release);
+	return handle;
+}
+
+BOOL WindowContextSlab::destroy(const UINT32 handle) {
+	Slot* pSlot = getSlot(handle);
+	if (pSlot == nullptr) return FALSE;
+
+	bindWindow(handle, NULL);
+	pSlot->handle.store(0, std::memory_order_release);
+	pSlot->getContext()->~WindowContext();
+
+	// 以前のハンドルが使えなくなるよう世代を進める。0 は使わない
+	if (++pSlot->generation == 0) pSlot->generation = 1;
+
+	// reserve() 済みなので失敗しない
+	freeList_.push_back((handle & 0xFFFF) - 1);
+	count_--;
+	return TRUE;
+}
+
+WindowContext* WindowContextSlab::get(const UINT32 handle) const {
+	Slot* pSlot = getSlot(handle);
+	return (pSlot != nullptr ? pSlot->getContext() : nullptr);
+}
+
+UINT32 WindowContextSlab::getHandle(const WindowContext* pContext) const {
+	if (pContext == nullptr) return 0;
+
+	std::less<const Slot*> less;
+	const UINT32 slabCount = slabCount_.load(std::memory_order_acquire);
+	for (UINT32 i = 0; i < slabCount; i++) {
+		const Slot* pFirst = &slabs_[i][0];
+		const Slot* pSlot = reinterpret_cast<const Slot*>(pContext);
+		if (less(pSlot, pFirst) || !less(pSlot, pFirst + SLAB_SIZE)) continue;
+
+		// storage は Slot の先頭にあるので、コンテキストのアドレスは Slot のアドレスと一致する
+		const UINT32 j = (UINT32)(pSlot - pFirst);
+		if (slabs_[i][j].getContext() != pContext) return 0;
+		return slabs_[i][j].handle.load(std::memory_order_acquire);
+	}
+	return 0;
+}
+
+void WindowContextSlab::getHandles(std::vector<UINT32>& handles) const {
+	handles.clear();
+	const UINT32 slabCount = slabCount_.load(std::memory_order_acquire);
+	for (UINT32 i = 0; i < slabCount; i++) {
+		for (UINT32 j = 0; j < SLAB_SIZE; j++) {
+			const UINT32 handle = slabs_[i][j].handle.load(std::memory_order_acquire);
+			if (handle != 0) {
+				handles.push_back(handle);
+			}
+		}
+	}
+}
+
+BOOL WindowContextSlab::bindWindow(const UINT32 handle, const HWND hWnd) {
+	Slot* pSlot = getSlot(handle);
+	if (pSlot == nullptr) return FALSE;
+	if (pSlot->hWnd == hWnd) return TRUE;
+
+	auto less = [](const std::pair<HWND, UINT32>& item, const HWND h) { return std::less<HWND>()(item.first, h); };
+
+	// 他のコンテキストが使っているウィンドウは選べない
+	if (hWnd != NULL) {
+		auto it = std::lower_bound(windows_.begin(), windows_.end(), hWnd, less);
+		if (it != windows_.end() && it->first == hWnd) return FALSE;
+		try {
+			windows_.insert(it, std::make_pair(hWnd, handle));
+		}
+		catch (...) {
+			return FALSE;
+		}
+	}
+
+	if (pSlot->hWnd != NULL) {
+		auto previous = std::lower_bound(windows_.begin(), windows_.end(), pSlot->hWnd, less);
+		if (previous != windows_.end() && previous->first == pSlot->hWnd) {
+			windows_.erase(previous);
+		}
+	}
+	pSlot->hWnd = hWnd;
+	return TRUE;
+}
+
+WindowContext* WindowContextSlab::findByWindow(const HWND hWnd) const {
+	if (hWnd == NULL) return nullptr;
+
+	auto it = std::lower_bound(windows_.begin(), windows_.end(), hWnd,
+		[](const std::pair<HWND, UINT32>& item, const HWND h) { return std::less<HWND>()(item.first, h); });
+	if (it == windows_.end() || it->first != hWnd) return nullptr;
+	return get(it->second);
+}
+
+/// <summary>
+/// Slot of a context which exists, or nullptr
+/// </summary>
+WindowContextSlab::Slot* WindowContextSlab::getSlot(const UINT32 handle) const {
+	const UINT32 index = (handle & 0xFFFF);
+	if (index == 0) return nullptr;
+
+	const UINT32 i = (index - 1) / SLAB_SIZE;
+	if (i >= slabCount_.load(std::memory_order_acquire)) return nullptr;
+
+	Slot& slot = slabs_[i][(index - 1) % SLAB_SIZE];
+	if (slot.handle.load(std::memory_order_acquire) != handle) return nullptr;
+	return &slot;
+}
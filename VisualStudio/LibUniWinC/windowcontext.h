@@ -0,0 +1,164 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include "dragmove.h"
+#include "eventcoalescer.h"
+#include "eventqueue.h"
+#include "hittestmask.h"
+#include "seqlock.h"
+#include "windowtween.h"
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Window geometry published by the window thread for the getters called on other threads
+/// </summary>
+struct WindowGeometry {
+	HWND hWnd;				// NULL if no window is attached
+	RECT rect;
+	SIZE client;
+	BOOL bZoomed;
+	BOOL bIconic;
+};
+
+/// <summary>
+/// State of one attached window.
+///   The exported functions work on the current context (the default one unless a context function is called),
+///   so that several windows can be controlled at once, e.g. one Unity window for each display.
+///   The flags returned by the getters are atomic and the geometry is published by a seqlock,
+///   so that other threads can read them while the window thread changes them. The other members belong to the window thread.
+/// </summary>
+struct WindowContext {
+	WindowContext();
+
+	HWND hTargetWnd;
+	WINDOWINFO originalWindowInfo;
+	WINDOWPLACEMENT originalWindowPlacement;
+	HWND hParentWnd;
+	std::atomic<BOOL> bIsTransparent;
+	std::atomic<BOOL> bIsBorderless;
+	BYTE byAlpha;							// ウィンドウ全体の透明度 0x00:透明 ～ 0xFF:不透明
+	std::atomic<BOOL> bIsTopmost;
+	std::atomic<BOOL> bIsBottommost;
+	std::atomic<BOOL> bIsBackground;
+	std::atomic<BOOL> bIsClickThrough;
+	BOOL bAllowDropFile;
+	COLORREF dwKeyColor;					// AABBGGRR
+	TransparentType nTransparentType;
+	TransparentType nCurrentTransparentType;
+	WNDPROC lpMyWndProc;
+	WNDPROC lpOriginalWndProc;
+	WindowStyleChangedCallback hWindowStyleChangedHandler;
+	MonitorChangedCallback hMonitorChangedHandler;
+	FilesCallback hDropFilesHandler;
+	FilesCallbackUtf8 hDropFilesUtf8Handler;
+	EventQueue eventQueue;					// PollEvents() で取り出すイベント
+	EventCoalescer eventCoalescer;			// 連続するリサイズ等をまとめる
+	BOOL bIsEventQueueEnabled;
+	HitTestMask hitTestMask;				// 不透明部分のマスク。透明部分ではクリックスルーにする
+	std::atomic<BOOL> bIsHitTestMaskEnabled;
+	BOOL bIsMaskClickThrough;				// マスクによってクリックスルーにしているか
+	std::atomic<BOOL> bIsInputRegionEnabled;	// マスクからウィンドウの入力領域を設定するか
+	BOOL bIsInputRegionApplied;
+	UINT64 nInputRegionVersion;				// 入力領域に反映したマスクのバージョン
+	SIZE szInputRegionClient;				// 入力領域を作った際のクライアント領域サイズ
+	std::vector<RECT> inputRegionRects;
+	DragMover dragMover;					// BeginDragMove() で開始したウィンドウのドラッグ
+	BOOL bIsDragEndOnRelease;				// ボタンが離されたらドラッグを終える（開始時に押されていた場合）
+	WindowTweener windowTweener;			// StartWindowTween() で開始したアニメーション
+	std::atomic<RefreshMode> nRefreshMode;
+	REFRESHSTATS refreshStats;				// 枠の変更による再描画、リサイズの回数
+	SIZE szLastClient;						// 最後にWM_SIZEで通知されたクライアント領域サイズ
+	SeqLock<WindowGeometry> geometry;		// 他のスレッドから読むための位置、サイズ。ウィンドウスレッドが変わった時だけ更新する
+	std::atomic<BOOL> bIsDragMoving;		// dragMover の状態を他のスレッドから読むための写し
+	std::atomic<UINT32> tweenIds[3];		// 位置、サイズ、透明度を動かしているアニメーションのID。windowTweener を他のスレッドから読むための写し
+
+private:
+	WindowContext(const WindowContext&) = delete;
+	WindowContext& operator=(const WindowContext&) = delete;
+};
+
+/// <summary>
+/// Contexts kept in slabs of fixed size, referred to by handles.
+///   A slab is never moved nor freed until the destructor, so a pointer to a context stays valid while it exists,
+///   and destroyed slots are reused from a free list without allocating the slab again.
+///   A handle is the slot index plus 1 in the low 16 bits and the generation of the slot in the high 16 bits.
+///   The generation is incremented when the slot is freed, so a handle of a destroyed context is rejected even after the slot is reused.
+///   The windows are looked up by a sorted array of (HWND, handle), which the window procedure searches on each message.
+///   Only the window thread may create, destroy and bind. get() and getHandle() may be called on any thread:
+///   a slab is published after it is built, and each slot publishes the handle of its context atomically.
+///   Destroying a context while another thread uses it is not detected; the caller must stop the other threads first.
+/// </summary>
+class WindowContextSlab {
+public:
+	static const UINT32 SLAB_SIZE = 64;			// Contexts per slab
+	static const UINT32 MAX_COUNT = 0xFFFF;		// Slots which fit in the handle
+	static const UINT32 MAX_SLABS = (MAX_COUNT + SLAB_SIZE - 1) / SLAB_SIZE;
+
+	WindowContextSlab();
+	~WindowContextSlab();
+
+	/// <summary>
+	/// Construct a context in a free slot
+	/// </summary>
+	/// <returns>Handle of the context, or 0 if failed</returns>
+	UINT32 create();
+
+	/// <summary>
+	/// Destroy the context. Its window must have been detached
+	/// </summary>
+	/// <returns>FALSE if the handle is invalid</returns>
+	BOOL destroy(const UINT32 handle);
+
+	/// <summary>
+	/// The context of the handle
+	/// </summary>
+	/// <returns>nullptr if the handle is invalid or the context has been destroyed</returns>
+	WindowContext* get(const UINT32 handle) const;
+
+	/// <summary>
+	/// Handle of the context, or 0 if it is not in the slabs
+	/// </summary>
+	UINT32 getHandle(const WindowContext* pContext) const;
+
+	UINT32 getCount() const { return count_; }
+
+	/// <summary>
+	/// Handles of all the contexts, in the order of the slots
+	/// </summary>
+	void getHandles(std::vector<UINT32>& handles) const;
+
+	/// <summary>
+	/// Associate the window with the context, replacing the previous window of the context
+	/// </summary>
+	/// <param name="hWnd">NULL only removes the previous window</param>
+	/// <returns>FALSE if the window belongs to another context, or failed to allocate</returns>
+	BOOL bindWindow(const UINT32 handle, const HWND hWnd);
+
+	/// <summary>
+	/// The context which the window belongs to, or nullptr
+	/// </summary>
+	WindowContext* findByWindow(const HWND hWnd) const;
+
+private:
+	struct Slot {
+		std::aligned_storage<sizeof(WindowContext), alignof(WindowContext)>::type storage;
+		std::atomic<UINT32> handle;		// Handle of the context, or 0 if the slot is free
+		WORD generation;		// Never 0, so that no handle is 0
+		HWND hWnd;				// Window bound to the context
+
+		WindowContext* getContext() { return reinterpret_cast<WindowContext*>(&storage); }
+	};
+
+	std::unique_ptr<Slot[]> slabs_[MAX_SLABS];
+	std::atomic<UINT32> slabCount_;					// Slabs built. slabs_ below this are never changed
+	std::vector<UINT32> freeList_;					// Indices of the free slots, the last one is reused first
+	std::vector<std::pair<HWND, UINT32>> windows_;	// (HWND, handle) sorted by HWND
+	UINT32 count_;
+
+	Slot* getSlot(const UINT32 handle) const;
+	static UINT32 makeHandle(const UINT32 index, const WORD generation) { return ((UINT32)generation << 16) | (index + 1); }
+};
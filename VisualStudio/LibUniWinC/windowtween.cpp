@@ -0,0 +1,160 @@
+﻿// windowtween.cpp : Scheduler of the window tweens
+
+#include "pch.h"
+#include "windowtween.h"
+
+
+WindowTweener::WindowTweener() : nextId_(1) {
+}
+
+UINT32 WindowTweener::start(const INT64 now, const DWORD flags, const TweenValues& from, const TweenValues& to, const INT64 duration, const EasingType easing, std::vector<UINT32>& cancelled) {
+	const DWORD properties = flags & ((DWORD)WindowTweenFlag::Position | (DWORD)WindowTweenFlag::Size | (DWORD)WindowTweenFlag::Alpha);
+	if (properties == 0) return 0;
+
+	// 同じプロパティを動かしている古いトゥイーンからは取り上げる
+	take(properties, cancelled);
+	if (tweens_.size() >= UNIWINC_TWEEN_MAX_COUNT) return 0;
+
+	// 0 は失敗を表すので使わない
+	if (nextId_ == 0) nextId_++;
+
+	Tween tween;
+	tween.id = nextId_++;
+	tween.flags = properties;
+	tween.from = from;
+	tween.to = to;
+	tween.start = now;
+	tween.duration = (duration > 0 ? duration : 0);
+	tween.easing = easing;
+	tween.bFinishing = FALSE;
+	tweens_.push_back(tween);
+	return tween.id;
+}
+
+DWORD WindowTweener::step(const INT64 now, TweenValues& values, std::vector<UINT32>& completed) {
+	DWORD written = 0;
+
+	for (size_t i = 0; i < tweens_.size(); ) {
+		const Tween& tween = tweens_[i];
+
+		double t = 1.0;
+		if (!tween.bFinishing && tween.duration > 0) {
+			t = (double)(now - tween.start) / (double)tween.duration;
+			if (t < 0.0) t = 0.0;
+			if (t > 1.0) t = 1.0;
+		}
+
+		// 終点では誤差なく目標値とする
+		const double e = (t < 1.0 ? ease(tween.easing, t) : 1.0);
+		const TweenValues& a = tween.from;
+		const TweenValues& b = tween.to;
+		if (tween.flags & (DWORD)WindowTweenFlag::Position) {
+			values.left = (t < 1.0 ? a.left + (b.left - a.left) * e : b.left);
+			values.bottom = (t < 1.0 ? a.bottom + (b.bottom - a.bottom) * e : b.bottom);
+		}
+		if (tween.flags & (DWORD)WindowTweenFlag::Size) {
+			values.width = (t < 1.0 ? a.width + (b.width - a.width) * e : b.width);
+			values.height = (t < 1.0 ? a.height + (b.height - a.height) * e : b.height);
+		}
+		if (tween.flags & (DWORD)WindowTweenFlag::Alpha) {
+			values.alpha = (t < 1.0 ? a.alpha + (b.alpha - a.alpha) * e : b.alpha);
+		}
+		written |= tween.flags;
+
+		if (t >= 1.0) {
+			completed.push_back(tween.id);
+			tweens_.erase(tweens_.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+	return written;
+}
+
+BOOL WindowTweener::stop(const UINT32 id, const BOOL bComplete) {
+	for (size_t i = 0; i < tweens_.size(); i++) {
+		if (tweens_[i].id != id) continue;
+
+		if (bComplete) {
+			tweens_[i].bFinishing = TRUE;
+		}
+		else {
+			tweens_.erase(tweens_.begin() + i);
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+void WindowTweener::take(const DWORD flags, std::vector<UINT32>& cancelled) {
+	for (size_t i = 0; i < tweens_.size(); ) {
+		tweens_[i].flags &= ~flags;
+		if (tweens_[i].flags == 0) {
+			cancelled.push_back(tweens_[i].id);
+			tweens_.erase(tweens_.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+void WindowTweener::clear(std::vector<UINT32>& cancelled) {
+	for (const Tween& tween : tweens_) {
+		cancelled.push_back(tween.id);
+	}
+	tweens_.clear();
+}
+
+BOOL WindowTweener::isRunning(const UINT32 id) const {
+	if (id == 0) return !tweens_.empty();
+
+	for (const Tween& tween : tweens_) {
+		if (tween.id == id) return TRUE;
+	}
+	return FALSE;
+}
+
+UINT32 WindowTweener::getTweenOf(const DWORD flag) const {
+	// プロパティは一つのアニメーションだけが動かす
+	for (const Tween& tween : tweens_) {
+		if (tween.flags & flag) return tween.id;
+	}
+	return 0;
+}
+
+DWORD WindowTweener::getFlags() const {
+	DWORD flags = 0;
+	for (const Tween& tween : tweens_) {
+		flags |= tween.flags;
+	}
+	return flags;
+}
+
+double WindowTweener::ease(const EasingType easing, const double t) {
+	double u;
+	switch (easing) {
+	case EasingType::InQuad:
+		return t * t;
+	case EasingType::OutQuad:
+		u = 1.0 - t;
+		return 1.0 - u * u;
+	case EasingType::InOutQuad:
+		if (t < 0.5) return 2.0 * t * t;
+		u = 2.0 - 2.0 * t;
+		return 1.0 - u * u / 2.0;
+	case EasingType::InCubic:
+		return t * t * t;
+	case EasingType::OutCubic:
+		u = 1.0 - t;
+		return 1.0 - u * u * u;
+	case EasingType::InOutCubic:
+		if (t < 0.5) return 4.0 * t * t * t;
+		u = 2.0 - 2.0 * t;
+		return 1.0 - u * u * u / 2.0;
+	case EasingType::Linear:
+	default:
+		return t;
+	}
+}
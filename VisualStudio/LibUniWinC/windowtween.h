@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include "libuniwinc.h"
+#include <vector>
+
+/// <summary>
+/// Window values animated by WindowTweener.
+///   The position is the bottom-left in screen coordinates, so that a size tween keeps the bottom-left as SetSize() does.
+/// </summary>
+struct TweenValues {
+	double left;
+	double bottom;
+	double width;
+	double height;
+	double alpha;		// [0, 255]
+};
+
+/// <summary>
+/// Scheduler of the window tweens, independent of the window system and of the clock.
+///   Each property (WindowTweenFlag) is animated by at most one tween. A new tween takes the properties from the older ones,
+///   and a tween which has lost all of its properties is cancelled.
+///   step() evaluates all tweens at the given time and merges them into one set of values,
+///   so that the caller changes the window once per tick however many tweens are running.
+///   The values depend only on the times given, so they are the same however irregular the ticks are.
+/// </summary>
+class WindowTweener {
+public:
+	WindowTweener();
+
+	/// <summary>
+	/// Start a tween
+	/// </summary>
+	/// <param name="now">Current time [us]</param>
+	/// <param name="flags">WindowTweenFlag of the properties to animate</param>
+	/// <param name="from">Current values</param>
+	/// <param name="to">Target values. Only the properties in flags are used</param>
+	/// <param name="duration">[us]. 0 or less reaches the target at the next step</param>
+	/// <param name="cancelled">Receives the IDs of the tweens cancelled by taking their properties</param>
+	/// <returns>Tween ID, or 0 if no property is given or too many tweens are running</returns>
+	UINT32 start(const INT64 now, const DWORD flags, const TweenValues& from, const TweenValues& to, const INT64 duration, const EasingType easing, std::vector<UINT32>& cancelled);
+
+	/// <summary>
+	/// Evaluate the tweens at the time and remove the finished ones
+	/// </summary>
+	/// <param name="values">The animated properties are overwritten. The others are kept</param>
+	/// <param name="completed">Receives the IDs of the tweens which have reached their targets</param>
+	/// <returns>WindowTweenFlag of the properties written</returns>
+	DWORD step(const INT64 now, TweenValues& values, std::vector<UINT32>& completed);
+
+	/// <summary>
+	/// Stop the tween
+	/// </summary>
+	/// <param name="bComplete">TRUE to reach the target at the next step, FALSE to remove it at once where it is</param>
+	/// <returns>FALSE if the tween is not running</returns>
+	BOOL stop(const UINT32 id, const BOOL bComplete);
+
+	/// <summary>
+	/// Stop animating the properties. Tweens left without properties are removed
+	/// </summary>
+	void take(const DWORD flags, std::vector<UINT32>& cancelled);
+
+	/// <summary>
+	/// Remove all the tweens
+	/// </summary>
+	void clear(std::vector<UINT32>& cancelled);
+
+	/// <param name="id">0 for any tween</param>
+	BOOL isRunning(const UINT32 id) const;
+
+	/// <summary>
+	/// ID of the tween animating the property, or 0
+	/// </summary>
+	/// <param name="flag">One of WindowTweenFlag</param>
+	UINT32 getTweenOf(const DWORD flag) const;
+
+	BOOL isEmpty() const { return tweens_.empty(); }
+
+	/// <summary>
+	/// WindowTweenFlag of the properties being animated
+	/// </summary>
+	DWORD getFlags() const;
+
+	/// <summary>
+	/// Progress of the curve at t in [0, 1]
+	/// </summary>
+	static double ease(const EasingType easing, const double t);
+
+private:
+	struct Tween {
+		UINT32 id;
+		DWORD flags;			// Properties still animated by this tween
+		TweenValues from;
+		TweenValues to;
+		INT64 start;			// [us]
+		INT64 duration;			// [us]
+		EasingType easing;
+		BOOL bFinishing;		// Reach the target at the next step
+	};
+
+	std::vector<Tween> tweens_;		// In the order of start
+	UINT32 nextId_;
+};
@@ -1229,6 +1229,15 @@ public class LibUniWinC {
         return true
     }
 
+    /// For Windows only. Changes are applied immediately on Mac
+    @objc public static func beginWindowUpdate() -> Void {
+    }
+
+    /// For Windows only
+    @objc public static func commitWindowUpdate() -> Bool {
+        return true
+    }
+
     /// Return some information for debugging
     @objc public static func getDebugInfo() -> Int32 {
         var result: Int32 = 0
@@ -232,6 +232,18 @@ public func AttachWindowHandle(hwnd: UInt64) -> Bool {
     return LibUniWinC.attachWindowHandle(hwnd: hwnd)
 }
 
+// For Windows only (Nothing to do on Mac)
+@_cdecl("BeginWindowUpdate")
+public func BeginWindowUpdate() -> Void {
+    LibUniWinC.beginWindowUpdate()
+}
+
+// For Windows only (Nothing to do on Mac)
+@_cdecl("CommitWindowUpdate")
+public func CommitWindowUpdate() -> Bool {
+    return LibUniWinC.commitWindowUpdate()
+}
+
 
 // For debugging
 @_cdecl("GetDebugInfo")